@@ -0,0 +1,94 @@
+//
+//  AOVDecodeScheduler.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  See license.txt for license terms.
+//
+//  AOVDecodeScheduler limits the decode work of all the views in the
+//  app to a budget of pixels per vsync, see decode_budget.h. Each
+//  AOVMTKView registers its player and asks the scheduler at every
+//  display link callback if a frame should be pulled and rendered.
+//  Views that show the frames of one shared decoder are registered
+//  once so that each frame is counted once against the budget.
+//  Views that cover more of the screen are served first, players
+//  that keep dropping frames are moved to a smaller rendition.
+//  The scheduler is used from the main thread.
+
+@import Foundation;
+@import CoreGraphics;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface AOVDecodeScheduler : NSObject
+
+// The scheduler shared by every view
+
++ (AOVDecodeScheduler*) sharedScheduler;
+
+// Budget in decoded pixels per vsync, an alpha video counts its RGB
+// and alpha streams. Defaults to AOV_DECODE_SCHEDULER_DEFAULT_PIXELS,
+// set to 0 to decode every frame.
+
+@property (nonatomic, assign) int64_t pixelsPerVsync;
+
+// Register the player of a view that decodes frames of width x height
+// from numStreams videos, returns the index used by the other methods
+// or -1 when too many players are registered. Views that pass the same
+// decodeKey share one player, see AOVFrameSourceShared decodeKey.
+
+- (int) addPlayerWithWidth:(int)width
+                    height:(int)height
+                numStreams:(int)numStreams
+             frameDuration:(CFTimeInterval)frameDuration
+                 decodeKey:(nullable id)decodeKey;
+
+- (int) addPlayerWithWidth:(int)width
+                    height:(int)height
+                numStreams:(int)numStreams
+             frameDuration:(CFTimeInterval)frameDuration;
+
+// A player shared by several views is removed with its last view
+
+- (void) removePlayer:(int)index;
+
+// Move the view to the player of another decodeKey, when the view
+// diverges from the decoder it shared it gets a player of its own.
+
+- (void) setPlayer:(int)index decodeKey:(nullable id)decodeKey;
+
+// Size in pixels of the view the player is shown in, a view that is
+// not visible gets no frames. A shared player is visible when any of
+// its views is and takes the size of its largest visible view.
+
+- (void) setPlayer:(int)index
+         viewWidth:(int)viewWidth
+        viewHeight:(int)viewHeight
+         isVisible:(BOOL)isVisible;
+
+// Pixel sizes as NSValue CGSize of the rendition that fits the view
+// followed by each smaller rendition, see AOVPlayer renditionLevelSizes.
+
+- (void) setPlayer:(int)index levelSizes:(NSArray<NSValue*>*)levelSizes;
+
+// Returns FALSE when the frame due at this vsync should not be pulled
+// and rendered. The first call with a new host time schedules every
+// player for that vsync.
+
+- (BOOL) shouldDecodePlayer:(int)index hostTime:(CFTimeInterval)hostTime;
+
+// Number of steps down from the rendition that fits the view
+
+- (int) levelForPlayer:(int)index;
+
+// Metrics as a string, frames decoded, late and dropped
+
+- (NSString*) metricsDescription;
+
+@end
+
+// About what a hardware decoder sustains at 60 Hz
+
+#define AOV_DECODE_SCHEDULER_DEFAULT_PIXELS (3840 * 2160)
+
+NS_ASSUME_NONNULL_END
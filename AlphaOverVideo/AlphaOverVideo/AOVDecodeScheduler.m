@@ -0,0 +1,274 @@
+//
+//  AOVDecodeScheduler.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  See license.txt for license terms.
+//
+
+#import "AOVDecodeScheduler.h"
+
+#import "decode_budget.h"
+
+@implementation AOVDecodeScheduler
+{
+  DecodeBudget *_budget;
+  
+  // Host time of the most recent scheduled vsync
+  CFTimeInterval _lastHostTime;
+  
+  // Player index of each decodeKey, keys are not retained
+  NSMapTable<id, NSNumber*> *_decodeKeyPlayers;
+}
+
++ (AOVDecodeScheduler*) sharedScheduler
+{
+#if defined(DEBUG)
+  NSAssert([NSThread isMainThread] == TRUE, @"isMainThread");
+#endif // DEBUG
+  
+  static AOVDecodeScheduler *scheduler = nil;
+  
+  if (scheduler == nil) {
+    scheduler = [[AOVDecodeScheduler alloc] init];
+  }
+  
+  return scheduler;
+}
+
+- (nullable instancetype) init
+{
+  if (self = [super init]) {
+    _budget = (DecodeBudget *) malloc(sizeof(DecodeBudget));
+    decode_budget_init(_budget, AOV_DECODE_SCHEDULER_DEFAULT_PIXELS);
+    
+    NSPointerFunctionsOptions keyOptions = NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality;
+    _decodeKeyPlayers = [NSMapTable mapTableWithKeyOptions:keyOptions valueOptions:NSPointerFunctionsStrongMemory];
+  }
+  
+  return self;
+}
+
+- (void) dealloc
+{
+  free(_budget);
+}
+
+- (int64_t) pixelsPerVsync
+{
+  return _budget->pixelsPerVsync;
+}
+
+- (void) setPixelsPerVsync:(int64_t)pixelsPerVsync
+{
+  _budget->pixelsPerVsync = pixelsPerVsync;
+}
+
+// The index returned to a view is the index of its view in the budget,
+// views with the same decodeKey are views of one player.
+
+- (int) addPlayerWithWidth:(int)width
+                    height:(int)height
+                numStreams:(int)numStreams
+             frameDuration:(CFTimeInterval)frameDuration
+                 decodeKey:(nullable id)decodeKey
+{
+  int playerIndex = [self playerForDecodeKey:decodeKey];
+  BOOL isNewPlayer = FALSE;
+  
+  if (playerIndex == -1) {
+    playerIndex = decode_budget_add_player(_budget, width, height, numStreams, frameDuration);
+    isNewPlayer = TRUE;
+  }
+  
+  if (playerIndex == -1) {
+    return -1;
+  }
+  
+  int index = decode_budget_add_view(_budget, playerIndex);
+  
+  if (index == -1) {
+    if (isNewPlayer) {
+      decode_budget_remove_player(_budget, playerIndex);
+    }
+    return -1;
+  }
+  
+  if (decodeKey != nil) {
+    [_decodeKeyPlayers setObject:@(playerIndex) forKey:decodeKey];
+  }
+  
+  return index;
+}
+
+- (int) addPlayerWithWidth:(int)width
+                    height:(int)height
+                numStreams:(int)numStreams
+             frameDuration:(CFTimeInterval)frameDuration
+{
+  return [self addPlayerWithWidth:width height:height numStreams:numStreams frameDuration:frameDuration decodeKey:nil];
+}
+
+// Player of the decodeKey, -1 when no view registered it
+
+- (int) playerForDecodeKey:(nullable id)decodeKey
+{
+  if (decodeKey == nil) {
+    return -1;
+  }
+  
+  NSNumber *num = [_decodeKeyPlayers objectForKey:decodeKey];
+  
+  if (num == nil || _budget->players[num.intValue].inUse == 0) {
+    return -1;
+  }
+  
+  return num.intValue;
+}
+
+- (void) removeDecodeKeysOfPlayer:(int)playerIndex
+{
+  NSMutableArray *keys = [NSMutableArray array];
+  
+  for (id key in _decodeKeyPlayers) {
+    if ([[_decodeKeyPlayers objectForKey:key] intValue] == playerIndex) {
+      [keys addObject:key];
+    }
+  }
+  
+  for (id key in keys) {
+    [_decodeKeyPlayers removeObjectForKey:key];
+  }
+}
+
+- (void) removePlayer:(int)index
+{
+  if (index == -1) {
+    return;
+  }
+  
+  int playerIndex = decode_budget_view_player(_budget, index);
+  decode_budget_remove_view(_budget, index);
+  
+  if (_budget->players[playerIndex].inUse == 0) {
+    [self removeDecodeKeysOfPlayer:playerIndex];
+  }
+}
+
+- (void) setPlayer:(int)index decodeKey:(nullable id)decodeKey
+{
+  if (index == -1 || decodeKey == nil) {
+    return;
+  }
+  
+  int prevPlayerIndex = decode_budget_view_player(_budget, index);
+  int playerIndex = [self playerForDecodeKey:decodeKey];
+  
+  if (playerIndex == prevPlayerIndex) {
+    return;
+  }
+  
+  if (playerIndex == -1) {
+    if (_budget->players[prevPlayerIndex].numViews == 1) {
+      // The only view of the player keeps it under the new key
+      playerIndex = prevPlayerIndex;
+      [self removeDecodeKeysOfPlayer:playerIndex];
+    } else {
+      playerIndex = decode_budget_copy_player(_budget, prevPlayerIndex);
+      
+      if (playerIndex == -1) {
+        return;
+      }
+    }
+    
+    [_decodeKeyPlayers setObject:@(playerIndex) forKey:decodeKey];
+  }
+  
+  decode_budget_move_view(_budget, index, playerIndex);
+  
+  if (_budget->players[prevPlayerIndex].inUse == 0) {
+    [self removeDecodeKeysOfPlayer:prevPlayerIndex];
+  }
+}
+
+- (void) setPlayer:(int)index
+         viewWidth:(int)viewWidth
+        viewHeight:(int)viewHeight
+         isVisible:(BOOL)isVisible
+{
+  decode_budget_set_view_size(_budget, index, viewWidth, viewHeight, isVisible ? 1 : 0);
+}
+
+- (void) setPlayer:(int)index levelSizes:(NSArray<NSValue*>*)levelSizes
+{
+  int widths[DECODE_BUDGET_MAX_LEVELS];
+  int heights[DECODE_BUDGET_MAX_LEVELS];
+  int numLevels = 0;
+  
+  for (NSValue *value in levelSizes) {
+    if (numLevels == DECODE_BUDGET_MAX_LEVELS) {
+      break;
+    }
+    
+    CGSize size = value.CGSizeValue;
+    widths[numLevels] = (int) size.width;
+    heights[numLevels] = (int) size.height;
+    numLevels += 1;
+  }
+  
+  decode_budget_set_levels(_budget, decode_budget_view_player(_budget, index), numLevels, widths, heights);
+}
+
+- (BOOL) shouldDecodePlayer:(int)index hostTime:(CFTimeInterval)hostTime
+{
+#if defined(DEBUG)
+  NSAssert([NSThread isMainThread] == TRUE, @"isMainThread");
+#endif // DEBUG
+  
+  if (index == -1) {
+    return TRUE;
+  }
+  
+  // Display links of all the views fire for the same vsync, times
+  // within 1 ms are treated as the same vsync.
+  
+  if (fabs(hostTime - _lastHostTime) > 0.001) {
+    decode_budget_schedule(_budget, hostTime);
+    _lastHostTime = hostTime;
+  }
+  
+  return decode_budget_decision(_budget, decode_budget_view_player(_budget, index)) != DecodeBudgetSkip;
+}
+
+- (int) levelForPlayer:(int)index
+{
+  if (index == -1) {
+    return 0;
+  }
+  
+  return decode_budget_level(_budget, decode_budget_view_player(_budget, index));
+}
+
+- (NSString*) metricsDescription
+{
+  DecodeBudgetMetrics *metrics = &_budget->metrics;
+  
+  double load = 0.0;
+  
+  if (_budget->pixelsPerVsync > 0 && metrics->numVsyncs > 0) {
+    load = (double) metrics->pixelsDecoded / ((double) _budget->pixelsPerVsync * metrics->numVsyncs);
+  }
+  
+  return [NSString stringWithFormat:@"%d of %d frames decoded : %d late : %d dropped : %d hidden : %d over budget : load %.2f : %d down %d up",
+          (int) metrics->numDecoded,
+          (int) metrics->numFrames,
+          (int) metrics->numLate,
+          (int) metrics->numDropped,
+          (int) metrics->numHiddenDropped,
+          (int) metrics->numOverBudget,
+          load,
+          (int) metrics->numDowngrades,
+          (int) metrics->numUpgrades];
+}
+
+@end
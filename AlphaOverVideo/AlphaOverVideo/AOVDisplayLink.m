@@ -8,6 +8,8 @@
 
 #import "AOVDisplayLink.h"
 
+#import "frame_pool.h"
+
 //#define LOG_DISPLAY_LINK_TIMINGS
 
 // Private API
@@ -26,10 +28,6 @@
 
 @property (nonatomic, assign) BOOL isReadyToPlay;
 
-// The last N display link vsync events will be tracked with this array.
-
-@property (nonatomic, retain) NSMutableArray *displayLinkVsyncTimes;
-
 // If sync start special case is needed then these fields are used to
 // wait until a couple of vsyncs are delivered.
 @property (nonatomic, retain) NSTimer *syncStartTimer;
@@ -263,6 +261,10 @@ static CVReturn displayLinkRenderCallback(CVDisplayLinkRef displayLink,
 #else
   CVDisplayLinkRef _displayLink;
 #endif // TARGET_OS_IOS
+  
+  // The last N display link vsync events, a fixed size history so
+  // that recording a vsync does not allocate.
+  FrameVsyncHistory _displayLinkVsyncTimes;
 }
 
 // FIXME: if view is deallocated while rendering then the render operation
@@ -527,21 +529,7 @@ static CVReturn displayLinkRenderCallback(CVDisplayLinkRef displayLink,
   
   // Record timing info until the next vsync can be predicted
   
-  NSMutableArray *displayLinkVsyncTimes = self.displayLinkVsyncTimes;
-  
-  if (self.displayLinkVsyncTimes == nil) {
-    self.displayLinkVsyncTimes = [NSMutableArray array];
-    displayLinkVsyncTimes = self.displayLinkVsyncTimes;
-  }
-  
-  {
-    NSNumber *framePresentationTimeNum = [NSNumber numberWithDouble:framePresentationTime];
-    [displayLinkVsyncTimes addObject:framePresentationTimeNum];
-    
-    if (displayLinkVsyncTimes.count > 3) {
-      [displayLinkVsyncTimes removeObjectAtIndex:0];
-    }
-  }
+  frame_vsync_history_add(&_displayLinkVsyncTimes, framePresentationTime);
 
   if (self.isReadyToPlay == FALSE) {
 #if defined(LOG_DISPLAY_LINK_TIMINGS)
@@ -581,9 +569,7 @@ static CVReturn displayLinkRenderCallback(CVDisplayLinkRef displayLink,
 
 - (void) syncStartCheck
 {
-  NSArray *displayLinkVsyncTimes = [NSArray arrayWithArray:self.displayLinkVsyncTimes];
-  
-  if (displayLinkVsyncTimes.count >= 1) {
+  if (_displayLinkVsyncTimes.count >= 1) {
     // At least 1 vsync times, ready to start
     
     [self.syncStartTimer invalidate];
@@ -591,8 +577,7 @@ static CVReturn displayLinkRenderCallback(CVDisplayLinkRef displayLink,
     
     self.isReadyToPlay = TRUE;
     
-    NSNumber *vsyncNum = [displayLinkVsyncTimes lastObject];
-    CFTimeInterval syncTime = [vsyncNum doubleValue];
+    CFTimeInterval syncTime = frame_vsync_history_last(&_displayLinkVsyncTimes);
     [self syncStart:syncTime];
   }
 }
@@ -621,9 +606,7 @@ static CVReturn displayLinkRenderCallback(CVDisplayLinkRef displayLink,
   //NSAssert(weakSelf.isReadyToPlay == FALSE, @"isReadyToPlay is already TRUE");
   //#endif // DEBUG
   
-  NSArray *displayLinkVsyncTimes = [NSArray arrayWithArray:self.displayLinkVsyncTimes];
-  
-  if (displayLinkVsyncTimes.count < 1) {
+  if (_displayLinkVsyncTimes.count < 1) {
     NSAssert(self.syncStartTimer == nil, @"syncStartTimer is already set");
     
     NSTimer *timer = [NSTimer timerWithTimeInterval:1.0f/60.0f
@@ -640,8 +623,7 @@ static CVReturn displayLinkRenderCallback(CVDisplayLinkRef displayLink,
     
     self.isReadyToPlay = TRUE;
     
-    NSNumber *vsyncNum = [displayLinkVsyncTimes lastObject];
-    CFTimeInterval syncTime = [vsyncNum doubleValue];
+    CFTimeInterval syncTime = frame_vsync_history_last(&_displayLinkVsyncTimes);
     [self syncStart:syncTime];
   }
 }
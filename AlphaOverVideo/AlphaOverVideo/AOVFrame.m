@@ -8,11 +8,20 @@
 
 #import "AOVFrame.h"
 
+#import "AOVFramePool.h"
+
 #import <QuartzCore/QuartzCore.h>
 
 // Private API
 
 @interface AOVFrame ()
+{
+  // Set for a frame owned by an AOVFramePool, the pixel buffers and
+  // frame number are then stored in the pool handle.
+  FramePoolHandle *m_poolHandle;
+  
+  int m_frameNum;
+}
 
 @end
 
@@ -21,10 +30,84 @@
 @synthesize yCbCrPixelBuffer = m_yCbCrPixelBuffer;
 @synthesize alphaPixelBuffer = m_alphaPixelBuffer;
 
+- (instancetype) initWithPoolHandle:(FramePoolHandle*)poolHandle
+{
+  if (self = [super init]) {
+    m_poolHandle = poolHandle;
+  }
+  
+  return self;
+}
+
+- (CVPixelBufferRef) yCbCrPixelBuffer
+{
+  if (m_poolHandle != NULL) {
+    return (CVPixelBufferRef) m_poolHandle->buffers[0];
+  }
+  return m_yCbCrPixelBuffer;
+}
+
+- (CVPixelBufferRef) alphaPixelBuffer
+{
+  if (m_poolHandle != NULL) {
+    return (CVPixelBufferRef) m_poolHandle->buffers[1];
+  }
+  return m_alphaPixelBuffer;
+}
+
+- (int) frameNum
+{
+  if (m_poolHandle != NULL) {
+    return m_poolHandle->timing.frameNum;
+  }
+  return m_frameNum;
+}
+
+- (void) setFrameNum:(int)frameNum
+{
+  if (m_poolHandle != NULL) {
+    m_poolHandle->timing.frameNum = frameNum;
+  } else {
+    m_frameNum = frameNum;
+  }
+}
+
+// Timing record of a pooled frame, NULL for a frame that is not pooled
+
+- (FrameTimingRecord*) timingRecord
+{
+  if (m_poolHandle != NULL) {
+    return &m_poolHandle->timing;
+  }
+  return NULL;
+}
+
+- (void) retainPooledFrame
+{
+  if (m_poolHandle != NULL) {
+    frame_pool_retain(m_poolHandle);
+  }
+}
+
+// Dropping the last reference releases the pixel buffers and returns
+// the frame to the pool, the frame must not be used after that.
+
+- (void) releasePooledFrame
+{
+  if (m_poolHandle != NULL) {
+    frame_pool_release(m_poolHandle);
+  }
+}
+
 // Setter for self.yCbCrPixelBuffer, this logic holds on to a retain for the CoreVideo buffer
 
 - (void) setYCbCrPixelBuffer:(CVPixelBufferRef)cvBufferRef
 {
+  if (m_poolHandle != NULL) {
+    frame_pool_set_buffer(m_poolHandle, 0, cvBufferRef);
+    return;
+  }
+  
   if (cvBufferRef) {
     CFRetain(cvBufferRef);
   }
@@ -36,6 +119,11 @@
 
 - (void) setAlphaPixelBuffer:(CVPixelBufferRef)cvBufferRef
 {
+  if (m_poolHandle != NULL) {
+    frame_pool_set_buffer(m_poolHandle, 1, cvBufferRef);
+    return;
+  }
+  
   if (cvBufferRef) {
     CFRetain(cvBufferRef);
   }
@@ -47,8 +135,12 @@
 
 - (void) dealloc
 {
-  self.yCbCrPixelBuffer = nil;
-  self.alphaPixelBuffer = nil;
+  // Buffers of a pooled frame are released by the pool
+  
+  if (m_poolHandle == NULL) {
+    self.yCbCrPixelBuffer = nil;
+    self.alphaPixelBuffer = nil;
+  }
   return;
 }
 
@@ -0,0 +1,60 @@
+//
+//  AOVFramePool.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  See license.txt for license terms.
+//
+//  A fixed set of AOVFrame objects that a frame source reuses for
+//  every decoded frame, so that no object is allocated per frame.
+//  Each frame wraps a frame_pool.h handle with an intrusive reference
+//  count. A frame returned by a frame source holds one reference that
+//  belongs to the caller, the caller passes it on or drops it with
+//  releasePooledFrame. Frames not created by a pool ignore these calls.
+
+@import Foundation;
+
+#import "AOVFrame.h"
+
+#import "frame_pool.h"
+
+// Frames per source : 2 held by a view, 1 held over by an alpha
+// source to repair an off by one decode and 1 just decoded, with
+// room for a caller that holds frames a little longer.
+
+#define AOV_FRAME_POOL_CAPACITY 8
+
+// Pooled frame API of AOVFrame
+
+@interface AOVFrame ()
+
+- (nonnull instancetype) initWithPoolHandle:(nonnull FramePoolHandle*)poolHandle;
+
+- (nullable FrameTimingRecord*) timingRecord;
+
+- (void) retainPooledFrame;
+
+- (void) releasePooledFrame;
+
+@end
+
+// AOVFramePool class
+
+@interface AOVFramePool : NSObject
+
+- (nullable instancetype) initWithCapacity:(int)capacity;
+
+// Return a frame with one reference that belongs to the caller,
+// nil when every frame in the pool is in use.
+
+- (nullable AOVFrame*) acquireFrame;
+
+// Number of frames held by a frame source or a view
+
+@property (nonatomic, readonly) int numFramesInUse;
+
+// Number of acquireFrame calls that returned nil
+
+@property (nonatomic, readonly) int numExhausted;
+
+@end
@@ -0,0 +1,103 @@
+//
+//  AOVFramePool.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  See license.txt for license terms.
+//
+
+#import "AOVFramePool.h"
+
+static void aov_frame_pool_retain_buffer(void *buffer)
+{
+  CVPixelBufferRetain((CVPixelBufferRef) buffer);
+}
+
+static void aov_frame_pool_release_buffer(void *buffer)
+{
+  CVPixelBufferRelease((CVPixelBufferRef) buffer);
+}
+
+// Private API
+
+@interface AOVFramePool ()
+{
+  FramePool *_pool;
+}
+
+// Holds the frame objects, the handles only hold unretained refs
+
+@property (nonatomic, copy) NSArray<AOVFrame*> *frames;
+
+@end
+
+@implementation AOVFramePool
+
+- (nullable instancetype) initWithCapacity:(int)capacity
+{
+  if (self = [super init]) {
+    _pool = frame_pool_create(capacity, aov_frame_pool_retain_buffer, aov_frame_pool_release_buffer);
+    
+    if (_pool == NULL) {
+      return nil;
+    }
+    
+    NSMutableArray *mFrames = [NSMutableArray arrayWithCapacity:capacity];
+    
+    for (int i = 0; i < capacity; i++) {
+      FramePoolHandle *handle = &_pool->handles[i];
+      AOVFrame *frame = [[AOVFrame alloc] initWithPoolHandle:handle];
+      handle->userData = (__bridge void *) frame;
+      [mFrames addObject:frame];
+    }
+    
+    self.frames = mFrames;
+  }
+  
+  return self;
+}
+
+// Frames still held by a view keep the pool memory alive until the
+// last reference is released.
+
+- (void) dealloc
+{
+  if (_pool != NULL) {
+    frame_pool_close(_pool);
+    _pool = NULL;
+  }
+}
+
+- (nullable AOVFrame*) acquireFrame
+{
+  FramePoolHandle *handle = frame_pool_acquire(_pool);
+  
+  if (handle == NULL) {
+    return nil;
+  }
+  
+  return (__bridge AOVFrame *) handle->userData;
+}
+
+- (int) numFramesInUse
+{
+  return frame_pool_num_in_use(_pool);
+}
+
+- (int) numExhausted
+{
+  return (int) _pool->numExhausted;
+}
+
+- (NSString*) description
+{
+  return [NSString stringWithFormat:@"AOVFramePool %p : %d of %d in use : %d acquired : max in use %d : %d exhausted",
+          self,
+          self.numFramesInUse,
+          _pool->numHandles,
+          (int) _pool->numAcquired,
+          _pool->maxInUse,
+          self.numExhausted];
+}
+
+@end
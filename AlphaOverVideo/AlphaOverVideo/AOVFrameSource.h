@@ -48,6 +48,8 @@
 // The presentationTimePtr pointer provides a way to query the
 // DTS (display time stamp) of the decoded frame in the H.264 stream.
 // Note that presentationTimePtr can be NULL.
+// A returned frame comes from a fixed pool of frames and holds one
+// pool reference that belongs to the caller, see AOVFramePool.h.
 
 - (nullable AOVFrame*) frameForHostTime:(CFTimeInterval)hostTime
                    hostPresentationTime:(CFTimeInterval)hostPresentationTime
@@ -82,4 +84,11 @@
 
 - (void) stop;
 
+// Replace the clip URLs passed to loadFromURLs with another set of the
+// same length, used to switch renditions. The clip that is playing is
+// not interrupted, the new URLs are used from the next clip or loop
+// boundary on.
+
+- (void) replaceClipURLs:(NSArray* _Nonnull)urlsArr;
+
 @end
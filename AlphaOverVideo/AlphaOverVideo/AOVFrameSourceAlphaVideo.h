@@ -44,6 +44,14 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, readonly) int loopCount;
 
+// TRUE when the sample tables of every RGB and alpha file pair were
+// verified to present identical frames at identical times at load
+// time. Frame mismatches during playback of a lock-step pair are
+// decode timing jitter and are repaired by holding a frame without
+// resyncing the players.
+
+@property (nonatomic, readonly) BOOL pairIsLockStep;
+
 // The maximum number of times a clip or a collection of clips will
 // be looped. When zero this indicates that playback will be stopped
 // after loop N completes.
@@ -72,6 +80,12 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (BOOL) loadFromURLs:(NSArray*)urlArr;
 
+// Replace the RGB and Alpha URL pairs, the pairs are checked and
+// indexed on a background queue and then both sources switch to the
+// new pairs at the same clip or loop boundary.
+
+- (void) replaceClipURLs:(NSArray*)urlArr;
+
 - (NSString*) description;
 
 // Kick of play operation
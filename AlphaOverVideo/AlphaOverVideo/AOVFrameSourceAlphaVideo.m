@@ -8,9 +8,14 @@
 
 #import "AOVFrameSourceAlphaVideo.h"
 
+#import "mp4_pair_check.h"
+
+#import "AOVFramePool.h"
+
 @import Metal;
 
 //#define STORE_TIMES
+//#define LOG_HELD_OVER_FRAMES
 
 #if TARGET_OS_IPHONE
 static int cachedFeatureSet = -1;
@@ -23,6 +28,13 @@ static int cachedFeatureSet = -1;
 @property (nonatomic, retain) AVPlayer *player;
 @property (nonatomic, retain) AVPlayerItemVideoOutput *playerItemVideoOutput;
 @property (nonatomic, assign) int frameNum;
+@property (nonatomic, retain) NSMutableDictionary *frameIndexes;
+
++ (NSDictionary*) frameIndexesForURLs:(NSArray*)clipURLs
+                         frameIndexes:(NSDictionary*)frameIndexes;
+
+- (void) replaceClipURLs:(NSArray*)urlsArr
+            frameIndexes:(NSDictionary*)frameIndexes;
 
 @end
 
@@ -41,18 +53,40 @@ static int cachedFeatureSet = -1;
 
 @property (nonatomic, assign) int isLooping;
 
-#if defined(STORE_TIMES)
-@property (nonatomic, retain) NSMutableArray *times;
-#endif // STORE_TIMES
+@property (nonatomic, assign) BOOL pairIsLockStep;
+
+// Set once the pairs from replaceClipURLs are checked and indexed,
+// until the next lastSecond
+
+@property (nonatomic, copy) NSArray *pendingRGBURLs;
+@property (nonatomic, copy) NSArray *pendingAlphaURLs;
+@property (nonatomic, copy) NSDictionary *pendingRGBFrameIndexes;
+@property (nonatomic, copy) NSDictionary *pendingAlphaFrameIndexes;
+@property (nonatomic, assign) BOOL pendingPairIsLockStep;
+
+// Incremented by each replaceClipURLs so that an earlier prepare that
+// completes late does not replace the latest pairs
+
+@property (nonatomic, assign) int replaceSerial;
 
 @end
 
 @implementation AOVFrameSourceAlphaVideo
+{
+#if defined(STORE_TIMES)
+  // RGB and alpha timing of each call, frameNum is -1 when no frame was decoded
+  FrameTimingLog _rgbTimes;
+  FrameTimingLog _alphaTimes;
+#endif // STORE_TIMES
+}
 
 - (void) dealloc
 {
   //NSLog(@"%@", self);
   
+  [self.heldRGBFrame releasePooledFrame];
+  [self.heldAlphaFrame releasePooledFrame];
+  
   return;
 }
 
@@ -75,21 +109,13 @@ static int cachedFeatureSet = -1;
            hostPresentationTime:(CFTimeInterval)hostPresentationTime
             presentationTimePtr:(float*)presentationTimePtr
 {
-  const int debugDumpForHostTimeValues = 1;
+  const int debugDumpForHostTimeValues = 0;
   
 #if defined(DEBUG)
   // Callback must be processed on main thread
   NSAssert([NSThread isMainThread] == TRUE, @"isMainThread");
 #endif // DEBUG
   
-#if defined(STORE_TIMES)
-  if (self.times == nil) {
-    self.times = [NSMutableArray array];
-  }
-  
-  NSMutableArray *timeArr = [NSMutableArray array];
-#endif // STORE_TIMES
-  
   // If entered frame logic with looping flag set to TRUE, then this
   // decode should not attempt to resync output until a frame has
   // been successfully decoded.
@@ -191,12 +217,19 @@ static int cachedFeatureSet = -1;
     isLooping = TRUE;
   }
   
+  // Logging allocates, it is off by default since no frame is decoded
+  // on every other vsync of a 30 FPS video on a 60 Hz display.
+  
+#if defined(LOG_HELD_OVER_FRAMES)
+  const BOOL isHeldOverLogging = TRUE;
+#else
+  const BOOL isHeldOverLogging = FALSE;
+#endif // LOG_HELD_OVER_FRAMES
+  
   // Attempt to fixup held over frames. Note that isHeldOver and isLooping
   // do not mix since fixing up a frame at the end or the start of a
   // video would fail because the video was just switched. nop in that case.
   
-  const BOOL isHeldOverLogging = TRUE;
-  
   if (isHeldOver && (isLooping == FALSE)) {
     if (rgbFrameNum == alphaFrameNum) {
       if (isHeldOverLogging) {
@@ -214,9 +247,11 @@ static int cachedFeatureSet = -1;
       
       if (rgbFrameNum != -1 && alphaFrameNum != -1) {
         if (isRGBHeldOver) {
+          [rgbFrame releasePooledFrame];
           rgbFrame = [rgbSource frameForItemTime:itemTime hostTime:hostTime hostPresentationTime:hostPresentationTime presentationTimePtr:&rgbPresentaitonTime];
           rgbFrameNum = (rgbFrame == nil) ? -1 : rgbFrame.frameNum;
         } else if (isAlphaHeldOver) {
+          [alphaFrame releasePooledFrame];
           alphaFrame = [alphaSource frameForItemTime:itemTime hostTime:hostTime hostPresentationTime:hostPresentationTime presentationTimePtr:&alphaPresentaitonTime];
           alphaFrameNum = (alphaFrame == nil) ? -1 : alphaFrame.frameNum;
         }
@@ -235,18 +270,22 @@ static int cachedFeatureSet = -1;
   }
   
 #if defined(STORE_TIMES)
-  // Media time when this frame data is being processed, ahead of hostTime since
-  // the hostTime value is determined in relation to vsync bounds.
-  [timeArr addObject:@(CACurrentMediaTime())];  
-  [timeArr addObject:@(hostTime)];
-  [timeArr addObject:@(CMTimeGetSeconds(itemTime))];
-  
-  [timeArr addObject:@(rgbPresentaitonTime)];
-  [timeArr addObject:@(rgbFrameNum)];
-  [timeArr addObject:@(alphaPresentaitonTime)];
-  [timeArr addObject:@(alphaFrameNum)];
+  {
+    FrameTimingRecord record;
+    record.hostTime = hostTime;
+    record.itemTime = CMTimeGetSeconds(itemTime);
+    record.presentationTime = rgbPresentaitonTime;
+    record.frameNum = rgbFrameNum;
+    frame_timing_log_add(&_rgbTimes, &record);
+    record.presentationTime = alphaPresentaitonTime;
+    record.frameNum = alphaFrameNum;
+    frame_timing_log_add(&_alphaTimes, &record);
+  }
 #endif // STORE_TIMES
   
+  // Each decoded frame holds a pool reference, a frame that is not
+  // returned or held over is released.
+  
   if (rgbFrame == nil && alphaFrame == nil) {
     // No frame avilable from either source
     if (isHeldOverLogging) {
@@ -258,12 +297,14 @@ static int cachedFeatureSet = -1;
     if (isHeldOverLogging) {
       NSLog(@"RGB returned a frame but alpha did not");
     }
+    [rgbFrame releasePooledFrame];
     rgbFrame = nil;
   } else if (rgbFrame == nil && alphaFrame != nil) {
     // alpha returned a frame but RGB did not
     if (isHeldOverLogging) {
       NSLog(@"alpha returned a frame but RGB did not");
     }
+    [alphaFrame releasePooledFrame];
     rgbFrame = nil;
   } else if (rgbFrameNum != alphaFrameNum) {
     if (isHeldOverLogging) {
@@ -280,14 +321,23 @@ static int cachedFeatureSet = -1;
     if (rgbFrameNum+1 == alphaFrameNum) {
       // Hold alpha until next loop
       self.heldAlphaFrame = alphaFrame;
+      [rgbFrame releasePooledFrame];
       offByOne = TRUE;
     } else if (alphaFrameNum+1 == rgbFrameNum) {
       // Hold rgb until next loop
       self.heldRGBFrame = rgbFrame;
+      [alphaFrame releasePooledFrame];
       offByOne = TRUE;
+    } else {
+      [rgbFrame releasePooledFrame];
+      [alphaFrame releasePooledFrame];
     }
     
-    if (offByOne && (isLooping == FALSE)) {
+    // A lock-step pair has identical sample tables, so an off by one
+    // frame is decode jitter that the held frame repairs on the next
+    // call. Resync only pairs that could not be verified at load time.
+    
+    if (offByOne && (isLooping == FALSE) && (self.pairIsLockStep == FALSE)) {
       if (isHeldOverLogging) {
         NSLog(@"setRate to repair frame off by 1 mismatch");
       }
@@ -302,13 +352,10 @@ static int cachedFeatureSet = -1;
     rgbFrame = nil;
   } else {
     rgbFrame.alphaPixelBuffer = alphaFrame.yCbCrPixelBuffer;
+    [alphaFrame releasePooledFrame];
     alphaFrame = nil;
   }
   
-#if defined(STORE_TIMES)
-  [self.times addObject:timeArr];
-#endif // STORE_TIMES
-  
   if (presentationTimePtr != NULL) {
     *presentationTimePtr = rgbPresentaitonTime;
   }
@@ -341,6 +388,38 @@ static int cachedFeatureSet = -1;
   self.rgbSource.lastSecondFrameDelta = 3.0;
 }
 
+// Compare the sample tables of a local RGB and alpha file pair,
+// returns TRUE when both present the same frames at the same times.
+// Remote URLs cannot be checked without a download and return FALSE.
+
++ (BOOL) checkPair:(NSURL*)rgbURL alphaURL:(NSURL*)alphaURL
+{
+  if (rgbURL.isFileURL == FALSE || alphaURL.isFileURL == FALSE) {
+    return FALSE;
+  }
+  
+  Mp4PairReport report;
+  
+  int err = mp4_pair_check_files(rgbURL.path.fileSystemRepresentation, alphaURL.path.fileSystemRepresentation, &report);
+  
+  if (err != 0 || report.isLockStep == FALSE) {
+    NSLog(@"RGB and alpha pair mismatch for %@", rgbURL.lastPathComponent);
+    
+    for (int i = 0; i < report.numStored; i++) {
+      Mp4PairMismatch *mismatch = &report.mismatches[i];
+      NSLog(@"%s mismatch at frame %d : rgb %lld alpha %lld",
+            mp4_pair_mismatch_name(mismatch->type),
+            mismatch->frameNum,
+            (long long) mismatch->rgbValue,
+            (long long) mismatch->alphaValue);
+    }
+    
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
 // Init from an array of NSURL objects, loads the first
 // RGB and Alpha URLS from urlArr[0]
 
@@ -353,13 +432,21 @@ static int cachedFeatureSet = -1;
   NSMutableArray *mRGBArr = [NSMutableArray array];
   NSMutableArray *mAlphaArr = [NSMutableArray array];
   
+  BOOL pairIsLockStep = TRUE;
+  
   for (NSArray *pair in urlArr ) {
     NSURL *rgbURL = pair[0];
     NSURL *alphaURL = pair[1];
     
     [mRGBArr addObject:rgbURL];
     [mAlphaArr addObject:alphaURL];
+    
+    if (pairIsLockStep) {
+      pairIsLockStep = [self.class checkPair:rgbURL alphaURL:alphaURL];
+    }
   }
+  
+  self.pairIsLockStep = pairIsLockStep;
 
   BOOL worked;
   
@@ -376,6 +463,80 @@ static int cachedFeatureSet = -1;
   return worked;
 }
 
+// The pair check and the frame indexes read each file, this is done
+// on a background queue so that the display link is not blocked. The
+// prepared pairs are swapped in at the next lastSecond.
+
+- (void) replaceClipURLs:(NSArray*)urlArr
+{
+  self.replaceSerial += 1;
+  int replaceSerial = self.replaceSerial;
+  
+  NSArray *pairs = [urlArr copy];
+  BOOL checkPairs = self.pairIsLockStep;
+  NSDictionary *rgbFrameIndexes = [self.rgbSource.frameIndexes copy];
+  NSDictionary *alphaFrameIndexes = [self.alphaSource.frameIndexes copy];
+  
+  __weak typeof(self) weakSelf = self;
+  
+  dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+    NSMutableArray *mRGBArr = [NSMutableArray array];
+    NSMutableArray *mAlphaArr = [NSMutableArray array];
+    
+    BOOL pairIsLockStep = checkPairs;
+    
+    for (NSArray *pair in pairs ) {
+      NSURL *rgbURL = pair[0];
+      NSURL *alphaURL = pair[1];
+      
+      [mRGBArr addObject:rgbURL];
+      [mAlphaArr addObject:alphaURL];
+      
+      if (pairIsLockStep) {
+        pairIsLockStep = [AOVFrameSourceAlphaVideo checkPair:rgbURL alphaURL:alphaURL];
+      }
+    }
+    
+    NSDictionary *rgbClipFrameIndexes = [AOVFrameSourceVideo frameIndexesForURLs:mRGBArr frameIndexes:rgbFrameIndexes];
+    NSDictionary *alphaClipFrameIndexes = [AOVFrameSourceVideo frameIndexesForURLs:mAlphaArr frameIndexes:alphaFrameIndexes];
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+      AOVFrameSourceAlphaVideo *strongSelf = weakSelf;
+      
+      if (strongSelf == nil || strongSelf.replaceSerial != replaceSerial) {
+        return;
+      }
+      
+      strongSelf.pendingRGBURLs = mRGBArr;
+      strongSelf.pendingAlphaURLs = mAlphaArr;
+      strongSelf.pendingRGBFrameIndexes = rgbClipFrameIndexes;
+      strongSelf.pendingAlphaFrameIndexes = alphaClipFrameIndexes;
+      strongSelf.pendingPairIsLockStep = pairIsLockStep;
+    });
+  });
+}
+
+// Pass the pairs from replaceClipURLs to both sources at once, so that
+// a later replaceClipURLs cannot land between the staggered RGB and
+// Alpha preloads and mix two renditions.
+
+- (void) applyPendingClipURLs
+{
+  if (self.pendingRGBURLs == nil) {
+    return;
+  }
+  
+  self.pairIsLockStep = self.pairIsLockStep && self.pendingPairIsLockStep;
+  
+  [self.rgbSource replaceClipURLs:self.pendingRGBURLs frameIndexes:self.pendingRGBFrameIndexes];
+  [self.alphaSource replaceClipURLs:self.pendingAlphaURLs frameIndexes:self.pendingAlphaFrameIndexes];
+  
+  self.pendingRGBURLs = nil;
+  self.pendingAlphaURLs = nil;
+  self.pendingRGBFrameIndexes = nil;
+  self.pendingAlphaFrameIndexes = nil;
+}
+
 // FIXME: both callbacks need to report in and pass successfully,
 // return error conditions if not both successful after waiting
 // for both to be invoked.
@@ -607,6 +768,8 @@ static int cachedFeatureSet = -1;
 
 - (void) restart {
   self.isLooping = TRUE;
+  [self.heldRGBFrame releasePooledFrame];
+  [self.heldAlphaFrame releasePooledFrame];
   self.heldRGBFrame = nil;
   self.heldAlphaFrame = nil;
   
@@ -632,6 +795,8 @@ static int cachedFeatureSet = -1;
     return;
   }
   
+  [self applyPendingClipURLs];
+  
 #if TARGET_OS_IOS
   if ([self isMetalDeviceA8OrNewer]) {
     [self.alphaSource lastSecond];
@@ -0,0 +1,56 @@
+//
+//  AOVFrameSourceShared.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  See license.txt for license terms.
+//
+//  AOVFrameSourceShared class implements the AOVFrameSource
+//  protocol for one view on top of a frame source that is shared
+//  by every view that plays the same clip at the same time offset.
+//  The clip is decoded once and each decoded frame is handed to
+//  every view, see decode_fanout.h. A view whose playhead diverges
+//  from the shared playhead continues on a frame source of its own.
+//  Shared frame sources are used from the main thread.
+
+@import Foundation;
+@import AVFoundation;
+
+#import "AOVFrameSource.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface AOVFrameSourceShared : NSObject <AOVFrameSource>
+
+// Subscribe to the shared frame source for the clip URLs and time
+// offset. The factory block is invoked to create and load a frame
+// source when no view plays the clip at this offset yet. Returns
+// nil when no frame source could be created.
+
+- (nullable instancetype) initWithClipURLs:(NSArray*)urlsArr
+                                timeOffset:(CFTimeInterval)timeOffset
+                                   factory:(id<AOVFrameSource> _Nullable (^)(void))factory;
+
+// Offset in seconds of this view into the clip
+
+@property (nonatomic, readonly) CFTimeInterval timeOffset;
+
+// TRUE while frames come from a frame source shared with other views
+
+@property (nonatomic, readonly) BOOL isShared;
+
+// Identifies the decoder this view is on, views with the same key
+// decode each frame once, see AOVDecodeScheduler. The key changes
+// when the view diverges and is nil once stopped.
+
+@property (nonatomic, readonly, nullable) id decodeKey;
+
+- (NSString*) description;
+
+// Registry metrics as a string, decodes and frames shared by views
+
++ (NSString*) metricsDescription;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,539 @@
+//
+//  AOVFrameSourceShared.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  See license.txt for license terms.
+//
+
+#import "AOVFrameSourceShared.h"
+
+#import <QuartzCore/QuartzCore.h>
+
+#import "AOVFramePool.h"
+
+#import "decode_fanout.h"
+
+// AOVSharedDecode holds the frame source of one registry entry, an
+// instance is the decoder pointer stored in decode_fanout.h. Views
+// that join after the frame source was loaded or prerolled get their
+// callbacks right away.
+
+@interface AOVSharedDecode : NSObject
+
+@property (nonatomic, retain) id<AOVFrameSource> frameSource;
+
+// Kept so that a view that diverges can open its own frame source
+
+@property (nonatomic, copy) id<AOVFrameSource> (^factory)(void);
+
+@property (nonatomic, assign) CFTimeInterval timeOffset;
+
+@property (nonatomic, assign) float playRate;
+
+@property (nonatomic, assign) BOOL isLoaded;
+@property (nonatomic, assign) BOOL loadSucceeded;
+@property (nonatomic, assign) BOOL isPrerolled;
+
+@property (nonatomic, retain) NSMutableArray *loadedBlocks;
+@property (nonatomic, retain) NSMutableArray *prerollBlocks;
+
+// Host time that the view which starts the decoder syncs to, 0 when
+// the decoder was opened for a view that diverged.
+
+@property (nonatomic, assign) CFTimeInterval syncHostTime;
+
+@end
+
+@implementation AOVSharedDecode
+
+- (instancetype) initWithFrameSource:(id<AOVFrameSource>)frameSource
+                          timeOffset:(CFTimeInterval)timeOffset
+{
+  if (self = [super init]) {
+    self.frameSource = frameSource;
+    self.timeOffset = timeOffset;
+    self.playRate = 1.0f;
+    self.loadedBlocks = [NSMutableArray array];
+    self.prerollBlocks = [NSMutableArray array];
+    
+    __weak typeof(self) weakSelf = self;
+    
+    frameSource.loadedBlock = ^(BOOL success){
+      [weakSelf loaded:success];
+    };
+  }
+  
+  return self;
+}
+
+- (void) loaded:(BOOL)success
+{
+  self.isLoaded = TRUE;
+  self.loadSucceeded = success;
+  
+  NSArray *blocks = self.loadedBlocks;
+  self.loadedBlocks = [NSMutableArray array];
+  
+  for (void (^block)(BOOL) in blocks) {
+    block(success);
+  }
+}
+
+- (void) whenLoaded:(void (^)(BOOL success))block
+{
+  if (self.isLoaded) {
+    BOOL success = self.loadSucceeded;
+    dispatch_async(dispatch_get_main_queue(), ^{
+      block(success);
+    });
+  } else {
+    [self.loadedBlocks addObject:[block copy]];
+  }
+}
+
+// The frame source is prerolled once, for the first view that asks
+
+- (void) whenPrerolled:(float)rate block:(void (^)(void))block
+{
+  if (self.isPrerolled) {
+    dispatch_async(dispatch_get_main_queue(), block);
+    return;
+  }
+  
+  [self.prerollBlocks addObject:[block copy]];
+  
+  if (self.prerollBlocks.count > 1) {
+    return;
+  }
+  
+  self.playRate = rate;
+  
+  __weak typeof(self) weakSelf = self;
+  
+  [self.frameSource playWithPreroll:rate block:^{
+    weakSelf.isPrerolled = TRUE;
+    
+    NSArray *blocks = weakSelf.prerollBlocks;
+    weakSelf.prerollBlocks = [NSMutableArray array];
+    
+    for (void (^prerollBlock)(void) in blocks) {
+      prerollBlock();
+    }
+  }];
+}
+
+// Invoked by decode_fanout_start(), clip time 0 plays at startTime
+
+- (void) startAtTime:(CFTimeInterval)startTime
+{
+  if (self.isPrerolled && self.syncHostTime > 0) {
+    CFTimeInterval itemTime = self.syncHostTime - startTime;
+    [self.frameSource syncStart:self.playRate itemTime:itemTime atHostTime:self.syncHostTime];
+    return;
+  }
+  
+  // Opened for a view that diverged, once this frame source is ready
+  // it seeks to where the shared playhead is at that time, so the view
+  // continues from the shared clock instead of the start of the clip.
+  
+  __weak typeof(self) weakSelf = self;
+  
+  [self whenLoaded:^(BOOL success){
+    if (!success) {
+      return;
+    }
+    
+    [weakSelf whenPrerolled:weakSelf.playRate block:^{
+      CFTimeInterval frameDuration = weakSelf.frameSource.frameDuration;
+      CFTimeInterval hostTime = CACurrentMediaTime() + frameDuration;
+      CFTimeInterval itemTime = hostTime - startTime;
+      
+      if (itemTime < 0.0) {
+        itemTime = 0.0;
+      }
+      
+      [weakSelf.frameSource syncStart:weakSelf.playRate itemTime:itemTime atHostTime:hostTime];
+    }];
+  }];
+}
+
+@end
+
+// Decoder callbacks for decode_fanout.h, a frame is an AOVFrame that
+// holds one pool reference and one retain for each holder.
+
+static void* aov_shared_open(void *context, uint64_t clipId, int64_t offset, void *openArg)
+{
+  id<AOVFrameSource> (^factory)(void) = (__bridge id<AOVFrameSource> (^)(void)) openArg;
+  
+  id<AOVFrameSource> frameSource = factory();
+  
+  if (frameSource == nil) {
+    return NULL;
+  }
+  
+  // The offset key is in milliseconds
+  
+  AOVSharedDecode *sharedDecode = [[AOVSharedDecode alloc] initWithFrameSource:frameSource timeOffset:(offset / 1000.0)];
+  sharedDecode.factory = factory;
+  
+  return (__bridge_retained void *) sharedDecode;
+}
+
+// A view that diverges opens its own frame source with the factory
+// block retained by the shared decode it leaves
+
+static void* aov_shared_diverge_arg(void *context, void *decoder)
+{
+  AOVSharedDecode *sharedDecode = (__bridge AOVSharedDecode *) decoder;
+  return (__bridge void *) sharedDecode.factory;
+}
+
+static void aov_shared_start(void *context, void *decoder, double startTime)
+{
+  AOVSharedDecode *sharedDecode = (__bridge AOVSharedDecode *) decoder;
+  [sharedDecode startAtTime:startTime];
+}
+
+static void* aov_shared_decode(void *context, void *decoder, const DecodeFanoutRequest *request)
+{
+  AOVSharedDecode *sharedDecode = (__bridge AOVSharedDecode *) decoder;
+  
+  AOVFrame *frame = [sharedDecode.frameSource frameForHostTime:request->hostTime
+                                          hostPresentationTime:request->presentationTime
+                                           presentationTimePtr:NULL];
+  
+  if (frame == nil) {
+    return NULL;
+  }
+  
+  return (__bridge_retained void *) frame;
+}
+
+static void aov_shared_close(void *context, void *decoder)
+{
+  AOVSharedDecode *sharedDecode = (__bridge_transfer AOVSharedDecode *) decoder;
+  [sharedDecode.frameSource stop];
+}
+
+static void aov_shared_retain_frame(void *context, void *ptr)
+{
+  AOVFrame *frame = (__bridge AOVFrame *) ptr;
+  [frame retainPooledFrame];
+  CFRetain(ptr);
+}
+
+static void aov_shared_release_frame(void *context, void *ptr)
+{
+  AOVFrame *frame = (__bridge AOVFrame *) ptr;
+  [frame releasePooledFrame];
+  CFRelease(ptr);
+}
+
+// Registry shared by every view, only accessed from the main thread
+
+static DecodeFanout* aov_shared_fanout()
+{
+  static DecodeFanout *fanout = NULL;
+  
+  if (fanout == NULL) {
+    DecodeFanoutDecoder decoder;
+    decoder.open = aov_shared_open;
+    decoder.divergeArg = aov_shared_diverge_arg;
+    decoder.start = aov_shared_start;
+    decoder.decode = aov_shared_decode;
+    decoder.close = aov_shared_close;
+    decoder.retainFrame = aov_shared_retain_frame;
+    decoder.releaseFrame = aov_shared_release_frame;
+    decoder.context = NULL;
+    
+    fanout = (DecodeFanout *) malloc(sizeof(DecodeFanout));
+    decode_fanout_init(fanout, &decoder);
+  }
+  
+  return fanout;
+}
+
+// Private API
+
+@interface AOVFrameSourceShared ()
+
+// Index in the registry, -1 once stopped
+
+@property (nonatomic, assign) int subscriberIndex;
+
+@property (nonatomic, assign) CFTimeInterval timeOffset;
+
+@end
+
+@implementation AOVFrameSourceShared
+
+@synthesize loadedBlock = _loadedBlock;
+@synthesize videoPlaybackFinishedBlock = _videoPlaybackFinishedBlock;
+
+// Clip identity is the list of URLs the frame source decodes
+
++ (uint64_t) clipIdForURLs:(NSArray*)urlsArr
+{
+  NSMutableString *mStr = [NSMutableString string];
+  
+  for (id obj in urlsArr) {
+    NSArray *urls = [obj isKindOfClass:NSArray.class] ? (NSArray *) obj : @[obj];
+    for (NSURL *url in urls) {
+      [mStr appendString:url.absoluteString];
+      [mStr appendString:@"\n"];
+    }
+  }
+  
+  return decode_fanout_clip_id(mStr.UTF8String);
+}
+
+- (nullable instancetype) initWithClipURLs:(NSArray*)urlsArr
+                                timeOffset:(CFTimeInterval)timeOffset
+                                   factory:(id<AOVFrameSource> _Nullable (^)(void))factory
+{
+#if defined(DEBUG)
+  NSAssert([NSThread isMainThread] == TRUE, @"isMainThread");
+#endif // DEBUG
+  
+  if (self = [super init]) {
+    self.timeOffset = timeOffset;
+    
+    uint64_t clipId = [self.class clipIdForURLs:urlsArr];
+    int64_t offset = llround(timeOffset * 1000.0);
+    
+    self.subscriberIndex = decode_fanout_subscribe(aov_shared_fanout(), clipId, offset, (__bridge void *) factory);
+    
+    if (self.subscriberIndex == -1) {
+      return nil;
+    }
+  }
+  
+  return self;
+}
+
+- (void) dealloc
+{
+  [self stop];
+}
+
+- (nullable AOVSharedDecode*) sharedDecode
+{
+  if (self.subscriberIndex == -1) {
+    return nil;
+  }
+  return (__bridge AOVSharedDecode *) decode_fanout_subscriber_decoder(aov_shared_fanout(), self.subscriberIndex);
+}
+
+- (BOOL) isShared
+{
+  if (self.subscriberIndex == -1) {
+    return FALSE;
+  }
+  DecodeFanout *fanout = aov_shared_fanout();
+  return fanout->entries[fanout->subscribers[self.subscriberIndex].entryIndex].numSubscribers > 1;
+}
+
+- (nullable id) decodeKey
+{
+  return self.sharedDecode;
+}
+
+- (NSString*) description
+{
+  return [NSString stringWithFormat:@"AOVFrameSourceShared %p offset %.3f : %@ : %@",
+          self,
+          self.timeOffset,
+          self.isShared ? @"shared" : @"not shared",
+          self.sharedDecode.frameSource];
+}
+
++ (NSString*) metricsDescription
+{
+  DecodeFanoutMetrics *metrics = &aov_shared_fanout()->metrics;
+  
+  return [NSString stringWithFormat:@"%d decoders open (max %d) : %d decoded : %d of %d frames shared : %d diverged",
+          metrics->numOpenDecoders,
+          metrics->maxOpenDecoders,
+          (int) metrics->numFramesDecoded,
+          (int) metrics->numFramesShared,
+          (int) metrics->numFramesDelivered,
+          (int) metrics->numDivergences];
+}
+
+// The loaded block is invoked once the shared frame source has loaded,
+// right away when it was loaded for another view.
+
+- (void) setLoadedBlock:(void (^)(BOOL))loadedBlock
+{
+  _loadedBlock = [loadedBlock copy];
+  
+  if (loadedBlock == nil) {
+    return;
+  }
+  
+  __weak typeof(self) weakSelf = self;
+  
+  [self.sharedDecode whenLoaded:^(BOOL success){
+    void (^block)(BOOL) = weakSelf.loadedBlock;
+    weakSelf.loadedBlock = nil;
+    if (block != nil) {
+      block(success);
+    }
+  }];
+}
+
+- (nullable AOVFrame*) frameForHostTime:(CFTimeInterval)hostTime
+                   hostPresentationTime:(CFTimeInterval)hostPresentationTime
+                    presentationTimePtr:(nullable float*)presentationTimePtr
+{
+#if defined(DEBUG)
+  NSAssert([NSThread isMainThread] == TRUE, @"isMainThread");
+#endif // DEBUG
+  
+  if (self.subscriberIndex == -1) {
+    return nil;
+  }
+  
+  void *ptr = decode_fanout_frame(aov_shared_fanout(), self.subscriberIndex, hostTime, hostPresentationTime);
+  
+  if (ptr == NULL) {
+    return nil;
+  }
+  
+  // The pool reference belongs to the caller and ARC takes over the retain
+  
+  AOVFrame *frame = (__bridge_transfer AOVFrame *) ptr;
+  
+  if (presentationTimePtr != NULL) {
+    FrameTimingRecord *record = [frame timingRecord];
+    *presentationTimePtr = (record != NULL) ? (float) record->presentationTime : -1.0f;
+  }
+  
+  return frame;
+}
+
+- (BOOL) hasMoreFrames
+{
+  return [self.sharedDecode.frameSource hasMoreFrames];
+}
+
+- (void) playWithPreroll:(float)rate block:(void (^)(void))block
+{
+  [self.sharedDecode whenPrerolled:rate block:block];
+}
+
+// The first view to sync start the shared frame source starts it,
+// other views join the playhead that is already running.
+
+- (void) syncStart:(float)rate
+          itemTime:(CFTimeInterval)itemTime
+        atHostTime:(CFTimeInterval)atHostTime
+{
+  AOVSharedDecode *sharedDecode = self.sharedDecode;
+  
+  if (sharedDecode == nil) {
+    return;
+  }
+  
+  sharedDecode.playRate = rate;
+  sharedDecode.syncHostTime = atHostTime;
+  
+  CFTimeInterval startTime = atHostTime - (itemTime + self.timeOffset);
+  
+  decode_fanout_start(aov_shared_fanout(), self.subscriberIndex, startTime, sharedDecode.frameSource.frameDuration);
+}
+
+// Stop leaves the shared frame source, it is stopped when the last
+// view leaves.
+
+- (void) stop
+{
+  if (self.subscriberIndex == -1) {
+    return;
+  }
+  
+  decode_fanout_unsubscribe(aov_shared_fanout(), self.subscriberIndex);
+  self.subscriberIndex = -1;
+}
+
+// Shared clips are identified by their URLs, a shared frame source
+// does not switch clips.
+
+- (void) replaceClipURLs:(NSArray*)urlsArr
+{
+  return;
+}
+
+- (int) loopCount
+{
+  return self.sharedDecode.frameSource.loopCount;
+}
+
+- (int) loopMaxCount
+{
+  return self.sharedDecode.frameSource.loopMaxCount;
+}
+
+- (void) setLoopMaxCount:(int)loopMaxCount
+{
+  self.sharedDecode.frameSource.loopMaxCount = loopMaxCount;
+}
+
+- (float) FPS
+{
+  return self.sharedDecode.frameSource.FPS;
+}
+
+- (void) setFPS:(float)FPS
+{
+  self.sharedDecode.frameSource.FPS = FPS;
+}
+
+- (float) frameDuration
+{
+  return self.sharedDecode.frameSource.frameDuration;
+}
+
+- (void) setFrameDuration:(float)frameDuration
+{
+  self.sharedDecode.frameSource.frameDuration = frameDuration;
+}
+
+- (int) width
+{
+  return self.sharedDecode.frameSource.width;
+}
+
+- (void) setWidth:(int)width
+{
+  self.sharedDecode.frameSource.width = width;
+}
+
+- (int) height
+{
+  return self.sharedDecode.frameSource.height;
+}
+
+- (void) setHeight:(int)height
+{
+  self.sharedDecode.frameSource.height = height;
+}
+
+- (BOOL) isReadyToPlay
+{
+  return self.sharedDecode.frameSource.isReadyToPlay;
+}
+
+- (BOOL) isPlaying
+{
+  return self.sharedDecode.frameSource.isPlaying;
+}
+
+- (BOOL) isFinishedPlaying
+{
+  return self.sharedDecode.frameSource.isFinishedPlaying;
+}
+
+@end
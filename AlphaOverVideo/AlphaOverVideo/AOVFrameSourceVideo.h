@@ -86,6 +86,12 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (BOOL) loadFromURLs:(NSArray*)urlsArr;
 
+// Replace the clip URLs, the frame indexes of the new URLs are built
+// on a background queue and the new URLs are used from the next time
+// lastSecond preloads a clip after that.
+
+- (void) replaceClipURLs:(NSArray*)urlsArr;
+
 - (NSString*) description;
 
 // Kick of play operation
@@ -121,6 +127,11 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (void) seekToTimeZero;
 
+// Frame accurate seek using the sample table index of a local file,
+// returns FALSE when no index is available for the current clip.
+
+- (BOOL) seekToFrame:(int)frameNum;
+
 // Initiate playback by preloading for a specific rate (typically 1.0)
 // and invoke block callback.
 
@@ -170,7 +181,8 @@ NS_ASSUME_NONNULL_BEGIN
 
 // Get frame that corresponds to item time. The item time range is
 // (0.0, (N * frameDuration))
-// Note that hostTime is used only for debug output here
+// Note that hostTime is only recorded in the frame timing record.
+// The returned frame holds one pool reference that belongs to the caller.
 
 - (nullable AOVFrame*) frameForItemTime:(CMTime)itemTime
                                hostTime:(CFTimeInterval)hostTime
@@ -14,9 +14,48 @@
 
 #import "AOVPlayerVideoOutput.h"
 
+#import "AOVFramePool.h"
+
+#import "mp4_probe.h"
+#import "mp4_index.h"
+
 //#define LOG_DISPLAY_LINK_TIMINGS
 //#define STORE_TIMES
 
+// AOVFrameIndex holds the mp4_index of one local file clip. The index
+// is built and opened once when the clips are defined, frame lookups
+// on the display link read it in place.
+
+@interface AOVFrameIndex : NSObject
+{
+@public
+  Mp4Index _index;
+}
+
+- (nullable instancetype) initWithURL:(NSURL*)url;
+
+@end
+
+@implementation AOVFrameIndex
+
+- (nullable instancetype) initWithURL:(NSURL*)url
+{
+  if (self = [super init]) {
+    if (mp4_index_build_file(url.path.fileSystemRepresentation, &_index) != 0) {
+      return nil;
+    }
+  }
+  
+  return self;
+}
+
+- (void) dealloc
+{
+  mp4_index_free(&_index);
+}
+
+@end
+
 // Private API
 
 @interface AOVFrameSourceVideo ()
@@ -24,22 +63,39 @@
 @property (nonatomic, retain) NSMutableArray<AVURLAsset *> *assets;
 @property (nonatomic, assign) int assetOffset;
 
+// Set once the clips from replaceClipURLs are prepared, until the next preload
+
+@property (nonatomic, copy) NSArray *pendingClipURLs;
+@property (nonatomic, copy) NSDictionary<NSURL*, AOVFrameIndex*> *pendingFrameIndexes;
+
+// Incremented by each replaceClipURLs so that an earlier prepare that
+// completes late does not replace the latest clips
+
+@property (nonatomic, assign) int replaceSerial;
+
 @property (nonatomic, assign) BOOL isPlayer2Active;
 @property (nonatomic, retain) AOVPlayerVideoOutput *playerVideoOutput1;
 @property (nonatomic, retain) AOVPlayerVideoOutput *playerVideoOutput2;
 
 @property (nonatomic, assign) int frameNum;
 
+// Opened mp4_index for each local file URL
+
+@property (nonatomic, retain) NSMutableDictionary<NSURL*, AOVFrameIndex*> *frameIndexes;
+
 @property (nonatomic, assign) int loopCount;
 
-#if defined(STORE_TIMES)
-@property (nonatomic, retain) NSMutableArray *times;
-#endif // STORE_TIMES
+// Decoded frames are handed out from a fixed set of frames
+
+@property (nonatomic, retain) AOVFramePool *framePool;
 
 @end
 
 @implementation AOVFrameSourceVideo
 {
+#if defined(STORE_TIMES)
+  FrameTimingLog _times;
+#endif // STORE_TIMES
 }
 
 - (nullable instancetype) init
@@ -47,6 +103,7 @@
   if (self = [super init]) {
     self.playerVideoOutput1 = [[AOVPlayerVideoOutput alloc] init];
     self.playerVideoOutput2 = [[AOVPlayerVideoOutput alloc] init];
+    self.framePool = [[AOVFramePool alloc] initWithCapacity:AOV_FRAME_POOL_CAPACITY];
     self.playRate = 1.0;
     self.lastSecondFrameDelta = 1.5;
   }
@@ -169,7 +226,7 @@
 
 // Get frame that corresponds to item time. The item time range is
 // (0.0, (N * frameDuration))
-// Note that hostTime is used only for debug output here
+// Note that hostTime is only recorded in the frame timing record.
 
 - (AOVFrame*) frameForItemTime:(CMTime)itemTime
                        hostTime:(CFTimeInterval)hostTime
@@ -195,14 +252,6 @@
   
   // Map time offset to item time
   
-#if defined(STORE_TIMES)
-  if (self.times == nil) {
-    self.times = [NSMutableArray array];
-  }
-  
-  NSMutableArray *timeArr = [NSMutableArray array];
-#endif // STORE_TIMES
-  
   // FIXME: Seems that a lot of CPU time in itemTimeForHostTime is being
   // spent getting the master clock for the host. It is better performance
   // wise to always set the master clock at the start of playback ?
@@ -229,14 +278,6 @@
   float itemSeconds = CMTimeGetSeconds(itemTime);
   float presentationTimeSeconds = -1;
   
-#if defined(STORE_TIMES)
-  // Media time when this frame data is being processed, ahead of hostTime since
-  // the hostTime value is determined in relation to vsync bounds.
-  [timeArr addObject:@(CACurrentMediaTime())];
-  [timeArr addObject:@(hostTime)];
-  [timeArr addObject:@(itemSeconds)];
-#endif // STORE_TIMES
-  
   if ([playerItemVideoOutput hasNewPixelBufferForItemTime:itemTime]) {
     // Grab the pixel bufer for the current time
     
@@ -252,42 +293,51 @@
       NSLog(@"                     display time %0.3f", presentationTimeSeconds);
 #endif // LOG_DISPLAY_LINK_TIMINGS
       
-      nextFrame = [[AOVFrame alloc] init];
+      // A frame is only allocated when a caller holds more frames
+      // than the pool capacity.
+      
+      nextFrame = [self.framePool acquireFrame];
+      
+      if (nextFrame == nil) {
+        nextFrame = [[AOVFrame alloc] init];
+      }
+      
       nextFrame.yCbCrPixelBuffer = rgbPixelBuffer;
-      nextFrame.frameNum = [AOVFrame calcFrameNum:presentationTimeSeconds fps:self.FPS];
+      nextFrame.frameNum = [self frameNumForPresentationTime:presentationTime asset:pvo.playerItem.asset];
       CVPixelBufferRelease(rgbPixelBuffer);
+      
+      FrameTimingRecord *timingRecord = nextFrame.timingRecord;
+      
+      if (timingRecord != NULL) {
+        timingRecord->hostTime = hostTime;
+        timingRecord->itemTime = itemSeconds;
+        timingRecord->presentationTime = presentationTimeSeconds;
+      }
 
 #if defined(LOG_DISPLAY_LINK_TIMINGS)
       NSLog(@"                     display F -> %d", nextFrame.frameNum);
 #endif // LOG_DISPLAY_LINK_TIMINGS
-      
-#if defined(STORE_TIMES)
-      [timeArr addObject:@(presentationTimeSeconds)];
-      [timeArr addObject:@(nextFrame.frameNum)];
-#endif // STORE_TIMES
     } else {
 #if defined(LOG_DISPLAY_LINK_TIMINGS)
       NSLog(@"did not load RGB frame for item time %0.3f", itemSeconds);
 #endif // LOG_DISPLAY_LINK_TIMINGS
-      
-#if defined(STORE_TIMES)
-      [timeArr addObject:@(-1)];
-      [timeArr addObject:@(-1)];
-#endif // STORE_TIMES
     }
   } else {
 #if defined(LOG_DISPLAY_LINK_TIMINGS)
     NSLog(@"hasNewPixelBufferForItemTime is FALSE at item time %0.3f", itemSeconds);
 #endif // LOG_DISPLAY_LINK_TIMINGS
-    
-#if defined(STORE_TIMES)
-    [timeArr addObject:@(-1)];
-    [timeArr addObject:@(-1)];
-#endif // STORE_TIMES
   }
   
 #if defined(STORE_TIMES)
-  [self.times addObject:timeArr];
+  {
+    // Fixed size log, -1 when no frame was loaded for the item time
+    FrameTimingRecord record;
+    record.hostTime = hostTime;
+    record.itemTime = itemSeconds;
+    record.presentationTime = presentationTimeSeconds;
+    record.frameNum = (nextFrame == nil) ? -1 : nextFrame.frameNum;
+    frame_timing_log_add(&_times, &record);
+  }
 #endif // STORE_TIMES
   
   // When one clip will transition into the next clip, a preloading stage
@@ -347,23 +397,156 @@
   return TRUE;
 }
 
-// Define clips array
+// Lookup the sample table index for a local file asset
+
+- (const Mp4Index*) frameIndexForAsset:(AVAsset*)asset
+{
+  if ([asset isKindOfClass:AVURLAsset.class] == FALSE) {
+    return NULL;
+  }
+  
+  AOVFrameIndex *frameIndex = self.frameIndexes[((AVURLAsset*)asset).URL];
+  
+  if (frameIndex == nil) {
+    return NULL;
+  }
+  
+  return &frameIndex->_index;
+}
+
+// Map a presentation time to a frame number using the sample table
+// index of the asset. The integer media time lookup avoids float
+// rounding errors with fractional frame rates like 29.97.
+
+- (int) frameNumForPresentationTime:(CMTime)presentationTime
+                              asset:(AVAsset*)asset
+{
+  const Mp4Index *index = [self frameIndexForAsset:asset];
+  
+  if (index != NULL) {
+    int64_t pts = mp4_index_media_time(index, presentationTime.value, presentationTime.timescale);
+    return mp4_index_frame_at_time(index, pts);
+  }
+  
+  return [AOVFrame calcFrameNum:CMTimeGetSeconds(presentationTime) fps:self.FPS];
+}
+
+// Build the frame index of each local file clip that is not already
+// in frameIndexes. This reads the sample tables of each file, so it
+// can be invoked from a background queue.
+
++ (NSDictionary*) frameIndexesForURLs:(NSArray*)clipURLs
+                         frameIndexes:(NSDictionary*)frameIndexes
+{
+  NSMutableDictionary<NSURL*, AOVFrameIndex*> *mFrameIndexes = [NSMutableDictionary dictionary];
+  
+  for (NSURL *url in clipURLs) {
+    if (url.isFileURL && mFrameIndexes[url] == nil) {
+      AOVFrameIndex *frameIndex = frameIndexes[url];
+      
+      if (frameIndex == nil) {
+        frameIndex = [[AOVFrameIndex alloc] initWithURL:url];
+      }
+      
+      mFrameIndexes[url] = frameIndex;
+    }
+  }
+  
+  return [NSDictionary dictionaryWithDictionary:mFrameIndexes];
+}
+
+// Define clips array from URLs and the frame indexes built for them
 
 - (void) makeAssetClipsFromURLs:(NSArray*)clipURLs
+                   frameIndexes:(NSDictionary*)clipFrameIndexes
 {
   NSMutableArray<AVURLAsset *> *assets = [NSMutableArray array];
   
+  // Indexes of earlier clips are kept since a clip that is still
+  // playing may have been replaced by replaceClipURLs
+  
+  NSMutableDictionary<NSURL*, AOVFrameIndex*> *frameIndexes = [NSMutableDictionary dictionary];
+  
+  if (self.frameIndexes != nil) {
+    [frameIndexes addEntriesFromDictionary:self.frameIndexes];
+  }
+  
+  [frameIndexes addEntriesFromDictionary:clipFrameIndexes];
+  
   for (NSURL *url in clipURLs) {
     AVURLAsset *urlAsset = [AVURLAsset URLAssetWithURL:url options:nil];
     [assets addObject:urlAsset];
   }
   
+  self.frameIndexes = frameIndexes;
+  
   self.assets = assets;
   self.assetOffset = 0;
   
   return;
 }
 
+- (void) replaceClipURLs:(NSArray*)urlsArr
+{
+#if defined(DEBUG)
+  NSAssert(urlsArr.count == self.assets.count, @"replaceClipURLs count %d != %d", (int)urlsArr.count, (int)self.assets.count);
+#endif // DEBUG
+  
+  // Building the frame indexes reads each file, this is done on a
+  // background queue so that the display link is not blocked. The
+  // prepared clips are swapped in at the next preload.
+  
+  self.replaceSerial += 1;
+  int replaceSerial = self.replaceSerial;
+  
+  NSArray *clipURLs = [urlsArr copy];
+  NSDictionary *frameIndexes = [self.frameIndexes copy];
+  
+  __weak typeof(self) weakSelf = self;
+  
+  dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+    NSDictionary *clipFrameIndexes = [AOVFrameSourceVideo frameIndexesForURLs:clipURLs frameIndexes:frameIndexes];
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+      if (weakSelf.replaceSerial == replaceSerial) {
+        [weakSelf replaceClipURLs:clipURLs frameIndexes:clipFrameIndexes];
+      }
+    });
+  });
+}
+
+// Replace the clip URLs with frame indexes that were already built,
+// the clips are swapped in at the next preload.
+
+- (void) replaceClipURLs:(NSArray*)urlsArr
+            frameIndexes:(NSDictionary*)frameIndexes
+{
+  self.pendingClipURLs = urlsArr;
+  self.pendingFrameIndexes = frameIndexes;
+}
+
+// Swap in the clips from replaceClipURLs before the next item is
+// preloaded, the position in the clip queue is not changed.
+
+- (void) applyPendingClipURLs
+{
+  NSArray *urls = self.pendingClipURLs;
+  NSDictionary *frameIndexes = self.pendingFrameIndexes;
+  
+  if (urls == nil) {
+    return;
+  }
+  
+  self.pendingClipURLs = nil;
+  self.pendingFrameIndexes = nil;
+  
+  int assetOffset = self.assetOffset;
+  
+  [self makeAssetClipsFromURLs:urls frameIndexes:frameIndexes];
+  
+  self.assetOffset = assetOffset % (int)self.assets.count;
+}
+
 // Init from array of URL assets
 
 - (BOOL) loadFromURLs:(NSArray*)urlsArr
@@ -392,7 +575,31 @@
   
   NSLog(@"PlayerItem URL %@", urls[0]);
   
-  [self makeAssetClipsFromURLs:urls];
+  // Parse dimensions and frame rate from the moov header of a local
+  // file so that these properties are valid before the async track
+  // load completes. The values are updated again in loadedCallback.
+  
+  NSURL *firstURL = urls[0];
+  
+  if (firstURL.isFileURL) {
+    Mp4ProbeResult probe;
+    
+    if (mp4_probe_file(firstURL.path.fileSystemRepresentation, &probe) == 0 && probe.minFrameDelta > 0) {
+      self.width = probe.width;
+      self.height = probe.height;
+      
+      float FPS = probe.FPS;
+      float frameDurationSeconds = probe.frameDuration;
+      if (FPS <= 30.001 && FPS >= 29.999) {
+        FPS = 30;
+        frameDurationSeconds = 1.0f / 30.0f;
+      }
+      self.FPS = FPS;
+      self.frameDuration = frameDurationSeconds;
+    }
+  }
+  
+  [self makeAssetClipsFromURLs:urls frameIndexes:[self.class frameIndexesForURLs:urls frameIndexes:self.frameIndexes]];
   
   __weak typeof(self) weakSelf = self;
   
@@ -745,6 +952,8 @@
   // Advance to next item, this preloading logic will
   // kick off an async asset ready to play notification.
   
+  [self applyPendingClipURLs];
+  
   AOVPlayerVideoOutput *pvo = [self preloadNextItem];
   NSAssert(pvo.player, @"player");
   
@@ -774,6 +983,24 @@
   [pvo seekToTimeZero];
 }
 
+- (BOOL) seekToFrame:(int)frameNum
+{
+  AOVPlayerVideoOutput *pvo = [self getCurrentPlayerVideoOutput];
+  const Mp4Index *index = [self frameIndexForAsset:pvo.playerItem.asset];
+  
+  if (index == NULL) {
+    return FALSE;
+  }
+  
+  if (frameNum < 0 || frameNum >= mp4_index_num_frames(index)) {
+    return FALSE;
+  }
+  
+  const Mp4IndexSample *sample = mp4_index_frame(index, frameNum);
+  [pvo seekToFrameTime:CMTimeMake(sample->pts, (int32_t) index->header->timescale)];
+  return TRUE;
+}
+
 // Initiate playback by preloading for a specific rate (typically 1.0)
 // and invoke block callback.
 
@@ -43,6 +43,27 @@ typedef enum
 
 @end
 
+// A frame source that provides frames that are already BT.709
+// 4:2:0 YCbCr, for example the output of cvpbu_ycbcr_subsample().
+// The encoder passes in a recycled kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange
+// buffer from the writer pool and the source writes the Y and CbCr
+// planes directly, so no CoreGraphics render or color conversion is
+// done for each encoded frame.
+
+@protocol AOVH264EncoderYCbCrFrameSource
+
+// Given a frame number in the range (0, N-1), write the Y and CbCr
+// planes of the indicated pixel buffer. Return FALSE on error.
+
+- (BOOL) fillYCbCrPixelBuffer:(CVPixelBufferRef)cvPixelBuffer frameNum:(int)frameNum;
+
+// Return TRUE if more frames can be returned by this frame source,
+// returning FALSE means that all frames have been encoded.
+
+- (BOOL) hasMoreFrames;
+
+@end
+
 // Implement this protocol to async report the results of an encoding
 // operation on a background thread.
 
@@ -66,6 +87,11 @@ typedef enum
 
 @property (nonatomic, assign) id<AOVH264EncoderFrameSource> frameSource;
 
+// Reference to a AOVH264EncoderYCbCrFrameSource implementation, when
+// set this source is used instead of frameSource.
+
+@property (nonatomic, assign) id<AOVH264EncoderYCbCrFrameSource> ycbcrFrameSource;
+
 // Reference to a H264EncoderResult, this must be set to a non-nil
 // value before encoding.
 
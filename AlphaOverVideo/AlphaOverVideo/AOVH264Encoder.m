@@ -155,10 +155,14 @@
              renderSize:(CGSize)renderSize
              aveBitrate:(int)aveBitrate
 {
-  if (self.frameSource == nil) {
+  if (self.frameSource == nil && self.ycbcrFrameSource == nil) {
     return AOVH264EncoderErrorCodeNoFrameSource;
   }
   
+  // A YCbCr source writes directly into biplanar buffers from the pool
+  
+  const BOOL isYCbCrSource = (self.ycbcrFrameSource != nil);
+  
   // If the output file already exists, remove it before starting
   // the encode process. This is basically "rm -f FILE". This
   // logic is run on the current thread (main thread)
@@ -228,7 +232,7 @@
   // of images to the videoWriterInput easier.
   
   NSMutableDictionary *adaptorAttributes = [NSMutableDictionary dictionaryWithObjectsAndKeys:
-                                            [NSNumber numberWithUnsignedInt:kCVPixelFormatType_32BGRA], kCVPixelBufferPixelFormatTypeKey,
+                                            [NSNumber numberWithUnsignedInt:(isYCbCrSource ? [self.class getPixelType] : kCVPixelFormatType_32BGRA)], kCVPixelBufferPixelFormatTypeKey,
                                             widthNum,  kCVPixelBufferWidthKey,
                                             heightNum, kCVPixelBufferHeightKey,
                                             nil];
@@ -294,7 +298,7 @@
     // Return TRUE if more frames can be returned by this frame source,
     // returning FALSE means that all frames have been encoded.
     
-    BOOL hasMoreFrames = [self.frameSource hasMoreFrames];
+    BOOL hasMoreFrames = isYCbCrSource ? [self.ycbcrFrameSource hasMoreFrames] : [self.frameSource hasMoreFrames];
     
     if (hasMoreFrames == FALSE) {
 #ifdef LOGGING
@@ -326,12 +330,6 @@
       [[NSRunLoop currentRunLoop] runUntilDate:maxDate];
     }
     
-    // Grab next input image frame
-    
-    NSAssert(self.frameSource, @"frameSource");
-    CGImageRef inImageRef = [self.frameSource imageForFrame:frameNum];
-    NSAssert(inImageRef != NULL, @"frameSource returned NULL for frame %d", frameNum);
-    
     CVReturn poolResult = CVPixelBufferPoolCreatePixelBuffer(NULL, adaptor.pixelBufferPool, &cvPixelBuffer);
     NSAssert(poolResult == kCVReturnSuccess, @"CVPixelBufferPoolCreatePixelBuffer");
     
@@ -343,7 +341,22 @@
     // kCVReturnInvalidArgument = -6661 (some configuration value is invalid, like adaptor.pixelBufferPool is nil)
     // kCVReturnAllocationFailed = -6662
     
-    [self fillPixelBufferFromImage:inImageRef cvPixelBuffer:cvPixelBuffer size:renderSize];
+    if (isYCbCrSource) {
+      // YCbCr source fills the pooled buffer directly
+      
+      BOOL filled = [self.ycbcrFrameSource fillYCbCrPixelBuffer:cvPixelBuffer frameNum:frameNum];
+      NSAssert(filled, @"ycbcrFrameSource failed to fill frame %d", frameNum);
+      
+      [self.class setBT709Attributes:cvPixelBuffer];
+    } else {
+      // Grab next input image frame
+      
+      NSAssert(self.frameSource, @"frameSource");
+      CGImageRef inImageRef = [self.frameSource imageForFrame:frameNum];
+      NSAssert(inImageRef != NULL, @"frameSource returned NULL for frame %d", frameNum);
+      
+      [self fillPixelBufferFromImage:inImageRef cvPixelBuffer:cvPixelBuffer size:renderSize];
+    }
     
     // Verify that the pixel buffer uses the BT.709 colorspace at this
     // points. This should have been defined inside the fill method.
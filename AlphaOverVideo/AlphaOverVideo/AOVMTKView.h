@@ -24,11 +24,31 @@
 #import "AOVFrame.h"
 #import "AOVPlayer.h"
 
+// Precision of the linear intermediate texture that video is
+// decoded into before a 2 pass resize into the view.
+// sRGB8 stores 4 bytes per pixel, Float16 stores 8 bytes per pixel
+// and stays within one 8 bit output step of Float32, which stores
+// 16 bytes per pixel.
+
+typedef enum {
+  AOVPrecisionSRGB8 = 0, // default
+  AOVPrecisionFloat16,
+  AOVPrecisionFloat32
+} AOVPrecision;
+
 // AOVMTKView extends MTKView
 
 @interface AOVMTKView : MTKView <MTKViewDelegate>
 
+// Defaults to AOVPrecisionSRGB8. Float32 falls back to Float16 on a
+// device that cannot filter 32 bit float textures and sRGB8 falls
+// back to Float16 when sRGB texture writes are not supported.
+
+@property (nonatomic, assign) AOVPrecision intermediatePrecision;
+
 // This method is invoked when the next frame of video is available.
+// A frame returned by a frame source is passed on with its pool
+// reference, the view drops it when the next frame is delivered.
 
 - (void) nextFrameReady:(AOVFrame*)nextFrame;
 
@@ -20,6 +20,11 @@
 #import "CVPixelBufferUtils.h"
 #import "AOVDisplayLink.h"
 #import "AOVFrameSource.h"
+#import "AOVFrameSourceShared.h"
+#import "AOVFramePool.h"
+#import "AOVDecodeScheduler.h"
+
+#import "decode_scaler.h"
 
 // Define this symbol to enable private texture mode on MacOSX.
 
@@ -98,6 +103,10 @@ void validate_storage_mode(id<MTLTexture> texture)
 
 @property (nonatomic, retain) AOVFrame *currentFrame;
 
+// Index of the player in AOVDecodeScheduler, -1 when not registered
+
+@property (nonatomic, assign) int schedulerIndex;
+
 @end
 
 @implementation AOVMTKView
@@ -132,8 +141,15 @@ void validate_storage_mode(id<MTLTexture> texture)
   
   self.displayLink = nil;
   
+  if (self.player != nil) {
+    [[AOVDecodeScheduler sharedScheduler] removePlayer:self.schedulerIndex];
+    self.schedulerIndex = -1;
+  }
+  
   MetalBT709Decoder *metalBT709Decoder = self.metalBT709Decoder;
   
+  [self.prevFrame releasePooledFrame];
+  [self.currentFrame releasePooledFrame];
   self.prevFrame = nil;
   self.currentFrame = nil;
   _resizeTexture = nil;
@@ -178,6 +194,15 @@ void validate_storage_mode(id<MTLTexture> texture)
   
   NSLog(@"layoutSubviews %d x %d -> viewport %d x %d", (int)size.width, (int)size.height, viewportWidth, viewportHeight);
   
+  // A player created from a rendition manifest selects the
+  // rendition that covers the new viewport size.
+  
+  if (viewportWidth > 0 && viewportHeight > 0) {
+    [self.player viewPixelSizeChanged:CGSizeMake(viewportWidth, viewportHeight)];
+  }
+  
+  [self updateScheduler];
+  
   // If media is attached and the size changes from an exact match to a different size
   // that would require a scale operation then be sure that an intermediate buffer is
   // allocated. This would make it possible to not allocate an intermediate buffer
@@ -311,12 +336,23 @@ void validate_storage_mode(id<MTLTexture> texture)
 {
   AOVMTKView *mtkView = self;
 
+  if (mtkView.player != nil) {
+    [[AOVDecodeScheduler sharedScheduler] removePlayer:mtkView.schedulerIndex];
+  }
+  
   mtkView.player = player;
+  mtkView.schedulerIndex = -1;
   
   [self checkSRGBPixelSupport];
   
   [mtkView mtkView:mtkView drawableSizeWillChange:mtkView.drawableSize];
   
+  // The view may have been laid out before the player was attached
+  
+  if (viewportWidth > 0 && viewportHeight > 0) {
+    [player viewPixelSizeChanged:CGSizeMake(viewportWidth, viewportHeight)];
+  }
+  
   __weak typeof(self) weakSelf = self;
   mtkView.delegate = weakSelf;
   
@@ -362,14 +398,13 @@ void validate_storage_mode(id<MTLTexture> texture)
         return;
       }
       
-      // Allocate scaling texture
+      // The intermediate scaling texture is allocated in displayFrame,
+      // and only when a frame needs a 2 pass resize.
       
       int pixelWidth = weakFrameSourceVideo.width;
       int pixelHeight = weakFrameSourceVideo.height;
       CGSize pixelSize = CGSizeMake(pixelWidth, pixelHeight);
       
-      [weakSelf makeInternalMetalTexture:pixelSize];
-      
       // Invoke block on player once video pixel size is known
       
       if (self.player.videoSizeReadyBlock != nil)
@@ -389,6 +424,20 @@ void validate_storage_mode(id<MTLTexture> texture)
       weakSelf.displayLink.FPS = FPS;
       weakSelf.displayLink.frameDuration = frameDuration;
       
+      // Register with the decode scheduler once the cost of a frame
+      // is known, an alpha video decodes two streams. Views of one
+      // shared decoder are registered as one player.
+      
+      if (weakSelf.schedulerIndex == -1) {
+        int numStreams = hasAlphaChannel ? 2 : 1;
+        weakSelf.schedulerIndex = [[AOVDecodeScheduler sharedScheduler] addPlayerWithWidth:pixelWidth
+                                                                                   height:pixelHeight
+                                                                               numStreams:numStreams
+                                                                            frameDuration:frameDuration
+                                                                                decodeKey:[weakSelf schedulerDecodeKey]];
+        [weakSelf updateScheduler];
+      }
+      
       if ([weakSelf.displayLink isDisplayLinkNotInitialized]) {
         [weakSelf.displayLink makeDisplayLink];
         [weakSelf.displayLink startDisplayLink];
@@ -429,7 +478,7 @@ void validate_storage_mode(id<MTLTexture> texture)
     // Invocation block for each display timer tick
     
     self.displayLink.invocationBlock = ^(CFTimeInterval hostTime, CFTimeInterval displayTime){
-      NSLog(@"AOVDisplayLink invocationBlock");
+      //NSLog(@"AOVDisplayLink invocationBlock");
       
       if (weakFrameSourceVideo.isFinishedPlaying == TRUE) {
         // When video playback has been started and it is now finished, terminate
@@ -489,9 +538,13 @@ void validate_storage_mode(id<MTLTexture> texture)
   self.displayLink = nil;
   self.player = nil;
   
+  [[AOVDecodeScheduler sharedScheduler] removePlayer:self.schedulerIndex];
+  self.schedulerIndex = -1;
+  
   // FIXME: Does view hold on to a ref to the most recent pixel buffer from a pool
   // delivered to the view?
   
+  [self.prevFrame releasePooledFrame];
   self.prevFrame = nil;
   
   return TRUE;
@@ -530,11 +583,6 @@ void validate_storage_mode(id<MTLTexture> texture)
     return;
   }
   
-  if (_resizeTexture == nil) {
-    NSLog(@"_resizeTexture not allocated in displayFrame");
-    return;
-  }
-  
   // Metal has been initialized at this point and the CAMetalLayer
   // used internally by MTKView has been allocated and configured.
   // Verify that the framebufferOnly optimization is enabled.
@@ -605,6 +653,9 @@ void validate_storage_mode(id<MTLTexture> texture)
     return;
   }
   
+  int frameWidth = (int) CVPixelBufferGetWidth(rgbPixelBuffer);
+  int frameHeight = (int) CVPixelBufferGetHeight(rgbPixelBuffer);
+  
   // Create a new command buffer for each render pass to the current drawable
   id<MTLCommandBuffer> commandBuffer = [mrc.commandQueue commandBuffer];
   commandBuffer.label = @"BT709 Render";
@@ -613,10 +664,33 @@ void validate_storage_mode(id<MTLTexture> texture)
   MTLRenderPassDescriptor *renderPassDescriptor = self.currentRenderPassDescriptor;
   
   BOOL isExactlySameSize =
-  (renderWidth == ((int)CVPixelBufferGetWidth(rgbPixelBuffer))) &&
-  (renderHeight == ((int)CVPixelBufferGetHeight(rgbPixelBuffer))) &&
+  (renderWidth == frameWidth) &&
+  (renderHeight == frameHeight) &&
   (renderPassDescriptor != nil);
   
+  // A view much smaller than the video is decoded and downscaled in
+  // one pass, so that a large video in a small view does not write
+  // and read back a full size intermediate texture. The fused pass
+  // decodes every filter tap, so a slight downscale uses 2 passes.
+  
+  BOOL isFusedScale =
+  (isExactlySameSize == FALSE) &&
+  (renderPassDescriptor != nil) &&
+  (isCaptureRenderedTextureEnabled == 0) &&
+  decode_scaler_use_fused(frameWidth, frameHeight, renderWidth, renderHeight,
+                          [self intermediateBytesPerPixel]);
+  
+  // Switching renditions changes the size of decoded frames at a
+  // loop boundary, the intermediate texture follows the frame size.
+  // The texture is released while it is not needed.
+  
+  if (isFusedScale || (isExactlySameSize && isCaptureRenderedTextureEnabled == 0)) {
+    _resizeTexture = nil;
+  } else if (_resizeTexture == nil || frameWidth != (int) _resizeTexture.width || frameHeight != (int) _resizeTexture.height ||
+             _resizeTexture.pixelFormat != [self intermediatePixelFormat]) {
+    [self makeInternalMetalTexture:CGSizeMake(frameWidth, frameHeight)];
+  }
+  
   if ((0)) {
     // Phony up exact match results just for testing purposes, this
     // would generate slightly wrong non-linear resample results
@@ -667,6 +741,23 @@ void validate_storage_mode(id<MTLTexture> texture)
 //#if defined(DEBUG)
 //      NSLog(@"PRESENT FRAME at host time %.3f : %.3f", presentationTime, CACurrentMediaTime());
 //#endif // DEBUG
+#endif // TARGET_OS_IOS
+    }
+  } else if (isFusedScale) {
+    worked = [metalBT709Decoder decodeScaleBT709:rgbPixelBuffer
+                                alphaPixelBuffer:alphaPixelBuffer
+                                   commandBuffer:commandBuffer
+                            renderPassDescriptor:renderPassDescriptor
+                                     renderWidth:renderWidth
+                                    renderHeight:renderHeight];
+    
+    if (worked) {
+#if TARGET_OS_IOS
+      CFTimeInterval minFramerate = self.frameDuration;
+      [commandBuffer presentDrawable:self.currentDrawable afterMinimumDuration:minFramerate];
+#else
+      CFTimeInterval presentationTime = self.presentationTime;
+      [commandBuffer presentDrawable:self.currentDrawable atTime:presentationTime];
 #endif // TARGET_OS_IOS
     }
   } else {
@@ -820,6 +911,7 @@ void validate_storage_mode(id<MTLTexture> texture)
 }
 
 // This method is invoked when a new frame of video data is ready to be displayed.
+// The view takes over the pool reference of a frame from a frame source.
 
 - (void) nextFrameReady:(AOVFrame*)nextFrame {
 #if defined(DEBUG)
@@ -828,8 +920,10 @@ void validate_storage_mode(id<MTLTexture> texture)
   
   //@synchronized (self)
   {
+    // Drop the last ref to the previous frame, a pooled frame goes
+    // back to the frame source pool here.
+    [self.prevFrame releasePooledFrame];
 #if defined(DEBUG)
-    // Should drop last ref to previous frame here
     if (self.prevFrame != nil) {
       self.prevFrame = nil;
     }
@@ -867,6 +961,48 @@ void validate_storage_mode(id<MTLTexture> texture)
 #endif // TARGET_OS_IOS
 }
 
+// Pixel format of the intermediate texture for intermediatePrecision.
+// The resize render samples the intermediate with a linear filter,
+// so 32 bit float is only used when the device can filter it.
+
+- (MTLPixelFormat) intermediatePixelFormat
+{
+  AOVPrecision precision = self.intermediatePrecision;
+  
+  if (precision == AOVPrecisionFloat32) {
+    id<MTLDevice> device = self.metalBT709Decoder.metalRenderContext.device;
+    
+    if (@available(macOS 11.0, iOS 14.0, *)) {
+      if (device.supports32BitFloatFiltering) {
+        return MTLPixelFormatRGBA32Float;
+      }
+    }
+    
+    return MTLPixelFormatRGBA16Float;
+  } else if (precision == AOVPrecisionFloat16) {
+    return MTLPixelFormatRGBA16Float;
+  }
+  
+  if (hasWriteSRGBTextureSupport) {
+    return MTLPixelFormatBGRA8Unorm_sRGB;
+  } else {
+    return MTLPixelFormatRGBA16Float;
+  }
+}
+
+- (int) intermediateBytesPerPixel
+{
+  MTLPixelFormat pixelFormat = [self intermediatePixelFormat];
+  
+  if (pixelFormat == MTLPixelFormatRGBA32Float) {
+    return 16;
+  } else if (pixelFormat == MTLPixelFormatRGBA16Float) {
+    return 8;
+  } else {
+    return 4;
+  }
+}
+
 - (BOOL) makeInternalMetalTexture:(CGSize)_resizeTextureSize
 {
 #if defined(DEBUG)
@@ -880,20 +1016,22 @@ void validate_storage_mode(id<MTLTexture> texture)
     int currentWidth = (int) _resizeTexture.width;
     int currentHeight = (int) _resizeTexture.height;
     
-    if (updatedWidth == currentWidth && updatedHeight == currentHeight) {
-      // Same dimensions, nop
+    if (updatedWidth == currentWidth && updatedHeight == currentHeight &&
+        _resizeTexture.pixelFormat == [self intermediatePixelFormat]) {
+      // Same dimensions and precision, nop
       return TRUE;
     }
+    
+    // Release the texture for the previous size
+    
+    _resizeTexture = nil;
   }
   
-  // FIXME: this method is invoked after the video dimensions have
-  // been loaded and the size of the internal texture is known.
-  // In the case that the view dimensions are exactly the same
-  // as the movie dimensions the internal texture is not allocated
-  // in order to keep memory down for very large textures.
-  
-  // FIXME: do not allocate if the render size exactly matches
-  // the movie size. Allocate if these do not match.
+  // This method is invoked from displayFrame only when a 2 pass
+  // scale is needed or when capture is enabled. An exact size match
+  // renders directly into the view and a much smaller view uses the
+  // fused decode and scale, so large videos in small views do not
+  // hold a full size intermediate texture.
   
   assert(_resizeTextureSize.width != 0);
   assert(_resizeTextureSize.height != 0);
@@ -908,22 +1046,12 @@ void validate_storage_mode(id<MTLTexture> texture)
   assert(device);
   
   // Init render texture that will hold resize render intermediate
-  // results. This is typically sRGB, but Mac OSX may not support it.
+  // results. The pixel format depends on intermediatePrecision.
   
   MTLTextureDescriptor *textureDescriptor = [[MTLTextureDescriptor alloc] init];
   
   textureDescriptor.textureType = MTLTextureType2D;
-  
-#if TARGET_OS_IOS
-  textureDescriptor.pixelFormat = MTLPixelFormatBGRA8Unorm_sRGB;
-#else
-  // MacOSX
-  if (hasWriteSRGBTextureSupport) {
-    textureDescriptor.pixelFormat = MTLPixelFormatBGRA8Unorm_sRGB;
-  } else {
-    textureDescriptor.pixelFormat = MTLPixelFormatRGBA16Float;
-  }
-#endif // TARGET_OS_IOS
+  textureDescriptor.pixelFormat = [self intermediatePixelFormat];
   
   // Set the pixel dimensions of the texture
   textureDescriptor.width = width;
@@ -947,13 +1075,7 @@ void validate_storage_mode(id<MTLTexture> texture)
   
 # if defined(DEBUG)
   {
-    int numBytesPerPixel;
-    
-    if (hasWriteSRGBTextureSupport) {
-      numBytesPerPixel = 4;
-    } else {
-      numBytesPerPixel = 8;
-    }
+    int numBytesPerPixel = [self intermediateBytesPerPixel];
     
     int numBytes = (int) (width * height * numBytesPerPixel);
     
@@ -977,6 +1099,31 @@ void validate_storage_mode(id<MTLTexture> texture)
     NSLog(@"displayTime       %.3f", displayTime);
   }
   
+  // The decode scheduler shares one budget between all views, when
+  // this view is over budget the frame is not pulled and the current
+  // frame stays on screen. The rendition is stepped down when the
+  // player keeps dropping frames.
+  
+  AOVDecodeScheduler *scheduler = [AOVDecodeScheduler sharedScheduler];
+  
+  [self updateSchedulerVisibility];
+  
+  // A view that diverged from a shared decoder is counted on its own
+  
+  [scheduler setPlayer:self.schedulerIndex decodeKey:[self schedulerDecodeKey]];
+  
+  BOOL shouldDecode = [scheduler shouldDecodePlayer:self.schedulerIndex hostTime:hostTime];
+  
+  int level = [scheduler levelForPlayer:self.schedulerIndex];
+  
+  if (level != self.player.renditionDowngrade) {
+    self.player.renditionDowngrade = level;
+  }
+  
+  if (shouldDecode == FALSE) {
+    return;
+  }
+  
   // Pull frame for time from video source
   
   id<AOVFrameSource> frameSource = self.player.frameSource;
@@ -1012,6 +1159,54 @@ void validate_storage_mode(id<MTLTexture> texture)
   }
 };
 
+// Pass the view size, visibility and rendition sizes of the player
+// to the decode scheduler.
+
+- (void) updateScheduler
+{
+  if (self.schedulerIndex == -1) {
+    return;
+  }
+  
+  AOVDecodeScheduler *scheduler = [AOVDecodeScheduler sharedScheduler];
+  
+  NSArray *levelSizes = [self.player renditionLevelSizes];
+  
+  if (levelSizes.count > 0) {
+    [scheduler setPlayer:self.schedulerIndex levelSizes:levelSizes];
+  }
+  
+  [self updateSchedulerVisibility];
+}
+
+// Views that share a decoder through AOVFrameSourceShared pass the
+// same key and are one player of the decode scheduler.
+
+- (nullable id) schedulerDecodeKey
+{
+  NSObject *frameSource = (NSObject *) self.player.frameSource;
+  
+  if ([frameSource isKindOfClass:AOVFrameSourceShared.class]) {
+    return ((AOVFrameSourceShared *) frameSource).decodeKey;
+  }
+  
+  return nil;
+}
+
+- (void) updateSchedulerVisibility
+{
+  if (self.schedulerIndex == -1) {
+    return;
+  }
+  
+  BOOL isVisible = (self.window != nil) && (self.isHidden == FALSE);
+  
+  [[AOVDecodeScheduler sharedScheduler] setPlayer:self.schedulerIndex
+                                        viewWidth:viewportWidth
+                                       viewHeight:viewportHeight
+                                        isVisible:isVisible];
+}
+
 #pragma mark - MTKViewDelegate
 
 - (void)mtkView:(nonnull MTKView *)view drawableSizeWillChange:(CGSize)size
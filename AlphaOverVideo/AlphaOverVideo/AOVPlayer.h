@@ -74,6 +74,64 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (AOVPlayer* _Nullable) playerWithLoopedClips:(NSArray* _Nonnull)assetURLs;
 
+// Create looped player that shares decoding with every other shared
+// player of the same clip and time offset. The clip is decoded once
+// and each decoded frame is shown in all the views, a view whose
+// playhead diverges continues with a decoder of its own. The time
+// offset in seconds selects where in the clip the player starts.
+
++ (AOVPlayer* _Nullable) playerWithSharedLoopedClip:(id _Nonnull)assetURLOrPair;
+
++ (AOVPlayer* _Nullable) playerWithSharedLoopedClip:(id _Nonnull)assetURLOrPair
+                                         timeOffset:(CFTimeInterval)timeOffset;
+
+// Create player from a rendition manifest, a text file that lists
+// the same clip encoded at several sizes, see rendition_manifest.h.
+// The smallest rendition that covers viewPixelSize is played, pass
+// the drawableSize of the view or CGSizeZero to play the largest.
+// Paths in the manifest are relative to the manifest file.
+
++ (AOVPlayer* _Nullable) playerWithRenditions:(NSURL* _Nonnull)manifestURL
+                                viewPixelSize:(CGSize)viewPixelSize;
+
+// Create looped player from a rendition manifest. When the view
+// size changes the player switches to the rendition that fits the
+// new size at the next loop boundary.
+
++ (AOVPlayer* _Nullable) playerWithLoopedRenditions:(NSURL* _Nonnull)manifestURL
+                                      viewPixelSize:(CGSize)viewPixelSize;
+
+// Index of the selected rendition in the manifest, -1 when the
+// player was not created from a rendition manifest.
+
+@property (nonatomic, readonly) int renditionIndex;
+
+// Renditions with a bitrate above this number of kbps are not
+// selected unless every rendition is above it. Defaults to 0,
+// which means no limit. Takes effect at the next view size change.
+
+@property (nonatomic, assign) int maxRenditionBitrate;
+
+// Invoked by AOVMTKView when the size of the view in pixels changes.
+// A player created from a rendition manifest selects the rendition
+// that fits the new size, playback switches to it at the next clip
+// or loop boundary.
+
+- (void) viewPixelSizeChanged:(CGSize)viewPixelSize;
+
+// Number of steps down from the rendition that fits the view, each
+// step selects the next smaller rendition in the manifest. Set by
+// AOVMTKView when the decode scheduler moves the player to another
+// level, see AOVDecodeScheduler.h. Defaults to 0.
+
+@property (nonatomic, assign) int renditionDowngrade;
+
+// Pixel sizes as NSValue CGSize of the rendition that fits the view
+// followed by each smaller rendition. Empty when the player was not
+// created from a rendition manifest.
+
+- (NSArray<NSValue*>*) renditionLevelSizes;
+
 // Create player with a single asset, at the
 // end of the clip playback is stopped.
 
@@ -13,6 +13,10 @@
 #import "AOVFrameSource.h"
 #import "AOVFrameSourceAlphaVideo.h"
 #import "AOVFrameSourceVideo.h"
+#import "AOVFrameSourceShared.h"
+
+#import "mp4_probe.h"
+#import "rendition_manifest.h"
 
 // Private API
 
@@ -28,10 +32,58 @@
 
 @property (nonatomic, retain) id<AOVFrameSource> frameSource;
 
+@property (nonatomic, assign) int renditionIndex;
+
+// RenditionManifest parsed from the manifest file
+
+@property (nonatomic, retain) NSData *renditionManifestData;
+@property (nonatomic, copy) NSURL *renditionBaseURL;
+@property (nonatomic, assign) BOOL renditionLooped;
+
+// Most recent view size, renditions are selected for this size
+
+@property (nonatomic, assign) CGSize renditionViewPixelSize;
+
 @end
 
 @implementation AOVPlayer
 
+- (nullable instancetype) init
+{
+  if (self = [super init]) {
+    self.renditionIndex = -1;
+  }
+  
+  return self;
+}
+
+// Read the moov header of a local clip without loading an AVAsset.
+// Returns FALSE when the file cannot be parsed or has no video track.
+// Remote URLs cannot be probed and are reported as valid.
+
++ (BOOL) probeClip:(NSURL*)url result:(Mp4ProbeResult*)resultPtr
+{
+  memset(resultPtr, 0, sizeof(Mp4ProbeResult));
+  
+  if (url.isFileURL == FALSE) {
+    return TRUE;
+  }
+  
+  int err = mp4_probe_file(url.path.fileSystemRepresentation, resultPtr);
+  
+  if (err != 0) {
+    NSLog(@"clip header could not be parsed (error %d) for \"%@\"", err, url.path);
+    return FALSE;
+  }
+  
+  if (resultPtr->width <= 0 || resultPtr->height <= 0 || resultPtr->numFrames == 0) {
+    NSLog(@"clip has an empty video track \"%@\"", url.path);
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
 // Given an array of clips, either NSURL objects or pairs of
 // NSURL objects in a NSArray, validate the input and return
 // an array that represents the clips to loop. Return nil
@@ -53,6 +105,10 @@
   
   for ( id obj in assetURLs ) {
     if ([obj isKindOfClass:NSURL.class]) {
+      Mp4ProbeResult probe;
+      if ([self probeClip:(NSURL*)obj result:&probe] == FALSE) {
+        return FALSE;
+      }
       if (subCount == -1) {
         subCount = 1;
       } else if (subCount == 1) {
@@ -71,6 +127,19 @@
       if (subCount == -1) {
         subCount = 2;
       }
+      
+      // RGB and alpha clips must have the same dimensions
+      
+      Mp4ProbeResult rgbProbe;
+      Mp4ProbeResult alphaProbe;
+      if ([self probeClip:pair[0] result:&rgbProbe] == FALSE ||
+          [self probeClip:pair[1] result:&alphaProbe] == FALSE) {
+        return FALSE;
+      }
+      if (rgbProbe.width != alphaProbe.width || rgbProbe.height != alphaProbe.height) {
+        NSLog(@"RGB clip %d x %d does not match alpha clip %d x %d", rgbProbe.width, rgbProbe.height, alphaProbe.width, alphaProbe.height);
+        return FALSE;
+      }
     } else {
       NSAssert(FALSE, @"unknown type for assetURLs element \"%@\"", obj);
       return FALSE;
@@ -109,22 +178,16 @@
   return [self playerWithLoopedClipsPrivate:assetURLs looped:TRUE loopMaxCount:0];
 }
 
-+ (AOVPlayer*) playerWithLoopedClipsPrivate:(NSArray*)assetURLs
-                                     looped:(BOOL)looped
-                               loopMaxCount:(int)loopMaxCount
+// Array of clips passed to the frame source, this is the
+// same as assetURLs except for the case of one looped clip.
+
++ (NSArray*) queueURLs:(NSArray*)assetURLs
+                looped:(BOOL)looped
 {
-  int subCount;
-  BOOL valid = [self validateClips:assetURLs clipSubCountPtr:&subCount];
-  if (!valid) {
-    return nil;
-  }
-  
   int num = (int) assetURLs.count;
   
   NSMutableArray *mURLs = [NSMutableArray array];
   
-  // Note that (num == 0) is handled above
-  
   if (num == 1 && looped) {
     // One clip will be initialized as using 2 copies of the url
     id url = assetURLs[0];
@@ -135,15 +198,17 @@
     [mURLs addObjectsFromArray:assetURLs];
   }
   
-  // If subCount is 1 then RGB clips, else RGB+A
-  
-  AOVPlayer *player = [[AOVPlayer alloc] init];
-  
-  player.hasAlphaChannel = (subCount == 2);
-  
+  return mURLs;
+}
+
+// Create and load a frame source for the queued clip URLs
+
++ (id<AOVFrameSource>) frameSourceForURLs:(NSArray*)mURLs
+                          hasAlphaChannel:(BOOL)hasAlphaChannel
+{
   id<AOVFrameSource> frameSource = nil;
   
-  if (player.hasAlphaChannel) {
+  if (hasAlphaChannel) {
     // RGBA 32BPP alpha video
     AOVFrameSourceAlphaVideo *frameSourceAlphaVideo = [[AOVFrameSourceAlphaVideo alloc] init];
     frameSource = frameSourceAlphaVideo;
@@ -175,6 +240,35 @@
     }
   }
   
+  return frameSource;
+}
+
++ (AOVPlayer*) playerWithLoopedClipsPrivate:(NSArray*)assetURLs
+                                     looped:(BOOL)looped
+                               loopMaxCount:(int)loopMaxCount
+{
+  int subCount;
+  BOOL valid = [self validateClips:assetURLs clipSubCountPtr:&subCount];
+  if (!valid) {
+    return nil;
+  }
+  
+  // Note that (num == 0) is handled above
+  
+  NSArray *mURLs = [self queueURLs:assetURLs looped:looped];
+  
+  // If subCount is 1 then RGB clips, else RGB+A
+  
+  AOVPlayer *player = [[AOVPlayer alloc] init];
+  
+  player.hasAlphaChannel = (subCount == 2);
+  
+  id<AOVFrameSource> frameSource = [self frameSourceForURLs:mURLs hasAlphaChannel:player.hasAlphaChannel];
+  
+  if (frameSource == nil) {
+    return nil;
+  }
+  
   frameSource.loopMaxCount = loopMaxCount;
   
   // Define source for frames in terms of generic interface ref
@@ -184,6 +278,229 @@
   return player;
 }
 
++ (AOVPlayer*) playerWithSharedLoopedClip:(id)assetURLOrPair
+{
+  return [self playerWithSharedLoopedClip:assetURLOrPair timeOffset:0.0];
+}
+
++ (AOVPlayer*) playerWithSharedLoopedClip:(id)assetURLOrPair
+                               timeOffset:(CFTimeInterval)timeOffset
+{
+  int subCount;
+  BOOL valid = [self validateClips:@[assetURLOrPair] clipSubCountPtr:&subCount];
+  if (!valid) {
+    return nil;
+  }
+  
+  NSArray *mURLs = [self queueURLs:@[assetURLOrPair] looped:TRUE];
+  
+  AOVPlayer *player = [[AOVPlayer alloc] init];
+  
+  player.hasAlphaChannel = (subCount == 2);
+  
+  BOOL hasAlphaChannel = player.hasAlphaChannel;
+  
+  // Only invoked when no other view plays the clip at this offset,
+  // or when the playhead of this view diverges.
+  
+  id<AOVFrameSource> (^factory)(void) = ^id<AOVFrameSource>{
+    return [AOVPlayer frameSourceForURLs:mURLs hasAlphaChannel:hasAlphaChannel];
+  };
+  
+  AOVFrameSourceShared *frameSourceShared = [[AOVFrameSourceShared alloc] initWithClipURLs:mURLs
+                                                                                timeOffset:timeOffset
+                                                                                   factory:factory];
+  
+  if (frameSourceShared == nil) {
+    return nil;
+  }
+  
+  player.frameSource = frameSourceShared;
+  
+  return player;
+}
+
+// Map a path in a rendition manifest to a URL, relative paths are
+// resolved against the directory that contains the manifest.
+
++ (NSURL*) urlForRenditionPath:(const char*)path
+                       baseURL:(NSURL*)baseURL
+{
+  NSString *str = [NSString stringWithUTF8String:path];
+  
+  if ([str rangeOfString:@"://"].location != NSNotFound) {
+    return [NSURL URLWithString:str];
+  } else if ([str isAbsolutePath]) {
+    return [NSURL fileURLWithPath:str];
+  } else {
+    return [baseURL URLByAppendingPathComponent:str];
+  }
+}
+
+// Clip argument for a rendition, either a NSURL or a pair of NSURLs
+
++ (id) clipForRendition:(const RenditionEntry*)entry
+                baseURL:(NSURL*)baseURL
+{
+  NSURL *rgbURL = [self urlForRenditionPath:entry->rgbPath baseURL:baseURL];
+  
+  if (rgbURL == nil || entry->alphaPath[0] == '\0') {
+    return rgbURL;
+  }
+  
+  NSURL *alphaURL = [self urlForRenditionPath:entry->alphaPath baseURL:baseURL];
+  
+  if (alphaURL == nil) {
+    return nil;
+  }
+  
+  return @[rgbURL, alphaURL];
+}
+
++ (AOVPlayer*) playerWithRenditions:(NSURL*)manifestURL
+                      viewPixelSize:(CGSize)viewPixelSize
+{
+  return [self playerWithRenditionsPrivate:manifestURL looped:FALSE viewPixelSize:viewPixelSize];
+}
+
++ (AOVPlayer*) playerWithLoopedRenditions:(NSURL*)manifestURL
+                            viewPixelSize:(CGSize)viewPixelSize
+{
+  return [self playerWithRenditionsPrivate:manifestURL looped:TRUE viewPixelSize:viewPixelSize];
+}
+
++ (AOVPlayer*) playerWithRenditionsPrivate:(NSURL*)manifestURL
+                                    looped:(BOOL)looped
+                             viewPixelSize:(CGSize)viewPixelSize
+{
+  NSMutableData *manifestData = [NSMutableData dataWithLength:sizeof(RenditionManifest)];
+  RenditionManifest *manifest = (RenditionManifest *) manifestData.mutableBytes;
+  
+  int err = rendition_manifest_read_file(manifestURL.path.fileSystemRepresentation, manifest);
+  
+  if (err != 0) {
+    NSLog(@"rendition manifest error %d at line %d in \"%@\"", err, manifest->errorLine, manifestURL.path);
+    return nil;
+  }
+  
+  NSURL *baseURL = [manifestURL URLByDeletingLastPathComponent];
+  
+  int index = rendition_manifest_select(manifest, (int) viewPixelSize.width, (int) viewPixelSize.height, 0);
+  
+  id clip = [self clipForRendition:&manifest->renditions[index] baseURL:baseURL];
+  
+  if (clip == nil) {
+    return nil;
+  }
+  
+  AOVPlayer *player = [self playerWithLoopedClipsPrivate:@[clip] looped:looped loopMaxCount:(looped ? 0 : 1)];
+  
+  if (player == nil) {
+    return nil;
+  }
+  
+  player.renditionManifestData = manifestData;
+  player.renditionBaseURL = baseURL;
+  player.renditionLooped = looped;
+  player.renditionIndex = index;
+  player.renditionViewPixelSize = viewPixelSize;
+  
+  return player;
+}
+
+// Fill levels with the rendition that fits the view followed by
+// each smaller rendition, returns the number of levels.
+
+- (int) renditionLevels:(int*)levels maxLevels:(int)maxLevels
+{
+  const RenditionManifest *manifest = (const RenditionManifest *) self.renditionManifestData.bytes;
+  
+  CGSize viewPixelSize = self.renditionViewPixelSize;
+  
+  int selected = rendition_manifest_select(manifest, (int) viewPixelSize.width, (int) viewPixelSize.height, self.maxRenditionBitrate);
+  
+  return rendition_manifest_levels(manifest, selected, levels, maxLevels);
+}
+
+- (NSArray<NSValue*>*) renditionLevelSizes
+{
+  NSMutableArray *mArr = [NSMutableArray array];
+  
+  if (self.renditionManifestData == nil) {
+    return mArr;
+  }
+  
+  const RenditionManifest *manifest = (const RenditionManifest *) self.renditionManifestData.bytes;
+  
+  int levels[RM_MAX_RENDITIONS];
+  int numLevels = [self renditionLevels:levels maxLevels:RM_MAX_RENDITIONS];
+  
+  for (int i = 0; i < numLevels; i++) {
+    const RenditionEntry *entry = &manifest->renditions[levels[i]];
+    [mArr addObject:[NSValue valueWithCGSize:CGSizeMake(entry->width, entry->height)]];
+  }
+  
+  return mArr;
+}
+
+- (void) setRenditionDowngrade:(int)renditionDowngrade
+{
+  if (renditionDowngrade < 0) {
+    renditionDowngrade = 0;
+  }
+  
+  if (renditionDowngrade == _renditionDowngrade) {
+    return;
+  }
+  
+  _renditionDowngrade = renditionDowngrade;
+  
+  [self viewPixelSizeChanged:self.renditionViewPixelSize];
+}
+
+- (void) viewPixelSizeChanged:(CGSize)viewPixelSize
+{
+  if (self.renditionManifestData == nil) {
+    return;
+  }
+  
+  self.renditionViewPixelSize = viewPixelSize;
+  
+  const RenditionManifest *manifest = (const RenditionManifest *) self.renditionManifestData.bytes;
+  
+  int levels[RM_MAX_RENDITIONS];
+  int numLevels = [self renditionLevels:levels maxLevels:RM_MAX_RENDITIONS];
+  
+  int index = levels[MIN(self.renditionDowngrade, numLevels - 1)];
+  
+  if (index == self.renditionIndex) {
+    return;
+  }
+  
+  // A clip that cannot be probed is not switched to, the current
+  // rendition keeps playing.
+  
+  id clip = [self.class clipForRendition:&manifest->renditions[index] baseURL:self.renditionBaseURL];
+  
+  int subCount;
+  
+  if (clip == nil || [self.class validateClips:@[clip] clipSubCountPtr:&subCount] == FALSE) {
+    return;
+  }
+  
+#if defined(DEBUG)
+  NSLog(@"view %d x %d switches to rendition %d x %d at next loop",
+        (int) viewPixelSize.width, (int) viewPixelSize.height,
+        manifest->renditions[index].width, manifest->renditions[index].height);
+#endif // DEBUG
+  
+  NSArray *mURLs = [self.class queueURLs:@[clip] looped:self.renditionLooped];
+  
+  [self.frameSource replaceClipURLs:mURLs];
+  
+  self.renditionIndex = index;
+}
+
 - (void) dealloc
 {
   return;
@@ -85,6 +85,10 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (void) seekToTimeZero;
 
+// Frame accurate seek to the exact presentation time of a frame
+
+- (void) seekToFrameTime:(CMTime)frameTime;
+
 // Kick of play operation where the zero time implicitly
 // gets synced to the indicated host time. This means
 // that 2 different calls to play on two different
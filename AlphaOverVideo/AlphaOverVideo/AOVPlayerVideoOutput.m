@@ -621,4 +621,11 @@ static void *AVPlayerItemStatusContext = &AVPlayerItemStatusContext;
   }];
 }
 
+- (void) seekToFrameTime:(CMTime)frameTime
+{
+  [self.player seekToTime:frameTime toleranceBefore:kCMTimeZero toleranceAfter:kCMTimeZero completionHandler:^(BOOL finished){
+    // nop
+  }];
+}
+
 @end
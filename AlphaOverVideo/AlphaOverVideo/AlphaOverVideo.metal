@@ -436,3 +436,164 @@ sRGBToLinearSRGBFragmentAlpha(RasterizerData in [[stage_in]],
   pixel.a = A;
   return pixel;
 }
+
+// Fused decode and resample into the view. Each output pixel is a
+// weighted sum of the decoded input pixels under the filter, tap
+// positions and weights are computed on the CPU with
+// linear_scale_filter_init(). Y and CbCr texels are read directly,
+// so no full size intermediate texture is written or read back.
+// See decode_scaler.h for the CPU reference.
+
+#define DECODE_SCALE_GAMMA_APPLE 0
+#define DECODE_SCALE_GAMMA_SRGB 1
+#define DECODE_SCALE_GAMMA_LINEAR 2
+
+static inline
+float4 BT709_decodeScale(const uint2 outCoord,
+                         const int gamma,
+                         const bool hasAlpha,
+                         texture2d<half, access::read> inYTexture,
+                         texture2d<half, access::read> inUVTexture,
+                         texture2d<half, access::read> inATexture,
+                         constant AAPLDecodeScaleParams & params,
+                         constant int *hStarts,
+                         constant float *hWeights,
+                         constant int *vStarts,
+                         constant float *vWeights)
+{
+  const int hTaps = params.hTaps;
+  const int vTaps = params.vTaps;
+  
+  const uint x0 = hStarts[outCoord.x];
+  const uint y0 = vStarts[outCoord.y];
+  
+  constant float *hRowWeights = hWeights + (outCoord.x * hTaps);
+  constant float *vRowWeights = vWeights + (outCoord.y * vTaps);
+  
+  float4 sum = float4(0.0f);
+  
+  for (int ky = 0; ky < vTaps; ky++) {
+    const float wy = vRowWeights[ky];
+    
+    if (wy == 0.0f) {
+      continue;
+    }
+    
+    float4 rowSum = float4(0.0f);
+    
+    for (int kx = 0; kx < hTaps; kx++) {
+      const float wx = hRowWeights[kx];
+      
+      if (wx == 0.0f) {
+        continue;
+      }
+      
+      const uint2 coord = uint2(x0 + kx, y0 + ky);
+      
+      float Y = float(inYTexture.read(coord).r);
+      half2 uvSamples = inUVTexture.read(coord / 2).rg;
+      
+      float4 pixel = BT709_decode(Y, float(uvSamples[0]), float(uvSamples[1]));
+      
+      if (gamma == DECODE_SCALE_GAMMA_APPLE) {
+        pixel = Apple196_gamma_decode(pixel);
+      } else if (gamma == DECODE_SCALE_GAMMA_SRGB) {
+        pixel = sRGB_gamma_decode(pixel);
+      }
+      
+      // Alpha video stores premultiplied color, color and alpha are
+      // summed as is, the same as the 2 pass scale of the decoded
+      // texture.
+      
+      if (hasAlpha) {
+        pixel.a = BT709_decodeAlpha(float(inATexture.read(coord).r));
+      }
+      
+      rowSum += pixel * wx;
+    }
+    
+    sum += rowSum * wy;
+  }
+  
+  // Negative lobes can overshoot at hard edges, color is clamped
+  // to [0, alpha] so that the output is valid premultiplied color.
+  
+  if (hasAlpha) {
+    sum.a = saturate(sum.a);
+    sum.rgb = clamp(sum.rgb, float3(0.0f), float3(sum.a));
+  } else {
+    sum = float4(saturate(sum.rgb), 1.0f);
+  }
+  
+  return sum;
+}
+
+// Fused decode and resample with Apple 196 gamma
+
+fragment float4
+BT709ToLinearSRGBScaleFragment(RasterizerData in [[stage_in]],
+                               texture2d<half, access::read>  inYTexture  [[texture(AAPLTextureIndexYPlane)]],
+                               texture2d<half, access::read>  inUVTexture [[texture(AAPLTextureIndexCbCrPlane)]],
+                               constant AAPLDecodeScaleParams & params    [[buffer(AAPLDecodeScaleIndexParams)]],
+                               constant int *hStarts                      [[buffer(AAPLDecodeScaleIndexHStarts)]],
+                               constant float *hWeights                   [[buffer(AAPLDecodeScaleIndexHWeights)]],
+                               constant int *vStarts                      [[buffer(AAPLDecodeScaleIndexVStarts)]],
+                               constant float *vWeights                   [[buffer(AAPLDecodeScaleIndexVWeights)]])
+{
+  // The Y texture is passed for alpha but is not read
+  const uint2 outCoord = uint2(in.clipSpacePosition.xy);
+  return BT709_decodeScale(outCoord, DECODE_SCALE_GAMMA_APPLE, false, inYTexture, inUVTexture, inYTexture,
+                           params, hStarts, hWeights, vStarts, vWeights);
+}
+
+// Fused decode and resample with sRGB gamma
+
+fragment float4
+sRGBToLinearSRGBScaleFragment(RasterizerData in [[stage_in]],
+                              texture2d<half, access::read>  inYTexture  [[texture(AAPLTextureIndexYPlane)]],
+                              texture2d<half, access::read>  inUVTexture [[texture(AAPLTextureIndexCbCrPlane)]],
+                              constant AAPLDecodeScaleParams & params    [[buffer(AAPLDecodeScaleIndexParams)]],
+                              constant int *hStarts                      [[buffer(AAPLDecodeScaleIndexHStarts)]],
+                              constant float *hWeights                   [[buffer(AAPLDecodeScaleIndexHWeights)]],
+                              constant int *vStarts                      [[buffer(AAPLDecodeScaleIndexVStarts)]],
+                              constant float *vWeights                   [[buffer(AAPLDecodeScaleIndexVWeights)]])
+{
+  const uint2 outCoord = uint2(in.clipSpacePosition.xy);
+  return BT709_decodeScale(outCoord, DECODE_SCALE_GAMMA_SRGB, false, inYTexture, inUVTexture, inYTexture,
+                           params, hStarts, hWeights, vStarts, vWeights);
+}
+
+// Fused decode and resample without a gamma adjustment
+
+fragment float4
+LinearToLinearSRGBScaleFragment(RasterizerData in [[stage_in]],
+                                texture2d<half, access::read>  inYTexture  [[texture(AAPLTextureIndexYPlane)]],
+                                texture2d<half, access::read>  inUVTexture [[texture(AAPLTextureIndexCbCrPlane)]],
+                                constant AAPLDecodeScaleParams & params    [[buffer(AAPLDecodeScaleIndexParams)]],
+                                constant int *hStarts                      [[buffer(AAPLDecodeScaleIndexHStarts)]],
+                                constant float *hWeights                   [[buffer(AAPLDecodeScaleIndexHWeights)]],
+                                constant int *vStarts                      [[buffer(AAPLDecodeScaleIndexVStarts)]],
+                                constant float *vWeights                   [[buffer(AAPLDecodeScaleIndexVWeights)]])
+{
+  const uint2 outCoord = uint2(in.clipSpacePosition.xy);
+  return BT709_decodeScale(outCoord, DECODE_SCALE_GAMMA_LINEAR, false, inYTexture, inUVTexture, inYTexture,
+                           params, hStarts, hWeights, vStarts, vWeights);
+}
+
+// Fused decode and resample with sRGB gamma and an alpha channel
+
+fragment float4
+sRGBToLinearSRGBScaleFragmentAlpha(RasterizerData in [[stage_in]],
+                                   texture2d<half, access::read>  inYTexture  [[texture(AAPLTextureIndexYPlane)]],
+                                   texture2d<half, access::read>  inUVTexture [[texture(AAPLTextureIndexCbCrPlane)]],
+                                   texture2d<half, access::read>  inATexture  [[texture(AAPLTextureIndexAlphaPlane)]],
+                                   constant AAPLDecodeScaleParams & params    [[buffer(AAPLDecodeScaleIndexParams)]],
+                                   constant int *hStarts                      [[buffer(AAPLDecodeScaleIndexHStarts)]],
+                                   constant float *hWeights                   [[buffer(AAPLDecodeScaleIndexHWeights)]],
+                                   constant int *vStarts                      [[buffer(AAPLDecodeScaleIndexVStarts)]],
+                                   constant float *vWeights                   [[buffer(AAPLDecodeScaleIndexVWeights)]])
+{
+  const uint2 outCoord = uint2(in.clipSpacePosition.xy);
+  return BT709_decodeScale(outCoord, DECODE_SCALE_GAMMA_SRGB, true, inYTexture, inUVTexture, inATexture,
+                           params, hStarts, hWeights, vStarts, vWeights);
+}
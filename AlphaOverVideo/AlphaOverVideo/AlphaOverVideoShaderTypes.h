@@ -31,6 +31,24 @@ typedef enum
   AAPLTextureIndexAlphaPlane = 2,
 } AAPLTextureYCbCrIndex;
 
+// Fragment buffer index values for the fused decode and scale shaders,
+//   taps for output column x start at hStarts[x] and use the hTaps
+//   weights at hWeights[x * hTaps], same for rows.
+typedef enum
+{
+  AAPLDecodeScaleIndexParams = 0,
+  AAPLDecodeScaleIndexHStarts = 1,
+  AAPLDecodeScaleIndexHWeights = 2,
+  AAPLDecodeScaleIndexVStarts = 3,
+  AAPLDecodeScaleIndexVWeights = 4,
+} AAPLDecodeScaleIndex;
+
+typedef struct
+{
+  int hTaps;
+  int vTaps;
+} AAPLDecodeScaleParams;
+
 //  This structure defines the layout of each vertex in the array of vertices set as an input to our
 //    Metal vertex shader.  Since this header is shared between our .metal shader and C code,
 //    we can be sure that the layout of the vertex array in the code matches the layout that
@@ -17,6 +17,8 @@
 
 #import "BT709.h"
 
+#import "encode_stats.h"
+
 @import Accelerate;
 
 @class CGFrameBuffer;
@@ -24,7 +26,11 @@
 typedef enum {
   BGRAToBT709ConverterSoftware = 0,
   BGRAToBT709ConverterVImage = 1,
-  BGRAToBT709ConverterMetal = 2
+  BGRAToBT709ConverterMetal = 2,
+  // Same output as BGRAToBT709ConverterSoftware via a 3D table, see color_lut.h
+  BGRAToBT709ConverterLut = 3,
+  // Compact interpolated table, output may differ by 1
+  BGRAToBT709ConverterLutTetrahedral = 4
 } BGRAToBT709ConverterTypeEnum;
 
 @interface BGRAToBT709Converter : NSObject
@@ -79,6 +85,14 @@ typedef enum {
                          inputGamma:(BT709Gamma)inputGamma
                         outputGamma:(BT709Gamma)outputGamma;
 
+// Same as above, render and convert time are recorded in stats when not NULL
+
++ (BOOL) convertIntoCoreVideoBuffer:(CGImageRef)inputImageRef
+                      cvPixelBuffer:(CVPixelBufferRef)cvPixelBuffer
+                         inputGamma:(BT709Gamma)inputGamma
+                        outputGamma:(BT709Gamma)outputGamma
+                              stats:(EncodeStats*)stats;
+
 // Convert the contents of a CoreVideo pixel buffer and write the results
 // into the indicated destination vImage buffer.
 
@@ -117,6 +131,13 @@ typedef enum {
                                    isLinear:(BOOL)isLinear
                                 asSRGBGamma:(BOOL)asSRGBGamma;
 
+// Same as above, render and convert time are recorded in stats when not NULL
+
++ (CVPixelBufferRef) createYCbCrFromCGImage:(CGImageRef)inputImageRef
+                                   isLinear:(BOOL)isLinear
+                                asSRGBGamma:(BOOL)asSRGBGamma
+                                      stats:(EncodeStats*)stats;
+
 // Copy YCbCr data stored in BGRA pixels into Y CbCr planes in CoreVideo
 // pixel buffer.
 
@@ -136,4 +157,8 @@ typedef enum {
 
 + (CGImageRef) unpremultiply:(CGImageRef)inputImageRef;
 
+// Unpremultiply with vImage, the output is identical to unpremultiply:
+
++ (CGImageRef) unpremultiplyWithVImage:(CGImageRef)inputImageRef;
+
 @end
@@ -14,6 +14,10 @@
 
 #import "CVPixelBufferUtils.h"
 
+#import "premultiply.h"
+
+#import "color_lut.h"
+
 @import Accelerate;
 @import CoreImage;
 
@@ -49,6 +53,9 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
     return [self.class convertSoftware:inBGRAPixels outBT709Pixels:outBT709Pixels width:width height:height];
   } else if (type == BGRAToBT709ConverterVImage) @autoreleasepool {
     return [self.class convertVimage:inBGRAPixels outBT709Pixels:outBT709Pixels width:width height:height];
+  } else if (type == BGRAToBT709ConverterLut || type == BGRAToBT709ConverterLutTetrahedral) {
+    ColorLutKind kind = (type == BGRAToBT709ConverterLut) ? ColorLutKindFullCube : ColorLutKindTetrahedral;
+    return [self.class convertLut:inBGRAPixels outBT709Pixels:outBT709Pixels width:width height:height kind:kind];
   } else {
     return FALSE;
   }
@@ -73,7 +80,9 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
     return FALSE;
   }
     
-  if (type == BGRAToBT709ConverterSoftware) @autoreleasepool {
+  if (type == BGRAToBT709ConverterSoftware ||
+      type == BGRAToBT709ConverterLut ||
+      type == BGRAToBT709ConverterLutTetrahedral) @autoreleasepool {
     [self.class unconvertSoftware:inBT709Pixels outBGRAPixels:outBGRAPixels width:width height:height];
   } else if (type == BGRAToBT709ConverterVImage) @autoreleasepool {
     return [self.class unconvertVimage:inBT709Pixels outBGRAPixels:outBGRAPixels width:width height:height];
@@ -143,6 +152,39 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
   return TRUE;
 }
 
+// Encode with the Apple gamma table that matches convertSoftware, the
+// table is mapped from the caches directory or built on first use. A
+// cached table whose checksum does not match the encode function in
+// this build is rebuilt, see color_lut_checksum().
+
++ (BOOL) convertLut:(uint32_t*)inBGRAPixels
+     outBT709Pixels:(uint32_t*)outBT709Pixels
+              width:(int)width
+             height:(int)height
+               kind:(ColorLutKind)kind
+{
+  static ColorLut luts[2];
+  static dispatch_once_t onceTokens[2];
+
+  const int lutIndex = (kind == ColorLutKindFullCube) ? 0 : 1;
+  __block int err = 0;
+
+  dispatch_once(&onceTokens[lutIndex], ^{
+    NSString *cachesDir = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+    NSString *filename = [NSString stringWithFormat:@"AOVColorLut_apple_%d.lut", (int)kind];
+    NSString *path = [cachesDir stringByAppendingPathComponent:filename];
+    err = color_lut_load([path fileSystemRepresentation], ColorLutEncodeApple, kind, &luts[lutIndex]);
+  });
+
+  if (err != 0 || luts[lutIndex].bytes == NULL) {
+    return FALSE;
+  }
+
+  color_lut_convert_row(&luts[lutIndex], inBGRAPixels, outBT709Pixels, width * height);
+
+  return TRUE;
+}
+
 + (BOOL) unconvertSoftware:(uint32_t*)inBT709Pixels
              outBGRAPixels:(uint32_t*)outBGRAPixels
                      width:(int)width
@@ -532,6 +574,18 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
                          inputGamma:(BT709Gamma)inputGamma
                          outputGamma:(BT709Gamma)outputGamma
 {
+  return [self convertIntoCoreVideoBuffer:inputImageRef cvPixelBuffer:cvPixelBuffer inputGamma:inputGamma outputGamma:outputGamma stats:NULL];
+}
+
++ (BOOL) convertIntoCoreVideoBuffer:(CGImageRef)inputImageRef
+                      cvPixelBuffer:(CVPixelBufferRef)cvPixelBuffer
+                         inputGamma:(BT709Gamma)inputGamma
+                         outputGamma:(BT709Gamma)outputGamma
+                              stats:(EncodeStats*)stats
+{
+  EncodeStatsMark mark;
+  encode_stats_begin(stats, &mark);
+  
   int width = (int) CGImageGetWidth(inputImageRef);
   int height = (int) CGImageGetHeight(inputImageRef);
   
@@ -553,6 +607,8 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
   
   [frameBuffer renderCGImage:inputImageRef];
   
+  encode_stats_end(stats, EncodeStageRender, &mark, 0, 0);
+  
   uint32_t *pixelsPtr = (uint32_t *) frameBuffer.pixels;
   
   //CVPixelBufferRef dst = [self createCoreVideoYCbCrBuffer:CGSizeMake(width, height)];
@@ -562,8 +618,12 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
     //*pixelsPtr++ = pixel;
   //}
   
+  encode_stats_begin(stats, &mark);
+  
   cvpbu_ycbcr_subsample(pixelsPtr, width, height, cvPixelBuffer, inputGamma, outputGamma);
   
+  encode_stats_end(stats, EncodeStageConvert, &mark, 0, 0);
+  
   return TRUE;
   
   /*
@@ -873,6 +933,14 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
 + (CVPixelBufferRef) createYCbCrFromCGImage:(CGImageRef)inputImageRef
                                    isLinear:(BOOL)isLinear
                                    asSRGBGamma:(BOOL)asSRGBGamma
+{
+  return [self createYCbCrFromCGImage:inputImageRef isLinear:isLinear asSRGBGamma:asSRGBGamma stats:NULL];
+}
+
++ (CVPixelBufferRef) createYCbCrFromCGImage:(CGImageRef)inputImageRef
+                                   isLinear:(BOOL)isLinear
+                                   asSRGBGamma:(BOOL)asSRGBGamma
+                                      stats:(EncodeStats*)stats
 {
   if (isLinear) {
     assert(asSRGBGamma == FALSE);
@@ -921,17 +989,17 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
     inputGamma = BT709GammaLinear;
     outputGamma = BT709GammaLinear;
     
-    worked = [self convertIntoCoreVideoBuffer:inputImageRef cvPixelBuffer:cvPixelBuffer inputGamma:inputGamma outputGamma:outputGamma];
+    worked = [self convertIntoCoreVideoBuffer:inputImageRef cvPixelBuffer:cvPixelBuffer inputGamma:inputGamma outputGamma:outputGamma stats:stats];
   } else if (asSRGBGamma) {
     inputGamma = BT709GammaSrgb;
     outputGamma = BT709GammaSrgb;
     
-    worked = [self convertIntoCoreVideoBuffer:inputImageRef cvPixelBuffer:cvPixelBuffer inputGamma:inputGamma outputGamma:outputGamma];
+    worked = [self convertIntoCoreVideoBuffer:inputImageRef cvPixelBuffer:cvPixelBuffer inputGamma:inputGamma outputGamma:outputGamma stats:stats];
   } else {
     inputGamma = BT709GammaSrgb;
     outputGamma = BT709GammaApple;
     
-    worked = [self convertIntoCoreVideoBuffer:inputImageRef cvPixelBuffer:cvPixelBuffer inputGamma:inputGamma outputGamma:outputGamma];
+    worked = [self convertIntoCoreVideoBuffer:inputImageRef cvPixelBuffer:cvPixelBuffer inputGamma:inputGamma outputGamma:outputGamma stats:stats];
   }
   
   NSAssert(worked, @"worked");
@@ -1128,6 +1196,50 @@ static inline uint32_t byte_to_grayscale24(uint32_t byteVal)
 // This method returns NULL if there was an error.
 
 + (CGImageRef) unpremultiply:(CGImageRef)inputImageRef
+{
+  static PremultiplyTables tables;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    premultiply_tables_init(&tables);
+  });
+
+  const int width = (int) CGImageGetWidth(inputImageRef);
+  const int height = (int) CGImageGetHeight(inputImageRef);
+
+  if (width == 0 || height == 0) {
+    return NULL;
+  }
+
+  CGColorSpaceRef inputColorspaceRef = CGImageGetColorSpace(inputImageRef);
+
+  // Render as premultiplied BGRA pixels in the input colorspace
+
+  CGFrameBuffer *inFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
+  inFrameBuffer.colorspace = inputColorspaceRef;
+
+  BOOL worked = [inFrameBuffer renderCGImage:inputImageRef];
+
+  if (!worked) {
+    return NULL;
+  }
+
+  CGFrameBuffer *outFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:24 width:width height:height];
+  outFrameBuffer.colorspace = inputColorspaceRef;
+
+  const uint32_t *inPixels = (const uint32_t *) inFrameBuffer.pixels;
+  uint32_t *outPixels = (uint32_t *) outFrameBuffer.pixels;
+
+  // Rows are not padded so the whole frame is one row
+
+  unpremultiply_row(&tables, inPixels, outPixels, width * height);
+
+  return [outFrameBuffer createCGImageRef];
+}
+
+// Unpremultiply with vImageUnpremultiplyData_BGRA8888(), the output
+// is identical to unpremultiply: and this method is kept as a reference.
+
++ (CGImageRef) unpremultiplyWithVImage:(CGImageRef)inputImageRef
 {
   // Default to sRGB on both MacOSX and iOS
   //CGColorSpaceRef inputColorspaceRef = NULL;
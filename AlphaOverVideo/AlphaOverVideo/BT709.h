@@ -17,6 +17,9 @@
 
 #include "sRGB.h"
 
+#include <stdint.h>
+#include <string.h>
+
 typedef enum
 {
   BT709GammaSrgb = 1,
@@ -1048,7 +1051,7 @@ void sRGB_ycbcr_tolinearNorm(
                               float *CrPtr
                               )
 {
-  const BOOL debug = FALSE;
+  const int debug = 0;
   
 #if defined(DEBUG)
   assert(R >= 0 && R <= 255);
@@ -1177,7 +1180,7 @@ float BT709_average_cbcr_linear(
                               float C4n
                               )
 {
-  const BOOL debug = FALSE;
+  const int debug = 0;
   
   float sum = (C1n + C2n + C3n + C4n);
   float ave = sum / 4.0f;
@@ -1504,4 +1507,139 @@ void BT709_average_pixel_values(
   *Cr = CrAve;
 }
 
+// Chroma subsampling of content that is mostly a single color, for example
+// black or fully transparent pixels, finds many 2x2 blocks where all 4
+// pixels are equal. The Y Cb Cr output for such a block depends only on
+// the color, so it is computed once with BT709_average_pixel_values()
+// and then looked up in a direct mapped memo. The output is bit exact.
+
+#define BT709_UNIFORM_MEMO_BITS 12
+#define BT709_UNIFORM_MEMO_SIZE (1 << BT709_UNIFORM_MEMO_BITS)
+
+// Number of 2x2 blocks that took each path
+
+typedef struct {
+  // Pixels are not all equal, full linear average
+  uint64_t numMixedBlocks;
+  // Same color as the previous uniform block
+  uint64_t numRunBlocks;
+  // Color found in the memo
+  uint64_t numMemoHitBlocks;
+  // Color computed and then stored in the memo
+  uint64_t numMemoMissBlocks;
+} BT709SubsampleStats;
+
+typedef struct {
+  // (R G B) with bit 24 set, zero for an empty entry
+  uint32_t keys[BT709_UNIFORM_MEMO_SIZE];
+  // Y | (Cb << 8) | (Cr << 16)
+  uint32_t values[BT709_UNIFORM_MEMO_SIZE];
+  // Key and value of the last uniform block
+  uint32_t runKey;
+  uint32_t runValue;
+  BT709Gamma inputGamma;
+  BT709Gamma outputGamma;
+} BT709UniformMemo;
+
+// A memo is only valid for one pair of gamma settings
+
+static inline
+void BT709_uniform_memo_init(BT709UniformMemo *memo,
+                             const BT709Gamma inputGamma,
+                             const BT709Gamma outputGamma)
+{
+  memset(memo->keys, 0, sizeof(memo->keys));
+  memo->runKey = 0;
+  memo->runValue = 0;
+  memo->inputGamma = inputGamma;
+  memo->outputGamma = outputGamma;
+}
+
+// Same output as BT709_average_pixel_values() for 4 BGRA pixels,
+// alpha is ignored.
+
+static inline
+void BT709_average_block_memo(
+                              BT709UniformMemo *memo,
+                              uint32_t p1,
+                              uint32_t p2,
+                              uint32_t p3,
+                              uint32_t p4,
+                              int *Y1,
+                              int *Y2,
+                              int *Y3,
+                              int *Y4,
+                              int *Cb,
+                              int *Cr,
+                              BT709SubsampleStats *stats
+                              )
+{
+  const uint32_t diff = ((p1 ^ p2) | (p1 ^ p3) | (p1 ^ p4)) & 0xFFFFFF;
+
+  if (diff != 0) {
+    stats->numMixedBlocks += 1;
+
+    BT709_average_pixel_values(
+                               (p1 >> 16) & 0xFF, (p1 >> 8) & 0xFF, p1 & 0xFF,
+                               (p2 >> 16) & 0xFF, (p2 >> 8) & 0xFF, p2 & 0xFF,
+                               (p3 >> 16) & 0xFF, (p3 >> 8) & 0xFF, p3 & 0xFF,
+                               (p4 >> 16) & 0xFF, (p4 >> 8) & 0xFF, p4 & 0xFF,
+                               Y1, Y2, Y3, Y4,
+                               Cb, Cr,
+                               memo->inputGamma,
+                               memo->outputGamma
+                               );
+    return;
+  }
+
+  const uint32_t key = (p1 & 0xFFFFFF) | (1 << 24);
+  uint32_t value;
+
+  if (key == memo->runKey) {
+    stats->numRunBlocks += 1;
+    value = memo->runValue;
+  } else {
+    const uint32_t slot = (key * 2654435761u) >> (32 - BT709_UNIFORM_MEMO_BITS);
+
+    if (memo->keys[slot] == key) {
+      stats->numMemoHitBlocks += 1;
+      value = memo->values[slot];
+    } else {
+      stats->numMemoMissBlocks += 1;
+
+      const int R = (p1 >> 16) & 0xFF;
+      const int G = (p1 >> 8) & 0xFF;
+      const int B = p1 & 0xFF;
+
+      int Y, Y2Unused, Y3Unused, Y4Unused, CbVal, CrVal;
+
+      BT709_average_pixel_values(
+                                 R, G, B,
+                                 R, G, B,
+                                 R, G, B,
+                                 R, G, B,
+                                 &Y, &Y2Unused, &Y3Unused, &Y4Unused,
+                                 &CbVal, &CrVal,
+                                 memo->inputGamma,
+                                 memo->outputGamma
+                                 );
+
+      value = (uint32_t) Y | ((uint32_t) CbVal << 8) | ((uint32_t) CrVal << 16);
+      memo->keys[slot] = key;
+      memo->values[slot] = value;
+    }
+
+    memo->runKey = key;
+    memo->runValue = value;
+  }
+
+  const int Y = value & 0xFF;
+  *Y1 = Y;
+  *Y2 = Y;
+  *Y3 = Y;
+  *Y4 = Y;
+  *Cb = (value >> 8) & 0xFF;
+  *Cr = (value >> 16) & 0xFF;
+}
+
 #endif // _BT709_H
@@ -11,6 +11,7 @@
 #define _CVPixelBufferUtils_H
 
 #import "BT709.h"
+#import "ycbcr_encoder.h"
 
 // Copy the contents of a specific plane from src to dst, this
 // method is optimized so that memcpy() operations will copy
@@ -237,10 +238,16 @@ NSMutableData* cvpbu_get_uv_plane_as_data(CVPixelBufferRef cvPixelBuffer, int pl
 
 // Subsample RGB pixels as YCbCr with linear gamma logic that
 // best represents the resized color planes via iterative approach.
+// Blocks of 4 equal pixels are looked up in a memo, stats counts
+// the number of blocks that took each path.
 
 static inline
-void cvpbu_ycbcr_subsample(uint32_t *inPixelsPtr, int width, int height, CVPixelBufferRef dst, const BT709Gamma inputGamma, const BT709Gamma outputGamma) {
+void cvpbu_ycbcr_subsample_stats(uint32_t *inPixelsPtr, int width, int height, CVPixelBufferRef dst, const BT709Gamma inputGamma, const BT709Gamma outputGamma, BT709SubsampleStats *stats) {
   const int debug = 0;
+
+  BT709UniformMemo *memo = (BT709UniformMemo *) malloc(sizeof(BT709UniformMemo));
+  assert(memo);
+  BT709_uniform_memo_init(memo, inputGamma, outputGamma);
   
 //  int width = (int) CVPixelBufferGetWidth(dst);
 //  int height = (int) CVPixelBufferGetHeight(dst);
@@ -301,40 +308,19 @@ void cvpbu_ycbcr_subsample(uint32_t *inPixelsPtr, int width, int height, CVPixel
         uint32_t p3 = inPixelsPtr[((row+1) * width) + col];
         uint32_t p4 = inPixelsPtr[((row+1) * width) + col+1];
         
-        int R1 = (p1 >> 16) & 0xFF;
-        int G1 = (p1 >> 8) & 0xFF;
-        int B1 = p1 & 0xFF;
-        
-        int R2 = (p2 >> 16) & 0xFF;
-        int G2 = (p2 >> 8) & 0xFF;
-        int B2 = p2 & 0xFF;
-        
-        int R3 = (p3 >> 16) & 0xFF;
-        int G3 = (p3 >> 8) & 0xFF;
-        int B3 = p3 & 0xFF;
-        
-        int R4 = (p4 >> 16) & 0xFF;
-        int G4 = (p4 >> 8) & 0xFF;
-        int B4 = p4 & 0xFF;
-        
         if (debug) {
-        printf("R1 G1 B1 %3d %3d %3d : R2 G2 B2 %3d %3d %3d\n", R1, G1, B1, R2, G2, B2);
-        printf("R3 G3 B3 %3d %3d %3d : R4 G4 B4 %3d %3d %3d\n", R3, G3, B3, R4, G4, B4);
+        printf("p1 p2 : 0x%08X 0x%08X\n", p1, p2);
+        printf("p3 p4 : 0x%08X 0x%08X\n", p3, p4);
         }
 
         int Y1, Y2, Y3, Y4;
         int Cb, Cr;
         
-        BT709_average_pixel_values(
-                                   R1, G1, B1,
-                                   R2, G2, B2,
-                                   R3, G3, B3,
-                                   R4, G4, B4,
-                                   &Y1, &Y2, &Y3, &Y4,
-                                   &Cb, &Cr,
-                                   inputGamma,
-                                   outputGamma
-                                   );
+        BT709_average_block_memo(memo,
+                                 p1, p2, p3, p4,
+                                 &Y1, &Y2, &Y3, &Y4,
+                                 &Cb, &Cr,
+                                 stats);
 
         if (debug) {
           printf("Y1 Y2 Y3 Y4 %3d %3d %3d %3d : Cb Cr %3d %3d\n", Y1, Y2, Y3, Y4, Cb, Cr);
@@ -396,7 +382,40 @@ void cvpbu_ycbcr_subsample(uint32_t *inPixelsPtr, int width, int height, CVPixel
     int status = CVPixelBufferUnlockBaseAddress(dst, 0);
     assert(status == kCVReturnSuccess);
   }
+  
+  free(memo);
+  
+  if (debug) {
+    printf("subsample blocks : mixed %d run %d memo hit %d memo miss %d\n",
+           (int) stats->numMixedBlocks, (int) stats->numRunBlocks,
+           (int) stats->numMemoHitBlocks, (int) stats->numMemoMissBlocks);
+  }
+}
+
+static inline
+void cvpbu_ycbcr_subsample(uint32_t *inPixelsPtr, int width, int height, CVPixelBufferRef dst, const BT709Gamma inputGamma, const BT709Gamma outputGamma) {
+  BT709SubsampleStats stats;
+  memset(&stats, 0, sizeof(stats));
+  cvpbu_ycbcr_subsample_stats(inPixelsPtr, width, height, dst, inputGamma, outputGamma, &stats);
 }
 
 
+// Describe the planes of a locked biplanar 4:2:0 buffer as a
+// YCbCrEncoderFrame so that it can be passed to an encoder backend.
+// The buffer must remain locked until the frame has been written.
+
+static inline
+void cvpbu_ycbcr_encoder_frame(CVPixelBufferRef cvPixelBuffer, YCbCrEncoderFrame *frame) {
+  const int yPlane = 0;
+  const int cbcrPlane = 1;
+
+  memset(frame, 0, sizeof(YCbCrEncoderFrame));
+
+  frame->yPtr = (const uint8_t *) CVPixelBufferGetBaseAddressOfPlane(cvPixelBuffer, yPlane);
+  frame->yBytesPerRow = (int) CVPixelBufferGetBytesPerRowOfPlane(cvPixelBuffer, yPlane);
+
+  frame->cbcrPtr = (const uint8_t *) CVPixelBufferGetBaseAddressOfPlane(cvPixelBuffer, cbcrPlane);
+  frame->cbcrBytesPerRow = (int) CVPixelBufferGetBytesPerRowOfPlane(cvPixelBuffer, cbcrPlane);
+}
+
 #endif // _CVPixelBufferUtils_H
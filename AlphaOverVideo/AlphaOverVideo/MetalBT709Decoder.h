@@ -62,6 +62,8 @@
 // Note that in the case where the render should be done in 1 step,
 // meaning directly into a view then pass a renderPassDescriptor.
 // A 2 stage render would pass nil for renderPassDescriptor.
+// The texture can also be a RGBA16Float or RGBA32Float intermediate,
+// a second render pipeline is created to match its pixel format.
 
 - (BOOL) decodeBT709:(CVPixelBufferRef)yCbCrInputTexture
     alphaPixelBuffer:(CVPixelBufferRef)alphaPixelBuffer
@@ -72,4 +74,19 @@ renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
         renderHeight:(int)renderHeight
   waitUntilCompleted:(BOOL)waitUntilCompleted;
 
+// Fused BT709 -> BGRA decode and resample that renders into a view
+// of any size in one pass. Y and CbCr texels are read and decoded
+// under a tent filter in linear light, so no intermediate texture
+// the size of the video is written. Filter taps are computed when
+// the input or render size changes. Each output pixel decodes every
+// tap, so decode_scaler_use_fused() decides when this is faster than
+// decodeBT709 followed by a resample.
+
+- (BOOL) decodeScaleBT709:(CVPixelBufferRef)yCbCrPixelBuffer
+         alphaPixelBuffer:(CVPixelBufferRef)alphaPixelBuffer
+            commandBuffer:(id<MTLCommandBuffer>)commandBuffer
+     renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
+              renderWidth:(int)renderWidth
+             renderHeight:(int)renderHeight;
+
 @end
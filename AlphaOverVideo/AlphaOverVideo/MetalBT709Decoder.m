@@ -10,15 +10,44 @@
 
 #import "CVPixelBufferUtils.h"
 
+#import "AlphaOverVideoShaderTypes.h"
+
+#import "linear_scaler.h"
+
 @interface MetalBT709Decoder ()
 {
   CVMetalTextureCacheRef _textureCache;
+  
+  // Input and output size of the filter in scaleFilterBuffer, the
+  // buffer holds hStarts, vStarts, hWeights and vWeights at the
+  // offsets in _scaleOffsets.
+  int _scaleInWidth;
+  int _scaleInHeight;
+  int _scaleOutWidth;
+  int _scaleOutHeight;
+  NSUInteger _scaleOffsets[4];
+  AAPLDecodeScaleParams _scaleParams;
+  
+  MTLPixelFormat _scalePixelFormat;
+  
+  // Pixel format of intermediateRenderPipelineState
+  MTLPixelFormat _intermediatePixelFormat;
 }
 
 @property (nonatomic, retain) id<MTLRenderPipelineState> renderPipelineState;
 
 @property (nonatomic, retain) id<MTLComputePipelineState> computePipelineState;
 
+@property (nonatomic, retain) id<MTLRenderPipelineState> scaleRenderPipelineState;
+
+// Render pipeline that runs the decode fragment shader into an
+// intermediate texture with a pixel format other than colorPixelFormat,
+// for example a 16 or 32 bit float texture.
+
+@property (nonatomic, retain) id<MTLRenderPipelineState> intermediateRenderPipelineState;
+
+@property (nonatomic, retain) id<MTLBuffer> scaleFilterBuffer;
+
 // FIXME: Make Y and CbCr textures a set of properties that can be passed
 // in so that triple buffering is possible.
 
@@ -269,7 +298,7 @@ renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
                renderHeight:(int)renderHeight
          waitUntilCompleted:(BOOL)waitUntilCompleted
 {
-  const int debug = 0;
+  BOOL worked;
   
   // Setup Metal textures for Y and UV input
   
@@ -300,6 +329,62 @@ renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
     return FALSE;
   }
   
+  worked = [self wrapInputPixelBuffers:cvPixelBuffer
+                       alphaPixelBuffer:alphaPixelBuffer];
+  
+  if (worked == FALSE) {
+    return FALSE;
+  }
+  
+  id<MTLTexture> outputTexture = bgraSRGBTexture;
+  
+  if (self.useComputeRenderer) {
+    worked = [self renderWithComputePipeline:outputTexture
+                               commandBuffer:commandBuffer];
+  } else {
+    if (renderPassDescriptor != nil) {
+      worked = [self renderWithRenderPipeline:commandBuffer
+                         renderPassDescriptor:renderPassDescriptor
+                                  renderWidth:renderWidth
+                                 renderHeight:renderHeight];
+    } else {
+      worked = [self renderWithRenderPipeline:outputTexture
+                                commandBuffer:commandBuffer];
+    }
+    
+    if (waitUntilCompleted && renderPassDescriptor != nil) {
+      // FIXME: would need to present drawable here before
+      // calling commit on the commandBuffer
+      assert(0);
+    }
+  }
+  
+  if (worked == FALSE) {
+    // Return FALSE to indicate that render was not successful
+    return FALSE;
+  }
+  
+  // Wait for GPU to complete this task
+  
+  if (waitUntilCompleted) {
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+  }
+  
+  return TRUE;
+}
+
+// Verify that the input pixel buffers are tagged with the configured
+// gamma and wrap the Y, CbCr and alpha planes as Metal textures.
+
+- (BOOL) wrapInputPixelBuffers:(CVPixelBufferRef)cvPixelBuffer
+              alphaPixelBuffer:(CVPixelBufferRef)alphaPixelBuffer
+{
+  const int debug = 0;
+  
+  int width = (int) CVPixelBufferGetWidth(cvPixelBuffer);
+  int height = (int) CVPixelBufferGetHeight(cvPixelBuffer);
+  
   // Check dimensions of alpha pixel buffer
   
   if (alphaPixelBuffer != NULL) {
@@ -490,43 +575,6 @@ renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
   self.inputCbCrTexture = inputCbCrTexture;
   self.inputAlphaTexture = inputAlphaTexture;
   
-  id<MTLTexture> outputTexture = bgraSRGBTexture;
-  
-  BOOL worked;
-  
-  if (self.useComputeRenderer) {
-    worked = [self renderWithComputePipeline:outputTexture
-                               commandBuffer:commandBuffer];
-  } else {
-    if (renderPassDescriptor != nil) {
-      worked = [self renderWithRenderPipeline:commandBuffer
-                         renderPassDescriptor:renderPassDescriptor
-                                  renderWidth:renderWidth
-                                 renderHeight:renderHeight];
-    } else {
-      worked = [self renderWithRenderPipeline:outputTexture
-                                commandBuffer:commandBuffer];
-    }
-    
-    if (waitUntilCompleted && renderPassDescriptor != nil) {
-      // FIXME: would need to present drawable here before
-      // calling commit on the commandBuffer
-      assert(0);
-    }
-  }
-  
-  if (worked == FALSE) {
-    // Return FALSE to indicate that render was not successful
-    return FALSE;
-  }
-  
-  // Wait for GPU to complete this task
-  
-  if (waitUntilCompleted) {
-    [commandBuffer commit];
-    [commandBuffer waitUntilCompleted];
-  }
-  
   return TRUE;
 }
 
@@ -592,6 +640,20 @@ renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
   
   id<MTLRenderPipelineState> pipeline = self.renderPipelineState;
   
+  // The intermediate texture precision is chosen by the view, a
+  // render pipeline must match the pixel format of the texture.
+  
+  if (outputTexture.pixelFormat != self.colorPixelFormat) {
+    if (self.intermediateRenderPipelineState == nil || outputTexture.pixelFormat != _intermediatePixelFormat) {
+      BOOL worked = [self setupMetalIntermediatePipeline:outputTexture.pixelFormat];
+      if (!worked) {
+        return FALSE;
+      }
+    }
+    
+    pipeline = self.intermediateRenderPipelineState;
+  }
+  
   // Configure fragment shader render into output texture of the exact same dimensions
   // so that there is no scaling and single (non-linear) pixels are rendered 1 to 1.
   
@@ -665,6 +727,20 @@ renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
   
   id<MTLRenderPipelineState> pipeline = self.renderPipelineState;
   
+  // The intermediate texture precision is chosen by the view, a
+  // render pipeline must match the pixel format of the texture.
+  
+  if (outputTexture.pixelFormat != self.colorPixelFormat) {
+    if (self.intermediateRenderPipelineState == nil || outputTexture.pixelFormat != _intermediatePixelFormat) {
+      BOOL worked = [self setupMetalIntermediatePipeline:outputTexture.pixelFormat];
+      if (!worked) {
+        return FALSE;
+      }
+    }
+    
+    pipeline = self.intermediateRenderPipelineState;
+  }
+  
   // Configure fragment shader render into output texture of the exact same dimensions
   // so that there is no scaling and single (non-linear) pixels are rendered 1 to 1.
   
@@ -728,4 +804,269 @@ renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
   }
 }
 
+// Render pipeline for the decode fragment shader that renders into an intermediate texture with the given pixel format
+
+- (BOOL) setupMetalIntermediatePipeline:(MTLPixelFormat)pixelFormat
+{
+  NSString *functionName = nil;
+  AOVGamma gamma = self.gamma;
+  
+  if (self.hasAlphaChannel) {
+    functionName = @"sRGBToLinearSRGBFragmentAlpha";
+  } else if (gamma == AOVGammaApple) {
+    functionName = @"BT709ToLinearSRGBFragment";
+  } else if (gamma == AOVGammaSRGB) {
+    functionName = @"sRGBToLinearSRGBFragment";
+  } else if (gamma == AOVGammaLinear) {
+    functionName = @"LinearToLinearSRGBFragment";
+  } else {
+    assert(0);
+  }
+  
+  self.intermediateRenderPipelineState = [self.metalRenderContext makePipeline:pixelFormat
+                                                                 pipelineLabel:[NSString stringWithFormat:@"Render Pipeline %@", functionName]
+                                                                numAttachments:1
+                                                            vertexFunctionName:@"identityVertexShader"
+                                                          fragmentFunctionName:functionName];
+  
+  if (self.intermediateRenderPipelineState == nil) {
+#if defined(DEBUG)
+    NSAssert(self.intermediateRenderPipelineState, @"Failed to create intermediate pipeline state for %@", functionName);
+#else
+    NSLog(@"Failed to create intermediate pipeline state for %@", functionName);
+#endif // DEBUG
+    return FALSE;
+  }
+  
+  _intermediatePixelFormat = pixelFormat;
+  
+  return TRUE;
+}
+
+// Fused decode and resample pipeline that renders into a view with the given pixel format
+
+- (BOOL) setupMetalScalePipeline:(MTLPixelFormat)pixelFormat
+{
+  NSString *functionName = nil;
+  AOVGamma gamma = self.gamma;
+  
+  if (self.hasAlphaChannel) {
+    functionName = @"sRGBToLinearSRGBScaleFragmentAlpha";
+  } else if (gamma == AOVGammaApple) {
+    functionName = @"BT709ToLinearSRGBScaleFragment";
+  } else if (gamma == AOVGammaSRGB) {
+    functionName = @"sRGBToLinearSRGBScaleFragment";
+  } else if (gamma == AOVGammaLinear) {
+    functionName = @"LinearToLinearSRGBScaleFragment";
+  } else {
+    assert(0);
+  }
+  
+  self.scaleRenderPipelineState = [self.metalRenderContext makePipeline:pixelFormat
+                                                          pipelineLabel:[NSString stringWithFormat:@"Render Pipeline %@", functionName]
+                                                         numAttachments:1
+                                                     vertexFunctionName:@"identityVertexShader"
+                                                   fragmentFunctionName:functionName];
+  
+  if (self.scaleRenderPipelineState == nil) {
+#if defined(DEBUG)
+    NSAssert(self.scaleRenderPipelineState, @"Failed to create scale pipeline state for %@", functionName);
+#else
+    NSLog(@"Failed to create scale pipeline state for %@", functionName);
+#endif // DEBUG
+    return FALSE;
+  }
+  
+  _scalePixelFormat = pixelFormat;
+  
+  return TRUE;
+}
+
+// Compute filter taps for a resample from the video size to the
+// render size, the buffer is reused until either size changes.
+
+- (BOOL) setupScaleFilter:(int)inWidth
+                 inHeight:(int)inHeight
+                 outWidth:(int)outWidth
+                outHeight:(int)outHeight
+{
+  if (self.scaleFilterBuffer != nil &&
+      inWidth == _scaleInWidth && inHeight == _scaleInHeight &&
+      outWidth == _scaleOutWidth && outHeight == _scaleOutHeight) {
+    return TRUE;
+  }
+  
+  self.scaleFilterBuffer = nil;
+  
+  LinearScaleFilter hFilter;
+  LinearScaleFilter vFilter;
+  
+  if (linear_scale_filter_init(&hFilter, LinearScaleKernelBilinear, inWidth, outWidth) != 0) {
+    return FALSE;
+  }
+  
+  if (linear_scale_filter_init(&vFilter, LinearScaleKernelBilinear, inHeight, outHeight) != 0) {
+    linear_scale_filter_free(&hFilter);
+    return FALSE;
+  }
+  
+  // Constant buffer offsets are kept 256 byte aligned, as required on MacOSX
+  
+  const NSUInteger align = 256;
+  const NSUInteger numBytes[4] = {
+    outWidth * sizeof(int),
+    outHeight * sizeof(int),
+    outWidth * hFilter.maxTaps * sizeof(float),
+    outHeight * vFilter.maxTaps * sizeof(float)
+  };
+  const void *ptrs[4] = { hFilter.starts, vFilter.starts, hFilter.weights, vFilter.weights };
+  
+  NSUInteger offset = 0;
+  
+  for (int i = 0; i < 4; i++) {
+    _scaleOffsets[i] = offset;
+    offset += ((numBytes[i] + align - 1) / align) * align;
+  }
+  
+  id<MTLBuffer> buffer = [self.metalRenderContext.device newBufferWithLength:offset
+                                                                     options:MTLResourceStorageModeShared];
+  
+  if (buffer != nil) {
+    uint8_t *bufferPtr = (uint8_t *) buffer.contents;
+    
+    for (int i = 0; i < 4; i++) {
+      memcpy(bufferPtr + _scaleOffsets[i], ptrs[i], numBytes[i]);
+    }
+  }
+  
+  _scaleParams.hTaps = hFilter.maxTaps;
+  _scaleParams.vTaps = vFilter.maxTaps;
+  
+  linear_scale_filter_free(&hFilter);
+  linear_scale_filter_free(&vFilter);
+  
+  if (buffer == nil) {
+    return FALSE;
+  }
+  
+  self.scaleFilterBuffer = buffer;
+  
+  _scaleInWidth = inWidth;
+  _scaleInHeight = inHeight;
+  _scaleOutWidth = outWidth;
+  _scaleOutHeight = outHeight;
+  
+  return TRUE;
+}
+
+// Fused BT709 -> BGRA decode and resample into a view of any size,
+// see header for details.
+
+- (BOOL) decodeScaleBT709:(CVPixelBufferRef)yCbCrPixelBuffer
+         alphaPixelBuffer:(CVPixelBufferRef)alphaPixelBuffer
+            commandBuffer:(id<MTLCommandBuffer>)commandBuffer
+     renderPassDescriptor:(MTLRenderPassDescriptor*)renderPassDescriptor
+              renderWidth:(int)renderWidth
+             renderHeight:(int)renderHeight
+{
+  BOOL worked;
+  
+  if (renderPassDescriptor == nil || renderWidth <= 0 || renderHeight <= 0) {
+    return FALSE;
+  }
+  
+  worked = [self setupMetal];
+  if (worked == FALSE) {
+    return FALSE;
+  }
+  
+  worked = [self wrapInputPixelBuffers:yCbCrPixelBuffer
+                      alphaPixelBuffer:alphaPixelBuffer];
+  
+  if (worked == FALSE) {
+    return FALSE;
+  }
+  
+  MTLPixelFormat pixelFormat = renderPassDescriptor.colorAttachments[0].texture.pixelFormat;
+  
+  if (self.scaleRenderPipelineState == nil || pixelFormat != _scalePixelFormat) {
+    worked = [self setupMetalScalePipeline:pixelFormat];
+    
+    if (worked == FALSE) {
+      return FALSE;
+    }
+  }
+  
+  int width = (int) CVPixelBufferGetWidth(yCbCrPixelBuffer);
+  int height = (int) CVPixelBufferGetHeight(yCbCrPixelBuffer);
+  
+  worked = [self setupScaleFilter:width
+                         inHeight:height
+                         outWidth:renderWidth
+                        outHeight:renderHeight];
+  
+  if (worked == FALSE) {
+    return FALSE;
+  }
+  
+  NSString *label = @"BT709 Decode Scale Render";
+  
+  // Every output pixel is written
+  renderPassDescriptor.colorAttachments[0].loadAction = MTLLoadActionDontCare;
+  
+  id<MTLRenderCommandEncoder> renderEncoder =
+    [commandBuffer renderCommandEncoderWithDescriptor:renderPassDescriptor];
+  renderEncoder.label = label;
+  
+  [renderEncoder pushDebugGroup:label];
+  
+  MTLViewport mtlvp = {0.0, 0.0, renderWidth, renderHeight, -1.0, 1.0 };
+  [renderEncoder setViewport:mtlvp];
+  
+  [renderEncoder setRenderPipelineState:self.scaleRenderPipelineState];
+  
+  [renderEncoder setVertexBuffer:self.metalRenderContext.identityVerticesBuffer
+                          offset:0
+                         atIndex:0];
+  
+  [renderEncoder setFragmentTexture:self.inputYTexture
+                            atIndex:AAPLTextureIndexYPlane];
+  [renderEncoder setFragmentTexture:self.inputCbCrTexture
+                            atIndex:AAPLTextureIndexCbCrPlane];
+  if (self.hasAlphaChannel) {
+#if defined(DEBUG)
+    NSAssert(self.inputAlphaTexture, @"inputAlphaTexture Metal texture is nil with hasAlphaChannel set to TRUE");
+#endif // DEBUG
+    [renderEncoder setFragmentTexture:self.inputAlphaTexture
+                              atIndex:AAPLTextureIndexAlphaPlane];
+  }
+  
+  [renderEncoder setFragmentBytes:&_scaleParams
+                           length:sizeof(_scaleParams)
+                          atIndex:AAPLDecodeScaleIndexParams];
+  
+  const int bufferIndexes[4] = {
+    AAPLDecodeScaleIndexHStarts,
+    AAPLDecodeScaleIndexVStarts,
+    AAPLDecodeScaleIndexHWeights,
+    AAPLDecodeScaleIndexVWeights
+  };
+  
+  for (int i = 0; i < 4; i++) {
+    [renderEncoder setFragmentBuffer:self.scaleFilterBuffer
+                              offset:_scaleOffsets[i]
+                             atIndex:bufferIndexes[i]];
+  }
+  
+  [renderEncoder drawPrimitives:MTLPrimitiveTypeTriangle
+                    vertexStart:0
+                    vertexCount:self.metalRenderContext.identityNumVertices];
+  
+  [renderEncoder popDebugGroup];
+  
+  [renderEncoder endEncoding];
+  
+  return TRUE;
+}
+
 @end
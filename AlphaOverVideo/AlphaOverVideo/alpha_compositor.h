@@ -0,0 +1,557 @@
+//
+//  alpha_compositor.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface to a CPU compositor that blends N layers
+//  of decoded RGB+Alpha frames over a background image. Blending is
+//  done in linear light (sRGB gamma removed) so that the output
+//  matches what the Metal render path produces when it mixes
+//  linear values before writing to a sRGB texture.
+//
+//  The output is processed in one pass over small square tiles so
+//  that the float accumulator for a tile stays in L1 cache while
+//  each layer that intersects the tile is blended into it in z order.
+//  Each layer can be scanned ahead of time to produce a coarse
+//  coverage map, blocks of a layer that are fully transparent are
+//  skipped and blocks that are fully opaque are copied without a blend.
+//
+//  This module depends only on libc so that it can be used for
+//  headless rendering and tests on any platform.
+//
+//  See license.txt for license terms.
+
+#if !defined(_ALPHA_COMPOSITOR_H)
+#define _ALPHA_COMPOSITOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "sRGB.h"
+#include "premultiply.h"
+
+// Output tile size in pixels, a tile of float4 values is 16 kB
+
+#define AC_TILE_DIM 32
+
+// Coverage block size in layer pixel coordinates
+
+#define AC_BLOCK_DIM 16
+
+// Max number of layers that can be passed to one composite call
+
+#define AC_MAX_LAYERS 64
+
+// Number of entries in the linear -> sRGB encode table. 14 bits
+// of linear precision keeps the dark end of the curve within
+// one byte step of the exact pow() result.
+
+#define AC_ENCODE_TABLE_BITS 14
+#define AC_ENCODE_TABLE_SIZE (1 << AC_ENCODE_TABLE_BITS)
+
+// Portable 4 wide float vector, supported by both clang and gcc.
+// Components are stored in (B G R A) order to match pixel layout.
+
+typedef float ac_float4 __attribute__((vector_size(16)));
+
+typedef enum {
+  ACBlockEmpty = 0,
+  ACBlockPartial = 1,
+  ACBlockOpaque = 2
+} ACBlockCoverage;
+
+typedef struct {
+  // BGRA pixels with sRGB gamma encoded RGB components, unless
+  // toLinear maps them with another curve
+  const uint32_t *pixels;
+  int pixelsPerRow;
+
+  // Byte -> linear normalized float for the RGB components, see
+  // ac_to_linear_init(). NULL uses the sRGB curve in the tables.
+  const float *toLinear;
+
+  // Optional alpha plane (one byte per pixel, linear). When NULL
+  // the alpha value is read from the A component of each pixel.
+  const uint8_t *alpha;
+  int alphaBytesPerRow;
+
+  int width;
+  int height;
+
+  // Offset of the layer origin in output pixel coordinates,
+  // a layer can be partially or completely outside the output.
+  int x;
+  int y;
+
+  // Layers with a larger z value are drawn on top
+  int z;
+
+  // TRUE when RGB values were premultiplied by alpha before
+  // gamma encoding, as written by srgb_to_bt709 -alpha 1.
+  int isPremultiplied;
+
+  // Coverage map filled in by ac_layer_scan_coverage(), NULL
+  // means that every block is treated as partial coverage.
+  uint8_t *coverage;
+  int coverageCols;
+  int coverageRows;
+} AlphaCompositorLayer;
+
+typedef struct {
+  // sRGB byte -> linear normalized float
+  float toLinear[256];
+  // A byte -> normalized float
+  float alphaNorm[256];
+  // Reciprocal of A used to undo premultiplication, see premultiply.h
+  uint32_t reciprocal[256];
+  // Linear normalized float (quantized) -> sRGB byte
+  uint8_t toSRGB[AC_ENCODE_TABLE_SIZE];
+} AlphaCompositorTables;
+
+typedef struct {
+  uint64_t blendedPixels;
+  uint64_t copiedPixels;
+  uint64_t skippedPixels;
+  uint64_t tiles;
+} AlphaCompositorStats;
+
+// State shared by all tiles of one composite operation
+
+typedef struct {
+  const AlphaCompositorTables *tables;
+
+  // Opaque background in sRGB, when NULL the output starts as transparent black
+  const uint32_t *bgPixels;
+  int bgPixelsPerRow;
+
+  uint32_t *outPixels;
+  int outPixelsPerRow;
+
+  int width;
+  int height;
+
+  int numLayers;
+  const AlphaCompositorLayer *layers[AC_MAX_LAYERS];
+} AlphaCompositorFrame;
+
+// Fill a 256 entry byte -> linear normalized float table. Bytes
+// decoded from a clip encoded without a gamma curve are already
+// linear and map as-is, otherwise the sRGB curve is removed.
+
+static inline
+void ac_to_linear_init(float *toLinear, int isLinear)
+{
+  for (int i = 0; i < 256; i++) {
+    if (isLinear) {
+      toLinear[i] = byteNorm(i);
+    } else {
+      toLinear[i] = sRGB_nonLinearNormToLinear(byteNorm(i));
+    }
+  }
+}
+
+// Fill in conversion tables, this only needs to be done once.
+
+static inline
+void ac_tables_init(AlphaCompositorTables *tables)
+{
+  ac_to_linear_init(tables->toLinear, 0);
+
+  for (int i = 0; i < 256; i++) {
+    tables->alphaNorm[i] = byteNorm(i);
+  }
+
+  premultiply_reciprocal_init(tables->reciprocal);
+
+  for (int i = 0; i < AC_ENCODE_TABLE_SIZE; i++) {
+    float linearN = i / (float) (AC_ENCODE_TABLE_SIZE - 1);
+    float nonLinear = sRGB_linearNormToNonLinear(linearN);
+    int v = (int) round(saturatef(nonLinear) * 255.0f);
+    tables->toSRGB[i] = (uint8_t) v;
+  }
+}
+
+// Encode a linear normalized value as a sRGB byte via table lookup
+
+static inline
+uint32_t ac_encode_srgb(const AlphaCompositorTables *tables, float linearN)
+{
+  int i = (int) (linearN * (AC_ENCODE_TABLE_SIZE - 1) + 0.5f);
+  if (i < 0) {
+    i = 0;
+  } else if (i > (AC_ENCODE_TABLE_SIZE - 1)) {
+    i = (AC_ENCODE_TABLE_SIZE - 1);
+  }
+  return tables->toSRGB[i];
+}
+
+// Read the alpha value for a specific layer pixel
+
+static inline
+int ac_layer_alpha(const AlphaCompositorLayer *layer, int col, int row)
+{
+  if (layer->alpha != NULL) {
+    return layer->alpha[(row * layer->alphaBytesPerRow) + col];
+  } else {
+    uint32_t pixel = layer->pixels[(row * layer->pixelsPerRow) + col];
+    return (pixel >> 24) & 0xFF;
+  }
+}
+
+// Scan the alpha values of a layer and generate a coverage map
+// with one entry for each AC_BLOCK_DIM x AC_BLOCK_DIM block.
+// The coverage map only needs to be regenerated when the layer
+// pixels change. Returns 0 on success.
+
+static inline
+int ac_layer_scan_coverage(AlphaCompositorLayer *layer)
+{
+  const int cols = (layer->width + AC_BLOCK_DIM - 1) / AC_BLOCK_DIM;
+  const int rows = (layer->height + AC_BLOCK_DIM - 1) / AC_BLOCK_DIM;
+
+  if (layer->coverage == NULL || layer->coverageCols != cols || layer->coverageRows != rows) {
+    free(layer->coverage);
+    layer->coverage = (uint8_t *) malloc(cols * rows);
+    if (layer->coverage == NULL) {
+      return 1;
+    }
+    layer->coverageCols = cols;
+    layer->coverageRows = rows;
+  }
+
+  for (int brow = 0; brow < rows; brow++) {
+    for (int bcol = 0; bcol < cols; bcol++) {
+      const int row0 = brow * AC_BLOCK_DIM;
+      const int col0 = bcol * AC_BLOCK_DIM;
+      const int row1 = (row0 + AC_BLOCK_DIM) > layer->height ? layer->height : (row0 + AC_BLOCK_DIM);
+      const int col1 = (col0 + AC_BLOCK_DIM) > layer->width ? layer->width : (col0 + AC_BLOCK_DIM);
+
+      int minA = 255;
+      int maxA = 0;
+
+      for (int row = row0; row < row1; row++) {
+        for (int col = col0; col < col1; col++) {
+          int A = ac_layer_alpha(layer, col, row);
+          minA = (A < minA) ? A : minA;
+          maxA = (A > maxA) ? A : maxA;
+        }
+      }
+
+      uint8_t coverage;
+
+      if (maxA == 0) {
+        coverage = ACBlockEmpty;
+      } else if (minA == 255) {
+        coverage = ACBlockOpaque;
+      } else {
+        coverage = ACBlockPartial;
+      }
+
+      layer->coverage[(brow * cols) + bcol] = coverage;
+    }
+  }
+
+  return 0;
+}
+
+static inline
+void ac_layer_free_coverage(AlphaCompositorLayer *layer)
+{
+  free(layer->coverage);
+  layer->coverage = NULL;
+  layer->coverageCols = 0;
+  layer->coverageRows = 0;
+}
+
+// Convert a layer pixel to a linear premultiplied (B G R A) vector
+
+static inline
+ac_float4 ac_expand_pixel(const AlphaCompositorTables *tables,
+                          const float *toLinear,
+                          uint32_t pixel,
+                          int A,
+                          int isPremultiplied)
+{
+  int B = pixel & 0xFF;
+  int G = (pixel >> 8) & 0xFF;
+  int R = (pixel >> 16) & 0xFF;
+
+  if (isPremultiplied && A != 255) {
+    // Undo premultiplication in gamma space so that the sRGB
+    // curve is removed from the original color value.
+    B = (int) unpremultiply_component(tables->reciprocal, B, A);
+    G = (int) unpremultiply_component(tables->reciprocal, G, A);
+    R = (int) unpremultiply_component(tables->reciprocal, R, A);
+  }
+
+  const float An = tables->alphaNorm[A];
+
+  ac_float4 v = { toLinear[B], toLinear[G], toLinear[R], 1.0f };
+  ac_float4 a4 = { An, An, An, An };
+  return v * a4;
+}
+
+// Blend a horizontal run of layer pixels into the accumulator.
+// The coverage value for the run is known to be partial or opaque.
+
+static inline
+void ac_blend_run(const AlphaCompositorTables *tables,
+                  const AlphaCompositorLayer *layer,
+                  int layerCol,
+                  int layerRow,
+                  int count,
+                  ac_float4 *accPtr,
+                  int isOpaque,
+                  AlphaCompositorStats *stats)
+{
+  const uint32_t *inPixels = layer->pixels + (layerRow * layer->pixelsPerRow) + layerCol;
+  const uint8_t *inAlpha = NULL;
+  const float *toLinear = (layer->toLinear != NULL) ? layer->toLinear : tables->toLinear;
+
+  if (layer->alpha != NULL) {
+    inAlpha = layer->alpha + (layerRow * layer->alphaBytesPerRow) + layerCol;
+  }
+
+  if (isOpaque) {
+    // Opaque pixels replace the accumulated value, no blend needed
+
+    for (int i = 0; i < count; i++) {
+      uint32_t pixel = inPixels[i];
+      int B = pixel & 0xFF;
+      int G = (pixel >> 8) & 0xFF;
+      int R = (pixel >> 16) & 0xFF;
+      ac_float4 v = { toLinear[B], toLinear[G], toLinear[R], 1.0f };
+      accPtr[i] = v;
+    }
+
+    stats->copiedPixels += count;
+    return;
+  }
+
+  int numSkipped = 0;
+
+  for (int i = 0; i < count; i++) {
+    uint32_t pixel = inPixels[i];
+    int A = (inAlpha != NULL) ? inAlpha[i] : ((pixel >> 24) & 0xFF);
+
+    if (A == 0) {
+      numSkipped++;
+      continue;
+    }
+
+    ac_float4 src = ac_expand_pixel(tables, toLinear, pixel, A, layer->isPremultiplied);
+
+    // Porter-Duff over with premultiplied linear values
+
+    const float invA = 1.0f - src[3];
+    ac_float4 invA4 = { invA, invA, invA, invA };
+    accPtr[i] = src + (accPtr[i] * invA4);
+  }
+
+  stats->blendedPixels += (count - numSkipped);
+  stats->skippedPixels += numSkipped;
+}
+
+// Init frame state and sort the layers by z order. Layers with the
+// same z value are drawn in the order they appear in the input array.
+// Returns 0 on success.
+
+static inline
+int ac_frame_init(AlphaCompositorFrame *frame,
+                  const AlphaCompositorTables *tables,
+                  const uint32_t *bgPixels,
+                  int bgPixelsPerRow,
+                  uint32_t *outPixels,
+                  int outPixelsPerRow,
+                  int width,
+                  int height,
+                  const AlphaCompositorLayer *layers,
+                  int numLayers)
+{
+  if (numLayers < 0 || numLayers > AC_MAX_LAYERS) {
+    return 1;
+  }
+
+  frame->tables = tables;
+  frame->bgPixels = bgPixels;
+  frame->bgPixelsPerRow = bgPixelsPerRow;
+  frame->outPixels = outPixels;
+  frame->outPixelsPerRow = outPixelsPerRow;
+  frame->width = width;
+  frame->height = height;
+  frame->numLayers = numLayers;
+
+  // Stable insertion sort on z
+
+  for (int i = 0; i < numLayers; i++) {
+    const AlphaCompositorLayer *layer = &layers[i];
+    int j = i;
+    while (j > 0 && frame->layers[j-1]->z > layer->z) {
+      frame->layers[j] = frame->layers[j-1];
+      j--;
+    }
+    frame->layers[j] = layer;
+  }
+
+  return 0;
+}
+
+// Number of tiles needed to cover the output
+
+static inline
+int ac_frame_num_tiles(const AlphaCompositorFrame *frame)
+{
+  const int cols = (frame->width + AC_TILE_DIM - 1) / AC_TILE_DIM;
+  const int rows = (frame->height + AC_TILE_DIM - 1) / AC_TILE_DIM;
+  return cols * rows;
+}
+
+// Composite one output tile. Tiles do not share any mutable state
+// other than stats, so different tiles can be processed on different
+// threads as long as each thread passes its own stats struct.
+
+static inline
+void ac_composite_tile(const AlphaCompositorFrame *frame,
+                       int tileIndex,
+                       AlphaCompositorStats *stats)
+{
+  const AlphaCompositorTables *tables = frame->tables;
+
+  const int tileCols = (frame->width + AC_TILE_DIM - 1) / AC_TILE_DIM;
+
+  const int tx0 = (tileIndex % tileCols) * AC_TILE_DIM;
+  const int ty0 = (tileIndex / tileCols) * AC_TILE_DIM;
+  const int tx1 = (tx0 + AC_TILE_DIM) > frame->width ? frame->width : (tx0 + AC_TILE_DIM);
+  const int ty1 = (ty0 + AC_TILE_DIM) > frame->height ? frame->height : (ty0 + AC_TILE_DIM);
+  const int tw = tx1 - tx0;
+  const int th = ty1 - ty0;
+
+  ac_float4 acc[AC_TILE_DIM * AC_TILE_DIM] __attribute__((aligned(16)));
+
+  // Load background into accumulator as linear values
+
+  for (int row = 0; row < th; row++) {
+    ac_float4 *accRowPtr = &acc[row * AC_TILE_DIM];
+
+    if (frame->bgPixels == NULL) {
+      const ac_float4 zero = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for (int col = 0; col < tw; col++) {
+        accRowPtr[col] = zero;
+      }
+    } else {
+      const uint32_t *bgRowPtr = frame->bgPixels + ((ty0 + row) * frame->bgPixelsPerRow) + tx0;
+      for (int col = 0; col < tw; col++) {
+        uint32_t pixel = bgRowPtr[col];
+        ac_float4 v = {
+          tables->toLinear[pixel & 0xFF],
+          tables->toLinear[(pixel >> 8) & 0xFF],
+          tables->toLinear[(pixel >> 16) & 0xFF],
+          1.0f
+        };
+        accRowPtr[col] = v;
+      }
+    }
+  }
+
+  // Blend each layer that intersects this tile, in z order
+
+  for (int li = 0; li < frame->numLayers; li++) {
+    const AlphaCompositorLayer *layer = frame->layers[li];
+
+    // Intersection of the tile and the layer in output coordinates
+
+    int ix0 = (layer->x > tx0) ? layer->x : tx0;
+    int iy0 = (layer->y > ty0) ? layer->y : ty0;
+    int ix1 = (layer->x + layer->width < tx1) ? (layer->x + layer->width) : tx1;
+    int iy1 = (layer->y + layer->height < ty1) ? (layer->y + layer->height) : ty1;
+
+    if (ix0 >= ix1 || iy0 >= iy1) {
+      continue;
+    }
+
+    for (int oy = iy0; oy < iy1; oy++) {
+      const int layerRow = oy - layer->y;
+      const uint8_t *coverageRowPtr = NULL;
+
+      if (layer->coverage != NULL) {
+        coverageRowPtr = layer->coverage + ((layerRow / AC_BLOCK_DIM) * layer->coverageCols);
+      }
+
+      ac_float4 *accRowPtr = &acc[(oy - ty0) * AC_TILE_DIM];
+
+      // Split the row into runs at coverage block boundaries
+
+      int ox = ix0;
+
+      while (ox < ix1) {
+        const int layerCol = ox - layer->x;
+        const int blockCol = layerCol / AC_BLOCK_DIM;
+        int runEnd = layer->x + ((blockCol + 1) * AC_BLOCK_DIM);
+        if (runEnd > ix1) {
+          runEnd = ix1;
+        }
+        const int count = runEnd - ox;
+
+        int coverage = (coverageRowPtr == NULL) ? ACBlockPartial : coverageRowPtr[blockCol];
+
+        if (coverage == ACBlockEmpty) {
+          stats->skippedPixels += count;
+        } else {
+          ac_blend_run(tables, layer, layerCol, layerRow, count,
+                       accRowPtr + (ox - tx0),
+                       (coverage == ACBlockOpaque),
+                       stats);
+        }
+
+        ox = runEnd;
+      }
+    }
+  }
+
+  // Encode accumulated linear values as sRGB output pixels
+
+  for (int row = 0; row < th; row++) {
+    const ac_float4 *accRowPtr = &acc[row * AC_TILE_DIM];
+    uint32_t *outRowPtr = frame->outPixels + ((ty0 + row) * frame->outPixelsPerRow) + tx0;
+
+    for (int col = 0; col < tw; col++) {
+      ac_float4 v = accRowPtr[col];
+
+      const float An = v[3];
+      uint32_t A = (uint32_t) (saturatef(An) * 255.0f + 0.5f);
+
+      if (frame->bgPixels == NULL && A != 0 && A != 255) {
+        // Output without a background is written as non-premultiplied
+        const float invA = 1.0f / An;
+        ac_float4 invA4 = { invA, invA, invA, 1.0f };
+        v = v * invA4;
+      }
+
+      uint32_t B = ac_encode_srgb(tables, v[0]);
+      uint32_t G = ac_encode_srgb(tables, v[1]);
+      uint32_t R = ac_encode_srgb(tables, v[2]);
+
+      outRowPtr[col] = (A << 24) | (R << 16) | (G << 8) | B;
+    }
+  }
+
+  stats->tiles += 1;
+}
+
+// Composite all tiles on the calling thread
+
+static inline
+void ac_composite(const AlphaCompositorFrame *frame,
+                  AlphaCompositorStats *stats)
+{
+  const int numTiles = ac_frame_num_tiles(frame);
+
+  for (int i = 0; i < numTiles; i++) {
+    ac_composite_tile(frame, i, stats);
+  }
+}
+
+#endif // _ALPHA_COMPOSITOR_H
@@ -0,0 +1,116 @@
+//
+//  bt709_decode.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that converts a 4:2:0 BT.709
+//  YCbCr frame back to sRGB BGRA pixels on the CPU. This
+//  is the inverse of the encoding done in srgb_to_bt709
+//  and produces the same values as the Metal decode path
+//  without needing a GPU.
+//
+//  See license.txt for license terms.
+
+#if !defined(_BT709_DECODE_H)
+#define _BT709_DECODE_H
+
+#include <stdint.h>
+
+#include "BT709.h"
+
+static inline
+int bt709_decode_clamp(int v, int minv, int maxv) {
+  if (v < minv) {
+    return minv;
+  } else if (v > maxv) {
+    return maxv;
+  }
+  return v;
+}
+
+// Decode one Y Cb Cr triple to sRGB byte values given the
+// gamma curve the data was encoded with. Y and CbCr values
+// that are outside the legal range are clamped since a lossy
+// decoder can emit values slightly outside of the range.
+
+static inline
+int bt709_decode_pixel(int Y, int Cb, int Cr, BT709Gamma gamma, int *RPtr, int *GPtr, int *BPtr) {
+  Y = bt709_decode_clamp(Y, BT709_YMin, BT709_YMax);
+  Cb = bt709_decode_clamp(Cb, BT709_UVMin, BT709_UVMax);
+  Cr = bt709_decode_clamp(Cr, BT709_UVMin, BT709_UVMax);
+
+  switch (gamma) {
+    case BT709GammaApple: {
+      return Apple196_to_sRGB_convertYCbCrToRGB(Y, Cb, Cr, RPtr, GPtr, BPtr, 1);
+    }
+    case BT709GammaSrgb:
+    case BT709GammaLinear:
+    default: {
+      // Linear data is stored without a gamma curve so the decoded
+      // byte values are used as-is, same as sRGB.
+      return sRGB_to_sRGB_convertYCbCrToRGB(Y, Cb, Cr, RPtr, GPtr, BPtr, 1);
+    }
+  }
+}
+
+// Decode 4:2:0 planes into opaque BGRA pixels. Each CbCr
+// sample is shared by the 2x2 block of Y samples it covers.
+
+static inline
+void bt709_decode_frame(const uint8_t *yPtr,
+                        const uint8_t *cbPtr,
+                        const uint8_t *crPtr,
+                        int width,
+                        int height,
+                        BT709Gamma gamma,
+                        uint32_t *outPixels,
+                        int outPixelsPerRow)
+{
+  const int hw = width / 2;
+
+  for (int row = 0; row < height; row++) {
+    const uint8_t *yRowPtr = yPtr + (row * width);
+    const uint8_t *cbRowPtr = cbPtr + ((row / 2) * hw);
+    const uint8_t *crRowPtr = crPtr + ((row / 2) * hw);
+    uint32_t *outRowPtr = outPixels + (row * outPixelsPerRow);
+
+    for (int col = 0; col < width; col++) {
+      int R, G, B;
+      bt709_decode_pixel(yRowPtr[col], cbRowPtr[col / 2], crRowPtr[col / 2], gamma, &R, &G, &B);
+      outRowPtr[col] = (0xFF << 24) | (R << 16) | (G << 8) | B;
+    }
+  }
+}
+
+// An alpha channel is encoded as grayscale with the byte values
+// passed through as-is, so only the Y plane needs to be read.
+// Fill a 256 entry table that maps Y to the alpha byte.
+
+static inline
+void bt709_decode_alpha_table(uint8_t *table) {
+  for (int Y = 0; Y < 256; Y++) {
+    int R, G, B;
+    bt709_decode_pixel(Y, 128, 128, BT709GammaSrgb, &R, &G, &B);
+    table[Y] = (uint8_t) G;
+  }
+}
+
+static inline
+void bt709_decode_alpha(const uint8_t *yPtr,
+                        int width,
+                        int height,
+                        const uint8_t *table,
+                        uint8_t *outAlpha,
+                        int outBytesPerRow)
+{
+  for (int row = 0; row < height; row++) {
+    const uint8_t *yRowPtr = yPtr + (row * width);
+    uint8_t *outRowPtr = outAlpha + (row * outBytesPerRow);
+
+    for (int col = 0; col < width; col++) {
+      outRowPtr[col] = table[yRowPtr[col]];
+    }
+  }
+}
+
+#endif // _BT709_DECODE_H
@@ -0,0 +1,874 @@
+//
+//  build_plan.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only manifest parser, job planner and content hash cache
+//  used by aov_build. A manifest is parsed into clips, each clip is
+//  planned as a small graph of jobs and a job is up to date when the
+//  hash of its command, inputs and dependencies matches the hash
+//  recorded in the cache for every one of its outputs. Running the
+//  jobs is left to the caller.
+//
+//  See license.txt for license terms.
+
+#if !defined(_BUILD_PLAN_H)
+#define _BUILD_PLAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define BUILD_MAX_PATH_LEN 4096
+#define BUILD_MAX_NAME_LEN 128
+#define BUILD_MAX_LINE_LEN 8192
+#define BUILD_MAX_TOKENS 64
+#define BUILD_MAX_JOB_ARGS 32
+#define BUILD_MAX_JOB_OUTPUTS 2
+#define BUILD_MAX_JOB_DEPS 2
+#define BUILD_MAX_FRAMES 9999999
+
+typedef enum {
+  EncoderScript = 0,
+  // srgb_to_bt709 built with AOV_HAVE_X264 writes .m4v directly
+  EncoderX264 = 1
+} EncoderType;
+
+typedef struct {
+  int alpha;
+  char gamma[16];
+  // Set when -gamma appears in the manifest
+  int isGammaSet;
+  char fps[16];
+  int crf;
+  char profile[16];
+  EncoderType encoder;
+  char output[BUILD_MAX_PATH_LEN];
+} ClipSettings;
+
+typedef struct {
+  char name[BUILD_MAX_NAME_LEN];
+  char firstFrame[BUILD_MAX_PATH_LEN];
+  ClipSettings settings;
+
+  char **frames;
+  int numFrames;
+
+  uint64_t inputHash;
+} BuildClip;
+
+typedef enum {
+  JobStatePending = 0,
+  JobStateRunning,
+  JobStateDone,
+  JobStateCached,
+  JobStateFailed,
+  JobStateSkipped
+} JobState;
+
+typedef struct {
+  char name[BUILD_MAX_NAME_LEN + 16];
+  int clipIndex;
+
+  char *argv[BUILD_MAX_JOB_ARGS + 1];
+  int argc;
+
+  char outputs[BUILD_MAX_JOB_OUTPUTS][BUILD_MAX_PATH_LEN];
+  int numOutputs;
+
+  // Intermediate outputs are deleted once all dependents are done
+  int isIntermediate;
+
+  int deps[BUILD_MAX_JOB_DEPS];
+  int numDeps;
+
+  // Number of CPU slots held while the job runs
+  int cost;
+
+  uint64_t hash;
+  int needsRun;
+  JobState state;
+
+  pid_t pid;
+  double startTime;
+  double seconds;
+  int exitStatus;
+} BuildJob;
+
+// Content hash of one input file, reused while size and mtime match
+
+typedef struct {
+  char *path;
+  int64_t size;
+  int64_t mtime;
+  uint64_t hash;
+  // Set when the entry was used by this build
+  int isLive;
+} CacheInput;
+
+typedef struct {
+  char *path;
+  uint64_t hash;
+} CacheOutput;
+
+typedef struct {
+  CacheInput *inputs;
+  int numInputs;
+  int maxInputs;
+
+  CacheOutput *outputs;
+  int numOutputs;
+  int maxOutputs;
+} BuildCache;
+
+typedef struct {
+  const char *manifestPath;
+  char manifestDir[BUILD_MAX_PATH_LEN];
+  const char *buildDir;
+  const char *outDir;
+  const char *toolsDir;
+  const char *progressPath;
+
+  int numSlots;
+  int encodeCost;
+  int numThreads;
+  int keepIntermediate;
+  int force;
+  int dryRun;
+
+  BuildClip *clips;
+  int numClips;
+  int maxClips;
+
+  BuildJob *jobs;
+  int numJobs;
+  int maxJobs;
+
+  BuildCache cache;
+
+  FILE *progressFile;
+  struct timespec startTime;
+
+  // Files hashed on the thread pool
+  CacheInput **hashQueue;
+  int numHashQueue;
+  int nextHash;
+} BuildPlan;
+
+// 64 bit FNV-1a
+
+#define BUILD_FNV_OFFSET 0xcbf29ce484222325ULL
+#define BUILD_FNV_PRIME 0x100000001b3ULL
+
+static inline
+uint64_t build_fnv_update(uint64_t hash, const void *bytes, size_t numBytes) {
+  const uint8_t *ptr = (const uint8_t *) bytes;
+  for (size_t i = 0; i < numBytes; i++) {
+    hash ^= ptr[i];
+    hash *= BUILD_FNV_PRIME;
+  }
+  return hash;
+}
+
+static inline
+uint64_t build_fnv_update_str(uint64_t hash, const char *str) {
+  // Include the terminator so that "ab" "c" differs from "a" "bc"
+  return build_fnv_update(hash, str, strlen(str) + 1);
+}
+
+static inline
+uint64_t build_fnv_update_u64(uint64_t hash, uint64_t v) {
+  return build_fnv_update(hash, &v, sizeof(v));
+}
+
+static inline
+int build_hash_file(const char *path, uint64_t *hashPtr) {
+  FILE *inFile = fopen(path, "rb");
+
+  if (inFile == NULL) {
+    return 1;
+  }
+
+  uint8_t buffer[64 * 1024];
+  uint64_t hash = BUILD_FNV_OFFSET;
+  size_t numRead;
+
+  while ((numRead = fread(buffer, 1, sizeof(buffer), inFile)) > 0) {
+    hash = build_fnv_update(hash, buffer, numRead);
+  }
+
+  int err = ferror(inFile) ? 1 : 0;
+  fclose(inFile);
+
+  *hashPtr = hash;
+  return err;
+}
+
+static inline
+int build_file_exists(const char *path) {
+  return access(path, F_OK) == 0;
+}
+
+// Check the result of snprintf into a path buffer, a truncated path
+// would name some other file.
+
+static inline
+int build_path_fits(int len) {
+  return len >= 0 && len < BUILD_MAX_PATH_LEN;
+}
+
+// Paths in the manifest are relative to the manifest file, returns
+// 0 on success or 1 when the path is too long.
+
+static inline
+int build_resolve_path(const BuildPlan *plan, const char *path, char *outPath) {
+  int len;
+
+  if (path[0] == '/' || plan->manifestDir[0] == '\0') {
+    len = snprintf(outPath, BUILD_MAX_PATH_LEN, "%s", path);
+  } else {
+    len = snprintf(outPath, BUILD_MAX_PATH_LEN, "%s/%s", plan->manifestDir, path);
+  }
+
+  return build_path_fits(len) ? 0 : 1;
+}
+
+// Cache file, one entry per line with the path last:
+//
+// input HASH SIZE MTIME PATH
+// output HASH PATH
+
+static inline
+CacheInput* build_cache_find_input(BuildCache *cache, const char *path) {
+  for (int i = 0; i < cache->numInputs; i++) {
+    if (strcmp(cache->inputs[i].path, path) == 0) {
+      return &cache->inputs[i];
+    }
+  }
+  return NULL;
+}
+
+static inline
+CacheInput* build_cache_add_input(BuildCache *cache, const char *path) {
+  if (cache->numInputs == cache->maxInputs) {
+    cache->maxInputs = (cache->maxInputs == 0) ? 256 : (cache->maxInputs * 2);
+    cache->inputs = (CacheInput *) realloc(cache->inputs, cache->maxInputs * sizeof(CacheInput));
+  }
+
+  CacheInput *input = &cache->inputs[cache->numInputs++];
+  memset(input, 0, sizeof(CacheInput));
+  input->path = strdup(path);
+  return input;
+}
+
+static inline
+CacheOutput* build_cache_find_output(BuildCache *cache, const char *path) {
+  for (int i = 0; i < cache->numOutputs; i++) {
+    if (strcmp(cache->outputs[i].path, path) == 0) {
+      return &cache->outputs[i];
+    }
+  }
+  return NULL;
+}
+
+static inline
+void build_cache_set_output(BuildCache *cache, const char *path, uint64_t hash) {
+  CacheOutput *output = build_cache_find_output(cache, path);
+
+  if (output == NULL) {
+    if (cache->numOutputs == cache->maxOutputs) {
+      cache->maxOutputs = (cache->maxOutputs == 0) ? 64 : (cache->maxOutputs * 2);
+      cache->outputs = (CacheOutput *) realloc(cache->outputs, cache->maxOutputs * sizeof(CacheOutput));
+    }
+    output = &cache->outputs[cache->numOutputs++];
+    output->path = strdup(path);
+  }
+
+  output->hash = hash;
+}
+
+static inline
+void build_cache_read(BuildCache *cache, const char *cachePath) {
+  FILE *inFile = fopen(cachePath, "r");
+
+  if (inFile == NULL) {
+    return;
+  }
+
+  char line[BUILD_MAX_LINE_LEN];
+
+  while (fgets(line, sizeof(line), inFile) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+
+    unsigned long long hash;
+    long long size;
+    long long mtime;
+    int pathOffset = 0;
+
+    if (sscanf(line, "input %llx %lld %lld %n", &hash, &size, &mtime, &pathOffset) == 3 && pathOffset > 0) {
+      CacheInput *input = build_cache_add_input(cache, line + pathOffset);
+      input->hash = hash;
+      input->size = size;
+      input->mtime = mtime;
+    } else if (sscanf(line, "output %llx %n", &hash, &pathOffset) == 1 && pathOffset > 0) {
+      build_cache_set_output(cache, line + pathOffset, hash);
+    }
+  }
+
+  fclose(inFile);
+}
+
+// Input entries not used by this build are dropped so that the cache
+// does not grow without bound as frames are renamed.
+
+static inline
+int build_cache_write(const BuildCache *cache, const char *cachePath) {
+  char tmpPath[BUILD_MAX_PATH_LEN];
+
+  if (!build_path_fits(snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cachePath))) {
+    return 1;
+  }
+
+  FILE *outFile = fopen(tmpPath, "w");
+
+  if (outFile == NULL) {
+    return 1;
+  }
+
+  for (int i = 0; i < cache->numInputs; i++) {
+    const CacheInput *input = &cache->inputs[i];
+    if (input->isLive) {
+      fprintf(outFile, "input %016llx %lld %lld %s\n",
+              (unsigned long long) input->hash, (long long) input->size, (long long) input->mtime, input->path);
+    }
+  }
+
+  for (int i = 0; i < cache->numOutputs; i++) {
+    const CacheOutput *output = &cache->outputs[i];
+    fprintf(outFile, "output %016llx %s\n", (unsigned long long) output->hash, output->path);
+  }
+
+  if (fclose(outFile) != 0) {
+    return 1;
+  }
+
+  // Replace atomically so an interrupted build leaves the old cache
+  return rename(tmpPath, cachePath);
+}
+
+// Manifest parsing
+
+static inline
+int build_tokenize(char *line, char **tokens) {
+  int numTokens = 0;
+  char *p = line;
+
+  while (*p != '\0' && numTokens < BUILD_MAX_TOKENS) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+      p++;
+    }
+
+    if (*p == '\0' || *p == '#') {
+      break;
+    }
+
+    if (*p == '"') {
+      p++;
+      tokens[numTokens++] = p;
+      while (*p != '\0' && *p != '"') {
+        p++;
+      }
+    } else {
+      tokens[numTokens++] = p;
+      while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+        p++;
+      }
+    }
+
+    if (*p != '\0') {
+      *p++ = '\0';
+    }
+  }
+
+  return numTokens;
+}
+
+// Parse "-option value" pairs, returns 0 on success
+
+static inline
+int build_parse_settings(char **tokens, int numTokens, ClipSettings *settings, const char *manifestPath, int lineNum) {
+  for (int i = 0; i < numTokens; i += 2) {
+    const char *option = tokens[i];
+
+    if (i == (numTokens - 1)) {
+      fprintf(stderr, "%s:%d: option \"%s\" needs a value\n", manifestPath, lineNum, option);
+      return 1;
+    }
+
+    const char *value = tokens[i + 1];
+
+    if (strcmp(option, "-alpha") == 0) {
+      settings->alpha = atoi(value);
+    } else if (strcmp(option, "-gamma") == 0) {
+      if (strcmp(value, "apple") != 0 && strcmp(value, "srgb") != 0 && strcmp(value, "linear") != 0) {
+        fprintf(stderr, "%s:%d: unknown -gamma \"%s\"\n", manifestPath, lineNum, value);
+        return 1;
+      }
+      snprintf(settings->gamma, sizeof(settings->gamma), "%s", value);
+      settings->isGammaSet = 1;
+    } else if (strcmp(option, "-fps") == 0) {
+      snprintf(settings->fps, sizeof(settings->fps), "%s", value);
+    } else if (strcmp(option, "-crf") == 0) {
+      settings->crf = atoi(value);
+    } else if (strcmp(option, "-profile") == 0) {
+      snprintf(settings->profile, sizeof(settings->profile), "%s", value);
+    } else if (strcmp(option, "-encoder") == 0) {
+      if (strcmp(value, "script") == 0) {
+        settings->encoder = EncoderScript;
+      } else if (strcmp(value, "x264") == 0) {
+        settings->encoder = EncoderX264;
+      } else {
+        fprintf(stderr, "%s:%d: unknown -encoder \"%s\"\n", manifestPath, lineNum, value);
+        return 1;
+      }
+    } else if (strcmp(option, "-output") == 0) {
+      // The _alpha video is named by replacing the .m4v extension
+      size_t len = strlen(value);
+      if (len <= 4 || strcmp(value + len - 4, ".m4v") != 0) {
+        fprintf(stderr, "%s:%d: -output \"%s\" must be a FILE.m4v path\n", manifestPath, lineNum, value);
+        return 1;
+      }
+      if (len >= sizeof(settings->output)) {
+        fprintf(stderr, "%s:%d: -output path too long\n", manifestPath, lineNum);
+        return 1;
+      }
+      snprintf(settings->output, sizeof(settings->output), "%s", value);
+    } else {
+      fprintf(stderr, "%s:%d: unknown option \"%s\"\n", manifestPath, lineNum, option);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static inline
+int build_parse_manifest(BuildPlan *plan) {
+  FILE *inFile = fopen(plan->manifestPath, "r");
+
+  if (inFile == NULL) {
+    fprintf(stderr, "can't read manifest \"%s\"\n", plan->manifestPath);
+    return 1;
+  }
+
+  // Defaults match the FFMPEG scripts
+
+  ClipSettings defaults;
+  memset(&defaults, 0, sizeof(defaults));
+  snprintf(defaults.gamma, sizeof(defaults.gamma), "apple");
+  snprintf(defaults.fps, sizeof(defaults.fps), "30");
+  defaults.crf = 23;
+  snprintf(defaults.profile, sizeof(defaults.profile), "main");
+  defaults.encoder = EncoderScript;
+
+  char line[BUILD_MAX_LINE_LEN];
+  char *tokens[BUILD_MAX_TOKENS];
+  int lineNum = 0;
+  int err = 0;
+
+  while (err == 0 && fgets(line, sizeof(line), inFile) != NULL) {
+    lineNum++;
+
+    int numTokens = build_tokenize(line, tokens);
+
+    if (numTokens == 0) {
+      continue;
+    }
+
+    if (strcmp(tokens[0], "defaults") == 0) {
+      err = build_parse_settings(tokens + 1, numTokens - 1, &defaults, plan->manifestPath, lineNum);
+      // Output path only applies to a single clip
+      defaults.output[0] = '\0';
+    } else if (strcmp(tokens[0], "clip") == 0) {
+      if (numTokens < 3) {
+        fprintf(stderr, "%s:%d: expected clip NAME FIRST_FRAME ?OPTIONS?\n", plan->manifestPath, lineNum);
+        err = 1;
+        break;
+      }
+
+      for (int i = 0; i < plan->numClips; i++) {
+        if (strcmp(plan->clips[i].name, tokens[1]) == 0) {
+          fprintf(stderr, "%s:%d: duplicate clip \"%s\"\n", plan->manifestPath, lineNum, tokens[1]);
+          err = 1;
+        }
+      }
+
+      if (plan->numClips == plan->maxClips) {
+        plan->maxClips = (plan->maxClips == 0) ? 16 : (plan->maxClips * 2);
+        plan->clips = (BuildClip *) realloc(plan->clips, plan->maxClips * sizeof(BuildClip));
+      }
+
+      BuildClip *clip = &plan->clips[plan->numClips++];
+      memset(clip, 0, sizeof(BuildClip));
+      snprintf(clip->name, sizeof(clip->name), "%s", tokens[1]);
+      clip->settings = defaults;
+
+      if (build_resolve_path(plan, tokens[2], clip->firstFrame) != 0) {
+        fprintf(stderr, "%s:%d: path too long \"%s\"\n", plan->manifestPath, lineNum, tokens[2]);
+        err = 1;
+      }
+
+      if (err == 0) {
+        err = build_parse_settings(tokens + 3, numTokens - 3, &clip->settings, plan->manifestPath, lineNum);
+      }
+
+      // Only sRGB gamma is supported with an alpha channel, srgb_to_bt709
+      // rejects any other gamma. Alpha clips default to sRGB.
+
+      if (err == 0 && clip->settings.alpha) {
+        if (clip->settings.isGammaSet && strcmp(clip->settings.gamma, "srgb") != 0) {
+          fprintf(stderr, "%s:%d: -alpha 1 requires -gamma srgb, not \"%s\"\n", plan->manifestPath, lineNum, clip->settings.gamma);
+          err = 1;
+        } else {
+          snprintf(clip->settings.gamma, sizeof(clip->settings.gamma), "srgb");
+        }
+      }
+    } else {
+      fprintf(stderr, "%s:%d: unknown entry \"%s\"\n", plan->manifestPath, lineNum, tokens[0]);
+      err = 1;
+    }
+  }
+
+  fclose(inFile);
+
+  if (err == 0 && plan->numClips == 0) {
+    fprintf(stderr, "no clips in manifest \"%s\"\n", plan->manifestPath);
+    err = 1;
+  }
+
+  return err;
+}
+
+// Planning
+
+static inline
+BuildJob* build_add_job(BuildPlan *plan, int clipIndex, const char *stage) {
+  if (plan->numJobs == plan->maxJobs) {
+    plan->maxJobs = (plan->maxJobs == 0) ? 64 : (plan->maxJobs * 2);
+    plan->jobs = (BuildJob *) realloc(plan->jobs, plan->maxJobs * sizeof(BuildJob));
+  }
+
+  BuildJob *job = &plan->jobs[plan->numJobs++];
+  memset(job, 0, sizeof(BuildJob));
+  job->clipIndex = clipIndex;
+  job->cost = 1;
+  job->pid = -1;
+  snprintf(job->name, sizeof(job->name), "%s/%s", plan->clips[clipIndex].name, stage);
+  return job;
+}
+
+static inline
+void build_job_add_arg(BuildJob *job, const char *arg) {
+  if (job->argc < BUILD_MAX_JOB_ARGS) {
+    job->argv[job->argc++] = strdup(arg);
+    job->argv[job->argc] = NULL;
+  }
+}
+
+static inline
+int build_job_add_tool(BuildPlan *plan, BuildJob *job, const char *tool) {
+  char toolPath[BUILD_MAX_PATH_LEN];
+  int len;
+
+  if (plan->toolsDir != NULL) {
+    len = snprintf(toolPath, sizeof(toolPath), "%s/%s", plan->toolsDir, tool);
+  } else {
+    len = snprintf(toolPath, sizeof(toolPath), "%s", tool);
+  }
+
+  if (!build_path_fits(len)) {
+    return 1;
+  }
+
+  build_job_add_arg(job, toolPath);
+  return 0;
+}
+
+static inline
+const char* build_encode_script_for_gamma(const char *gamma) {
+  if (strcmp(gamma, "srgb") == 0) {
+    return "ext_ffmpeg_encode_srgb_crf.sh";
+  } else if (strcmp(gamma, "linear") == 0) {
+    return "ext_ffmpeg_encode_linear_crf.sh";
+  }
+  return "ext_ffmpeg_encode_bt709_crf.sh";
+}
+
+static inline
+int build_add_encode_job(BuildPlan *plan, int clipIndex, int convertIndex, const char *stage,
+                          const char *script, const char *inPath, const char *outPath) {
+  BuildClip *clip = &plan->clips[clipIndex];
+  BuildJob *job = build_add_job(plan, clipIndex, stage);
+
+  char crfStr[16];
+  snprintf(crfStr, sizeof(crfStr), "%d", clip->settings.crf);
+
+  if (build_job_add_tool(plan, job, script) != 0) {
+    return 1;
+  }
+
+  build_job_add_arg(job, inPath);
+  build_job_add_arg(job, outPath);
+  build_job_add_arg(job, crfStr);
+  build_job_add_arg(job, clip->settings.profile);
+
+  snprintf(job->outputs[job->numOutputs++], BUILD_MAX_PATH_LEN, "%s", outPath);
+
+  job->deps[job->numDeps++] = convertIndex;
+  job->cost = plan->encodeCost;
+  return 0;
+}
+
+// Plan the jobs of each clip. Jobs are appended after the jobs
+// they depend on, so array order is a topological order. Returns 0
+// on success or 1 when a path is too long.
+
+static inline
+int build_plan_clip_jobs(BuildPlan *plan, int clipIndex) {
+  BuildClip *clip = &plan->clips[clipIndex];
+  const ClipSettings *settings = &clip->settings;
+
+  char outPath[BUILD_MAX_PATH_LEN];
+  char outAlphaPath[BUILD_MAX_PATH_LEN];
+  char y4mPath[BUILD_MAX_PATH_LEN];
+  char y4mAlphaPath[BUILD_MAX_PATH_LEN];
+
+  if (settings->output[0] != '\0') {
+    if (build_resolve_path(plan, settings->output, outPath) != 0) {
+      return 1;
+    }
+  } else {
+    if (!build_path_fits(snprintf(outPath, sizeof(outPath), "%s/%s.m4v", plan->outDir, clip->name))) {
+      return 1;
+    }
+  }
+
+  // Both paths end in .m4v, an -output path is checked when parsed
+
+  if (!build_path_fits(snprintf(outAlphaPath, sizeof(outAlphaPath), "%.*s_alpha.m4v", (int) (strlen(outPath) - 4), outPath)) ||
+      !build_path_fits(snprintf(y4mPath, sizeof(y4mPath), "%s/%s.y4m", plan->buildDir, clip->name)) ||
+      !build_path_fits(snprintf(y4mAlphaPath, sizeof(y4mAlphaPath), "%s/%s_alpha.y4m", plan->buildDir, clip->name))) {
+    return 1;
+  }
+
+  const int convertIndex = plan->numJobs;
+  BuildJob *convert = build_add_job(plan, clipIndex, "convert");
+
+  char crfStr[16];
+  snprintf(crfStr, sizeof(crfStr), "%d", settings->crf);
+
+  if (build_job_add_tool(plan, convert, "srgb_to_bt709") != 0) {
+    return 1;
+  }
+
+  build_job_add_arg(convert, "-alpha");
+  build_job_add_arg(convert, settings->alpha ? "1" : "0");
+  build_job_add_arg(convert, "-gamma");
+  build_job_add_arg(convert, settings->gamma);
+  build_job_add_arg(convert, "-fps");
+  build_job_add_arg(convert, settings->fps);
+
+  if (settings->encoder == EncoderX264) {
+    // One job converts and encodes both videos
+
+    build_job_add_arg(convert, "-crf");
+    build_job_add_arg(convert, crfStr);
+    build_job_add_arg(convert, "-profile");
+    build_job_add_arg(convert, settings->profile);
+    build_job_add_arg(convert, "-frames");
+    build_job_add_arg(convert, clip->firstFrame);
+    build_job_add_arg(convert, outPath);
+
+    snprintf(convert->outputs[convert->numOutputs++], BUILD_MAX_PATH_LEN, "%s", outPath);
+    if (settings->alpha) {
+      snprintf(convert->outputs[convert->numOutputs++], BUILD_MAX_PATH_LEN, "%s", outAlphaPath);
+    }
+
+    convert->cost = plan->encodeCost;
+    return 0;
+  }
+
+  build_job_add_arg(convert, "-frames");
+  build_job_add_arg(convert, clip->firstFrame);
+  build_job_add_arg(convert, y4mPath);
+
+  snprintf(convert->outputs[convert->numOutputs++], BUILD_MAX_PATH_LEN, "%s", y4mPath);
+  if (settings->alpha) {
+    snprintf(convert->outputs[convert->numOutputs++], BUILD_MAX_PATH_LEN, "%s", y4mAlphaPath);
+  }
+
+  convert->isIntermediate = !plan->keepIntermediate;
+
+  // RGB and alpha encodes can run at the same time
+
+  if (build_add_encode_job(plan, clipIndex, convertIndex, "encode", build_encode_script_for_gamma(settings->gamma), y4mPath, outPath) != 0) {
+    return 1;
+  }
+
+  if (settings->alpha) {
+    if (build_add_encode_job(plan, clipIndex, convertIndex, "encode_alpha", "ext_ffmpeg_encode_linear_crf.sh", y4mAlphaPath, outAlphaPath) != 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Find the file a tool is run from the same way posix_spawnp does, a
+// name without a slash is searched for in PATH. Returns 0 on success.
+
+static inline
+int build_stat_tool(const char *tool, struct stat *st) {
+  if (strchr(tool, '/') != NULL) {
+    return stat(tool, st);
+  }
+
+  const char *dirs = getenv("PATH");
+
+  if (dirs == NULL) {
+    dirs = "/usr/bin:/bin";
+  }
+
+  while (1) {
+    const char *end = strchr(dirs, ':');
+    int dirLen = (end != NULL) ? (int) (end - dirs) : (int) strlen(dirs);
+
+    char toolPath[BUILD_MAX_PATH_LEN];
+
+    // An empty entry is the current dir
+
+    if (build_path_fits(snprintf(toolPath, sizeof(toolPath), "%.*s%s%s", dirLen, dirs, (dirLen > 0) ? "/" : "", tool)) &&
+        stat(toolPath, st) == 0 && S_ISREG(st->st_mode)) {
+      return 0;
+    }
+
+    if (end == NULL) {
+      return -1;
+    }
+
+    dirs = end + 1;
+  }
+}
+
+// Job hash covers the command line, the size and modification time of
+// the tool, the clip inputs and the hashes of the jobs it depends on,
+// so it is known before any job runs. A rebuilt srgb_to_bt709 or an
+// edited encode script reruns the jobs that use it.
+
+static inline
+void build_hash_jobs(BuildPlan *plan) {
+  for (int i = 0; i < plan->numJobs; i++) {
+    BuildJob *job = &plan->jobs[i];
+    uint64_t hash = BUILD_FNV_OFFSET;
+
+    for (int j = 0; j < job->argc; j++) {
+      hash = build_fnv_update_str(hash, job->argv[j]);
+    }
+
+    struct stat st;
+
+    if (job->argc > 0 && build_stat_tool(job->argv[0], &st) == 0) {
+      hash = build_fnv_update_u64(hash, (uint64_t) st.st_size);
+      hash = build_fnv_update_u64(hash, (uint64_t) st.st_mtime);
+    }
+
+    if (job->numDeps == 0) {
+      hash = build_fnv_update_u64(hash, plan->clips[job->clipIndex].inputHash);
+    }
+
+    for (int j = 0; j < job->numDeps; j++) {
+      hash = build_fnv_update_u64(hash, plan->jobs[job->deps[j]].hash);
+    }
+
+    job->hash = hash;
+  }
+}
+
+static inline
+int build_job_is_up_to_date(BuildPlan *plan, const BuildJob *job) {
+  if (plan->force) {
+    return 0;
+  }
+
+  for (int i = 0; i < job->numOutputs; i++) {
+    const CacheOutput *output = build_cache_find_output(&plan->cache, job->outputs[i]);
+
+    if (output == NULL || output->hash != job->hash || !build_file_exists(job->outputs[i])) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// Walk jobs from last to first, a job runs when it is out of date and
+// either produces a final output or feeds a job that runs. Deleted
+// intermediates are only rebuilt when something needs them.
+
+static inline
+void build_mark_jobs_to_run(BuildPlan *plan) {
+  for (int i = plan->numJobs - 1; i >= 0; i--) {
+    BuildJob *job = &plan->jobs[i];
+
+    int isNeeded = !job->isIntermediate;
+
+    for (int j = i + 1; j < plan->numJobs; j++) {
+      const BuildJob *other = &plan->jobs[j];
+      for (int k = 0; k < other->numDeps; k++) {
+        if (other->deps[k] == i && other->needsRun) {
+          isNeeded = 1;
+        }
+      }
+    }
+
+    job->needsRun = isNeeded && !build_job_is_up_to_date(plan, job);
+    job->state = job->needsRun ? JobStatePending : JobStateCached;
+  }
+}
+
+static inline
+void build_free_plan(BuildPlan *plan) {
+  for (int i = 0; i < plan->numClips; i++) {
+    for (int j = 0; j < plan->clips[i].numFrames; j++) {
+      free(plan->clips[i].frames[j]);
+    }
+    free(plan->clips[i].frames);
+  }
+
+  for (int i = 0; i < plan->numJobs; i++) {
+    for (int j = 0; j < plan->jobs[i].argc; j++) {
+      free(plan->jobs[i].argv[j]);
+    }
+  }
+
+  for (int i = 0; i < plan->cache.numInputs; i++) {
+    free(plan->cache.inputs[i].path);
+  }
+
+  for (int i = 0; i < plan->cache.numOutputs; i++) {
+    free(plan->cache.outputs[i].path);
+  }
+
+  free(plan->clips);
+  free(plan->jobs);
+  free(plan->cache.inputs);
+  free(plan->cache.outputs);
+  free(plan->hashQueue);
+}
+
+#endif // _BUILD_PLAN_H
@@ -0,0 +1,590 @@
+//
+//  color_lut.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface to precomputed 3D lookup tables that map
+//  a 24 bit sRGB pixel to BT.709 Y Cb Cr. Each encode mode in BT.709
+//  is a pure function of (R G B), so the results can be computed
+//  once and then cached on disk and mapped into memory.
+//
+//  Full cube : every (R G B) input, 3 bytes per entry (48 MB). The
+//  output is exactly the same as the direct conversion function.
+//
+//  Tetrahedral : Y Cb Cr floats sampled on a 65^3 grid (3.3 MB) and
+//  interpolated inside one of 6 tetrahedra. The error is at most 1
+//  code value, see color_lut_measure_error().
+//
+//  A table is stored in one contiguous buffer that is also the
+//  serialized form, in host byte order. The header records a checksum
+//  of the encode function evaluated at a few probe colours, so that a
+//  cached table generated by an earlier version of BT709.h is rebuilt.
+//
+//  See license.txt for license terms.
+
+#if !defined(_COLOR_LUT_H)
+#define _COLOR_LUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "BT709.h"
+
+// 'AOVL' in host byte order
+#define COLOR_LUT_MAGIC 0x4C564F41
+#define COLOR_LUT_VERSION 2
+
+#define COLOR_LUT_ERR_IO 1
+#define COLOR_LUT_ERR_MALFORMED 2
+#define COLOR_LUT_ERR_NO_MEMORY 3
+
+// Number of grid points on each axis of a tetrahedral table
+#define COLOR_LUT_GRID_DIM 65
+
+// Encode functions from BT709.h that a table can replace
+
+typedef enum {
+  // sRGB_from_sRGB_convertRGBToYCbCr(), also used for linear input
+  ColorLutEncodeSrgb = 1,
+  // Apple196_from_sRGB_convertRGBToYCbCr()
+  ColorLutEncodeApple = 2,
+  // BT709_from_sRGB_convertRGBToYCbCr() with the gamma map applied
+  ColorLutEncodeBT709 = 3
+} ColorLutEncode;
+
+typedef enum {
+  ColorLutKindFullCube = 1,
+  ColorLutKindTetrahedral = 2
+} ColorLutKind;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t encode;
+  uint32_t kind;
+  uint64_t numDataBytes;
+  // color_lut_checksum() of the encode and kind
+  uint64_t checksum;
+} ColorLutHeader;
+
+typedef struct {
+  ColorLutEncode encode;
+  ColorLutKind kind;
+
+  // Full cube : (Y Cb Cr) bytes at ((R << 16) | (G << 8) | B) * 3
+  const uint8_t *cube;
+  // Tetrahedral : (Y Cb Cr) floats at (((r * 65) + g) * 65 + b) * 3
+  const float *grid;
+
+  // Grid cell and position in the cell for each byte value
+  uint8_t cellIndex[256];
+  float cellFrac[256];
+
+  // Contiguous serialized form of the table
+  const uint8_t *bytes;
+  uint64_t numBytes;
+
+  // Non-NULL when the table owns the buffer
+  uint8_t *storage;
+  // Non-NULL when the table was mapped from a file
+  void *mapping;
+} ColorLut;
+
+// Direct evaluation of the encode function
+
+static inline
+void color_lut_encode_pixel(ColorLutEncode encode, int R, int G, int B, int *Y, int *Cb, int *Cr) {
+  if (encode == ColorLutEncodeApple) {
+    Apple196_from_sRGB_convertRGBToYCbCr(R, G, B, Y, Cb, Cr);
+  } else if (encode == ColorLutEncodeBT709) {
+    BT709_from_sRGB_convertRGBToYCbCr(R, G, B, Y, Cb, Cr, 1);
+  } else {
+    sRGB_from_sRGB_convertRGBToYCbCr(R, G, B, Y, Cb, Cr);
+  }
+}
+
+// The gamma steps of every encode function are applied to each
+// component on its own before the matrix transform. This returns
+// the normalized component that is passed to the matrix.
+
+static inline
+float color_lut_gamma_component(ColorLutEncode encode, float normV) {
+  if (encode == ColorLutEncodeApple) {
+    return Apple196_linearNormToNonLinear(sRGB_nonLinearNormToLinear(normV));
+  } else if (encode == ColorLutEncodeBT709) {
+    return BT709_linearNormToNonLinear(sRGB_nonLinearNormToLinear(normV));
+  } else {
+    return normV;
+  }
+}
+
+// Matrix transform from BT709_convertNonLinearRGBToYCbCr() without rounding
+
+static inline
+void color_lut_matrix_unrounded(float Rn, float Gn, float Bn, float *out) {
+  float Ey = (BT709_Kr * Rn) + (BT709_Kg * Gn) + (BT709_Kb * Bn);
+  float Eb = (Bn - Ey) / BT709_Eb_minus_Ey_Range;
+  float Er = (Rn - Ey) / BT709_Er_minus_Ey_Range;
+
+  out[0] = (Ey * (BT709_YMax-BT709_YMin)) + 16;
+  out[1] = (Eb * (BT709_UVMax-BT709_UVMin)) + 128;
+  out[2] = (Er * (BT709_UVMax-BT709_UVMin)) + 128;
+}
+
+// FNV-1a hash of the bytes of a value
+
+static inline
+uint64_t color_lut_hash(uint64_t hash, const void *ptr, size_t numBytes) {
+  const uint8_t *bytes = (const uint8_t *) ptr;
+
+  for (size_t i = 0; i < numBytes; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+  }
+
+  return hash;
+}
+
+// Checksum of the values a table is generated from. The rounded
+// output of the encode function and the unrounded matrix output are
+// hashed for a few probe colours that cover both ends of the gamma
+// curve and each primary. Any change to the gamma curves, the matrix
+// or the rounding in BT709.h changes the checksum.
+
+static inline
+uint64_t color_lut_checksum(ColorLutEncode encode, ColorLutKind kind) {
+  static const uint8_t probes[][3] = {
+    { 0, 0, 0 }, { 1, 1, 1 }, { 4, 4, 4 }, { 16, 16, 16 },
+    { 64, 128, 192 }, { 128, 128, 128 }, { 254, 254, 254 }, { 255, 255, 255 },
+    { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }, { 255, 0, 255 }
+  };
+
+  const uint32_t params[3] = { (uint32_t) encode, (uint32_t) kind, COLOR_LUT_GRID_DIM };
+  uint64_t hash = color_lut_hash(0xCBF29CE484222325ULL, params, sizeof(params));
+
+  for (int i = 0; i < (int) (sizeof(probes) / sizeof(probes[0])); i++) {
+    const int R = probes[i][0];
+    const int G = probes[i][1];
+    const int B = probes[i][2];
+
+    int YCbCr[3];
+    color_lut_encode_pixel(encode, R, G, B, &YCbCr[0], &YCbCr[1], &YCbCr[2]);
+    hash = color_lut_hash(hash, YCbCr, sizeof(YCbCr));
+
+    float unrounded[3];
+    color_lut_matrix_unrounded(color_lut_gamma_component(encode, byteNorm(R)),
+                               color_lut_gamma_component(encode, byteNorm(G)),
+                               color_lut_gamma_component(encode, byteNorm(B)),
+                               unrounded);
+    hash = color_lut_hash(hash, unrounded, sizeof(unrounded));
+  }
+
+  return hash;
+}
+
+static inline
+uint64_t color_lut_num_data_bytes(ColorLutKind kind) {
+  if (kind == ColorLutKindFullCube) {
+    return (uint64_t) 256 * 256 * 256 * 3;
+  } else {
+    return (uint64_t) COLOR_LUT_GRID_DIM * COLOR_LUT_GRID_DIM * COLOR_LUT_GRID_DIM * 3 * sizeof(float);
+  }
+}
+
+// Point the table into a serialized buffer after checking the
+// header. Returns 0 on success.
+
+static inline
+int color_lut_open_buffer(const uint8_t *bytes, uint64_t numBytes, ColorLut *lut) {
+  memset(lut, 0, sizeof(ColorLut));
+
+  if (numBytes < sizeof(ColorLutHeader) || (((uintptr_t) bytes) & 0x7) != 0) {
+    return COLOR_LUT_ERR_MALFORMED;
+  }
+
+  const ColorLutHeader *header = (const ColorLutHeader *) bytes;
+
+  if (header->magic != COLOR_LUT_MAGIC || header->version != COLOR_LUT_VERSION) {
+    return COLOR_LUT_ERR_MALFORMED;
+  }
+
+  if (header->encode < ColorLutEncodeSrgb || header->encode > ColorLutEncodeBT709) {
+    return COLOR_LUT_ERR_MALFORMED;
+  }
+
+  if (header->kind != ColorLutKindFullCube && header->kind != ColorLutKindTetrahedral) {
+    return COLOR_LUT_ERR_MALFORMED;
+  }
+
+  if (header->numDataBytes != color_lut_num_data_bytes((ColorLutKind) header->kind) ||
+      numBytes != (sizeof(ColorLutHeader) + header->numDataBytes)) {
+    return COLOR_LUT_ERR_MALFORMED;
+  }
+
+  lut->encode = (ColorLutEncode) header->encode;
+  lut->kind = (ColorLutKind) header->kind;
+
+  if (lut->kind == ColorLutKindFullCube) {
+    lut->cube = bytes + sizeof(ColorLutHeader);
+  } else {
+    lut->grid = (const float *) (bytes + sizeof(ColorLutHeader));
+  }
+
+  // Byte 255 is placed at the far edge of the last cell so that
+  // the cell + 1 grid point always exists.
+
+  for (int v = 0; v < 256; v++) {
+    const int scaled = v * (COLOR_LUT_GRID_DIM - 1);
+    int cell = scaled / 255;
+    float frac = (float) (scaled % 255) / 255.0f;
+
+    if (cell == (COLOR_LUT_GRID_DIM - 1)) {
+      cell -= 1;
+      frac = 1.0f;
+    }
+
+    lut->cellIndex[v] = (uint8_t) cell;
+    lut->cellFrac[v] = frac;
+  }
+
+  lut->bytes = bytes;
+  lut->numBytes = numBytes;
+
+  return 0;
+}
+
+static inline
+void color_lut_free(ColorLut *lut) {
+  if (lut->mapping) {
+    munmap(lut->mapping, (size_t) lut->numBytes);
+  }
+  free(lut->storage);
+  memset(lut, 0, sizeof(ColorLut));
+}
+
+// Compute a table in memory, returns 0 on success
+
+static inline
+int color_lut_build(ColorLutEncode encode, ColorLutKind kind, ColorLut *lut) {
+  memset(lut, 0, sizeof(ColorLut));
+
+  const uint64_t numDataBytes = color_lut_num_data_bytes(kind);
+  const uint64_t numBytes = sizeof(ColorLutHeader) + numDataBytes;
+
+  uint8_t *storage = (uint8_t *) malloc((size_t) numBytes);
+
+  if (storage == NULL) {
+    return COLOR_LUT_ERR_NO_MEMORY;
+  }
+
+  ColorLutHeader *header = (ColorLutHeader *) storage;
+  memset(header, 0, sizeof(ColorLutHeader));
+  header->magic = COLOR_LUT_MAGIC;
+  header->version = COLOR_LUT_VERSION;
+  header->encode = encode;
+  header->kind = kind;
+  header->numDataBytes = numDataBytes;
+  header->checksum = color_lut_checksum(encode, kind);
+
+  if (kind == ColorLutKindFullCube) {
+    // Same float values as the direct function for each component,
+    // so that only the matrix and rounding run per entry.
+
+    float gammaTable[256];
+
+    for (int v = 0; v < 256; v++) {
+      gammaTable[v] = color_lut_gamma_component(encode, byteNorm(v));
+    }
+
+    uint8_t *cube = storage + sizeof(ColorLutHeader);
+
+    for (int R = 0; R < 256; R++) {
+      for (int G = 0; G < 256; G++) {
+        for (int B = 0; B < 256; B++) {
+          int Y, Cb, Cr;
+          BT709_convertNonLinearRGBToYCbCr(gammaTable[R], gammaTable[G], gammaTable[B], &Y, &Cb, &Cr);
+          *cube++ = (uint8_t) Y;
+          *cube++ = (uint8_t) Cb;
+          *cube++ = (uint8_t) Cr;
+        }
+      }
+    }
+  } else {
+    float gammaTable[COLOR_LUT_GRID_DIM];
+
+    for (int i = 0; i < COLOR_LUT_GRID_DIM; i++) {
+      gammaTable[i] = color_lut_gamma_component(encode, (float) i / (COLOR_LUT_GRID_DIM - 1));
+    }
+
+    float *grid = (float *) (storage + sizeof(ColorLutHeader));
+
+    for (int r = 0; r < COLOR_LUT_GRID_DIM; r++) {
+      for (int g = 0; g < COLOR_LUT_GRID_DIM; g++) {
+        for (int b = 0; b < COLOR_LUT_GRID_DIM; b++) {
+          color_lut_matrix_unrounded(gammaTable[r], gammaTable[g], gammaTable[b], grid);
+          grid += 3;
+        }
+      }
+    }
+  }
+
+  int err = color_lut_open_buffer(storage, numBytes, lut);
+
+  if (err != 0) {
+    free(storage);
+    return err;
+  }
+
+  lut->storage = storage;
+
+  return 0;
+}
+
+// Write the serialized table to a cache file, returns 0 on success.
+// The file is written under a temp name and then renamed so that a
+// reader never maps a partial table.
+
+static inline
+int color_lut_write_file(const ColorLut *lut, const char *outFilePath) {
+  char tmpPath[4096];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.%d.tmp", outFilePath, (int) getpid());
+
+  FILE *outFile = fopen(tmpPath, "wb");
+
+  if (outFile == NULL) {
+    return COLOR_LUT_ERR_IO;
+  }
+
+  int err = 0;
+
+  if (fwrite(lut->bytes, (size_t) lut->numBytes, 1, outFile) != 1) {
+    err = COLOR_LUT_ERR_IO;
+  }
+
+  if (fclose(outFile) != 0) {
+    err = COLOR_LUT_ERR_IO;
+  }
+
+  if (err == 0 && rename(tmpPath, outFilePath) != 0) {
+    err = COLOR_LUT_ERR_IO;
+  }
+
+  if (err != 0) {
+    unlink(tmpPath);
+  }
+
+  return err;
+}
+
+// Map a cache file written by color_lut_write_file(), the table
+// must match the encode and kind and must have been generated from
+// the same encode function. Returns 0 on success.
+
+static inline
+int color_lut_map_file(const char *inFilePath, ColorLutEncode encode, ColorLutKind kind, ColorLut *lut) {
+  memset(lut, 0, sizeof(ColorLut));
+
+  int fd = open(inFilePath, O_RDONLY);
+
+  if (fd == -1) {
+    return COLOR_LUT_ERR_IO;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return COLOR_LUT_ERR_IO;
+  }
+
+  const uint64_t numBytes = (uint64_t) st.st_size;
+
+  if (numBytes != (sizeof(ColorLutHeader) + color_lut_num_data_bytes(kind))) {
+    close(fd);
+    return COLOR_LUT_ERR_MALFORMED;
+  }
+
+  void *mapping = mmap(NULL, (size_t) numBytes, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    return COLOR_LUT_ERR_IO;
+  }
+
+  int err = color_lut_open_buffer((const uint8_t *) mapping, numBytes, lut);
+
+  if (err == 0 && (lut->encode != encode || lut->kind != kind)) {
+    err = COLOR_LUT_ERR_MALFORMED;
+  }
+
+  if (err == 0 && ((const ColorLutHeader *) mapping)->checksum != color_lut_checksum(encode, kind)) {
+    err = COLOR_LUT_ERR_MALFORMED;
+  }
+
+  if (err != 0) {
+    munmap(mapping, (size_t) numBytes);
+    memset(lut, 0, sizeof(ColorLut));
+    return err;
+  }
+
+  lut->mapping = mapping;
+
+  return 0;
+}
+
+// Map a cached table or build it and then write the cache. A cache
+// that cannot be written is not an error. Returns 0 on success.
+
+static inline
+int color_lut_load(const char *cacheFilePath, ColorLutEncode encode, ColorLutKind kind, ColorLut *lut) {
+  if (cacheFilePath != NULL && color_lut_map_file(cacheFilePath, encode, kind, lut) == 0) {
+    return 0;
+  }
+
+  int err = color_lut_build(encode, kind, lut);
+
+  if (err != 0) {
+    return err;
+  }
+
+  if (cacheFilePath != NULL) {
+    color_lut_write_file(lut, cacheFilePath);
+  }
+
+  return 0;
+}
+
+// Tetrahedral interpolation of the 8 grid points around (R G B)
+
+static inline
+void color_lut_interpolate(const ColorLut *lut, int R, int G, int B, int *Y, int *Cb, int *Cr) {
+  const int dim = COLOR_LUT_GRID_DIM;
+
+  const float fr = lut->cellFrac[R];
+  const float fg = lut->cellFrac[G];
+  const float fb = lut->cellFrac[B];
+
+  const float *c000 = lut->grid + ((((lut->cellIndex[R] * dim) + lut->cellIndex[G]) * dim) + lut->cellIndex[B]) * 3;
+
+  const int dr = dim * dim * 3;
+  const int dg = dim * 3;
+  const int db = 3;
+
+  const float *c111 = c000 + dr + dg + db;
+
+  // Walk from c000 to c111 along the edges picked by the order
+  // of the fractions, each step is weighted by one fraction.
+
+  const float *p1;
+  const float *p2;
+  float w1, w2, w3;
+
+  if (fr >= fg) {
+    if (fg >= fb) {
+      p1 = c000 + dr; p2 = c000 + dr + dg; w1 = fr; w2 = fg; w3 = fb;
+    } else if (fr >= fb) {
+      p1 = c000 + dr; p2 = c000 + dr + db; w1 = fr; w2 = fb; w3 = fg;
+    } else {
+      p1 = c000 + db; p2 = c000 + dr + db; w1 = fb; w2 = fr; w3 = fg;
+    }
+  } else {
+    if (fr >= fb) {
+      p1 = c000 + dg; p2 = c000 + dr + dg; w1 = fg; w2 = fr; w3 = fb;
+    } else if (fg >= fb) {
+      p1 = c000 + dg; p2 = c000 + dg + db; w1 = fg; w2 = fb; w3 = fr;
+    } else {
+      p1 = c000 + db; p2 = c000 + dg + db; w1 = fb; w2 = fg; w3 = fr;
+    }
+  }
+
+  int out[3];
+
+  for (int c = 0; c < 3; c++) {
+    float v = c000[c] + (w1 * (p1[c] - c000[c])) + (w2 * (p2[c] - p1[c])) + (w3 * (c111[c] - p2[c]));
+    out[c] = (int) (v + 0.5f);
+  }
+
+  *Y = out[0];
+  *Cb = out[1];
+  *Cr = out[2];
+}
+
+static inline
+void color_lut_lookup(const ColorLut *lut, int R, int G, int B, int *Y, int *Cb, int *Cr) {
+  if (lut->kind == ColorLutKindFullCube) {
+    const uint8_t *entry = lut->cube + ((((uint32_t) R << 16) | ((uint32_t) G << 8) | (uint32_t) B) * 3);
+    *Y = entry[0];
+    *Cb = entry[1];
+    *Cr = entry[2];
+  } else {
+    color_lut_interpolate(lut, R, G, B, Y, Cb, Cr);
+  }
+}
+
+// Convert BGRA pixels to (Cr << 16) | (Cb << 8) | Y, alpha is ignored
+
+static inline
+void color_lut_convert_row(const ColorLut *lut, const uint32_t *inPixels, uint32_t *outPixels, int numPixels) {
+  if (lut->kind == ColorLutKindFullCube) {
+    const uint8_t *cube = lut->cube;
+
+    for (int i = 0; i < numPixels; i++) {
+      const uint8_t *entry = cube + ((inPixels[i] & 0xFFFFFF) * 3);
+      outPixels[i] = ((uint32_t) entry[2] << 16) | ((uint32_t) entry[1] << 8) | entry[0];
+    }
+  } else {
+    for (int i = 0; i < numPixels; i++) {
+      const uint32_t pixel = inPixels[i];
+      int Y, Cb, Cr;
+      color_lut_interpolate(lut, (pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF, &Y, &Cb, &Cr);
+      outPixels[i] = ((uint32_t) Cr << 16) | ((uint32_t) Cb << 8) | (uint32_t) Y;
+    }
+  }
+}
+
+// Compare the table to the direct function for every (R G B),
+// returns the largest absolute error in any component and the
+// number of inputs where at least one component differs.
+
+static inline
+int color_lut_measure_error(const ColorLut *lut, uint32_t *numMismatched) {
+  int maxError = 0;
+  uint32_t mismatched = 0;
+
+  for (int R = 0; R < 256; R++) {
+    for (int G = 0; G < 256; G++) {
+      for (int B = 0; B < 256; B++) {
+        int Y1, Cb1, Cr1, Y2, Cb2, Cr2;
+        color_lut_encode_pixel(lut->encode, R, G, B, &Y1, &Cb1, &Cr1);
+        color_lut_lookup(lut, R, G, B, &Y2, &Cb2, &Cr2);
+
+        int dY = abs(Y1 - Y2);
+        int dCb = abs(Cb1 - Cb2);
+        int dCr = abs(Cr1 - Cr2);
+
+        if ((dY | dCb | dCr) != 0) {
+          mismatched += 1;
+        }
+
+        maxError = (dY > maxError) ? dY : maxError;
+        maxError = (dCb > maxError) ? dCb : maxError;
+        maxError = (dCr > maxError) ? dCr : maxError;
+      }
+    }
+  }
+
+  if (numMismatched) {
+    *numMismatched = mismatched;
+  }
+
+  return maxError;
+}
+
+#endif // _COLOR_LUT_H
@@ -0,0 +1,606 @@
+//
+//  decode_budget.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only scheduler that limits the total decode work of all
+//  players to a budget of pixels per vsync. The cost of a frame is
+//  the pixel size of the playing rendition times the number of video
+//  streams, 2 for an RGB and alpha pair. The priority of a player is
+//  the number of pixels its view covers on screen, a hidden view has
+//  no priority.
+//
+//  A player can be shown in more than one view, the views of one
+//  decoder share its player so each frame is counted once. The
+//  player is visible when any of its views is and its priority is
+//  the size of its largest visible view.
+//
+//  At each vsync every player with a frame due is sorted by priority
+//  and frames are granted until the budget is spent. The other
+//  players skip the vsync and their frame stays due, so it can be
+//  decoded late at the next vsync that has budget left. A frame that
+//  is still not decoded when the next frame is due is dropped. The
+//  first player in the order is granted even when its frame alone
+//  costs more than the budget. A visible player that dropped
+//  DECODE_BUDGET_MAX_DROPS frames in a row goes first, ahead of the
+//  highest priority player, so low priority players slow down
+//  instead of freezing. Hidden players drop every frame.
+//
+//  At the end of each window of DECODE_BUDGET_WINDOW vsyncs the
+//  lowest priority player that dropped more than
+//  DECODE_BUDGET_DOWNGRADE_DROP_RATIO of its frames moves one level
+//  down to a smaller rendition. When the frames of the window would
+//  still use less than DECODE_BUDGET_UPGRADE_LOAD of the budget with
+//  a larger rendition, the highest priority downgraded player moves
+//  one level back up.
+//
+//  See license.txt for license terms.
+
+#if !defined(_DECODE_BUDGET_H)
+#define _DECODE_BUDGET_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DECODE_BUDGET_MAX_PLAYERS 32
+
+#define DECODE_BUDGET_MAX_VIEWS 64
+
+// Rendition levels per player, level 0 fits the view
+
+#define DECODE_BUDGET_MAX_LEVELS 16
+
+#define DECODE_BUDGET_MAX_DROPS 2
+
+#define DECODE_BUDGET_WINDOW 60
+
+#define DECODE_BUDGET_DOWNGRADE_DROP_RATIO 0.25
+
+#define DECODE_BUDGET_UPGRADE_LOAD 0.5
+
+typedef enum {
+  // No frame due at this vsync
+  DecodeBudgetIdle = 0,
+  DecodeBudgetDecode,
+  DecodeBudgetSkip
+} DecodeBudgetDecision;
+
+typedef struct {
+  // Frames that came due, each is decoded or dropped
+  uint64_t numFrames;
+  uint64_t numDecoded;
+  // Frames decoded at a later vsync than the one they came due at
+  uint64_t numLate;
+  uint64_t numDropped;
+  // Vsyncs where a due frame was not granted
+  uint64_t numSkipped;
+  uint32_t numDowngrades;
+  uint32_t numUpgrades;
+} DecodeBudgetPlayerMetrics;
+
+typedef struct {
+  int inUse;
+
+  // Cost of one frame at each rendition level
+  int numStreams;
+  int numLevels;
+  int levelWidths[DECODE_BUDGET_MAX_LEVELS];
+  int levelHeights[DECODE_BUDGET_MAX_LEVELS];
+  int level;
+
+  double frameDuration;
+
+  // Priority inputs
+  int viewWidth;
+  int viewHeight;
+  int isVisible;
+
+  // Views added with decode_budget_add_view()
+  int numViews;
+
+  // Host time of the oldest frame not yet decoded or dropped, 0
+  // before the first vsync
+  double nextFrameTime;
+  // 1 when the frame at nextFrameTime came due at this vsync, 2 when
+  // it came due at an earlier vsync
+  int isFrameDue;
+
+  DecodeBudgetDecision decision;
+  int numDropsInRow;
+
+  // Counts for the current window
+  int windowFrames;
+  int windowDropped;
+
+  DecodeBudgetPlayerMetrics metrics;
+} DecodeBudgetPlayer;
+
+typedef struct {
+  int inUse;
+  int playerIndex;
+  int viewWidth;
+  int viewHeight;
+  int isVisible;
+} DecodeBudgetView;
+
+typedef struct {
+  uint64_t numVsyncs;
+  // Vsyncs where the frames due cost more than the budget
+  uint64_t numOverBudget;
+  uint64_t numFrames;
+  uint64_t numDecoded;
+  uint64_t numLate;
+  // Frames of visible players that were never decoded
+  uint64_t numDropped;
+  // Frames of hidden players
+  uint64_t numHiddenDropped;
+  uint64_t numSkipped;
+  uint64_t numDowngrades;
+  uint64_t numUpgrades;
+  // Pixels of the frames due at each vsync and of the frames granted
+  uint64_t pixelsDue;
+  uint64_t pixelsDecoded;
+  // The most recent vsync
+  int64_t lastPixelsDue;
+  int64_t lastPixelsDecoded;
+} DecodeBudgetMetrics;
+
+typedef struct {
+  // Budget in pixels per vsync, 0 for no limit
+  int64_t pixelsPerVsync;
+
+  DecodeBudgetPlayer players[DECODE_BUDGET_MAX_PLAYERS];
+  DecodeBudgetView views[DECODE_BUDGET_MAX_VIEWS];
+
+  int windowVsyncs;
+  // Pixels of the frames that came due in the window, once per frame
+  int64_t windowPixels;
+
+  DecodeBudgetMetrics metrics;
+} DecodeBudget;
+
+static inline
+void decode_budget_init(DecodeBudget *budget, int64_t pixelsPerVsync) {
+  memset(budget, 0, sizeof(DecodeBudget));
+  budget->pixelsPerVsync = pixelsPerVsync;
+}
+
+// Add a player that decodes frames of width x height from numStreams
+// streams, returns the player index or -1 when the scheduler is full.
+// A new player is visible with an unknown view size.
+
+static inline
+int decode_budget_add_player(DecodeBudget *budget, int width, int height, int numStreams, double frameDuration) {
+  for (int i = 0; i < DECODE_BUDGET_MAX_PLAYERS; i++) {
+    DecodeBudgetPlayer *player = &budget->players[i];
+
+    if (!player->inUse) {
+      memset(player, 0, sizeof(DecodeBudgetPlayer));
+      player->inUse = 1;
+      player->numStreams = numStreams;
+      player->numLevels = 1;
+      player->levelWidths[0] = width;
+      player->levelHeights[0] = height;
+      player->frameDuration = frameDuration;
+      player->isVisible = 1;
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static inline
+void decode_budget_remove_player(DecodeBudget *budget, int index) {
+  budget->players[index].inUse = 0;
+}
+
+static inline
+void decode_budget_set_view(DecodeBudget *budget, int index, int viewWidth, int viewHeight, int isVisible) {
+  DecodeBudgetPlayer *player = &budget->players[index];
+  player->viewWidth = viewWidth;
+  player->viewHeight = viewHeight;
+  player->isVisible = isVisible;
+}
+
+// Add a player with the frame cost, rendition levels and frame
+// duration of another player, for a view that stops sharing the
+// decoder of that player. Returns -1 when the scheduler is full.
+
+static inline
+int decode_budget_copy_player(DecodeBudget *budget, int index) {
+  const DecodeBudgetPlayer *player = &budget->players[index];
+
+  const int copyIndex = decode_budget_add_player(budget, player->levelWidths[0], player->levelHeights[0],
+                                                 player->numStreams, player->frameDuration);
+
+  if (copyIndex == -1) {
+    return -1;
+  }
+
+  DecodeBudgetPlayer *copy = &budget->players[copyIndex];
+  copy->numLevels = player->numLevels;
+  memcpy(copy->levelWidths, player->levelWidths, sizeof(copy->levelWidths));
+  memcpy(copy->levelHeights, player->levelHeights, sizeof(copy->levelHeights));
+  copy->level = player->level;
+
+  return copyIndex;
+}
+
+// Set the priority inputs of the player from its views
+
+static inline
+void decode_budget_update_views(DecodeBudget *budget, int index) {
+  int viewWidth = 0;
+  int viewHeight = 0;
+  int isVisible = 0;
+
+  for (int i = 0; i < DECODE_BUDGET_MAX_VIEWS; i++) {
+    const DecodeBudgetView *view = &budget->views[i];
+
+    if (!view->inUse || view->playerIndex != index || !view->isVisible) {
+      continue;
+    }
+
+    if (!isVisible || ((int64_t) view->viewWidth * view->viewHeight) > ((int64_t) viewWidth * viewHeight)) {
+      viewWidth = view->viewWidth;
+      viewHeight = view->viewHeight;
+    }
+
+    isVisible = 1;
+  }
+
+  decode_budget_set_view(budget, index, viewWidth, viewHeight, isVisible);
+}
+
+// Add a view of the player, returns the view index or -1 when every
+// view is in use. A new view is visible with an unknown size.
+
+static inline
+int decode_budget_add_view(DecodeBudget *budget, int index) {
+  for (int i = 0; i < DECODE_BUDGET_MAX_VIEWS; i++) {
+    DecodeBudgetView *view = &budget->views[i];
+
+    if (!view->inUse) {
+      memset(view, 0, sizeof(DecodeBudgetView));
+      view->inUse = 1;
+      view->playerIndex = index;
+      view->isVisible = 1;
+      budget->players[index].numViews += 1;
+      decode_budget_update_views(budget, index);
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+// The player is removed with its last view
+
+static inline
+void decode_budget_remove_view(DecodeBudget *budget, int viewIndex) {
+  DecodeBudgetView *view = &budget->views[viewIndex];
+  const int index = view->playerIndex;
+
+  view->inUse = 0;
+  budget->players[index].numViews -= 1;
+
+  if (budget->players[index].numViews == 0) {
+    decode_budget_remove_player(budget, index);
+  } else {
+    decode_budget_update_views(budget, index);
+  }
+}
+
+// Move a view to another player, the player it leaves is removed
+// when this was its last view.
+
+static inline
+void decode_budget_move_view(DecodeBudget *budget, int viewIndex, int index) {
+  DecodeBudgetView *view = &budget->views[viewIndex];
+  const int prevIndex = view->playerIndex;
+
+  if (prevIndex == index) {
+    return;
+  }
+
+  view->playerIndex = index;
+  budget->players[index].numViews += 1;
+  decode_budget_update_views(budget, index);
+
+  budget->players[prevIndex].numViews -= 1;
+
+  if (budget->players[prevIndex].numViews == 0) {
+    decode_budget_remove_player(budget, prevIndex);
+  } else {
+    decode_budget_update_views(budget, prevIndex);
+  }
+}
+
+static inline
+void decode_budget_set_view_size(DecodeBudget *budget, int viewIndex, int viewWidth, int viewHeight, int isVisible) {
+  DecodeBudgetView *view = &budget->views[viewIndex];
+  view->viewWidth = viewWidth;
+  view->viewHeight = viewHeight;
+  view->isVisible = isVisible;
+  decode_budget_update_views(budget, view->playerIndex);
+}
+
+static inline
+int decode_budget_view_player(const DecodeBudget *budget, int viewIndex) {
+  return budget->views[viewIndex].playerIndex;
+}
+
+// Pixel sizes of the rendition that fits the view and of each
+// smaller rendition, largest first. The level is clamped to the
+// new number of levels.
+
+static inline
+void decode_budget_set_levels(DecodeBudget *budget, int index, int numLevels, const int *widths, const int *heights) {
+  DecodeBudgetPlayer *player = &budget->players[index];
+
+  if (numLevels < 1) {
+    return;
+  }
+  if (numLevels > DECODE_BUDGET_MAX_LEVELS) {
+    numLevels = DECODE_BUDGET_MAX_LEVELS;
+  }
+
+  for (int i = 0; i < numLevels; i++) {
+    player->levelWidths[i] = widths[i];
+    player->levelHeights[i] = heights[i];
+  }
+
+  player->numLevels = numLevels;
+
+  if (player->level >= numLevels) {
+    player->level = numLevels - 1;
+  }
+}
+
+static inline
+int64_t decode_budget_frame_cost(const DecodeBudgetPlayer *player) {
+  return (int64_t) player->levelWidths[player->level] * player->levelHeights[player->level] * player->numStreams;
+}
+
+static inline
+int64_t decode_budget_priority(const DecodeBudgetPlayer *player) {
+  if (!player->isVisible) {
+    return 0;
+  }
+  return (int64_t) player->viewWidth * player->viewHeight;
+}
+
+// Sort order at a vsync, return 1 when player a goes before player b
+
+static inline
+int decode_budget_before(const DecodeBudget *budget, int a, int b) {
+  const DecodeBudgetPlayer *playerA = &budget->players[a];
+  const DecodeBudgetPlayer *playerB = &budget->players[b];
+
+  const int starvedA = playerA->isVisible && playerA->numDropsInRow >= DECODE_BUDGET_MAX_DROPS;
+  const int starvedB = playerB->isVisible && playerB->numDropsInRow >= DECODE_BUDGET_MAX_DROPS;
+
+  if (starvedA != starvedB) {
+    return starvedA;
+  }
+
+  const int64_t priorityA = decode_budget_priority(playerA);
+  const int64_t priorityB = decode_budget_priority(playerB);
+
+  if (priorityA != priorityB) {
+    return priorityA > priorityB;
+  }
+
+  return a < b;
+}
+
+// Move one player a rendition level up or down at the end of a window
+
+static inline
+void decode_budget_end_window(DecodeBudget *budget) {
+  int downgrade = -1;
+  int upgrade = -1;
+
+  for (int i = 0; i < DECODE_BUDGET_MAX_PLAYERS; i++) {
+    DecodeBudgetPlayer *player = &budget->players[i];
+
+    if (!player->inUse || !player->isVisible) {
+      continue;
+    }
+
+    if (player->windowFrames > 0 &&
+        player->windowDropped > (player->windowFrames * DECODE_BUDGET_DOWNGRADE_DROP_RATIO) &&
+        player->level < (player->numLevels - 1)) {
+      if (downgrade == -1 || decode_budget_priority(player) < decode_budget_priority(&budget->players[downgrade])) {
+        downgrade = i;
+      }
+    }
+
+    if (player->level > 0) {
+      if (upgrade == -1 || decode_budget_priority(player) > decode_budget_priority(&budget->players[upgrade])) {
+        upgrade = i;
+      }
+    }
+  }
+
+  if (downgrade != -1) {
+    DecodeBudgetPlayer *player = &budget->players[downgrade];
+    player->level += 1;
+    player->metrics.numDowngrades += 1;
+    budget->metrics.numDowngrades += 1;
+  } else if (upgrade != -1) {
+    // Demand of the window as if the player had played the larger
+    // rendition, the upgrade must leave headroom or the player would
+    // be downgraded again in the next window.
+
+    DecodeBudgetPlayer *player = &budget->players[upgrade];
+    const int64_t cost = decode_budget_frame_cost(player);
+    player->level -= 1;
+    const int64_t upgradeCost = decode_budget_frame_cost(player);
+    player->level += 1;
+
+    const double pixels = (double) budget->windowPixels + ((double) (upgradeCost - cost) * player->windowFrames);
+    const double load = pixels / ((double) budget->pixelsPerVsync * budget->windowVsyncs);
+
+    if (budget->pixelsPerVsync == 0 || load < DECODE_BUDGET_UPGRADE_LOAD) {
+      player->level -= 1;
+      player->metrics.numUpgrades += 1;
+      budget->metrics.numUpgrades += 1;
+    }
+  }
+
+  for (int i = 0; i < DECODE_BUDGET_MAX_PLAYERS; i++) {
+    budget->players[i].windowFrames = 0;
+    budget->players[i].windowDropped = 0;
+  }
+
+  budget->windowVsyncs = 0;
+  budget->windowPixels = 0;
+}
+
+// Drop the frame at nextFrameTime and move on to the next one
+
+static inline
+void decode_budget_drop_frame(DecodeBudget *budget, DecodeBudgetPlayer *player) {
+  if (player->isVisible) {
+    player->numDropsInRow += 1;
+    player->windowDropped += 1;
+    player->metrics.numDropped += 1;
+    budget->metrics.numDropped += 1;
+  } else {
+    budget->metrics.numHiddenDropped += 1;
+  }
+
+  player->nextFrameTime += player->frameDuration;
+  player->isFrameDue = 0;
+}
+
+// Decide which players decode a frame at the vsync, read the result
+// with decode_budget_decision().
+
+static inline
+void decode_budget_schedule(DecodeBudget *budget, double vsyncTime) {
+  int due[DECODE_BUDGET_MAX_PLAYERS];
+  int numDue = 0;
+
+  for (int i = 0; i < DECODE_BUDGET_MAX_PLAYERS; i++) {
+    DecodeBudgetPlayer *player = &budget->players[i];
+
+    if (!player->inUse) {
+      continue;
+    }
+
+    player->decision = DecodeBudgetIdle;
+
+    // A player that missed more than a few frames, after a stall or
+    // when it was added, starts counting again at this vsync
+
+    if (player->nextFrameTime == 0 ||
+        vsyncTime > (player->nextFrameTime + (DECODE_BUDGET_MAX_DROPS + 1) * player->frameDuration)) {
+      player->nextFrameTime = vsyncTime;
+      player->isFrameDue = 0;
+    }
+
+    // Times within 1 ms of the vsync count as reached. A frame not
+    // decoded by the time the next frame is due is dropped.
+
+    while (vsyncTime + 0.001 >= player->nextFrameTime + player->frameDuration) {
+      decode_budget_drop_frame(budget, player);
+    }
+
+    if (vsyncTime + 0.001 < player->nextFrameTime) {
+      continue;
+    }
+
+    if (player->isFrameDue) {
+      player->isFrameDue = 2;
+    } else {
+      player->isFrameDue = 1;
+      player->metrics.numFrames += 1;
+      budget->metrics.numFrames += 1;
+      if (player->isVisible) {
+        player->windowFrames += 1;
+        budget->windowPixels += decode_budget_frame_cost(player);
+      }
+    }
+
+    // Insertion sort into the due order
+
+    int j = numDue;
+    while (j > 0 && decode_budget_before(budget, i, due[j - 1])) {
+      due[j] = due[j - 1];
+      j--;
+    }
+    due[j] = i;
+    numDue += 1;
+  }
+
+  int64_t pixelsDue = 0;
+  int64_t pixelsDecoded = 0;
+
+  for (int k = 0; k < numDue; k++) {
+    DecodeBudgetPlayer *player = &budget->players[due[k]];
+
+    if (!player->isVisible) {
+      player->decision = DecodeBudgetSkip;
+      decode_budget_drop_frame(budget, player);
+      continue;
+    }
+
+    const int64_t cost = decode_budget_frame_cost(player);
+    pixelsDue += cost;
+
+    const int fits = (budget->pixelsPerVsync == 0) || (pixelsDecoded == 0) ||
+      ((pixelsDecoded + cost) <= budget->pixelsPerVsync);
+
+    if (fits) {
+      player->decision = DecodeBudgetDecode;
+      pixelsDecoded += cost;
+
+      if (player->isFrameDue == 2) {
+        player->metrics.numLate += 1;
+        budget->metrics.numLate += 1;
+      }
+
+      player->metrics.numDecoded += 1;
+      budget->metrics.numDecoded += 1;
+      player->numDropsInRow = 0;
+      player->nextFrameTime += player->frameDuration;
+      player->isFrameDue = 0;
+    } else {
+      player->decision = DecodeBudgetSkip;
+      player->metrics.numSkipped += 1;
+      budget->metrics.numSkipped += 1;
+    }
+  }
+
+  budget->metrics.numVsyncs += 1;
+  budget->metrics.pixelsDue += pixelsDue;
+  budget->metrics.pixelsDecoded += pixelsDecoded;
+  budget->metrics.lastPixelsDue = pixelsDue;
+  budget->metrics.lastPixelsDecoded = pixelsDecoded;
+
+  if (budget->pixelsPerVsync > 0 && pixelsDue > budget->pixelsPerVsync) {
+    budget->metrics.numOverBudget += 1;
+  }
+
+  budget->windowVsyncs += 1;
+
+  if (budget->windowVsyncs == DECODE_BUDGET_WINDOW) {
+    decode_budget_end_window(budget);
+  }
+}
+
+static inline
+DecodeBudgetDecision decode_budget_decision(const DecodeBudget *budget, int index) {
+  return budget->players[index].decision;
+}
+
+static inline
+int decode_budget_level(const DecodeBudget *budget, int index) {
+  return budget->players[index].level;
+}
+
+#endif // _DECODE_BUDGET_H
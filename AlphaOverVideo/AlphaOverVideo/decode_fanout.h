@@ -0,0 +1,457 @@
+//
+//  decode_fanout.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only registry that shares one decoder between every view
+//  that plays the same clip at the same time offset. An entry is
+//  keyed by a clip id and an offset, the first subscriber opens a
+//  decoder and later subscribers with the same key join it. Each
+//  frame is decoded once, the first subscriber that asks for a new
+//  frame number drives the decoder and every other subscriber gets
+//  a new reference to the same frame.
+//
+//  Subscribers of a started entry share its playhead. A subscriber
+//  that asks for a frame more than DECODE_FANOUT_MAX_SKEW_FRAMES
+//  behind the frame the entry last decoded, or that missed more than
+//  that many of the frames the entry decoded, has diverged. It is
+//  moved to a private entry with its own decoder and the other
+//  subscribers keep the shared decoder.
+//
+//  The decoder is a table of callbacks so that the registry can be
+//  driven by AVPlayer backed frame sources or by a synthetic decoder
+//  in tests. Frames are opaque pointers with a reference count kept
+//  by the retainFrame and releaseFrame callbacks. This module is not
+//  thread safe, frames are pulled from the main thread.
+//
+//  See license.txt for license terms.
+
+#if !defined(_DECODE_FANOUT_H)
+#define _DECODE_FANOUT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DECODE_FANOUT_MAX_ENTRIES 32
+
+#define DECODE_FANOUT_MAX_SUBSCRIBERS 64
+
+// A subscriber this many frames behind its entry still shares the
+// decoder, it gets the most recent frame. Display links on the same
+// display differ by less than one frame. Frames behind is counted
+// from the time of the request and from the frames the subscriber
+// has received.
+
+#define DECODE_FANOUT_MAX_SKEW_FRAMES 2
+
+typedef struct {
+  double hostTime;
+  double presentationTime;
+  // Seconds since the start time of the entry
+  double clipTime;
+  // clipTime in whole frames
+  int frameNum;
+} DecodeFanoutRequest;
+
+// Decoder interface, each callback is passed the context pointer
+
+typedef struct {
+  // Open a decoder for the clip, openArg is the value passed to
+  // decode_fanout_subscribe() or returned by divergeArg. Returns NULL
+  // when the clip cannot be opened.
+  void* (*open)(void *context, uint64_t clipId, int64_t offset, void *openArg);
+
+  // Return the openArg that opens another decoder for the clip of an
+  // open decoder, used when a subscriber diverges. The registry does
+  // not keep openArg, so the decoder has to hold what it points to.
+  // Can be NULL, open is then passed NULL.
+  void* (*divergeArg)(void *context, void *decoder);
+
+  // Begin playback so that clip time 0 is at startTime, can be NULL
+  void (*start)(void *context, void *decoder, double startTime);
+
+  // Return the frame shown for the request with one reference that
+  // belongs to the caller, or NULL when no new frame is ready.
+  void* (*decode)(void *context, void *decoder, const DecodeFanoutRequest *request);
+
+  void (*close)(void *context, void *decoder);
+
+  void (*retainFrame)(void *context, void *frame);
+  void (*releaseFrame)(void *context, void *frame);
+
+  void *context;
+} DecodeFanoutDecoder;
+
+typedef struct {
+  int inUse;
+  // An entry opened for a diverged subscriber is not found by lookups
+  int isPrivate;
+  uint64_t clipId;
+  int64_t offset;
+  void *decoder;
+
+  int isStarted;
+  double startTime;
+  double frameDuration;
+
+  // Frame number of the most recent decoded frame
+  int decodedFrameNum;
+  uint64_t numDecodeCalls;
+
+  // A decode that returned no frame is tried again at the next vsync
+  int attemptFrameNum;
+  double attemptHostTime;
+
+  // Most recent decoded frame, the entry holds one reference
+  void *frame;
+  // Incremented each time frame is replaced
+  uint32_t frameSerial;
+
+  int numSubscribers;
+} DecodeFanoutEntry;
+
+typedef struct {
+  int inUse;
+  int entryIndex;
+  // frameSerial of the last frame delivered
+  uint32_t frameSerial;
+} DecodeFanoutSubscriber;
+
+typedef struct {
+  uint64_t numRequests;
+  // Calls to the decode callback and calls that returned a frame
+  uint64_t numDecodeCalls;
+  uint64_t numFramesDecoded;
+  // Frames returned to subscribers
+  uint64_t numFramesDelivered;
+  // Frames returned to a subscriber from a decode made for another
+  uint64_t numFramesShared;
+  uint64_t numDecodersOpened;
+  uint64_t numDecodersClosed;
+  // Subscribers moved to a private decoder
+  uint64_t numDivergences;
+  int numOpenDecoders;
+  int maxOpenDecoders;
+} DecodeFanoutMetrics;
+
+typedef struct {
+  DecodeFanoutDecoder decoder;
+  DecodeFanoutEntry entries[DECODE_FANOUT_MAX_ENTRIES];
+  DecodeFanoutSubscriber subscribers[DECODE_FANOUT_MAX_SUBSCRIBERS];
+  DecodeFanoutMetrics metrics;
+} DecodeFanout;
+
+static inline
+void decode_fanout_init(DecodeFanout *fanout, const DecodeFanoutDecoder *decoder) {
+  memset(fanout, 0, sizeof(DecodeFanout));
+  fanout->decoder = *decoder;
+}
+
+// 64 bit FNV-1a of a string that identifies a clip, the URL or
+// URLs that are decoded.
+
+static inline
+uint64_t decode_fanout_clip_id(const char *str) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+
+  for ( ; *str != '\0'; str++) {
+    hash ^= (uint8_t) *str;
+    hash *= 0x100000001B3ULL;
+  }
+
+  return hash;
+}
+
+static inline
+int decode_fanout_frame_num(double clipTime, double frameDuration) {
+  // Bias so that a time computed as N * frameDuration is frame N
+  return (int) floor((clipTime / frameDuration) + 0.0001);
+}
+
+// Shared entry for the key, -1 when there is none
+
+static inline
+int decode_fanout_find_entry(DecodeFanout *fanout, uint64_t clipId, int64_t offset) {
+  for (int i = 0; i < DECODE_FANOUT_MAX_ENTRIES; i++) {
+    DecodeFanoutEntry *entry = &fanout->entries[i];
+    if (entry->inUse && !entry->isPrivate && entry->clipId == clipId && entry->offset == offset) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Open a decoder into a free entry, returns -1 when every entry is
+// in use or the decoder could not be opened.
+
+static inline
+int decode_fanout_open_entry(DecodeFanout *fanout, uint64_t clipId, int64_t offset, void *openArg, int isPrivate) {
+  int index = -1;
+
+  for (int i = 0; i < DECODE_FANOUT_MAX_ENTRIES; i++) {
+    if (!fanout->entries[i].inUse) {
+      index = i;
+      break;
+    }
+  }
+
+  if (index == -1) {
+    return -1;
+  }
+
+  void *decoder = fanout->decoder.open(fanout->decoder.context, clipId, offset, openArg);
+
+  if (decoder == NULL) {
+    return -1;
+  }
+
+  DecodeFanoutEntry *entry = &fanout->entries[index];
+  memset(entry, 0, sizeof(DecodeFanoutEntry));
+  entry->inUse = 1;
+  entry->isPrivate = isPrivate;
+  entry->clipId = clipId;
+  entry->offset = offset;
+  entry->decoder = decoder;
+  entry->attemptFrameNum = -1;
+
+  DecodeFanoutMetrics *metrics = &fanout->metrics;
+  metrics->numDecodersOpened += 1;
+  metrics->numOpenDecoders += 1;
+  if (metrics->numOpenDecoders > metrics->maxOpenDecoders) {
+    metrics->maxOpenDecoders = metrics->numOpenDecoders;
+  }
+
+  return index;
+}
+
+static inline
+void decode_fanout_close_entry(DecodeFanout *fanout, int index) {
+  DecodeFanoutEntry *entry = &fanout->entries[index];
+
+  if (entry->frame != NULL) {
+    fanout->decoder.releaseFrame(fanout->decoder.context, entry->frame);
+    entry->frame = NULL;
+  }
+
+  fanout->decoder.close(fanout->decoder.context, entry->decoder);
+  entry->decoder = NULL;
+  entry->inUse = 0;
+
+  fanout->metrics.numDecodersClosed += 1;
+  fanout->metrics.numOpenDecoders -= 1;
+}
+
+// Subscribe to the clip at the offset, the decoder is opened by the
+// first subscriber of the key. Returns the subscriber index or -1
+// when the registry is full or the decoder could not be opened.
+
+static inline
+int decode_fanout_subscribe(DecodeFanout *fanout, uint64_t clipId, int64_t offset, void *openArg) {
+  int subscriberIndex = -1;
+
+  for (int i = 0; i < DECODE_FANOUT_MAX_SUBSCRIBERS; i++) {
+    if (!fanout->subscribers[i].inUse) {
+      subscriberIndex = i;
+      break;
+    }
+  }
+
+  if (subscriberIndex == -1) {
+    return -1;
+  }
+
+  int index = decode_fanout_find_entry(fanout, clipId, offset);
+
+  if (index == -1) {
+    index = decode_fanout_open_entry(fanout, clipId, offset, openArg, 0);
+    if (index == -1) {
+      return -1;
+    }
+  }
+
+  fanout->entries[index].numSubscribers += 1;
+
+  DecodeFanoutSubscriber *subscriber = &fanout->subscribers[subscriberIndex];
+  subscriber->inUse = 1;
+  subscriber->entryIndex = index;
+  subscriber->frameSerial = 0;
+
+  return subscriberIndex;
+}
+
+// The decoder is closed when its last subscriber leaves
+
+static inline
+void decode_fanout_unsubscribe(DecodeFanout *fanout, int subscriberIndex) {
+  DecodeFanoutSubscriber *subscriber = &fanout->subscribers[subscriberIndex];
+
+  if (!subscriber->inUse) {
+    return;
+  }
+
+  DecodeFanoutEntry *entry = &fanout->entries[subscriber->entryIndex];
+  entry->numSubscribers -= 1;
+
+  if (entry->numSubscribers == 0) {
+    decode_fanout_close_entry(fanout, subscriber->entryIndex);
+  }
+
+  subscriber->inUse = 0;
+}
+
+// Start the entry of the subscriber so that clip time 0 is at
+// startTime. Returns 1 when this call started the decoder and 0 when
+// the entry was already started, the subscriber then joins the
+// playhead of the entry and startTime is ignored.
+
+static inline
+int decode_fanout_start(DecodeFanout *fanout, int subscriberIndex, double startTime, double frameDuration) {
+  DecodeFanoutEntry *entry = &fanout->entries[fanout->subscribers[subscriberIndex].entryIndex];
+
+  if (entry->isStarted) {
+    return 0;
+  }
+
+  entry->isStarted = 1;
+  entry->startTime = startTime;
+  entry->frameDuration = frameDuration;
+
+  if (fanout->decoder.start != NULL) {
+    fanout->decoder.start(fanout->decoder.context, entry->decoder, startTime);
+  }
+
+  return 1;
+}
+
+// Move a subscriber to a private entry with its own decoder that is
+// started at the same start time. Returns 0 when no decoder could be
+// opened, the subscriber then stays on the shared entry.
+
+static inline
+int decode_fanout_diverge(DecodeFanout *fanout, int subscriberIndex) {
+  DecodeFanoutSubscriber *subscriber = &fanout->subscribers[subscriberIndex];
+  const int sharedIndex = subscriber->entryIndex;
+  DecodeFanoutEntry *shared = &fanout->entries[sharedIndex];
+
+  void *openArg = NULL;
+
+  if (fanout->decoder.divergeArg != NULL) {
+    openArg = fanout->decoder.divergeArg(fanout->decoder.context, shared->decoder);
+  }
+
+  const int index = decode_fanout_open_entry(fanout, shared->clipId, shared->offset, openArg, 1);
+
+  if (index == -1) {
+    return 0;
+  }
+
+  shared->numSubscribers -= 1;
+
+  DecodeFanoutEntry *entry = &fanout->entries[index];
+  entry->numSubscribers = 1;
+
+  subscriber->entryIndex = index;
+  subscriber->frameSerial = 0;
+
+  fanout->metrics.numDivergences += 1;
+
+  decode_fanout_start(fanout, subscriberIndex, shared->startTime, shared->frameDuration);
+
+  return 1;
+}
+
+// Return the frame for the host time with one reference that belongs
+// to the caller, or NULL when the subscriber already has the most
+// recent frame or the entry has not been started.
+
+static inline
+void* decode_fanout_frame(DecodeFanout *fanout, int subscriberIndex, double hostTime, double presentationTime) {
+  DecodeFanoutSubscriber *subscriber = &fanout->subscribers[subscriberIndex];
+  DecodeFanoutEntry *entry = &fanout->entries[subscriber->entryIndex];
+
+  fanout->metrics.numRequests += 1;
+
+  if (!entry->isStarted) {
+    return NULL;
+  }
+
+  DecodeFanoutRequest request;
+  request.hostTime = hostTime;
+  request.presentationTime = presentationTime;
+  request.clipTime = hostTime - entry->startTime;
+  request.frameNum = decode_fanout_frame_num(request.clipTime, entry->frameDuration);
+
+  // A subscriber that fell behind the shared playhead continues on
+  // its own decoder. It is behind when it asks for an older frame or
+  // when it missed frames the others received.
+
+  if (entry->numSubscribers > 1 && entry->frame != NULL) {
+    const int isOlderFrame = request.frameNum < (entry->decodedFrameNum - DECODE_FANOUT_MAX_SKEW_FRAMES);
+    const int isMissedFrames = subscriber->frameSerial != 0 &&
+      (entry->frameSerial - subscriber->frameSerial) > DECODE_FANOUT_MAX_SKEW_FRAMES;
+
+    if (isOlderFrame || isMissedFrames) {
+      if (decode_fanout_diverge(fanout, subscriberIndex)) {
+        entry = &fanout->entries[subscriber->entryIndex];
+      }
+    }
+  }
+
+  // Decode once per frame number, a lone subscriber can also move
+  // the playhead back. When no frame is ready the same frame number
+  // is tried again at a later vsync.
+
+  int isDecoded = 0;
+
+  const int isNewFrame = (entry->frame == NULL) ||
+    (request.frameNum > entry->decodedFrameNum) ||
+    (entry->numSubscribers == 1 && request.frameNum != entry->decodedFrameNum);
+
+  const int isAttempted = (request.frameNum == entry->attemptFrameNum) &&
+    (request.hostTime == entry->attemptHostTime);
+
+  if (isNewFrame && !isAttempted) {
+    void *frame = fanout->decoder.decode(fanout->decoder.context, entry->decoder, &request);
+
+    entry->attemptFrameNum = request.frameNum;
+    entry->attemptHostTime = request.hostTime;
+    entry->numDecodeCalls += 1;
+    fanout->metrics.numDecodeCalls += 1;
+
+    if (frame != NULL) {
+      if (entry->frame != NULL) {
+        fanout->decoder.releaseFrame(fanout->decoder.context, entry->frame);
+      }
+      entry->frame = frame;
+      entry->frameSerial += 1;
+      entry->decodedFrameNum = request.frameNum;
+      fanout->metrics.numFramesDecoded += 1;
+      isDecoded = 1;
+    }
+  }
+
+  if (entry->frame == NULL || subscriber->frameSerial == entry->frameSerial) {
+    return NULL;
+  }
+
+  subscriber->frameSerial = entry->frameSerial;
+  fanout->decoder.retainFrame(fanout->decoder.context, entry->frame);
+
+  fanout->metrics.numFramesDelivered += 1;
+  if (!isDecoded) {
+    fanout->metrics.numFramesShared += 1;
+  }
+
+  return entry->frame;
+}
+
+// Decoder of the entry the subscriber is on
+
+static inline
+void* decode_fanout_subscriber_decoder(DecodeFanout *fanout, int subscriberIndex) {
+  return fanout->entries[fanout->subscribers[subscriberIndex].entryIndex].decoder;
+}
+
+#endif // _DECODE_FANOUT_H
@@ -0,0 +1,320 @@
+//
+//  decode_precision.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only CPU reference for the precision of the intermediate
+//  texture that the BT.709 decode writes linear pixels into before
+//  the resize render. The decode math mirrors BT709_decode() and the
+//  gamma decode functions in AlphaOverVideo.metal, then each pixel is
+//  stored at the precision of the intermediate pixel format and read
+//  back, the way the sampling shader sees it.
+//
+//  sRGB8 : BGRA8Unorm_sRGB, 4 bytes per pixel
+//  Float16 : RGBA16Float, 8 bytes per pixel
+//  Float32 : RGBA32Float, 16 bytes per pixel
+//
+//  The error analysis walks every 8 bit Y Cb Cr input and compares
+//  the 8 bit sRGB output step that the drawable gets to the step the
+//  float32 intermediate produces.
+//
+//  See license.txt for license terms.
+
+#if !defined(_DECODE_PRECISION_H)
+#define _DECODE_PRECISION_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sRGB.h"
+#include "BT709.h"
+
+typedef enum {
+  DecodePrecisionSRGB8 = 0, // default
+  DecodePrecisionFloat16,
+  DecodePrecisionFloat32
+} DecodePrecision;
+
+static inline
+const char* decode_precision_name(DecodePrecision precision) {
+  switch (precision) {
+    case DecodePrecisionSRGB8:
+      return "sRGB8";
+    case DecodePrecisionFloat16:
+      return "float16";
+    case DecodePrecisionFloat32:
+      return "float32";
+  }
+  return "unknown";
+}
+
+static inline
+int decode_precision_bytes_per_pixel(DecodePrecision precision) {
+  switch (precision) {
+    case DecodePrecisionSRGB8:
+      return 4;
+    case DecodePrecisionFloat16:
+      return 8;
+    case DecodePrecisionFloat32:
+      return 16;
+  }
+  return 0;
+}
+
+// IEEE half from float with round to nearest even, the rounding a
+// GPU applies when a shader writes float values into RGBA16Float.
+// Values too large for a half become infinity and NaN stays NaN.
+
+static inline
+uint16_t decode_precision_float_to_half(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+
+  const uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+  const int exp = (int) ((bits >> 23) & 0xFF);
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if (exp == 0xFF) {
+    return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+  }
+
+  // Unbiased exponent rebiased for half
+
+  int halfExp = exp - 127 + 15;
+
+  if (halfExp >= 0x1F) {
+    return sign | 0x7C00;
+  }
+
+  if (halfExp <= 0) {
+    // Subnormal half or zero, shift in the implicit 1 bit
+
+    if (halfExp < -10) {
+      return sign;
+    }
+
+    mantissa |= 0x800000;
+    const int shift = 14 - halfExp;
+    uint32_t halfMantissa = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+
+    if (rest > halfway || (rest == halfway && (halfMantissa & 0x1))) {
+      halfMantissa += 1;
+    }
+
+    return sign | (uint16_t) halfMantissa;
+  }
+
+  uint32_t half = ((uint32_t) halfExp << 10) | (mantissa >> 13);
+  const uint32_t rest = mantissa & 0x1FFF;
+
+  // A carry out of the mantissa bumps the exponent, which is
+  // still the correctly rounded result.
+
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 0x1))) {
+    half += 1;
+  }
+
+  return sign | (uint16_t) half;
+}
+
+static inline
+float decode_precision_half_to_float(uint16_t h) {
+  const uint32_t sign = ((uint32_t) (h & 0x8000)) << 16;
+  const int exp = (h >> 10) & 0x1F;
+  uint32_t mantissa = h & 0x3FF;
+  uint32_t bits;
+
+  if (exp == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else if (exp != 0) {
+    bits = sign | ((uint32_t) (exp - 15 + 127) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Subnormal half is a normal float
+
+    int e = -14;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      e -= 1;
+    }
+    mantissa &= 0x3FF;
+    bits = sign | ((uint32_t) (e + 127) << 23) | (mantissa << 13);
+  }
+
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Linear value in [0.0 1.0] to the sRGB byte that a BGRA8Unorm_sRGB
+// render target stores.
+
+static inline
+int decode_precision_srgb_byte(float linear) {
+  int v = (int) round(sRGB_linearNormToNonLinear(saturatef(linear)) * 255.0f);
+  return (v > 255) ? 255 : v;
+}
+
+// Store a linear value at the intermediate precision and return
+// the value that a sample of the intermediate texture reads back.
+
+static inline
+float decode_precision_store(float linear, DecodePrecision precision) {
+  switch (precision) {
+    case DecodePrecisionSRGB8:
+      return sRGB_nonLinearNormToLinear(decode_precision_srgb_byte(linear) / 255.0f);
+    case DecodePrecisionFloat16:
+      return decode_precision_half_to_float(decode_precision_float_to_half(linear));
+    case DecodePrecisionFloat32:
+      return linear;
+  }
+  return linear;
+}
+
+// Decode one Y Cb Cr byte triple to linear RGB with the constants,
+// clamp and gamma functions of the Metal decode shaders. Input bytes
+// are read from 8 bit textures into half values, so the normalized
+// inputs are rounded to half before the matrix multiply.
+
+static inline
+void decode_precision_pixel(int Y, int Cb, int Cr, BT709Gamma gamma, float *rgb) {
+  const float Yf = decode_precision_half_to_float(decode_precision_float_to_half(Y / 255.0f));
+  const float Cbf = decode_precision_half_to_float(decode_precision_float_to_half(Cb / 255.0f));
+  const float Crf = decode_precision_half_to_float(decode_precision_float_to_half(Cr / 255.0f));
+
+  const float Yn = Yf - (16.0f/255.0f);
+  const float Cbn = Cbf - (128.0f/255.0f);
+  const float Crn = Crf - (128.0f/255.0f);
+
+  rgb[0] = saturatef((1.1644f * Yn) + (1.7927f * Crn));
+  rgb[1] = saturatef((1.1644f * Yn) + (-0.2132f * Cbn) + (-0.5329f * Crn));
+  rgb[2] = saturatef((1.1644f * Yn) + (2.1124f * Cbn));
+
+  for (int i = 0; i < 3; i++) {
+    if (gamma == BT709GammaApple) {
+      rgb[i] = Apple196_nonLinearNormToLinear(rgb[i]);
+    } else if (gamma == BT709GammaSrgb) {
+      rgb[i] = sRGB_nonLinearNormToLinear(rgb[i]);
+    }
+  }
+}
+
+typedef struct {
+  // Number of Y Cb Cr inputs checked
+  uint32_t numInputs;
+  // Number of inputs where any output byte differs from float32
+  uint32_t numDifferent;
+  // Largest output byte difference from float32, in 8 bit steps
+  int maxStepError;
+  // Largest linear difference from float32 before output encoding
+  float maxLinearError;
+} DecodePrecisionError;
+
+// Compare the output bytes of the intermediate precision to the
+// float32 intermediate for every Cb Cr pair of each Y in
+// [yStart, yEnd). Call with 0 and 256 to cover the full 8 bit input
+// space, or split the Y range to run ranges in parallel.
+
+static inline
+void decode_precision_error(BT709Gamma gamma, DecodePrecision precision, int yStart, int yEnd, DecodePrecisionError *err) {
+  memset(err, 0, sizeof(DecodePrecisionError));
+
+  for (int Y = yStart; Y < yEnd; Y++) {
+    for (int Cb = 0; Cb < 256; Cb++) {
+      for (int Cr = 0; Cr < 256; Cr++) {
+        float rgb[3];
+        decode_precision_pixel(Y, Cb, Cr, gamma, rgb);
+
+        int isDifferent = 0;
+
+        for (int i = 0; i < 3; i++) {
+          const float stored = decode_precision_store(rgb[i], precision);
+          const int step = abs(decode_precision_srgb_byte(stored) - decode_precision_srgb_byte(rgb[i]));
+          const float linearError = fabsf(stored - rgb[i]);
+
+          if (step != 0) {
+            isDifferent = 1;
+          }
+          if (step > err->maxStepError) {
+            err->maxStepError = step;
+          }
+          if (linearError > err->maxLinearError) {
+            err->maxLinearError = linearError;
+          }
+        }
+
+        err->numInputs += 1;
+        err->numDifferent += isDifferent;
+      }
+    }
+  }
+}
+
+// Decode 4:2:0 planes into an intermediate buffer in the layout of
+// the intermediate pixel format, BGRA sRGB bytes, RGBA halfs or RGBA
+// floats. Alpha is 1.0 since the decode shaders write opaque pixels.
+// This is the CPU cost of the decode write for each precision.
+
+static inline
+void decode_precision_frame(const uint8_t *yPtr, const uint8_t *cbPtr, const uint8_t *crPtr,
+                            int width, int height,
+                            BT709Gamma gamma, DecodePrecision precision,
+                            void *outPtr, int outBytesPerRow)
+{
+  for (int row = 0; row < height; row++) {
+    const uint8_t *yRow = yPtr + (row * width);
+    const uint8_t *cbRow = cbPtr + ((row / 2) * (width / 2));
+    const uint8_t *crRow = crPtr + ((row / 2) * (width / 2));
+    uint8_t *outRow = ((uint8_t *) outPtr) + (row * outBytesPerRow);
+
+    for (int col = 0; col < width; col++) {
+      float rgb[3];
+      decode_precision_pixel(yRow[col], cbRow[col / 2], crRow[col / 2], gamma, rgb);
+
+      if (precision == DecodePrecisionSRGB8) {
+        uint32_t *pixelPtr = ((uint32_t *) outRow) + col;
+        *pixelPtr = 0xFF000000 | (decode_precision_srgb_byte(rgb[0]) << 16) | (decode_precision_srgb_byte(rgb[1]) << 8) | decode_precision_srgb_byte(rgb[2]);
+      } else if (precision == DecodePrecisionFloat16) {
+        uint16_t *pixelPtr = ((uint16_t *) outRow) + (col * 4);
+        pixelPtr[0] = decode_precision_float_to_half(rgb[0]);
+        pixelPtr[1] = decode_precision_float_to_half(rgb[1]);
+        pixelPtr[2] = decode_precision_float_to_half(rgb[2]);
+        pixelPtr[3] = 0x3C00;
+      } else {
+        float *pixelPtr = ((float *) outRow) + (col * 4);
+        pixelPtr[0] = rgb[0];
+        pixelPtr[1] = rgb[1];
+        pixelPtr[2] = rgb[2];
+        pixelPtr[3] = 1.0f;
+      }
+    }
+  }
+}
+
+// Bytes the intermediate texture costs for one frame of the 2 pass
+// path. The decode pass writes every pixel once and the resize pass
+// reads each texel once through the texture cache.
+
+typedef struct {
+  uint32_t bytesPerPixel;
+  uint64_t textureBytes;
+  uint64_t bytesWritten;
+  uint64_t bytesRead;
+} DecodePrecisionTraffic;
+
+static inline
+DecodePrecisionTraffic decode_precision_traffic(int width, int height, DecodePrecision precision) {
+  DecodePrecisionTraffic traffic;
+  traffic.bytesPerPixel = decode_precision_bytes_per_pixel(precision);
+  traffic.textureBytes = ((uint64_t) width) * height * traffic.bytesPerPixel;
+  traffic.bytesWritten = traffic.textureBytes;
+  traffic.bytesRead = traffic.textureBytes;
+  return traffic;
+}
+
+#endif // _DECODE_PRECISION_H
@@ -0,0 +1,550 @@
+//
+//  decode_scaler.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only fused BT.709 decode and resample. 4:2:0 Y Cb Cr
+//  planes, and an optional alpha Y plane, are decoded one input row
+//  at a time straight into the linear light row buffers of the
+//  resample, so the full size decoded frame is never stored. This
+//  is the CPU reference for the fused Metal path in
+//  MetalBT709Decoder, which reads the Y and CbCr textures and writes
+//  the scaled pixels into the view in one render pass.
+//
+//  Filter weights come from linear_scale_filter_init() and are the
+//  same weights the Metal shader reads from a buffer. Decoded values
+//  are rounded to sRGB bytes before conversion to linear light, the
+//  same precision as the BGRA sRGB intermediate texture of the 2 pass
+//  path. Alpha video stores premultiplied color, so color and alpha
+//  are summed as is and the output is premultiplied sRGB BGRA, the
+//  pixels the 2 pass scale writes into the view. Opaque output is
+//  the same as a full size decode followed by linear_scaler.h.
+//
+//  See license.txt for license terms.
+
+#if !defined(_DECODE_SCALER_H)
+#define _DECODE_SCALER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BT709.h"
+#include "bt709_decode.h"
+#include "premultiply.h"
+#include "linear_scaler.h"
+
+#define DS_ERR_SIZE 1
+#define DS_ERR_NO_MEMORY 2
+
+// Input planes, Y and alpha are width bytes per row and Cb and Cr
+// are (width / 2) bytes per row. alphaPtr is NULL for opaque video.
+
+typedef struct {
+  const uint8_t *yPtr;
+  const uint8_t *cbPtr;
+  const uint8_t *crPtr;
+  const uint8_t *alphaPtr;
+} DecodeScalePlanes;
+
+typedef struct {
+  PremultiplyTables tables;
+  BT709Gamma gamma;
+
+  // Matrix terms for each clamped Y Cb Cr byte, same float products
+  // as quality_decode_pixel() so that sRGB and linear frames round
+  // to the bytes bt709_decode_pixel() returns.
+  float decodeY[256];
+  float decodeCbG[256];
+  float decodeCbB[256];
+  float decodeCrR[256];
+  float decodeCrG[256];
+
+  // Alpha Y -> normalized alpha
+  float alphaNorm[256];
+
+  int inWidth;
+  int inHeight;
+  int outWidth;
+  int outHeight;
+
+  LinearScaleFilter hFilter;
+  LinearScaleFilter vFilter;
+
+  int numBands;
+  LinearScaleBand bands[LS_MAX_BANDS];
+
+  // Input rows decoded by each band in the last scale, rows that
+  // are read by 2 bands are decoded twice.
+  int rowsDecoded[LS_MAX_BANDS];
+} DecodeScaler;
+
+// Bytes moved and memory held for one frame
+
+typedef struct {
+  uint64_t bytesRead;
+  uint64_t bytesWritten;
+  uint64_t peakBytes;
+} DecodeScaleTraffic;
+
+static inline
+void decode_scaler_free(DecodeScaler *scaler) {
+  linear_scale_filter_free(&scaler->hFilter);
+  linear_scale_filter_free(&scaler->vFilter);
+
+  for (int i = 0; i < scaler->numBands; i++) {
+    linear_scale_band_free(&scaler->bands[i]);
+  }
+
+  scaler->numBands = 0;
+}
+
+// Plan a decode from inWidth x inHeight to outWidth x outHeight with
+// row buffers for numBands bands. The input dimensions must be even.
+// Returns 0 on success.
+
+static inline
+int decode_scaler_init(DecodeScaler *scaler,
+                       LinearScaleKernel kernel,
+                       BT709Gamma gamma,
+                       int inWidth,
+                       int inHeight,
+                       int outWidth,
+                       int outHeight,
+                       int numBands)
+{
+  memset(scaler, 0, sizeof(DecodeScaler));
+
+  if (inWidth <= 0 || inHeight <= 0 || outWidth <= 0 || outHeight <= 0 ||
+      (inWidth % 2) != 0 || (inHeight % 2) != 0 ||
+      numBands < 1 || numBands > LS_MAX_BANDS) {
+    return DS_ERR_SIZE;
+  }
+
+  scaler->gamma = gamma;
+
+  linear_scaler_tables_init(&scaler->tables, (gamma == BT709GammaLinear));
+
+  const float YScale = 255.0f / (BT709_YMax - BT709_YMin);
+  const float UVScale = 255.0f / (BT709_UVMax - BT709_UVMin);
+
+  uint8_t alphaTable[256];
+  bt709_decode_alpha_table(alphaTable);
+
+  for (int i = 0; i < 256; i++) {
+    const int Y = bt709_decode_clamp(i, BT709_YMin, BT709_YMax);
+    const int UV = bt709_decode_clamp(i, BT709_UVMin, BT709_UVMax);
+    const float Yn = (Y - 16) * (1.0f / 255.0f);
+    const float UVn = (UV - 128) * (1.0f / 255.0f);
+
+    scaler->decodeY[i] = Yn * YScale;
+    scaler->decodeCbG[i] = UVn * (-1.0f * UVScale * BT709_Eb_minus_Ey_Range * BT709_Kb_over_Kg);
+    scaler->decodeCbB[i] = UVn * (UVScale * BT709_Eb_minus_Ey_Range);
+    scaler->decodeCrR[i] = UVn * (UVScale * BT709_Er_minus_Ey_Range);
+    scaler->decodeCrG[i] = UVn * (-1.0f * UVScale * BT709_Er_minus_Ey_Range * BT709_Kr_over_Kg);
+
+    scaler->alphaNorm[i] = scaler->tables.alphaNorm[alphaTable[i]];
+  }
+
+  scaler->inWidth = inWidth;
+  scaler->inHeight = inHeight;
+  scaler->outWidth = outWidth;
+  scaler->outHeight = outHeight;
+
+  if (linear_scale_filter_init(&scaler->hFilter, kernel, inWidth, outWidth) != 0 ||
+      linear_scale_filter_init(&scaler->vFilter, kernel, inHeight, outHeight) != 0) {
+    decode_scaler_free(scaler);
+    return DS_ERR_NO_MEMORY;
+  }
+
+  // No more bands than output rows
+
+  scaler->numBands = (numBands > outHeight) ? outHeight : numBands;
+
+  for (int i = 0; i < scaler->numBands; i++) {
+    if (linear_scale_band_init(&scaler->bands[i], inWidth, outWidth, scaler->vFilter.maxTaps) != 0) {
+      decode_scaler_free(scaler);
+      return DS_ERR_NO_MEMORY;
+    }
+  }
+
+  return 0;
+}
+
+// Decode one input row to linear (B G R A) vectors, the color of an
+// alpha video is already premultiplied
+
+static inline
+void decode_scaler_decode_row(const DecodeScaler *scaler,
+                              const DecodeScalePlanes *planes,
+                              int row,
+                              pm_float4 *outRow)
+{
+  const int width = scaler->inWidth;
+  const uint8_t *yRowPtr = planes->yPtr + ((size_t) row * width);
+  const uint8_t *cbRowPtr = planes->cbPtr + ((size_t) (row / 2) * (width / 2));
+  const uint8_t *crRowPtr = planes->crPtr + ((size_t) (row / 2) * (width / 2));
+  const uint8_t *aRowPtr = (planes->alphaPtr != NULL) ? (planes->alphaPtr + ((size_t) row * width)) : NULL;
+  const float *toLinear = scaler->tables.toLinear;
+
+  for (int col = 0; col < width; col++) {
+    const int Y = yRowPtr[col];
+    const int Cb = cbRowPtr[col / 2];
+    const int Cr = crRowPtr[col / 2];
+
+    int R, G, B;
+
+    if (scaler->gamma == BT709GammaApple) {
+      bt709_decode_pixel(Y, Cb, Cr, scaler->gamma, &R, &G, &B);
+    } else {
+      // Values are saturated, so adding 0.5 and truncating is the same as round()
+
+      const float yTerm = scaler->decodeY[Y];
+
+      R = (int) ((saturatef(yTerm + scaler->decodeCrR[Cr]) * 255.0f) + 0.5f);
+      G = (int) ((saturatef((yTerm + scaler->decodeCbG[Cb]) + scaler->decodeCrG[Cr]) * 255.0f) + 0.5f);
+      B = (int) ((saturatef(yTerm + scaler->decodeCbB[Cb]) * 255.0f) + 0.5f);
+    }
+
+    const float An = (aRowPtr != NULL) ? scaler->alphaNorm[aRowPtr[col]] : 1.0f;
+
+    pm_float4 v = { toLinear[B], toLinear[G], toLinear[R], An };
+    outRow[col] = v;
+  }
+}
+
+// Encode linear premultiplied (B G R A) vectors as premultiplied sRGB
+// BGRA. Negative lobes can overshoot at hard edges, color is clamped
+// to [0, alpha].
+
+static inline
+void decode_scaler_encode_row(const PremultiplyTables *tables, const pm_float4 *inVecs, uint32_t *outPixels, int numPixels) {
+  const float scale = (float) (PM_ENCODE_TABLE_SIZE - 1);
+
+  for (int i = 0; i < numPixels; i++) {
+    const pm_float4 v = inVecs[i];
+    float An = v[3];
+    An = (An < 0.0f) ? 0.0f : ((An > 1.0f) ? 1.0f : An);
+
+    const int A = (int) (An * 255.0f + 0.5f);
+
+    if (A == 0) {
+      outPixels[i] = 0;
+      continue;
+    }
+
+    uint32_t pixel = (uint32_t) A << 24;
+
+    for (int j = 0; j < 3; j++) {
+      float c = v[j];
+      c = (c < 0.0f) ? 0.0f : ((c > An) ? An : c);
+      const int index = (int) (c * scale + 0.5f);
+      pixel |= ((uint32_t) tables->toSRGB[index]) << (j * 8);
+    }
+
+    outPixels[i] = pixel;
+  }
+}
+
+// Decode row into the band input buffer and filter it into a slot
+// of the band row cache unless it is already there
+
+static inline
+const pm_float4* decode_scaler_filtered_row(DecodeScaler *scaler,
+                                            int bandIndex,
+                                            const DecodeScalePlanes *planes,
+                                            int row)
+{
+  LinearScaleBand *band = &scaler->bands[bandIndex];
+  const int slot = row % band->numSlots;
+  pm_float4 *outRow = band->rows + ((size_t) slot * scaler->outWidth);
+
+  if (band->rowInSlot[slot] == row) {
+    return outRow;
+  }
+
+  decode_scaler_decode_row(scaler, planes, row, band->inRow);
+  linear_scale_filter_row(&scaler->hFilter, band->inRow, outRow);
+
+  band->rowInSlot[slot] = row;
+  scaler->rowsDecoded[bandIndex] += 1;
+
+  return outRow;
+}
+
+// Decode and resample output rows [rowStart, rowEnd) with the buffers
+// of one band. Calls with different bands may run on different
+// threads at once.
+
+static inline
+void decode_scaler_scale_rows(DecodeScaler *scaler,
+                              int bandIndex,
+                              const DecodeScalePlanes *planes,
+                              uint32_t *outPixels,
+                              int outPixelsPerRow,
+                              int rowStart,
+                              int rowEnd)
+{
+  LinearScaleBand *band = &scaler->bands[bandIndex];
+  const LinearScaleFilter *vFilter = &scaler->vFilter;
+  const int outWidth = scaler->outWidth;
+
+  for (int i = 0; i < band->numSlots; i++) {
+    band->rowInSlot[i] = -1;
+  }
+
+  scaler->rowsDecoded[bandIndex] = 0;
+
+  for (int row = rowStart; row < rowEnd; row++) {
+    const float *weights = vFilter->weights + ((size_t) row * vFilter->maxTaps);
+    const int start = vFilter->starts[row];
+
+    memset(band->accRow, 0, outWidth * sizeof(pm_float4));
+
+    for (int k = 0; k < vFilter->maxTaps; k++) {
+      const float w = weights[k];
+
+      if (w == 0.0f) {
+        continue;
+      }
+
+      const pm_float4 *inRow = decode_scaler_filtered_row(scaler, bandIndex, planes, start + k);
+
+      for (int col = 0; col < outWidth; col++) {
+        band->accRow[col] += inRow[col] * w;
+      }
+    }
+
+    uint32_t *outRow = outPixels + ((size_t) row * outPixelsPerRow);
+
+    if (planes->alphaPtr != NULL) {
+      decode_scaler_encode_row(&scaler->tables, band->accRow, outRow, outWidth);
+    } else {
+      unpremultiply_linear_row(&scaler->tables, band->accRow, outRow, outWidth);
+    }
+  }
+}
+
+typedef struct {
+  DecodeScaler *scaler;
+  int bandIndex;
+  const DecodeScalePlanes *planes;
+  uint32_t *outPixels;
+  int outPixelsPerRow;
+  int rowStart;
+  int rowEnd;
+} DecodeScaleJob;
+
+static inline
+void* decode_scaler_job_main(void *arg) {
+  DecodeScaleJob *job = (DecodeScaleJob *) arg;
+  decode_scaler_scale_rows(job->scaler, job->bandIndex, job->planes,
+                           job->outPixels, job->outPixelsPerRow,
+                           job->rowStart, job->rowEnd);
+  return NULL;
+}
+
+// Decode and resample a whole frame, each band after the first runs
+// on its own thread and the first band runs on the calling thread.
+
+static inline
+void decode_scaler_scale(DecodeScaler *scaler,
+                         const DecodeScalePlanes *planes,
+                         uint32_t *outPixels,
+                         int outPixelsPerRow)
+{
+  DecodeScaleJob jobs[LS_MAX_BANDS];
+  pthread_t threads[LS_MAX_BANDS];
+  int isRunning[LS_MAX_BANDS];
+
+  const int numBands = scaler->numBands;
+
+  for (int i = 0; i < numBands; i++) {
+    DecodeScaleJob *job = &jobs[i];
+
+    job->scaler = scaler;
+    job->bandIndex = i;
+    job->planes = planes;
+    job->outPixels = outPixels;
+    job->outPixelsPerRow = outPixelsPerRow;
+    job->rowStart = (int) (((int64_t) scaler->outHeight * i) / numBands);
+    job->rowEnd = (int) (((int64_t) scaler->outHeight * (i + 1)) / numBands);
+
+    isRunning[i] = 0;
+
+    if (i > 0 && pthread_create(&threads[i], NULL, decode_scaler_job_main, job) == 0) {
+      isRunning[i] = 1;
+    }
+  }
+
+  // Band 0 and any band whose thread could not be started
+
+  for (int i = 0; i < numBands; i++) {
+    if (!isRunning[i]) {
+      decode_scaler_job_main(&jobs[i]);
+    }
+  }
+
+  for (int i = 1; i < numBands; i++) {
+    if (isRunning[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+}
+
+// Bytes moved by the last decode_scaler_scale(), input plane bytes
+// of each decoded row plus the output pixels. peakBytes is the
+// filter and row buffer memory held by the scaler.
+
+static inline
+DecodeScaleTraffic decode_scaler_traffic(const DecodeScaler *scaler, int hasAlpha) {
+  DecodeScaleTraffic traffic;
+
+  const uint64_t inRowBytes = (uint64_t) scaler->inWidth * (hasAlpha ? 2 : 1) + scaler->inWidth / 2;
+
+  traffic.bytesRead = 0;
+
+  for (int i = 0; i < scaler->numBands; i++) {
+    traffic.bytesRead += inRowBytes * scaler->rowsDecoded[i];
+  }
+
+  traffic.bytesWritten = (uint64_t) scaler->outWidth * scaler->outHeight * sizeof(uint32_t);
+
+  const LinearScaleFilter *hFilter = &scaler->hFilter;
+  const LinearScaleFilter *vFilter = &scaler->vFilter;
+
+  traffic.peakBytes = (uint64_t) hFilter->outSize * (sizeof(int) + hFilter->maxTaps * sizeof(float));
+  traffic.peakBytes += (uint64_t) vFilter->outSize * (sizeof(int) + vFilter->maxTaps * sizeof(float));
+
+  for (int i = 0; i < scaler->numBands; i++) {
+    const LinearScaleBand *band = &scaler->bands[i];
+    traffic.peakBytes += ((uint64_t) scaler->inWidth + ((uint64_t) band->numSlots + 1) * scaler->outWidth) * sizeof(pm_float4);
+    traffic.peakBytes += band->numSlots * sizeof(int);
+  }
+
+  return traffic;
+}
+
+// Bytes moved by the 2 pass path for one frame: the planes are read
+// and decoded into a full size intermediate of intermediateBytesPerPixel
+// bytes, which is then read back and resampled into the output.
+// peakBytes is the intermediate texture.
+
+static inline
+DecodeScaleTraffic decode_scaler_two_pass_traffic(int inWidth,
+                                                  int inHeight,
+                                                  int outWidth,
+                                                  int outHeight,
+                                                  int hasAlpha,
+                                                  int intermediateBytesPerPixel)
+{
+  DecodeScaleTraffic traffic;
+
+  const uint64_t numInPixels = (uint64_t) inWidth * inHeight;
+  const uint64_t planeBytes = numInPixels * (hasAlpha ? 2 : 1) + numInPixels / 2;
+  const uint64_t intermediateBytes = numInPixels * intermediateBytesPerPixel;
+
+  traffic.bytesRead = planeBytes + intermediateBytes;
+  traffic.bytesWritten = intermediateBytes + (uint64_t) outWidth * outHeight * sizeof(uint32_t);
+  traffic.peakBytes = intermediateBytes;
+
+  return traffic;
+}
+
+// Bytes moved by the fused Metal path for one frame, each plane
+// is read once and only the output is written. peakBytes is the
+// filter buffer.
+
+static inline
+DecodeScaleTraffic decode_scaler_fused_traffic(int inWidth,
+                                               int inHeight,
+                                               int outWidth,
+                                               int outHeight,
+                                               int hasAlpha,
+                                               LinearScaleKernel kernel)
+{
+  DecodeScaleTraffic traffic;
+
+  const uint64_t numInPixels = (uint64_t) inWidth * inHeight;
+
+  traffic.bytesRead = numInPixels * (hasAlpha ? 2 : 1) + numInPixels / 2;
+  traffic.bytesWritten = (uint64_t) outWidth * outHeight * sizeof(uint32_t);
+
+  LinearScaleFilter hFilter;
+  LinearScaleFilter vFilter;
+
+  traffic.peakBytes = 0;
+
+  if (linear_scale_filter_init(&hFilter, kernel, inWidth, outWidth) == 0) {
+    traffic.peakBytes += (uint64_t) outWidth * (sizeof(int) + hFilter.maxTaps * sizeof(float));
+    linear_scale_filter_free(&hFilter);
+  }
+
+  if (linear_scale_filter_init(&vFilter, kernel, inHeight, outHeight) == 0) {
+    traffic.peakBytes += (uint64_t) outHeight * (sizeof(int) + vFilter.maxTaps * sizeof(float));
+    linear_scale_filter_free(&vFilter);
+  }
+
+  return traffic;
+}
+
+// Decodes per output pixel of the fused Metal path. Every pixel of a
+// SIMD group runs the loop over all hTaps x vTaps taps, so taps with
+// a zero weight cost as much as the others.
+
+static inline
+double decode_scaler_fused_decodes(int inWidth,
+                                   int inHeight,
+                                   int outWidth,
+                                   int outHeight,
+                                   LinearScaleKernel kernel)
+{
+  return (double) linear_scale_filter_max_taps(kernel, inWidth, outWidth) *
+    linear_scale_filter_max_taps(kernel, inHeight, outHeight);
+}
+
+// Decodes per output pixel of the 2 pass path, each input pixel is
+// decoded once.
+
+static inline
+double decode_scaler_two_pass_decodes(int inWidth,
+                                      int inHeight,
+                                      int outWidth,
+                                      int outHeight)
+{
+  return ((double) inWidth * inHeight) / ((double) outWidth * outHeight);
+}
+
+// A decode with gamma is about 40 ALU ops. A GPU runs about 25 to 75
+// ALU ops in the time it moves one byte, so one decode costs about
+// as much as moving one byte.
+
+#define DS_FUSED_BYTES_PER_DECODE 1.0
+
+// Returns 1 when the fused path is expected to be faster than the 2
+// pass path. The fused path decodes 4 to 12 times more pixels but
+// does not write and read back an intermediate texel for each input
+// pixel. With the tent filter and a 4 byte intermediate it is used
+// for most scales below 0.6. A slight downscale would decode 20 times
+// more pixels to save a few bytes per output pixel.
+
+static inline
+int decode_scaler_use_fused(int inWidth,
+                            int inHeight,
+                            int outWidth,
+                            int outHeight,
+                            int intermediateBytesPerPixel)
+{
+  if (outWidth <= 0 || outHeight <= 0 || outWidth > inWidth || outHeight > inHeight) {
+    return 0;
+  }
+
+  const double fusedDecodes = decode_scaler_fused_decodes(inWidth, inHeight, outWidth, outHeight, LinearScaleKernelBilinear);
+  const double twoPassDecodes = decode_scaler_two_pass_decodes(inWidth, inHeight, outWidth, outHeight);
+
+  const double bytesSaved = twoPassDecodes * intermediateBytesPerPixel * 2;
+
+  return bytesSaved >= (fusedDecodes - twoPassDecodes) * DS_FUSED_BYTES_PER_DECODE;
+}
+
+#endif // _DECODE_SCALER_H
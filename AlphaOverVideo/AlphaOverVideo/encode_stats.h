@@ -0,0 +1,284 @@
+//
+//  encode_stats.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that records per stage timing and memory
+//  use while frames are converted to YCbCr and written. Each stage
+//  keeps wall and CPU time totals, a log2 histogram of wall time,
+//  bytes read and written and the process peak RSS seen at the end
+//  of the stage. Recording a stage costs two clock reads and one
+//  getrusage() call, so stats can be left on for CI runs.
+//
+//  See license.txt for license terms.
+
+#if !defined(_ENCODE_STATS_H)
+#define _ENCODE_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// Histogram bucket i counts samples where the wall time in microseconds
+// is in [2^i, 2^(i+1)), bucket 0 also counts samples under 1 us.
+
+#define ENCODE_STATS_NUM_BUCKETS 32
+
+typedef enum {
+  // Read the image file and decode to pixels
+  EncodeStageDecode = 0,
+  // Render into the colorspace and bit depth used for conversion
+  EncodeStageRender,
+  // RGB to subsampled YCbCr
+  EncodeStageConvert,
+  // Copy YCbCr planes out of the CoreVideo buffer
+  EncodeStageCopy,
+  // Pass planes to the encoder backend
+  EncodeStageWrite,
+  // Hash input files and read or write frame cache entries
+  EncodeStageCache,
+  // Build the linear light pyramid and resample each rendition
+  EncodeStageScale,
+  EncodeStageNum
+} EncodeStage;
+
+typedef struct {
+  uint64_t count;
+  uint64_t wallNanos;
+  uint64_t cpuNanos;
+  uint64_t maxWallNanos;
+  uint64_t bytesRead;
+  uint64_t bytesWritten;
+  // Process peak RSS when the stage last ended
+  uint64_t peakRSSBytes;
+  // Sum of the peak RSS increase while in this stage
+  uint64_t peakRSSGrowthBytes;
+  uint32_t wallHistogram[ENCODE_STATS_NUM_BUCKETS];
+} EncodeStageStats;
+
+typedef struct {
+  int enabled;
+  uint64_t startWallNanos;
+  uint64_t startCpuNanos;
+  EncodeStageStats stages[EncodeStageNum];
+} EncodeStats;
+
+// Times at the start of a stage
+
+typedef struct {
+  uint64_t wallNanos;
+  uint64_t cpuNanos;
+  uint64_t peakRSSBytes;
+} EncodeStatsMark;
+
+static inline
+const char* encode_stats_stage_name(EncodeStage stage) {
+  static const char *names[EncodeStageNum] = { "decode", "render", "convert", "copy", "write", "cache", "scale" };
+  return names[stage];
+}
+
+static inline
+uint64_t encode_stats_clock_nanos(clockid_t clockId) {
+  struct timespec ts;
+  clock_gettime(clockId, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000ull) + (uint64_t) ts.tv_nsec;
+}
+
+// Process peak RSS in bytes, ru_maxrss is bytes on Darwin and KB on Linux
+
+static inline
+uint64_t encode_stats_peak_rss_bytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return (uint64_t) usage.ru_maxrss;
+#else
+  return (uint64_t) usage.ru_maxrss * 1024;
+#endif // __APPLE__
+}
+
+static inline
+void encode_stats_init(EncodeStats *stats, int enabled) {
+  memset(stats, 0, sizeof(EncodeStats));
+  stats->enabled = enabled;
+
+  if (enabled) {
+    stats->startWallNanos = encode_stats_clock_nanos(CLOCK_MONOTONIC);
+    stats->startCpuNanos = encode_stats_clock_nanos(CLOCK_PROCESS_CPUTIME_ID);
+  }
+}
+
+// CPU time is for the whole process so that work done on other
+// threads, for example by CoreGraphics, is counted.
+
+static inline
+void encode_stats_begin(const EncodeStats *stats, EncodeStatsMark *mark) {
+  if (stats == NULL || !stats->enabled) {
+    return;
+  }
+
+  mark->wallNanos = encode_stats_clock_nanos(CLOCK_MONOTONIC);
+  mark->cpuNanos = encode_stats_clock_nanos(CLOCK_PROCESS_CPUTIME_ID);
+  mark->peakRSSBytes = encode_stats_peak_rss_bytes();
+}
+
+static inline
+void encode_stats_end(EncodeStats *stats, EncodeStage stage, const EncodeStatsMark *mark,
+                      uint64_t bytesRead, uint64_t bytesWritten) {
+  if (stats == NULL || !stats->enabled) {
+    return;
+  }
+
+  const uint64_t wallNanos = encode_stats_clock_nanos(CLOCK_MONOTONIC) - mark->wallNanos;
+  const uint64_t cpuNanos = encode_stats_clock_nanos(CLOCK_PROCESS_CPUTIME_ID) - mark->cpuNanos;
+  const uint64_t peakRSSBytes = encode_stats_peak_rss_bytes();
+
+  EncodeStageStats *s = &stats->stages[stage];
+
+  s->count += 1;
+  s->wallNanos += wallNanos;
+  s->cpuNanos += cpuNanos;
+  s->maxWallNanos = (wallNanos > s->maxWallNanos) ? wallNanos : s->maxWallNanos;
+  s->bytesRead += bytesRead;
+  s->bytesWritten += bytesWritten;
+  s->peakRSSBytes = peakRSSBytes;
+  s->peakRSSGrowthBytes += (peakRSSBytes - mark->peakRSSBytes);
+
+  uint64_t micros = wallNanos / 1000;
+  int bucket = 0;
+
+  while (micros > 1 && bucket < (ENCODE_STATS_NUM_BUCKETS - 1)) {
+    micros >>= 1;
+    bucket += 1;
+  }
+
+  s->wallHistogram[bucket] += 1;
+}
+
+// Count bytes written outside of a timed stage, for example the
+// size of an output file once it has been closed.
+
+static inline
+void encode_stats_add_bytes_written(EncodeStats *stats, EncodeStage stage, uint64_t bytesWritten) {
+  if (stats == NULL || !stats->enabled) {
+    return;
+  }
+
+  stats->stages[stage].bytesWritten += bytesWritten;
+}
+
+// Upper bound in milliseconds of the histogram bucket that holds the
+// given percentile (0 to 100) of samples.
+
+static inline
+double encode_stats_percentile_ms(const EncodeStageStats *s, int percentile) {
+  if (s->count == 0) {
+    return 0.0;
+  }
+
+  const uint64_t target = ((s->count * (uint64_t) percentile) + 99) / 100;
+  uint64_t sum = 0;
+
+  for (int i = 0; i < ENCODE_STATS_NUM_BUCKETS; i++) {
+    sum += s->wallHistogram[i];
+    if (sum >= target) {
+      double upperMs = (double) (1ull << (i + 1)) / 1000.0;
+      double maxMs = s->maxWallNanos / 1000000.0;
+      return (upperMs < maxMs) ? upperMs : maxMs;
+    }
+  }
+
+  return s->maxWallNanos / 1000000.0;
+}
+
+static inline
+void encode_stats_print(const EncodeStats *stats, FILE *outFile) {
+  if (!stats->enabled) {
+    return;
+  }
+
+  const double totalWallMs = (encode_stats_clock_nanos(CLOCK_MONOTONIC) - stats->startWallNanos) / 1000000.0;
+  const double totalCpuMs = (encode_stats_clock_nanos(CLOCK_PROCESS_CPUTIME_ID) - stats->startCpuNanos) / 1000000.0;
+
+  fprintf(outFile, "%-8s %6s %10s %8s %8s %8s %8s %10s %6s %9s %9s %9s %9s\n",
+          "stage", "count", "wall ms", "mean ms", "p50 ms", "p90 ms", "max ms",
+          "cpu ms", "cpu %", "MB read", "MB write", "RSS MB", "RSS +MB");
+
+  for (int i = 0; i < EncodeStageNum; i++) {
+    const EncodeStageStats *s = &stats->stages[i];
+
+    if (s->count == 0 && s->bytesWritten == 0) {
+      continue;
+    }
+
+    const double wallMs = s->wallNanos / 1000000.0;
+    const double cpuMs = s->cpuNanos / 1000000.0;
+
+    fprintf(outFile, "%-8s %6d %10.1f %8.2f %8.2f %8.2f %8.2f %10.1f %6.0f %9.1f %9.1f %9.1f %9.1f\n",
+            encode_stats_stage_name((EncodeStage) i),
+            (int) s->count,
+            wallMs,
+            (s->count > 0) ? (wallMs / s->count) : 0.0,
+            encode_stats_percentile_ms(s, 50),
+            encode_stats_percentile_ms(s, 90),
+            s->maxWallNanos / 1000000.0,
+            cpuMs,
+            (wallMs > 0.0) ? (100.0 * cpuMs / wallMs) : 0.0,
+            s->bytesRead / 1000000.0,
+            s->bytesWritten / 1000000.0,
+            s->peakRSSBytes / 1000000.0,
+            s->peakRSSGrowthBytes / 1000000.0);
+  }
+
+  fprintf(outFile, "total wall %.1f ms, cpu %.1f ms, peak RSS %.1f MB\n",
+          totalWallMs, totalCpuMs, encode_stats_peak_rss_bytes() / 1000000.0);
+}
+
+// Write stage totals and histograms as JSON, returns 0 on success
+
+static inline
+int encode_stats_write_json(const EncodeStats *stats, const char *outFilePath) {
+  FILE *outFile = fopen(outFilePath, "w");
+
+  if (outFile == NULL) {
+    return 1;
+  }
+
+  fprintf(outFile, "{\n");
+  fprintf(outFile, "  \"wall_ns\": %llu,\n", (unsigned long long) (encode_stats_clock_nanos(CLOCK_MONOTONIC) - stats->startWallNanos));
+  fprintf(outFile, "  \"cpu_ns\": %llu,\n", (unsigned long long) (encode_stats_clock_nanos(CLOCK_PROCESS_CPUTIME_ID) - stats->startCpuNanos));
+  fprintf(outFile, "  \"peak_rss_bytes\": %llu,\n", (unsigned long long) encode_stats_peak_rss_bytes());
+  fprintf(outFile, "  \"histogram_bucket_us\": \"bucket i counts wall times in [2^i, 2^(i+1)) us\",\n");
+  fprintf(outFile, "  \"stages\": {\n");
+
+  for (int i = 0; i < EncodeStageNum; i++) {
+    const EncodeStageStats *s = &stats->stages[i];
+
+    fprintf(outFile, "    \"%s\": {\n", encode_stats_stage_name((EncodeStage) i));
+    fprintf(outFile, "      \"count\": %llu,\n", (unsigned long long) s->count);
+    fprintf(outFile, "      \"wall_ns\": %llu,\n", (unsigned long long) s->wallNanos);
+    fprintf(outFile, "      \"cpu_ns\": %llu,\n", (unsigned long long) s->cpuNanos);
+    fprintf(outFile, "      \"max_wall_ns\": %llu,\n", (unsigned long long) s->maxWallNanos);
+    fprintf(outFile, "      \"bytes_read\": %llu,\n", (unsigned long long) s->bytesRead);
+    fprintf(outFile, "      \"bytes_written\": %llu,\n", (unsigned long long) s->bytesWritten);
+    fprintf(outFile, "      \"peak_rss_bytes\": %llu,\n", (unsigned long long) s->peakRSSBytes);
+    fprintf(outFile, "      \"peak_rss_growth_bytes\": %llu,\n", (unsigned long long) s->peakRSSGrowthBytes);
+    fprintf(outFile, "      \"wall_histogram\": [");
+
+    for (int b = 0; b < ENCODE_STATS_NUM_BUCKETS; b++) {
+      fprintf(outFile, "%s%u", (b == 0) ? "" : ", ", s->wallHistogram[b]);
+    }
+
+    fprintf(outFile, "]\n");
+    fprintf(outFile, "    }%s\n", (i < (EncodeStageNum - 1)) ? "," : "");
+  }
+
+  fprintf(outFile, "  }\n");
+  fprintf(outFile, "}\n");
+
+  return (fclose(outFile) == 0) ? 0 : 1;
+}
+
+#endif // _ENCODE_STATS_H
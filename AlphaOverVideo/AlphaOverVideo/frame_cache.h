@@ -0,0 +1,447 @@
+//
+//  frame_cache.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface to a content addressed cache of converted
+//  frames. The key is a 128 bit hash of the conversion settings and
+//  of the input file contents that define the image. For PNG files
+//  text and time chunks are skipped, so a re-rendered frame with the
+//  same pixels and a new timestamp still hits. Hashing the file means
+//  a hit skips decode as well as conversion.
+//
+//  Each entry is one file named by the key, holding a small header
+//  and the Y, Cb and Cr planes compressed with zlib. Entries are
+//  written to a temp file and renamed, so an interrupted run or two
+//  runs sharing a cache directory never leave a partial entry.
+//
+//  See license.txt for license terms.
+
+#if !defined(_FRAME_CACHE_H)
+#define _FRAME_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "png_reader.h"
+
+// 'AOVF' in host byte order
+#define FRAME_CACHE_MAGIC 0x46564F41
+
+// Increment when conversion output changes so that old entries miss
+#define FRAME_CACHE_VERSION 1
+
+#define FRAME_CACHE_ERR_IO 1
+#define FRAME_CACHE_ERR_MALFORMED 2
+#define FRAME_CACHE_ERR_NO_MEMORY 3
+
+typedef struct {
+  uint64_t h1;
+  uint64_t h2;
+} FrameCacheKey;
+
+// Streaming hash state, 4 independent 64 bit lanes consume 32 byte
+// stripes with the same round as xxHash64. Two differently mixed
+// 64 bit results are taken from the lanes at the end.
+
+typedef struct {
+  uint64_t lanes[4];
+  uint8_t stripe[32];
+  int stripeLen;
+  uint64_t totalLen;
+} FrameHashState;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t h1;
+  uint64_t h2;
+  uint32_t width;
+  uint32_t height;
+  // Compressed size of the Y, Cb and Cr planes in file order
+  uint32_t compressedNumBytes[3];
+  uint32_t reserved;
+} FrameCacheEntryHeader;
+
+typedef struct {
+  int width;
+  int height;
+  // Y is width * height, Cb and Cr are (width / 2) * (height / 2)
+  uint8_t *planes[3];
+} FrameCacheEntry;
+
+typedef struct {
+  // Same key as the previous frame, planes reused in memory
+  uint64_t numRepeatHits;
+  // Read from the cache directory
+  uint64_t numStoreHits;
+  uint64_t numMisses;
+  // Compressed bytes written to the cache directory
+  uint64_t numBytesStored;
+} FrameCacheStats;
+
+#define FRAME_HASH_P1 0x9E3779B185EBCA87ULL
+#define FRAME_HASH_P2 0xC2B2AE3D27D4EB4FULL
+#define FRAME_HASH_P3 0x165667B19E3779F9ULL
+#define FRAME_HASH_P4 0x85EBCA77C2B2AE63ULL
+
+static inline
+uint64_t frame_hash_rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline
+uint64_t frame_hash_round(uint64_t lane, uint64_t v) {
+  lane += v * FRAME_HASH_P2;
+  lane = frame_hash_rotl(lane, 31);
+  return lane * FRAME_HASH_P1;
+}
+
+static inline
+uint64_t frame_hash_avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= FRAME_HASH_P2;
+  h ^= h >> 29;
+  h *= FRAME_HASH_P3;
+  h ^= h >> 32;
+  return h;
+}
+
+static inline
+void frame_hash_init(FrameHashState *state) {
+  memset(state, 0, sizeof(FrameHashState));
+  state->lanes[0] = FRAME_HASH_P1 + FRAME_HASH_P2;
+  state->lanes[1] = FRAME_HASH_P2;
+  state->lanes[2] = 0;
+  state->lanes[3] = 0 - FRAME_HASH_P1;
+}
+
+static inline
+void frame_hash_stripe(FrameHashState *state, const uint8_t *ptr) {
+  uint64_t v[4];
+  memcpy(v, ptr, sizeof(v));
+
+  for (int i = 0; i < 4; i++) {
+    state->lanes[i] = frame_hash_round(state->lanes[i], v[i]);
+  }
+}
+
+static inline
+void frame_hash_update(FrameHashState *state, const void *bytes, size_t numBytes) {
+  const uint8_t *ptr = (const uint8_t *) bytes;
+
+  state->totalLen += numBytes;
+
+  if (state->stripeLen > 0) {
+    size_t n = 32 - state->stripeLen;
+    if (n > numBytes) {
+      n = numBytes;
+    }
+    memcpy(state->stripe + state->stripeLen, ptr, n);
+    state->stripeLen += (int) n;
+    ptr += n;
+    numBytes -= n;
+
+    if (state->stripeLen < 32) {
+      return;
+    }
+
+    frame_hash_stripe(state, state->stripe);
+    state->stripeLen = 0;
+  }
+
+  for ( ; numBytes >= 32; ptr += 32, numBytes -= 32) {
+    frame_hash_stripe(state, ptr);
+  }
+
+  memcpy(state->stripe, ptr, numBytes);
+  state->stripeLen = (int) numBytes;
+}
+
+static inline
+FrameCacheKey frame_hash_final(const FrameHashState *state) {
+  // Zero pad the last partial stripe, the total length is mixed in below
+
+  FrameHashState s = *state;
+
+  if (s.stripeLen > 0) {
+    memset(s.stripe + s.stripeLen, 0, 32 - s.stripeLen);
+    frame_hash_stripe(&s, s.stripe);
+  }
+
+  const uint64_t *l = s.lanes;
+
+  uint64_t h1 = frame_hash_rotl(l[0], 1) + frame_hash_rotl(l[1], 7) + frame_hash_rotl(l[2], 12) + frame_hash_rotl(l[3], 18);
+  uint64_t h2 = (l[0] * FRAME_HASH_P3) ^ frame_hash_rotl(l[1] * FRAME_HASH_P4, 17) ^
+                frame_hash_rotl(l[2] * FRAME_HASH_P1, 31) ^ frame_hash_rotl(l[3] * FRAME_HASH_P2, 47);
+
+  FrameCacheKey key;
+  key.h1 = frame_hash_avalanche(h1 ^ (s.totalLen * FRAME_HASH_P4));
+  key.h2 = frame_hash_avalanche(h2 + s.totalLen);
+  return key;
+}
+
+static inline
+int frame_cache_key_equal(const FrameCacheKey *a, const FrameCacheKey *b) {
+  return (a->h1 == b->h1 && a->h2 == b->h2);
+}
+
+// Hash the image defining contents of a file in memory. PNG ancillary
+// chunks that do not change pixels (tEXt, zTXt, iTXt, tIME) and the
+// chunk CRCs are skipped, any other file is hashed as is.
+
+static inline
+void frame_cache_hash_buffer(FrameHashState *state, const uint8_t *data, size_t len) {
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  if (len < 8 || memcmp(data, signature, 8) != 0) {
+    frame_hash_update(state, data, len);
+    return;
+  }
+
+  size_t offset = 8;
+
+  while (offset + 12 <= len) {
+    uint32_t chunkLen = png_read_be32(data + offset);
+    const uint8_t *type = data + offset + 4;
+
+    if (chunkLen > len - offset - 12) {
+      // Truncated, hash the remaining bytes
+      break;
+    }
+
+    if (memcmp(type, "tEXt", 4) != 0 && memcmp(type, "zTXt", 4) != 0 &&
+        memcmp(type, "iTXt", 4) != 0 && memcmp(type, "tIME", 4) != 0) {
+      frame_hash_update(state, data + offset, 8 + chunkLen);
+    }
+
+    offset += 12 + chunkLen;
+  }
+
+  frame_hash_update(state, data + offset, len - offset);
+}
+
+// Key for one input file, settings holds every conversion option that
+// changes the output. Returns 0 on success.
+
+static inline
+int frame_cache_key_for_file(const char *inFilePath, const char *settings, FrameCacheKey *key) {
+  PngMappedFile mapped;
+
+  if (png_map_file(inFilePath, &mapped) != 0) {
+    return FRAME_CACHE_ERR_IO;
+  }
+
+  FrameHashState state;
+  frame_hash_init(&state);
+
+  const uint32_t version = FRAME_CACHE_VERSION;
+  frame_hash_update(&state, &version, sizeof(version));
+  frame_hash_update(&state, settings, strlen(settings) + 1);
+
+  frame_cache_hash_buffer(&state, mapped.data, mapped.len);
+
+  png_unmap_file(&mapped);
+
+  *key = frame_hash_final(&state);
+
+  return 0;
+}
+
+static inline
+void frame_cache_entry_path(const char *cacheDir, const FrameCacheKey *key, char *path, size_t pathLen) {
+  snprintf(path, pathLen, "%s/%016llx%016llx.ycbcr", cacheDir,
+           (unsigned long long) key->h1, (unsigned long long) key->h2);
+}
+
+static inline
+void frame_cache_entry_free(FrameCacheEntry *entry) {
+  for (int i = 0; i < 3; i++) {
+    free(entry->planes[i]);
+    entry->planes[i] = NULL;
+  }
+}
+
+// Write one entry, planes are packed with no row padding. Returns 0 on success.
+
+static inline
+int frame_cache_write_entry(const char *cacheDir, const FrameCacheKey *key,
+                            int width, int height,
+                            const uint8_t *Y, const uint8_t *Cb, const uint8_t *Cr,
+                            FrameCacheStats *stats) {
+  const uint8_t *planes[3] = { Y, Cb, Cr };
+  const size_t planeNumBytes[3] = {
+    (size_t) width * height,
+    (size_t) (width / 2) * (height / 2),
+    (size_t) (width / 2) * (height / 2)
+  };
+
+  FrameCacheEntryHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = FRAME_CACHE_MAGIC;
+  header.version = FRAME_CACHE_VERSION;
+  header.h1 = key->h1;
+  header.h2 = key->h2;
+  header.width = (uint32_t) width;
+  header.height = (uint32_t) height;
+
+  uint8_t *compressed[3] = { NULL, NULL, NULL };
+  int err = 0;
+
+  for (int i = 0; i < 3 && err == 0; i++) {
+    uLongf numBytes = compressBound((uLong) planeNumBytes[i]);
+    compressed[i] = (uint8_t *) malloc(numBytes);
+
+    if (compressed[i] == NULL) {
+      err = FRAME_CACHE_ERR_NO_MEMORY;
+    } else if (compress2(compressed[i], &numBytes, planes[i], (uLong) planeNumBytes[i], 1) != Z_OK) {
+      err = FRAME_CACHE_ERR_NO_MEMORY;
+    } else {
+      header.compressedNumBytes[i] = (uint32_t) numBytes;
+    }
+  }
+
+  char path[4096];
+  char tmpPath[4096 + 32];
+  frame_cache_entry_path(cacheDir, key, path, sizeof(path));
+  snprintf(tmpPath, sizeof(tmpPath), "%s.%d.tmp", path, (int) getpid());
+
+  FILE *outFile = NULL;
+
+  if (err == 0) {
+    outFile = fopen(tmpPath, "wb");
+    if (outFile == NULL) {
+      err = FRAME_CACHE_ERR_IO;
+    }
+  }
+
+  if (err == 0 && fwrite(&header, sizeof(header), 1, outFile) != 1) {
+    err = FRAME_CACHE_ERR_IO;
+  }
+
+  for (int i = 0; i < 3 && err == 0; i++) {
+    if (fwrite(compressed[i], header.compressedNumBytes[i], 1, outFile) != 1) {
+      err = FRAME_CACHE_ERR_IO;
+    }
+  }
+
+  if (outFile != NULL && fclose(outFile) != 0) {
+    err = FRAME_CACHE_ERR_IO;
+  }
+
+  if (outFile != NULL && err == 0 && rename(tmpPath, path) != 0) {
+    err = FRAME_CACHE_ERR_IO;
+  }
+
+  if (outFile != NULL && err != 0) {
+    unlink(tmpPath);
+  }
+
+  for (int i = 0; i < 3; i++) {
+    free(compressed[i]);
+  }
+
+  if (err == 0 && stats != NULL) {
+    stats->numBytesStored += sizeof(header) + header.compressedNumBytes[0] +
+      header.compressedNumBytes[1] + header.compressedNumBytes[2];
+  }
+
+  return err;
+}
+
+// Read the entry for key, returns FRAME_CACHE_ERR_IO when there is no
+// entry and 0 on success. The caller frees the entry with
+// frame_cache_entry_free().
+
+static inline
+int frame_cache_read_entry(const char *cacheDir, const FrameCacheKey *key, FrameCacheEntry *entry) {
+  memset(entry, 0, sizeof(FrameCacheEntry));
+
+  char path[4096];
+  frame_cache_entry_path(cacheDir, key, path, sizeof(path));
+
+  // A miss is the common case, check quietly before mapping
+
+  if (access(path, R_OK) != 0) {
+    return FRAME_CACHE_ERR_IO;
+  }
+
+  PngMappedFile mapped;
+
+  if (png_map_file(path, &mapped) != 0) {
+    return FRAME_CACHE_ERR_IO;
+  }
+
+  FrameCacheEntryHeader header;
+  int err = 0;
+
+  if (mapped.len < sizeof(header)) {
+    err = FRAME_CACHE_ERR_MALFORMED;
+  } else {
+    memcpy(&header, mapped.data, sizeof(header));
+
+    const uint64_t numBytes = (uint64_t) sizeof(header) + header.compressedNumBytes[0] +
+      header.compressedNumBytes[1] + header.compressedNumBytes[2];
+
+    if (header.magic != FRAME_CACHE_MAGIC || header.version != FRAME_CACHE_VERSION ||
+        header.h1 != key->h1 || header.h2 != key->h2 ||
+        header.width == 0 || header.height == 0 ||
+        header.width > 16384 || header.height > 16384 ||
+        numBytes != mapped.len) {
+      err = FRAME_CACHE_ERR_MALFORMED;
+    }
+  }
+
+  const uint8_t *ptr = mapped.data + sizeof(header);
+
+  for (int i = 0; i < 3 && err == 0; i++) {
+    uLongf planeNumBytes = (i == 0) ?
+      (uLongf) header.width * header.height :
+      (uLongf) (header.width / 2) * (header.height / 2);
+
+    entry->planes[i] = (uint8_t *) malloc(planeNumBytes);
+
+    if (entry->planes[i] == NULL) {
+      err = FRAME_CACHE_ERR_NO_MEMORY;
+      break;
+    }
+
+    uLongf inflatedNumBytes = planeNumBytes;
+
+    if (uncompress(entry->planes[i], &inflatedNumBytes, ptr, header.compressedNumBytes[i]) != Z_OK ||
+        inflatedNumBytes != planeNumBytes) {
+      err = FRAME_CACHE_ERR_MALFORMED;
+    }
+
+    ptr += header.compressedNumBytes[i];
+  }
+
+  png_unmap_file(&mapped);
+
+  if (err != 0) {
+    frame_cache_entry_free(entry);
+    return err;
+  }
+
+  entry->width = (int) header.width;
+  entry->height = (int) header.height;
+
+  return 0;
+}
+
+static inline
+void frame_cache_print_stats(const FrameCacheStats *stats, FILE *outFile) {
+  fprintf(outFile, "frame cache : %llu repeated, %llu cached, %llu converted, %.1f MB stored\n",
+          (unsigned long long) stats->numRepeatHits,
+          (unsigned long long) stats->numStoreHits,
+          (unsigned long long) stats->numMisses,
+          stats->numBytesStored / 1000000.0);
+}
+
+#endif // _FRAME_CACHE_H
@@ -0,0 +1,301 @@
+//
+//  frame_pool.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only pool of preallocated frame handles with intrusive
+//  reference counts. A handle holds the decoded buffers of one frame
+//  and a fixed size timing record, so that handing frames from a
+//  frame source to a view does not allocate once playback has
+//  started. Buffers are opaque pointers retained and released with
+//  callbacks, CFRetain and CFRelease for CoreVideo pixel buffers.
+//
+//  A pool is created once per frame source. When the last reference
+//  to a handle is dropped its buffers are released and the handle
+//  goes back on the free list. A pool that is closed while handles
+//  are still held by a view is freed when the last handle is released.
+//
+//  See license.txt for license terms.
+
+#if !defined(_FRAME_POOL_H)
+#define _FRAME_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// Frame buffers per handle, Y Cb Cr and alpha
+
+#define FRAME_POOL_NUM_BUFFERS 2
+
+#define FRAME_POOL_MAX_HANDLES 64
+
+typedef void (*FramePoolBufferFunc)(void *buffer);
+
+// Timing of one decoded frame, -1 where a time is not known
+
+typedef struct {
+  double hostTime;
+  double itemTime;
+  double presentationTime;
+  int frameNum;
+} FrameTimingRecord;
+
+typedef struct FramePool FramePool;
+
+typedef struct {
+  atomic_int refCount;
+  int index;
+  FramePool *pool;
+  void *buffers[FRAME_POOL_NUM_BUFFERS];
+  FrameTimingRecord timing;
+  // Object that wraps this handle, set once when the pool is created
+  void *userData;
+} FramePoolHandle;
+
+struct FramePool {
+  FramePoolHandle handles[FRAME_POOL_MAX_HANDLES];
+  int freeIndexes[FRAME_POOL_MAX_HANDLES];
+  int numHandles;
+  int numFree;
+
+  // Set by frame_pool_close()
+  int closed;
+
+  FramePoolBufferFunc retainBuffer;
+  FramePoolBufferFunc releaseBuffer;
+
+  pthread_mutex_t mutex;
+
+  // Totals
+  uint64_t numAcquired;
+  // Acquire calls that found every handle in use
+  uint64_t numExhausted;
+  // Most handles in use at once
+  int maxInUse;
+};
+
+static inline
+void frame_timing_record_clear(FrameTimingRecord *record) {
+  record->hostTime = -1;
+  record->itemTime = -1;
+  record->presentationTime = -1;
+  record->frameNum = -1;
+}
+
+// Allocate a pool of numHandles handles, this is the only allocation
+// the pool makes. Returns NULL when numHandles is out of range or
+// memory is not available. retainBuffer and releaseBuffer can be NULL.
+
+static inline
+FramePool* frame_pool_create(int numHandles, FramePoolBufferFunc retainBuffer, FramePoolBufferFunc releaseBuffer) {
+  if (numHandles < 1 || numHandles > FRAME_POOL_MAX_HANDLES) {
+    return NULL;
+  }
+
+  FramePool *pool = (FramePool *) calloc(1, sizeof(FramePool));
+
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  pool->numHandles = numHandles;
+  pool->numFree = numHandles;
+  pool->retainBuffer = retainBuffer;
+  pool->releaseBuffer = releaseBuffer;
+
+  // Free list is a stack, handle 0 is acquired first
+
+  for (int i = 0; i < numHandles; i++) {
+    FramePoolHandle *handle = &pool->handles[i];
+    atomic_init(&handle->refCount, 0);
+    handle->index = i;
+    handle->pool = pool;
+    frame_timing_record_clear(&handle->timing);
+    pool->freeIndexes[i] = numHandles - 1 - i;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+
+  return pool;
+}
+
+static inline
+void frame_pool_destroy(FramePool *pool) {
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool);
+}
+
+static inline
+int frame_pool_num_in_use(FramePool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  int numInUse = pool->numHandles - pool->numFree;
+  pthread_mutex_unlock(&pool->mutex);
+  return numInUse;
+}
+
+// Take a free handle with a reference count of 1 that belongs to
+// the caller. Returns NULL when every handle is in use, a caller
+// that holds more frames than the pool size is leaking references.
+
+static inline
+FramePoolHandle* frame_pool_acquire(FramePool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+
+  if (pool->numFree == 0 || pool->closed) {
+    pool->numExhausted += 1;
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+  }
+
+  pool->numFree -= 1;
+  FramePoolHandle *handle = &pool->handles[pool->freeIndexes[pool->numFree]];
+
+  pool->numAcquired += 1;
+  const int numInUse = pool->numHandles - pool->numFree;
+  if (numInUse > pool->maxInUse) {
+    pool->maxInUse = numInUse;
+  }
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  atomic_store(&handle->refCount, 1);
+  frame_timing_record_clear(&handle->timing);
+
+  return handle;
+}
+
+static inline
+void frame_pool_retain(FramePoolHandle *handle) {
+  atomic_fetch_add(&handle->refCount, 1);
+}
+
+// Drop a reference, the last release returns the buffers to their
+// owner and the handle to the pool.
+
+static inline
+void frame_pool_release(FramePoolHandle *handle) {
+  const int prevCount = atomic_fetch_sub(&handle->refCount, 1);
+
+  if (prevCount > 1) {
+    return;
+  }
+
+#if defined(DEBUG)
+  assert(prevCount == 1);
+#endif // DEBUG
+
+  FramePool *pool = handle->pool;
+
+  for (int i = 0; i < FRAME_POOL_NUM_BUFFERS; i++) {
+    if (handle->buffers[i] != NULL && pool->releaseBuffer != NULL) {
+      pool->releaseBuffer(handle->buffers[i]);
+    }
+    handle->buffers[i] = NULL;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->freeIndexes[pool->numFree] = handle->index;
+  pool->numFree += 1;
+  const int isDone = pool->closed && (pool->numFree == pool->numHandles);
+  pthread_mutex_unlock(&pool->mutex);
+
+  if (isDone) {
+    frame_pool_destroy(pool);
+  }
+}
+
+// Close the pool once the owner is done with it. Handles that are
+// still held stay valid, the pool is freed with the last release.
+
+static inline
+void frame_pool_close(FramePool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->closed = 1;
+  const int isDone = (pool->numFree == pool->numHandles);
+  pthread_mutex_unlock(&pool->mutex);
+
+  if (isDone) {
+    frame_pool_destroy(pool);
+  }
+}
+
+// Replace a buffer of a held handle, the new buffer is retained and
+// the old buffer is released.
+
+static inline
+void frame_pool_set_buffer(FramePoolHandle *handle, int bufferIndex, void *buffer) {
+  FramePool *pool = handle->pool;
+
+  if (buffer != NULL && pool->retainBuffer != NULL) {
+    pool->retainBuffer(buffer);
+  }
+  if (handle->buffers[bufferIndex] != NULL && pool->releaseBuffer != NULL) {
+    pool->releaseBuffer(handle->buffers[bufferIndex]);
+  }
+  handle->buffers[bufferIndex] = buffer;
+}
+
+// Fixed size log of the most recent timing records, replaces growing
+// arrays of boxed times when recording decode timing.
+
+#define FRAME_TIMING_LOG_SIZE 512
+
+typedef struct {
+  FrameTimingRecord records[FRAME_TIMING_LOG_SIZE];
+  // Total records added, the log holds the last FRAME_TIMING_LOG_SIZE
+  uint64_t count;
+} FrameTimingLog;
+
+static inline
+void frame_timing_log_add(FrameTimingLog *log, const FrameTimingRecord *record) {
+  log->records[log->count % FRAME_TIMING_LOG_SIZE] = *record;
+  log->count += 1;
+}
+
+static inline
+int frame_timing_log_length(const FrameTimingLog *log) {
+  return (log->count < FRAME_TIMING_LOG_SIZE) ? (int) log->count : FRAME_TIMING_LOG_SIZE;
+}
+
+// Record i of the log, 0 is the oldest record still held
+
+static inline
+const FrameTimingRecord* frame_timing_log_get(const FrameTimingLog *log, int i) {
+  const uint64_t first = log->count - frame_timing_log_length(log);
+  return &log->records[(first + i) % FRAME_TIMING_LOG_SIZE];
+}
+
+// The last few vsync times reported by a display link
+
+#define FRAME_VSYNC_HISTORY_SIZE 3
+
+typedef struct {
+  double times[FRAME_VSYNC_HISTORY_SIZE];
+  int count;
+  int next;
+} FrameVsyncHistory;
+
+static inline
+void frame_vsync_history_add(FrameVsyncHistory *history, double vsyncTime) {
+  history->times[history->next] = vsyncTime;
+  history->next = (history->next + 1) % FRAME_VSYNC_HISTORY_SIZE;
+  if (history->count < FRAME_VSYNC_HISTORY_SIZE) {
+    history->count += 1;
+  }
+}
+
+// Most recent vsync time, 0 when no time was added
+
+static inline
+double frame_vsync_history_last(const FrameVsyncHistory *history) {
+  if (history->count == 0) {
+    return 0;
+  }
+  return history->times[(history->next + FRAME_VSYNC_HISTORY_SIZE - 1) % FRAME_VSYNC_HISTORY_SIZE];
+}
+
+#endif // _FRAME_POOL_H
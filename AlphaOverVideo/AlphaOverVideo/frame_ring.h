@@ -0,0 +1,272 @@
+//
+//  frame_ring.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only bounded ring of fixed size frame slots shared by one
+//  producer thread and one consumer thread. The producer blocks when
+//  every slot is full, so a reader that fills slots from a pipe stops
+//  reading and the process writing into the pipe blocks in turn. This
+//  keeps memory use at numSlots frames no matter how far ahead the
+//  producer could run. Time spent blocked on each side is recorded so
+//  that the slow end of a pipeline can be found.
+//
+//  See license.txt for license terms.
+
+#if !defined(_FRAME_RING_H)
+#define _FRAME_RING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+typedef struct {
+  uint8_t *storage;
+  size_t slotNumBytes;
+  int numSlots;
+
+  // Next slot to fill, next slot to consume and number of full slots
+  int head;
+  int tail;
+  int count;
+
+  // Set by the producer after the last frame
+  int closed;
+  // Set by the consumer to stop the producer early
+  int aborted;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+
+  // Totals, read once both threads are done
+  uint64_t numFrames;
+  uint64_t producerWaitNanos;
+  uint64_t consumerWaitNanos;
+  // Most full slots seen at once
+  int maxCount;
+} FrameRing;
+
+static inline
+uint64_t frame_ring_now_nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000ull) + (uint64_t) ts.tv_nsec;
+}
+
+// Allocate numSlots slots of slotNumBytes, each 64 byte aligned.
+// Returns 0 on success.
+
+static inline
+int frame_ring_init(FrameRing *ring, int numSlots, size_t slotNumBytes) {
+  memset(ring, 0, sizeof(FrameRing));
+
+  if (numSlots < 1 || slotNumBytes == 0) {
+    return 1;
+  }
+
+  const size_t alignedNumBytes = (slotNumBytes + 63) & ~((size_t) 63);
+
+  if (posix_memalign((void **) &ring->storage, 64, alignedNumBytes * numSlots) != 0) {
+    ring->storage = NULL;
+    return 1;
+  }
+
+  ring->slotNumBytes = alignedNumBytes;
+  ring->numSlots = numSlots;
+
+  pthread_mutex_init(&ring->mutex, NULL);
+  pthread_cond_init(&ring->notEmpty, NULL);
+  pthread_cond_init(&ring->notFull, NULL);
+
+  return 0;
+}
+
+static inline
+void frame_ring_free(FrameRing *ring) {
+  if (ring->storage == NULL) {
+    return;
+  }
+
+  pthread_mutex_destroy(&ring->mutex);
+  pthread_cond_destroy(&ring->notEmpty);
+  pthread_cond_destroy(&ring->notFull);
+
+  free(ring->storage);
+  ring->storage = NULL;
+}
+
+// Producer : wait for a free slot, returns NULL once the consumer aborts
+
+static inline
+uint8_t* frame_ring_acquire_write(FrameRing *ring) {
+  pthread_mutex_lock(&ring->mutex);
+
+  if (ring->count == ring->numSlots && !ring->aborted) {
+    const uint64_t start = frame_ring_now_nanos();
+
+    while (ring->count == ring->numSlots && !ring->aborted) {
+      pthread_cond_wait(&ring->notFull, &ring->mutex);
+    }
+
+    ring->producerWaitNanos += frame_ring_now_nanos() - start;
+  }
+
+  uint8_t *slot = ring->aborted ? NULL : (ring->storage + ((size_t) ring->head * ring->slotNumBytes));
+
+  pthread_mutex_unlock(&ring->mutex);
+
+  return slot;
+}
+
+// Producer : the slot returned by frame_ring_acquire_write() is full
+
+static inline
+void frame_ring_commit_write(FrameRing *ring) {
+  pthread_mutex_lock(&ring->mutex);
+
+  ring->head = (ring->head + 1) % ring->numSlots;
+  ring->count += 1;
+  ring->numFrames += 1;
+
+  if (ring->count > ring->maxCount) {
+    ring->maxCount = ring->count;
+  }
+
+  pthread_cond_signal(&ring->notEmpty);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+// Producer : no more frames
+
+static inline
+void frame_ring_close_write(FrameRing *ring) {
+  pthread_mutex_lock(&ring->mutex);
+  ring->closed = 1;
+  pthread_cond_signal(&ring->notEmpty);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+// Consumer : wait for a full slot, returns NULL after the last frame
+
+static inline
+const uint8_t* frame_ring_acquire_read(FrameRing *ring) {
+  pthread_mutex_lock(&ring->mutex);
+
+  if (ring->count == 0 && !ring->closed) {
+    const uint64_t start = frame_ring_now_nanos();
+
+    while (ring->count == 0 && !ring->closed) {
+      pthread_cond_wait(&ring->notEmpty, &ring->mutex);
+    }
+
+    ring->consumerWaitNanos += frame_ring_now_nanos() - start;
+  }
+
+  const uint8_t *slot = (ring->count == 0) ? NULL : (ring->storage + ((size_t) ring->tail * ring->slotNumBytes));
+
+  pthread_mutex_unlock(&ring->mutex);
+
+  return slot;
+}
+
+// Consumer : done with the slot returned by frame_ring_acquire_read()
+
+static inline
+void frame_ring_release_read(FrameRing *ring) {
+  pthread_mutex_lock(&ring->mutex);
+
+  ring->tail = (ring->tail + 1) % ring->numSlots;
+  ring->count -= 1;
+
+  pthread_cond_signal(&ring->notFull);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+// Consumer : stop early, a blocked producer returns NULL
+
+static inline
+void frame_ring_abort(FrameRing *ring) {
+  pthread_mutex_lock(&ring->mutex);
+  ring->aborted = 1;
+  pthread_cond_signal(&ring->notFull);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+// Read exactly numBytes from fd, returns the number of bytes read
+// which is less than numBytes only at end of file, or -1 on error.
+
+static inline
+ssize_t frame_ring_read_fully(int fd, uint8_t *ptr, size_t numBytes) {
+  size_t numRead = 0;
+
+  while (numRead < numBytes) {
+    ssize_t result = read(fd, ptr + numRead, numBytes - numRead);
+
+    if (result < 0 && errno == EINTR) {
+      continue;
+    } else if (result < 0) {
+      return -1;
+    } else if (result == 0) {
+      break;
+    }
+
+    numRead += (size_t) result;
+  }
+
+  return (ssize_t) numRead;
+}
+
+// Producer loop : fill slots with frameNumBytes read from fd until end
+// of file, then close the ring. Returns 0 when the input ends on a
+// frame boundary or the consumer aborted, 1 on a read error or a
+// partial final frame.
+
+static inline
+int frame_ring_fill_from_fd(FrameRing *ring, int fd, size_t frameNumBytes) {
+  int err = 0;
+
+  while (1) {
+    uint8_t *slot = frame_ring_acquire_write(ring);
+
+    if (slot == NULL) {
+      break;
+    }
+
+    ssize_t numRead = frame_ring_read_fully(fd, slot, frameNumBytes);
+
+    if (numRead == (ssize_t) frameNumBytes) {
+      frame_ring_commit_write(ring);
+    } else {
+      if (numRead != 0) {
+        err = 1;
+      }
+      break;
+    }
+  }
+
+  frame_ring_close_write(ring);
+
+  return err;
+}
+
+static inline
+void frame_ring_print_stats(const FrameRing *ring, uint64_t numBytesPerFrame, uint64_t wallNanos, FILE *outFile) {
+  const double seconds = wallNanos / 1000000000.0;
+  const double megabytes = (ring->numFrames * numBytesPerFrame) / 1000000.0;
+
+  fprintf(outFile, "raw input : %llu frames, %.1f MB in %.2f s, %.1f FPS, %.1f MB/s\n",
+          (unsigned long long) ring->numFrames, megabytes, seconds,
+          (seconds > 0.0) ? (ring->numFrames / seconds) : 0.0,
+          (seconds > 0.0) ? (megabytes / seconds) : 0.0);
+  fprintf(outFile, "raw input : reader blocked %.1f ms on full buffers, converter waited %.1f ms for input, %d of %d buffers used\n",
+          ring->producerWaitNanos / 1000000.0, ring->consumerWaitNanos / 1000000.0,
+          ring->maxCount, ring->numSlots);
+}
+
+#endif // _FRAME_RING_H
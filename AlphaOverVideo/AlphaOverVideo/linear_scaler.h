@@ -0,0 +1,578 @@
+//
+//  linear_scaler.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only CPU image scaler that resamples premultiplied BGRA
+//  frames in linear light with a bilinear (tent), Catmull-Rom bicubic
+//  or Lanczos-3 kernel. It is used to make thumbnails, renditions and
+//  test images without a GPU. It does not model the scale pass in
+//  MetalScaleRenderContext, that pass takes one hardware linear
+//  sample per output pixel and does not widen when downscaling.
+//
+//  The resample is separable. Each input row is converted to linear
+//  premultiplied float and filtered horizontally into a small ring of
+//  rows, then each output row is a weighted sum of the rows in that
+//  ring. Weights for every output pixel are computed once when the
+//  scaler is created. When downscaling, the kernel is widened by the
+//  scale factor so that every input pixel contributes. Taps past the
+//  edge of the frame reuse the edge pixel.
+//
+//  Output rows are split into bands, each band has its own row
+//  buffers and can run on its own thread. Catmull-Rom and Lanczos
+//  have negative lobes that can overshoot at hard edges, color is
+//  clamped to [0, alpha] when converting back so that the output is
+//  always valid premultiplied BGRA.
+//
+//  Input and output pixels are premultiplied BGRA with sRGB gamma
+//  encoded components, the layout of a 32 BPP CGFrameBuffer. When
+//  the frames are linear the byte values are used as is.
+//
+//  See license.txt for license terms.
+
+#if !defined(_LINEAR_SCALER_H)
+#define _LINEAR_SCALER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "premultiply.h"
+
+#define LS_MAX_BANDS 16
+
+#define LS_ERR_SIZE 1
+#define LS_ERR_NO_MEMORY 2
+
+typedef enum {
+  LinearScaleKernelBilinear = 0,
+  LinearScaleKernelBicubic,
+  LinearScaleKernelLanczos3
+} LinearScaleKernel;
+
+// Taps for one direction of a resample, output i reads maxTaps
+// inputs starting at starts[i]. Unused taps have a zero weight.
+
+typedef struct {
+  int inSize;
+  int outSize;
+  int maxTaps;
+  int *starts;
+  float *weights;
+} LinearScaleFilter;
+
+// Row buffers for one band of output rows. Horizontally filtered
+// input rows are kept in maxTaps slots for the vertical pass.
+
+typedef struct {
+  pm_float4 *inRow;
+  pm_float4 *rows;
+  int *rowInSlot;
+  int numSlots;
+  pm_float4 *accRow;
+} LinearScaleBand;
+
+typedef struct {
+  PremultiplyTables tables;
+  LinearScaleKernel kernel;
+
+  // Linear premultiplied value of each premultiplied byte C at
+  // alpha A, indexed by (A * 256) + C. Same result as unpremultiply
+  // then premultiply_linear_row() with one lookup per component.
+  float *linearTable;
+
+  int inWidth;
+  int inHeight;
+  int outWidth;
+  int outHeight;
+
+  LinearScaleFilter hFilter;
+  LinearScaleFilter vFilter;
+
+  int numBands;
+  LinearScaleBand bands[LS_MAX_BANDS];
+} LinearScaler;
+
+static inline
+const char* linear_scale_kernel_name(LinearScaleKernel kernel) {
+  switch (kernel) {
+    case LinearScaleKernelBilinear:
+      return "bilinear";
+    case LinearScaleKernelBicubic:
+      return "bicubic";
+    case LinearScaleKernelLanczos3:
+      return "lanczos3";
+  }
+  return "unknown";
+}
+
+// Radius of the kernel in input pixels at a scale of 1
+
+static inline
+double linear_scale_kernel_support(LinearScaleKernel kernel) {
+  switch (kernel) {
+    case LinearScaleKernelBilinear:
+      return 1.0;
+    case LinearScaleKernelBicubic:
+      return 2.0;
+    case LinearScaleKernelLanczos3:
+      return 3.0;
+  }
+  return 1.0;
+}
+
+static inline
+double linear_scale_sinc(double x) {
+  if (x == 0.0) {
+    return 1.0;
+  }
+  x *= M_PI;
+  return sin(x) / x;
+}
+
+static inline
+double linear_scale_kernel_weight(LinearScaleKernel kernel, double x) {
+  x = fabs(x);
+
+  switch (kernel) {
+    case LinearScaleKernelBilinear: {
+      return (x < 1.0) ? (1.0 - x) : 0.0;
+    }
+    case LinearScaleKernelBicubic: {
+      // Catmull-Rom, the B = 0 C = 0.5 cubic
+      if (x < 1.0) {
+        return ((1.5 * x - 2.5) * x * x) + 1.0;
+      } else if (x < 2.0) {
+        return (((-0.5 * x + 2.5) * x - 4.0) * x) + 2.0;
+      }
+      return 0.0;
+    }
+    case LinearScaleKernelLanczos3: {
+      return (x < 3.0) ? (linear_scale_sinc(x) * linear_scale_sinc(x / 3.0)) : 0.0;
+    }
+  }
+
+  return 0.0;
+}
+
+static inline
+void linear_scale_filter_free(LinearScaleFilter *filter) {
+  free(filter->starts);
+  free(filter->weights);
+  filter->starts = NULL;
+  filter->weights = NULL;
+}
+
+// Number of taps per output of a resample from inSize to outSize
+
+static inline
+int linear_scale_filter_max_taps(LinearScaleKernel kernel, int inSize, int outSize) {
+  const double scale = (double) inSize / outSize;
+  const double filterScale = (scale > 1.0) ? scale : 1.0;
+  const double support = linear_scale_kernel_support(kernel) * filterScale;
+
+  const int maxTaps = (int) ceil(support) * 2 + 1;
+  return (maxTaps > inSize) ? inSize : maxTaps;
+}
+
+// Compute normalized weights for each of outSize outputs. Returns 0 on success.
+
+static inline
+int linear_scale_filter_init(LinearScaleFilter *filter, LinearScaleKernel kernel, int inSize, int outSize) {
+  memset(filter, 0, sizeof(LinearScaleFilter));
+
+  const double scale = (double) inSize / outSize;
+  const double filterScale = (scale > 1.0) ? scale : 1.0;
+  const double support = linear_scale_kernel_support(kernel) * filterScale;
+
+  filter->inSize = inSize;
+  filter->outSize = outSize;
+  filter->maxTaps = linear_scale_filter_max_taps(kernel, inSize, outSize);
+  filter->starts = (int *) malloc(outSize * sizeof(int));
+  filter->weights = (float *) calloc((size_t) outSize * filter->maxTaps, sizeof(float));
+
+  double *sums = (double *) malloc(filter->maxTaps * sizeof(double));
+
+  if (filter->starts == NULL || filter->weights == NULL || sums == NULL) {
+    free(sums);
+    linear_scale_filter_free(filter);
+    return LS_ERR_NO_MEMORY;
+  }
+
+  for (int i = 0; i < outSize; i++) {
+    const double center = ((i + 0.5) * scale) - 0.5;
+
+    const int lo = (int) ceil(center - support);
+    const int hi = (int) floor(center + support);
+
+    // Taps past either edge fold onto the edge pixel, shift the
+    // window left when it would read past the end of the input.
+
+    int start = (lo < 0) ? 0 : lo;
+
+    if ((start + filter->maxTaps) > inSize) {
+      start = inSize - filter->maxTaps;
+    }
+
+    memset(sums, 0, filter->maxTaps * sizeof(double));
+    double total = 0.0;
+
+    for (int j = lo; j <= hi; j++) {
+      const double w = linear_scale_kernel_weight(kernel, (j - center) / filterScale);
+
+      if (w == 0.0) {
+        continue;
+      }
+
+      int index = (j < 0) ? 0 : ((j > (inSize - 1)) ? (inSize - 1) : j);
+      index -= start;
+
+      // Only zero weight taps can fall outside the window
+
+      if (index >= 0 && index < filter->maxTaps) {
+        sums[index] += w;
+        total += w;
+      }
+    }
+
+    float *weights = filter->weights + ((size_t) i * filter->maxTaps);
+
+    if (total == 0.0) {
+      // Center falls exactly between taps that are out of range
+      int index = (int) floor(center + 0.5);
+      index = (index < 0) ? 0 : ((index > (inSize - 1)) ? (inSize - 1) : index);
+      weights[index - start] = 1.0f;
+    } else {
+      for (int k = 0; k < filter->maxTaps; k++) {
+        weights[k] = (float) (sums[k] / total);
+      }
+    }
+
+    filter->starts[i] = start;
+  }
+
+  free(sums);
+
+  return 0;
+}
+
+static inline
+void linear_scale_band_free(LinearScaleBand *band) {
+  free(band->inRow);
+  free(band->rows);
+  free(band->rowInSlot);
+  free(band->accRow);
+  memset(band, 0, sizeof(LinearScaleBand));
+}
+
+// Allocate row buffers for one band. Returns 0 on success.
+
+static inline
+int linear_scale_band_init(LinearScaleBand *band, int inWidth, int outWidth, int numSlots) {
+  memset(band, 0, sizeof(LinearScaleBand));
+
+  band->numSlots = numSlots;
+
+  if (posix_memalign((void **) &band->inRow, 64, (size_t) inWidth * sizeof(pm_float4)) != 0 ||
+      posix_memalign((void **) &band->rows, 64, (size_t) numSlots * outWidth * sizeof(pm_float4)) != 0 ||
+      posix_memalign((void **) &band->accRow, 64, (size_t) outWidth * sizeof(pm_float4)) != 0 ||
+      (band->rowInSlot = (int *) malloc(numSlots * sizeof(int))) == NULL) {
+    linear_scale_band_free(band);
+    return LS_ERR_NO_MEMORY;
+  }
+
+  return 0;
+}
+
+// Premultiply tables for sRGB frames, or for frames where the byte
+// values are already linear when isLinear is set.
+
+static inline
+void linear_scaler_tables_init(PremultiplyTables *tables, int isLinear) {
+  premultiply_tables_init(tables);
+
+  if (isLinear) {
+    for (int i = 0; i < 256; i++) {
+      tables->toLinear[i] = i / 255.0f;
+    }
+
+    for (int i = 0; i < PM_ENCODE_TABLE_SIZE; i++) {
+      tables->toSRGB[i] = (uint8_t) ((i * 255 + (PM_ENCODE_TABLE_SIZE - 1) / 2) / (PM_ENCODE_TABLE_SIZE - 1));
+    }
+  }
+}
+
+static inline
+void linear_scaler_free(LinearScaler *scaler) {
+  linear_scale_filter_free(&scaler->hFilter);
+  linear_scale_filter_free(&scaler->vFilter);
+
+  free(scaler->linearTable);
+  scaler->linearTable = NULL;
+
+  for (int i = 0; i < scaler->numBands; i++) {
+    linear_scale_band_free(&scaler->bands[i]);
+  }
+
+  scaler->numBands = 0;
+}
+
+// Plan a resample from inWidth x inHeight to outWidth x outHeight with
+// row buffers for numBands bands. Pass isLinear when byte values are
+// already linear. Returns 0 on success.
+
+static inline
+int linear_scaler_init(LinearScaler *scaler,
+                       LinearScaleKernel kernel,
+                       int isLinear,
+                       int inWidth,
+                       int inHeight,
+                       int outWidth,
+                       int outHeight,
+                       int numBands)
+{
+  memset(scaler, 0, sizeof(LinearScaler));
+
+  if (inWidth <= 0 || inHeight <= 0 || outWidth <= 0 || outHeight <= 0 ||
+      numBands < 1 || numBands > LS_MAX_BANDS) {
+    return LS_ERR_SIZE;
+  }
+
+  linear_scaler_tables_init(&scaler->tables, isLinear);
+
+  scaler->linearTable = (float *) malloc(256 * 256 * sizeof(float));
+
+  if (scaler->linearTable == NULL) {
+    return LS_ERR_NO_MEMORY;
+  }
+
+  for (uint32_t A = 0; A < 256; A++) {
+    for (uint32_t C = 0; C < 256; C++) {
+      const uint32_t straight = unpremultiply_pixel(&scaler->tables, (A << 24) | C);
+      scaler->linearTable[(A * 256) + C] = scaler->tables.toLinear[straight & 0xFF] * scaler->tables.alphaNorm[A];
+    }
+  }
+
+  scaler->kernel = kernel;
+  scaler->inWidth = inWidth;
+  scaler->inHeight = inHeight;
+  scaler->outWidth = outWidth;
+  scaler->outHeight = outHeight;
+
+  if (linear_scale_filter_init(&scaler->hFilter, kernel, inWidth, outWidth) != 0 ||
+      linear_scale_filter_init(&scaler->vFilter, kernel, inHeight, outHeight) != 0) {
+    linear_scaler_free(scaler);
+    return LS_ERR_NO_MEMORY;
+  }
+
+  // No more bands than output rows
+
+  scaler->numBands = (numBands > outHeight) ? outHeight : numBands;
+
+  for (int i = 0; i < scaler->numBands; i++) {
+    if (linear_scale_band_init(&scaler->bands[i], inWidth, outWidth, scaler->vFilter.maxTaps) != 0) {
+      linear_scaler_free(scaler);
+      return LS_ERR_NO_MEMORY;
+    }
+  }
+
+  return 0;
+}
+
+// Horizontal pass, filter one row of linear premultiplied input
+
+static inline
+void linear_scale_filter_row(const LinearScaleFilter *filter, const pm_float4 *inRow, pm_float4 *outRow) {
+  const int maxTaps = filter->maxTaps;
+
+  for (int col = 0; col < filter->outSize; col++) {
+    const pm_float4 *in = inRow + filter->starts[col];
+    const float *weights = filter->weights + ((size_t) col * maxTaps);
+
+    pm_float4 sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (int k = 0; k < maxTaps; k++) {
+      sum += in[k] * weights[k];
+    }
+
+    outRow[col] = sum;
+  }
+}
+
+// Convert input row to linear light and filter it into a slot of the
+// band row cache unless it is already there
+
+static inline
+const pm_float4* linear_scaler_filtered_row(const LinearScaler *scaler,
+                                            LinearScaleBand *band,
+                                            const uint32_t *inPixels,
+                                            int inPixelsPerRow,
+                                            int row)
+{
+  const LinearScaleFilter *hFilter = &scaler->hFilter;
+  const int slot = row % band->numSlots;
+  pm_float4 *outRow = band->rows + ((size_t) slot * hFilter->outSize);
+
+  if (band->rowInSlot[slot] == row) {
+    return outRow;
+  }
+
+  const uint32_t *inRow = inPixels + ((size_t) row * inPixelsPerRow);
+
+  for (int col = 0; col < scaler->inWidth; col++) {
+    const uint32_t pixel = inRow[col];
+    const float *table = scaler->linearTable + ((pixel >> 24) * 256);
+
+    pm_float4 v = {
+      table[pixel & 0xFF],
+      table[(pixel >> 8) & 0xFF],
+      table[(pixel >> 16) & 0xFF],
+      scaler->tables.alphaNorm[pixel >> 24]
+    };
+
+    band->inRow[col] = v;
+  }
+
+  linear_scale_filter_row(hFilter, band->inRow, outRow);
+
+  band->rowInSlot[slot] = row;
+
+  return outRow;
+}
+
+// Resample output rows [rowStart, rowEnd) with the buffers of one band.
+// Calls with different bands may run on different threads at once.
+
+static inline
+void linear_scaler_scale_rows(const LinearScaler *scaler,
+                              LinearScaleBand *band,
+                              const uint32_t *inPixels,
+                              int inPixelsPerRow,
+                              uint32_t *outPixels,
+                              int outPixelsPerRow,
+                              int rowStart,
+                              int rowEnd)
+{
+  const LinearScaleFilter *vFilter = &scaler->vFilter;
+  const int outWidth = scaler->outWidth;
+
+  if (scaler->inWidth == outWidth && scaler->inHeight == scaler->outHeight) {
+    // Same size is copied, no round trip through linear light
+
+    for (int row = rowStart; row < rowEnd; row++) {
+      memcpy(outPixels + ((size_t) row * outPixelsPerRow),
+             inPixels + ((size_t) row * inPixelsPerRow),
+             outWidth * sizeof(uint32_t));
+    }
+
+    return;
+  }
+
+  for (int i = 0; i < band->numSlots; i++) {
+    band->rowInSlot[i] = -1;
+  }
+
+  for (int row = rowStart; row < rowEnd; row++) {
+    const float *weights = vFilter->weights + ((size_t) row * vFilter->maxTaps);
+    const int start = vFilter->starts[row];
+
+    memset(band->accRow, 0, outWidth * sizeof(pm_float4));
+
+    for (int k = 0; k < vFilter->maxTaps; k++) {
+      const float w = weights[k];
+
+      if (w == 0.0f) {
+        continue;
+      }
+
+      const pm_float4 *inRow = linear_scaler_filtered_row(scaler, band, inPixels, inPixelsPerRow, start + k);
+
+      for (int col = 0; col < outWidth; col++) {
+        band->accRow[col] += inRow[col] * w;
+      }
+    }
+
+    // Unpremultiply clamps color / alpha to [0, 1], so ringing past
+    // a hard edge cannot write color larger than alpha.
+
+    uint32_t *outRow = outPixels + ((size_t) row * outPixelsPerRow);
+
+    unpremultiply_linear_row(&scaler->tables, band->accRow, outRow, outWidth);
+    premultiply_row(outRow, outRow, outWidth);
+  }
+}
+
+typedef struct {
+  const LinearScaler *scaler;
+  LinearScaleBand *band;
+  const uint32_t *inPixels;
+  int inPixelsPerRow;
+  uint32_t *outPixels;
+  int outPixelsPerRow;
+  int rowStart;
+  int rowEnd;
+} LinearScaleJob;
+
+static inline
+void* linear_scaler_job_main(void *arg) {
+  LinearScaleJob *job = (LinearScaleJob *) arg;
+  linear_scaler_scale_rows(job->scaler, job->band,
+                           job->inPixels, job->inPixelsPerRow,
+                           job->outPixels, job->outPixelsPerRow,
+                           job->rowStart, job->rowEnd);
+  return NULL;
+}
+
+// Resample a whole frame, each band after the first runs on its own
+// thread and the first band runs on the calling thread.
+
+static inline
+void linear_scaler_scale(LinearScaler *scaler,
+                         const uint32_t *inPixels,
+                         int inPixelsPerRow,
+                         uint32_t *outPixels,
+                         int outPixelsPerRow)
+{
+  LinearScaleJob jobs[LS_MAX_BANDS];
+  pthread_t threads[LS_MAX_BANDS];
+  int isRunning[LS_MAX_BANDS];
+
+  const int numBands = scaler->numBands;
+
+  for (int i = 0; i < numBands; i++) {
+    LinearScaleJob *job = &jobs[i];
+
+    job->scaler = scaler;
+    job->band = &scaler->bands[i];
+    job->inPixels = inPixels;
+    job->inPixelsPerRow = inPixelsPerRow;
+    job->outPixels = outPixels;
+    job->outPixelsPerRow = outPixelsPerRow;
+    job->rowStart = (int) (((int64_t) scaler->outHeight * i) / numBands);
+    job->rowEnd = (int) (((int64_t) scaler->outHeight * (i + 1)) / numBands);
+
+    isRunning[i] = 0;
+
+    if (i > 0 && pthread_create(&threads[i], NULL, linear_scaler_job_main, job) == 0) {
+      isRunning[i] = 1;
+    }
+  }
+
+  // Band 0 and any band whose thread could not be started
+
+  for (int i = 0; i < numBands; i++) {
+    if (!isRunning[i]) {
+      linear_scaler_job_main(&jobs[i]);
+    }
+  }
+
+  for (int i = 1; i < numBands; i++) {
+    if (isRunning[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+}
+
+#endif // _LINEAR_SCALER_H
@@ -0,0 +1,827 @@
+//
+//  mp4_index.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that builds a per-frame index for the
+//  first video track of an ISO-BMFF file from the sample tables
+//  (stts, ctts, stss, stsz, stco/co64, stsc) and the edit list.
+//  Each frame records PTS, DTS, byte offset, size and keyframe flag.
+//  Times are kept as integers in the media timescale so that
+//  29.97 FPS content maps to frame numbers without float drift.
+//
+//  The index is stored in one contiguous buffer that is also the
+//  serialized form, a cached index can be written to disk and later
+//  opened in place without parsing the MP4 file again. The cache
+//  is stored in host byte order and records the size and modification
+//  time of the MP4 file it was built from, so that a cache left over
+//  from an earlier version of the file is rebuilt.
+//
+//  See license.txt for license terms.
+
+#if !defined(_MP4_INDEX_H)
+#define _MP4_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include "mp4_probe.h"
+
+// 'AOVI' in host byte order
+#define MP4_INDEX_MAGIC 0x49564F41
+#define MP4_INDEX_VERSION 2
+
+// Upper bound on the number of samples in one track
+#define MP4_INDEX_MAX_SAMPLES (1 << 24)
+
+#define MP4_INDEX_FLAG_KEYFRAME 0x1
+
+typedef struct {
+  // Presentation time with the edit list applied, the first
+  // displayed frame has a PTS of zero for typical content. Frames
+  // that are decoded but skipped by the edit have a negative PTS.
+  int64_t pts;
+  int64_t dts;
+  uint64_t offset;
+  uint32_t size;
+  // Frame number in display order
+  uint32_t frameNum;
+  uint32_t flags;
+  uint32_t reserved;
+} Mp4IndexSample;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t timescale;
+  uint32_t numSamples;
+  uint32_t numKeyframes;
+  uint32_t reserved;
+  // Media duration in timescale units
+  int64_t duration;
+  // PTS just past the end of the final frame
+  int64_t endPts;
+  // Size and modification time in nanoseconds of the MP4 file the
+  // cache was built from, zero when not built from a file
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+} Mp4IndexHeader;
+
+typedef struct {
+  const Mp4IndexHeader *header;
+  // Samples in decode order
+  const Mp4IndexSample *samples;
+  // Display frame number -> sample index
+  const uint32_t *displayOrder;
+  // Sample indexes of sync samples in ascending order
+  const uint32_t *keyframes;
+
+  // Contiguous serialized form of the index
+  const uint8_t *bytes;
+  uint64_t numBytes;
+
+  // Non-NULL when the index owns the buffer
+  uint8_t *storage;
+} Mp4Index;
+
+static inline
+uint64_t mp4_index_num_bytes(uint32_t numSamples, uint32_t numKeyframes) {
+  return sizeof(Mp4IndexHeader) +
+    ((uint64_t) numSamples * sizeof(Mp4IndexSample)) +
+    ((uint64_t) numSamples * sizeof(uint32_t)) +
+    ((uint64_t) numKeyframes * sizeof(uint32_t));
+}
+
+// Point the index sections into a serialized buffer after
+// checking that every section fits and that every sample index and
+// frame number is in range, so that a corrupt cache cannot cause an
+// out of bounds read. Returns 0 on success.
+
+static inline
+int mp4_index_open_buffer(const uint8_t *bytes, uint64_t numBytes, Mp4Index *index) {
+  memset(index, 0, sizeof(Mp4Index));
+
+  if (numBytes < sizeof(Mp4IndexHeader) || (((uintptr_t) bytes) & 0x7) != 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  const Mp4IndexHeader *header = (const Mp4IndexHeader *) bytes;
+
+  if (header->magic != MP4_INDEX_MAGIC || header->version != MP4_INDEX_VERSION) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  if (header->numSamples > MP4_INDEX_MAX_SAMPLES || header->numKeyframes > header->numSamples ||
+      header->timescale == 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  if (mp4_index_num_bytes(header->numSamples, header->numKeyframes) != numBytes) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  const uint32_t numSamples = header->numSamples;
+  const Mp4IndexSample *samples = (const Mp4IndexSample *) (bytes + sizeof(Mp4IndexHeader));
+  const uint32_t *displayOrder = (const uint32_t *) (samples + numSamples);
+  const uint32_t *keyframes = displayOrder + numSamples;
+
+  for (uint32_t i = 0; i < numSamples; i++) {
+    if (displayOrder[i] >= numSamples || samples[i].frameNum >= numSamples) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+  }
+
+  // Keyframes are binary searched, so they must also be ascending
+
+  for (uint32_t i = 0; i < header->numKeyframes; i++) {
+    if (keyframes[i] >= numSamples || (i > 0 && keyframes[i] <= keyframes[i - 1])) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+  }
+
+  index->header = header;
+  index->samples = samples;
+  index->displayOrder = displayOrder;
+  index->keyframes = keyframes;
+  index->bytes = bytes;
+  index->numBytes = numBytes;
+
+  return 0;
+}
+
+static inline
+void mp4_index_free(Mp4Index *index) {
+  free(index->storage);
+  memset(index, 0, sizeof(Mp4Index));
+}
+
+static inline
+int mp4_index_num_frames(const Mp4Index *index) {
+  return (int) index->header->numSamples;
+}
+
+// Sample for a display order frame number
+
+static inline
+const Mp4IndexSample* mp4_index_frame(const Mp4Index *index, int frameNum) {
+#if defined(DEBUG)
+  assert(frameNum >= 0 && frameNum < (int) index->header->numSamples);
+#endif // DEBUG
+  return &index->samples[index->displayOrder[frameNum]];
+}
+
+// Convert a time fraction like a CMTime value and timescale
+// to media timescale units, rounded to the nearest unit.
+
+static inline
+int64_t mp4_index_media_time(const Mp4Index *index, int64_t value, int32_t timescale) {
+  if (timescale <= 0) {
+    return 0;
+  }
+
+  const int64_t mediaTimescale = index->header->timescale;
+
+  if (timescale == mediaTimescale) {
+    return value;
+  }
+
+  // Split to avoid overflow of value * mediaTimescale
+  const int64_t whole = value / timescale;
+  const int64_t rem = value % timescale;
+
+  return (whole * mediaTimescale) + (((rem * mediaTimescale) + (timescale / 2)) / timescale);
+}
+
+// Find the display frame number for a presentation time in media
+// timescale units. The frame with the largest PTS <= pts is returned,
+// times before the first frame return 0 and times after the end
+// return the final frame. Returns -1 for an empty index. O(log n).
+
+static inline
+int mp4_index_frame_at_time(const Mp4Index *index, int64_t pts) {
+  const int numFrames = (int) index->header->numSamples;
+
+  if (numFrames == 0) {
+    return -1;
+  }
+
+  int lo = 0;
+  int hi = numFrames - 1;
+
+  while (lo < hi) {
+    int mid = lo + ((hi - lo + 1) / 2);
+
+    if (index->samples[index->displayOrder[mid]].pts <= pts) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  return lo;
+}
+
+// Find the keyframe that decoding must start from in order to display
+// the given frame, this is the nearest sync sample at or before the
+// frame in decode order. Returns the display frame number of the
+// keyframe or -1 when there is no keyframe. O(log n).
+
+static inline
+int mp4_index_keyframe_before(const Mp4Index *index, int frameNum) {
+  const int numKeyframes = (int) index->header->numKeyframes;
+
+  if (numKeyframes == 0 || frameNum < 0 || frameNum >= (int) index->header->numSamples) {
+    return -1;
+  }
+
+  const uint32_t sampleIndex = index->displayOrder[frameNum];
+
+  if (index->keyframes[0] > sampleIndex) {
+    return -1;
+  }
+
+  int lo = 0;
+  int hi = numKeyframes - 1;
+
+  while (lo < hi) {
+    int mid = lo + ((hi - lo + 1) / 2);
+
+    if (index->keyframes[mid] <= sampleIndex) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  return (int) index->samples[index->keyframes[lo]].frameNum;
+}
+
+// Read the first usable edit from trak/edts/elst. The media time is
+// the first media sample time that is presented and the empty
+// duration is the delay before any media is presented, converted
+// from the movie timescale to the media timescale.
+
+static inline
+void mp4_index_parse_elst(const Mp4ProbeSpan *trak, uint32_t movieTimescale, uint32_t mediaTimescale,
+                          int64_t *mediaTimePtr, int64_t *emptyDurationPtr) {
+  *mediaTimePtr = 0;
+  *emptyDurationPtr = 0;
+
+  const uint32_t elstPath[] = {
+    MP4_PROBE_FOURCC('e','d','t','s'),
+    MP4_PROBE_FOURCC('e','l','s','t')
+  };
+
+  Mp4ProbeSpan elst;
+
+  if (mp4_probe_find_path(trak, elstPath, 2, &elst) != 0 || elst.len < 8) {
+    return;
+  }
+
+  const int version = elst.ptr[0];
+  const uint32_t numEntries = mp4_probe_be32(elst.ptr + 4);
+  const uint32_t entrySize = (version == 1) ? 20 : 12;
+
+  if ((uint64_t) numEntries * entrySize > (elst.len - 8)) {
+    return;
+  }
+
+  const uint8_t *ptr = elst.ptr + 8;
+  int64_t emptyDuration = 0;
+
+  for (uint32_t i = 0; i < numEntries; i++, ptr += entrySize) {
+    int64_t segmentDuration;
+    int64_t mediaTime;
+
+    if (version == 1) {
+      segmentDuration = (int64_t) mp4_probe_be64(ptr);
+      mediaTime = (int64_t) mp4_probe_be64(ptr + 8);
+    } else {
+      segmentDuration = mp4_probe_be32(ptr);
+      mediaTime = (int32_t) mp4_probe_be32(ptr + 4);
+    }
+
+    if (mediaTime == -1) {
+      // Empty edit
+      emptyDuration += segmentDuration;
+      continue;
+    }
+
+    *mediaTimePtr = mediaTime;
+    break;
+  }
+
+  if (movieTimescale > 0 && emptyDuration > 0) {
+    *emptyDurationPtr = (emptyDuration * mediaTimescale) / movieTimescale;
+  }
+}
+
+// Sort helper for display order
+
+typedef struct {
+  int64_t pts;
+  uint32_t sampleIndex;
+} Mp4IndexSortEntry;
+
+static inline
+int mp4_index_sort_cmp(const void *a, const void *b) {
+  const Mp4IndexSortEntry *ea = (const Mp4IndexSortEntry *) a;
+  const Mp4IndexSortEntry *eb = (const Mp4IndexSortEntry *) b;
+  if (ea->pts != eb->pts) {
+    return (ea->pts < eb->pts) ? -1 : 1;
+  }
+  return (ea->sampleIndex < eb->sampleIndex) ? -1 : (ea->sampleIndex > eb->sampleIndex);
+}
+
+// Build the index from an in memory moov payload. Returns 0 on success.
+
+static inline
+int mp4_index_build_moov(const Mp4ProbeSpan *moov, Mp4Index *index) {
+  memset(index, 0, sizeof(Mp4Index));
+
+  Mp4ProbeResult probe;
+
+  int err = mp4_probe_moov(moov, &probe);
+  if (err != 0) {
+    return err;
+  }
+
+  Mp4ProbeSpan trak;
+  Mp4ProbeSpan mdia;
+
+  err = mp4_probe_video_trak(moov, &trak, &mdia);
+  if (err != 0) {
+    return err;
+  }
+
+  const uint32_t stblPath[] = {
+    MP4_PROBE_FOURCC('m','i','n','f'),
+    MP4_PROBE_FOURCC('s','t','b','l')
+  };
+
+  Mp4ProbeSpan stbl;
+
+  if (mp4_probe_find_path(&mdia, stblPath, 2, &stbl) != 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  uint32_t movieTimescale = 0;
+  Mp4ProbeSpan mvhd;
+
+  if (mp4_probe_find(moov, MP4_PROBE_FOURCC('m','v','h','d'), &mvhd) == 0 && mvhd.len >= 24) {
+    movieTimescale = mp4_probe_be32(mvhd.ptr + ((mvhd.ptr[0] == 1) ? 20 : 12));
+  }
+
+  // Required tables
+
+  Mp4ProbeSpan stts, stsz, stsc, stco;
+  int isCo64 = 0;
+
+  if (mp4_probe_find(&stbl, MP4_PROBE_FOURCC('s','t','t','s'), &stts) != 0 || stts.len < 8 ||
+      mp4_probe_find(&stbl, MP4_PROBE_FOURCC('s','t','s','z'), &stsz) != 0 || stsz.len < 12 ||
+      mp4_probe_find(&stbl, MP4_PROBE_FOURCC('s','t','s','c'), &stsc) != 0 || stsc.len < 8) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  if (mp4_probe_find(&stbl, MP4_PROBE_FOURCC('s','t','c','o'), &stco) != 0) {
+    if (mp4_probe_find(&stbl, MP4_PROBE_FOURCC('c','o','6','4'), &stco) != 0) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+    isCo64 = 1;
+  }
+
+  if (stco.len < 8) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  // Optional tables
+
+  Mp4ProbeSpan ctts = { NULL, 0 };
+  Mp4ProbeSpan stss = { NULL, 0 };
+  const int hasCtts = (mp4_probe_find(&stbl, MP4_PROBE_FOURCC('c','t','t','s'), &ctts) == 0 && ctts.len >= 8);
+  const int hasStss = (mp4_probe_find(&stbl, MP4_PROBE_FOURCC('s','t','s','s'), &stss) == 0 && stss.len >= 8);
+
+  // stsz defines the number of samples, every other table must agree
+
+  const uint32_t constantSize = mp4_probe_be32(stsz.ptr + 4);
+  const uint32_t numSamples = mp4_probe_be32(stsz.ptr + 8);
+
+  if (numSamples > MP4_INDEX_MAX_SAMPLES || (int64_t) numSamples != probe.numFrames) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  if (constantSize == 0 && ((uint64_t) numSamples * 4) > (stsz.len - 12)) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  uint32_t numKeyframes = numSamples;
+  uint32_t numSyncEntries = 0;
+
+  if (hasStss) {
+    numSyncEntries = mp4_probe_be32(stss.ptr + 4);
+    if (((uint64_t) numSyncEntries * 4) > (stss.len - 8) || numSyncEntries > numSamples) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+    numKeyframes = numSyncEntries;
+  }
+
+  const uint64_t numBytes = mp4_index_num_bytes(numSamples, numKeyframes);
+  uint8_t *storage = (uint8_t *) calloc(1, (size_t) numBytes);
+  Mp4IndexSortEntry *sortEntries = (Mp4IndexSortEntry *) malloc((numSamples > 0 ? numSamples : 1) * sizeof(Mp4IndexSortEntry));
+
+  if (storage == NULL || sortEntries == NULL) {
+    free(storage);
+    free(sortEntries);
+    return MP4_PROBE_ERR_TOO_LARGE;
+  }
+
+  Mp4IndexHeader *header = (Mp4IndexHeader *) storage;
+  Mp4IndexSample *samples = (Mp4IndexSample *) (storage + sizeof(Mp4IndexHeader));
+  uint32_t *displayOrder = (uint32_t *) (samples + numSamples);
+  uint32_t *keyframes = displayOrder + numSamples;
+
+  err = MP4_PROBE_ERR_MALFORMED;
+  uint32_t lastDelta;
+
+  // DTS from stts
+
+  {
+    const uint32_t numEntries = mp4_probe_be32(stts.ptr + 4);
+    if (((uint64_t) numEntries * 8) > (stts.len - 8)) {
+      goto fail;
+    }
+
+    uint32_t sampleIndex = 0;
+    int64_t dts = 0;
+    lastDelta = 0;
+
+    for (uint32_t i = 0; i < numEntries; i++) {
+      const uint32_t count = mp4_probe_be32(stts.ptr + 8 + (i * 8));
+      const uint32_t delta = mp4_probe_be32(stts.ptr + 8 + (i * 8) + 4);
+
+      if (count > (numSamples - sampleIndex)) {
+        goto fail;
+      }
+
+      for (uint32_t j = 0; j < count; j++) {
+        samples[sampleIndex].dts = dts;
+        samples[sampleIndex].pts = dts;
+        sampleIndex++;
+        dts += delta;
+      }
+
+      if (count > 0) {
+        lastDelta = delta;
+      }
+    }
+
+    if (sampleIndex != numSamples) {
+      goto fail;
+    }
+  }
+
+  // Composition offsets from ctts, version 0 offsets are treated
+  // as signed since many encoders write negative values there.
+
+  if (hasCtts) {
+    const uint32_t numEntries = mp4_probe_be32(ctts.ptr + 4);
+    if (((uint64_t) numEntries * 8) > (ctts.len - 8)) {
+      goto fail;
+    }
+
+    uint32_t sampleIndex = 0;
+
+    for (uint32_t i = 0; i < numEntries; i++) {
+      const uint32_t count = mp4_probe_be32(ctts.ptr + 8 + (i * 8));
+      const int32_t offset = (int32_t) mp4_probe_be32(ctts.ptr + 8 + (i * 8) + 4);
+
+      if (count > (numSamples - sampleIndex)) {
+        goto fail;
+      }
+
+      for (uint32_t j = 0; j < count; j++) {
+        samples[sampleIndex].pts = samples[sampleIndex].dts + offset;
+        sampleIndex++;
+      }
+    }
+  }
+
+  // Edit list shifts the presentation timeline
+
+  {
+    int64_t editMediaTime;
+    int64_t emptyDuration;
+    mp4_index_parse_elst(&trak, movieTimescale, probe.timescale, &editMediaTime, &emptyDuration);
+
+    const int64_t shift = emptyDuration - editMediaTime;
+
+    for (uint32_t i = 0; i < numSamples; i++) {
+      samples[i].pts += shift;
+    }
+  }
+
+  // Sizes from stsz
+
+  for (uint32_t i = 0; i < numSamples; i++) {
+    samples[i].size = (constantSize != 0) ? constantSize : mp4_probe_be32(stsz.ptr + 12 + (i * 4));
+  }
+
+  // Offsets from stsc + stco/co64
+
+  {
+    const uint32_t numChunks = mp4_probe_be32(stco.ptr + 4);
+    const uint32_t offsetSize = isCo64 ? 8 : 4;
+
+    if (((uint64_t) numChunks * offsetSize) > (stco.len - 8)) {
+      goto fail;
+    }
+
+    const uint32_t numEntries = mp4_probe_be32(stsc.ptr + 4);
+    if (((uint64_t) numEntries * 12) > (stsc.len - 8)) {
+      goto fail;
+    }
+
+    uint32_t sampleIndex = 0;
+
+    for (uint32_t i = 0; i < numEntries && sampleIndex < numSamples; i++) {
+      const uint8_t *entry = stsc.ptr + 8 + (i * 12);
+      const uint32_t firstChunk = mp4_probe_be32(entry);
+      const uint32_t samplesPerChunk = mp4_probe_be32(entry + 4);
+
+      uint32_t endChunk = numChunks + 1;
+      if ((i + 1) < numEntries) {
+        endChunk = mp4_probe_be32(entry + 12);
+      }
+
+      if (firstChunk == 0 || endChunk < firstChunk || endChunk > (numChunks + 1)) {
+        goto fail;
+      }
+
+      for (uint32_t chunk = firstChunk; chunk < endChunk && sampleIndex < numSamples; chunk++) {
+        const uint8_t *offsetPtr = stco.ptr + 8 + ((uint64_t) (chunk - 1) * offsetSize);
+        uint64_t offset = isCo64 ? mp4_probe_be64(offsetPtr) : mp4_probe_be32(offsetPtr);
+
+        for (uint32_t j = 0; j < samplesPerChunk && sampleIndex < numSamples; j++) {
+          samples[sampleIndex].offset = offset;
+          offset += samples[sampleIndex].size;
+          sampleIndex++;
+        }
+      }
+    }
+
+    if (sampleIndex != numSamples) {
+      goto fail;
+    }
+  }
+
+  // Keyframes from stss, when there is no stss every sample is a sync sample
+
+  if (hasStss) {
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < numSyncEntries; i++) {
+      const uint32_t sampleNum = mp4_probe_be32(stss.ptr + 8 + (i * 4));
+      if (sampleNum == 0 || sampleNum > numSamples || sampleNum <= prev) {
+        goto fail;
+      }
+      prev = sampleNum;
+      keyframes[i] = sampleNum - 1;
+      samples[sampleNum - 1].flags |= MP4_INDEX_FLAG_KEYFRAME;
+    }
+  } else {
+    for (uint32_t i = 0; i < numSamples; i++) {
+      keyframes[i] = i;
+      samples[i].flags |= MP4_INDEX_FLAG_KEYFRAME;
+    }
+  }
+
+  // Display order
+
+  for (uint32_t i = 0; i < numSamples; i++) {
+    sortEntries[i].pts = samples[i].pts;
+    sortEntries[i].sampleIndex = i;
+  }
+
+  qsort(sortEntries, numSamples, sizeof(Mp4IndexSortEntry), mp4_index_sort_cmp);
+
+  for (uint32_t i = 0; i < numSamples; i++) {
+    displayOrder[i] = sortEntries[i].sampleIndex;
+    samples[sortEntries[i].sampleIndex].frameNum = i;
+  }
+
+  // The final displayed frame lasts as long as the final decode delta
+
+  header->endPts = (numSamples > 0) ? (sortEntries[numSamples - 1].pts + lastDelta) : 0;
+
+  free(sortEntries);
+
+  header->magic = MP4_INDEX_MAGIC;
+  header->version = MP4_INDEX_VERSION;
+  header->timescale = probe.timescale;
+  header->numSamples = numSamples;
+  header->numKeyframes = numKeyframes;
+  header->duration = (int64_t) probe.duration;
+
+  err = mp4_index_open_buffer(storage, numBytes, index);
+
+  if (err != 0) {
+    free(storage);
+    return err;
+  }
+
+  index->storage = storage;
+
+  return 0;
+
+fail:
+  free(storage);
+  free(sortEntries);
+  return err;
+}
+
+// Build the index by reading the moov box through readFunc, returns 0 on success
+
+static inline
+int mp4_index_build(mp4_read_func readFunc, void *ctx, uint64_t fileSize, Mp4Index *index) {
+  memset(index, 0, sizeof(Mp4Index));
+
+  uint8_t *moovBytes;
+  uint64_t moovLen;
+
+  int err = mp4_probe_read_moov(readFunc, ctx, fileSize, &moovBytes, &moovLen);
+  if (err != 0) {
+    return err;
+  }
+
+  Mp4ProbeSpan moov = { moovBytes, moovLen };
+  err = mp4_index_build_moov(&moov, index);
+
+  free(moovBytes);
+  return err;
+}
+
+static inline
+int mp4_index_build_file(const char *inFilePath, Mp4Index *index) {
+  FILE *inFile = fopen(inFilePath, "rb");
+
+  if (inFile == NULL) {
+    memset(index, 0, sizeof(Mp4Index));
+    return MP4_PROBE_ERR_IO;
+  }
+
+  fseeko(inFile, 0, SEEK_END);
+  uint64_t fileSize = (uint64_t) ftello(inFile);
+
+  int err = mp4_index_build(mp4_probe_read_file, inFile, fileSize, index);
+
+  fclose(inFile);
+
+  return err;
+}
+
+static inline
+int mp4_index_build_buffer(const uint8_t *bytes, uint64_t numBytes, Mp4Index *index) {
+  Mp4ProbeSpan span = { bytes, numBytes };
+  return mp4_index_build(mp4_probe_read_buffer, &span, numBytes, index);
+}
+
+// Write the serialized index to a cache file, returns 0 on success
+
+static inline
+int mp4_index_write_file(const Mp4Index *index, const char *outFilePath) {
+  FILE *outFile = fopen(outFilePath, "wb");
+
+  if (outFile == NULL) {
+    return MP4_PROBE_ERR_IO;
+  }
+
+  int err = 0;
+
+  if (fwrite(index->bytes, (size_t) index->numBytes, 1, outFile) != 1) {
+    err = MP4_PROBE_ERR_IO;
+  }
+
+  if (fclose(outFile) != 0) {
+    err = MP4_PROBE_ERR_IO;
+  }
+
+  return err;
+}
+
+// Read a cache file written by mp4_index_write_file(), returns 0 on success
+
+static inline
+int mp4_index_read_file(const char *inFilePath, Mp4Index *index) {
+  memset(index, 0, sizeof(Mp4Index));
+
+  FILE *inFile = fopen(inFilePath, "rb");
+
+  if (inFile == NULL) {
+    return MP4_PROBE_ERR_IO;
+  }
+
+  fseeko(inFile, 0, SEEK_END);
+  uint64_t numBytes = (uint64_t) ftello(inFile);
+  fseeko(inFile, 0, SEEK_SET);
+
+  if (numBytes < sizeof(Mp4IndexHeader) ||
+      numBytes > mp4_index_num_bytes(MP4_INDEX_MAX_SAMPLES, MP4_INDEX_MAX_SAMPLES)) {
+    fclose(inFile);
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  uint8_t *storage = (uint8_t *) malloc((size_t) numBytes);
+
+  if (storage == NULL) {
+    fclose(inFile);
+    return MP4_PROBE_ERR_TOO_LARGE;
+  }
+
+  if (fread(storage, (size_t) numBytes, 1, inFile) != 1) {
+    fclose(inFile);
+    free(storage);
+    return MP4_PROBE_ERR_IO;
+  }
+
+  fclose(inFile);
+
+  int err = mp4_index_open_buffer(storage, numBytes, index);
+
+  if (err != 0) {
+    free(storage);
+    return err;
+  }
+
+  index->storage = storage;
+
+  return 0;
+}
+
+// Size and modification time in nanoseconds of a file, returns 0 on success
+
+static inline
+int mp4_index_source_stat(const char *inFilePath, uint64_t *sizePtr, int64_t *mtimePtr) {
+  struct stat st;
+
+  if (stat(inFilePath, &st) != 0) {
+    return MP4_PROBE_ERR_IO;
+  }
+
+#if defined(__APPLE__)
+  const struct timespec mtime = st.st_mtimespec;
+#else
+  const struct timespec mtime = st.st_mtim;
+#endif // __APPLE__
+
+  *sizePtr = (uint64_t) st.st_size;
+  *mtimePtr = ((int64_t) mtime.tv_sec * 1000000000) + (int64_t) mtime.tv_nsec;
+
+  return 0;
+}
+
+// Read the cached index for an MP4 file. A missing, truncated or
+// corrupt cache is a cache miss, as is a cache built from a file with
+// a different size or modification time. On a miss the index is built
+// from the MP4 file and the cache is written again. Returns 0 on success.
+
+static inline
+int mp4_index_load_cached(const char *inFilePath, const char *cacheFilePath, Mp4Index *index) {
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+
+  int err = mp4_index_source_stat(inFilePath, &sourceSize, &sourceMtime);
+
+  if (err != 0) {
+    memset(index, 0, sizeof(Mp4Index));
+    return err;
+  }
+
+  if (mp4_index_read_file(cacheFilePath, index) == 0) {
+    if (index->header->sourceSize == sourceSize && index->header->sourceMtime == sourceMtime) {
+      return 0;
+    }
+
+    mp4_index_free(index);
+  }
+
+  err = mp4_index_build_file(inFilePath, index);
+
+  if (err != 0) {
+    return err;
+  }
+
+  Mp4IndexHeader *header = (Mp4IndexHeader *) index->storage;
+  header->sourceSize = sourceSize;
+  header->sourceMtime = sourceMtime;
+
+  // A cache that cannot be written only costs a rebuild next time
+
+  mp4_index_write_file(index, cacheFilePath);
+
+  return 0;
+}
+
+#endif // _MP4_INDEX_H
@@ -0,0 +1,222 @@
+//
+//  mp4_pair_check.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only validator for an RGB and _alpha video pair. The
+//  container sample tables of both files are compared without
+//  decoding so that a pair that can never play back in lock-step
+//  is detected at load time instead of through dropped frames.
+//  Frame level mismatches are reported with display frame numbers.
+//
+//  See license.txt for license terms.
+
+#if !defined(_MP4_PAIR_CHECK_H)
+#define _MP4_PAIR_CHECK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mp4_probe.h"
+#include "mp4_index.h"
+
+// Maximum number of mismatches stored in a report, all mismatches
+// are counted even when they are not stored.
+#define MP4_PAIR_MAX_MISMATCHES 16
+
+typedef enum {
+  Mp4PairMismatchDimensions = 0,
+  Mp4PairMismatchTimescale,
+  Mp4PairMismatchFrameCount,
+  Mp4PairMismatchDuration,
+  // The first frame is presented at a different time, typically
+  // because the edit lists do not agree.
+  Mp4PairMismatchEditList,
+  // A frame is presented at a different time
+  Mp4PairMismatchFrameTime,
+  // One of the files could not be parsed
+  Mp4PairMismatchParse
+} Mp4PairMismatchType;
+
+typedef struct {
+  Mp4PairMismatchType type;
+  // Display frame number or -1 when not specific to a frame
+  int frameNum;
+  int64_t rgbValue;
+  int64_t alphaValue;
+} Mp4PairMismatch;
+
+typedef struct {
+  // Set when both files present identical frames at identical times
+  int isLockStep;
+  int numFrames;
+  int numMismatches;
+  int numStored;
+  Mp4PairMismatch mismatches[MP4_PAIR_MAX_MISMATCHES];
+} Mp4PairReport;
+
+static inline
+const char* mp4_pair_mismatch_name(Mp4PairMismatchType type) {
+  switch (type) {
+    case Mp4PairMismatchDimensions:
+      return "dimensions";
+    case Mp4PairMismatchTimescale:
+      return "timescale";
+    case Mp4PairMismatchFrameCount:
+      return "frame count";
+    case Mp4PairMismatchDuration:
+      return "duration";
+    case Mp4PairMismatchEditList:
+      return "edit list";
+    case Mp4PairMismatchFrameTime:
+      return "frame time";
+    case Mp4PairMismatchParse:
+      return "parse";
+  }
+  return "unknown";
+}
+
+static inline
+void mp4_pair_add_mismatch(Mp4PairReport *report, Mp4PairMismatchType type, int frameNum, int64_t rgbValue, int64_t alphaValue) {
+  if (report->numStored < MP4_PAIR_MAX_MISMATCHES) {
+    Mp4PairMismatch *mismatch = &report->mismatches[report->numStored++];
+    mismatch->type = type;
+    mismatch->frameNum = frameNum;
+    mismatch->rgbValue = rgbValue;
+    mismatch->alphaValue = alphaValue;
+  }
+  report->numMismatches += 1;
+}
+
+// Compare two already parsed files. Times are compared as exact
+// fractions so that files with different timescales that present
+// frames at the same instants are reported only for the timescale.
+
+static inline
+void mp4_pair_check_index(const Mp4ProbeResult *rgbProbe, const Mp4Index *rgbIndex,
+                          const Mp4ProbeResult *alphaProbe, const Mp4Index *alphaIndex,
+                          Mp4PairReport *report) {
+  memset(report, 0, sizeof(Mp4PairReport));
+
+  if (rgbProbe->width != alphaProbe->width) {
+    mp4_pair_add_mismatch(report, Mp4PairMismatchDimensions, -1, rgbProbe->width, alphaProbe->width);
+  }
+
+  if (rgbProbe->height != alphaProbe->height) {
+    mp4_pair_add_mismatch(report, Mp4PairMismatchDimensions, -1, rgbProbe->height, alphaProbe->height);
+  }
+
+  const int64_t rgbTimescale = rgbIndex->header->timescale;
+  const int64_t alphaTimescale = alphaIndex->header->timescale;
+
+  if (rgbTimescale != alphaTimescale) {
+    mp4_pair_add_mismatch(report, Mp4PairMismatchTimescale, -1, rgbTimescale, alphaTimescale);
+  }
+
+  const int rgbNumFrames = mp4_index_num_frames(rgbIndex);
+  const int alphaNumFrames = mp4_index_num_frames(alphaIndex);
+
+  const int numFrames = (rgbNumFrames < alphaNumFrames) ? rgbNumFrames : alphaNumFrames;
+
+  if (rgbNumFrames != alphaNumFrames) {
+    // Frame number is the first frame missing from the shorter file
+    mp4_pair_add_mismatch(report, Mp4PairMismatchFrameCount, numFrames, rgbNumFrames, alphaNumFrames);
+  }
+
+  // rgbEnd / rgbTimescale == alphaEnd / alphaTimescale
+
+  const int64_t rgbEnd = rgbIndex->header->endPts;
+  const int64_t alphaEnd = alphaIndex->header->endPts;
+
+  if ((rgbEnd * alphaTimescale) != (alphaEnd * rgbTimescale)) {
+    mp4_pair_add_mismatch(report, Mp4PairMismatchDuration, -1, rgbEnd, alphaEnd);
+  }
+
+  report->numFrames = numFrames;
+
+  for (int frameNum = 0; frameNum < numFrames; frameNum++) {
+    const int64_t rgbPts = mp4_index_frame(rgbIndex, frameNum)->pts;
+    const int64_t alphaPts = mp4_index_frame(alphaIndex, frameNum)->pts;
+
+    if ((rgbPts * alphaTimescale) != (alphaPts * rgbTimescale)) {
+      Mp4PairMismatchType type = (frameNum == 0) ? Mp4PairMismatchEditList : Mp4PairMismatchFrameTime;
+      mp4_pair_add_mismatch(report, type, frameNum, rgbPts, alphaPts);
+    }
+  }
+
+  report->isLockStep = (report->numMismatches == 0);
+}
+
+// Parse and compare an RGB file and an alpha file. Returns 0 when
+// both files could be parsed, the report indicates if they match.
+
+static inline
+int mp4_pair_check_files(const char *rgbPath, const char *alphaPath, Mp4PairReport *report) {
+  memset(report, 0, sizeof(Mp4PairReport));
+
+  Mp4ProbeResult rgbProbe;
+  Mp4ProbeResult alphaProbe;
+  Mp4Index rgbIndex;
+  Mp4Index alphaIndex;
+
+  int err = mp4_probe_file(rgbPath, &rgbProbe);
+
+  if (err == 0) {
+    err = mp4_index_build_file(rgbPath, &rgbIndex);
+  }
+
+  if (err != 0) {
+    mp4_pair_add_mismatch(report, Mp4PairMismatchParse, -1, err, 0);
+    return err;
+  }
+
+  err = mp4_probe_file(alphaPath, &alphaProbe);
+
+  if (err == 0) {
+    err = mp4_index_build_file(alphaPath, &alphaIndex);
+  }
+
+  if (err != 0) {
+    mp4_index_free(&rgbIndex);
+    mp4_pair_add_mismatch(report, Mp4PairMismatchParse, -1, 0, err);
+    return err;
+  }
+
+  mp4_pair_check_index(&rgbProbe, &rgbIndex, &alphaProbe, &alphaIndex, report);
+
+  mp4_index_free(&rgbIndex);
+  mp4_index_free(&alphaIndex);
+
+  return 0;
+}
+
+// Print one line per stored mismatch
+
+static inline
+void mp4_pair_print_report(FILE *outFile, const char *prefix, const Mp4PairReport *report) {
+  for (int i = 0; i < report->numStored; i++) {
+    const Mp4PairMismatch *mismatch = &report->mismatches[i];
+
+    if (mismatch->frameNum >= 0) {
+      fprintf(outFile, "%s%s mismatch at frame %d : rgb %lld alpha %lld\n",
+              prefix,
+              mp4_pair_mismatch_name(mismatch->type),
+              mismatch->frameNum,
+              (long long) mismatch->rgbValue,
+              (long long) mismatch->alphaValue);
+    } else {
+      fprintf(outFile, "%s%s mismatch : rgb %lld alpha %lld\n",
+              prefix,
+              mp4_pair_mismatch_name(mismatch->type),
+              (long long) mismatch->rgbValue,
+              (long long) mismatch->alphaValue);
+    }
+  }
+
+  if (report->numMismatches > report->numStored) {
+    fprintf(outFile, "%s%d more mismatches\n", prefix, report->numMismatches - report->numStored);
+  }
+}
+
+#endif // _MP4_PAIR_CHECK_H
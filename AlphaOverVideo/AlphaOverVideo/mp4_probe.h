@@ -0,0 +1,811 @@
+//
+//  mp4_probe.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that parses the moov atom of an
+//  ISO-BMFF (MP4, M4V, MOV) file to extract the properties
+//  of the first video track: dimensions, timescale, frame
+//  count, FPS and colour tags. Only the box headers before
+//  moov and the moov box itself are read, so probing a clip
+//  takes microseconds as opposed to an async AVAsset load.
+//
+//  All reads go through a bounded read callback and every
+//  box size is checked against the size of the enclosing box,
+//  so a truncated or corrupted file fails with an error code
+//  instead of reading out of bounds.
+//
+//  See license.txt for license terms.
+
+#if !defined(_MP4_PROBE_H)
+#define _MP4_PROBE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Largest moov box that will be read into memory
+
+#define MP4_PROBE_MAX_MOOV (32 * 1024 * 1024)
+
+// Error codes, 0 indicates success
+
+#define MP4_PROBE_ERR_IO 1
+#define MP4_PROBE_ERR_NO_MOOV 2
+#define MP4_PROBE_ERR_MALFORMED 3
+#define MP4_PROBE_ERR_NO_VIDEO 4
+#define MP4_PROBE_ERR_TOO_LARGE 5
+
+// Read len bytes at offset into buf, returns the number of bytes read
+
+typedef uint32_t (*mp4_read_func)(void *ctx, uint64_t offset, uint8_t *buf, uint32_t len);
+
+typedef struct {
+  // Sample entry type, "avc1" for H.264
+  char codec[5];
+
+  int width;
+  int height;
+
+  // Media timescale and duration in timescale units
+  uint32_t timescale;
+  uint64_t duration;
+
+  int numFrames;
+
+  // Shortest sample duration in timescale units
+  uint32_t minFrameDelta;
+  int isConstantFrameRate;
+
+  float FPS;
+  float frameDuration;
+  double durationSeconds;
+
+  // H.264 profile and level from avcC
+  int profile;
+  int level;
+
+  // ISO/IEC 23001-8 colour tags from colr nclx/nclc, or from the
+  // H.264 SPS VUI when the container has no colr box.
+  int hasColorTags;
+  int colorPrimaries;
+  int transferCharacteristics;
+  int matrixCoefficients;
+  int fullRange;
+} Mp4ProbeResult;
+
+// Bounds checked cursor over an in memory box payload
+
+typedef struct {
+  const uint8_t *ptr;
+  uint64_t len;
+} Mp4ProbeSpan;
+
+static inline
+uint32_t mp4_probe_be16(const uint8_t *ptr) {
+  return ((uint32_t) ptr[0] << 8) | ptr[1];
+}
+
+static inline
+uint32_t mp4_probe_be32(const uint8_t *ptr) {
+  return ((uint32_t) ptr[0] << 24) | ((uint32_t) ptr[1] << 16) | ((uint32_t) ptr[2] << 8) | ptr[3];
+}
+
+static inline
+uint64_t mp4_probe_be64(const uint8_t *ptr) {
+  return ((uint64_t) mp4_probe_be32(ptr) << 32) | mp4_probe_be32(ptr + 4);
+}
+
+// Parse the box header at the start of span. On success the type
+// is written to typePtr and the payload of the box is written to
+// payloadPtr, returns the total size of the box or 0 on error.
+
+static inline
+uint64_t mp4_probe_box(const Mp4ProbeSpan *span, uint32_t *typePtr, Mp4ProbeSpan *payloadPtr) {
+  if (span->len < 8) {
+    return 0;
+  }
+
+  uint64_t size = mp4_probe_be32(span->ptr);
+  uint32_t headerSize = 8;
+
+  if (size == 1) {
+    if (span->len < 16) {
+      return 0;
+    }
+    size = mp4_probe_be64(span->ptr + 8);
+    headerSize = 16;
+  } else if (size == 0) {
+    // Box extends to the end of the enclosing box
+    size = span->len;
+  }
+
+  if (size < headerSize || size > span->len) {
+    return 0;
+  }
+
+  *typePtr = mp4_probe_be32(span->ptr + 4);
+  payloadPtr->ptr = span->ptr + headerSize;
+  payloadPtr->len = size - headerSize;
+
+  return size;
+}
+
+#define MP4_PROBE_FOURCC(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+// Find the first child box with the given type, returns 0 on success
+
+static inline
+int mp4_probe_find(const Mp4ProbeSpan *span, uint32_t type, Mp4ProbeSpan *payloadPtr) {
+  Mp4ProbeSpan cur = *span;
+
+  while (cur.len >= 8) {
+    uint32_t boxType;
+    Mp4ProbeSpan payload;
+    uint64_t size = mp4_probe_box(&cur, &boxType, &payload);
+
+    if (size == 0) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+
+    if (boxType == type) {
+      *payloadPtr = payload;
+      return 0;
+    }
+
+    cur.ptr += size;
+    cur.len -= size;
+  }
+
+  return MP4_PROBE_ERR_MALFORMED;
+}
+
+// Find a box by following a path of nested box types
+
+static inline
+int mp4_probe_find_path(const Mp4ProbeSpan *span, const uint32_t *types, int numTypes, Mp4ProbeSpan *payloadPtr) {
+  Mp4ProbeSpan cur = *span;
+
+  for (int i = 0; i < numTypes; i++) {
+    if (mp4_probe_find(&cur, types[i], &cur) != 0) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+  }
+
+  *payloadPtr = cur;
+  return 0;
+}
+
+// Bit reader for H.264 RBSP data, reads past the end return zero
+// bits and set the error flag.
+
+typedef struct {
+  const uint8_t *ptr;
+  int numBytes;
+  int bitOffset;
+  int isError;
+} Mp4ProbeBits;
+
+static inline
+uint32_t mp4_probe_bits(Mp4ProbeBits *bits, int n) {
+  uint32_t v = 0;
+
+  for (int i = 0; i < n; i++) {
+    int byteOffset = bits->bitOffset >> 3;
+
+    if (byteOffset >= bits->numBytes) {
+      bits->isError = 1;
+      return 0;
+    }
+
+    int bit = (bits->ptr[byteOffset] >> (7 - (bits->bitOffset & 0x7))) & 0x1;
+    v = (v << 1) | bit;
+    bits->bitOffset++;
+  }
+
+  return v;
+}
+
+// Exp-Golomb unsigned
+
+static inline
+uint32_t mp4_probe_ue(Mp4ProbeBits *bits) {
+  int leadingZeros = 0;
+
+  while (mp4_probe_bits(bits, 1) == 0) {
+    if (bits->isError || leadingZeros == 31) {
+      bits->isError = 1;
+      return 0;
+    }
+    leadingZeros++;
+  }
+
+  return ((1u << leadingZeros) - 1) + mp4_probe_bits(bits, leadingZeros);
+}
+
+// Exp-Golomb signed
+
+static inline
+int32_t mp4_probe_se(Mp4ProbeBits *bits) {
+  uint32_t v = mp4_probe_ue(bits);
+  return (v & 0x1) ? (int32_t) ((v + 1) / 2) : -((int32_t) (v / 2));
+}
+
+// Read the colour description from the VUI of a H.264 SPS NAL unit.
+// Returns 0 when colour tags were found.
+
+static inline
+int mp4_probe_sps_colors(const uint8_t *nal, int nalLen, Mp4ProbeResult *result) {
+  // Remove emulation prevention bytes, only the start of the
+  // SPS up to the VUI colour description is needed.
+
+  uint8_t rbsp[256];
+  int rbspLen = 0;
+  int zeroCount = 0;
+
+  for (int i = 1; i < nalLen && rbspLen < (int) sizeof(rbsp); i++) {
+    uint8_t b = nal[i];
+    if (zeroCount == 2 && b == 0x03) {
+      zeroCount = 0;
+      continue;
+    }
+    zeroCount = (b == 0) ? (zeroCount + 1) : 0;
+    rbsp[rbspLen++] = b;
+  }
+
+  Mp4ProbeBits bits = { rbsp, rbspLen, 0, 0 };
+
+  const int profile = mp4_probe_bits(&bits, 8);
+  mp4_probe_bits(&bits, 16); // constraint flags and level
+  mp4_probe_ue(&bits); // seq_parameter_set_id
+
+  if (profile == 100 || profile == 110 || profile == 122 || profile == 244 ||
+      profile == 44 || profile == 83 || profile == 86 || profile == 118 ||
+      profile == 128 || profile == 138 || profile == 139 || profile == 134 || profile == 135) {
+    const uint32_t chromaFormat = mp4_probe_ue(&bits);
+    if (chromaFormat == 3) {
+      mp4_probe_bits(&bits, 1); // separate_colour_plane_flag
+    }
+    mp4_probe_ue(&bits); // bit_depth_luma_minus8
+    mp4_probe_ue(&bits); // bit_depth_chroma_minus8
+    mp4_probe_bits(&bits, 1); // qpprime_y_zero_transform_bypass_flag
+
+    if (mp4_probe_bits(&bits, 1)) {
+      // seq_scaling_matrix_present_flag
+      const int numLists = (chromaFormat == 3) ? 12 : 8;
+      for (int i = 0; i < numLists && !bits.isError; i++) {
+        if (mp4_probe_bits(&bits, 1)) {
+          const int size = (i < 6) ? 16 : 64;
+          int lastScale = 8;
+          int nextScale = 8;
+          for (int j = 0; j < size && !bits.isError; j++) {
+            if (nextScale != 0) {
+              nextScale = (lastScale + mp4_probe_se(&bits) + 256) % 256;
+            }
+            lastScale = (nextScale == 0) ? lastScale : nextScale;
+          }
+        }
+      }
+    }
+  }
+
+  mp4_probe_ue(&bits); // log2_max_frame_num_minus4
+
+  const uint32_t pocType = mp4_probe_ue(&bits);
+
+  if (pocType == 0) {
+    mp4_probe_ue(&bits); // log2_max_pic_order_cnt_lsb_minus4
+  } else if (pocType == 1) {
+    mp4_probe_bits(&bits, 1);
+    mp4_probe_se(&bits);
+    mp4_probe_se(&bits);
+    const uint32_t numRefFramesInCycle = mp4_probe_ue(&bits);
+    for (uint32_t i = 0; i < numRefFramesInCycle && !bits.isError; i++) {
+      mp4_probe_se(&bits);
+    }
+  }
+
+  mp4_probe_ue(&bits); // max_num_ref_frames
+  mp4_probe_bits(&bits, 1); // gaps_in_frame_num_value_allowed_flag
+  mp4_probe_ue(&bits); // pic_width_in_mbs_minus1
+  mp4_probe_ue(&bits); // pic_height_in_map_units_minus1
+
+  if (mp4_probe_bits(&bits, 1) == 0) {
+    // frame_mbs_only_flag is zero
+    mp4_probe_bits(&bits, 1); // mb_adaptive_frame_field_flag
+  }
+
+  mp4_probe_bits(&bits, 1); // direct_8x8_inference_flag
+
+  if (mp4_probe_bits(&bits, 1)) {
+    // frame_cropping_flag
+    for (int i = 0; i < 4; i++) {
+      mp4_probe_ue(&bits);
+    }
+  }
+
+  if (mp4_probe_bits(&bits, 1) == 0 || bits.isError) {
+    // No VUI
+    return 1;
+  }
+
+  if (mp4_probe_bits(&bits, 1)) {
+    // aspect_ratio_info_present_flag
+    if (mp4_probe_bits(&bits, 8) == 255) {
+      mp4_probe_bits(&bits, 32); // sar_width and sar_height
+    }
+  }
+
+  if (mp4_probe_bits(&bits, 1)) {
+    // overscan_info_present_flag
+    mp4_probe_bits(&bits, 1);
+  }
+
+  if (mp4_probe_bits(&bits, 1) == 0) {
+    // No video_signal_type
+    return 1;
+  }
+
+  mp4_probe_bits(&bits, 3); // video_format
+  const int fullRange = mp4_probe_bits(&bits, 1);
+
+  if (mp4_probe_bits(&bits, 1) == 0) {
+    // No colour_description
+    return 1;
+  }
+
+  const int primaries = mp4_probe_bits(&bits, 8);
+  const int transfer = mp4_probe_bits(&bits, 8);
+  const int matrix = mp4_probe_bits(&bits, 8);
+
+  if (bits.isError) {
+    return 1;
+  }
+
+  result->hasColorTags = 1;
+  result->colorPrimaries = primaries;
+  result->transferCharacteristics = transfer;
+  result->matrixCoefficients = matrix;
+  result->fullRange = fullRange;
+
+  return 0;
+}
+
+// Parse avcC for profile and level, then parse the first SPS for colour tags
+
+static inline
+void mp4_probe_avcc(const Mp4ProbeSpan *avcc, Mp4ProbeResult *result, int parseColors) {
+  if (avcc->len < 6) {
+    return;
+  }
+
+  const uint8_t *ptr = avcc->ptr;
+
+  result->profile = ptr[1];
+  result->level = ptr[3];
+
+  if (!parseColors) {
+    return;
+  }
+
+  const int numSPS = ptr[5] & 0x1F;
+
+  if (numSPS == 0 || avcc->len < 8) {
+    return;
+  }
+
+  const int spsLen = (int) mp4_probe_be16(ptr + 6);
+
+  if (spsLen < 4 || (uint64_t) (8 + spsLen) > avcc->len) {
+    return;
+  }
+
+  mp4_probe_sps_colors(ptr + 8, spsLen, result);
+}
+
+// Parse stsd, the first sample entry determines codec and dimensions
+
+static inline
+int mp4_probe_stsd(const Mp4ProbeSpan *stsd, Mp4ProbeResult *result) {
+  if (stsd->len < 8) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  Mp4ProbeSpan entries = { stsd->ptr + 8, stsd->len - 8 };
+
+  uint32_t type;
+  Mp4ProbeSpan entry;
+
+  if (mp4_probe_box(&entries, &type, &entry) == 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  result->codec[0] = (char) ((type >> 24) & 0xFF);
+  result->codec[1] = (char) ((type >> 16) & 0xFF);
+  result->codec[2] = (char) ((type >> 8) & 0xFF);
+  result->codec[3] = (char) (type & 0xFF);
+  result->codec[4] = '\0';
+
+  // VisualSampleEntry is 78 bytes followed by child boxes
+
+  if (entry.len < 78) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  result->width = (int) mp4_probe_be16(entry.ptr + 24);
+  result->height = (int) mp4_probe_be16(entry.ptr + 26);
+
+  Mp4ProbeSpan children = { entry.ptr + 78, entry.len - 78 };
+  Mp4ProbeSpan payload;
+
+  if (mp4_probe_find(&children, MP4_PROBE_FOURCC('c','o','l','r'), &payload) == 0 && payload.len >= 10) {
+    uint32_t colorType = mp4_probe_be32(payload.ptr);
+
+    if (colorType == MP4_PROBE_FOURCC('n','c','l','x') || colorType == MP4_PROBE_FOURCC('n','c','l','c')) {
+      result->hasColorTags = 1;
+      result->colorPrimaries = (int) mp4_probe_be16(payload.ptr + 4);
+      result->transferCharacteristics = (int) mp4_probe_be16(payload.ptr + 6);
+      result->matrixCoefficients = (int) mp4_probe_be16(payload.ptr + 8);
+      result->fullRange = 0;
+
+      if (colorType == MP4_PROBE_FOURCC('n','c','l','x') && payload.len >= 11) {
+        result->fullRange = (payload.ptr[10] >> 7) & 0x1;
+      }
+    }
+  }
+
+  if (mp4_probe_find(&children, MP4_PROBE_FOURCC('a','v','c','C'), &payload) == 0) {
+    mp4_probe_avcc(&payload, result, !result->hasColorTags);
+  }
+
+  return 0;
+}
+
+// Parse stts to count frames and find the shortest frame duration
+
+static inline
+int mp4_probe_stts(const Mp4ProbeSpan *stts, Mp4ProbeResult *result) {
+  if (stts->len < 8) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  const uint32_t numEntries = mp4_probe_be32(stts->ptr + 4);
+
+  if (((uint64_t) numEntries * 8) > (stts->len - 8)) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  const uint8_t *ptr = stts->ptr + 8;
+  uint64_t numFrames = 0;
+  uint32_t minDelta = 0;
+  uint32_t firstDelta = 0;
+  int isConstant = 1;
+
+  for (uint32_t i = 0; i < numEntries; i++, ptr += 8) {
+    const uint32_t count = mp4_probe_be32(ptr);
+    const uint32_t delta = mp4_probe_be32(ptr + 4);
+
+    numFrames += count;
+
+    if (count == 0 || delta == 0) {
+      continue;
+    }
+
+    if (minDelta == 0 || delta < minDelta) {
+      minDelta = delta;
+    }
+
+    // The final sample often has a different duration, so a
+    // single sample entry at the end does not count as a change.
+
+    const int isFinalSample = (i == (numEntries - 1)) && (count == 1);
+
+    if (firstDelta == 0) {
+      firstDelta = delta;
+    } else if (delta != firstDelta && !isFinalSample) {
+      isConstant = 0;
+    }
+  }
+
+  if (numFrames > 0x7FFFFFFF) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  result->numFrames = (int) numFrames;
+  result->minFrameDelta = minDelta;
+  result->isConstantFrameRate = isConstant;
+
+  return 0;
+}
+
+// Find the first trak with a video handler in an in memory moov
+// payload. Returns 0 on success.
+
+static inline
+int mp4_probe_video_trak(const Mp4ProbeSpan *moov, Mp4ProbeSpan *trakPtr, Mp4ProbeSpan *mdiaPtr) {
+  Mp4ProbeSpan cur = *moov;
+
+  while (cur.len >= 8) {
+    uint32_t type;
+    Mp4ProbeSpan trak;
+    uint64_t size = mp4_probe_box(&cur, &type, &trak);
+
+    if (size == 0) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+
+    cur.ptr += size;
+    cur.len -= size;
+
+    if (type != MP4_PROBE_FOURCC('t','r','a','k')) {
+      continue;
+    }
+
+    Mp4ProbeSpan mdia;
+
+    if (mp4_probe_find(&trak, MP4_PROBE_FOURCC('m','d','i','a'), &mdia) != 0) {
+      continue;
+    }
+
+    Mp4ProbeSpan hdlr;
+
+    if (mp4_probe_find(&mdia, MP4_PROBE_FOURCC('h','d','l','r'), &hdlr) != 0 || hdlr.len < 12) {
+      continue;
+    }
+
+    if (mp4_probe_be32(hdlr.ptr + 8) != MP4_PROBE_FOURCC('v','i','d','e')) {
+      continue;
+    }
+
+    *trakPtr = trak;
+    *mdiaPtr = mdia;
+    return 0;
+  }
+
+  return MP4_PROBE_ERR_NO_VIDEO;
+}
+
+// Parse the tracks in an in memory moov payload, the first video
+// track is used. Returns 0 on success.
+
+static inline
+int mp4_probe_moov(const Mp4ProbeSpan *moov, Mp4ProbeResult *result) {
+  memset(result, 0, sizeof(Mp4ProbeResult));
+
+  Mp4ProbeSpan trak;
+  Mp4ProbeSpan mdia;
+
+  int err = mp4_probe_video_trak(moov, &trak, &mdia);
+  if (err != 0) {
+    return err;
+  }
+
+  Mp4ProbeSpan mdhd;
+
+  if (mp4_probe_find(&mdia, MP4_PROBE_FOURCC('m','d','h','d'), &mdhd) != 0 || mdhd.len < 4) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  if (mdhd.ptr[0] == 1) {
+    if (mdhd.len < 32) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+    result->timescale = mp4_probe_be32(mdhd.ptr + 20);
+    result->duration = mp4_probe_be64(mdhd.ptr + 24);
+  } else {
+    if (mdhd.len < 20) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+    result->timescale = mp4_probe_be32(mdhd.ptr + 12);
+    result->duration = mp4_probe_be32(mdhd.ptr + 16);
+  }
+
+  if (result->timescale == 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  // Track header dimensions are 16.16 fixed point, these are
+  // used only when the sample entry does not define a size.
+
+  Mp4ProbeSpan tkhd;
+  int tkhdWidth = 0;
+  int tkhdHeight = 0;
+
+  if (mp4_probe_find(&trak, MP4_PROBE_FOURCC('t','k','h','d'), &tkhd) == 0) {
+    const uint64_t dimOffset = (tkhd.len > 0 && tkhd.ptr[0] == 1) ? 88 : 76;
+    if (tkhd.len >= (dimOffset + 8)) {
+      tkhdWidth = (int) (mp4_probe_be32(tkhd.ptr + dimOffset) >> 16);
+      tkhdHeight = (int) (mp4_probe_be32(tkhd.ptr + dimOffset + 4) >> 16);
+    }
+  }
+
+  const uint32_t stblPath[] = {
+    MP4_PROBE_FOURCC('m','i','n','f'),
+    MP4_PROBE_FOURCC('s','t','b','l')
+  };
+
+  Mp4ProbeSpan stbl;
+
+  if (mp4_probe_find_path(&mdia, stblPath, 2, &stbl) != 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  Mp4ProbeSpan stsd;
+
+  if (mp4_probe_find(&stbl, MP4_PROBE_FOURCC('s','t','s','d'), &stsd) != 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  err = mp4_probe_stsd(&stsd, result);
+  if (err != 0) {
+    return err;
+  }
+
+  if (result->width == 0 || result->height == 0) {
+    result->width = tkhdWidth;
+    result->height = tkhdHeight;
+  }
+
+  Mp4ProbeSpan stts;
+
+  if (mp4_probe_find(&stbl, MP4_PROBE_FOURCC('s','t','t','s'), &stts) != 0) {
+    return MP4_PROBE_ERR_MALFORMED;
+  }
+
+  err = mp4_probe_stts(&stts, result);
+  if (err != 0) {
+    return err;
+  }
+
+  if (result->minFrameDelta > 0) {
+    result->frameDuration = (float) result->minFrameDelta / result->timescale;
+    result->FPS = (float) result->timescale / result->minFrameDelta;
+  }
+
+  result->durationSeconds = (double) result->duration / result->timescale;
+
+  return 0;
+}
+
+// Walk top level boxes with bounded reads until moov is found, then
+// read the moov payload into a malloc() buffer that the caller must
+// free. Returns 0 on success.
+
+static inline
+int mp4_probe_read_moov(mp4_read_func readFunc, void *ctx, uint64_t fileSize, uint8_t **moovBytesPtr, uint64_t *moovLenPtr) {
+  uint64_t offset = 0;
+
+  *moovBytesPtr = NULL;
+  *moovLenPtr = 0;
+
+  while ((offset + 8) <= fileSize) {
+    uint8_t header[16];
+    uint32_t headerLen = (fileSize - offset) >= 16 ? 16 : 8;
+
+    if (readFunc(ctx, offset, header, headerLen) != headerLen) {
+      return MP4_PROBE_ERR_IO;
+    }
+
+    uint64_t size = mp4_probe_be32(header);
+    uint32_t headerSize = 8;
+
+    if (size == 1) {
+      if (headerLen < 16) {
+        return MP4_PROBE_ERR_MALFORMED;
+      }
+      size = mp4_probe_be64(header + 8);
+      headerSize = 16;
+    } else if (size == 0) {
+      size = fileSize - offset;
+    }
+
+    if (size < headerSize || size > (fileSize - offset)) {
+      return MP4_PROBE_ERR_MALFORMED;
+    }
+
+    if (mp4_probe_be32(header + 4) == MP4_PROBE_FOURCC('m','o','o','v')) {
+      const uint64_t payloadLen = size - headerSize;
+
+      if (payloadLen > MP4_PROBE_MAX_MOOV) {
+        return MP4_PROBE_ERR_TOO_LARGE;
+      }
+
+      uint8_t *moovBytes = (uint8_t *) malloc(payloadLen > 0 ? (size_t) payloadLen : 1);
+
+      if (moovBytes == NULL) {
+        return MP4_PROBE_ERR_TOO_LARGE;
+      }
+
+      if (readFunc(ctx, offset + headerSize, moovBytes, (uint32_t) payloadLen) != payloadLen) {
+        free(moovBytes);
+        return MP4_PROBE_ERR_IO;
+      }
+
+      *moovBytesPtr = moovBytes;
+      *moovLenPtr = payloadLen;
+      return 0;
+    }
+
+    offset += size;
+  }
+
+  return MP4_PROBE_ERR_NO_MOOV;
+}
+
+// Read moov with bounded reads and parse it. Returns 0 on success.
+
+static inline
+int mp4_probe(mp4_read_func readFunc, void *ctx, uint64_t fileSize, Mp4ProbeResult *result) {
+  memset(result, 0, sizeof(Mp4ProbeResult));
+
+  uint8_t *moovBytes;
+  uint64_t moovLen;
+
+  int err = mp4_probe_read_moov(readFunc, ctx, fileSize, &moovBytes, &moovLen);
+  if (err != 0) {
+    return err;
+  }
+
+  Mp4ProbeSpan moov = { moovBytes, moovLen };
+  err = mp4_probe_moov(&moov, result);
+
+  free(moovBytes);
+  return err;
+}
+
+// Read callbacks for a file and for an in memory buffer
+
+static inline
+uint32_t mp4_probe_read_file(void *ctx, uint64_t offset, uint8_t *buf, uint32_t len) {
+  FILE *inFile = (FILE *) ctx;
+
+  if (fseeko(inFile, (off_t) offset, SEEK_SET) != 0) {
+    return 0;
+  }
+
+  return (uint32_t) fread(buf, 1, len, inFile);
+}
+
+static inline
+uint32_t mp4_probe_read_buffer(void *ctx, uint64_t offset, uint8_t *buf, uint32_t len) {
+  const Mp4ProbeSpan *span = (const Mp4ProbeSpan *) ctx;
+
+  if (offset >= span->len) {
+    return 0;
+  }
+
+  if (len > (span->len - offset)) {
+    len = (uint32_t) (span->len - offset);
+  }
+
+  memcpy(buf, span->ptr + offset, len);
+  return len;
+}
+
+static inline
+int mp4_probe_file(const char *inFilePath, Mp4ProbeResult *result) {
+  FILE *inFile = fopen(inFilePath, "rb");
+
+  if (inFile == NULL) {
+    return MP4_PROBE_ERR_IO;
+  }
+
+  fseeko(inFile, 0, SEEK_END);
+  uint64_t fileSize = (uint64_t) ftello(inFile);
+
+  int err = mp4_probe(mp4_probe_read_file, inFile, fileSize, result);
+
+  fclose(inFile);
+
+  return err;
+}
+
+static inline
+int mp4_probe_buffer(const uint8_t *bytes, uint64_t numBytes, Mp4ProbeResult *result) {
+  Mp4ProbeSpan span = { bytes, numBytes };
+  return mp4_probe(mp4_probe_read_buffer, &span, numBytes, result);
+}
+
+#endif // _MP4_PROBE_H
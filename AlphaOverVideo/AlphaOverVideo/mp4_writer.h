@@ -0,0 +1,707 @@
+//
+//  mp4_writer.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only muxer that writes one H.264 video track to an
+//  .m4v file. Encoded samples are appended to the mdat box as they
+//  arrive, so only the compressed data touches disk, and the moov
+//  box with the sample tables is written when the file is closed.
+//  Samples are passed in with 4 byte big endian NAL lengths (AVCC
+//  format) along with decode and presentation times.
+//
+//  See license.txt for license terms.
+
+#if !defined(_MP4_WRITER_H)
+#define _MP4_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MP4_WRITER_ERR_IO 1
+#define MP4_WRITER_ERR_STATE 2
+#define MP4_WRITER_ERR_MEMORY 3
+
+typedef struct {
+  FILE *outFile;
+  int width;
+  int height;
+  uint32_t timescale;
+
+  // avcC payload built from the SPS and PPS
+  uint8_t *avcC;
+  int avcCLen;
+
+  int hasColorTags;
+  int colorPrimaries;
+  int transferCharacteristics;
+  int matrixCoefficients;
+  int fullRange;
+
+  // Offset of the mdat header, the size is written on close
+  uint64_t mdatOffset;
+  uint64_t writeOffset;
+
+  // DTS of the first sample, all times are shifted so that
+  // the first decode time is zero.
+  int64_t firstDts;
+
+  uint32_t *sizes;
+  uint64_t *offsets;
+  int64_t *dts;
+  int64_t *pts;
+  uint8_t *isKeyframe;
+  int numSamples;
+  int maxSamples;
+} Mp4Writer;
+
+// Big endian output buffer used to assemble the moov box
+
+typedef struct {
+  uint8_t *bytes;
+  uint64_t len;
+  uint64_t capacity;
+  int failed;
+} Mp4WriterBuffer;
+
+static inline
+void mp4_writer_buffer_reserve(Mp4WriterBuffer *buf, uint64_t numBytes) {
+  if (buf->failed || (buf->len + numBytes) <= buf->capacity) {
+    return;
+  }
+
+  uint64_t capacity = (buf->capacity == 0) ? 4096 : buf->capacity;
+  while (capacity < (buf->len + numBytes)) {
+    capacity *= 2;
+  }
+
+  uint8_t *bytes = (uint8_t *) realloc(buf->bytes, (size_t) capacity);
+  if (bytes == NULL) {
+    buf->failed = 1;
+    return;
+  }
+
+  buf->bytes = bytes;
+  buf->capacity = capacity;
+}
+
+static inline
+void mp4_writer_put_bytes(Mp4WriterBuffer *buf, const void *bytes, uint64_t numBytes) {
+  mp4_writer_buffer_reserve(buf, numBytes);
+  if (buf->failed) {
+    return;
+  }
+  memcpy(buf->bytes + buf->len, bytes, (size_t) numBytes);
+  buf->len += numBytes;
+}
+
+static inline
+void mp4_writer_put8(Mp4WriterBuffer *buf, uint32_t v) {
+  uint8_t b = (uint8_t) v;
+  mp4_writer_put_bytes(buf, &b, 1);
+}
+
+static inline
+void mp4_writer_put16(Mp4WriterBuffer *buf, uint32_t v) {
+  uint8_t b[2] = { (uint8_t) (v >> 8), (uint8_t) v };
+  mp4_writer_put_bytes(buf, b, 2);
+}
+
+static inline
+void mp4_writer_put32(Mp4WriterBuffer *buf, uint32_t v) {
+  uint8_t b[4] = { (uint8_t) (v >> 24), (uint8_t) (v >> 16), (uint8_t) (v >> 8), (uint8_t) v };
+  mp4_writer_put_bytes(buf, b, 4);
+}
+
+static inline
+void mp4_writer_put64(Mp4WriterBuffer *buf, uint64_t v) {
+  mp4_writer_put32(buf, (uint32_t) (v >> 32));
+  mp4_writer_put32(buf, (uint32_t) v);
+}
+
+static inline
+void mp4_writer_put_zeros(Mp4WriterBuffer *buf, int numBytes) {
+  for (int i = 0; i < numBytes; i++) {
+    mp4_writer_put8(buf, 0);
+  }
+}
+
+// Start a box and return the offset of the size field, the size
+// is filled in by mp4_writer_end_box().
+
+static inline
+uint64_t mp4_writer_begin_box(Mp4WriterBuffer *buf, const char *type) {
+  uint64_t offset = buf->len;
+  mp4_writer_put32(buf, 0);
+  mp4_writer_put_bytes(buf, type, 4);
+  return offset;
+}
+
+static inline
+uint64_t mp4_writer_begin_full_box(Mp4WriterBuffer *buf, const char *type, int version, uint32_t flags) {
+  uint64_t offset = mp4_writer_begin_box(buf, type);
+  mp4_writer_put32(buf, ((uint32_t) version << 24) | (flags & 0xFFFFFF));
+  return offset;
+}
+
+static inline
+void mp4_writer_end_box(Mp4WriterBuffer *buf, uint64_t offset) {
+  if (buf->failed) {
+    return;
+  }
+  uint32_t size = (uint32_t) (buf->len - offset);
+  buf->bytes[offset] = (uint8_t) (size >> 24);
+  buf->bytes[offset + 1] = (uint8_t) (size >> 16);
+  buf->bytes[offset + 2] = (uint8_t) (size >> 8);
+  buf->bytes[offset + 3] = (uint8_t) size;
+}
+
+// Open the output file and write the ftyp box and the mdat header.
+// Returns 0 on success.
+
+static inline
+int mp4_writer_open(Mp4Writer *writer, const char *outPath, int width, int height, uint32_t timescale) {
+  memset(writer, 0, sizeof(Mp4Writer));
+
+  writer->width = width;
+  writer->height = height;
+  writer->timescale = timescale;
+
+  writer->outFile = fopen(outPath, "wb");
+
+  if (writer->outFile == NULL) {
+    return MP4_WRITER_ERR_IO;
+  }
+
+  Mp4WriterBuffer buf;
+  memset(&buf, 0, sizeof(buf));
+
+  uint64_t ftyp = mp4_writer_begin_box(&buf, "ftyp");
+  mp4_writer_put_bytes(&buf, "M4V ", 4);
+  mp4_writer_put32(&buf, 1);
+  mp4_writer_put_bytes(&buf, "M4V ", 4);
+  mp4_writer_put_bytes(&buf, "M4A ", 4);
+  mp4_writer_put_bytes(&buf, "mp42", 4);
+  mp4_writer_put_bytes(&buf, "isom", 4);
+  mp4_writer_end_box(&buf, ftyp);
+
+  writer->mdatOffset = buf.len;
+
+  // 64 bit mdat size so that large files need no rewrite
+
+  mp4_writer_put32(&buf, 1);
+  mp4_writer_put_bytes(&buf, "mdat", 4);
+  mp4_writer_put64(&buf, 0);
+
+  int err = 0;
+
+  if (buf.failed || fwrite(buf.bytes, (size_t) buf.len, 1, writer->outFile) != 1) {
+    err = MP4_WRITER_ERR_IO;
+  }
+
+  writer->writeOffset = buf.len;
+
+  free(buf.bytes);
+  return err;
+}
+
+// Define the avcC decoder configuration from a raw SPS and PPS
+// without start codes or length prefixes.
+
+static inline
+int mp4_writer_set_avcc(Mp4Writer *writer, const uint8_t *sps, int spsLen, const uint8_t *pps, int ppsLen) {
+  if (spsLen < 4 || ppsLen < 1) {
+    return MP4_WRITER_ERR_STATE;
+  }
+
+  Mp4WriterBuffer buf;
+  memset(&buf, 0, sizeof(buf));
+
+  mp4_writer_put8(&buf, 1);
+  // profile, constraint flags and level
+  mp4_writer_put8(&buf, sps[1]);
+  mp4_writer_put8(&buf, sps[2]);
+  mp4_writer_put8(&buf, sps[3]);
+  // 4 byte NAL lengths
+  mp4_writer_put8(&buf, 0xFF);
+  mp4_writer_put8(&buf, 0xE1);
+  mp4_writer_put16(&buf, spsLen);
+  mp4_writer_put_bytes(&buf, sps, spsLen);
+  mp4_writer_put8(&buf, 1);
+  mp4_writer_put16(&buf, ppsLen);
+  mp4_writer_put_bytes(&buf, pps, ppsLen);
+
+  if (buf.failed) {
+    free(buf.bytes);
+    return MP4_WRITER_ERR_MEMORY;
+  }
+
+  free(writer->avcC);
+  writer->avcC = buf.bytes;
+  writer->avcCLen = (int) buf.len;
+
+  return 0;
+}
+
+// Tag the track with nclx color values, for example primaries 1
+// (BT.709), transfer 13 (sRGB), 8 (linear) or 1 (BT.709), matrix 1.
+
+static inline
+void mp4_writer_set_color(Mp4Writer *writer, int colorPrimaries, int transferCharacteristics, int matrixCoefficients, int fullRange) {
+  writer->hasColorTags = 1;
+  writer->colorPrimaries = colorPrimaries;
+  writer->transferCharacteristics = transferCharacteristics;
+  writer->matrixCoefficients = matrixCoefficients;
+  writer->fullRange = fullRange;
+}
+
+// Append one encoded sample, times are in the track timescale.
+// Returns 0 on success.
+
+static inline
+int mp4_writer_write_sample(Mp4Writer *writer, const uint8_t *bytes, uint32_t numBytes, int64_t dts, int64_t pts, int isKeyframe) {
+  if (writer->outFile == NULL) {
+    return MP4_WRITER_ERR_STATE;
+  }
+
+  if (writer->numSamples == writer->maxSamples) {
+    int maxSamples = (writer->maxSamples == 0) ? 256 : (writer->maxSamples * 2);
+
+    uint32_t *sizes = (uint32_t *) realloc(writer->sizes, maxSamples * sizeof(uint32_t));
+    if (sizes != NULL) {
+      writer->sizes = sizes;
+    }
+    uint64_t *offsets = (uint64_t *) realloc(writer->offsets, maxSamples * sizeof(uint64_t));
+    if (offsets != NULL) {
+      writer->offsets = offsets;
+    }
+    int64_t *dtsArr = (int64_t *) realloc(writer->dts, maxSamples * sizeof(int64_t));
+    if (dtsArr != NULL) {
+      writer->dts = dtsArr;
+    }
+    int64_t *ptsArr = (int64_t *) realloc(writer->pts, maxSamples * sizeof(int64_t));
+    if (ptsArr != NULL) {
+      writer->pts = ptsArr;
+    }
+    uint8_t *keyArr = (uint8_t *) realloc(writer->isKeyframe, maxSamples);
+    if (keyArr != NULL) {
+      writer->isKeyframe = keyArr;
+    }
+
+    if (sizes == NULL || offsets == NULL || dtsArr == NULL || ptsArr == NULL || keyArr == NULL) {
+      return MP4_WRITER_ERR_MEMORY;
+    }
+
+    writer->maxSamples = maxSamples;
+  }
+
+  if (writer->numSamples == 0) {
+    writer->firstDts = dts;
+  } else if (dts <= (writer->dts[writer->numSamples - 1] + writer->firstDts)) {
+    // Decode times must increase
+    return MP4_WRITER_ERR_STATE;
+  }
+
+  if (numBytes > 0 && fwrite(bytes, numBytes, 1, writer->outFile) != 1) {
+    return MP4_WRITER_ERR_IO;
+  }
+
+  const int i = writer->numSamples++;
+  writer->sizes[i] = numBytes;
+  writer->offsets[i] = writer->writeOffset;
+  writer->dts[i] = dts - writer->firstDts;
+  writer->pts[i] = pts - writer->firstDts;
+  writer->isKeyframe[i] = (uint8_t) (isKeyframe != 0);
+
+  writer->writeOffset += numBytes;
+
+  return 0;
+}
+
+// Emit the moov box for the samples written so far
+
+static inline
+void mp4_writer_put_moov(Mp4Writer *writer, Mp4WriterBuffer *buf, int64_t sampleDuration) {
+  const int numSamples = writer->numSamples;
+
+  // The presentation of the first frame is delayed by the reorder
+  // depth, an edit list skips this delay so playback starts at 0.
+
+  int64_t minPts = (numSamples > 0) ? writer->pts[0] : 0;
+  int64_t maxPts = minPts;
+  int needsCtts = 0;
+  int needsSigned = 0;
+  int allKeyframes = 1;
+  int needsCo64 = 0;
+
+  for (int i = 0; i < numSamples; i++) {
+    minPts = (writer->pts[i] < minPts) ? writer->pts[i] : minPts;
+    maxPts = (writer->pts[i] > maxPts) ? writer->pts[i] : maxPts;
+    if (writer->pts[i] != writer->dts[i]) {
+      needsCtts = 1;
+    }
+    if (writer->pts[i] < writer->dts[i]) {
+      needsSigned = 1;
+    }
+    if (writer->isKeyframe[i] == 0) {
+      allKeyframes = 0;
+    }
+    if (writer->offsets[i] > 0xFFFFFFFFULL) {
+      needsCo64 = 1;
+    }
+  }
+
+  const int64_t mediaDuration = (numSamples > 0) ? (writer->dts[numSamples - 1] + sampleDuration) : 0;
+  const int64_t presentationDuration = (numSamples > 0) ? ((maxPts + sampleDuration) - minPts) : 0;
+
+  uint64_t moov = mp4_writer_begin_box(buf, "moov");
+
+  // mvhd
+
+  {
+    uint64_t box = mp4_writer_begin_full_box(buf, "mvhd", 1, 0);
+    mp4_writer_put64(buf, 0);
+    mp4_writer_put64(buf, 0);
+    mp4_writer_put32(buf, writer->timescale);
+    mp4_writer_put64(buf, presentationDuration);
+    mp4_writer_put32(buf, 0x00010000);
+    mp4_writer_put16(buf, 0x0100);
+    mp4_writer_put_zeros(buf, 10);
+    // Identity matrix
+    const uint32_t matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    for (int i = 0; i < 9; i++) {
+      mp4_writer_put32(buf, matrix[i]);
+    }
+    mp4_writer_put_zeros(buf, 24);
+    // next track ID
+    mp4_writer_put32(buf, 2);
+    mp4_writer_end_box(buf, box);
+  }
+
+  uint64_t trak = mp4_writer_begin_box(buf, "trak");
+
+  // tkhd : enabled, in movie, in preview
+
+  {
+    uint64_t box = mp4_writer_begin_full_box(buf, "tkhd", 1, 0x7);
+    mp4_writer_put64(buf, 0);
+    mp4_writer_put64(buf, 0);
+    mp4_writer_put32(buf, 1);
+    mp4_writer_put32(buf, 0);
+    mp4_writer_put64(buf, presentationDuration);
+    mp4_writer_put_zeros(buf, 8);
+    mp4_writer_put16(buf, 0);
+    mp4_writer_put16(buf, 0);
+    mp4_writer_put16(buf, 0);
+    mp4_writer_put16(buf, 0);
+    const uint32_t matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    for (int i = 0; i < 9; i++) {
+      mp4_writer_put32(buf, matrix[i]);
+    }
+    mp4_writer_put32(buf, ((uint32_t) writer->width) << 16);
+    mp4_writer_put32(buf, ((uint32_t) writer->height) << 16);
+    mp4_writer_end_box(buf, box);
+  }
+
+  // edts : skip the reorder delay
+
+  if (minPts != 0) {
+    uint64_t edts = mp4_writer_begin_box(buf, "edts");
+    uint64_t box = mp4_writer_begin_full_box(buf, "elst", 1, 0);
+    mp4_writer_put32(buf, 1);
+    mp4_writer_put64(buf, presentationDuration);
+    mp4_writer_put64(buf, minPts);
+    mp4_writer_put32(buf, 0x00010000);
+    mp4_writer_end_box(buf, box);
+    mp4_writer_end_box(buf, edts);
+  }
+
+  uint64_t mdia = mp4_writer_begin_box(buf, "mdia");
+
+  {
+    uint64_t box = mp4_writer_begin_full_box(buf, "mdhd", 1, 0);
+    mp4_writer_put64(buf, 0);
+    mp4_writer_put64(buf, 0);
+    mp4_writer_put32(buf, writer->timescale);
+    mp4_writer_put64(buf, mediaDuration);
+    // "und" language
+    mp4_writer_put16(buf, 0x55C4);
+    mp4_writer_put16(buf, 0);
+    mp4_writer_end_box(buf, box);
+  }
+
+  {
+    uint64_t box = mp4_writer_begin_full_box(buf, "hdlr", 0, 0);
+    mp4_writer_put32(buf, 0);
+    mp4_writer_put_bytes(buf, "vide", 4);
+    mp4_writer_put_zeros(buf, 12);
+    mp4_writer_put_bytes(buf, "VideoHandler", 13);
+    mp4_writer_end_box(buf, box);
+  }
+
+  uint64_t minf = mp4_writer_begin_box(buf, "minf");
+
+  {
+    uint64_t box = mp4_writer_begin_full_box(buf, "vmhd", 0, 1);
+    mp4_writer_put_zeros(buf, 8);
+    mp4_writer_end_box(buf, box);
+  }
+
+  {
+    uint64_t dinf = mp4_writer_begin_box(buf, "dinf");
+    uint64_t dref = mp4_writer_begin_full_box(buf, "dref", 0, 0);
+    mp4_writer_put32(buf, 1);
+    // Self contained data reference
+    uint64_t url = mp4_writer_begin_full_box(buf, "url ", 0, 1);
+    mp4_writer_end_box(buf, url);
+    mp4_writer_end_box(buf, dref);
+    mp4_writer_end_box(buf, dinf);
+  }
+
+  uint64_t stbl = mp4_writer_begin_box(buf, "stbl");
+
+  // stsd with a single avc1 entry
+
+  {
+    uint64_t stsd = mp4_writer_begin_full_box(buf, "stsd", 0, 0);
+    mp4_writer_put32(buf, 1);
+
+    uint64_t avc1 = mp4_writer_begin_box(buf, "avc1");
+    mp4_writer_put_zeros(buf, 6);
+    // data reference index
+    mp4_writer_put16(buf, 1);
+    mp4_writer_put_zeros(buf, 16);
+    mp4_writer_put16(buf, writer->width);
+    mp4_writer_put16(buf, writer->height);
+    // 72 DPI
+    mp4_writer_put32(buf, 0x00480000);
+    mp4_writer_put32(buf, 0x00480000);
+    mp4_writer_put32(buf, 0);
+    // frame count
+    mp4_writer_put16(buf, 1);
+    // compressor name
+    mp4_writer_put_zeros(buf, 32);
+    // depth
+    mp4_writer_put16(buf, 0x0018);
+    mp4_writer_put16(buf, 0xFFFF);
+
+    uint64_t avcC = mp4_writer_begin_box(buf, "avcC");
+    mp4_writer_put_bytes(buf, writer->avcC, writer->avcCLen);
+    mp4_writer_end_box(buf, avcC);
+
+    if (writer->hasColorTags) {
+      uint64_t colr = mp4_writer_begin_box(buf, "colr");
+      mp4_writer_put_bytes(buf, "nclx", 4);
+      mp4_writer_put16(buf, writer->colorPrimaries);
+      mp4_writer_put16(buf, writer->transferCharacteristics);
+      mp4_writer_put16(buf, writer->matrixCoefficients);
+      mp4_writer_put8(buf, writer->fullRange ? 0x80 : 0);
+      mp4_writer_end_box(buf, colr);
+    }
+
+    uint64_t pasp = mp4_writer_begin_box(buf, "pasp");
+    mp4_writer_put32(buf, 1);
+    mp4_writer_put32(buf, 1);
+    mp4_writer_end_box(buf, pasp);
+
+    mp4_writer_end_box(buf, avc1);
+    mp4_writer_end_box(buf, stsd);
+  }
+
+  // stts : run length encoded decode deltas
+
+  {
+    uint64_t stts = mp4_writer_begin_full_box(buf, "stts", 0, 0);
+    uint64_t countOffset = buf->len;
+    mp4_writer_put32(buf, 0);
+
+    uint32_t numEntries = 0;
+
+    for (int i = 0; i < numSamples; ) {
+      int64_t delta = ((i + 1) < numSamples) ? (writer->dts[i + 1] - writer->dts[i]) : sampleDuration;
+      int count = 1;
+      while ((i + count) < numSamples) {
+        int j = i + count;
+        int64_t nextDelta = ((j + 1) < numSamples) ? (writer->dts[j + 1] - writer->dts[j]) : sampleDuration;
+        if (nextDelta != delta) {
+          break;
+        }
+        count++;
+      }
+      mp4_writer_put32(buf, count);
+      mp4_writer_put32(buf, (uint32_t) delta);
+      numEntries++;
+      i += count;
+    }
+
+    if (buf->failed == 0) {
+      buf->bytes[countOffset] = (uint8_t) (numEntries >> 24);
+      buf->bytes[countOffset + 1] = (uint8_t) (numEntries >> 16);
+      buf->bytes[countOffset + 2] = (uint8_t) (numEntries >> 8);
+      buf->bytes[countOffset + 3] = (uint8_t) numEntries;
+    }
+
+    mp4_writer_end_box(buf, stts);
+  }
+
+  // ctts : composition offsets, version 1 allows negative offsets
+
+  if (needsCtts) {
+    uint64_t ctts = mp4_writer_begin_full_box(buf, "ctts", needsSigned ? 1 : 0, 0);
+    uint64_t countOffset = buf->len;
+    mp4_writer_put32(buf, 0);
+
+    uint32_t numEntries = 0;
+
+    for (int i = 0; i < numSamples; ) {
+      int64_t offset = writer->pts[i] - writer->dts[i];
+      int count = 1;
+      while ((i + count) < numSamples && (writer->pts[i + count] - writer->dts[i + count]) == offset) {
+        count++;
+      }
+      mp4_writer_put32(buf, count);
+      mp4_writer_put32(buf, (uint32_t) (int32_t) offset);
+      numEntries++;
+      i += count;
+    }
+
+    if (buf->failed == 0) {
+      buf->bytes[countOffset] = (uint8_t) (numEntries >> 24);
+      buf->bytes[countOffset + 1] = (uint8_t) (numEntries >> 16);
+      buf->bytes[countOffset + 2] = (uint8_t) (numEntries >> 8);
+      buf->bytes[countOffset + 3] = (uint8_t) numEntries;
+    }
+
+    mp4_writer_end_box(buf, ctts);
+  }
+
+  // stss : omitted when every sample is a sync sample
+
+  if (allKeyframes == 0) {
+    uint32_t numKeyframes = 0;
+    for (int i = 0; i < numSamples; i++) {
+      numKeyframes += writer->isKeyframe[i];
+    }
+
+    uint64_t stss = mp4_writer_begin_full_box(buf, "stss", 0, 0);
+    mp4_writer_put32(buf, numKeyframes);
+    for (int i = 0; i < numSamples; i++) {
+      if (writer->isKeyframe[i]) {
+        mp4_writer_put32(buf, i + 1);
+      }
+    }
+    mp4_writer_end_box(buf, stss);
+  }
+
+  // stsc : one sample per chunk
+
+  {
+    uint64_t stsc = mp4_writer_begin_full_box(buf, "stsc", 0, 0);
+    mp4_writer_put32(buf, 1);
+    mp4_writer_put32(buf, 1);
+    mp4_writer_put32(buf, 1);
+    mp4_writer_put32(buf, 1);
+    mp4_writer_end_box(buf, stsc);
+  }
+
+  {
+    uint64_t stsz = mp4_writer_begin_full_box(buf, "stsz", 0, 0);
+    mp4_writer_put32(buf, 0);
+    mp4_writer_put32(buf, numSamples);
+    for (int i = 0; i < numSamples; i++) {
+      mp4_writer_put32(buf, writer->sizes[i]);
+    }
+    mp4_writer_end_box(buf, stsz);
+  }
+
+  {
+    uint64_t stco = mp4_writer_begin_full_box(buf, needsCo64 ? "co64" : "stco", 0, 0);
+    mp4_writer_put32(buf, numSamples);
+    for (int i = 0; i < numSamples; i++) {
+      if (needsCo64) {
+        mp4_writer_put64(buf, writer->offsets[i]);
+      } else {
+        mp4_writer_put32(buf, (uint32_t) writer->offsets[i]);
+      }
+    }
+    mp4_writer_end_box(buf, stco);
+  }
+
+  mp4_writer_end_box(buf, stbl);
+  mp4_writer_end_box(buf, minf);
+  mp4_writer_end_box(buf, mdia);
+  mp4_writer_end_box(buf, trak);
+  mp4_writer_end_box(buf, moov);
+}
+
+static inline
+void mp4_writer_free(Mp4Writer *writer) {
+  if (writer->outFile != NULL) {
+    fclose(writer->outFile);
+  }
+
+  free(writer->avcC);
+  free(writer->sizes);
+  free(writer->offsets);
+  free(writer->dts);
+  free(writer->pts);
+  free(writer->isKeyframe);
+
+  memset(writer, 0, sizeof(Mp4Writer));
+}
+
+// Write the moov box, patch the mdat size and close the file. The
+// duration of the final sample is sampleDuration. Returns 0 on success.
+
+static inline
+int mp4_writer_close(Mp4Writer *writer, int64_t sampleDuration) {
+  if (writer->outFile == NULL || writer->avcC == NULL) {
+    mp4_writer_free(writer);
+    return MP4_WRITER_ERR_STATE;
+  }
+
+  Mp4WriterBuffer buf;
+  memset(&buf, 0, sizeof(buf));
+
+  mp4_writer_put_moov(writer, &buf, sampleDuration);
+
+  int err = 0;
+
+  if (buf.failed) {
+    err = MP4_WRITER_ERR_MEMORY;
+  } else if (fwrite(buf.bytes, (size_t) buf.len, 1, writer->outFile) != 1) {
+    err = MP4_WRITER_ERR_IO;
+  }
+
+  free(buf.bytes);
+
+  // Patch the 64 bit mdat size
+
+  if (err == 0) {
+    uint64_t mdatSize = writer->writeOffset - writer->mdatOffset;
+    Mp4WriterBuffer sizeBuf;
+    memset(&sizeBuf, 0, sizeof(sizeBuf));
+    mp4_writer_put64(&sizeBuf, mdatSize);
+
+    if (sizeBuf.failed ||
+        fseeko(writer->outFile, (off_t) (writer->mdatOffset + 8), SEEK_SET) != 0 ||
+        fwrite(sizeBuf.bytes, 8, 1, writer->outFile) != 1) {
+      err = MP4_WRITER_ERR_IO;
+    }
+
+    free(sizeBuf.bytes);
+  }
+
+  if (fclose(writer->outFile) != 0 && err == 0) {
+    err = MP4_WRITER_ERR_IO;
+  }
+
+  writer->outFile = NULL;
+  mp4_writer_free(writer);
+
+  return err;
+}
+
+#endif // _MP4_WRITER_H
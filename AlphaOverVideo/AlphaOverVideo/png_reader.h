@@ -0,0 +1,730 @@
+//
+//  png_reader.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that reads an 8 bit PNG file into
+//  BGRA pixels, the inverse of png_writer.h. Gray, gray+alpha,
+//  RGB, RGBA and palette images are supported, interlaced images
+//  are not. Only zlib is needed, so this can be used on platforms
+//  without ImageIO. Color values are returned as stored, alpha
+//  is not premultiplied.
+//
+//  Files are mapped with mmap() and IDAT chunks are inflated one
+//  row at a time, each row is unfiltered and converted directly into
+//  the output buffer so that the whole inflated image is never held
+//  in memory. Output can be BGRA pixels or planar float R G B A.
+//  The cICP, iCCP, sRGB and gAMA chunks are parsed so that a caller
+//  can classify the colorspace without decoding the image.
+//
+//  See license.txt for license terms.
+
+#if !defined(_PNG_READER_H)
+#define _PNG_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+// Colorspace implied by the PNG chunks, in order of precedence
+// cICP then iCCP then sRGB then gAMA.
+
+typedef enum {
+  // No colorspace chunks
+  PngColorspaceUntagged = 0,
+  // sRGB chunk, cICP 1/13 or an iCCP profile named sRGB
+  PngColorspaceSRGB,
+  // gAMA of 1.0 without cHRM or cICP 1/8, sRGB primaries and linear values
+  PngColorspaceLinearSRGB,
+  // cICP with BT.709 primaries and a BT.709 transfer function
+  PngColorspaceBT709,
+  // cICP 12/13 or an iCCP profile named Display P3
+  PngColorspaceDisplayP3,
+  // Any other gAMA, iCCP profile or cICP code
+  PngColorspaceOther
+} PngColorspace;
+
+// Chunk level info, read without inflating image data
+
+typedef struct {
+  int width;
+  int height;
+  int bitDepth;
+  int colorType;
+  int interlace;
+  // Bytes per pixel in a filtered row
+  int bpp;
+  // TRUE when the image has an alpha channel or a tRNS chunk
+  int hasAlpha;
+  PngColorspace colorspace;
+  // cICP primaries, transfer, matrix and full range flag
+  int hasCICP;
+  uint8_t cicp[4];
+  // sRGB rendering intent, -1 when there is no sRGB chunk
+  int srgbIntent;
+  // gAMA value, 1/gamma times 100000, 0 when there is no gAMA chunk
+  uint32_t gamma;
+  int hasCHRM;
+  // iCCP profile name, empty when there is no iCCP chunk
+  char iccName[80];
+  // Palette with tRNS alpha applied, as BGRA pixels
+  uint32_t palette[256];
+  // Offset of the first IDAT chunk
+  size_t idatOffset;
+} PngInfo;
+
+typedef struct {
+  // BGRA pixels, width * height, 64 byte aligned
+  uint32_t *pixels;
+  int width;
+  int height;
+  // TRUE when the image has an alpha channel or a tRNS chunk
+  int hasAlpha;
+  PngColorspace colorspace;
+} PngImage;
+
+typedef enum {
+  // uint32_t BGRA pixels, alpha is not premultiplied
+  PngOutputBGRA = 0,
+  // 4 float planes R G B A, byte values divided by 255
+  PngOutputPlanarFloat
+} PngOutputFormat;
+
+typedef struct {
+  PngOutputFormat format;
+  // PngOutputBGRA : first pixel and row stride in pixels
+  uint32_t *pixels;
+  int pixelsPerRow;
+  // PngOutputPlanarFloat : R G B A planes and row stride in floats
+  float *planes[4];
+  int floatsPerRow;
+} PngOutput;
+
+// A PNG file mapped read only
+
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+} PngMappedFile;
+
+// Portable 16 byte and 4 lane vectors, supported by both clang and gcc
+
+typedef uint8_t png_uint8x16 __attribute__((vector_size(16)));
+typedef uint8_t png_uint8x4 __attribute__((vector_size(4)));
+typedef int16_t png_int16x4 __attribute__((vector_size(8)));
+
+// Rows passed to png_unfilter_row_fast() must be readable and
+// writable this many bytes past the end of the row.
+
+#define PNG_ROW_PADDING 16
+
+static inline
+uint32_t png_read_be32(const uint8_t *ptr) {
+  return ((uint32_t) ptr[0] << 24) | ((uint32_t) ptr[1] << 16) | ((uint32_t) ptr[2] << 8) | (uint32_t) ptr[3];
+}
+
+static inline
+int png_paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+
+  if (pa <= pb && pa <= pc) {
+    return a;
+  } else if (pb <= pc) {
+    return b;
+  }
+  return c;
+}
+
+// Undo the filter of one row in place, prevRow is NULL for the first row.
+// Returns 0 on success.
+
+static inline
+int png_unfilter_row(int filterType, uint8_t *row, const uint8_t *prevRow, int rowNumBytes, int bpp) {
+  switch (filterType) {
+    case 0: {
+      break;
+    }
+    case 1: {
+      for (int i = bpp; i < rowNumBytes; i++) {
+        row[i] = (uint8_t) (row[i] + row[i - bpp]);
+      }
+      break;
+    }
+    case 2: {
+      if (prevRow != NULL) {
+        for (int i = 0; i < rowNumBytes; i++) {
+          row[i] = (uint8_t) (row[i] + prevRow[i]);
+        }
+      }
+      break;
+    }
+    case 3: {
+      for (int i = 0; i < rowNumBytes; i++) {
+        int left = (i >= bpp) ? row[i - bpp] : 0;
+        int up = (prevRow != NULL) ? prevRow[i] : 0;
+        row[i] = (uint8_t) (row[i] + ((left + up) >> 1));
+      }
+      break;
+    }
+    case 4: {
+      for (int i = 0; i < rowNumBytes; i++) {
+        int left = (i >= bpp) ? row[i - bpp] : 0;
+        int up = (prevRow != NULL) ? prevRow[i] : 0;
+        int upLeft = (i >= bpp && prevRow != NULL) ? prevRow[i - bpp] : 0;
+        row[i] = (uint8_t) (row[i] + png_paeth(left, up, upLeft));
+      }
+      break;
+    }
+    default: {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Vector form of png_unfilter_row(), the output is identical. prevRow
+// must not be NULL, pass a zeroed row for the first row. Both rows need
+// PNG_ROW_PADDING bytes after the end. Up is done 16 bytes at a time.
+// Paeth depends on the pixel to the left, so for 3 and 4 byte pixels
+// each pixel is one 4 lane vector and the branches in png_paeth() become
+// lane masks. For 3 byte pixels the fourth lane is masked to zero so the
+// first byte of the next pixel is written back unchanged. Sub and Avg
+// are left to png_unfilter_row(), compilers already vectorize Sub and
+// neither was faster as 4 lane vectors.
+
+static inline
+int png_unfilter_row_fast(int filterType, uint8_t *row, const uint8_t *prevRow, int rowNumBytes, int bpp) {
+  if (filterType == 2) {
+    for (int i = 0; i < rowNumBytes; i += 16) {
+      png_uint8x16 r, u;
+      memcpy(&r, row + i, sizeof(r));
+      memcpy(&u, prevRow + i, sizeof(u));
+      r += u;
+      memcpy(row + i, &r, sizeof(r));
+    }
+    return 0;
+  }
+
+  if (filterType != 4 || (bpp != 3 && bpp != 4)) {
+    return png_unfilter_row(filterType, row, prevRow, rowNumBytes, bpp);
+  }
+
+  const png_int16x4 laneMask = { -1, -1, -1, (bpp == 4) ? -1 : 0 };
+
+  png_int16x4 a = { 0, 0, 0, 0 };
+  png_int16x4 c = { 0, 0, 0, 0 };
+
+  for (int i = 0; i < rowNumBytes; i += bpp) {
+    png_uint8x4 r, u;
+    memcpy(&r, row + i, sizeof(r));
+    memcpy(&u, prevRow + i, sizeof(u));
+    const png_int16x4 b = __builtin_convertvector(u, png_int16x4) & laneMask;
+
+    // Same tests as png_paeth() with p = a + b - c
+
+    png_int16x4 pa = b - c;
+    png_int16x4 pb = a - c;
+    png_int16x4 pc = pa + pb;
+    pa = (pa ^ (pa >> 15)) - (pa >> 15);
+    pb = (pb ^ (pb >> 15)) - (pb >> 15);
+    pc = (pc ^ (pc >> 15)) - (pc >> 15);
+
+    const png_int16x4 useA = (pa <= pb) & (pa <= pc);
+    const png_int16x4 useB = ~useA & (pb <= pc);
+    const png_int16x4 useC = ~(useA | useB);
+    const png_int16x4 predictor = (a & useA) | (b & useB) | (c & useC);
+
+    r += __builtin_convertvector(predictor, png_uint8x4);
+    memcpy(row + i, &r, sizeof(r));
+    a = __builtin_convertvector(r, png_int16x4) & laneMask;
+    c = b;
+  }
+
+  return 0;
+}
+
+// Classify the colorspace from parsed chunks
+
+static inline
+PngColorspace png_classify_colorspace(const PngInfo *info) {
+  if (info->hasCICP) {
+    const int primaries = info->cicp[0];
+    const int transfer = info->cicp[1];
+    const int fullRange = info->cicp[3];
+
+    if (!fullRange) {
+      return PngColorspaceOther;
+    } else if (primaries == 1 && transfer == 13) {
+      return PngColorspaceSRGB;
+    } else if (primaries == 1 && transfer == 8) {
+      return PngColorspaceLinearSRGB;
+    } else if (primaries == 1 && (transfer == 1 || transfer == 6 || transfer == 14 || transfer == 15)) {
+      return PngColorspaceBT709;
+    } else if (primaries == 12 && transfer == 13) {
+      return PngColorspaceDisplayP3;
+    }
+    return PngColorspaceOther;
+  }
+
+  // Profile contents are not parsed, the names written by
+  // common tools are used to detect well known profiles.
+
+  if (info->iccName[0] != '\0') {
+    if (strncmp(info->iccName, "sRGB", 4) == 0) {
+      return PngColorspaceSRGB;
+    } else if (strcmp(info->iccName, "Display P3") == 0) {
+      return PngColorspaceDisplayP3;
+    }
+    return PngColorspaceOther;
+  }
+
+  if (info->srgbIntent >= 0) {
+    return PngColorspaceSRGB;
+  }
+
+  if (info->gamma != 0) {
+    if (info->gamma == 100000 && !info->hasCHRM) {
+      return PngColorspaceLinearSRGB;
+    }
+    return PngColorspaceOther;
+  }
+
+  return PngColorspaceUntagged;
+}
+
+// Parse chunks up to the first IDAT, returns 0 on success. Image data
+// is not inflated, call png_info_is_supported() before decoding.
+
+static inline
+int png_read_info(const uint8_t *data, size_t len, PngInfo *info) {
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  memset(info, 0, sizeof(PngInfo));
+  info->colorType = -1;
+  info->srgbIntent = -1;
+
+  if (len < 8 || memcmp(data, signature, 8) != 0) {
+    return 1;
+  }
+
+  for (int i = 0; i < 256; i++) {
+    info->palette[i] = 0xFF000000;
+  }
+
+  int hasTRNS = 0;
+  size_t offset = 8;
+
+  while (offset + 12 <= len) {
+    uint32_t chunkLen = png_read_be32(data + offset);
+    const uint8_t *type = data + offset + 4;
+    const uint8_t *chunk = data + offset + 8;
+
+    if (chunkLen > len - offset - 12) {
+      return 1;
+    }
+
+    if (memcmp(type, "IHDR", 4) == 0 && chunkLen >= 13) {
+      info->width = (int) png_read_be32(chunk);
+      info->height = (int) png_read_be32(chunk + 4);
+      info->bitDepth = chunk[8];
+      info->colorType = chunk[9];
+      info->interlace = chunk[12];
+    } else if (memcmp(type, "PLTE", 4) == 0) {
+      int paletteLen = (int) (chunkLen / 3);
+      if (paletteLen > 256) {
+        paletteLen = 256;
+      }
+      for (int i = 0; i < paletteLen; i++) {
+        info->palette[i] = 0xFF000000 | (chunk[i*3] << 16) | (chunk[i*3+1] << 8) | chunk[i*3+2];
+      }
+    } else if (memcmp(type, "tRNS", 4) == 0 && info->colorType == 3) {
+      hasTRNS = 1;
+      for (int i = 0; i < (int) chunkLen && i < 256; i++) {
+        info->palette[i] = (info->palette[i] & 0x00FFFFFF) | ((uint32_t) chunk[i] << 24);
+      }
+    } else if (memcmp(type, "cICP", 4) == 0 && chunkLen == 4) {
+      info->hasCICP = 1;
+      memcpy(info->cicp, chunk, 4);
+    } else if (memcmp(type, "iCCP", 4) == 0 && chunkLen > 0) {
+      int nameLen = 0;
+      while (nameLen < (int) chunkLen && nameLen < 79 && chunk[nameLen] != '\0') {
+        nameLen++;
+      }
+      memcpy(info->iccName, chunk, nameLen);
+      info->iccName[nameLen] = '\0';
+      if (nameLen == 0) {
+        // An empty name is not valid, still record that a profile exists
+        strcpy(info->iccName, "?");
+      }
+    } else if (memcmp(type, "sRGB", 4) == 0 && chunkLen == 1) {
+      info->srgbIntent = chunk[0];
+    } else if (memcmp(type, "gAMA", 4) == 0 && chunkLen == 4) {
+      info->gamma = png_read_be32(chunk);
+    } else if (memcmp(type, "cHRM", 4) == 0) {
+      info->hasCHRM = 1;
+    } else if (memcmp(type, "IDAT", 4) == 0) {
+      info->idatOffset = offset;
+      break;
+    } else if (memcmp(type, "IEND", 4) == 0) {
+      break;
+    }
+
+    offset += 12 + chunkLen;
+  }
+
+  switch (info->colorType) {
+    case 0: info->bpp = 1; break;
+    case 2: info->bpp = 3; break;
+    case 3: info->bpp = 1; break;
+    case 4: info->bpp = 2; break;
+    case 6: info->bpp = 4; break;
+    default: break;
+  }
+
+  info->hasAlpha = (info->colorType == 4 || info->colorType == 6 || hasTRNS);
+  info->colorspace = png_classify_colorspace(info);
+
+  return 0;
+}
+
+// TRUE when png_decode_buffer() can decode the image
+
+static inline
+int png_info_is_supported(const PngInfo *info) {
+  return (info->width > 0 && info->height > 0 && info->bitDepth == 8 &&
+          info->bpp != 0 && info->interlace == 0 && info->idatOffset != 0);
+}
+
+// Convert one unfiltered row to BGRA pixels
+
+static inline
+void png_convert_row(const PngInfo *info, const uint8_t *rowBytes, uint32_t *outPtr) {
+  const int width = info->width;
+
+  switch (info->colorType) {
+    case 0: {
+      for (int col = 0; col < width; col++) {
+        const uint32_t c = rowBytes[col];
+        outPtr[col] = 0xFF000000 | (c << 16) | (c << 8) | c;
+      }
+      break;
+    }
+    case 2: {
+      for (int col = 0; col < width; col++) {
+        const uint8_t *c = rowBytes + (col * 3);
+        outPtr[col] = 0xFF000000 | (c[0] << 16) | (c[1] << 8) | c[2];
+      }
+      break;
+    }
+    case 3: {
+      for (int col = 0; col < width; col++) {
+        outPtr[col] = info->palette[rowBytes[col]];
+      }
+      break;
+    }
+    case 4: {
+      for (int col = 0; col < width; col++) {
+        const uint8_t *c = rowBytes + (col * 2);
+        outPtr[col] = ((uint32_t) c[1] << 24) | (c[0] << 16) | (c[0] << 8) | c[0];
+      }
+      break;
+    }
+    default: {
+      // RGBA bytes read as a little endian word are 0xAABBGGRR, swap R and B
+      for (int col = 0; col < width; col++) {
+        const uint8_t *c = rowBytes + (col * 4);
+        const uint32_t rgba = ((uint32_t) c[3] << 24) | ((uint32_t) c[2] << 16) | ((uint32_t) c[1] << 8) | c[0];
+        outPtr[col] = (rgba & 0xFF00FF00) | ((rgba >> 16) & 0xFF) | ((rgba & 0xFF) << 16);
+      }
+      break;
+    }
+  }
+}
+
+// Inflate and unfilter image data into output, info must come from
+// png_read_info() on the same buffer. Returns 0 on success.
+
+static inline
+int png_decode_buffer(const uint8_t *data, size_t len, const PngInfo *info, const PngOutput *output) {
+  if (!png_info_is_supported(info)) {
+    return 1;
+  }
+
+  const int width = info->width;
+  const int height = info->height;
+  const int bpp = info->bpp;
+  const size_t rowNumBytes = (size_t) width * bpp;
+
+  // Row data starts 16 byte aligned, the filter type byte is just before it
+
+  const size_t rowBufNumBytes = 16 + rowNumBytes + PNG_ROW_PADDING;
+  uint8_t *rowBufs = NULL;
+  uint32_t *bgraRow = NULL;
+
+  if (posix_memalign((void **) &rowBufs, 64, rowBufNumBytes * 2) != 0) {
+    return 1;
+  }
+
+  if (output->format == PngOutputPlanarFloat &&
+      posix_memalign((void **) &bgraRow, 64, (size_t) width * sizeof(uint32_t)) != 0) {
+    free(rowBufs);
+    return 1;
+  }
+
+  memset(rowBufs, 0, rowBufNumBytes * 2);
+
+  uint8_t *rowBuf = rowBufs;
+  uint8_t *prevBuf = rowBufs + rowBufNumBytes;
+
+  float toFloat[256];
+
+  for (int i = 0; i < 256; i++) {
+    toFloat[i] = i / 255.0f;
+  }
+
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+
+  if (inflateInit(&strm) != Z_OK) {
+    free(rowBufs);
+    free(bgraRow);
+    return 1;
+  }
+
+  int err = 0;
+  int row = 0;
+  int zresult = Z_OK;
+  size_t offset = info->idatOffset;
+
+  strm.next_out = rowBuf + 15;
+  strm.avail_out = (uInt) (rowNumBytes + 1);
+
+  while (row < height && err == 0) {
+    if (strm.avail_in == 0) {
+      // Move to the next IDAT chunk, other chunks between IDAT chunks are ignored
+
+      int foundIDAT = 0;
+
+      while (offset + 12 <= len) {
+        uint32_t chunkLen = png_read_be32(data + offset);
+        const uint8_t *type = data + offset + 4;
+
+        if (chunkLen > len - offset - 12) {
+          break;
+        }
+
+        size_t chunkOffset = offset;
+        offset += 12 + chunkLen;
+
+        if (memcmp(type, "IDAT", 4) == 0) {
+          strm.next_in = (Bytef *) (data + chunkOffset + 8);
+          strm.avail_in = chunkLen;
+          foundIDAT = 1;
+          break;
+        } else if (memcmp(type, "IEND", 4) == 0) {
+          offset = len;
+          break;
+        }
+      }
+
+      if (!foundIDAT) {
+        err = 1;
+        break;
+      }
+    }
+
+    if (zresult == Z_STREAM_END) {
+      err = 1;
+      break;
+    }
+
+    zresult = inflate(&strm, Z_NO_FLUSH);
+
+    if (zresult != Z_OK && zresult != Z_STREAM_END && zresult != Z_BUF_ERROR) {
+      err = 1;
+      break;
+    }
+
+    if (zresult == Z_BUF_ERROR && strm.avail_in != 0 && strm.avail_out != 0) {
+      // No progress possible
+      err = 1;
+      break;
+    }
+
+    if (strm.avail_out != 0) {
+      continue;
+    }
+
+    // One full row has been inflated
+
+    uint8_t *rowBytes = rowBuf + 16;
+
+    if (png_unfilter_row_fast(rowBuf[15], rowBytes, prevBuf + 16, (int) rowNumBytes, bpp) != 0) {
+      err = 1;
+      break;
+    }
+
+    if (output->format == PngOutputBGRA) {
+      png_convert_row(info, rowBytes, output->pixels + ((size_t) row * output->pixelsPerRow));
+    } else {
+      png_convert_row(info, rowBytes, bgraRow);
+
+      const size_t rowOffset = (size_t) row * output->floatsPerRow;
+      float *R = output->planes[0] + rowOffset;
+      float *G = output->planes[1] + rowOffset;
+      float *B = output->planes[2] + rowOffset;
+      float *A = output->planes[3] + rowOffset;
+
+      for (int col = 0; col < width; col++) {
+        const uint32_t pixel = bgraRow[col];
+        R[col] = toFloat[(pixel >> 16) & 0xFF];
+        G[col] = toFloat[(pixel >> 8) & 0xFF];
+        B[col] = toFloat[pixel & 0xFF];
+        A[col] = toFloat[pixel >> 24];
+      }
+    }
+
+    uint8_t *tmp = prevBuf;
+    prevBuf = rowBuf;
+    rowBuf = tmp;
+    row++;
+
+    strm.next_out = rowBuf + 15;
+    strm.avail_out = (uInt) (rowNumBytes + 1);
+  }
+
+  inflateEnd(&strm);
+  free(rowBufs);
+  free(bgraRow);
+
+  return err;
+}
+
+// Read PNG data from a buffer, returns 0 on success. The caller
+// must free image->pixels with png_image_free().
+
+static inline
+int png_read_buffer(const uint8_t *data, size_t len, PngImage *image) {
+  memset(image, 0, sizeof(PngImage));
+
+  PngInfo info;
+
+  if (png_read_info(data, len, &info) != 0) {
+    return 1;
+  }
+
+  if (!png_info_is_supported(&info)) {
+    fprintf(stderr, "unsupported PNG : %dx%d depth %d color type %d interlace %d\n",
+            info.width, info.height, info.bitDepth, info.colorType, info.interlace);
+    return 1;
+  }
+
+  uint32_t *pixels = NULL;
+
+  if (posix_memalign((void **) &pixels, 64, (size_t) info.width * info.height * sizeof(uint32_t)) != 0) {
+    return 1;
+  }
+
+  PngOutput output;
+  memset(&output, 0, sizeof(output));
+  output.format = PngOutputBGRA;
+  output.pixels = pixels;
+  output.pixelsPerRow = info.width;
+
+  if (png_decode_buffer(data, len, &info, &output) != 0) {
+    free(pixels);
+    return 1;
+  }
+
+  image->pixels = pixels;
+  image->width = info.width;
+  image->height = info.height;
+  image->hasAlpha = info.hasAlpha;
+  image->colorspace = info.colorspace;
+
+  return 0;
+}
+
+// Map a file read only, returns 0 on success
+
+static inline
+int png_map_file(const char *inFilePath, PngMappedFile *mapped) {
+  memset(mapped, 0, sizeof(PngMappedFile));
+
+  int fd = open(inFilePath, O_RDONLY);
+
+  if (fd < 0) {
+    fprintf(stderr, "could not open input PNG file \"%s\"\n", inFilePath);
+    return 1;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return 1;
+  }
+
+  void *ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (ptr == MAP_FAILED) {
+    return 1;
+  }
+
+  // Chunks are read front to back once
+
+  madvise(ptr, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+  mapped->data = (const uint8_t *) ptr;
+  mapped->len = (size_t) st.st_size;
+
+  return 0;
+}
+
+static inline
+void png_unmap_file(PngMappedFile *mapped) {
+  if (mapped->data != NULL) {
+    munmap((void *) mapped->data, mapped->len);
+  }
+  mapped->data = NULL;
+  mapped->len = 0;
+}
+
+// Read a PNG file, returns 0 on success
+
+static inline
+int png_read_file(const char *inFilePath, PngImage *image) {
+  memset(image, 0, sizeof(PngImage));
+
+  PngMappedFile mapped;
+
+  if (png_map_file(inFilePath, &mapped) != 0) {
+    return 1;
+  }
+
+  int err = png_read_buffer(mapped.data, mapped.len, image);
+  png_unmap_file(&mapped);
+
+  return err;
+}
+
+static inline
+void png_image_free(PngImage *image) {
+  free(image->pixels);
+  image->pixels = NULL;
+}
+
+#endif // _PNG_READER_H
@@ -0,0 +1,166 @@
+//
+//  png_writer.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that writes BGRA pixels
+//  to a PNG file tagged as sRGB. Only zlib is needed,
+//  so this can be used on platforms without ImageIO.
+//
+//  See license.txt for license terms.
+
+#if !defined(_PNG_WRITER_H)
+#define _PNG_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+static inline
+void png_write_be32(uint8_t *ptr, uint32_t v) {
+  ptr[0] = (v >> 24) & 0xFF;
+  ptr[1] = (v >> 16) & 0xFF;
+  ptr[2] = (v >> 8) & 0xFF;
+  ptr[3] = v & 0xFF;
+}
+
+// Emit one chunk, the CRC covers the type and data bytes
+
+static inline
+int png_write_chunk(FILE *outFile, const char *type, const uint8_t *data, uint32_t len) {
+  uint8_t header[8];
+  png_write_be32(header, len);
+  memcpy(header + 4, type, 4);
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, header + 4, 4);
+  if (len > 0) {
+    crc = crc32(crc, data, len);
+  }
+
+  uint8_t footer[4];
+  png_write_be32(footer, (uint32_t) crc);
+
+  if (fwrite(header, sizeof(header), 1, outFile) != 1) {
+    return 2;
+  }
+  if (len > 0 && fwrite(data, len, 1, outFile) != 1) {
+    return 2;
+  }
+  if (fwrite(footer, sizeof(footer), 1, outFile) != 1) {
+    return 2;
+  }
+
+  return 0;
+}
+
+// Write BGRA pixels as a 8 bit RGB or RGBA PNG. When writeAlpha
+// is FALSE the alpha component is ignored. Rows use the Sub filter
+// which compresses smooth video frames well at a low CPU cost.
+// Returns 0 on success.
+
+static inline
+int png_write_file(const char *outFilePath,
+                   const uint32_t *pixels,
+                   int pixelsPerRow,
+                   int width,
+                   int height,
+                   int writeAlpha)
+{
+  const int bpp = writeAlpha ? 4 : 3;
+  const size_t rowNumBytes = 1 + (width * bpp);
+  const size_t rawNumBytes = rowNumBytes * height;
+
+  uint8_t *raw = (uint8_t *) malloc(rawNumBytes);
+  uLongf compressedNumBytes = compressBound((uLong) rawNumBytes);
+  uint8_t *compressed = (uint8_t *) malloc(compressedNumBytes);
+
+  if (raw == NULL || compressed == NULL) {
+    free(raw);
+    free(compressed);
+    return 1;
+  }
+
+  for (int row = 0; row < height; row++) {
+    const uint32_t *rowPtr = pixels + (row * pixelsPerRow);
+    uint8_t *outPtr = raw + (row * rowNumBytes);
+
+    // Sub filter
+    *outPtr++ = 1;
+
+    uint8_t prev[4] = { 0, 0, 0, 0 };
+
+    for (int col = 0; col < width; col++) {
+      uint32_t pixel = rowPtr[col];
+      uint8_t c[4];
+      c[0] = (pixel >> 16) & 0xFF;
+      c[1] = (pixel >> 8) & 0xFF;
+      c[2] = pixel & 0xFF;
+      c[3] = (pixel >> 24) & 0xFF;
+
+      for (int i = 0; i < bpp; i++) {
+        *outPtr++ = (uint8_t) (c[i] - prev[i]);
+        prev[i] = c[i];
+      }
+    }
+  }
+
+  int result = compress2(compressed, &compressedNumBytes, raw, (uLong) rawNumBytes, 6);
+
+  free(raw);
+
+  if (result != Z_OK) {
+    free(compressed);
+    return 1;
+  }
+
+  FILE *outFile = fopen(outFilePath, "wb");
+
+  if (outFile == NULL) {
+    fprintf(stderr, "could not open output PNG file \"%s\"\n", outFilePath);
+    free(compressed);
+    return 1;
+  }
+
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  uint8_t ihdr[13];
+  png_write_be32(ihdr, width);
+  png_write_be32(ihdr + 4, height);
+  ihdr[8] = 8; // bit depth
+  ihdr[9] = writeAlpha ? 6 : 2; // RGBA or RGB
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+
+  // sRGB rendering intent : perceptual
+  uint8_t srgb[1] = { 0 };
+
+  int err = 0;
+
+  if (fwrite(signature, sizeof(signature), 1, outFile) != 1) {
+    err = 2;
+  }
+  if (err == 0) {
+    err = png_write_chunk(outFile, "IHDR", ihdr, sizeof(ihdr));
+  }
+  if (err == 0) {
+    err = png_write_chunk(outFile, "sRGB", srgb, sizeof(srgb));
+  }
+  if (err == 0) {
+    err = png_write_chunk(outFile, "IDAT", compressed, (uint32_t) compressedNumBytes);
+  }
+  if (err == 0) {
+    err = png_write_chunk(outFile, "IEND", NULL, 0);
+  }
+
+  fclose(outFile);
+  free(compressed);
+
+  return err;
+}
+
+#endif // _PNG_WRITER_H
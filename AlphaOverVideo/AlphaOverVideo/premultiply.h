@@ -0,0 +1,254 @@
+//
+//  premultiply.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface to premultiply and unpremultiply BGRA
+//  pixels on the CPU, either on the gamma encoded byte values or
+//  in linear light. Rows are processed 4 pixels at a time with a
+//  portable vector type that clang and gcc map onto NEON or SSE.
+//
+//  Byte kernels follow exact rounding contracts so that results
+//  do not depend on the platform:
+//
+//  premultiply   : C' = round(C * A / 255)
+//  unpremultiply : C = min(255, floor((C' * 255 + A / 2) / A)), 0 when A = 0
+//
+//  The unpremultiply result is the same as vImageUnpremultiplyData_BGRA8888().
+//  The divide is replaced by a multiply with a 256 entry reciprocal table.
+//
+//  See license.txt for license terms.
+
+#if !defined(_PREMULTIPLY_H)
+#define _PREMULTIPLY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sRGB.h"
+
+// Reciprocal table precision, ceil(2^24 / A) is exact for every
+// numerator C' * 255 + A / 2 that can be formed from byte values.
+
+#define PM_RECIPROCAL_SHIFT 24
+
+// Number of entries in the linear -> sRGB encode table, same
+// precision as the alpha_compositor.h table.
+
+#define PM_ENCODE_TABLE_BITS 14
+#define PM_ENCODE_TABLE_SIZE (1 << PM_ENCODE_TABLE_BITS)
+
+// Portable 4 wide vectors, supported by both clang and gcc.
+// Float components are stored in (B G R A) order to match pixel layout.
+
+typedef uint32_t pm_uint4 __attribute__((vector_size(16)));
+typedef float pm_float4 __attribute__((vector_size(16)));
+
+typedef struct {
+  // ceil(2^24 / A), zero for A = 0
+  uint32_t reciprocal[256];
+  // sRGB byte -> linear normalized float
+  float toLinear[256];
+  // A byte -> normalized float
+  float alphaNorm[256];
+  // Linear normalized float (quantized) -> sRGB byte
+  uint8_t toSRGB[PM_ENCODE_TABLE_SIZE];
+} PremultiplyTables;
+
+// Fill a 256 entry unpremultiply reciprocal table
+
+static inline
+void premultiply_reciprocal_init(uint32_t *reciprocal) {
+  reciprocal[0] = 0;
+
+  for (int A = 1; A < 256; A++) {
+    reciprocal[A] = (uint32_t) (((1u << PM_RECIPROCAL_SHIFT) + A - 1) / A);
+  }
+}
+
+static inline
+void premultiply_tables_init(PremultiplyTables *tables) {
+  premultiply_reciprocal_init(tables->reciprocal);
+
+  for (int i = 0; i < 256; i++) {
+    tables->toLinear[i] = sRGB_nonLinearNormToLinear(byteNorm(i));
+    tables->alphaNorm[i] = i / 255.0f;
+  }
+
+  for (int i = 0; i < PM_ENCODE_TABLE_SIZE; i++) {
+    float linearN = (float) i / (PM_ENCODE_TABLE_SIZE - 1);
+    int v = (int) (sRGB_linearNormToNonLinear(linearN) * 255.0f + 0.5f);
+    tables->toSRGB[i] = (uint8_t) ((v > 255) ? 255 : v);
+  }
+}
+
+// round(C * A / 255) without a divide, exact for all byte inputs
+
+static inline
+uint32_t premultiply_component(uint32_t C, uint32_t A) {
+  uint32_t t = (C * A) + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+// floor((C * 255 + A / 2) / A) clamped to 255, the caller handles A = 0
+
+static inline
+uint32_t unpremultiply_component(const uint32_t *reciprocal, uint32_t C, uint32_t A) {
+  uint64_t n = (uint64_t) ((C * 255) + (A / 2));
+  uint32_t v = (uint32_t) ((n * reciprocal[A]) >> PM_RECIPROCAL_SHIFT);
+  return (v > 255) ? 255 : v;
+}
+
+static inline
+uint32_t premultiply_pixel(uint32_t pixel) {
+  const uint32_t A = pixel >> 24;
+
+  if (A == 255) {
+    return pixel;
+  }
+
+  const uint32_t B = premultiply_component(pixel & 0xFF, A);
+  const uint32_t G = premultiply_component((pixel >> 8) & 0xFF, A);
+  const uint32_t R = premultiply_component((pixel >> 16) & 0xFF, A);
+
+  return (A << 24) | (R << 16) | (G << 8) | B;
+}
+
+static inline
+uint32_t unpremultiply_pixel(const PremultiplyTables *tables, uint32_t pixel) {
+  const uint32_t A = pixel >> 24;
+
+  if (A == 255) {
+    return pixel;
+  } else if (A == 0) {
+    return 0;
+  }
+
+  const uint32_t B = unpremultiply_component(tables->reciprocal, pixel & 0xFF, A);
+  const uint32_t G = unpremultiply_component(tables->reciprocal, (pixel >> 8) & 0xFF, A);
+  const uint32_t R = unpremultiply_component(tables->reciprocal, (pixel >> 16) & 0xFF, A);
+
+  return (A << 24) | (R << 16) | (G << 8) | B;
+}
+
+// Premultiply a row of BGRA pixels, in and out may be the same buffer.
+// Each vector holds 4 pixels, every lane computes the same rounding
+// as premultiply_component() for one channel at a time.
+
+static inline
+void premultiply_row(const uint32_t *inPixels, uint32_t *outPixels, int numPixels) {
+  int i = 0;
+
+  const pm_uint4 mask = { 0xFF, 0xFF, 0xFF, 0xFF };
+  const pm_uint4 half = { 128, 128, 128, 128 };
+
+  for ( ; (i + 4) <= numPixels; i += 4) {
+    pm_uint4 p;
+    memcpy(&p, inPixels + i, sizeof(p));
+
+    const pm_uint4 A = p >> 24;
+    pm_uint4 out = A << 24;
+
+    for (int shift = 0; shift < 24; shift += 8) {
+      pm_uint4 t = (((p >> shift) & mask) * A) + half;
+      out |= ((t + (t >> 8)) >> 8) << shift;
+    }
+
+    memcpy(outPixels + i, &out, sizeof(out));
+  }
+
+  for ( ; i < numPixels; i++) {
+    outPixels[i] = premultiply_pixel(inPixels[i]);
+  }
+}
+
+// Unpremultiply a row of BGRA pixels, in and out may be the same buffer.
+// Runs of 4 opaque pixels are copied and runs of 4 transparent pixels
+// are zeroed without a table lookup.
+
+static inline
+void unpremultiply_row(const PremultiplyTables *tables, const uint32_t *inPixels, uint32_t *outPixels, int numPixels) {
+  int i = 0;
+
+  for ( ; (i + 4) <= numPixels; i += 4) {
+    pm_uint4 p;
+    memcpy(&p, inPixels + i, sizeof(p));
+
+    const uint32_t allA = (p[0] & p[1] & p[2] & p[3]) >> 24;
+    const uint32_t anyA = (p[0] | p[1] | p[2] | p[3]) >> 24;
+
+    if (allA == 255) {
+      memmove(outPixels + i, &p, sizeof(p));
+    } else if (anyA == 0) {
+      memset(outPixels + i, 0, sizeof(p));
+    } else {
+      for (int j = 0; j < 4; j++) {
+        outPixels[i + j] = unpremultiply_pixel(tables, p[j]);
+      }
+    }
+  }
+
+  for ( ; i < numPixels; i++) {
+    outPixels[i] = unpremultiply_pixel(tables, inPixels[i]);
+  }
+}
+
+// Convert sRGB BGRA pixels that are not premultiplied to linear
+// premultiplied (B G R A) float vectors.
+
+static inline
+void premultiply_linear_row(const PremultiplyTables *tables, const uint32_t *inPixels, pm_float4 *outVecs, int numPixels) {
+  for (int i = 0; i < numPixels; i++) {
+    const uint32_t pixel = inPixels[i];
+    const float An = tables->alphaNorm[pixel >> 24];
+
+    pm_float4 v = {
+      tables->toLinear[pixel & 0xFF],
+      tables->toLinear[(pixel >> 8) & 0xFF],
+      tables->toLinear[(pixel >> 16) & 0xFF],
+      1.0f
+    };
+    pm_float4 a4 = { An, An, An, An };
+
+    outVecs[i] = v * a4;
+  }
+}
+
+// Convert linear premultiplied (B G R A) float vectors back to sRGB
+// BGRA pixels that are not premultiplied. The color is divided by
+// alpha in linear light before the sRGB curve is applied.
+
+static inline
+void unpremultiply_linear_row(const PremultiplyTables *tables, const pm_float4 *inVecs, uint32_t *outPixels, int numPixels) {
+  const float scale = (float) (PM_ENCODE_TABLE_SIZE - 1);
+
+  for (int i = 0; i < numPixels; i++) {
+    pm_float4 v = inVecs[i];
+    const float An = v[3];
+
+    int A = (int) (An * 255.0f + 0.5f);
+    A = (A < 0) ? 0 : ((A > 255) ? 255 : A);
+
+    if (A == 0) {
+      outPixels[i] = 0;
+      continue;
+    }
+
+    const float invA = 1.0f / An;
+    pm_float4 invA4 = { invA, invA, invA, 0.0f };
+    pm_float4 c = v * invA4 * scale + 0.5f;
+
+    uint32_t pixel = (uint32_t) A << 24;
+
+    for (int j = 0; j < 3; j++) {
+      int index = (int) c[j];
+      index = (index < 0) ? 0 : ((index >= PM_ENCODE_TABLE_SIZE) ? (PM_ENCODE_TABLE_SIZE - 1) : index);
+      pixel |= ((uint32_t) tables->toSRGB[index]) << (j * 8);
+    }
+
+    outPixels[i] = pixel;
+  }
+}
+
+#endif // _PREMULTIPLY_H
@@ -0,0 +1,596 @@
+//
+//  quality_metrics.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that measures how closely a decoded BT.709
+//  frame matches the source frame it was encoded from. Both frames
+//  are decoded to RGB and the error is measured in linear light,
+//  since that is the space the Metal render path blends in and a
+//  gamma encoded error understates loss in bright regions. Alpha
+//  frames are compared on the decoded alpha values.
+//
+//  Source frames can also be compared directly as BGRA pixels, in
+//  which case Y PSNR, SSIM on Y and an alpha weighted edge error are
+//  measured along with the linear RGB and alpha error. That pass is
+//  split into square tiles so that the source Y values and SSIM block
+//  sums for a tile stay in L1 cache, tiles can run on any thread.
+//
+//  See license.txt for license terms.
+
+#if !defined(_QUALITY_METRICS_H)
+#define _QUALITY_METRICS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "BT709.h"
+#include "sRGB.h"
+#include "bt709_decode.h"
+#include "premultiply.h"
+
+// PSNR reported for identical frames
+
+#define QUALITY_MAX_PSNR 100.0
+
+// Tile size of the source to decoded pass, must be a multiple of 4
+
+#define QUALITY_TILE_DIM 64
+
+// SSIM constants for 8 bit samples
+
+#define QUALITY_SSIM_C1 ((0.01 * 255) * (0.01 * 255))
+#define QUALITY_SSIM_C2 ((0.03 * 255) * (0.03 * 255))
+
+// Portable 4 wide float vector in (B G R A) order, same layout
+// as ac_float4 in alpha_compositor.h.
+
+typedef float qm_float4 __attribute__((vector_size(16)));
+
+typedef struct {
+  // Decoded byte -> linear normalized value
+  float toLinear[256];
+  // Alpha Y -> alpha byte
+  uint8_t alphaTable[256];
+  // Source R G B byte -> contribution to unrounded Y
+  float yWeights[3][256];
+  // A byte -> normalized float
+  float alphaNorm[256];
+  // Reciprocal of A used to undo premultiplication, see premultiply.h
+  uint32_t reciprocal[256];
+  // Matrix terms of BT709_convertNormalizedYCbCrToRGB() for each
+  // clamped Y Cb Cr byte, used to decode sRGB and linear frames.
+  float decodeY[256];
+  float decodeCbG[256];
+  float decodeCbB[256];
+  float decodeCrR[256];
+  float decodeCrG[256];
+  BT709Gamma gamma;
+} QualityTables;
+
+// Squared error sums over linear normalized values
+
+typedef struct {
+  // R G B
+  double sumSq[3];
+  uint64_t numPixels;
+} QualityLinearError;
+
+typedef struct {
+  double sumSq;
+  uint64_t numPixels;
+} QualityAlphaError;
+
+static inline
+void quality_tables_init(QualityTables *tables, BT709Gamma gamma) {
+  tables->gamma = gamma;
+
+  for (int i = 0; i < 256; i++) {
+    if (gamma == BT709GammaLinear) {
+      // Decoded byte values are already linear
+      tables->toLinear[i] = byteNorm(i);
+    } else {
+      // Apple gamma is decoded to sRGB by bt709_decode_pixel()
+      tables->toLinear[i] = sRGB_nonLinearNormToLinear(byteNorm(i));
+    }
+  }
+
+  bt709_decode_alpha_table(tables->alphaTable);
+
+  // Y is a weighted sum of the gamma encoded R G B values, so it
+  // can be computed from 3 tables and then rounded as in
+  // BT709_convertNonLinearRGBToYCbCr().
+
+  const float Kc[3] = { BT709_Kr, BT709_Kg, BT709_Kb };
+
+  for (int i = 0; i < 256; i++) {
+    float n = byteNorm(i);
+
+    if (gamma == BT709GammaApple) {
+      n = Apple196_linearNormToNonLinear(sRGB_nonLinearNormToLinear(n));
+    }
+
+    for (int c = 0; c < 3; c++) {
+      tables->yWeights[c][i] = Kc[c] * n * (BT709_YMax - BT709_YMin);
+    }
+
+    tables->alphaNorm[i] = i / 255.0f;
+  }
+
+  premultiply_reciprocal_init(tables->reciprocal);
+
+  // Same float products as the matrix multiply, so that the sums
+  // below round to the same bytes as bt709_decode_pixel().
+
+  const float YScale = 255.0f / (BT709_YMax - BT709_YMin);
+  const float UVScale = 255.0f / (BT709_UVMax - BT709_UVMin);
+
+  for (int i = 0; i < 256; i++) {
+    const int Y = bt709_decode_clamp(i, BT709_YMin, BT709_YMax);
+    const int UV = bt709_decode_clamp(i, BT709_UVMin, BT709_UVMax);
+    const float Yn = (Y - 16) * (1.0f / 255.0f);
+    const float UVn = (UV - 128) * (1.0f / 255.0f);
+
+    tables->decodeY[i] = Yn * YScale;
+    tables->decodeCbG[i] = UVn * (-1.0f * UVScale * BT709_Eb_minus_Ey_Range * BT709_Kb_over_Kg);
+    tables->decodeCbB[i] = UVn * (UVScale * BT709_Eb_minus_Ey_Range);
+    tables->decodeCrR[i] = UVn * (UVScale * BT709_Er_minus_Ey_Range);
+    tables->decodeCrG[i] = UVn * (-1.0f * UVScale * BT709_Er_minus_Ey_Range * BT709_Kr_over_Kg);
+  }
+}
+
+// Decode one Y Cb Cr triple to bytes, same result as bt709_decode_pixel()
+
+static inline
+void quality_decode_pixel(const QualityTables *tables, int Y, int Cb, int Cr, int *RPtr, int *GPtr, int *BPtr) {
+  if (tables->gamma == BT709GammaApple) {
+    bt709_decode_pixel(Y, Cb, Cr, tables->gamma, RPtr, GPtr, BPtr);
+    return;
+  }
+
+  const float yTerm = tables->decodeY[Y];
+
+  // Values are saturated, so adding 0.5 and truncating is the same as round()
+
+  *RPtr = (int) ((saturatef(yTerm + tables->decodeCrR[Cr]) * 255.0f) + 0.5f);
+  *GPtr = (int) ((saturatef((yTerm + tables->decodeCbG[Cb]) + tables->decodeCrG[Cr]) * 255.0f) + 0.5f);
+  *BPtr = (int) ((saturatef(yTerm + tables->decodeCbB[Cb]) * 255.0f) + 0.5f);
+}
+
+// PSNR of a mean squared error over normalized values
+
+static inline
+double quality_psnr_mse(double mse) {
+  if (mse <= 0.0) {
+    return QUALITY_MAX_PSNR;
+  }
+
+  double psnr = 10.0 * log10(1.0 / mse);
+
+  return (psnr > QUALITY_MAX_PSNR) ? QUALITY_MAX_PSNR : psnr;
+}
+
+// PSNR of a squared error sum over normalized values
+
+static inline
+double quality_psnr(double sumSq, uint64_t numSamples) {
+  if (numSamples == 0) {
+    return QUALITY_MAX_PSNR;
+  }
+
+  return quality_psnr_mse(sumSq / (double) numSamples);
+}
+
+static inline
+double quality_linear_psnr(const QualityLinearError *err) {
+  return quality_psnr(err->sumSq[0] + err->sumSq[1] + err->sumSq[2], err->numPixels * 3);
+}
+
+// Channel 0 = R, 1 = G, 2 = B
+
+static inline
+double quality_linear_channel_psnr(const QualityLinearError *err, int channel) {
+  return quality_psnr(err->sumSq[channel], err->numPixels);
+}
+
+static inline
+double quality_alpha_psnr(const QualityAlphaError *err) {
+  return quality_psnr(err->sumSq, err->numPixels);
+}
+
+// Accumulate the linear light error of one 4:2:0 frame. Rows are
+// decoded one at a time into the two rows of scratch pixels, each
+// scratch buffer must hold width pixels.
+
+static inline
+void quality_linear_error_frame(const QualityTables *tables,
+                                const uint8_t *srcY, const uint8_t *srcCb, const uint8_t *srcCr,
+                                const uint8_t *dstY, const uint8_t *dstCb, const uint8_t *dstCr,
+                                int width,
+                                int height,
+                                uint32_t *srcRow,
+                                uint32_t *dstRow,
+                                QualityLinearError *err)
+{
+  const int hw = width / 2;
+
+  for (int row = 0; row < height; row++) {
+    const int chromaOffset = (row / 2) * hw;
+
+    bt709_decode_frame(srcY + (row * width), srcCb + chromaOffset, srcCr + chromaOffset,
+                       width, 1, tables->gamma, srcRow, width);
+    bt709_decode_frame(dstY + (row * width), dstCb + chromaOffset, dstCr + chromaOffset,
+                       width, 1, tables->gamma, dstRow, width);
+
+    double sumR = 0.0;
+    double sumG = 0.0;
+    double sumB = 0.0;
+
+    for (int col = 0; col < width; col++) {
+      const uint32_t srcPixel = srcRow[col];
+      const uint32_t dstPixel = dstRow[col];
+
+      float dR = tables->toLinear[(srcPixel >> 16) & 0xFF] - tables->toLinear[(dstPixel >> 16) & 0xFF];
+      float dG = tables->toLinear[(srcPixel >> 8) & 0xFF] - tables->toLinear[(dstPixel >> 8) & 0xFF];
+      float dB = tables->toLinear[srcPixel & 0xFF] - tables->toLinear[dstPixel & 0xFF];
+
+      sumR += dR * dR;
+      sumG += dG * dG;
+      sumB += dB * dB;
+    }
+
+    err->sumSq[0] += sumR;
+    err->sumSq[1] += sumG;
+    err->sumSq[2] += sumB;
+  }
+
+  err->numPixels += (uint64_t) width * height;
+}
+
+// Accumulate the error of one alpha frame, only the Y plane is read
+
+static inline
+void quality_alpha_error_frame(const QualityTables *tables,
+                               const uint8_t *srcY,
+                               const uint8_t *dstY,
+                               int width,
+                               int height,
+                               QualityAlphaError *err)
+{
+  const int numPixels = width * height;
+  double sum = 0.0;
+
+  for (int i = 0; i < numPixels; i++) {
+    float d = (tables->alphaTable[srcY[i]] - tables->alphaTable[dstY[i]]) / 255.0f;
+    sum += d * d;
+  }
+
+  err->sumSq += sum;
+  err->numPixels += (uint64_t) numPixels;
+}
+
+// Error of a source frame compared to the decoded frame. Tiles
+// accumulate into their own stats which are merged afterwards.
+
+typedef struct {
+  // Squared Y differences in byte units
+  uint64_t ySumSq;
+  uint64_t yNumPixels;
+
+  // SSIM of 8x8 Y windows placed every 4 pixels
+  double ssimSum;
+  uint64_t ssimNumWindows;
+
+  // RGB error on linear premultiplied values
+  QualityLinearError linear;
+
+  QualityAlphaError alpha;
+
+  // Linear RGBA error weighted by 4 * A * (1 - A), so that only
+  // semi-transparent pixels contribute and A = 0.5 counts the most.
+  double edgeSumSq;
+  double edgeWeight;
+} QualityStats;
+
+// State shared by all tiles of one frame comparison
+
+typedef struct {
+  const QualityTables *tables;
+
+  // Source BGRA pixels with gamma encoded RGB that is not premultiplied
+  const uint32_t *srcPixels;
+  int srcPixelsPerRow;
+
+  // Decoded 4:2:0 planes
+  const uint8_t *dstY;
+  const uint8_t *dstCb;
+  const uint8_t *dstCr;
+
+  // Decoded Y plane of the _alpha video, NULL for an opaque video
+  const uint8_t *dstAlpha;
+
+  // TRUE when RGB values were premultiplied by alpha before
+  // encoding, as written by srgb_to_bt709 -alpha 1.
+  int isPremultiplied;
+
+  int width;
+  int height;
+} QualityFrame;
+
+// 4x4 block sums of source Y (s1) and decoded Y (s2)
+
+typedef struct {
+  int s1;
+  int s2;
+  int ss;
+  int s12;
+} QualitySSIMBlock;
+
+static inline
+void quality_stats_merge(QualityStats *stats, const QualityStats *other) {
+  stats->ySumSq += other->ySumSq;
+  stats->yNumPixels += other->yNumPixels;
+  stats->ssimSum += other->ssimSum;
+  stats->ssimNumWindows += other->ssimNumWindows;
+  for (int c = 0; c < 3; c++) {
+    stats->linear.sumSq[c] += other->linear.sumSq[c];
+  }
+  stats->linear.numPixels += other->linear.numPixels;
+  stats->alpha.sumSq += other->alpha.sumSq;
+  stats->alpha.numPixels += other->alpha.numPixels;
+  stats->edgeSumSq += other->edgeSumSq;
+  stats->edgeWeight += other->edgeWeight;
+}
+
+static inline
+double quality_stats_y_psnr(const QualityStats *stats) {
+  return quality_psnr(stats->ySumSq / (255.0 * 255.0), stats->yNumPixels);
+}
+
+static inline
+double quality_stats_ssim(const QualityStats *stats) {
+  if (stats->ssimNumWindows == 0) {
+    return 1.0;
+  }
+  return stats->ssimSum / (double) stats->ssimNumWindows;
+}
+
+// Returns QUALITY_MAX_PSNR when there are no semi-transparent pixels
+
+static inline
+double quality_stats_edge_psnr(const QualityStats *stats) {
+  if (stats->edgeWeight <= 0.0) {
+    return QUALITY_MAX_PSNR;
+  }
+  return quality_psnr_mse(stats->edgeSumSq / stats->edgeWeight);
+}
+
+// SSIM of one 8x8 window from population sums over 64 samples
+
+static inline
+double quality_ssim_window(int s1, int s2, int ss, int s12) {
+  const double N = 64.0;
+  const double C1 = QUALITY_SSIM_C1 * N * N;
+  const double C2 = QUALITY_SSIM_C2 * N * N;
+
+  const double fs1 = s1;
+  const double fs2 = s2;
+  const double vars = (N * ss) - (fs1 * fs1) - (fs2 * fs2);
+  const double covar = (N * s12) - (fs1 * fs2);
+
+  return ((2.0 * fs1 * fs2 + C1) * (2.0 * covar + C2)) /
+         (((fs1 * fs1) + (fs2 * fs2) + C1) * (vars + C2));
+}
+
+// Number of tiles needed to cover the frame
+
+static inline
+int quality_frame_num_tiles(const QualityFrame *frame) {
+  const int cols = (frame->width + QUALITY_TILE_DIM - 1) / QUALITY_TILE_DIM;
+  const int rows = (frame->height + QUALITY_TILE_DIM - 1) / QUALITY_TILE_DIM;
+  return cols * rows;
+}
+
+// Compare one tile. Tiles only read frame data, so different tiles
+// can be measured on different threads that pass their own stats.
+// SSIM windows that start inside the tile read up to 4 pixels past
+// the right and bottom edges of the tile.
+
+static inline
+void quality_measure_tile(const QualityFrame *frame,
+                          int tileIndex,
+                          QualityStats *stats)
+{
+  const QualityTables *tables = frame->tables;
+  const int width = frame->width;
+  const int height = frame->height;
+  const int hw = width / 2;
+  const int tileCols = (width + QUALITY_TILE_DIM - 1) / QUALITY_TILE_DIM;
+
+  const int x0 = (tileIndex % tileCols) * QUALITY_TILE_DIM;
+  const int y0 = (tileIndex / tileCols) * QUALITY_TILE_DIM;
+  const int x1 = (x0 + QUALITY_TILE_DIM < width) ? (x0 + QUALITY_TILE_DIM) : width;
+  const int y1 = (y0 + QUALITY_TILE_DIM < height) ? (y0 + QUALITY_TILE_DIM) : height;
+
+  // Extended region read by SSIM windows
+  const int ex1 = (x1 + 4 < width) ? (x1 + 4) : width;
+  const int ey1 = (y1 + 4 < height) ? (y1 + 4) : height;
+
+  const int srcYDim = QUALITY_TILE_DIM + 4;
+  uint8_t srcYTile[(QUALITY_TILE_DIM + 4) * (QUALITY_TILE_DIM + 4)];
+
+  const int hasAlpha = (frame->dstAlpha != NULL);
+  const qm_float4 zero4 = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+  uint64_t ySumSq = 0;
+  double edgeSumSq = 0.0;
+  double edgeWeight = 0.0;
+  double sumSq[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+  for (int row = y0; row < ey1; row++) {
+    const uint32_t *srcRow = frame->srcPixels + (row * frame->srcPixelsPerRow);
+    const uint8_t *dstYRow = frame->dstY + (row * width);
+    const uint8_t *dstCbRow = frame->dstCb + ((row / 2) * hw);
+    const uint8_t *dstCrRow = frame->dstCr + ((row / 2) * hw);
+    const uint8_t *dstAlphaRow = hasAlpha ? (frame->dstAlpha + (row * width)) : NULL;
+    uint8_t *srcYRow = srcYTile + ((row - y0) * srcYDim);
+
+    const int isInside = (row < y1);
+
+    qm_float4 rowSumSq = zero4;
+    float rowEdgeSumSq = 0.0f;
+    float rowEdgeWeight = 0.0f;
+
+    for (int col = x0; col < ex1; col++) {
+      const uint32_t srcPixel = srcRow[col];
+      int A = hasAlpha ? (srcPixel >> 24) : 255;
+      int B = srcPixel & 0xFF;
+      int G = (srcPixel >> 8) & 0xFF;
+      int R = (srcPixel >> 16) & 0xFF;
+
+      // Encoded Y of the source pixel
+
+      int pB = B;
+      int pG = G;
+      int pR = R;
+
+      if (frame->isPremultiplied && A != 255) {
+        pB = premultiply_component(B, A);
+        pG = premultiply_component(G, A);
+        pR = premultiply_component(R, A);
+      }
+
+      const float Yf = BT709_YMin + tables->yWeights[0][pR] + tables->yWeights[1][pG] + tables->yWeights[2][pB];
+      const int srcY = (int) (Yf + 0.5f);
+      srcYRow[col - x0] = (uint8_t) srcY;
+
+      if (!isInside || col >= x1) {
+        continue;
+      }
+
+      const int dstYVal = dstYRow[col];
+      const int dY = srcY - dstYVal;
+      ySumSq += (uint64_t) (dY * dY);
+
+      // Linear premultiplied source and decoded values
+
+      int dR, dG, dB;
+      quality_decode_pixel(tables, dstYVal, dstCbRow[col / 2], dstCrRow[col / 2], &dR, &dG, &dB);
+
+      int dA = hasAlpha ? tables->alphaTable[dstAlphaRow[col]] : 255;
+
+      if (frame->isPremultiplied && dA != 255) {
+        dB = (int) unpremultiply_component(tables->reciprocal, dB, dA);
+        dG = (int) unpremultiply_component(tables->reciprocal, dG, dA);
+        dR = (int) unpremultiply_component(tables->reciprocal, dR, dA);
+      }
+
+      const float An = tables->alphaNorm[A];
+      const float dAn = tables->alphaNorm[dA];
+
+      qm_float4 s = { tables->toLinear[B], tables->toLinear[G], tables->toLinear[R], 1.0f };
+      qm_float4 d = { tables->toLinear[dB], tables->toLinear[dG], tables->toLinear[dR], 1.0f };
+      qm_float4 sA = { An, An, An, An };
+      qm_float4 dA4 = { dAn, dAn, dAn, dAn };
+
+      qm_float4 diff = (s * sA) - (d * dA4);
+      qm_float4 diffSq = diff * diff;
+      rowSumSq += diffSq;
+
+      const float w = 4.0f * An * (1.0f - An);
+      rowEdgeSumSq += w * 0.25f * (diffSq[0] + diffSq[1] + diffSq[2] + diffSq[3]);
+      rowEdgeWeight += w;
+    }
+
+    for (int c = 0; c < 4; c++) {
+      sumSq[c] += rowSumSq[c];
+    }
+    edgeSumSq += rowEdgeSumSq;
+    edgeWeight += rowEdgeWeight;
+  }
+
+  const uint64_t numPixels = (uint64_t) (x1 - x0) * (y1 - y0);
+
+  stats->ySumSq += ySumSq;
+  stats->yNumPixels += numPixels;
+
+  stats->linear.sumSq[0] += sumSq[2];
+  stats->linear.sumSq[1] += sumSq[1];
+  stats->linear.sumSq[2] += sumSq[0];
+  stats->linear.numPixels += numPixels;
+
+  if (hasAlpha) {
+    stats->alpha.sumSq += sumSq[3];
+    stats->alpha.numPixels += numPixels;
+    stats->edgeSumSq += edgeSumSq;
+    stats->edgeWeight += edgeWeight;
+  }
+
+  // 4x4 block sums over the extended region, then one SSIM window
+  // for each 2x2 group of blocks that starts inside the tile.
+
+  const int blockCols = (ex1 - x0) / 4;
+  const int blockRows = (ey1 - y0) / 4;
+  QualitySSIMBlock blocks[((QUALITY_TILE_DIM / 4) + 1) * ((QUALITY_TILE_DIM / 4) + 1)];
+
+  for (int by = 0; by < blockRows; by++) {
+    for (int bx = 0; bx < blockCols; bx++) {
+      QualitySSIMBlock block = { 0, 0, 0, 0 };
+
+      for (int y = 0; y < 4; y++) {
+        const int row = y0 + (by * 4) + y;
+        const uint8_t *s1Ptr = srcYTile + ((row - y0) * srcYDim) + (bx * 4);
+        const uint8_t *s2Ptr = frame->dstY + (row * width) + x0 + (bx * 4);
+
+        for (int x = 0; x < 4; x++) {
+          const int a = s1Ptr[x];
+          const int b = s2Ptr[x];
+          block.s1 += a;
+          block.s2 += b;
+          block.ss += (a * a) + (b * b);
+          block.s12 += a * b;
+        }
+      }
+
+      blocks[(by * blockCols) + bx] = block;
+    }
+  }
+
+  double ssimSum = 0.0;
+  uint64_t ssimNumWindows = 0;
+
+  for (int by = 0; (by + 1) < blockRows && (y0 + by * 4) < y1; by++) {
+    for (int bx = 0; (bx + 1) < blockCols && (x0 + bx * 4) < x1; bx++) {
+      const QualitySSIMBlock *b0 = &blocks[(by * blockCols) + bx];
+      const QualitySSIMBlock *b1 = b0 + 1;
+      const QualitySSIMBlock *b2 = b0 + blockCols;
+      const QualitySSIMBlock *b3 = b2 + 1;
+
+      ssimSum += quality_ssim_window(b0->s1 + b1->s1 + b2->s1 + b3->s1,
+                                     b0->s2 + b1->s2 + b2->s2 + b3->s2,
+                                     b0->ss + b1->ss + b2->ss + b3->ss,
+                                     b0->s12 + b1->s12 + b2->s12 + b3->s12);
+      ssimNumWindows++;
+    }
+  }
+
+  stats->ssimSum += ssimSum;
+  stats->ssimNumWindows += ssimNumWindows;
+}
+
+// Compare all tiles on the calling thread
+
+static inline
+void quality_measure(const QualityFrame *frame,
+                     QualityStats *stats)
+{
+  const int numTiles = quality_frame_num_tiles(frame);
+
+  for (int i = 0; i < numTiles; i++) {
+    quality_measure_tile(frame, i, stats);
+  }
+}
+
+#endif // _QUALITY_METRICS_H
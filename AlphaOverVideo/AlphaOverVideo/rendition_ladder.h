@@ -0,0 +1,475 @@
+//
+//  rendition_ladder.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that scales one source frame down to several
+//  output sizes, a rendition ladder, in linear light. Each source frame
+//  is converted to linear premultiplied float once and then halved with
+//  a 2x2 box filter into a pyramid. A rendition is resampled with a
+//  separable tent filter from the smallest pyramid level that covers
+//  it, so the filter spans at most about 2 level pixels in each
+//  direction and the cost of a rendition follows its own size instead
+//  of the source size. Filter weights are computed once per size.
+//
+//  Each rendition has its own row buffers, so different renditions of
+//  the same frame can be rendered on different threads at once.
+//
+//  Input and output pixels are premultiplied BGRA with sRGB gamma
+//  encoded components, the layout of a 32 BPP CGFrameBuffer. When the
+//  frames are linear the byte values are used as is.
+//
+//  This module depends only on libc, see premultiply.h.
+//
+//  See license.txt for license terms.
+
+#if !defined(_RENDITION_LADDER_H)
+#define _RENDITION_LADDER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "premultiply.h"
+
+#define RL_MAX_RENDITIONS 8
+#define RL_MAX_LEVELS 16
+
+#define RL_ERR_SIZE 1
+#define RL_ERR_NO_MEMORY 2
+
+typedef struct {
+  int width;
+  int height;
+} RenditionSize;
+
+// Taps for one direction of a resample, output i reads maxTaps
+// inputs starting at starts[i]. Unused taps have a zero weight.
+
+typedef struct {
+  int inSize;
+  int outSize;
+  int maxTaps;
+  int *starts;
+  float *weights;
+} RenditionFilter;
+
+// Linear premultiplied (B G R A) pixels, rows are packed
+
+typedef struct {
+  pm_float4 *pixels;
+  int width;
+  int height;
+} RenditionLevel;
+
+// Horizontally filtered level rows kept for the vertical pass, the
+// window of rows for one output row always fits in maxTaps slots.
+
+typedef struct {
+  pm_float4 *rows;
+  int *rowInSlot;
+  int numSlots;
+  pm_float4 *accRow;
+} RenditionRowCache;
+
+typedef struct {
+  PremultiplyTables tables;
+
+  int srcWidth;
+  int srcHeight;
+
+  int numRenditions;
+  RenditionSize sizes[RL_MAX_RENDITIONS];
+  int levelForRendition[RL_MAX_RENDITIONS];
+  RenditionFilter hFilters[RL_MAX_RENDITIONS];
+  RenditionFilter vFilters[RL_MAX_RENDITIONS];
+
+  RenditionRowCache rowCaches[RL_MAX_RENDITIONS];
+
+  int numLevels;
+  RenditionLevel levels[RL_MAX_LEVELS];
+
+  // Source frame passed to rendition_ladder_set_source(), renditions
+  // at the source size are copied from it.
+  const uint32_t *srcPixels;
+  int srcPixelsPerRow;
+
+  // One row of straight alpha source pixels
+  uint32_t *rowPixels;
+} RenditionLadder;
+
+// Tent filter scaled to cover inSize / outSize input pixels for each
+// output pixel. Taps that fall outside the input are dropped and the
+// remaining weights are normalized, so edges are not darkened.
+
+static inline
+int rendition_filter_init(RenditionFilter *filter, int inSize, int outSize) {
+  memset(filter, 0, sizeof(RenditionFilter));
+
+  const double scale = (double) inSize / outSize;
+  const double radius = (scale > 1.0) ? scale : 1.0;
+
+  filter->inSize = inSize;
+  filter->outSize = outSize;
+  filter->maxTaps = (int) ceil(radius) * 2 + 1;
+  filter->maxTaps = (filter->maxTaps > inSize) ? inSize : filter->maxTaps;
+  filter->starts = (int *) malloc(outSize * sizeof(int));
+  filter->weights = (float *) calloc((size_t) outSize * filter->maxTaps, sizeof(float));
+
+  if (filter->starts == NULL || filter->weights == NULL) {
+    return RL_ERR_NO_MEMORY;
+  }
+
+  for (int i = 0; i < outSize; i++) {
+    const double center = ((i + 0.5) * scale) - 0.5;
+
+    int lo = (int) ceil(center - radius);
+    int hi = (int) floor(center + radius);
+
+    lo = (lo < 0) ? 0 : lo;
+    hi = (hi > (inSize - 1)) ? (inSize - 1) : hi;
+
+    // Skip zero weight taps at either end
+
+    while (lo < hi && (1.0 - fabs(lo - center) / radius) <= 0.0) {
+      lo++;
+    }
+    while (hi > lo && (1.0 - fabs(hi - center) / radius) <= 0.0) {
+      hi--;
+    }
+
+    float *weights = filter->weights + ((size_t) i * filter->maxTaps);
+    double sum = 0.0;
+
+    for (int j = lo; j <= hi; j++) {
+      double w = 1.0 - fabs(j - center) / radius;
+      w = (w > 0.0) ? w : 0.0;
+      weights[j - lo] = (float) w;
+      sum += w;
+    }
+
+    if (sum <= 0.0) {
+      // Center falls exactly between taps that are out of range
+      weights[0] = 1.0f;
+      sum = 1.0;
+    }
+
+    for (int j = lo; j <= hi; j++) {
+      weights[j - lo] = (float) (weights[j - lo] / sum);
+    }
+
+    // Taps past the end of the input keep a zero weight, shift
+    // the window left so that every tap reads a valid index.
+
+    if ((lo + filter->maxTaps) > inSize) {
+      const int shift = (lo + filter->maxTaps) - inSize;
+      const int numTaps = hi - lo + 1;
+
+      memmove(weights + shift, weights, numTaps * sizeof(float));
+      memset(weights, 0, shift * sizeof(float));
+      lo -= shift;
+    }
+
+    filter->starts[i] = lo;
+  }
+
+  return 0;
+}
+
+static inline
+void rendition_filter_free(RenditionFilter *filter) {
+  free(filter->starts);
+  free(filter->weights);
+  filter->starts = NULL;
+  filter->weights = NULL;
+}
+
+static inline
+void rendition_ladder_free(RenditionLadder *ladder) {
+  for (int i = 0; i < ladder->numRenditions; i++) {
+    rendition_filter_free(&ladder->hFilters[i]);
+    rendition_filter_free(&ladder->vFilters[i]);
+
+    RenditionRowCache *cache = &ladder->rowCaches[i];
+    free(cache->rows);
+    free(cache->rowInSlot);
+    free(cache->accRow);
+    memset(cache, 0, sizeof(RenditionRowCache));
+  }
+
+  for (int i = 0; i < ladder->numLevels; i++) {
+    free(ladder->levels[i].pixels);
+    ladder->levels[i].pixels = NULL;
+  }
+
+  free(ladder->rowPixels);
+  ladder->rowPixels = NULL;
+  ladder->numRenditions = 0;
+  ladder->numLevels = 0;
+}
+
+// Plan the pyramid and filters for frames of srcWidth x srcHeight.
+// Every rendition must be even, non zero and no larger than the
+// source. Pass isLinear when byte values are already linear.
+// Returns 0 on success.
+
+static inline
+int rendition_ladder_init(RenditionLadder *ladder,
+                          int isLinear,
+                          int srcWidth,
+                          int srcHeight,
+                          const RenditionSize *sizes,
+                          int numSizes)
+{
+  memset(ladder, 0, sizeof(RenditionLadder));
+
+  if (numSizes < 1 || numSizes > RL_MAX_RENDITIONS || srcWidth <= 0 || srcHeight <= 0) {
+    return RL_ERR_SIZE;
+  }
+
+  premultiply_tables_init(&ladder->tables);
+
+  if (isLinear) {
+    for (int i = 0; i < 256; i++) {
+      ladder->tables.toLinear[i] = i / 255.0f;
+    }
+
+    for (int i = 0; i < PM_ENCODE_TABLE_SIZE; i++) {
+      ladder->tables.toSRGB[i] = (uint8_t) ((i * 255 + (PM_ENCODE_TABLE_SIZE - 1) / 2) / (PM_ENCODE_TABLE_SIZE - 1));
+    }
+  }
+
+  ladder->srcWidth = srcWidth;
+  ladder->srcHeight = srcHeight;
+
+  int minWidth = srcWidth;
+  int minHeight = srcHeight;
+
+  for (int i = 0; i < numSizes; i++) {
+    const RenditionSize size = sizes[i];
+
+    if (size.width <= 0 || size.height <= 0 || (size.width % 2) != 0 || (size.height % 2) != 0 ||
+        size.width > srcWidth || size.height > srcHeight) {
+      return RL_ERR_SIZE;
+    }
+
+    ladder->sizes[i] = size;
+
+    minWidth = (size.width < minWidth) ? size.width : minWidth;
+    minHeight = (size.height < minHeight) ? size.height : minHeight;
+  }
+
+  // Halve while both dimensions divide evenly and the half still
+  // covers the smallest rendition.
+
+  int levelWidth = srcWidth;
+  int levelHeight = srcHeight;
+
+  while (1) {
+    RenditionLevel *level = &ladder->levels[ladder->numLevels];
+
+    level->width = levelWidth;
+    level->height = levelHeight;
+
+    if (posix_memalign((void **) &level->pixels, 64, (size_t) levelWidth * levelHeight * sizeof(pm_float4)) != 0) {
+      level->pixels = NULL;
+      rendition_ladder_free(ladder);
+      return RL_ERR_NO_MEMORY;
+    }
+
+    ladder->numLevels += 1;
+
+    if (ladder->numLevels == RL_MAX_LEVELS ||
+        (levelWidth % 2) != 0 || (levelHeight % 2) != 0 ||
+        (levelWidth / 2) < minWidth || (levelHeight / 2) < minHeight) {
+      break;
+    }
+
+    levelWidth /= 2;
+    levelHeight /= 2;
+  }
+
+  ladder->numRenditions = numSizes;
+
+  ladder->rowPixels = (uint32_t *) malloc(srcWidth * sizeof(uint32_t));
+
+  if (ladder->rowPixels == NULL) {
+    rendition_ladder_free(ladder);
+    return RL_ERR_NO_MEMORY;
+  }
+
+  for (int i = 0; i < numSizes; i++) {
+    const RenditionSize size = sizes[i];
+
+    int levelIndex = 0;
+
+    for (int l = 0; l < ladder->numLevels; l++) {
+      if (ladder->levels[l].width >= size.width && ladder->levels[l].height >= size.height) {
+        levelIndex = l;
+      }
+    }
+
+    const RenditionLevel *level = &ladder->levels[levelIndex];
+
+    ladder->levelForRendition[i] = levelIndex;
+
+    if (rendition_filter_init(&ladder->hFilters[i], level->width, size.width) != 0 ||
+        rendition_filter_init(&ladder->vFilters[i], level->height, size.height) != 0) {
+      rendition_ladder_free(ladder);
+      return RL_ERR_NO_MEMORY;
+    }
+
+    RenditionRowCache *cache = &ladder->rowCaches[i];
+
+    cache->numSlots = ladder->vFilters[i].maxTaps;
+
+    if (posix_memalign((void **) &cache->rows, 64, (size_t) cache->numSlots * size.width * sizeof(pm_float4)) != 0 ||
+        posix_memalign((void **) &cache->accRow, 64, (size_t) size.width * sizeof(pm_float4)) != 0 ||
+        (cache->rowInSlot = (int *) malloc(cache->numSlots * sizeof(int))) == NULL) {
+      rendition_ladder_free(ladder);
+      return RL_ERR_NO_MEMORY;
+    }
+  }
+
+  return 0;
+}
+
+// Convert a source frame to linear light and fill in every pyramid level
+
+static inline
+void rendition_ladder_set_source(RenditionLadder *ladder, const uint32_t *pixels, int pixelsPerRow) {
+  RenditionLevel *level0 = &ladder->levels[0];
+
+  ladder->srcPixels = pixels;
+  ladder->srcPixelsPerRow = pixelsPerRow;
+
+  for (int row = 0; row < level0->height; row++) {
+    unpremultiply_row(&ladder->tables, pixels + ((size_t) row * pixelsPerRow), ladder->rowPixels, level0->width);
+    premultiply_linear_row(&ladder->tables, ladder->rowPixels, level0->pixels + ((size_t) row * level0->width), level0->width);
+  }
+
+  const pm_float4 quarter = { 0.25f, 0.25f, 0.25f, 0.25f };
+
+  for (int l = 1; l < ladder->numLevels; l++) {
+    const RenditionLevel *in = &ladder->levels[l - 1];
+    RenditionLevel *out = &ladder->levels[l];
+
+    for (int row = 0; row < out->height; row++) {
+      const pm_float4 *row0 = in->pixels + ((size_t) (row * 2) * in->width);
+      const pm_float4 *row1 = row0 + in->width;
+      pm_float4 *outRow = out->pixels + ((size_t) row * out->width);
+
+      for (int col = 0; col < out->width; col++) {
+        outRow[col] = (row0[col * 2] + row0[(col * 2) + 1] + row1[col * 2] + row1[(col * 2) + 1]) * quarter;
+      }
+    }
+  }
+}
+
+// Filter level row into slot of the row cache unless it is already there
+
+static inline
+const pm_float4* rendition_ladder_filtered_row(const RenditionLevel *level,
+                                               const RenditionFilter *hFilter,
+                                               RenditionRowCache *cache,
+                                               int row)
+{
+  const int slot = row % cache->numSlots;
+  pm_float4 *outRow = cache->rows + ((size_t) slot * hFilter->outSize);
+
+  if (cache->rowInSlot[slot] == row) {
+    return outRow;
+  }
+
+  const pm_float4 *inRow = level->pixels + ((size_t) row * level->width);
+
+  for (int col = 0; col < hFilter->outSize; col++) {
+    const pm_float4 *in = inRow + hFilter->starts[col];
+    const float *weights = hFilter->weights + ((size_t) col * hFilter->maxTaps);
+
+    pm_float4 sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (int k = 0; k < hFilter->maxTaps; k++) {
+      sum += in[k] * weights[k];
+    }
+
+    outRow[col] = sum;
+  }
+
+  cache->rowInSlot[slot] = row;
+
+  return outRow;
+}
+
+// Resample rendition index from its pyramid level and write premultiplied
+// BGRA pixels. rendition_ladder_set_source() must be called first, calls
+// for different renditions may run on different threads.
+
+static inline
+void rendition_ladder_render(RenditionLadder *ladder, int index, uint32_t *outPixels, int outPixelsPerRow) {
+  const RenditionLevel *level = &ladder->levels[ladder->levelForRendition[index]];
+  const RenditionFilter *hFilter = &ladder->hFilters[index];
+  const RenditionFilter *vFilter = &ladder->vFilters[index];
+  RenditionRowCache *cache = &ladder->rowCaches[index];
+
+  const int outWidth = ladder->sizes[index].width;
+  const int outHeight = ladder->sizes[index].height;
+
+  if (outWidth == ladder->srcWidth && outHeight == ladder->srcHeight) {
+    // Source size is copied, no round trip through linear light
+
+    for (int row = 0; row < outHeight; row++) {
+      memcpy(outPixels + ((size_t) row * outPixelsPerRow),
+             ladder->srcPixels + ((size_t) row * ladder->srcPixelsPerRow),
+             outWidth * sizeof(uint32_t));
+    }
+
+    return;
+  }
+
+  if (outWidth == level->width && outHeight == level->height) {
+    // Pyramid level is already the rendition size
+
+    for (int row = 0; row < outHeight; row++) {
+      uint32_t *outRow = outPixels + ((size_t) row * outPixelsPerRow);
+
+      unpremultiply_linear_row(&ladder->tables, level->pixels + ((size_t) row * level->width), outRow, outWidth);
+      premultiply_row(outRow, outRow, outWidth);
+    }
+
+    return;
+  }
+
+  for (int i = 0; i < cache->numSlots; i++) {
+    cache->rowInSlot[i] = -1;
+  }
+
+  for (int row = 0; row < outHeight; row++) {
+    const float *weights = vFilter->weights + ((size_t) row * vFilter->maxTaps);
+    const int start = vFilter->starts[row];
+
+    memset(cache->accRow, 0, outWidth * sizeof(pm_float4));
+
+    for (int k = 0; k < vFilter->maxTaps; k++) {
+      const float w = weights[k];
+
+      if (w == 0.0f) {
+        continue;
+      }
+
+      const pm_float4 *inRow = rendition_ladder_filtered_row(level, hFilter, cache, start + k);
+
+      for (int col = 0; col < outWidth; col++) {
+        cache->accRow[col] += inRow[col] * w;
+      }
+    }
+
+    uint32_t *outRow = outPixels + ((size_t) row * outPixelsPerRow);
+
+    unpremultiply_linear_row(&ladder->tables, cache->accRow, outRow, outWidth);
+    premultiply_row(outRow, outRow, outWidth);
+  }
+}
+
+#endif // _RENDITION_LADDER_H
@@ -0,0 +1,344 @@
+//
+//  rendition_manifest.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only parser for a rendition manifest, a text file that
+//  lists the same clip encoded at several sizes, and the logic that
+//  picks which rendition to play for a given view size.
+//
+//  Each line holds the pixel size, the bitrate in kbps, the RGB
+//  video and for alpha clips the _alpha video. Lines that start
+//  with # are comments and paths cannot contain spaces.
+//
+//  # Example renditions
+//  2048x1536 8000 Example_2048x1536.m4v Example_2048x1536_alpha.m4v
+//  1024x768 3000 Example_1024x768.m4v Example_1024x768_alpha.m4v
+//
+//  See license.txt for license terms.
+
+#if !defined(_RENDITION_MANIFEST_H)
+#define _RENDITION_MANIFEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define RM_MAX_RENDITIONS 16
+#define RM_MAX_PATH 1024
+
+// Largest manifest file that will be read
+
+#define RM_MAX_FILE_SIZE (64 * 1024)
+
+// Error codes, 0 indicates success
+
+#define RM_ERR_IO 1
+#define RM_ERR_SYNTAX 2
+#define RM_ERR_SIZE 3
+#define RM_ERR_TOO_MANY 4
+#define RM_ERR_MIXED_ALPHA 5
+#define RM_ERR_EMPTY 6
+
+typedef struct {
+  int width;
+  int height;
+  int bitrateKbps;
+  char rgbPath[RM_MAX_PATH];
+  // Empty string when the clip has no alpha channel
+  char alphaPath[RM_MAX_PATH];
+} RenditionEntry;
+
+typedef struct {
+  RenditionEntry renditions[RM_MAX_RENDITIONS];
+  int numRenditions;
+  int hasAlpha;
+  // 1 based line number of the first error
+  int errorLine;
+} RenditionManifest;
+
+// Parse a positive decimal integer that ends at endChar, returns
+// the number of characters consumed or 0 on error.
+
+static inline
+int rendition_manifest_parse_int(const char *str, char endChar, int *valPtr) {
+  int i = 0;
+  int64_t val = 0;
+
+  while (isdigit((unsigned char) str[i])) {
+    val = (val * 10) + (str[i] - '0');
+    if (val > 0x7FFFFFFF) {
+      return 0;
+    }
+    i++;
+  }
+
+  if (i == 0 || str[i] != endChar || val == 0) {
+    return 0;
+  }
+
+  *valPtr = (int) val;
+  return i;
+}
+
+// Parse one line with the given length, blank and comment lines
+// leave the manifest unchanged. Returns 0 on success.
+
+static inline
+int rendition_manifest_parse_line(const char *line, int len, RenditionManifest *manifest) {
+  // Split into at most 5 whitespace separated tokens
+
+  char tokens[5][RM_MAX_PATH];
+  int numTokens = 0;
+  int i = 0;
+
+  while (1) {
+    while (i < len && isspace((unsigned char) line[i])) {
+      i++;
+    }
+
+    if (i == len || (numTokens == 0 && line[i] == '#')) {
+      break;
+    }
+
+    if (numTokens == 5) {
+      return RM_ERR_SYNTAX;
+    }
+
+    int start = i;
+
+    while (i < len && !isspace((unsigned char) line[i])) {
+      i++;
+    }
+
+    if ((i - start) >= RM_MAX_PATH) {
+      return RM_ERR_SYNTAX;
+    }
+
+    memcpy(tokens[numTokens], line + start, i - start);
+    tokens[numTokens][i - start] = '\0';
+    numTokens += 1;
+  }
+
+  if (numTokens == 0) {
+    return 0;
+  }
+
+  if (numTokens < 3 || numTokens > 4) {
+    return RM_ERR_SYNTAX;
+  }
+
+  if (manifest->numRenditions == RM_MAX_RENDITIONS) {
+    return RM_ERR_TOO_MANY;
+  }
+
+  RenditionEntry *entry = &manifest->renditions[manifest->numRenditions];
+  memset(entry, 0, sizeof(RenditionEntry));
+
+  int n = rendition_manifest_parse_int(tokens[0], 'x', &entry->width);
+
+  if (n == 0 || rendition_manifest_parse_int(tokens[0] + n + 1, '\0', &entry->height) == 0) {
+    return RM_ERR_SYNTAX;
+  }
+
+  if (rendition_manifest_parse_int(tokens[1], '\0', &entry->bitrateKbps) == 0) {
+    return RM_ERR_SYNTAX;
+  }
+
+  // 4:2:0 video needs even dimensions
+
+  if ((entry->width & 0x1) || (entry->height & 0x1)) {
+    return RM_ERR_SIZE;
+  }
+
+  strcpy(entry->rgbPath, tokens[2]);
+
+  const int hasAlpha = (numTokens == 4);
+
+  if (hasAlpha) {
+    strcpy(entry->alphaPath, tokens[3]);
+  }
+
+  if (manifest->numRenditions > 0 && hasAlpha != manifest->hasAlpha) {
+    return RM_ERR_MIXED_ALPHA;
+  }
+
+  manifest->hasAlpha = hasAlpha;
+  manifest->numRenditions += 1;
+
+  return 0;
+}
+
+// Parse len bytes of manifest text. Returns 0 on success, on error
+// manifest->errorLine is the line that could not be parsed.
+
+static inline
+int rendition_manifest_parse(const char *text, size_t len, RenditionManifest *manifest) {
+  memset(manifest, 0, sizeof(RenditionManifest));
+
+  size_t offset = 0;
+  int lineNum = 0;
+
+  while (offset < len) {
+    size_t end = offset;
+
+    while (end < len && text[end] != '\n') {
+      end++;
+    }
+
+    lineNum += 1;
+
+    int err = rendition_manifest_parse_line(text + offset, (int) (end - offset), manifest);
+
+    if (err != 0) {
+      manifest->errorLine = lineNum;
+      return err;
+    }
+
+    offset = end + 1;
+  }
+
+  if (manifest->numRenditions == 0) {
+    return RM_ERR_EMPTY;
+  }
+
+  return 0;
+}
+
+static inline
+int rendition_manifest_read_file(const char *path, RenditionManifest *manifest) {
+  memset(manifest, 0, sizeof(RenditionManifest));
+
+  FILE *inFile = fopen(path, "rb");
+
+  if (inFile == NULL) {
+    return RM_ERR_IO;
+  }
+
+  char *text = (char *) malloc(RM_MAX_FILE_SIZE);
+  size_t len = fread(text, 1, RM_MAX_FILE_SIZE, inFile);
+  int isTooLarge = (fgetc(inFile) != EOF);
+
+  fclose(inFile);
+
+  int err = isTooLarge ? RM_ERR_IO : rendition_manifest_parse(text, len, manifest);
+
+  free(text);
+
+  return err;
+}
+
+// Return the index of the rendition to play in a view of the given
+// pixel size. This is the smallest rendition at least as large as
+// the view in both dimensions, or the largest rendition when none
+// is that large. A zero view size means the size is not known yet
+// and also picks the largest. Renditions over maxBitrateKbps are
+// skipped unless all of them are over, in which case the lowest
+// bitrate is used. Pass 0 for no bitrate limit. Equal sizes prefer
+// the higher bitrate.
+
+static inline
+int rendition_manifest_select(const RenditionManifest *manifest, int viewWidth, int viewHeight, int maxBitrateKbps) {
+  const int n = manifest->numRenditions;
+
+  int lowestBitrate = 0;
+
+  for (int i = 1; i < n; i++) {
+    if (manifest->renditions[i].bitrateKbps < manifest->renditions[lowestBitrate].bitrateKbps) {
+      lowestBitrate = i;
+    }
+  }
+
+  const int isSizeKnown = (viewWidth > 0 && viewHeight > 0);
+
+  int smallestCovering = -1;
+  int largest = -1;
+
+  for (int i = 0; i < n; i++) {
+    const RenditionEntry *entry = &manifest->renditions[i];
+
+    if (maxBitrateKbps > 0 && entry->bitrateKbps > maxBitrateKbps) {
+      continue;
+    }
+
+    const int64_t area = (int64_t) entry->width * entry->height;
+
+    if (largest == -1) {
+      largest = i;
+    } else {
+      const RenditionEntry *other = &manifest->renditions[largest];
+      const int64_t otherArea = (int64_t) other->width * other->height;
+
+      if (area > otherArea || (area == otherArea && entry->bitrateKbps > other->bitrateKbps)) {
+        largest = i;
+      }
+    }
+
+    if (isSizeKnown && entry->width >= viewWidth && entry->height >= viewHeight) {
+      if (smallestCovering == -1) {
+        smallestCovering = i;
+      } else {
+        const RenditionEntry *other = &manifest->renditions[smallestCovering];
+        const int64_t otherArea = (int64_t) other->width * other->height;
+
+        if (area < otherArea || (area == otherArea && entry->bitrateKbps > other->bitrateKbps)) {
+          smallestCovering = i;
+        }
+      }
+    }
+  }
+
+  if (smallestCovering != -1) {
+    return smallestCovering;
+  } else if (largest != -1) {
+    return largest;
+  } else {
+    return lowestBitrate;
+  }
+}
+
+// Fill levels with the index of the selected rendition followed by
+// each smaller rendition, largest area first. Level N is the
+// rendition played when a decode budget moves a player N steps below
+// the rendition that fits its view. Returns the number of levels.
+
+static inline
+int rendition_manifest_levels(const RenditionManifest *manifest, int selected, int *levels, int maxLevels) {
+  int numLevels = 0;
+
+  if (maxLevels < 1) {
+    return 0;
+  }
+
+  levels[numLevels++] = selected;
+
+  while (numLevels < maxLevels) {
+    const RenditionEntry *prev = &manifest->renditions[levels[numLevels - 1]];
+    const int64_t prevArea = (int64_t) prev->width * prev->height;
+
+    int next = -1;
+    int64_t nextArea = 0;
+
+    for (int i = 0; i < manifest->numRenditions; i++) {
+      const RenditionEntry *entry = &manifest->renditions[i];
+      const int64_t area = (int64_t) entry->width * entry->height;
+
+      if (area < prevArea && (next == -1 || area > nextArea)) {
+        next = i;
+        nextArea = area;
+      }
+    }
+
+    if (next == -1) {
+      break;
+    }
+
+    levels[numLevels++] = next;
+  }
+
+  return numLevels;
+}
+
+#endif // _RENDITION_MANIFEST_H
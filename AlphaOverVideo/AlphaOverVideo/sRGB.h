@@ -13,6 +13,10 @@
 #if !defined(_SRGB_H)
 #define _SRGB_H
 
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
 // saturate limits the range to [0.0, 1.0]
 
 static inline
@@ -0,0 +1,324 @@
+//
+//  x264_backend.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Encoder backend that passes BT.709 YCbCr frames directly to
+//  libx264 and muxes the compressed samples into an .m4v file with
+//  mp4_writer.h. This replaces writing an intermediate Y4M file and
+//  then running one of the FFMPEG/ext_ffmpeg_encode_*_crf.sh scripts,
+//  the defaults and color tags match those scripts. Only compiled
+//  when AOV_HAVE_X264 is defined and libx264 is linked.
+//
+//  See license.txt for license terms.
+
+#if !defined(_X264_BACKEND_H)
+#define _X264_BACKEND_H
+
+#if defined(AOV_HAVE_X264)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <x264.h>
+
+#include "ycbcr_encoder.h"
+#include "mp4_writer.h"
+
+// ISO/IEC 23001-8 values written to both the SPS VUI and the colr box
+
+#define X264_BACKEND_PRIMARIES_BT709 1
+#define X264_BACKEND_TRANSFER_BT709 1
+#define X264_BACKEND_TRANSFER_LINEAR 8
+#define X264_BACKEND_TRANSFER_SRGB 13
+#define X264_BACKEND_MATRIX_BT709 1
+
+typedef struct {
+  const char *outPath;
+
+  // Same defaults as the ffmpeg scripts
+  int crf;
+  const char *profile;
+  const char *preset;
+  const char *tune;
+
+  YCbCrEncoderConfig config;
+  x264_t *encoder;
+  x264_picture_t picIn;
+  Mp4Writer writer;
+
+  // Duration of one frame in mp4 timescale units
+  int frameTicks;
+  int64_t frameNum;
+} YCbCrX264BackendContext;
+
+// Map the gamma the frames were encoded with to a transfer tag,
+// "apple" gamma is tagged as BT.709 just like the bt709 script.
+
+static inline
+int x264_backend_transfer(BT709Gamma gamma) {
+  switch (gamma) {
+    case BT709GammaSrgb:
+      return X264_BACKEND_TRANSFER_SRGB;
+    case BT709GammaLinear:
+      return X264_BACKEND_TRANSFER_LINEAR;
+    default:
+      return X264_BACKEND_TRANSFER_BT709;
+  }
+}
+
+// Append the NALs output for one frame as a single sample
+
+static inline
+int x264_backend_write_nals(YCbCrX264BackendContext *x264Ctx, x264_nal_t *nals, int frameSize, const x264_picture_t *picOut) {
+  if (frameSize <= 0) {
+    return 0;
+  }
+
+  // With b_annexb disabled each NAL payload begins with a 4 byte
+  // length and the payloads of one frame are contiguous.
+
+  const int64_t ticks = x264Ctx->frameTicks;
+
+  return mp4_writer_write_sample(&x264Ctx->writer,
+                                 nals[0].p_payload,
+                                 (uint32_t) frameSize,
+                                 picOut->i_dts * ticks,
+                                 picOut->i_pts * ticks,
+                                 picOut->b_keyframe);
+}
+
+static inline
+int x264_backend_open(void *ctx, const YCbCrEncoderConfig *config) {
+  YCbCrX264BackendContext *x264Ctx = (YCbCrX264BackendContext *) ctx;
+
+  if ((config->width % 2) != 0 || (config->height % 2) != 0) {
+    return 1;
+  }
+
+  x264Ctx->config = *config;
+
+  int fpsNum, fpsDen;
+  y4m_fps_fraction(config->fps, &fpsNum, &fpsDen);
+
+  x264_param_t param;
+
+  if (x264_param_default_preset(&param, x264Ctx->preset, x264Ctx->tune) < 0) {
+    fprintf(stderr, "x264 unknown preset \"%s\" or tune \"%s\"\n", x264Ctx->preset, x264Ctx->tune);
+    return 1;
+  }
+
+  param.i_csp = X264_CSP_I420;
+  param.i_width = config->width;
+  param.i_height = config->height;
+  param.i_fps_num = fpsNum;
+  param.i_fps_den = fpsDen;
+  param.i_timebase_num = fpsDen;
+  param.i_timebase_den = fpsNum;
+  param.b_vfr_input = 0;
+
+  param.rc.i_rc_method = X264_RC_CRF;
+  param.rc.f_rf_constant = (float) x264Ctx->crf;
+
+  // -color_primaries bt709 -colorspace bt709 -color_trc ...
+
+  param.vui.i_colorprim = X264_BACKEND_PRIMARIES_BT709;
+  param.vui.i_transfer = x264_backend_transfer(config->gamma);
+  param.vui.i_colmatrix = X264_BACKEND_MATRIX_BT709;
+  param.vui.b_fullrange = 0;
+
+  // Length prefixed NALs, SPS and PPS are stored once in avcC
+
+  param.b_annexb = 0;
+  param.b_repeat_headers = 0;
+
+  if (x264_param_apply_profile(&param, x264Ctx->profile) < 0) {
+    fprintf(stderr, "x264 unknown profile \"%s\"\n", x264Ctx->profile);
+    return 1;
+  }
+
+  x264Ctx->encoder = x264_encoder_open(&param);
+
+  if (x264Ctx->encoder == NULL) {
+    return 1;
+  }
+
+  // 600 is evenly divisible by the integer frame rates, 29.97
+  // uses a 30000 timescale so that each frame is 1001 ticks.
+
+  uint32_t timescale;
+
+  if (fpsDen == 1 && (600 % fpsNum) == 0) {
+    timescale = 600;
+    x264Ctx->frameTicks = 600 / fpsNum;
+  } else {
+    timescale = (uint32_t) fpsNum;
+    x264Ctx->frameTicks = fpsDen;
+  }
+
+  if (mp4_writer_open(&x264Ctx->writer, x264Ctx->outPath, config->width, config->height, timescale) != 0) {
+    fprintf(stderr, "could not open output file \"%s\"\n", x264Ctx->outPath);
+    return 1;
+  }
+
+  mp4_writer_set_color(&x264Ctx->writer,
+                       param.vui.i_colorprim,
+                       param.vui.i_transfer,
+                       param.vui.i_colmatrix,
+                       param.vui.b_fullrange);
+
+  x264_nal_t *nals;
+  int numNals;
+
+  if (x264_encoder_headers(x264Ctx->encoder, &nals, &numNals) < 0) {
+    return 1;
+  }
+
+  const uint8_t *sps = NULL;
+  const uint8_t *pps = NULL;
+  int spsLen = 0;
+  int ppsLen = 0;
+
+  for (int i = 0; i < numNals; i++) {
+    // Skip the 4 byte length prefix
+    if (nals[i].i_type == NAL_SPS) {
+      sps = nals[i].p_payload + 4;
+      spsLen = nals[i].i_payload - 4;
+    } else if (nals[i].i_type == NAL_PPS) {
+      pps = nals[i].p_payload + 4;
+      ppsLen = nals[i].i_payload - 4;
+    }
+  }
+
+  if (sps == NULL || pps == NULL) {
+    return 1;
+  }
+
+  if (mp4_writer_set_avcc(&x264Ctx->writer, sps, spsLen, pps, ppsLen) != 0) {
+    return 1;
+  }
+
+  x264_picture_init(&x264Ctx->picIn);
+  x264Ctx->picIn.img.i_csp = X264_CSP_I420;
+  x264Ctx->picIn.img.i_plane = 3;
+
+  return 0;
+}
+
+static inline
+int x264_backend_write_frame(void *ctx, const YCbCrEncoderFrame *frame) {
+  YCbCrX264BackendContext *x264Ctx = (YCbCrX264BackendContext *) ctx;
+
+  const int width = x264Ctx->config.width;
+  const int height = x264Ctx->config.height;
+
+  // x264 reads planar chroma with any stride, interleaved chroma
+  // is split into a temporary buffer first.
+
+  uint8_t *chromaPlanes = NULL;
+
+  x264_picture_t *picIn = &x264Ctx->picIn;
+
+  picIn->img.plane[0] = (uint8_t *) frame->yPtr;
+  picIn->img.i_stride[0] = frame->yBytesPerRow;
+
+  if (frame->cbcrPtr != NULL) {
+    const int chromaWidth = width / 2;
+    const int chromaHeight = height / 2;
+    const int chromaNumBytes = chromaWidth * chromaHeight;
+
+    chromaPlanes = (uint8_t *) malloc(chromaNumBytes * 2);
+
+    if (chromaPlanes == NULL) {
+      return 1;
+    }
+
+    ycbcr_encoder_split_chroma(frame, chromaWidth, chromaHeight, chromaPlanes, chromaPlanes + chromaNumBytes);
+
+    picIn->img.plane[1] = chromaPlanes;
+    picIn->img.plane[2] = chromaPlanes + chromaNumBytes;
+    picIn->img.i_stride[1] = chromaWidth;
+    picIn->img.i_stride[2] = chromaWidth;
+  } else {
+    picIn->img.plane[1] = (uint8_t *) frame->cbPtr;
+    picIn->img.plane[2] = (uint8_t *) frame->crPtr;
+    picIn->img.i_stride[1] = frame->chromaBytesPerRow;
+    picIn->img.i_stride[2] = frame->chromaBytesPerRow;
+  }
+
+  picIn->i_pts = x264Ctx->frameNum++;
+
+  x264_nal_t *nals;
+  int numNals;
+  x264_picture_t picOut;
+
+  int frameSize = x264_encoder_encode(x264Ctx->encoder, &nals, &numNals, picIn, &picOut);
+
+  free(chromaPlanes);
+
+  if (frameSize < 0) {
+    return 1;
+  }
+
+  return x264_backend_write_nals(x264Ctx, nals, frameSize, &picOut);
+}
+
+static inline
+int x264_backend_close(void *ctx) {
+  YCbCrX264BackendContext *x264Ctx = (YCbCrX264BackendContext *) ctx;
+
+  int err = 0;
+
+  if (x264Ctx->encoder != NULL) {
+    // Flush frames held back for lookahead and B frame reordering
+
+    while (err == 0 && x264_encoder_delayed_frames(x264Ctx->encoder) > 0) {
+      x264_nal_t *nals;
+      int numNals;
+      x264_picture_t picOut;
+
+      int frameSize = x264_encoder_encode(x264Ctx->encoder, &nals, &numNals, NULL, &picOut);
+
+      if (frameSize < 0) {
+        err = 1;
+      } else {
+        err = x264_backend_write_nals(x264Ctx, nals, frameSize, &picOut);
+      }
+    }
+
+    x264_encoder_close(x264Ctx->encoder);
+    x264Ctx->encoder = NULL;
+  }
+
+  if (err == 0) {
+    err = mp4_writer_close(&x264Ctx->writer, x264Ctx->frameTicks);
+  } else {
+    mp4_writer_free(&x264Ctx->writer);
+  }
+
+  return err;
+}
+
+// Define a backend that encodes frames to the .m4v file at outPath,
+// the context must remain valid until the backend is closed.
+
+static inline
+void x264_backend_init(YCbCrEncoderBackend *backend, YCbCrX264BackendContext *ctx, const char *outPath) {
+  memset(ctx, 0, sizeof(YCbCrX264BackendContext));
+  ctx->outPath = outPath;
+  ctx->crf = 23;
+  ctx->profile = "main";
+  ctx->preset = "slow";
+  ctx->tune = "animation";
+
+  backend->ctx = ctx;
+  backend->open = x264_backend_open;
+  backend->write_frame = x264_backend_write_frame;
+  backend->close = x264_backend_close;
+}
+
+#endif // AOV_HAVE_X264
+
+#endif // _X264_BACKEND_H
@@ -0,0 +1,254 @@
+//
+//  y4m_reader.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Header only interface that supports reading
+//  a Y4M file that contains tagged YUV bytes
+//  in 4:2:0 format, as written by y4m_writer.h.
+//  Frames are a fixed size, so any frame can be
+//  read directly without scanning the whole file.
+//
+//  See license.txt for license terms.
+
+#if !defined(_Y4M_READER_H)
+#define _Y4M_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "y4m_writer.h"
+
+// Longest header line that will be parsed
+
+#define Y4M_READER_MAX_LINE 1024
+
+typedef struct {
+  FILE *inFile;
+
+  int width;
+  int height;
+
+  // Framerate as a fraction, 30000:1001 = 29.97 FPS
+  int fpsNum;
+  int fpsDen;
+
+  // Offset of the first "FRAME" marker
+  long firstFrameOffset;
+
+  // Number of bytes in one frame, including the "FRAME\n" marker
+  long frameNumBytes;
+
+  int numFrames;
+
+  int yLen;
+  int uvLen;
+} Y4MReaderStruct;
+
+// Read one newline terminated line, returns the line length
+// without the newline or -1 on EOF or when line is too long.
+
+static inline
+int y4m_read_line(FILE *inFile, char *line, int maxLen) {
+  int len = 0;
+
+  while (1) {
+    int c = fgetc(inFile);
+    if (c == EOF) {
+      return -1;
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (len == (maxLen - 1)) {
+      return -1;
+    }
+    line[len++] = (char) c;
+  }
+
+  line[len] = '\0';
+  return len;
+}
+
+// Open Y4M file and parse the header. Only 4:2:0 progressive input
+// is supported. Returns 0 on success.
+
+static inline
+int y4m_open_reader(const char *inFilePath, Y4MReaderStruct *rsPtr) {
+  memset(rsPtr, 0, sizeof(Y4MReaderStruct));
+
+  FILE *inFile = fopen(inFilePath, "rb");
+
+  if (inFile == NULL) {
+    fprintf(stderr, "could not open input Y4M file \"%s\"\n", inFilePath);
+    return 1;
+  }
+
+  rsPtr->inFile = inFile;
+  rsPtr->fpsNum = 30;
+  rsPtr->fpsDen = 1;
+
+  char line[Y4M_READER_MAX_LINE];
+
+  int lineLen = y4m_read_line(inFile, line, sizeof(line));
+
+  if (lineLen < 0 || strncmp(line, "YUV4MPEG2 ", 10) != 0) {
+    fprintf(stderr, "invalid Y4M header in \"%s\"\n", inFilePath);
+    fclose(inFile);
+    rsPtr->inFile = NULL;
+    return 2;
+  }
+
+  // Parse space separated tags
+
+  char *savePtr = NULL;
+
+  for (char *tag = strtok_r(line + 10, " ", &savePtr); tag != NULL; tag = strtok_r(NULL, " ", &savePtr)) {
+    switch (tag[0]) {
+      case 'W': {
+        rsPtr->width = atoi(tag + 1);
+        break;
+      }
+      case 'H': {
+        rsPtr->height = atoi(tag + 1);
+        break;
+      }
+      case 'F': {
+        int num, den;
+        if (sscanf(tag + 1, "%d:%d", &num, &den) == 2 && num > 0 && den > 0) {
+          rsPtr->fpsNum = num;
+          rsPtr->fpsDen = den;
+        }
+        break;
+      }
+      case 'I': {
+        if (tag[1] != 'p' && tag[1] != '?') {
+          fprintf(stderr, "interlaced Y4M input is not supported\n");
+          fclose(inFile);
+          rsPtr->inFile = NULL;
+          return 2;
+        }
+        break;
+      }
+      case 'C': {
+        if (strncmp(tag + 1, "420", 3) != 0) {
+          fprintf(stderr, "Y4M colorspace \"%s\" is not supported, must be 4:2:0\n", tag + 1);
+          fclose(inFile);
+          rsPtr->inFile = NULL;
+          return 2;
+        }
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  if (rsPtr->width <= 0 || rsPtr->height <= 0 || (rsPtr->width % 2) != 0 || (rsPtr->height % 2) != 0) {
+    fprintf(stderr, "invalid Y4M dimensions %d x %d\n", rsPtr->width, rsPtr->height);
+    fclose(inFile);
+    rsPtr->inFile = NULL;
+    return 2;
+  }
+
+  // y4m_writer.h emits an extra comment line after the header,
+  // skip any lines that appear before the first FRAME marker.
+
+  while (1) {
+    long offset = ftell(inFile);
+    lineLen = y4m_read_line(inFile, line, sizeof(line));
+    if (lineLen < 0) {
+      // No frames
+      rsPtr->firstFrameOffset = offset;
+      break;
+    }
+    if (strncmp(line, "FRAME", 5) == 0) {
+      rsPtr->firstFrameOffset = offset;
+      break;
+    }
+  }
+
+  rsPtr->yLen = rsPtr->width * rsPtr->height;
+  rsPtr->uvLen = (rsPtr->width / 2) * (rsPtr->height / 2);
+  rsPtr->frameNumBytes = 6 + rsPtr->yLen + (2 * rsPtr->uvLen);
+
+  fseek(inFile, 0, SEEK_END);
+  long fileSize = ftell(inFile);
+
+  rsPtr->numFrames = (int) ((fileSize - rsPtr->firstFrameOffset) / rsPtr->frameNumBytes);
+
+  return 0;
+}
+
+static inline
+void y4m_close_reader(Y4MReaderStruct *rsPtr) {
+  if (rsPtr->inFile != NULL) {
+    fclose(rsPtr->inFile);
+    rsPtr->inFile = NULL;
+  }
+}
+
+// Map a time in seconds to a frame number, the result is clamped
+// to the range of frames in the file.
+
+static inline
+int y4m_frame_for_time(Y4MReaderStruct *rsPtr, double seconds) {
+  int frameNum = (int) ((seconds * rsPtr->fpsNum) / rsPtr->fpsDen + 1e-6);
+  if (frameNum < 0) {
+    frameNum = 0;
+  } else if (frameNum >= rsPtr->numFrames) {
+    frameNum = rsPtr->numFrames - 1;
+  }
+  return frameNum;
+}
+
+// Read Y, U, V planes for a specific frame into buffers described by
+// fsPtr, each buffer length must match the plane size. Returns 0 on success.
+
+static inline
+int y4m_read_frame(Y4MReaderStruct *rsPtr, int frameNum, Y4MFrameStruct *fsPtr) {
+  if (frameNum < 0 || frameNum >= rsPtr->numFrames) {
+    return 1;
+  }
+
+#if defined(DEBUG)
+  assert(fsPtr->yLen == rsPtr->yLen);
+  assert(fsPtr->uLen == rsPtr->uvLen);
+  assert(fsPtr->vLen == rsPtr->uvLen);
+#endif // DEBUG
+
+  FILE *inFile = rsPtr->inFile;
+
+  long offset = rsPtr->firstFrameOffset + (frameNum * rsPtr->frameNumBytes);
+
+  if (fseek(inFile, offset, SEEK_SET) != 0) {
+    return 2;
+  }
+
+  char marker[6];
+
+  if (fread(marker, sizeof(marker), 1, inFile) != 1 || memcmp(marker, "FRAME\n", 6) != 0) {
+    // Per frame parameters are not supported
+    return 2;
+  }
+
+  if (fread(fsPtr->yPtr, rsPtr->yLen, 1, inFile) != 1) {
+    return 2;
+  }
+
+  if (fread(fsPtr->uPtr, rsPtr->uvLen, 1, inFile) != 1) {
+    return 2;
+  }
+
+  if (fread(fsPtr->vPtr, rsPtr->uvLen, 1, inFile) != 1) {
+    return 2;
+  }
+
+  return 0;
+}
+
+#endif // _Y4M_READER_H
@@ -13,6 +13,9 @@
 #define _Y4M_WRITER_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
 
 typedef enum {
   Y4MHeaderFPS_1,
@@ -44,6 +47,53 @@ typedef struct {
   int vLen;
 } Y4MFrameStruct;
 
+// Frame rate as a fraction, 29.97 is 30000/1001
+
+static inline
+void y4m_fps_fraction(Y4MHeaderFPS fps, int *numPtr, int *denPtr) {
+  int num = 30;
+  int den = 1;
+
+  switch (fps) {
+    case Y4MHeaderFPS_1: {
+      num = 1;
+      break;
+    }
+    case Y4MHeaderFPS_2: {
+      num = 2;
+      break;
+    }
+    case Y4MHeaderFPS_15: {
+      num = 15;
+      break;
+    }
+    case Y4MHeaderFPS_24: {
+      num = 24;
+      break;
+    }
+    case Y4MHeaderFPS_25: {
+      num = 25;
+      break;
+    }
+    case Y4MHeaderFPS_29_97: {
+      num = 30000;
+      den = 1001;
+      break;
+    }
+    case Y4MHeaderFPS_30: {
+      num = 30;
+      break;
+    }
+    case Y4MHeaderFPS_60: {
+      num = 60;
+      break;
+    }
+  }
+
+  *numPtr = num;
+  *denPtr = den;
+}
+
 // Open output Y4M file descriptor with binary setting
 
 static inline
@@ -72,8 +122,8 @@ int y4m_write_header(FILE *outFile, Y4MHeaderStruct *hsPtr) {
   
   {
     int width = hsPtr->width;
-    NSString *formatted = [NSString stringWithFormat:@"W%d ", width];
-    char *segment = (char*) [formatted UTF8String];
+    char segment[32];
+    snprintf(segment, sizeof(segment), "W%d ", width);
     int segmentLen = (int) strlen(segment);
     int numWritten = (int) fwrite(segment, segmentLen, 1, outFile);
     if (numWritten != 1) {
@@ -83,8 +133,8 @@ int y4m_write_header(FILE *outFile, Y4MHeaderStruct *hsPtr) {
   
   {
     int height = hsPtr->height;
-    NSString *formatted = [NSString stringWithFormat:@"H%d ", height];
-    char *segment = (char*) [formatted UTF8String];
+    char segment[32];
+    snprintf(segment, sizeof(segment), "H%d ", height);
     int segmentLen = (int) strlen(segment);
     int numWritten = (int) fwrite(segment, segmentLen, 1, outFile);
     if (numWritten != 1) {
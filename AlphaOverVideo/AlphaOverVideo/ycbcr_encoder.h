@@ -0,0 +1,213 @@
+//
+//  ycbcr_encoder.h
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Portable interface for encoder backends that accept frames that
+//  are already BT.709 4:2:0 YCbCr. Chroma can be passed as separate
+//  Cb and Cr planes or as the interleaved CbCr plane of a biplanar
+//  buffer, so the same frame can be handed to a backend without a
+//  render or color conversion step. A backend is a table of function
+//  pointers, the Y4M backend defined here writes frames to a file.
+//
+//  See license.txt for license terms.
+
+#if !defined(_YCBCR_ENCODER_H)
+#define _YCBCR_ENCODER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BT709.h"
+#include "y4m_writer.h"
+
+typedef struct {
+  int width;
+  int height;
+  Y4MHeaderFPS fps;
+  // Transfer function the YCbCr values were encoded with, this
+  // defines the color tags written by backends that support tags.
+  BT709Gamma gamma;
+} YCbCrEncoderConfig;
+
+typedef struct {
+  const uint8_t *yPtr;
+  int yBytesPerRow;
+
+  // Planar chroma, used when cbcrPtr is NULL
+  const uint8_t *cbPtr;
+  const uint8_t *crPtr;
+  int chromaBytesPerRow;
+
+  // Interleaved Cb Cr pairs
+  const uint8_t *cbcrPtr;
+  int cbcrBytesPerRow;
+} YCbCrEncoderFrame;
+
+// Each function returns 0 on success
+
+typedef struct {
+  void *ctx;
+  int (*open)(void *ctx, const YCbCrEncoderConfig *config);
+  int (*write_frame)(void *ctx, const YCbCrEncoderFrame *frame);
+  int (*close)(void *ctx);
+} YCbCrEncoderBackend;
+
+// Copy the chroma of a frame into separate packed Cb and Cr planes
+
+static inline
+void ycbcr_encoder_split_chroma(const YCbCrEncoderFrame *frame, int chromaWidth, int chromaHeight,
+                                uint8_t *cbOut, uint8_t *crOut) {
+  for (int row = 0; row < chromaHeight; row++) {
+    uint8_t *cbRowPtr = cbOut + (row * chromaWidth);
+    uint8_t *crRowPtr = crOut + (row * chromaWidth);
+
+    if (frame->cbcrPtr != NULL) {
+      const uint8_t *inRowPtr = frame->cbcrPtr + (row * frame->cbcrBytesPerRow);
+
+      for (int col = 0; col < chromaWidth; col++) {
+        cbRowPtr[col] = inRowPtr[(col * 2)];
+        crRowPtr[col] = inRowPtr[(col * 2) + 1];
+      }
+    } else {
+      memcpy(cbRowPtr, frame->cbPtr + (row * frame->chromaBytesPerRow), chromaWidth);
+      memcpy(crRowPtr, frame->crPtr + (row * frame->chromaBytesPerRow), chromaWidth);
+    }
+  }
+}
+
+// Y4M backend
+
+typedef struct {
+  const char *outPath;
+  FILE *outFile;
+  YCbCrEncoderConfig config;
+  // Packed planes, only used when the input rows are padded
+  // or the chroma is interleaved.
+  uint8_t *yPlane;
+  uint8_t *cbPlane;
+  uint8_t *crPlane;
+} YCbCrY4MBackendContext;
+
+static inline
+int ycbcr_y4m_backend_open(void *ctx, const YCbCrEncoderConfig *config) {
+  YCbCrY4MBackendContext *y4mCtx = (YCbCrY4MBackendContext *) ctx;
+
+  if ((config->width % 2) != 0 || (config->height % 2) != 0) {
+    return 1;
+  }
+
+  y4mCtx->config = *config;
+
+  if (y4mCtx->outFile == NULL) {
+    y4mCtx->outFile = y4m_open_file(y4mCtx->outPath);
+  }
+
+  if (y4mCtx->outFile == NULL) {
+    return 1;
+  }
+
+  const int numPixels = config->width * config->height;
+
+  y4mCtx->yPlane = (uint8_t *) malloc(numPixels);
+  y4mCtx->cbPlane = (uint8_t *) malloc(numPixels / 4);
+  y4mCtx->crPlane = (uint8_t *) malloc(numPixels / 4);
+
+  if (y4mCtx->yPlane == NULL || y4mCtx->cbPlane == NULL || y4mCtx->crPlane == NULL) {
+    return 1;
+  }
+
+  Y4MHeaderStruct header;
+  header.width = config->width;
+  header.height = config->height;
+  header.fps = config->fps;
+
+  return y4m_write_header(y4mCtx->outFile, &header);
+}
+
+static inline
+int ycbcr_y4m_backend_write_frame(void *ctx, const YCbCrEncoderFrame *frame) {
+  YCbCrY4MBackendContext *y4mCtx = (YCbCrY4MBackendContext *) ctx;
+
+  const int width = y4mCtx->config.width;
+  const int height = y4mCtx->config.height;
+  const int chromaWidth = width / 2;
+  const int chromaHeight = height / 2;
+
+  Y4MFrameStruct fs;
+
+  fs.yLen = width * height;
+  fs.uLen = chromaWidth * chromaHeight;
+  fs.vLen = chromaWidth * chromaHeight;
+
+  // Packed planes are written directly
+
+  if (frame->yBytesPerRow == width) {
+    fs.yPtr = (uint8_t *) frame->yPtr;
+  } else {
+    for (int row = 0; row < height; row++) {
+      memcpy(y4mCtx->yPlane + (row * width), frame->yPtr + (row * frame->yBytesPerRow), width);
+    }
+    fs.yPtr = y4mCtx->yPlane;
+  }
+
+  if (frame->cbcrPtr == NULL && frame->chromaBytesPerRow == chromaWidth) {
+    fs.uPtr = (uint8_t *) frame->cbPtr;
+    fs.vPtr = (uint8_t *) frame->crPtr;
+  } else {
+    ycbcr_encoder_split_chroma(frame, chromaWidth, chromaHeight, y4mCtx->cbPlane, y4mCtx->crPlane);
+    fs.uPtr = y4mCtx->cbPlane;
+    fs.vPtr = y4mCtx->crPlane;
+  }
+
+  return y4m_write_frame(y4mCtx->outFile, &fs);
+}
+
+static inline
+int ycbcr_y4m_backend_close(void *ctx) {
+  YCbCrY4MBackendContext *y4mCtx = (YCbCrY4MBackendContext *) ctx;
+
+  int err = 0;
+
+  if (y4mCtx->outFile != NULL && fclose(y4mCtx->outFile) != 0) {
+    err = 2;
+  }
+
+  free(y4mCtx->yPlane);
+  free(y4mCtx->cbPlane);
+  free(y4mCtx->crPlane);
+
+  y4mCtx->outFile = NULL;
+  y4mCtx->yPlane = NULL;
+  y4mCtx->cbPlane = NULL;
+  y4mCtx->crPlane = NULL;
+
+  return err;
+}
+
+// Define a backend that writes frames to the Y4M file at outPath,
+// the context must remain valid until the backend is closed.
+
+static inline
+void ycbcr_y4m_backend_init(YCbCrEncoderBackend *backend, YCbCrY4MBackendContext *ctx, const char *outPath) {
+  memset(ctx, 0, sizeof(YCbCrY4MBackendContext));
+  ctx->outPath = outPath;
+
+  backend->ctx = ctx;
+  backend->open = ycbcr_y4m_backend_open;
+  backend->write_frame = ycbcr_y4m_backend_write_frame;
+  backend->close = ycbcr_y4m_backend_close;
+}
+
+// Define a backend that writes frames to an open stream, for example
+// stdout. The stream is closed when the backend is closed.
+
+static inline
+void ycbcr_y4m_backend_init_stream(YCbCrEncoderBackend *backend, YCbCrY4MBackendContext *ctx, FILE *outFile) {
+  ycbcr_y4m_backend_init(backend, ctx, NULL);
+  ctx->outFile = outFile;
+}
+
+#endif // _YCBCR_ENCODER_H
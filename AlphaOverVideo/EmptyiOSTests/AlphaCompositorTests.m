@@ -0,0 +1,339 @@
+//
+//  AlphaCompositorTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "alpha_compositor.h"
+
+#import "bt709_decode.h"
+
+@interface AlphaCompositorTests : XCTestCase
+
+@end
+
+static inline
+uint32_t rgbaToPixel(uint32_t R, uint32_t G, uint32_t B, uint32_t A)
+{
+  uint32_t outPixel = (A << 24) | (R << 16) | (G << 8) | B;
+  return outPixel;
+}
+
+@implementation AlphaCompositorTests
+{
+  AlphaCompositorTables *tables;
+}
+
+- (void)setUp {
+  tables = (AlphaCompositorTables *) malloc(sizeof(AlphaCompositorTables));
+  ac_tables_init(tables);
+}
+
+- (void)tearDown {
+  free(tables);
+  tables = NULL;
+}
+
+// Fill a layer buffer with a single pixel value
+
+- (NSMutableData*) fillPixels:(uint32_t)pixel width:(int)width height:(int)height
+{
+  NSMutableData *mData = [NSMutableData dataWithLength:width*height*sizeof(uint32_t)];
+  uint32_t *pixels = (uint32_t *) mData.mutableBytes;
+  for (int i = 0; i < (width * height); i++) {
+    pixels[i] = pixel;
+  }
+  return mData;
+}
+
+- (AlphaCompositorLayer) makeLayer:(NSMutableData*)pixelsData
+                             width:(int)width
+                            height:(int)height
+                                 x:(int)x
+                                 y:(int)y
+                                 z:(int)z
+{
+  AlphaCompositorLayer layer;
+  memset(&layer, 0, sizeof(layer));
+  layer.pixels = (const uint32_t *) pixelsData.bytes;
+  layer.pixelsPerRow = width;
+  layer.width = width;
+  layer.height = height;
+  layer.x = x;
+  layer.y = y;
+  layer.z = z;
+  layer.isPremultiplied = 1;
+  return layer;
+}
+
+// 50% gray over black must be blended as linear values, 0.5 linear
+// encodes to sRGB 188 as opposed to 128 when blended as sRGB bytes.
+
+- (void)testLinearBlend50PercentWhiteOverBlack {
+  const int width = 64;
+  const int height = 64;
+
+  NSMutableData *bgData = [self fillPixels:rgbaToPixel(0, 0, 0, 255) width:width height:height];
+  NSMutableData *outData = [self fillPixels:0 width:width height:height];
+
+  // Premultiplied white at 50% alpha
+  NSMutableData *layerData = [self fillPixels:rgbaToPixel(128, 128, 128, 128) width:width height:height];
+
+  AlphaCompositorLayer layer = [self makeLayer:layerData width:width height:height x:0 y:0 z:0];
+
+  AlphaCompositorFrame frame;
+  int result = ac_frame_init(&frame, tables, bgData.bytes, width, outData.mutableBytes, width, width, height, &layer, 1);
+  XCTAssert(result == 0);
+
+  AlphaCompositorStats stats;
+  memset(&stats, 0, sizeof(stats));
+  ac_composite(&frame, &stats);
+
+  uint32_t *outPixels = (uint32_t *) outData.bytes;
+
+  {
+    uint32_t v = outPixels[0];
+    uint32_t expectedVal = rgbaToPixel(188, 188, 188, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  XCTAssert(stats.blendedPixels == (width * height));
+}
+
+// A clip encoded with linear gamma decodes to bytes that are already
+// linear. Gray 128 is linear 0.5, which must come out as sRGB 188 and
+// not be linearized a second time as if it were sRGB 128.
+
+- (void)testLinearGammaClipRoundTrip {
+  const int width = 16;
+  const int height = 16;
+
+  uint8_t cbcr = 128;
+  int grayY = -1;
+
+  for (int Y = 0; Y < 256; Y++) {
+    uint8_t yVal = (uint8_t) Y;
+    uint32_t pixel;
+    bt709_decode_frame(&yVal, &cbcr, &cbcr, 1, 1, BT709GammaLinear, &pixel, 1);
+    if ((pixel & 0xFF) == 128) {
+      grayY = Y;
+      break;
+    }
+  }
+
+  XCTAssert(grayY != -1);
+
+  NSMutableData *yData = [NSMutableData dataWithLength:width*height];
+  NSMutableData *uvData = [NSMutableData dataWithLength:(width/2)*(height/2)];
+  memset(yData.mutableBytes, grayY, yData.length);
+  memset(uvData.mutableBytes, 128, uvData.length);
+
+  NSMutableData *layerData = [self fillPixels:0 width:width height:height];
+  bt709_decode_frame(yData.bytes, uvData.bytes, uvData.bytes, width, height, BT709GammaLinear, layerData.mutableBytes, width);
+
+  NSMutableData *bgData = [self fillPixels:rgbaToPixel(0, 0, 0, 255) width:width height:height];
+  NSMutableData *outData = [self fillPixels:0 width:width height:height];
+
+  float linearToLinear[256];
+  ac_to_linear_init(linearToLinear, 1);
+
+  AlphaCompositorLayer layer = [self makeLayer:layerData width:width height:height x:0 y:0 z:0];
+  layer.toLinear = linearToLinear;
+
+  AlphaCompositorFrame frame;
+  ac_frame_init(&frame, tables, bgData.bytes, width, outData.mutableBytes, width, width, height, &layer, 1);
+
+  AlphaCompositorStats stats;
+  memset(&stats, 0, sizeof(stats));
+  ac_composite(&frame, &stats);
+
+  uint32_t *outPixels = (uint32_t *) outData.bytes;
+
+  {
+    uint32_t v = outPixels[0];
+    uint32_t expectedVal = rgbaToPixel(188, 188, 188, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  // Without the table the bytes are treated as sRGB
+
+  layer.toLinear = NULL;
+  ac_frame_init(&frame, tables, bgData.bytes, width, outData.mutableBytes, width, width, height, &layer, 1);
+  ac_composite(&frame, &stats);
+
+  {
+    uint32_t v = outPixels[0];
+    uint32_t expectedVal = rgbaToPixel(128, 128, 128, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+}
+
+// Fully transparent blocks are skipped and leave the background as-is,
+// fully opaque blocks replace the background.
+
+- (void)testCoverageSkipsTransparentBlocks {
+  const int width = 64;
+  const int height = 64;
+
+  NSMutableData *bgData = [self fillPixels:rgbaToPixel(10, 20, 30, 255) width:width height:height];
+  NSMutableData *outData = [self fillPixels:0 width:width height:height];
+  NSMutableData *layerData = [self fillPixels:0 width:width height:height];
+
+  // Left half transparent, right half opaque red
+
+  uint32_t *layerPixels = (uint32_t *) layerData.mutableBytes;
+  for (int row = 0; row < height; row++) {
+    for (int col = width/2; col < width; col++) {
+      layerPixels[(row * width) + col] = rgbaToPixel(255, 0, 0, 255);
+    }
+  }
+
+  AlphaCompositorLayer layer = [self makeLayer:layerData width:width height:height x:0 y:0 z:0];
+  int result = ac_layer_scan_coverage(&layer);
+  XCTAssert(result == 0);
+
+  XCTAssert(layer.coverage[0] == ACBlockEmpty);
+  XCTAssert(layer.coverage[layer.coverageCols-1] == ACBlockOpaque);
+
+  AlphaCompositorFrame frame;
+  ac_frame_init(&frame, tables, bgData.bytes, width, outData.mutableBytes, width, width, height, &layer, 1);
+
+  AlphaCompositorStats stats;
+  memset(&stats, 0, sizeof(stats));
+  ac_composite(&frame, &stats);
+
+  uint32_t *outPixels = (uint32_t *) outData.bytes;
+
+  {
+    uint32_t v = outPixels[0];
+    uint32_t expectedVal = rgbaToPixel(10, 20, 30, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  {
+    uint32_t v = outPixels[width-1];
+    uint32_t expectedVal = rgbaToPixel(255, 0, 0, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  XCTAssert(stats.blendedPixels == 0);
+  XCTAssert(stats.copiedPixels == (width * height / 2));
+  XCTAssert(stats.skippedPixels == (width * height / 2));
+
+  ac_layer_free_coverage(&layer);
+}
+
+// The layer with the larger z value is drawn on top regardless of
+// the order layers appear in the input array. Offsets can place a
+// layer partially outside of the output.
+
+- (void)testZOrderAndOffsets {
+  const int width = 64;
+  const int height = 64;
+
+  NSMutableData *bgData = [self fillPixels:rgbaToPixel(0, 0, 0, 255) width:width height:height];
+  NSMutableData *outData = [self fillPixels:0 width:width height:height];
+  NSMutableData *redData = [self fillPixels:rgbaToPixel(255, 0, 0, 255) width:32 height:32];
+  NSMutableData *greenData = [self fillPixels:rgbaToPixel(0, 255, 0, 255) width:32 height:32];
+
+  AlphaCompositorLayer layers[2];
+  layers[0] = [self makeLayer:greenData width:32 height:32 x:16 y:16 z:2];
+  layers[1] = [self makeLayer:redData width:32 height:32 x:-8 y:-8 z:1];
+
+  AlphaCompositorFrame frame;
+  ac_frame_init(&frame, tables, bgData.bytes, width, outData.mutableBytes, width, width, height, layers, 2);
+
+  AlphaCompositorStats stats;
+  memset(&stats, 0, sizeof(stats));
+  ac_composite(&frame, &stats);
+
+  uint32_t *outPixels = (uint32_t *) outData.bytes;
+
+  {
+    // Red only
+    uint32_t v = outPixels[(4 * width) + 4];
+    uint32_t expectedVal = rgbaToPixel(255, 0, 0, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  {
+    // Overlap, green is on top
+    uint32_t v = outPixels[(20 * width) + 20];
+    uint32_t expectedVal = rgbaToPixel(0, 255, 0, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  {
+    // Background
+    uint32_t v = outPixels[(60 * width) + 2];
+    uint32_t expectedVal = rgbaToPixel(0, 0, 0, 255);
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+}
+
+// Benchmark throughput as the number of layers grows, each layer is
+// a soft edged circle similar to a Fireworks burst over a 1024x768 background.
+
+- (void) measureLayers:(int)numLayers {
+  const int width = 1024;
+  const int height = 768;
+  const int layerDim = 256;
+
+  NSMutableData *bgData = [self fillPixels:rgbaToPixel(40, 40, 80, 255) width:width height:height];
+  NSMutableData *outData = [self fillPixels:0 width:width height:height];
+  NSMutableData *layerData = [self fillPixels:0 width:layerDim height:layerDim];
+
+  uint32_t *layerPixels = (uint32_t *) layerData.mutableBytes;
+
+  for (int row = 0; row < layerDim; row++) {
+    for (int col = 0; col < layerDim; col++) {
+      float dx = col - layerDim/2;
+      float dy = row - layerDim/2;
+      float d = sqrtf(dx*dx + dy*dy) / (layerDim/2);
+      int A = (d >= 1.0f) ? 0 : (int) round((1.0f - d) * 255.0f);
+      layerPixels[(row * layerDim) + col] = rgbaToPixel(A, (A * 3) / 4, A / 2, A);
+    }
+  }
+
+  AlphaCompositorLayer layers[AC_MAX_LAYERS];
+
+  for (int i = 0; i < numLayers; i++) {
+    layers[i] = [self makeLayer:layerData width:layerDim height:layerDim x:(i * 97) % (width - layerDim) y:(i * 61) % (height - layerDim) z:i];
+    ac_layer_scan_coverage(&layers[i]);
+  }
+
+  AlphaCompositorFrame frame;
+  ac_frame_init(&frame, tables, bgData.bytes, width, outData.mutableBytes, width, width, height, layers, numLayers);
+
+  [self measureBlock:^{
+    AlphaCompositorStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < 10; i++) {
+      ac_composite(&frame, &stats);
+    }
+  }];
+
+  for (int i = 0; i < numLayers; i++) {
+    ac_layer_free_coverage(&layers[i]);
+  }
+}
+
+- (void)testPerformanceComposite1Layer {
+  [self measureLayers:1];
+}
+
+- (void)testPerformanceComposite4Layers {
+  [self measureLayers:4];
+}
+
+- (void)testPerformanceComposite8Layers {
+  [self measureLayers:8];
+}
+
+- (void)testPerformanceComposite16Layers {
+  [self measureLayers:16];
+}
+
+@end
@@ -0,0 +1,569 @@
+//
+//  BuildPlanTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "build_plan.h"
+
+@interface BuildPlanTests : XCTestCase
+
+@end
+
+@implementation BuildPlanTests
+
+- (NSString*) tmpDir
+{
+  NSString *dir = [NSTemporaryDirectory() stringByAppendingPathComponent:@"BuildPlanTests"];
+  [[NSFileManager defaultManager] createDirectoryAtPath:dir withIntermediateDirectories:TRUE attributes:nil error:nil];
+  return dir;
+}
+
+// Init a plan that reads the manifest text from a file in the tmp dir,
+// with the build and output dirs next to the manifest.
+
+- (void) initPlan:(BuildPlan*)plan manifest:(NSString*)manifest
+{
+  NSString *dir = [self tmpDir];
+  NSString *manifestPath = [dir stringByAppendingPathComponent:@"manifest.txt"];
+  [manifest writeToFile:manifestPath atomically:TRUE encoding:NSUTF8StringEncoding error:nil];
+
+  memset(plan, 0, sizeof(BuildPlan));
+  plan->manifestPath = strdup([manifestPath fileSystemRepresentation]);
+  snprintf(plan->manifestDir, sizeof(plan->manifestDir), "%s", [dir fileSystemRepresentation]);
+  plan->buildDir = strdup([[dir stringByAppendingPathComponent:@"build"] fileSystemRepresentation]);
+  plan->outDir = strdup([dir fileSystemRepresentation]);
+  plan->encodeCost = 2;
+}
+
+- (void) freePlan:(BuildPlan*)plan
+{
+  free((void *) plan->manifestPath);
+  free((void *) plan->buildDir);
+  free((void *) plan->outDir);
+  build_free_plan(plan);
+}
+
+- (NSString*) tmpPath:(NSString*)path
+{
+  return [[self tmpDir] stringByAppendingPathComponent:path];
+}
+
+- (void)testParseManifest {
+  BuildPlan plan;
+
+  [self initPlan:&plan manifest:
+   @"# comment line\n"
+   @"\n"
+   @"defaults -fps 24 -crf 20\n"
+   @"clip Fireworks frames/Fireworks/F0001.png -alpha 1 # trailing comment\n"
+   @"clip Logo \"frames/Logo Big/F0001.png\" -gamma linear -crf 28 -output out/Logo.m4v\n"
+   @"defaults -profile high\n"
+   @"clip Field frames/Field/F0001.png -encoder x264\n"
+   @"clip Globe frames/Globe/F0001.png -alpha 1 -gamma srgb\n"];
+
+  int err = build_parse_manifest(&plan);
+  XCTAssert(err == 0);
+
+  {
+    int v = plan.numClips;
+    int expectedVal = 4;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  BuildClip *fireworks = &plan.clips[0];
+  BuildClip *logo = &plan.clips[1];
+  BuildClip *field = &plan.clips[2];
+  BuildClip *globe = &plan.clips[3];
+
+  XCTAssert(strcmp(fireworks->name, "Fireworks") == 0);
+  XCTAssert([@(fireworks->firstFrame) isEqualToString:[self tmpPath:@"frames/Fireworks/F0001.png"]]);
+  XCTAssert(fireworks->settings.alpha == 1);
+  XCTAssert(strcmp(fireworks->settings.gamma, "srgb") == 0);
+  XCTAssert(strcmp(fireworks->settings.fps, "24") == 0);
+  XCTAssert(fireworks->settings.crf == 20);
+  XCTAssert(strcmp(fireworks->settings.profile, "main") == 0);
+  XCTAssert(fireworks->settings.output[0] == '\0');
+
+  // Quoted path with a space, options override the defaults
+
+  XCTAssert([@(logo->firstFrame) isEqualToString:[self tmpPath:@"frames/Logo Big/F0001.png"]]);
+  XCTAssert(logo->settings.alpha == 0);
+  XCTAssert(strcmp(logo->settings.gamma, "linear") == 0);
+  XCTAssert(logo->settings.crf == 28);
+  XCTAssert(strcmp(logo->settings.output, "out/Logo.m4v") == 0);
+
+  // Defaults apply to the clips that come after them
+
+  XCTAssert(strcmp(field->settings.gamma, "apple") == 0);
+  XCTAssert(strcmp(field->settings.profile, "high") == 0);
+  XCTAssert(field->settings.crf == 20);
+  XCTAssert(field->settings.encoder == EncoderX264);
+
+  // An alpha clip defaults to sRGB gamma, it can also be set
+
+  XCTAssert(globe->settings.alpha == 1);
+  XCTAssert(strcmp(globe->settings.gamma, "srgb") == 0);
+
+  [self freePlan:&plan];
+}
+
+- (void)testParseManifestErrors {
+  NSArray *manifests = @[
+    @"",
+    @"# only a comment\n",
+    @"clip A\n",
+    @"clip A a/F0001.png -crf\n",
+    @"clip A a/F0001.png -gamma rec2020\n",
+    @"clip A a/F0001.png -encoder hevc\n",
+    @"clip A a/F0001.png -bogus 1\n",
+    @"clip A a/F0001.png -alpha 1 -gamma apple\n",
+    @"defaults -gamma linear\nclip A a/F0001.png -alpha 1\n",
+    @"clip A a/F0001.png -output A.mp4\n",
+    @"clip A a/F0001.png -output A\n",
+    @"clip A a/F0001.png -output .m4v\n",
+    @"clip A a/F0001.png\nclip A b/F0001.png\n",
+    @"clips A a/F0001.png\n",
+  ];
+
+  for (NSString *manifest in manifests) {
+    BuildPlan plan;
+    [self initPlan:&plan manifest:manifest];
+    int err = build_parse_manifest(&plan);
+    XCTAssert(err != 0, @"%@", manifest);
+    [self freePlan:&plan];
+  }
+}
+
+// An RGB clip plans a convert and one encode, an alpha clip a second
+// encode of the _alpha video. The encodes depend on the convert.
+
+- (void)testPlanJobs {
+  BuildPlan plan;
+
+  [self initPlan:&plan manifest:
+   @"clip A a/F0001.png -alpha 1\n"
+   @"clip B b/F0001.png\n"];
+
+  int err = build_parse_manifest(&plan);
+  XCTAssert(err == 0);
+
+  for (int i = 0; i < plan.numClips; i++) {
+    err = build_plan_clip_jobs(&plan, i);
+    XCTAssert(err == 0);
+  }
+
+  {
+    int v = plan.numJobs;
+    int expectedVal = 5;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(strcmp(plan.jobs[0].name, "A/convert") == 0);
+  XCTAssert(strcmp(plan.jobs[1].name, "A/encode") == 0);
+  XCTAssert(strcmp(plan.jobs[2].name, "A/encode_alpha") == 0);
+  XCTAssert(strcmp(plan.jobs[3].name, "B/convert") == 0);
+  XCTAssert(strcmp(plan.jobs[4].name, "B/encode") == 0);
+
+  XCTAssert(plan.jobs[0].numOutputs == 2);
+  XCTAssert(plan.jobs[0].isIntermediate);
+  XCTAssert(plan.jobs[1].numDeps == 1 && plan.jobs[1].deps[0] == 0);
+  XCTAssert(plan.jobs[2].numDeps == 1 && plan.jobs[2].deps[0] == 0);
+  XCTAssert(plan.jobs[4].numDeps == 1 && plan.jobs[4].deps[0] == 3);
+  XCTAssert(plan.jobs[1].cost == 2);
+
+  XCTAssert([@(plan.jobs[1].outputs[0]) isEqualToString:[self tmpPath:@"A.m4v"]]);
+  XCTAssert([@(plan.jobs[2].outputs[0]) isEqualToString:[self tmpPath:@"A_alpha.m4v"]]);
+
+  [self freePlan:&plan];
+}
+
+// A path that does not fit is an error, a truncated path would name
+// some other file.
+
+- (void)testLongPaths {
+  NSString *longName = [@"" stringByPaddingToLength:BUILD_MAX_PATH_LEN withString:@"a" startingAtIndex:0];
+
+  NSArray *manifests = @[
+    [NSString stringWithFormat:@"clip A %@/F0001.png\n", longName],
+    [NSString stringWithFormat:@"clip A a/F0001.png -output %@.m4v\n", longName],
+  ];
+
+  for (NSString *manifest in manifests) {
+    BuildPlan plan;
+    [self initPlan:&plan manifest:manifest];
+    int err = build_parse_manifest(&plan);
+    XCTAssert(err != 0);
+    [self freePlan:&plan];
+  }
+
+  // Output dir leaves no room for the clip name
+
+  BuildPlan plan;
+  [self initPlan:&plan manifest:@"clip A a/F0001.png\n"];
+
+  int err = build_parse_manifest(&plan);
+  XCTAssert(err == 0);
+
+  free((void *) plan.outDir);
+  plan.outDir = strdup([[longName substringFromIndex:4] UTF8String]);
+
+  err = build_plan_clip_jobs(&plan, 0);
+  XCTAssert(err != 0);
+
+  [self freePlan:&plan];
+
+  // Cache path leaves no room for the .tmp suffix
+
+  BuildCache cache;
+  memset(&cache, 0, sizeof(cache));
+  err = build_cache_write(&cache, [[longName substringFromIndex:2] UTF8String]);
+  XCTAssert(err != 0);
+}
+
+// The _alpha video of a clip with an -output path is written next to it
+
+- (void)testOutputPath {
+  BuildPlan plan;
+
+  [self initPlan:&plan manifest:
+   @"clip A a/F0001.png -alpha 1 -output out/Logo.v2.m4v\n"];
+
+  int err = build_parse_manifest(&plan);
+  XCTAssert(err == 0);
+
+  err = build_plan_clip_jobs(&plan, 0);
+  XCTAssert(err == 0);
+
+  XCTAssert([@(plan.jobs[1].outputs[0]) isEqualToString:[self tmpPath:@"out/Logo.v2.m4v"]]);
+  XCTAssert([@(plan.jobs[2].outputs[0]) isEqualToString:[self tmpPath:@"out/Logo.v2_alpha.m4v"]]);
+
+  [self freePlan:&plan];
+}
+
+// Plan, hash and mark the jobs of a two clip manifest with the given
+// clip input hashes.
+
+- (void) planJobs:(BuildPlan*)plan inputHashA:(uint64_t)inputHashA inputHashB:(uint64_t)inputHashB
+{
+  [self initPlan:plan manifest:
+   @"clip A a/F0001.png -alpha 1\n"
+   @"clip B b/F0001.png\n"];
+
+  int err = build_parse_manifest(plan);
+  XCTAssert(err == 0);
+
+  plan->clips[0].inputHash = inputHashA;
+  plan->clips[1].inputHash = inputHashB;
+
+  for (int i = 0; i < plan->numClips; i++) {
+    err = build_plan_clip_jobs(plan, i);
+    XCTAssert(err == 0);
+  }
+
+  build_hash_jobs(plan);
+}
+
+- (int) numToRun:(BuildPlan*)plan
+{
+  int numToRun = 0;
+  for (int i = 0; i < plan->numJobs; i++) {
+    if (plan->jobs[i].needsRun) {
+      numToRun++;
+    }
+  }
+  return numToRun;
+}
+
+// A job is up to date when every output exists and was recorded in the
+// cache with the job hash. Changing the inputs of one clip reruns only
+// the jobs of that clip, an intermediate that was deleted is rebuilt
+// only when a job that depends on it has to run.
+
+- (void)testUpToDate {
+  BuildPlan plan;
+  [self planJobs:&plan inputHashA:1 inputHashB:2];
+
+  // Nothing built yet
+
+  build_mark_jobs_to_run(&plan);
+
+  {
+    int v = [self numToRun:&plan];
+    int expectedVal = 5;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Record a build of every job and create the final outputs, the
+  // intermediate .y4m files were removed after the encodes.
+
+  NSString *cachePath = [[self tmpDir] stringByAppendingPathComponent:@"build.cache"];
+
+  for (int i = 0; i < plan.numJobs; i++) {
+    BuildJob *job = &plan.jobs[i];
+    for (int j = 0; j < job->numOutputs; j++) {
+      build_cache_set_output(&plan.cache, job->outputs[j], job->hash);
+      if (!job->isIntermediate) {
+        [[NSData data] writeToFile:@(job->outputs[j]) atomically:TRUE];
+      } else {
+        [[NSFileManager defaultManager] removeItemAtPath:@(job->outputs[j]) error:nil];
+      }
+    }
+  }
+
+  int err = build_cache_write(&plan.cache, [cachePath fileSystemRepresentation]);
+  XCTAssert(err == 0);
+
+  [self freePlan:&plan];
+
+  // Same inputs, nothing runs
+
+  [self planJobs:&plan inputHashA:1 inputHashB:2];
+  build_cache_read(&plan.cache, [cachePath fileSystemRepresentation]);
+  build_mark_jobs_to_run(&plan);
+
+  {
+    int v = [self numToRun:&plan];
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  for (int i = 0; i < plan.numJobs; i++) {
+    XCTAssert(plan.jobs[i].state == JobStateCached);
+  }
+
+  [self freePlan:&plan];
+
+  // Frames of B changed, the B convert and encode run
+
+  [self planJobs:&plan inputHashA:1 inputHashB:3];
+  build_cache_read(&plan.cache, [cachePath fileSystemRepresentation]);
+  build_mark_jobs_to_run(&plan);
+
+  {
+    int v = [self numToRun:&plan];
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(plan.jobs[3].needsRun);
+  XCTAssert(plan.jobs[4].needsRun);
+
+  [self freePlan:&plan];
+
+  // A final output was deleted, the encode runs and so does the
+  // convert that makes its input.
+
+  [[NSFileManager defaultManager] removeItemAtPath:[self tmpPath:@"A_alpha.m4v"] error:nil];
+
+  [self planJobs:&plan inputHashA:1 inputHashB:2];
+  build_cache_read(&plan.cache, [cachePath fileSystemRepresentation]);
+  build_mark_jobs_to_run(&plan);
+
+  XCTAssert(plan.jobs[0].needsRun);
+  XCTAssert(plan.jobs[1].needsRun == 0);
+  XCTAssert(plan.jobs[2].needsRun);
+  XCTAssert(plan.jobs[3].needsRun == 0);
+  XCTAssert(plan.jobs[4].needsRun == 0);
+
+  // Force runs every job
+
+  plan.force = 1;
+  build_mark_jobs_to_run(&plan);
+
+  {
+    int v = [self numToRun:&plan];
+    int expectedVal = 5;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  [self freePlan:&plan];
+}
+
+// The job hash changes with the command line and with the hash of a
+// job it depends on.
+
+- (void)testJobHash {
+  BuildPlan plan1;
+  BuildPlan plan2;
+
+  [self planJobs:&plan1 inputHashA:1 inputHashB:2];
+  [self planJobs:&plan2 inputHashA:1 inputHashB:2];
+
+  for (int i = 0; i < plan1.numJobs; i++) {
+    XCTAssert(plan1.jobs[i].hash == plan2.jobs[i].hash);
+  }
+
+  plan2.clips[0].inputHash = 5;
+  build_hash_jobs(&plan2);
+
+  XCTAssert(plan1.jobs[0].hash != plan2.jobs[0].hash);
+  XCTAssert(plan1.jobs[1].hash != plan2.jobs[1].hash);
+  XCTAssert(plan1.jobs[3].hash == plan2.jobs[3].hash);
+
+  plan2.clips[0].inputHash = 1;
+  free(plan2.jobs[4].argv[3]);
+  plan2.jobs[4].argv[3] = strdup("30");
+  build_hash_jobs(&plan2);
+
+  XCTAssert(plan1.jobs[0].hash == plan2.jobs[0].hash);
+  XCTAssert(plan1.jobs[4].hash != plan2.jobs[4].hash);
+
+  [self freePlan:&plan1];
+  [self freePlan:&plan2];
+}
+
+// Plan the jobs of a clip run with the tools in the tmp dir
+
+- (void) planToolJobs:(BuildPlan*)plan
+{
+  [self initPlan:plan manifest:@"clip A a/F0001.png\n"];
+  plan->toolsDir = strdup([[self tmpPath:@"tools"] fileSystemRepresentation]);
+
+  int err = build_parse_manifest(plan);
+  XCTAssert(err == 0);
+
+  err = build_plan_clip_jobs(plan, 0);
+  XCTAssert(err == 0);
+
+  build_hash_jobs(plan);
+
+  free((void *) plan->toolsDir);
+  plan->toolsDir = NULL;
+}
+
+// A rebuilt srgb_to_bt709 changes the hash of the convert and of the
+// encode that depends on it, an edited encode script only changes the
+// hash of the encode.
+
+- (void)testToolChangeReruns {
+  NSString *toolsDir = [self tmpPath:@"tools"];
+  [[NSFileManager defaultManager] createDirectoryAtPath:toolsDir withIntermediateDirectories:TRUE attributes:nil error:nil];
+
+  NSString *convertPath = [toolsDir stringByAppendingPathComponent:@"srgb_to_bt709"];
+  NSString *scriptPath = [toolsDir stringByAppendingPathComponent:@"ext_ffmpeg_encode_bt709_crf.sh"];
+
+  [@"v1" writeToFile:convertPath atomically:TRUE encoding:NSUTF8StringEncoding error:nil];
+  [@"v1" writeToFile:scriptPath atomically:TRUE encoding:NSUTF8StringEncoding error:nil];
+
+  BuildPlan plan1;
+  BuildPlan plan2;
+
+  [self planToolJobs:&plan1];
+  [self planToolJobs:&plan2];
+
+  XCTAssert(plan1.jobs[0].hash == plan2.jobs[0].hash);
+  XCTAssert(plan1.jobs[1].hash == plan2.jobs[1].hash);
+
+  [self freePlan:&plan2];
+
+  [@"v1 rebuilt" writeToFile:convertPath atomically:TRUE encoding:NSUTF8StringEncoding error:nil];
+  [self planToolJobs:&plan2];
+
+  XCTAssert(plan1.jobs[0].hash != plan2.jobs[0].hash);
+  XCTAssert(plan1.jobs[1].hash != plan2.jobs[1].hash);
+
+  [self freePlan:&plan1];
+  plan1 = plan2;
+
+  [@"v2 script" writeToFile:scriptPath atomically:TRUE encoding:NSUTF8StringEncoding error:nil];
+  [self planToolJobs:&plan2];
+
+  XCTAssert(plan1.jobs[0].hash == plan2.jobs[0].hash);
+  XCTAssert(plan1.jobs[1].hash != plan2.jobs[1].hash);
+
+  [self freePlan:&plan1];
+  [self freePlan:&plan2];
+}
+
+// Cache entries written and read back are the same, input entries not
+// used by the build are dropped.
+
+- (void)testCacheRoundTrip {
+  BuildCache cache;
+  memset(&cache, 0, sizeof(cache));
+
+  CacheInput *input = build_cache_add_input(&cache, "frames/A/F0001.png");
+  input->hash = 0x0123456789abcdefULL;
+  input->size = 1234;
+  input->mtime = 1700000000;
+  input->isLive = 1;
+
+  input = build_cache_add_input(&cache, "frames/A B/F0002.png");
+  input->hash = 0xfedcba9876543210ULL;
+  input->size = 5;
+  input->mtime = 1700000001;
+  input->isLive = 1;
+
+  input = build_cache_add_input(&cache, "frames/Old/F0001.png");
+  input->hash = 1;
+  input->isLive = 0;
+
+  build_cache_set_output(&cache, "out/A.m4v", 0xffffffffffffffffULL);
+  build_cache_set_output(&cache, "out/A B_alpha.m4v", 42);
+  build_cache_set_output(&cache, "out/A.m4v", 7);
+
+  NSString *cachePath = [[self tmpDir] stringByAppendingPathComponent:@"roundtrip.cache"];
+
+  int err = build_cache_write(&cache, [cachePath fileSystemRepresentation]);
+  XCTAssert(err == 0);
+
+  BuildCache readCache;
+  memset(&readCache, 0, sizeof(readCache));
+  build_cache_read(&readCache, [cachePath fileSystemRepresentation]);
+
+  {
+    int v = readCache.numInputs;
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = readCache.numOutputs;
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    const CacheInput *written = &cache.inputs[i];
+    const CacheInput *read = build_cache_find_input(&readCache, written->path);
+    XCTAssert(read != NULL, @"%s", written->path);
+    if (read != NULL) {
+      XCTAssert(read->hash == written->hash);
+      XCTAssert(read->size == written->size);
+      XCTAssert(read->mtime == written->mtime);
+    }
+  }
+
+  XCTAssert(build_cache_find_input(&readCache, "frames/Old/F0001.png") == NULL);
+
+  CacheOutput *output = build_cache_find_output(&readCache, "out/A.m4v");
+  XCTAssert(output != NULL && output->hash == 7);
+
+  output = build_cache_find_output(&readCache, "out/A B_alpha.m4v");
+  XCTAssert(output != NULL && output->hash == 42);
+
+  // A missing cache file reads as an empty cache
+
+  BuildCache emptyCache;
+  memset(&emptyCache, 0, sizeof(emptyCache));
+  build_cache_read(&emptyCache, "/nonexistent/aov_build.cache");
+  XCTAssert(emptyCache.numInputs == 0 && emptyCache.numOutputs == 0);
+
+  BuildCache *caches[2] = { &cache, &readCache };
+
+  for (int c = 0; c < 2; c++) {
+    for (int i = 0; i < caches[c]->numInputs; i++) {
+      free(caches[c]->inputs[i].path);
+    }
+    for (int i = 0; i < caches[c]->numOutputs; i++) {
+      free(caches[c]->outputs[i].path);
+    }
+    free(caches[c]->inputs);
+    free(caches[c]->outputs);
+  }
+}
+
+@end
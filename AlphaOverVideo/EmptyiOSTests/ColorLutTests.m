@@ -0,0 +1,273 @@
+//
+//  ColorLutTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "color_lut.h"
+
+#import "BGRAToBT709Converter.h"
+
+@interface ColorLutTests : XCTestCase
+
+@end
+
+@implementation ColorLutTests
+
+- (NSString*) tmpPath:(NSString*)filename
+{
+  return [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+}
+
+// Full cube must be identical to the direct function for every input
+
+- (void)testFullCubeExact {
+  ColorLutEncode encodes[3] = { ColorLutEncodeSrgb, ColorLutEncodeApple, ColorLutEncodeBT709 };
+
+  for (int i = 0; i < 3; i++) {
+    ColorLut lut;
+    int err = color_lut_build(encodes[i], ColorLutKindFullCube, &lut);
+    XCTAssert(err == 0);
+
+    uint32_t numMismatched = 0;
+    int maxError = color_lut_measure_error(&lut, &numMismatched);
+
+    {
+      int v = maxError;
+      int expectedVal = 0;
+      XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+    }
+
+    {
+      int v = (int) numMismatched;
+      int expectedVal = 0;
+      XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+    }
+
+    color_lut_free(&lut);
+  }
+}
+
+// Interpolated output is never more than 1 away from the direct function
+// and differs for less than 1% of all inputs.
+
+- (void)testTetrahedralErrorBound {
+  ColorLutEncode encodes[3] = { ColorLutEncodeSrgb, ColorLutEncodeApple, ColorLutEncodeBT709 };
+
+  for (int i = 0; i < 3; i++) {
+    ColorLut lut;
+    int err = color_lut_build(encodes[i], ColorLutKindTetrahedral, &lut);
+    XCTAssert(err == 0);
+
+    uint32_t numMismatched = 0;
+    int maxError = color_lut_measure_error(&lut, &numMismatched);
+
+    XCTAssert(maxError <= 1, @"max error %d", maxError);
+    XCTAssert(numMismatched < ((256 * 256 * 256) / 100), @"mismatched %d", (int) numMismatched);
+
+    // Grid points are exact
+
+    int Y1, Cb1, Cr1, Y2, Cb2, Cr2;
+    color_lut_encode_pixel(encodes[i], 255, 0, 255, &Y1, &Cb1, &Cr1);
+    color_lut_lookup(&lut, 255, 0, 255, &Y2, &Cb2, &Cr2);
+    XCTAssert(Y1 == Y2 && Cb1 == Cb2 && Cr1 == Cr2);
+
+    color_lut_free(&lut);
+  }
+}
+
+// A written table maps back with the same contents, a table with
+// a different encode or a truncated file is rejected.
+
+- (void)testWriteAndMapFile {
+  NSString *path = [self tmpPath:@"color_lut_test.lut"];
+
+  ColorLut lut;
+  int err = color_lut_build(ColorLutEncodeApple, ColorLutKindTetrahedral, &lut);
+  XCTAssert(err == 0);
+
+  err = color_lut_write_file(&lut, [path fileSystemRepresentation]);
+  XCTAssert(err == 0);
+
+  ColorLut mappedLut;
+  err = color_lut_map_file([path fileSystemRepresentation], ColorLutEncodeApple, ColorLutKindTetrahedral, &mappedLut);
+  XCTAssert(err == 0);
+  XCTAssert(mappedLut.mapping != NULL);
+
+  {
+    int v = (int) mappedLut.numBytes;
+    int expectedVal = (int) lut.numBytes;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  int cmp = memcmp(mappedLut.bytes, lut.bytes, (size_t) lut.numBytes);
+  XCTAssert(cmp == 0);
+
+  color_lut_free(&mappedLut);
+
+  ColorLut wrongLut;
+  err = color_lut_map_file([path fileSystemRepresentation], ColorLutEncodeBT709, ColorLutKindTetrahedral, &wrongLut);
+  XCTAssert(err == COLOR_LUT_ERR_MALFORMED);
+
+  truncate([path fileSystemRepresentation], 1000);
+  err = color_lut_map_file([path fileSystemRepresentation], ColorLutEncodeApple, ColorLutKindTetrahedral, &wrongLut);
+  XCTAssert(err == COLOR_LUT_ERR_MALFORMED);
+
+  color_lut_free(&lut);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+// A cached table generated by a different encode function has a
+// different checksum, loading rejects it and rebuilds the cache.
+
+- (void)testStaleTableRebuilt {
+  NSString *path = [self tmpPath:@"color_lut_stale.lut"];
+
+  ColorLut lut;
+  int err = color_lut_build(ColorLutEncodeApple, ColorLutKindTetrahedral, &lut);
+  XCTAssert(err == 0);
+
+  {
+    uint64_t v = ((const ColorLutHeader *) lut.bytes)->checksum;
+    XCTAssert(v == color_lut_checksum(ColorLutEncodeApple, ColorLutKindTetrahedral));
+    XCTAssert(v != color_lut_checksum(ColorLutEncodeBT709, ColorLutKindTetrahedral));
+    XCTAssert(v != color_lut_checksum(ColorLutEncodeApple, ColorLutKindFullCube));
+  }
+
+  // Write the table with the checksum of other generating code
+
+  ((ColorLutHeader *) lut.storage)->checksum += 1;
+  err = color_lut_write_file(&lut, [path fileSystemRepresentation]);
+  XCTAssert(err == 0);
+  color_lut_free(&lut);
+
+  ColorLut mappedLut;
+  err = color_lut_map_file([path fileSystemRepresentation], ColorLutEncodeApple, ColorLutKindTetrahedral, &mappedLut);
+  XCTAssert(err == COLOR_LUT_ERR_MALFORMED);
+
+  err = color_lut_load([path fileSystemRepresentation], ColorLutEncodeApple, ColorLutKindTetrahedral, &lut);
+  XCTAssert(err == 0);
+  XCTAssert(lut.mapping == NULL);
+  color_lut_free(&lut);
+
+  // The rebuilt cache was written back and now maps
+
+  err = color_lut_map_file([path fileSystemRepresentation], ColorLutEncodeApple, ColorLutKindTetrahedral, &mappedLut);
+  XCTAssert(err == 0);
+  color_lut_free(&mappedLut);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+// The table converter writes the same pixels as the software converter
+
+- (void)testConverterLutMatchesSoftware {
+  const int width = 256;
+  const int height = 64;
+  const int numPixels = width * height;
+
+  uint32_t *inPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+  uint32_t *expectedPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+
+  for (int i = 0; i < numPixels; i++) {
+    inPixels[i] = 0xFF000000 | ((uint32_t) (i * 2654435761u) & 0xFFFFFF);
+  }
+
+  BOOL worked = [BGRAToBT709Converter convert:inPixels outBT709Pixels:expectedPixels width:width height:height type:BGRAToBT709ConverterSoftware];
+  XCTAssert(worked);
+
+  worked = [BGRAToBT709Converter convert:inPixels outBT709Pixels:outPixels width:width height:height type:BGRAToBT709ConverterLut];
+  XCTAssert(worked);
+
+  int cmp = memcmp(outPixels, expectedPixels, numPixels * sizeof(uint32_t));
+  XCTAssert(cmp == 0);
+
+  free(inPixels);
+  free(outPixels);
+  free(expectedPixels);
+}
+
+- (void)testPerformanceBuildFullCube {
+  [self measureBlock:^{
+    ColorLut lut;
+    color_lut_build(ColorLutEncodeApple, ColorLutKindFullCube, &lut);
+    color_lut_free(&lut);
+  }];
+}
+
+- (void)testPerformanceMapFullCube {
+  NSString *path = [self tmpPath:@"color_lut_perf.lut"];
+
+  ColorLut lut;
+  color_lut_build(ColorLutEncodeApple, ColorLutKindFullCube, &lut);
+  color_lut_write_file(&lut, [path fileSystemRepresentation]);
+  color_lut_free(&lut);
+
+  [self measureBlock:^{
+    ColorLut mappedLut;
+    int err = color_lut_map_file([path fileSystemRepresentation], ColorLutEncodeApple, ColorLutKindFullCube, &mappedLut);
+    XCTAssert(err == 0);
+    color_lut_free(&mappedLut);
+  }];
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+// Convert one 1080p frame of random colors, compare to testPerformanceDirect
+
+- (void)measureConvert:(ColorLutKind)kind {
+  const int numPixels = 1920 * 1080;
+  uint32_t *inPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+
+  for (int i = 0; i < numPixels; i++) {
+    inPixels[i] = (uint32_t) (i * 2654435761u);
+  }
+
+  ColorLut lut;
+  color_lut_build(ColorLutEncodeApple, kind, &lut);
+
+  [self measureBlock:^{
+    color_lut_convert_row(&lut, inPixels, outPixels, numPixels);
+  }];
+
+  color_lut_free(&lut);
+  free(inPixels);
+  free(outPixels);
+}
+
+- (void)testPerformanceConvertFullCube {
+  [self measureConvert:ColorLutKindFullCube];
+}
+
+- (void)testPerformanceConvertTetrahedral {
+  [self measureConvert:ColorLutKindTetrahedral];
+}
+
+- (void)testPerformanceDirect {
+  const int numPixels = 1920 * 1080;
+  uint32_t *inPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+
+  for (int i = 0; i < numPixels; i++) {
+    inPixels[i] = (uint32_t) (i * 2654435761u);
+  }
+
+  [self measureBlock:^{
+    for (int i = 0; i < numPixels; i++) {
+      const uint32_t pixel = inPixels[i];
+      int Y, Cb, Cr;
+      color_lut_encode_pixel(ColorLutEncodeApple, (pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF, &Y, &Cb, &Cr);
+      outPixels[i] = ((uint32_t) Cr << 16) | ((uint32_t) Cb << 8) | (uint32_t) Y;
+    }
+  }];
+
+  free(inPixels);
+  free(outPixels);
+}
+
+@end
@@ -0,0 +1,364 @@
+//
+//  DecodeBudgetTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "decode_budget.h"
+
+@interface DecodeBudgetTests : XCTestCase
+
+@end
+
+@implementation DecodeBudgetTests
+{
+  DecodeBudget *_budget;
+  // Vsyncs where more than one frame was granted over the budget
+  int _numOverGranted;
+}
+
+- (void)setUp {
+  _budget = (DecodeBudget *) malloc(sizeof(DecodeBudget));
+  _numOverGranted = 0;
+}
+
+- (void)tearDown {
+  free(_budget);
+}
+
+// Schedule vsyncs of a 60 Hz display starting at vsync number first
+
+- (void) runVsyncs:(int)first count:(int)count {
+  for (int vsync = first; vsync < (first + count); vsync++) {
+    decode_budget_schedule(_budget, 10.0 + (vsync / 60.0));
+
+    int numGranted = 0;
+
+    for (int i = 0; i < DECODE_BUDGET_MAX_PLAYERS; i++) {
+      if (_budget->players[i].inUse && decode_budget_decision(_budget, i) == DecodeBudgetDecode) {
+        numGranted += 1;
+      }
+    }
+
+    if (_budget->pixelsPerVsync > 0 && numGranted > 1 &&
+        _budget->metrics.lastPixelsDecoded > _budget->pixelsPerVsync) {
+      _numOverGranted += 1;
+    }
+  }
+}
+
+// Without a limit every frame of every player is decoded on time
+
+- (void)testNoLimit {
+  decode_budget_init(_budget, 0);
+
+  for (int i = 0; i < 4; i++) {
+    int index = decode_budget_add_player(_budget, 1920, 1080, 2, 1.0 / 30.0);
+    XCTAssert(index == i);
+    decode_budget_set_view(_budget, index, 400, 300, 1);
+  }
+
+  [self runVsyncs:0 count:120];
+
+  DecodeBudgetMetrics *metrics = &_budget->metrics;
+
+  {
+    int v = (int) metrics->numDecoded;
+    int expectedVal = 4 * 60;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(metrics->numDropped == 0);
+  XCTAssert(metrics->numSkipped == 0);
+  XCTAssert(metrics->numLate == 0);
+}
+
+// The budget fits one frame per vsync. Two 30 FPS players come due
+// at the same vsync, the larger view is decoded on time and the
+// smaller view one vsync late, no frame is dropped.
+
+- (void)testLargerViewFirst {
+  decode_budget_init(_budget, 1920 * 1080 * 2);
+
+  int small = decode_budget_add_player(_budget, 1920, 1080, 2, 1.0 / 30.0);
+  int large = decode_budget_add_player(_budget, 1920, 1080, 2, 1.0 / 30.0);
+
+  decode_budget_set_view(_budget, small, 320, 240, 1);
+  decode_budget_set_view(_budget, large, 1920, 1080, 1);
+
+  [self runVsyncs:0 count:120];
+
+  XCTAssert(_numOverGranted == 0, @"%d vsyncs over budget", _numOverGranted);
+
+  DecodeBudgetPlayerMetrics *smallMetrics = &_budget->players[small].metrics;
+  DecodeBudgetPlayerMetrics *largeMetrics = &_budget->players[large].metrics;
+
+  {
+    int v = (int) largeMetrics->numDecoded;
+    int expectedVal = 60;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(largeMetrics->numLate == 0);
+
+  {
+    int v = (int) smallMetrics->numDecoded;
+    int expectedVal = 60;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) smallMetrics->numLate;
+    int expectedVal = 60;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(_budget->metrics.numDropped == 0);
+}
+
+// Three 60 FPS players and a budget of one frame per vsync, a player
+// that dropped frames goes first so the smallest view keeps playing.
+
+- (void)testStarvedPlayerGoesFirst {
+  decode_budget_init(_budget, 1920 * 1080);
+
+  for (int i = 0; i < 3; i++) {
+    decode_budget_add_player(_budget, 1920, 1080, 1, 1.0 / 60.0);
+    decode_budget_set_view(_budget, i, 100 * (i + 1), 100 * (i + 1), 1);
+  }
+
+  [self runVsyncs:0 count:60];
+
+  XCTAssert(_numOverGranted == 0, @"%d vsyncs over budget", _numOverGranted);
+
+  {
+    int v = (int) _budget->metrics.numDecoded;
+    int expectedVal = 60;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  for (int i = 0; i < 3; i++) {
+    int v = (int) _budget->players[i].metrics.numDecoded;
+    XCTAssert(v >= 15, @"player %d decoded %d frames", i, v);
+  }
+}
+
+// A budget of one frame per vsync and two 60 FPS players. The low
+// priority player goes ahead of the high priority player each time
+// it has dropped DECODE_BUDGET_MAX_DROPS frames in a row, so it gets
+// every third vsync and the high priority player the other two.
+
+- (void)testStarvedPlayerBeforeHighestPriority {
+  decode_budget_init(_budget, 1920 * 1080);
+
+  int low = decode_budget_add_player(_budget, 1920, 1080, 1, 1.0 / 60.0);
+  int high = decode_budget_add_player(_budget, 1920, 1080, 1, 1.0 / 60.0);
+
+  decode_budget_set_view(_budget, low, 100, 100, 1);
+  decode_budget_set_view(_budget, high, 1000, 1000, 1);
+
+  // The high priority player goes first until the low priority
+  // player has dropped 2 frames
+
+  [self runVsyncs:0 count:2];
+
+  XCTAssert(decode_budget_decision(_budget, high) == DecodeBudgetDecode);
+  XCTAssert(decode_budget_decision(_budget, low) == DecodeBudgetSkip);
+
+  [self runVsyncs:2 count:1];
+
+  XCTAssert(decode_budget_decision(_budget, low) == DecodeBudgetDecode);
+  XCTAssert(decode_budget_decision(_budget, high) == DecodeBudgetSkip);
+
+  [self runVsyncs:3 count:57];
+
+  XCTAssert(_numOverGranted == 0, @"%d vsyncs over budget", _numOverGranted);
+
+  {
+    int v = (int) _budget->players[low].metrics.numDecoded;
+    int expectedVal = 20;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) _budget->players[high].metrics.numDecoded;
+    int expectedVal = 40;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) _budget->players[high].metrics.numSkipped;
+    int expectedVal = 20;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// A hidden view decodes nothing until it becomes visible
+
+- (void)testHiddenPlayer {
+  decode_budget_init(_budget, 0);
+
+  int index = decode_budget_add_player(_budget, 640, 480, 1, 1.0 / 30.0);
+  decode_budget_set_view(_budget, index, 640, 480, 0);
+
+  [self runVsyncs:0 count:60];
+
+  XCTAssert(_budget->players[index].metrics.numDecoded == 0);
+
+  {
+    int v = (int) _budget->metrics.numHiddenDropped;
+    int expectedVal = 30;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(_budget->metrics.numDropped == 0);
+
+  decode_budget_set_view(_budget, index, 640, 480, 1);
+
+  [self runVsyncs:60 count:60];
+
+  {
+    int v = (int) _budget->players[index].metrics.numDecoded;
+    int expectedVal = 30;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Four players over budget, the smaller views step down to smaller
+// renditions until no frame is dropped. When two players go away
+// the larger remaining view steps back up.
+
+- (void)testDowngradeThenUpgrade {
+  const int widths[3] = { 1920, 1280, 640 };
+  const int heights[3] = { 1080, 720, 360 };
+
+  decode_budget_init(_budget, 1920 * 1080 * 2);
+
+  for (int i = 0; i < 4; i++) {
+    decode_budget_add_player(_budget, 1920, 1080, 2, 1.0 / 30.0);
+    decode_budget_set_levels(_budget, i, 3, widths, heights);
+    decode_budget_set_view(_budget, i, 200 * (i + 1), 100 * (i + 1), 1);
+  }
+
+  [self runVsyncs:0 count:600];
+
+  XCTAssert(_numOverGranted == 0, @"%d vsyncs over budget", _numOverGranted);
+
+  XCTAssert(_budget->metrics.numDowngrades > 0);
+  XCTAssert(_budget->metrics.numUpgrades == 0);
+
+  // The largest view keeps the full size rendition
+
+  XCTAssert(decode_budget_level(_budget, 3) == 0);
+  XCTAssert(decode_budget_level(_budget, 0) == 2);
+
+  // Settled, nothing is dropped
+
+  uint64_t numDropped = _budget->metrics.numDropped;
+
+  [self runVsyncs:600 count:120];
+
+  XCTAssert(_budget->metrics.numDropped == numDropped);
+
+  decode_budget_remove_player(_budget, 3);
+  decode_budget_remove_player(_budget, 2);
+
+  [self runVsyncs:720 count:600];
+
+  XCTAssert(_budget->metrics.numUpgrades > 0);
+  XCTAssert(decode_budget_level(_budget, 1) < 2);
+}
+
+// Three views show one shared decoder and a fourth view another clip.
+// The budget fits one frame per vsync and each decoder is counted
+// once, so both 30 FPS players play every frame. A view that
+// diverges moves to a copy of the shared player.
+
+- (void)testViewsOfSharedPlayer {
+  const int widths[2] = { 1920, 960 };
+  const int heights[2] = { 1080, 540 };
+
+  decode_budget_init(_budget, 1920 * 1080);
+
+  int shared = decode_budget_add_player(_budget, 1920, 1080, 1, 1.0 / 30.0);
+  decode_budget_set_levels(_budget, shared, 2, widths, heights);
+
+  int views[3];
+
+  for (int i = 0; i < 3; i++) {
+    views[i] = decode_budget_add_view(_budget, shared);
+    decode_budget_set_view_size(_budget, views[i], 100 * (i + 1), 100 * (i + 1), 1);
+  }
+
+  int other = decode_budget_add_player(_budget, 1920, 1080, 1, 1.0 / 30.0);
+  int otherView = decode_budget_add_view(_budget, other);
+  decode_budget_set_view_size(_budget, otherView, 250, 250, 1);
+
+  XCTAssert(_budget->players[shared].numViews == 3);
+
+  // The shared player takes the size of its largest visible view
+
+  XCTAssert(_budget->players[shared].viewWidth == 300);
+
+  decode_budget_set_view_size(_budget, views[2], 300, 300, 0);
+
+  XCTAssert(_budget->players[shared].viewWidth == 200);
+  XCTAssert(_budget->players[shared].isVisible);
+
+  [self runVsyncs:0 count:120];
+
+  XCTAssert(_numOverGranted == 0, @"%d vsyncs over budget", _numOverGranted);
+
+  {
+    int v = (int) _budget->players[shared].metrics.numDecoded;
+    int expectedVal = 60;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) _budget->players[other].metrics.numDecoded;
+    int expectedVal = 60;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(_budget->metrics.numDropped == 0);
+
+  // View 0 diverges, its player has the cost and levels of the shared one
+
+  int copy = decode_budget_copy_player(_budget, shared);
+  decode_budget_move_view(_budget, views[0], copy);
+
+  XCTAssert(decode_budget_view_player(_budget, views[0]) == copy);
+  XCTAssert(_budget->players[copy].numLevels == 2);
+  XCTAssert(_budget->players[copy].viewWidth == 100);
+  XCTAssert(_budget->players[shared].numViews == 2);
+
+  // The shared player is removed with its last view
+
+  decode_budget_remove_view(_budget, views[1]);
+  XCTAssert(_budget->players[shared].inUse);
+
+  decode_budget_remove_view(_budget, views[2]);
+  XCTAssert(_budget->players[shared].inUse == 0);
+  XCTAssert(_budget->players[copy].inUse);
+}
+
+// The scheduler has a fixed number of players
+
+- (void)testFull {
+  decode_budget_init(_budget, 0);
+
+  for (int i = 0; i < DECODE_BUDGET_MAX_PLAYERS; i++) {
+    XCTAssert(decode_budget_add_player(_budget, 64, 64, 1, 1.0 / 30.0) == i);
+  }
+
+  XCTAssert(decode_budget_add_player(_budget, 64, 64, 1, 1.0 / 30.0) == -1);
+
+  decode_budget_remove_player(_budget, 5);
+
+  XCTAssert(decode_budget_add_player(_budget, 64, 64, 1, 1.0 / 30.0) == 5);
+}
+
+@end
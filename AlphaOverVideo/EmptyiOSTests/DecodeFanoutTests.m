@@ -0,0 +1,614 @@
+//
+//  DecodeFanoutTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "frame_pool.h"
+
+#import "decode_fanout.h"
+
+#import <QuartzCore/QuartzCore.h>
+
+#import "AOVFramePool.h"
+#import "AOVFrameSourceShared.h"
+#import "AOVFrameSourceVideo.h"
+
+// Synthetic decoder, each decode takes a handle from a frame pool
+// and records the frame number in it.
+
+typedef struct {
+  FramePool *pool;
+  int numOpen;
+  int numClose;
+  int numStart;
+  // open returns NULL when set
+  int failOpen;
+  // decode returns NULL the first time a frame number is asked for
+  int failFirstDecode;
+  int failedFrameNum;
+} SyntheticDecoderContext;
+
+typedef struct {
+  int64_t offset;
+  double startTime;
+  void *openArg;
+} SyntheticDecoder;
+
+static void* synthetic_open(void *context, uint64_t clipId, int64_t offset, void *openArg)
+{
+  SyntheticDecoderContext *ctx = (SyntheticDecoderContext *) context;
+  if (ctx->failOpen) {
+    return NULL;
+  }
+  ctx->numOpen += 1;
+  SyntheticDecoder *decoder = (SyntheticDecoder *) calloc(1, sizeof(SyntheticDecoder));
+  decoder->offset = offset;
+  decoder->openArg = openArg;
+  return decoder;
+}
+
+static void* synthetic_diverge_arg(void *context, void *decoder)
+{
+  return ((SyntheticDecoder *) decoder)->openArg;
+}
+
+static void synthetic_start(void *context, void *decoder, double startTime)
+{
+  SyntheticDecoderContext *ctx = (SyntheticDecoderContext *) context;
+  ctx->numStart += 1;
+  ((SyntheticDecoder *) decoder)->startTime = startTime;
+}
+
+static void* synthetic_decode(void *context, void *decoder, const DecodeFanoutRequest *request)
+{
+  SyntheticDecoderContext *ctx = (SyntheticDecoderContext *) context;
+  if (ctx->failFirstDecode && request->frameNum != ctx->failedFrameNum) {
+    ctx->failedFrameNum = request->frameNum;
+    return NULL;
+  }
+  FramePoolHandle *handle = frame_pool_acquire(ctx->pool);
+  if (handle == NULL) {
+    return NULL;
+  }
+  handle->timing.frameNum = request->frameNum;
+  handle->timing.hostTime = request->hostTime;
+  return handle;
+}
+
+static void synthetic_close(void *context, void *decoder)
+{
+  SyntheticDecoderContext *ctx = (SyntheticDecoderContext *) context;
+  ctx->numClose += 1;
+  free(decoder);
+}
+
+static void synthetic_retain_frame(void *context, void *frame)
+{
+  frame_pool_retain((FramePoolHandle *) frame);
+}
+
+static void synthetic_release_frame(void *context, void *frame)
+{
+  frame_pool_release((FramePoolHandle *) frame);
+}
+
+@interface DecodeFanoutTests : XCTestCase
+
+@end
+
+@implementation DecodeFanoutTests
+{
+  SyntheticDecoderContext _ctx;
+  DecodeFanout *_fanout;
+}
+
+- (void)setUp {
+  memset(&_ctx, 0, sizeof(_ctx));
+  _ctx.pool = frame_pool_create(FRAME_POOL_MAX_HANDLES, NULL, NULL);
+
+  DecodeFanoutDecoder decoder;
+  decoder.open = synthetic_open;
+  decoder.divergeArg = synthetic_diverge_arg;
+  decoder.start = synthetic_start;
+  decoder.decode = synthetic_decode;
+  decoder.close = synthetic_close;
+  decoder.retainFrame = synthetic_retain_frame;
+  decoder.releaseFrame = synthetic_release_frame;
+  decoder.context = &_ctx;
+
+  _fanout = (DecodeFanout *) malloc(sizeof(DecodeFanout));
+  decode_fanout_init(_fanout, &decoder);
+}
+
+- (void)tearDown {
+  free(_fanout);
+  frame_pool_close(_ctx.pool);
+}
+
+- (NSString*) resourcePath:(NSString*)filename
+{
+  NSString *testsDir = [[NSString stringWithUTF8String:__FILE__] stringByDeletingLastPathComponent];
+  NSString *resDir = [[testsDir stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"Resources"];
+  NSString *path = [resDir stringByAppendingPathComponent:filename];
+
+  if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
+    return path;
+  }
+
+  NSBundle *bundle = [NSBundle bundleForClass:self.class];
+  return [bundle pathForResource:[filename stringByDeletingPathExtension] ofType:[filename pathExtension]];
+}
+
+- (void) runFor:(CFTimeInterval)seconds
+{
+  [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:seconds]];
+}
+
+// 8 views show the same clip, every view gets every frame and each
+// frame is decoded once.
+
+- (void)testViewsShareOneDecoder {
+  const int numViews = 8;
+  const double frameDuration = 1.0 / 30.0;
+  const uint64_t clipId = decode_fanout_clip_id("Fireworks.m4v");
+
+  int subscribers[numViews];
+  FramePoolHandle *viewFrames[numViews];
+
+  for (int i = 0; i < numViews; i++) {
+    subscribers[i] = decode_fanout_subscribe(_fanout, clipId, 0, NULL);
+    XCTAssert(subscribers[i] != -1);
+    viewFrames[i] = NULL;
+  }
+
+  {
+    int v = _ctx.numOpen;
+    int expectedVal = 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // The first view starts the decoder, the others join it
+
+  XCTAssert(decode_fanout_start(_fanout, subscribers[0], 100.0, frameDuration) == 1);
+
+  for (int i = 1; i < numViews; i++) {
+    XCTAssert(decode_fanout_start(_fanout, subscribers[i], 200.0, frameDuration) == 0);
+  }
+
+  XCTAssert(_ctx.numStart == 1);
+
+  // 60 Hz display of 30 FPS video, frames are held by the views
+
+  int numWrong = 0;
+  const int numVsync = 120;
+
+  for (int vsync = 0; vsync < numVsync; vsync++) {
+    const double hostTime = 100.0 + (vsync * frameDuration / 2);
+
+    for (int i = 0; i < numViews; i++) {
+      FramePoolHandle *handle = decode_fanout_frame(_fanout, subscribers[i], hostTime, hostTime + frameDuration);
+
+      if (handle != NULL) {
+        if (handle->timing.frameNum != (vsync / 2)) {
+          numWrong += 1;
+        }
+        if (viewFrames[i] != NULL) {
+          frame_pool_release(viewFrames[i]);
+        }
+        viewFrames[i] = handle;
+      }
+    }
+  }
+
+  XCTAssert(numWrong == 0, @"%d frames for the wrong time", numWrong);
+
+  DecodeFanoutMetrics *metrics = &_fanout->metrics;
+
+  {
+    int v = (int) metrics->numFramesDecoded;
+    int expectedVal = numVsync / 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) metrics->numFramesDelivered;
+    int expectedVal = numViews * numVsync / 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) metrics->numFramesShared;
+    int expectedVal = (numViews - 1) * numVsync / 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Every view holds the same frame
+
+  for (int i = 1; i < numViews; i++) {
+    XCTAssert(viewFrames[i] == viewFrames[0]);
+  }
+
+  {
+    // Views plus the registry hold one frame
+    int v = atomic_load(&viewFrames[0]->refCount);
+    int expectedVal = numViews + 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  for (int i = 0; i < numViews; i++) {
+    frame_pool_release(viewFrames[i]);
+    decode_fanout_unsubscribe(_fanout, subscribers[i]);
+  }
+
+  XCTAssert(_ctx.numClose == 1);
+  XCTAssert(metrics->numOpenDecoders == 0);
+  XCTAssert(frame_pool_num_in_use(_ctx.pool) == 0);
+}
+
+// A different offset or clip is a different decoder
+
+- (void)testKeyedByClipAndOffset {
+  const uint64_t clipA = decode_fanout_clip_id("A.m4v");
+  const uint64_t clipB = decode_fanout_clip_id("B.m4v");
+
+  XCTAssert(clipA != clipB);
+
+  int sub1 = decode_fanout_subscribe(_fanout, clipA, 0, NULL);
+  int sub2 = decode_fanout_subscribe(_fanout, clipA, 500, NULL);
+  int sub3 = decode_fanout_subscribe(_fanout, clipB, 0, NULL);
+  int sub4 = decode_fanout_subscribe(_fanout, clipA, 500, NULL);
+
+  {
+    int v = _ctx.numOpen;
+    int expectedVal = 3;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(decode_fanout_subscriber_decoder(_fanout, sub2) == decode_fanout_subscriber_decoder(_fanout, sub4));
+  XCTAssert(decode_fanout_subscriber_decoder(_fanout, sub1) != decode_fanout_subscriber_decoder(_fanout, sub2));
+
+  // The decoder stays open until its last subscriber leaves
+
+  decode_fanout_unsubscribe(_fanout, sub2);
+  XCTAssert(_ctx.numClose == 0);
+  decode_fanout_unsubscribe(_fanout, sub4);
+  XCTAssert(_ctx.numClose == 1);
+
+  decode_fanout_unsubscribe(_fanout, sub1);
+  decode_fanout_unsubscribe(_fanout, sub3);
+
+  XCTAssert(_ctx.numClose == 3);
+  XCTAssert(_fanout->metrics.maxOpenDecoders == 3);
+}
+
+// A view that falls behind the shared playhead gets its own decoder,
+// opened with the openArg of the shared decoder, the other views keep
+// sharing.
+
+- (void)testDivergedViewGetsOwnDecoder {
+  const double frameDuration = 1.0 / 30.0;
+  const uint64_t clipId = decode_fanout_clip_id("Fireworks.m4v");
+  int openArg = 0;
+
+  int sub1 = decode_fanout_subscribe(_fanout, clipId, 0, &openArg);
+  int sub2 = decode_fanout_subscribe(_fanout, clipId, 0, &openArg);
+  int sub3 = decode_fanout_subscribe(_fanout, clipId, 0, &openArg);
+
+  decode_fanout_start(_fanout, sub1, 0.0, frameDuration);
+
+  FramePoolHandle *lastFrame3 = NULL;
+
+  for (int frameNum = 0; frameNum < 60; frameNum++) {
+    const double hostTime = frameNum * frameDuration;
+
+    FramePoolHandle *frame1 = decode_fanout_frame(_fanout, sub1, hostTime, hostTime);
+    FramePoolHandle *frame2 = decode_fanout_frame(_fanout, sub2, hostTime, hostTime);
+
+    // View 3 stalls for half a second after frame 30
+
+    const double hostTime3 = (frameNum < 30) ? hostTime : (hostTime - 0.5);
+    FramePoolHandle *frame3 = decode_fanout_frame(_fanout, sub3, hostTime3, hostTime3);
+
+    XCTAssert(frame1 != NULL && frame1 == frame2);
+
+    if (frame3 != NULL) {
+      XCTAssert(frame3->timing.frameNum == decode_fanout_frame_num(hostTime3, frameDuration));
+      if (lastFrame3 != NULL) {
+        frame_pool_release(lastFrame3);
+      }
+      lastFrame3 = frame3;
+    }
+
+    frame_pool_release(frame1);
+    frame_pool_release(frame2);
+  }
+
+  {
+    int v = (int) _fanout->metrics.numDivergences;
+    int expectedVal = 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(decode_fanout_subscriber_decoder(_fanout, sub1) == decode_fanout_subscriber_decoder(_fanout, sub2));
+  XCTAssert(decode_fanout_subscriber_decoder(_fanout, sub1) != decode_fanout_subscriber_decoder(_fanout, sub3));
+
+  XCTAssert(((SyntheticDecoder *) decode_fanout_subscriber_decoder(_fanout, sub3))->openArg == &openArg);
+
+  {
+    // The private decoder was started at the shared start time
+    int v = _ctx.numStart;
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  frame_pool_release(lastFrame3);
+
+  decode_fanout_unsubscribe(_fanout, sub1);
+  decode_fanout_unsubscribe(_fanout, sub2);
+  decode_fanout_unsubscribe(_fanout, sub3);
+
+  XCTAssert(_ctx.numClose == 2);
+  XCTAssert(frame_pool_num_in_use(_ctx.pool) == 0);
+}
+
+// 60 Hz display of 30 FPS video where no frame is ready at the first
+// vsync of each frame. The decode is tried again at the next vsync,
+// once per vsync, and both views get every frame.
+
+- (void)testRetryWhenNoFrameReady {
+  const double frameDuration = 1.0 / 30.0;
+  const uint64_t clipId = decode_fanout_clip_id("Fireworks.m4v");
+  const int numVsync = 120;
+
+  _ctx.failFirstDecode = 1;
+  _ctx.failedFrameNum = -1;
+
+  int subscribers[2];
+  int numFrames[2] = { 0, 0 };
+  int numWrong = 0;
+
+  subscribers[0] = decode_fanout_subscribe(_fanout, clipId, 0, NULL);
+  subscribers[1] = decode_fanout_subscribe(_fanout, clipId, 0, NULL);
+
+  decode_fanout_start(_fanout, subscribers[0], 0.0, frameDuration);
+
+  for (int vsync = 0; vsync < numVsync; vsync++) {
+    const double hostTime = vsync * frameDuration / 2;
+
+    for (int i = 0; i < 2; i++) {
+      FramePoolHandle *handle = decode_fanout_frame(_fanout, subscribers[i], hostTime, hostTime);
+
+      if (handle != NULL) {
+        numFrames[i] += 1;
+        if (handle->timing.frameNum != (vsync / 2)) {
+          numWrong += 1;
+        }
+        frame_pool_release(handle);
+      }
+    }
+  }
+
+  XCTAssert(numWrong == 0, @"%d frames for the wrong time", numWrong);
+
+  for (int i = 0; i < 2; i++) {
+    int v = numFrames[i];
+    int expectedVal = numVsync / 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // One failed and one successful decode for each frame
+    int v = (int) _fanout->metrics.numDecodeCalls;
+    int expectedVal = numVsync;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(_fanout->metrics.numDivergences == 0);
+
+  decode_fanout_unsubscribe(_fanout, subscribers[0]);
+  decode_fanout_unsubscribe(_fanout, subscribers[1]);
+
+  XCTAssert(frame_pool_num_in_use(_ctx.pool) == 0);
+}
+
+// A view that stops pulling frames while the other view keeps
+// playing has missed frames when it pulls again at the current time,
+// it moves to its own decoder.
+
+- (void)testStalledViewDiverges {
+  const double frameDuration = 1.0 / 30.0;
+  const uint64_t clipId = decode_fanout_clip_id("Fireworks.m4v");
+
+  int sub1 = decode_fanout_subscribe(_fanout, clipId, 0, NULL);
+  int sub2 = decode_fanout_subscribe(_fanout, clipId, 0, NULL);
+
+  decode_fanout_start(_fanout, sub1, 0.0, frameDuration);
+
+  int numWrong = 0;
+
+  for (int frameNum = 0; frameNum < 60; frameNum++) {
+    const double hostTime = frameNum * frameDuration;
+
+    FramePoolHandle *frame1 = decode_fanout_frame(_fanout, sub1, hostTime, hostTime);
+    frame_pool_release(frame1);
+
+    // View 2 pulls no frames from frame 20 to frame 29
+
+    if (frameNum >= 20 && frameNum < 30) {
+      continue;
+    }
+
+    FramePoolHandle *frame2 = decode_fanout_frame(_fanout, sub2, hostTime, hostTime);
+
+    if (frame2 == NULL || frame2->timing.frameNum != frameNum) {
+      numWrong += 1;
+    }
+
+    if (frame2 != NULL) {
+      frame_pool_release(frame2);
+    }
+
+    if (frameNum < 30) {
+      XCTAssert(decode_fanout_subscriber_decoder(_fanout, sub1) == decode_fanout_subscriber_decoder(_fanout, sub2));
+    }
+  }
+
+  XCTAssert(numWrong == 0, @"%d frames for the wrong time", numWrong);
+
+  {
+    int v = (int) _fanout->metrics.numDivergences;
+    int expectedVal = 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(decode_fanout_subscriber_decoder(_fanout, sub1) != decode_fanout_subscriber_decoder(_fanout, sub2));
+
+  decode_fanout_unsubscribe(_fanout, sub1);
+  decode_fanout_unsubscribe(_fanout, sub2);
+
+  XCTAssert(frame_pool_num_in_use(_ctx.pool) == 0);
+}
+
+// Nothing is delivered before the start and a failed open is reported
+
+- (void)testNotStartedAndOpenFailure {
+  const uint64_t clipId = decode_fanout_clip_id("A.m4v");
+
+  int sub = decode_fanout_subscribe(_fanout, clipId, 0, NULL);
+
+  XCTAssert(decode_fanout_frame(_fanout, sub, 1.0, 1.0) == NULL);
+  XCTAssert(_fanout->metrics.numDecodeCalls == 0);
+
+  _ctx.failOpen = 1;
+
+  XCTAssert(decode_fanout_subscribe(_fanout, clipId, 1, NULL) == -1);
+
+  // Joining an open decoder does not open another
+
+  int sub2 = decode_fanout_subscribe(_fanout, clipId, 0, NULL);
+  XCTAssert(sub2 != -1);
+
+  decode_fanout_unsubscribe(_fanout, sub);
+  decode_fanout_unsubscribe(_fanout, sub2);
+
+  XCTAssert(_ctx.numClose == 1);
+}
+
+// Two AOVFrameSourceShared views play CarSpin.m4v from one decoder.
+// The second view stalls, the frame source it continues on seeks to
+// the shared playhead, so its first frame is the frame of the shared
+// clock and not a frame from the start of the clip.
+
+- (void)testSharedDivergedViewFollowsSharedClock {
+  NSString *path = [self resourcePath:@"CarSpin.m4v"];
+
+  if (path == nil) {
+    return;
+  }
+
+  NSArray *urls = @[ [NSURL fileURLWithPath:path] ];
+
+  id<AOVFrameSource> (^factory)(void) = ^id<AOVFrameSource>{
+    AOVFrameSourceVideo *frameSource = [[AOVFrameSourceVideo alloc] init];
+    [frameSource loadFromURLs:urls];
+    return frameSource;
+  };
+
+  AOVFrameSourceShared *view1 = [[AOVFrameSourceShared alloc] initWithClipURLs:urls timeOffset:0.0 factory:factory];
+  AOVFrameSourceShared *view2 = [[AOVFrameSourceShared alloc] initWithClipURLs:urls timeOffset:0.0 factory:factory];
+
+  XCTAssert(view1 != nil && view2 != nil);
+  XCTAssert(view2.isShared);
+
+  // Start both views at the same host time the way AOVMTKView does
+
+  __block CFTimeInterval startTime = 0.0;
+  __block BOOL isStarted = FALSE;
+
+  __weak AOVFrameSourceShared *weakView1 = view1;
+  __weak AOVFrameSourceShared *weakView2 = view2;
+
+  view1.loadedBlock = ^(BOOL success){
+    XCTAssert(success);
+
+    [weakView1 playWithPreroll:1.0f block:^{
+      CFTimeInterval frameDuration = weakView1.frameDuration;
+      CFTimeInterval hostTime = CACurrentMediaTime() + frameDuration;
+      [weakView1 syncStart:1.0f itemTime:frameDuration atHostTime:hostTime];
+      [weakView2 syncStart:1.0f itemTime:frameDuration atHostTime:hostTime];
+      startTime = hostTime - frameDuration;
+      isStarted = TRUE;
+    }];
+  };
+
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+
+  while ((isStarted == FALSE || view1.isPlaying == FALSE) && [timeout timeIntervalSinceNow] > 0) {
+    [self runFor:0.01];
+  }
+
+  XCTAssert(view1.isPlaying, @"playback did not start");
+
+  if (view1.isPlaying == FALSE) {
+    return;
+  }
+
+  const double frameDuration = view1.frameDuration;
+
+  // Both views follow the shared playhead for a second
+
+  for (int i = 0; i < 60; i++) {
+    [self runFor:(1.0 / 60.0)];
+    CFTimeInterval hostTime = CACurrentMediaTime();
+    [[view1 frameForHostTime:hostTime hostPresentationTime:hostTime presentationTimePtr:NULL] releasePooledFrame];
+    [[view2 frameForHostTime:hostTime hostPresentationTime:hostTime presentationTimePtr:NULL] releasePooledFrame];
+  }
+
+  XCTAssert(view2.isShared);
+
+  // View 2 asks for a frame half a second behind the shared playhead
+
+  {
+    CFTimeInterval hostTime = CACurrentMediaTime() - 0.5;
+    [[view2 frameForHostTime:hostTime hostPresentationTime:hostTime presentationTimePtr:NULL] releasePooledFrame];
+  }
+
+  XCTAssert(view2.isShared == FALSE);
+
+  // The first frame of the private frame source
+
+  int frameNum = -1;
+  int expectedFrameNum = -1;
+
+  timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+
+  while (frameNum == -1 && [timeout timeIntervalSinceNow] > 0) {
+    [self runFor:(1.0 / 60.0)];
+    CFTimeInterval hostTime = CACurrentMediaTime();
+    [[view1 frameForHostTime:hostTime hostPresentationTime:hostTime presentationTimePtr:NULL] releasePooledFrame];
+
+    AOVFrame *frame = [view2 frameForHostTime:hostTime hostPresentationTime:hostTime presentationTimePtr:NULL];
+
+    if (frame != nil) {
+      frameNum = frame.frameNum;
+      expectedFrameNum = decode_fanout_frame_num(hostTime - startTime, frameDuration);
+      [frame releasePooledFrame];
+    }
+  }
+
+  XCTAssert(frameNum != -1, @"no frame after diverge");
+
+  // Display links and decode latency differ by a frame or two, a
+  // restart at the start of the clip would be 40 or more frames off
+
+  XCTAssert(abs(frameNum - expectedFrameNum) <= 2, @"frame %d != %d", frameNum, expectedFrameNum);
+  XCTAssert(expectedFrameNum >= 40, @"%d", expectedFrameNum);
+
+  [view1 stop];
+  [view2 stop];
+}
+
+@end
@@ -0,0 +1,193 @@
+//
+//  DecodePrecisionTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "decode_precision.h"
+
+@interface DecodePrecisionTests : XCTestCase
+
+@end
+
+@implementation DecodePrecisionTests
+
+// Every finite half survives a round trip through float and values
+// halfway between two halfs round to the even half.
+
+- (void)testHalfConversion {
+  int numWrong = 0;
+
+  for (uint32_t h = 0; h < 0x10000; h++) {
+    if (((h >> 10) & 0x1F) == 0x1F) {
+      continue;
+    }
+    float f = decode_precision_half_to_float((uint16_t) h);
+    if (decode_precision_float_to_half(f) != h) {
+      numWrong += 1;
+    }
+  }
+
+  XCTAssert(numWrong == 0, @"%d halfs changed in a round trip", numWrong);
+
+  {
+    int v = decode_precision_float_to_half(1.0f);
+    int expectedVal = 0x3C00;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // 1 + 2^-11 is halfway between 1.0 and the next half, rounds to 1.0
+    int v = decode_precision_float_to_half(1.0f + (1.0f / 2048.0f));
+    int expectedVal = 0x3C00;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // 1 + 3 * 2^-11 is halfway between 2 halfs, rounds up to the even one
+    int v = decode_precision_float_to_half(1.0f + (3.0f / 2048.0f));
+    int expectedVal = 0x3C02;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // Smallest subnormal half
+    int v = decode_precision_float_to_half(1.0f / 16777216.0f);
+    int expectedVal = 0x0001;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Walk all 2^24 Y Cb Cr inputs for each precision and gamma, the
+// Y range is split so that rows run in parallel.
+
+- (DecodePrecisionError) errorForGamma:(BT709Gamma)gamma
+                             precision:(DecodePrecision)precision
+{
+  DecodePrecisionError *errs = (DecodePrecisionError *) malloc(256 * sizeof(DecodePrecisionError));
+
+  dispatch_apply(256, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t Y) {
+    decode_precision_error(gamma, precision, (int) Y, (int) Y + 1, &errs[Y]);
+  });
+
+  DecodePrecisionError err;
+  memset(&err, 0, sizeof(err));
+
+  for (int Y = 0; Y < 256; Y++) {
+    err.numInputs += errs[Y].numInputs;
+    err.numDifferent += errs[Y].numDifferent;
+    if (errs[Y].maxStepError > err.maxStepError) {
+      err.maxStepError = errs[Y].maxStepError;
+    }
+    if (errs[Y].maxLinearError > err.maxLinearError) {
+      err.maxLinearError = errs[Y].maxLinearError;
+    }
+  }
+
+  free(errs);
+
+  return err;
+}
+
+// Half precision output is never more than one 8 bit step from
+// float32 output. sRGB8 output matches for a 1 to 1 decode but its
+// linear error is much larger than half, this is the error that a
+// resample averages into output pixels.
+
+- (void)testFullInputSpaceError {
+  const BT709Gamma gammas[] = { BT709GammaApple, BT709GammaSrgb, BT709GammaLinear };
+
+  for (int g = 0; g < 3; g++) {
+    DecodePrecisionError srgbErr = [self errorForGamma:gammas[g] precision:DecodePrecisionSRGB8];
+    DecodePrecisionError halfErr = [self errorForGamma:gammas[g] precision:DecodePrecisionFloat16];
+    DecodePrecisionError floatErr = [self errorForGamma:gammas[g] precision:DecodePrecisionFloat32];
+
+    XCTAssert(halfErr.numInputs == (256 * 256 * 256));
+
+    XCTAssert(halfErr.maxStepError <= 1, @"float16 max step error %d for gamma %d", halfErr.maxStepError, gammas[g]);
+    XCTAssert(halfErr.maxLinearError < (1.0f / 2048.0f), @"float16 max linear error %f for gamma %d", halfErr.maxLinearError, gammas[g]);
+
+    XCTAssert(srgbErr.maxStepError == 0, @"sRGB8 max step error %d for gamma %d", srgbErr.maxStepError, gammas[g]);
+    XCTAssert(srgbErr.maxLinearError > (8.0f * halfErr.maxLinearError), @"sRGB8 max linear error %f for gamma %d", srgbErr.maxLinearError, gammas[g]);
+
+    XCTAssert(floatErr.numDifferent == 0);
+    XCTAssert(floatErr.maxLinearError == 0.0f);
+
+    printf("gamma %d : sRGB8 linear error %f : float16 %u of %u inputs off by 1 step, linear error %f\n",
+           gammas[g], srgbErr.maxLinearError, halfErr.numDifferent, halfErr.numInputs, halfErr.maxLinearError);
+  }
+}
+
+// Intermediate bytes for 1280x720 video shown in a larger view
+
+- (void)testTraffic {
+  DecodePrecisionTraffic srgbTraffic = decode_precision_traffic(1280, 720, DecodePrecisionSRGB8);
+  DecodePrecisionTraffic halfTraffic = decode_precision_traffic(1280, 720, DecodePrecisionFloat16);
+  DecodePrecisionTraffic floatTraffic = decode_precision_traffic(1280, 720, DecodePrecisionFloat32);
+
+  {
+    int v = (int) srgbTraffic.textureBytes;
+    int expectedVal = 1280 * 720 * 4;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) (halfTraffic.bytesWritten + halfTraffic.bytesRead);
+    int expectedVal = 1280 * 720 * 8 * 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // float16 moves half the bytes of float32 each frame
+    int v = (int) ((floatTraffic.bytesWritten + floatTraffic.bytesRead) - (halfTraffic.bytesWritten + halfTraffic.bytesRead));
+    int expectedVal = 1280 * 720 * 8 * 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Benchmarks, CPU reference decode into each intermediate layout
+
+- (void) measureDecode:(DecodePrecision)precision
+{
+  const int width = 1280;
+  const int height = 720;
+
+  uint8_t *yPtr = (uint8_t *) malloc(width * height);
+  uint8_t *cbPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint8_t *crPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  const int outBytesPerRow = width * decode_precision_bytes_per_pixel(precision);
+  void *outPtr = malloc(outBytesPerRow * height);
+
+  for (int i = 0; i < (width * height); i++) {
+    yPtr[i] = (uint8_t) (i * 2654435761u >> 24);
+  }
+  for (int i = 0; i < ((width / 2) * (height / 2)); i++) {
+    cbPtr[i] = (uint8_t) (i * 40503u >> 8);
+    crPtr[i] = (uint8_t) (i * 2246822519u >> 24);
+  }
+
+  [self measureBlock:^{
+    decode_precision_frame(yPtr, cbPtr, crPtr, width, height, BT709GammaSrgb, precision, outPtr, outBytesPerRow);
+  }];
+
+  free(yPtr);
+  free(cbPtr);
+  free(crPtr);
+  free(outPtr);
+}
+
+- (void)testPerformance720pSRGB8 {
+  [self measureDecode:DecodePrecisionSRGB8];
+}
+
+- (void)testPerformance720pFloat16 {
+  [self measureDecode:DecodePrecisionFloat16];
+}
+
+- (void)testPerformance720pFloat32 {
+  [self measureDecode:DecodePrecisionFloat32];
+}
+
+@end
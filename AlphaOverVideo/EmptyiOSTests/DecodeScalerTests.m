@@ -0,0 +1,456 @@
+//
+//  DecodeScalerTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "decode_scaler.h"
+
+@interface DecodeScalerTests : XCTestCase
+
+@end
+
+@implementation DecodeScalerTests
+
+// Fill 4:2:0 planes with a pattern that changes on every pixel
+
+- (void) fillPlanes:(uint8_t*)yPtr
+                 cb:(uint8_t*)cbPtr
+                 cr:(uint8_t*)crPtr
+              width:(int)width
+             height:(int)height
+{
+  for (int i = 0; i < (width * height); i++) {
+    yPtr[i] = 16 + (((i * 2654435761u) >> 24) % 220);
+  }
+
+  for (int i = 0; i < ((width / 2) * (height / 2)); i++) {
+    cbPtr[i] = 16 + (((i * 40503u) >> 8) % 225);
+    crPtr[i] = 16 + (((i * 7919u) >> 4) % 225);
+  }
+}
+
+// Opaque output is the same as a full size decode followed by the
+// linear light resample, for each gamma and both down and up scaling.
+
+- (void)testMatchesTwoPass {
+  const int width = 64;
+  const int height = 48;
+  const int sizes[][2] = { { 32, 24 }, { 21, 16 }, { 64, 48 }, { 7, 5 }, { 100, 75 } };
+  const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+  const BT709Gamma gammas[] = { BT709GammaSrgb, BT709GammaApple, BT709GammaLinear };
+
+  uint8_t *yPtr = (uint8_t *) malloc(width * height);
+  uint8_t *cbPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint8_t *crPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint32_t *fullPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *expectedPixels = (uint32_t *) malloc(100 * 75 * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(100 * 75 * sizeof(uint32_t));
+
+  [self fillPlanes:yPtr cb:cbPtr cr:crPtr width:width height:height];
+
+  DecodeScalePlanes planes = { yPtr, cbPtr, crPtr, NULL };
+
+  for (int g = 0; g < 3; g++) {
+    const BT709Gamma gamma = gammas[g];
+
+    bt709_decode_frame(yPtr, cbPtr, crPtr, width, height, gamma, fullPixels, width);
+
+    for (int s = 0; s < numSizes; s++) {
+      const int outWidth = sizes[s][0];
+      const int outHeight = sizes[s][1];
+
+      LinearScaler linearScaler;
+      int err = linear_scaler_init(&linearScaler, LinearScaleKernelBilinear, (gamma == BT709GammaLinear), width, height, outWidth, outHeight, 1);
+      XCTAssert(err == 0);
+
+      linear_scaler_scale(&linearScaler, fullPixels, width, expectedPixels, outWidth);
+
+      DecodeScaler scaler;
+      err = decode_scaler_init(&scaler, LinearScaleKernelBilinear, gamma, width, height, outWidth, outHeight, 2);
+      XCTAssert(err == 0);
+
+      decode_scaler_scale(&scaler, &planes, outPixels, outWidth);
+
+      int numWrong = 0;
+
+      for (int i = 0; i < (outWidth * outHeight); i++) {
+        if (outPixels[i] != expectedPixels[i]) {
+          numWrong += 1;
+        }
+      }
+
+      XCTAssert(numWrong == 0, @"%d wrong pixels for gamma %d at %d x %d", numWrong, (int) gamma, outWidth, outHeight);
+
+      linear_scaler_free(&linearScaler);
+      decode_scaler_free(&scaler);
+    }
+  }
+
+  free(yPtr);
+  free(cbPtr);
+  free(crPtr);
+  free(fullPixels);
+  free(expectedPixels);
+  free(outPixels);
+}
+
+// 2 pass reference for an alpha video, the frame is decoded at full
+// size with the premultiplied color as stored, then color and alpha
+// are resampled in linear light and color is clamped to alpha.
+
+- (void) twoPassAlpha:(const DecodeScaler*)scaler
+               planes:(const DecodeScalePlanes*)planes
+            outPixels:(uint32_t*)outPixels
+{
+  const int width = scaler->inWidth;
+  const int height = scaler->inHeight;
+  const LinearScaleFilter *hFilter = &scaler->hFilter;
+  const LinearScaleFilter *vFilter = &scaler->vFilter;
+  const PremultiplyTables *tables = &scaler->tables;
+  const float scale = (float) (PM_ENCODE_TABLE_SIZE - 1);
+
+  uint32_t *fullPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint8_t alphaTable[256];
+
+  bt709_decode_frame(planes->yPtr, planes->cbPtr, planes->crPtr, width, height, BT709GammaSrgb, fullPixels, width);
+  bt709_decode_alpha_table(alphaTable);
+
+  for (int row = 0; row < scaler->outHeight; row++) {
+    for (int col = 0; col < scaler->outWidth; col++) {
+      double sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+      for (int ky = 0; ky < vFilter->maxTaps; ky++) {
+        const double wy = vFilter->weights[(row * vFilter->maxTaps) + ky];
+        const int y = vFilter->starts[row] + ky;
+
+        for (int kx = 0; kx < hFilter->maxTaps; kx++) {
+          const double w = wy * hFilter->weights[(col * hFilter->maxTaps) + kx];
+          const int x = hFilter->starts[col] + kx;
+          const uint32_t pixel = fullPixels[(y * width) + x];
+
+          for (int j = 0; j < 3; j++) {
+            sum[j] += w * tables->toLinear[(pixel >> (j * 8)) & 0xFF];
+          }
+
+          sum[3] += w * tables->alphaNorm[alphaTable[planes->alphaPtr[(y * width) + x]]];
+        }
+      }
+
+      const double An = fmin(fmax(sum[3], 0.0), 1.0);
+      const uint32_t A = (uint32_t) (An * 255.0 + 0.5);
+      uint32_t pixel = 0;
+
+      if (A > 0) {
+        pixel = A << 24;
+
+        for (int j = 0; j < 3; j++) {
+          const double c = fmin(fmax(sum[j], 0.0), An);
+          pixel |= ((uint32_t) tables->toSRGB[(int) (c * scale + 0.5)]) << (j * 8);
+        }
+      }
+
+      outPixels[(row * scaler->outWidth) + col] = pixel;
+    }
+  }
+
+  free(fullPixels);
+}
+
+// Alpha video stores premultiplied color, black under transparent
+// pixels. Transparent, opaque white and opaque pattern columns give
+// the same pixels as the 2 pass reference and every partially
+// transparent pixel is valid premultiplied color.
+
+- (void)testAlphaMatchesTwoPass {
+  const int width = 64;
+  const int height = 48;
+  const int outWidth = 21;
+  const int outHeight = 16;
+
+  uint8_t *yPtr = (uint8_t *) malloc(width * height);
+  uint8_t *cbPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint8_t *crPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint8_t *alphaPtr = (uint8_t *) malloc(width * height);
+  uint32_t *expectedPixels = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+
+  [self fillPlanes:yPtr cb:cbPtr cr:crPtr width:width height:height];
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      const int isTransparent = (col < 22);
+      const int isWhite = (col >= 22 && col < 42);
+
+      if (isTransparent) {
+        yPtr[(row * width) + col] = 16;
+      } else if (isWhite) {
+        yPtr[(row * width) + col] = 235;
+      }
+
+      if (isTransparent || isWhite) {
+        cbPtr[((row / 2) * (width / 2)) + (col / 2)] = 128;
+        crPtr[((row / 2) * (width / 2)) + (col / 2)] = 128;
+      }
+
+      alphaPtr[(row * width) + col] = isTransparent ? 16 : 235;
+    }
+  }
+
+  DecodeScalePlanes planes = { yPtr, cbPtr, crPtr, alphaPtr };
+
+  for (int kernel = LinearScaleKernelBilinear; kernel <= LinearScaleKernelLanczos3; kernel++) {
+    DecodeScaler scaler;
+    int err = decode_scaler_init(&scaler, (LinearScaleKernel) kernel, BT709GammaSrgb, width, height, outWidth, outHeight, 1);
+    XCTAssert(err == 0);
+
+    decode_scaler_scale(&scaler, &planes, outPixels, outWidth);
+
+    [self twoPassAlpha:&scaler planes:&planes outPixels:expectedPixels];
+
+    int numWrong = 0;
+    int numInvalid = 0;
+    int numPartial = 0;
+
+    for (int i = 0; i < (outWidth * outHeight); i++) {
+      const uint32_t pixel = outPixels[i];
+      const uint32_t A = pixel >> 24;
+
+      // Summation order can move a value by one byte
+
+      for (int j = 0; j < 32; j += 8) {
+        const int delta = (int) ((pixel >> j) & 0xFF) - (int) ((expectedPixels[i] >> j) & 0xFF);
+        if (abs(delta) > 1) {
+          numWrong += 1;
+          break;
+        }
+      }
+
+      if (A > 0 && A < 255) {
+        numPartial += 1;
+
+        // Color in linear light is not larger than alpha
+
+        for (int j = 0; j < 24; j += 8) {
+          if (scaler.tables.toLinear[(pixel >> j) & 0xFF] > (scaler.tables.alphaNorm[A] + (1.0f / 255.0f))) {
+            numInvalid += 1;
+            break;
+          }
+        }
+      }
+    }
+
+    XCTAssert(numWrong == 0, @"%d wrong pixels with %s", numWrong, linear_scale_kernel_name((LinearScaleKernel) kernel));
+    XCTAssert(numInvalid == 0, @"%d invalid premultiplied pixels with %s", numInvalid, linear_scale_kernel_name((LinearScaleKernel) kernel));
+    XCTAssert(numPartial > 0);
+
+    decode_scaler_free(&scaler);
+  }
+
+  free(yPtr);
+  free(cbPtr);
+  free(crPtr);
+  free(alphaPtr);
+  free(expectedPixels);
+  free(outPixels);
+}
+
+// Splitting rows into bands gives the same pixels as one band
+
+- (void)testBands {
+  const int width = 128;
+  const int height = 96;
+  const int outWidth = 45;
+  const int outHeight = 31;
+
+  uint8_t *yPtr = (uint8_t *) malloc(width * height);
+  uint8_t *cbPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint8_t *crPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint32_t *outPixels1 = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+  uint32_t *outPixels5 = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+
+  [self fillPlanes:yPtr cb:cbPtr cr:crPtr width:width height:height];
+
+  DecodeScalePlanes planes = { yPtr, cbPtr, crPtr, NULL };
+
+  DecodeScaler scaler1;
+  DecodeScaler scaler5;
+
+  int err = decode_scaler_init(&scaler1, LinearScaleKernelLanczos3, BT709GammaSrgb, width, height, outWidth, outHeight, 1);
+  XCTAssert(err == 0);
+  err = decode_scaler_init(&scaler5, LinearScaleKernelLanczos3, BT709GammaSrgb, width, height, outWidth, outHeight, 5);
+  XCTAssert(err == 0);
+
+  decode_scaler_scale(&scaler1, &planes, outPixels1, outWidth);
+  decode_scaler_scale(&scaler5, &planes, outPixels5, outWidth);
+
+  XCTAssert(memcmp(outPixels1, outPixels5, outWidth * outHeight * sizeof(uint32_t)) == 0);
+
+  // One band decodes each input row once
+
+  {
+    int v = scaler1.rowsDecoded[0];
+    int expectedVal = height;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  decode_scaler_free(&scaler1);
+  decode_scaler_free(&scaler5);
+
+  free(yPtr);
+  free(cbPtr);
+  free(crPtr);
+  free(outPixels1);
+  free(outPixels5);
+}
+
+- (void)testInvalidSizes {
+  DecodeScaler scaler;
+
+  int err = decode_scaler_init(&scaler, LinearScaleKernelBilinear, BT709GammaSrgb, 63, 48, 32, 24, 1);
+  XCTAssert(err == DS_ERR_SIZE);
+
+  err = decode_scaler_init(&scaler, LinearScaleKernelBilinear, BT709GammaSrgb, 64, 48, 0, 24, 1);
+  XCTAssert(err == DS_ERR_SIZE);
+}
+
+// Bytes moved and memory held per frame for a 2048 x 1536 video at
+// several downscale ratios. The 2 pass numbers use a BGRA sRGB
+// intermediate texture.
+
+- (void)testTraffic {
+  const int width = 2048;
+  const int height = 1536;
+  const int divisors[] = { 2, 3, 4, 8 };
+
+  for (int i = 0; i < 4; i++) {
+    const int outWidth = width / divisors[i];
+    const int outHeight = height / divisors[i];
+
+    DecodeScaleTraffic twoPass = decode_scaler_two_pass_traffic(width, height, outWidth, outHeight, 0, 4);
+    DecodeScaleTraffic fused = decode_scaler_fused_traffic(width, height, outWidth, outHeight, 0, LinearScaleKernelBilinear);
+
+    const uint64_t twoPassBytes = twoPass.bytesRead + twoPass.bytesWritten;
+    const uint64_t fusedBytes = fused.bytesRead + fused.bytesWritten;
+
+    NSLog(@"%4d x %4d : 2 pass %.2f MB moved %.2f MB held : fused %.2f MB moved %.3f MB held",
+          outWidth, outHeight,
+          twoPassBytes / 1000000.0, twoPass.peakBytes / 1000000.0,
+          fusedBytes / 1000000.0, fused.peakBytes / 1000000.0);
+
+    // The intermediate texture alone is 4 bytes per input pixel
+
+    XCTAssert((twoPassBytes - fusedBytes) == ((uint64_t) width * height * 4 * 2));
+    XCTAssert(fused.peakBytes < (twoPass.peakBytes / 100));
+  }
+}
+
+// The fused path decodes every tap for each output pixel. A slight
+// downscale decodes 25 pixels per output pixel where the 2 pass path
+// decodes about 1, so the view only uses it for larger downscales.
+
+- (void)testUseFused {
+  const int width = 2048;
+  const int height = 1536;
+
+  {
+    int v = (int) decode_scaler_fused_decodes(width, height, 1946, 1459, LinearScaleKernelBilinear);
+    int expectedVal = 25;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(decode_scaler_fused_decodes(width, height, 1946, 1459, LinearScaleKernelBilinear) >=
+            20 * decode_scaler_two_pass_decodes(width, height, 1946, 1459));
+
+  // Slight downscale
+
+  XCTAssert(decode_scaler_use_fused(width, height, 1946, 1459, 4) == 0);
+  XCTAssert(decode_scaler_use_fused(width, height, 1843, 1382, 4) == 0);
+
+  // Half, quarter and smaller
+
+  XCTAssert(decode_scaler_use_fused(width, height, 1024, 768, 4) == 1);
+  XCTAssert(decode_scaler_use_fused(width, height, 512, 384, 4) == 1);
+  XCTAssert(decode_scaler_use_fused(width, height, 64, 48, 4) == 1);
+
+  // A wider intermediate saves more bytes
+
+  XCTAssert(decode_scaler_use_fused(width, height, 1400, 1050, 4) == 0);
+  XCTAssert(decode_scaler_use_fused(width, height, 1400, 1050, 16) == 1);
+
+  // Upscale and invalid sizes
+
+  XCTAssert(decode_scaler_use_fused(width, height, 4096, 3072, 4) == 0);
+  XCTAssert(decode_scaler_use_fused(width, height, 2048, 3072, 4) == 0);
+  XCTAssert(decode_scaler_use_fused(width, height, 0, 768, 4) == 0);
+}
+
+// Benchmarks, fused decode and scale compared to a full size decode
+// followed by a resample
+
+- (void) measureDecodeScale:(int)outWidth
+                  outHeight:(int)outHeight
+                    isFused:(BOOL)isFused
+{
+  const int width = 2048;
+  const int height = 1536;
+
+  uint8_t *yPtr = (uint8_t *) malloc(width * height);
+  uint8_t *cbPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint8_t *crPtr = (uint8_t *) malloc((width / 2) * (height / 2));
+  uint32_t *fullPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+
+  [self fillPlanes:yPtr cb:cbPtr cr:crPtr width:width height:height];
+
+  DecodeScalePlanes planes = { yPtr, cbPtr, crPtr, NULL };
+  DecodeScalePlanes *planesPtr = &planes;
+
+  LinearScaler linearScaler;
+  LinearScaler *linearScalerPtr = &linearScaler;
+  DecodeScaler scaler;
+  DecodeScaler *scalerPtr = &scaler;
+
+  int err = linear_scaler_init(&linearScaler, LinearScaleKernelBilinear, 0, width, height, outWidth, outHeight, 1);
+  XCTAssert(err == 0);
+  err = decode_scaler_init(&scaler, LinearScaleKernelBilinear, BT709GammaSrgb, width, height, outWidth, outHeight, 1);
+  XCTAssert(err == 0);
+
+  [self measureBlock:^{
+    if (isFused) {
+      decode_scaler_scale(scalerPtr, planesPtr, outPixels, outWidth);
+    } else {
+      bt709_decode_frame(yPtr, cbPtr, crPtr, width, height, BT709GammaSrgb, fullPixels, width);
+      linear_scaler_scale(linearScalerPtr, fullPixels, width, outPixels, outWidth);
+    }
+  }];
+
+  linear_scaler_free(&linearScaler);
+  decode_scaler_free(&scaler);
+
+  free(yPtr);
+  free(cbPtr);
+  free(crPtr);
+  free(fullPixels);
+  free(outPixels);
+}
+
+- (void)testPerformanceHalfTwoPass {
+  [self measureDecodeScale:1024 outHeight:768 isFused:FALSE];
+}
+
+- (void)testPerformanceHalfFused {
+  [self measureDecodeScale:1024 outHeight:768 isFused:TRUE];
+}
+
+- (void)testPerformanceQuarterTwoPass {
+  [self measureDecodeScale:512 outHeight:384 isFused:FALSE];
+}
+
+- (void)testPerformanceQuarterFused {
+  [self measureDecodeScale:512 outHeight:384 isFused:TRUE];
+}
+
+@end
@@ -0,0 +1,114 @@
+//
+//  EncodeStatsTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "encode_stats.h"
+
+@interface EncodeStatsTests : XCTestCase
+
+@end
+
+@implementation EncodeStatsTests
+
+// Disabled stats record nothing
+
+- (void)testDisabled {
+  EncodeStats stats;
+  encode_stats_init(&stats, 0);
+
+  EncodeStatsMark mark;
+  encode_stats_begin(&stats, &mark);
+  encode_stats_end(&stats, EncodeStageDecode, &mark, 100, 0);
+  encode_stats_add_bytes_written(&stats, EncodeStageWrite, 100);
+
+  {
+    int v = (int) stats.stages[EncodeStageDecode].count;
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) stats.stages[EncodeStageWrite].bytesWritten;
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Each end adds one histogram sample along with the byte counts
+
+- (void)testCountsAndHistogram {
+  EncodeStats stats;
+  encode_stats_init(&stats, 1);
+
+  for (int i = 0; i < 10; i++) {
+    EncodeStatsMark mark;
+    encode_stats_begin(&stats, &mark);
+    encode_stats_end(&stats, EncodeStageConvert, &mark, 1000, 10);
+  }
+
+  const EncodeStageStats *s = &stats.stages[EncodeStageConvert];
+
+  {
+    int v = (int) s->count;
+    int expectedVal = 10;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) s->bytesRead;
+    int expectedVal = 10000;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) s->bytesWritten;
+    int expectedVal = 100;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  uint32_t numSamples = 0;
+  for (int i = 0; i < ENCODE_STATS_NUM_BUCKETS; i++) {
+    numSamples += s->wallHistogram[i];
+  }
+
+  {
+    int v = (int) numSamples;
+    int expectedVal = 10;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(s->peakRSSBytes > 0);
+  XCTAssert(encode_stats_percentile_ms(s, 90) <= (s->maxWallNanos / 1000000.0));
+}
+
+// Percentiles are the upper bound of the bucket, capped by the max
+
+- (void)testPercentile {
+  EncodeStageStats s;
+  memset(&s, 0, sizeof(s));
+
+  // 9 samples in [64, 128) us and 1 sample in [1024, 2048) us
+
+  s.count = 10;
+  s.wallHistogram[6] = 9;
+  s.wallHistogram[10] = 1;
+  s.maxWallNanos = 1500 * 1000;
+
+  {
+    int v = (int) round(encode_stats_percentile_ms(&s, 50) * 1000);
+    int expectedVal = 128;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) round(encode_stats_percentile_ms(&s, 100) * 1000);
+    int expectedVal = 1500;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+@end
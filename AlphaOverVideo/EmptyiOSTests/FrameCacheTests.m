@@ -0,0 +1,186 @@
+//
+//  FrameCacheTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "frame_cache.h"
+#import "png_writer.h"
+
+@interface FrameCacheTests : XCTestCase
+
+@end
+
+@implementation FrameCacheTests
+
+- (NSString*) tmpPath:(NSString*)filename
+{
+  return [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+}
+
+// Hashing in pieces gives the same key as hashing in one call
+
+- (void)testStreamingHash {
+  uint8_t bytes[200];
+
+  for (int i = 0; i < (int) sizeof(bytes); i++) {
+    bytes[i] = (uint8_t) ((i * 31) + 7);
+  }
+
+  for (int len = 0; len <= (int) sizeof(bytes); len++) {
+    FrameHashState oneState;
+    frame_hash_init(&oneState);
+    frame_hash_update(&oneState, bytes, len);
+    FrameCacheKey oneKey = frame_hash_final(&oneState);
+
+    FrameHashState pieceState;
+    frame_hash_init(&pieceState);
+    for (int i = 0; i < len; i += 5) {
+      frame_hash_update(&pieceState, bytes + i, ((len - i) < 5) ? (len - i) : 5);
+    }
+    FrameCacheKey pieceKey = frame_hash_final(&pieceState);
+
+    XCTAssert(frame_cache_key_equal(&oneKey, &pieceKey), @"len %d", len);
+  }
+}
+
+// Text chunks do not change the key, settings and pixels do
+
+- (void)testKeyForPngFile {
+  const int width = 16;
+  const int height = 8;
+  uint32_t pixels[width * height];
+
+  for (int i = 0; i < (width * height); i++) {
+    pixels[i] = 0xFF000000 | (i * 2654435761u);
+  }
+
+  NSString *path = [self tmpPath:@"frame_cache_a.png"];
+  NSString *textPath = [self tmpPath:@"frame_cache_b.png"];
+
+  int err = png_write_file([path fileSystemRepresentation], pixels, width, width, height, 0);
+  XCTAssert(err == 0);
+
+  // Copy with a tEXt chunk after the 8 byte signature and 25 byte IHDR chunk
+
+  NSData *data = [NSData dataWithContentsOfFile:path];
+  NSMutableData *textData = [NSMutableData dataWithBytes:data.bytes length:33];
+  const uint8_t textChunk[] = { 0, 0, 0, 5, 't', 'E', 'X', 't', 'a', 0, 'b', 'c', 'd', 0, 0, 0, 0 };
+  [textData appendBytes:textChunk length:sizeof(textChunk)];
+  [textData appendBytes:((const uint8_t *) data.bytes) + 33 length:data.length - 33];
+  [textData writeToFile:textPath atomically:TRUE];
+
+  FrameCacheKey key, textKey, srgbKey;
+
+  err = frame_cache_key_for_file([path fileSystemRepresentation], "gamma=apple", &key);
+  XCTAssert(err == 0);
+  err = frame_cache_key_for_file([textPath fileSystemRepresentation], "gamma=apple", &textKey);
+  XCTAssert(err == 0);
+  err = frame_cache_key_for_file([path fileSystemRepresentation], "gamma=srgb", &srgbKey);
+  XCTAssert(err == 0);
+
+  XCTAssert(frame_cache_key_equal(&key, &textKey));
+  XCTAssert(!frame_cache_key_equal(&key, &srgbKey));
+
+  pixels[0] ^= 1;
+  png_write_file([path fileSystemRepresentation], pixels, width, width, height, 0);
+
+  FrameCacheKey changedKey;
+  err = frame_cache_key_for_file([path fileSystemRepresentation], "gamma=apple", &changedKey);
+  XCTAssert(err == 0);
+  XCTAssert(!frame_cache_key_equal(&key, &changedKey));
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+  [[NSFileManager defaultManager] removeItemAtPath:textPath error:nil];
+}
+
+// Planes read back unchanged, a missing or truncated entry is a miss
+
+- (void)testWriteAndReadEntry {
+  NSString *cacheDir = [self tmpPath:@"frame_cache_test"];
+  [[NSFileManager defaultManager] createDirectoryAtPath:cacheDir withIntermediateDirectories:TRUE attributes:nil error:nil];
+
+  const int width = 64;
+  const int height = 32;
+  uint8_t Y[width * height];
+  uint8_t Cb[(width / 2) * (height / 2)];
+  uint8_t Cr[(width / 2) * (height / 2)];
+
+  for (int i = 0; i < (int) sizeof(Y); i++) {
+    Y[i] = (uint8_t) i;
+  }
+  for (int i = 0; i < (int) sizeof(Cb); i++) {
+    Cb[i] = (uint8_t) (i * 3);
+    Cr[i] = 128;
+  }
+
+  FrameCacheKey key = { 1, 2 };
+  FrameCacheKey otherKey = { 1, 3 };
+
+  FrameCacheStats stats;
+  memset(&stats, 0, sizeof(stats));
+
+  int err = frame_cache_write_entry([cacheDir fileSystemRepresentation], &key, width, height, Y, Cb, Cr, &stats);
+  XCTAssert(err == 0);
+  XCTAssert(stats.numBytesStored > 0);
+  XCTAssert(stats.numBytesStored < (sizeof(Y) + sizeof(Cb) + sizeof(Cr)));
+
+  FrameCacheEntry entry;
+  err = frame_cache_read_entry([cacheDir fileSystemRepresentation], &key, &entry);
+  XCTAssert(err == 0);
+
+  {
+    int v = entry.width;
+    int expectedVal = width;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = entry.height;
+    int expectedVal = height;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(memcmp(entry.planes[0], Y, sizeof(Y)) == 0);
+  XCTAssert(memcmp(entry.planes[1], Cb, sizeof(Cb)) == 0);
+  XCTAssert(memcmp(entry.planes[2], Cr, sizeof(Cr)) == 0);
+
+  frame_cache_entry_free(&entry);
+
+  err = frame_cache_read_entry([cacheDir fileSystemRepresentation], &otherKey, &entry);
+  XCTAssert(err == FRAME_CACHE_ERR_IO);
+
+  char path[4096];
+  frame_cache_entry_path([cacheDir fileSystemRepresentation], &key, path, sizeof(path));
+  truncate(path, 100);
+
+  err = frame_cache_read_entry([cacheDir fileSystemRepresentation], &key, &entry);
+  XCTAssert(err == FRAME_CACHE_ERR_MALFORMED);
+
+  [[NSFileManager defaultManager] removeItemAtPath:cacheDir error:nil];
+}
+
+// Hash 4 MB, about the size of a 1080p RGBA PNG
+
+- (void)testPerformanceHash {
+  const int numBytes = 4 * 1024 * 1024;
+  uint8_t *bytes = (uint8_t *) malloc(numBytes);
+
+  for (int i = 0; i < numBytes; i++) {
+    bytes[i] = (uint8_t) (i * 13);
+  }
+
+  [self measureBlock:^{
+    FrameHashState state;
+    frame_hash_init(&state);
+    frame_hash_update(&state, bytes, numBytes);
+    FrameCacheKey key = frame_hash_final(&state);
+    XCTAssert(key.h1 != 0);
+  }];
+
+  free(bytes);
+}
+
+@end
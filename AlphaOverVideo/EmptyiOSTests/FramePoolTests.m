@@ -0,0 +1,590 @@
+//
+//  FramePoolTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <CoreVideo/CoreVideo.h>
+
+#import <MetalKit/MetalKit.h>
+
+#import <pthread.h>
+#import <dlfcn.h>
+#import <execinfo.h>
+
+#import "frame_pool.h"
+
+#import "AOVFramePool.h"
+
+#import "AOVFrameSourceVideo.h"
+#import "AOVFrameSourceAlphaVideo.h"
+#import "AOVMTKView.h"
+
+// Allocation counting harness. libmalloc invokes malloc_logger for
+// every allocation once it is set, this is the hook malloc stack
+// logging is built on. Only allocations made by the thread that
+// started counting are counted, so that allocations from other
+// threads in the test process are ignored.
+
+typedef void (malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip);
+
+extern malloc_logger_t *malloc_logger;
+
+#define MALLOC_LOG_TYPE_ALLOCATE 2
+
+static pthread_t countingThread;
+static volatile int numAllocations = 0;
+
+// When countedImage is set, only allocations requested by code in that
+// image are counted. The first caller outside of this logger, the
+// system libraries, CoreFoundation and Foundation decides, so buffers
+// that AVFoundation allocates for itself are not counted while an
+// NSLog or an autoreleased object made by AlphaOverVideo code is.
+
+static const void *countedImage = NULL;
+static volatile int isInLogger = 0;
+
+static int is_runtime_image(const char *path)
+{
+  return (strstr(path, "/usr/lib/") != NULL) ||
+    (strstr(path, "/CoreFoundation.framework/") != NULL) ||
+    (strstr(path, "/Foundation.framework/") != NULL);
+}
+
+static int is_counted_caller()
+{
+  void *frames[64];
+  int numFrames = backtrace(frames, 64);
+
+  Dl_info loggerInfo;
+  dladdr((const void *) is_counted_caller, &loggerInfo);
+
+  for (int i = 0; i < numFrames; i++) {
+    Dl_info info;
+
+    if (dladdr(frames[i], &info) == 0 || info.dli_fname == NULL) {
+      continue;
+    }
+
+    if (info.dli_fbase == countedImage) {
+      return 1;
+    }
+
+    if (info.dli_fbase == loggerInfo.dli_fbase || is_runtime_image(info.dli_fname)) {
+      continue;
+    }
+
+    return 0;
+  }
+
+  return 0;
+}
+
+static void count_allocations(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip)
+{
+  if ((type & MALLOC_LOG_TYPE_ALLOCATE) && pthread_equal(pthread_self(), countingThread) && (isInLogger == 0)) {
+    isInLogger = 1;
+
+    if (countedImage == NULL || is_counted_caller()) {
+      numAllocations += 1;
+    }
+
+    isInLogger = 0;
+  }
+}
+
+static void start_counting_allocations()
+{
+  countingThread = pthread_self();
+  numAllocations = 0;
+  countedImage = NULL;
+  malloc_logger = count_allocations;
+}
+
+// Count only allocations made by code in the image that defines aClass
+
+static void start_counting_allocations_of_image(Class aClass)
+{
+  Dl_info info;
+  dladdr((__bridge const void *) aClass, &info);
+
+  countingThread = pthread_self();
+  numAllocations = 0;
+  countedImage = info.dli_fbase;
+  malloc_logger = count_allocations;
+}
+
+static int stop_counting_allocations()
+{
+  malloc_logger = NULL;
+  return numAllocations;
+}
+
+// Fake buffers count retain and release calls
+
+static int numBufferRetains = 0;
+static int numBufferReleases = 0;
+
+static void count_buffer_retain(void *buffer)
+{
+  numBufferRetains += 1;
+}
+
+static void count_buffer_release(void *buffer)
+{
+  numBufferReleases += 1;
+}
+
+@interface FramePoolTests : XCTestCase
+
+@end
+
+@implementation FramePoolTests
+
+- (NSString*) resourcePath:(NSString*)filename
+{
+  NSString *testsDir = [[NSString stringWithUTF8String:__FILE__] stringByDeletingLastPathComponent];
+  NSString *resDir = [[testsDir stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"Resources"];
+  NSString *path = [resDir stringByAppendingPathComponent:filename];
+
+  if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
+    return path;
+  }
+
+  NSBundle *bundle = [NSBundle bundleForClass:self.class];
+  return [bundle pathForResource:[filename stringByDeletingPathExtension] ofType:[filename pathExtension]];
+}
+
+// The harness itself must see an allocation
+
+- (void)testAllocationCounter {
+  start_counting_allocations();
+  void *ptr = malloc(64);
+  int count = stop_counting_allocations();
+  free(ptr);
+
+  XCTAssert(count >= 1, @"%d allocations", count);
+}
+
+// Allocations are attributed to the code that asked for them, an
+// NSLog made from the framework counts and one made here does not
+
+- (void)testAllocationCounterImage {
+  AOVFramePool *pool = [[AOVFramePool alloc] initWithCapacity:1];
+
+  start_counting_allocations_of_image(AOVFramePool.class);
+  NSString *str = [NSString stringWithFormat:@"%d %@", 1, @"test"];
+  int count = stop_counting_allocations();
+
+  XCTAssert(str.length > 0);
+  XCTAssert(count == 0, @"%d allocations", count);
+
+  start_counting_allocations_of_image(AOVFramePool.class);
+  NSString *description = [pool description];
+  count = stop_counting_allocations();
+
+  XCTAssert(description.length > 0);
+  XCTAssert(count >= 1, @"%d allocations", count);
+}
+
+- (void)testRetainRelease {
+  numBufferRetains = 0;
+  numBufferReleases = 0;
+
+  FramePool *pool = frame_pool_create(2, count_buffer_retain, count_buffer_release);
+  XCTAssert(pool != NULL);
+
+  int buffer1;
+  int buffer2;
+
+  FramePoolHandle *handle = frame_pool_acquire(pool);
+  XCTAssert(handle != NULL);
+  XCTAssert(handle->timing.frameNum == -1);
+
+  frame_pool_set_buffer(handle, 0, &buffer1);
+  frame_pool_set_buffer(handle, 1, &buffer2);
+  frame_pool_retain(handle);
+  frame_pool_release(handle);
+
+  {
+    int v = frame_pool_num_in_use(pool);
+    int expectedVal = 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(numBufferReleases == 0);
+
+  frame_pool_release(handle);
+
+  {
+    int v = frame_pool_num_in_use(pool);
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = numBufferReleases;
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Every handle in use
+
+  FramePoolHandle *handle1 = frame_pool_acquire(pool);
+  FramePoolHandle *handle2 = frame_pool_acquire(pool);
+  XCTAssert(handle1 != NULL && handle2 != NULL && handle1 != handle2);
+  XCTAssert(frame_pool_acquire(pool) == NULL);
+  XCTAssert(pool->numExhausted == 1);
+
+  // Handles held after close stay valid, the pool is freed by the last release
+
+  frame_pool_close(pool);
+  frame_pool_set_buffer(handle1, 0, &buffer1);
+  frame_pool_release(handle1);
+  frame_pool_release(handle2);
+
+  XCTAssert(numBufferRetains == numBufferReleases);
+
+  XCTAssert(frame_pool_create(0, NULL, NULL) == NULL);
+  XCTAssert(frame_pool_create(FRAME_POOL_MAX_HANDLES + 1, NULL, NULL) == NULL);
+}
+
+- (void)testHistoryAndLog {
+  FrameVsyncHistory history;
+  memset(&history, 0, sizeof(history));
+
+  XCTAssert(frame_vsync_history_last(&history) == 0);
+
+  for (int i = 1; i <= 5; i++) {
+    frame_vsync_history_add(&history, i * 0.5);
+  }
+
+  XCTAssert(history.count == FRAME_VSYNC_HISTORY_SIZE);
+  XCTAssert(frame_vsync_history_last(&history) == 2.5);
+
+  FrameTimingLog *log = (FrameTimingLog *) calloc(1, sizeof(FrameTimingLog));
+
+  for (int i = 0; i < (FRAME_TIMING_LOG_SIZE + 10); i++) {
+    FrameTimingRecord record = { i, i, i, i };
+    frame_timing_log_add(log, &record);
+  }
+
+  {
+    int v = frame_timing_log_length(log);
+    int expectedVal = FRAME_TIMING_LOG_SIZE;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = frame_timing_log_get(log, 0)->frameNum;
+    int expectedVal = 10;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  free(log);
+}
+
+// Steady state of an alpha video in a view : RGB and alpha frames are
+// decoded, alpha is merged into the RGB frame, one frame in 7 is held
+// over and the view keeps the current and previous frames.
+
+- (void)testSteadyStateHandlesDoNotAllocate {
+  numBufferRetains = 0;
+  numBufferReleases = 0;
+
+  FramePool *rgbPool = frame_pool_create(8, count_buffer_retain, count_buffer_release);
+  FramePool *alphaPool = frame_pool_create(8, count_buffer_retain, count_buffer_release);
+
+  FramePoolHandle *prevHandle = NULL;
+  FramePoolHandle *currentHandle = NULL;
+  FramePoolHandle *heldHandle = NULL;
+
+  int rgbBuffer;
+  int alphaBuffer;
+  int numNull = 0;
+
+  start_counting_allocations();
+
+  for (int i = 0; i < 10000; i++) {
+    FramePoolHandle *rgbHandle = frame_pool_acquire(rgbPool);
+    FramePoolHandle *alphaHandle = frame_pool_acquire(alphaPool);
+
+    if (rgbHandle == NULL || alphaHandle == NULL) {
+      numNull += 1;
+      break;
+    }
+
+    frame_pool_set_buffer(rgbHandle, 0, &rgbBuffer);
+    frame_pool_set_buffer(alphaHandle, 0, &alphaBuffer);
+    rgbHandle->timing.frameNum = i;
+    alphaHandle->timing.frameNum = i;
+
+    frame_pool_set_buffer(rgbHandle, 1, alphaHandle->buffers[0]);
+    frame_pool_release(alphaHandle);
+
+    if ((i % 7) == 0) {
+      if (heldHandle != NULL) {
+        frame_pool_release(heldHandle);
+      }
+      heldHandle = rgbHandle;
+      continue;
+    }
+
+    if (prevHandle != NULL) {
+      frame_pool_release(prevHandle);
+    }
+    prevHandle = currentHandle;
+    currentHandle = rgbHandle;
+  }
+
+  int count = stop_counting_allocations();
+
+  XCTAssert(count == 0, @"%d allocations", count);
+  XCTAssert(numNull == 0);
+  XCTAssert(rgbPool->maxInUse <= 4, @"max in use %d", rgbPool->maxInUse);
+
+  frame_pool_release(prevHandle);
+  frame_pool_release(currentHandle);
+  frame_pool_release(heldHandle);
+
+  XCTAssert(frame_pool_num_in_use(rgbPool) == 0);
+  XCTAssert(frame_pool_num_in_use(alphaPool) == 0);
+  XCTAssert(numBufferRetains == numBufferReleases);
+
+  frame_pool_close(rgbPool);
+  frame_pool_close(alphaPool);
+}
+
+// Same handoff with AOVFrame objects from AOVFramePool and CoreVideo
+// pixel buffers, the first frames warm up the autorelease pool.
+
+- (void) handoffFrames:(int)numFrames
+               rgbPool:(AOVFramePool*)rgbPool
+             alphaPool:(AOVFramePool*)alphaPool
+             rgbBuffer:(CVPixelBufferRef)rgbBuffer
+           alphaBuffer:(CVPixelBufferRef)alphaBuffer
+              prevPtr:(AOVFrame * __strong *)prevPtr
+           currentPtr:(AOVFrame * __strong *)currentPtr
+{
+  for (int i = 0; i < numFrames; i++) {
+    AOVFrame *rgbFrame = [rgbPool acquireFrame];
+    AOVFrame *alphaFrame = [alphaPool acquireFrame];
+
+    rgbFrame.yCbCrPixelBuffer = rgbBuffer;
+    rgbFrame.frameNum = i;
+    alphaFrame.yCbCrPixelBuffer = alphaBuffer;
+    alphaFrame.frameNum = i;
+
+    rgbFrame.alphaPixelBuffer = alphaFrame.yCbCrPixelBuffer;
+    [alphaFrame releasePooledFrame];
+
+    [*prevPtr releasePooledFrame];
+    *prevPtr = *currentPtr;
+    *currentPtr = rgbFrame;
+  }
+}
+
+- (void)testSteadyStateFramesDoNotAllocate {
+  CVPixelBufferRef rgbBuffer = NULL;
+  CVPixelBufferRef alphaBuffer = NULL;
+
+  CVPixelBufferCreate(kCFAllocatorDefault, 64, 64, kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange, NULL, &rgbBuffer);
+  CVPixelBufferCreate(kCFAllocatorDefault, 64, 64, kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange, NULL, &alphaBuffer);
+  XCTAssert(rgbBuffer != NULL && alphaBuffer != NULL);
+
+  const int rgbRetainCount = (int) CFGetRetainCount(rgbBuffer);
+
+  AOVFramePool *rgbPool = [[AOVFramePool alloc] initWithCapacity:AOV_FRAME_POOL_CAPACITY];
+  AOVFramePool *alphaPool = [[AOVFramePool alloc] initWithCapacity:AOV_FRAME_POOL_CAPACITY];
+
+  AOVFrame *prevFrame = nil;
+  AOVFrame *currentFrame = nil;
+
+  @autoreleasepool {
+    [self handoffFrames:4 rgbPool:rgbPool alphaPool:alphaPool rgbBuffer:rgbBuffer alphaBuffer:alphaBuffer prevPtr:&prevFrame currentPtr:&currentFrame];
+
+    start_counting_allocations();
+
+    [self handoffFrames:10000 rgbPool:rgbPool alphaPool:alphaPool rgbBuffer:rgbBuffer alphaBuffer:alphaBuffer prevPtr:&prevFrame currentPtr:&currentFrame];
+
+    int count = stop_counting_allocations();
+
+    XCTAssert(count == 0, @"%d allocations", count);
+  }
+
+  XCTAssert(currentFrame.frameNum == 9999);
+  XCTAssert(currentFrame.alphaPixelBuffer == alphaBuffer);
+  XCTAssert(rgbPool.numFramesInUse == 2);
+  XCTAssert(alphaPool.numFramesInUse == 0);
+  XCTAssert(rgbPool.numExhausted == 0);
+
+  [prevFrame releasePooledFrame];
+  [currentFrame releasePooledFrame];
+  prevFrame = nil;
+  currentFrame = nil;
+
+  {
+    int v = (int) CFGetRetainCount(rgbBuffer);
+    int expectedVal = rgbRetainCount;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  CVPixelBufferRelease(rgbBuffer);
+  CVPixelBufferRelease(alphaBuffer);
+}
+
+// Load a frame source and start playback the way AOVMTKView does,
+// returns FALSE when playback did not start.
+
+- (BOOL) playFrameSource:(id<AOVFrameSource>)frameSource
+               loadBlock:(BOOL (^)(void))loadBlock
+{
+  __block BOOL isLoaded = FALSE;
+  __block BOOL isStarted = FALSE;
+
+  __weak id<AOVFrameSource> weakFrameSource = frameSource;
+
+  frameSource.loadedBlock = ^(BOOL success){
+    if (success == FALSE || isLoaded) {
+      return;
+    }
+
+    isLoaded = TRUE;
+
+    [weakFrameSource playWithPreroll:1.0f block:^{
+      CFTimeInterval frameDuration = weakFrameSource.frameDuration;
+      [weakFrameSource syncStart:1.0f itemTime:frameDuration atHostTime:CACurrentMediaTime() + frameDuration];
+      isStarted = TRUE;
+    }];
+  };
+
+  if (loadBlock() == FALSE) {
+    return FALSE;
+  }
+
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+
+  while ((isStarted == FALSE || frameSource.isPlaying == FALSE) && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+
+  return frameSource.isPlaying;
+}
+
+// Pull frames for numVsyncs vsyncs of a 60 Hz display and hand each
+// frame to the view, the calls displayLinkCallback makes. Allocations
+// made by AlphaOverVideo code during these calls are counted when
+// isCounting is set. Returns the number of frames delivered.
+
+- (int) pullFrames:(id<AOVFrameSource>)frameSource
+              view:(AOVMTKView*)view
+         numVsyncs:(int)numVsyncs
+        isCounting:(BOOL)isCounting
+    numAllocations:(int*)numAllocationsPtr
+{
+  const CFTimeInterval vsyncDuration = 1.0 / 60.0;
+
+  int numFrames = 0;
+  int count = 0;
+
+  for (int i = 0; i < numVsyncs; i++) {
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:vsyncDuration]];
+
+    CFTimeInterval hostTime = CACurrentMediaTime();
+
+    @autoreleasepool {
+      if (isCounting) {
+        start_counting_allocations_of_image(AOVFramePool.class);
+      }
+
+      AOVFrame *nextFrame = [frameSource frameForHostTime:hostTime hostPresentationTime:(hostTime + vsyncDuration) presentationTimePtr:NULL];
+
+      if (nextFrame != nil) {
+        [view nextFrameReady:nextFrame];
+        numFrames += 1;
+      }
+
+      nextFrame = nil;
+
+      if (isCounting) {
+        count += stop_counting_allocations();
+      }
+    }
+  }
+
+  *numAllocationsPtr = count;
+  return numFrames;
+}
+
+// Play a frame source into a view, once the first frames have warmed
+// up the pools, 2 seconds of frames must not allocate. Counting stops
+// before the preload of the next loop a second before the end.
+
+- (void) checkFrameSourceDoesNotAllocate:(id<AOVFrameSource>)frameSource
+                               loadBlock:(BOOL (^)(void))loadBlock
+{
+  BOOL worked = [self playFrameSource:frameSource loadBlock:loadBlock];
+  XCTAssert(worked, @"playback did not start");
+
+  if (worked == FALSE) {
+    return;
+  }
+
+  AOVMTKView *view = [[AOVMTKView alloc] initWithFrame:CGRectMake(0, 0, 64, 64) device:MTLCreateSystemDefaultDevice()];
+
+  int count = 0;
+
+  [self pullFrames:frameSource view:view numVsyncs:30 isCounting:FALSE numAllocations:&count];
+
+  int numFrames = [self pullFrames:frameSource view:view numVsyncs:120 isCounting:TRUE numAllocations:&count];
+
+  XCTAssert(count == 0, @"%d allocations", count);
+
+  // 30 FPS video, allow for a slow simulator
+
+  XCTAssert(numFrames >= 30, @"%d frames", numFrames);
+
+  [view nextFrameReady:nil];
+  [view nextFrameReady:nil];
+
+  [frameSource stop];
+}
+
+// AOVFrameSourceVideo frameForHostTime and frameForItemTime
+
+- (void)testVideoFramesDoNotAllocate {
+  NSString *path = [self resourcePath:@"CarSpin.m4v"];
+
+  if (path == nil) {
+    return;
+  }
+
+  AOVFrameSourceVideo *frameSource = [[AOVFrameSourceVideo alloc] init];
+
+  [self checkFrameSourceDoesNotAllocate:frameSource loadBlock:^BOOL{
+    return [frameSource loadFromURLs:@[ [NSURL fileURLWithPath:path] ]];
+  }];
+}
+
+// AOVFrameSourceAlphaVideo decodes both streams and merges alpha into
+// the RGB frame, held over frames are logged only when enabled
+
+- (void)testAlphaVideoFramesDoNotAllocate {
+  NSString *rgbPath = [self resourcePath:@"CarSpin.m4v"];
+  NSString *alphaPath = [self resourcePath:@"CarSpin_alpha.m4v"];
+
+  if (rgbPath == nil || alphaPath == nil) {
+    return;
+  }
+
+  AOVFrameSourceAlphaVideo *frameSource = [[AOVFrameSourceAlphaVideo alloc] init];
+
+  [self checkFrameSourceDoesNotAllocate:frameSource loadBlock:^BOOL{
+    NSArray *pair = @[ [NSURL fileURLWithPath:rgbPath], [NSURL fileURLWithPath:alphaPath] ];
+    return [frameSource loadFromURLs:@[ pair ]];
+  }];
+}
+
+@end
@@ -0,0 +1,204 @@
+//
+//  FrameRingTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "frame_ring.h"
+
+// Writes numFrames frames into a pipe, the first 4 bytes of each frame
+// hold the frame number and the rest is filled with the low byte.
+
+typedef struct {
+  int fd;
+  int numFrames;
+  size_t frameNumBytes;
+  size_t numExtraBytes;
+} FrameRingTestWriter;
+
+static
+void* frameRingTestWriterMain(void *arg)
+{
+  FrameRingTestWriter *writer = (FrameRingTestWriter *) arg;
+  uint8_t *frame = (uint8_t *) malloc(writer->frameNumBytes);
+
+  for (int i = 0; i < writer->numFrames; i++) {
+    memset(frame, i & 0xFF, writer->frameNumBytes);
+    memcpy(frame, &i, sizeof(i));
+    write(writer->fd, frame, writer->frameNumBytes);
+  }
+
+  if (writer->numExtraBytes > 0) {
+    write(writer->fd, frame, writer->numExtraBytes);
+  }
+
+  close(writer->fd);
+  free(frame);
+  return NULL;
+}
+
+typedef struct {
+  FrameRing *ring;
+  int fd;
+  size_t frameNumBytes;
+  int result;
+} FrameRingTestReader;
+
+static
+void* frameRingTestReaderMain(void *arg)
+{
+  FrameRingTestReader *reader = (FrameRingTestReader *) arg;
+  reader->result = frame_ring_fill_from_fd(reader->ring, reader->fd, reader->frameNumBytes);
+  return NULL;
+}
+
+@interface FrameRingTests : XCTestCase
+
+@end
+
+@implementation FrameRingTests
+
+// Pipe numFrames frames through a ring of numSlots slots, returns the
+// number of frames consumed in order and sets the reader result.
+
+- (int) pipeFrames:(int)numFrames
+        extraBytes:(size_t)numExtraBytes
+          numSlots:(int)numSlots
+     frameNumBytes:(size_t)frameNumBytes
+          consumer:(void (^)(const uint8_t *slot))consumer
+              ring:(FrameRing *)ring
+      readerResult:(int *)readerResultPtr
+{
+  int fds[2];
+  int err = pipe(fds);
+  XCTAssert(err == 0);
+
+  err = frame_ring_init(ring, numSlots, frameNumBytes);
+  XCTAssert(err == 0);
+
+  FrameRingTestWriter writer = { fds[1], numFrames, frameNumBytes, numExtraBytes };
+  FrameRingTestReader reader = { ring, fds[0], frameNumBytes, 0 };
+
+  pthread_t writerThread, readerThread;
+  pthread_create(&writerThread, NULL, frameRingTestWriterMain, &writer);
+  pthread_create(&readerThread, NULL, frameRingTestReaderMain, &reader);
+
+  int numInOrder = 0;
+
+  while (1) {
+    const uint8_t *slot = frame_ring_acquire_read(ring);
+
+    if (slot == NULL) {
+      break;
+    }
+
+    int frameNum;
+    memcpy(&frameNum, slot, sizeof(frameNum));
+
+    if (frameNum == numInOrder && slot[frameNumBytes - 1] == (numInOrder & 0xFF)) {
+      numInOrder += 1;
+    }
+
+    if (consumer != nil) {
+      consumer(slot);
+    }
+
+    frame_ring_release_read(ring);
+  }
+
+  pthread_join(readerThread, NULL);
+  pthread_join(writerThread, NULL);
+  close(fds[0]);
+
+  *readerResultPtr = reader.result;
+  return numInOrder;
+}
+
+// Every frame arrives in order and a slow consumer never lets the
+// producer fill more slots than the ring holds.
+
+- (void)testOrderAndBound {
+  FrameRing ring;
+  int readerResult = -1;
+
+  int numInOrder = [self pipeFrames:40 extraBytes:0 numSlots:3 frameNumBytes:100000 consumer:^(const uint8_t *slot) {
+    usleep(1000);
+  } ring:&ring readerResult:&readerResult];
+
+  {
+    int v = numInOrder;
+    int expectedVal = 40;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) ring.numFrames;
+    int expectedVal = 40;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(readerResult == 0);
+  XCTAssert(ring.maxCount <= 3);
+  XCTAssert(ring.producerWaitNanos > 0);
+
+  frame_ring_free(&ring);
+}
+
+// Input that stops part way through a frame is an error, the whole
+// frames before it are still delivered.
+
+- (void)testPartialFrame {
+  FrameRing ring;
+  int readerResult = -1;
+
+  int numInOrder = [self pipeFrames:5 extraBytes:10 numSlots:2 frameNumBytes:4096 consumer:nil ring:&ring readerResult:&readerResult];
+
+  {
+    int v = numInOrder;
+    int expectedVal = 5;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(readerResult == 1);
+
+  frame_ring_free(&ring);
+}
+
+// An aborted ring stops a producer that is waiting for a free slot
+
+- (void)testAbort {
+  FrameRing ring;
+  int err = frame_ring_init(&ring, 2, 64);
+  XCTAssert(err == 0);
+
+  for (int i = 0; i < 2; i++) {
+    uint8_t *slot = frame_ring_acquire_write(&ring);
+    XCTAssert(slot != NULL);
+    frame_ring_commit_write(&ring);
+  }
+
+  frame_ring_abort(&ring);
+
+  XCTAssert(frame_ring_acquire_write(&ring) == NULL);
+
+  frame_ring_free(&ring);
+}
+
+// Pipe 60 frames of 1080p BGRA
+
+- (void)testPerformancePipe1080p {
+  [self measureBlock:^{
+    FrameRing ring;
+    int readerResult = -1;
+
+    int numInOrder = [self pipeFrames:60 extraBytes:0 numSlots:4 frameNumBytes:(1920 * 1080 * 4) consumer:nil ring:&ring readerResult:&readerResult];
+
+    XCTAssert(numInOrder == 60);
+
+    frame_ring_free(&ring);
+  }];
+}
+
+@end
@@ -0,0 +1,269 @@
+//
+//  LinearScalerTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "linear_scaler.h"
+
+@interface LinearScalerTests : XCTestCase
+
+@end
+
+@implementation LinearScalerTests
+
+// Black and white pixels average to 50% linear light, sRGB 188 and not 128.
+// Pixels near the edge are skipped since edge taps reuse the edge pixel.
+
+- (void)testCheckerAveragesInLinearLight {
+  const int width = 64;
+  const int height = 64;
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc((width / 2) * (height / 2) * sizeof(uint32_t));
+
+  for (int i = 0; i < (width * height); i++) {
+    pixels[i] = (((i / width) + (i % width)) & 0x1) ? 0xFFFFFFFF : 0xFF000000;
+  }
+
+  for (int kernel = LinearScaleKernelBilinear; kernel <= LinearScaleKernelLanczos3; kernel++) {
+    LinearScaler scaler;
+    int err = linear_scaler_init(&scaler, (LinearScaleKernel) kernel, 0, width, height, width / 2, height / 2, 2);
+    XCTAssert(err == 0);
+
+    linear_scaler_scale(&scaler, pixels, width, outPixels, width / 2);
+
+    int numWrong = 0;
+
+    for (int row = 4; row < ((height / 2) - 4); row++) {
+      for (int col = 4; col < ((width / 2) - 4); col++) {
+        if (outPixels[(row * (width / 2)) + col] != 0xFFBCBCBC) {
+          numWrong += 1;
+        }
+      }
+    }
+
+    XCTAssert(numWrong == 0, @"%d wrong pixels with %s", numWrong, linear_scale_kernel_name((LinearScaleKernel) kernel));
+
+    linear_scaler_free(&scaler);
+  }
+
+  free(pixels);
+  free(outPixels);
+}
+
+// A solid color stays the same for every kernel, scaling down and up
+
+- (void)testSolidColor {
+  const uint32_t solidPixel = premultiply_pixel(0x80336699);
+  const int sizes[][4] = { { 256, 192, 128, 96 }, { 256, 192, 171, 129 }, { 64, 48, 100, 75 }, { 5, 3, 2, 2 }, { 1, 1, 3, 3 } };
+  const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  for (int kernel = LinearScaleKernelBilinear; kernel <= LinearScaleKernelLanczos3; kernel++) {
+    for (int s = 0; s < numSizes; s++) {
+      const int inWidth = sizes[s][0];
+      const int inHeight = sizes[s][1];
+      const int outWidth = sizes[s][2];
+      const int outHeight = sizes[s][3];
+
+      uint32_t *pixels = (uint32_t *) malloc(inWidth * inHeight * sizeof(uint32_t));
+      uint32_t *outPixels = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+
+      for (int i = 0; i < (inWidth * inHeight); i++) {
+        pixels[i] = solidPixel;
+      }
+
+      LinearScaler scaler;
+      int err = linear_scaler_init(&scaler, (LinearScaleKernel) kernel, 0, inWidth, inHeight, outWidth, outHeight, 3);
+      XCTAssert(err == 0);
+
+      linear_scaler_scale(&scaler, pixels, inWidth, outPixels, outWidth);
+
+      int numWrong = 0;
+
+      for (int i = 0; i < (outWidth * outHeight); i++) {
+        if (outPixels[i] != solidPixel) {
+          numWrong += 1;
+        }
+      }
+
+      XCTAssert(numWrong == 0, @"%d wrong pixels for %d x %d -> %d x %d with %s", numWrong, inWidth, inHeight, outWidth, outHeight, linear_scale_kernel_name((LinearScaleKernel) kernel));
+
+      linear_scaler_free(&scaler);
+
+      free(pixels);
+      free(outPixels);
+    }
+  }
+}
+
+// Weights are normalized and every tap reads a pixel inside the input
+
+- (void)testFilterWeights {
+  const int sizes[][2] = { { 2048, 1024 }, { 1920, 1280 }, { 100, 300 }, { 7, 3 }, { 3, 7 }, { 1, 5 }, { 5, 1 } };
+  const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  for (int kernel = LinearScaleKernelBilinear; kernel <= LinearScaleKernelLanczos3; kernel++) {
+    for (int s = 0; s < numSizes; s++) {
+      LinearScaleFilter filter;
+      int err = linear_scale_filter_init(&filter, (LinearScaleKernel) kernel, sizes[s][0], sizes[s][1]);
+      XCTAssert(err == 0);
+
+      int numWrong = 0;
+
+      for (int i = 0; i < filter.outSize; i++) {
+        double sum = 0.0;
+
+        for (int k = 0; k < filter.maxTaps; k++) {
+          sum += filter.weights[(i * filter.maxTaps) + k];
+        }
+
+        if (fabs(sum - 1.0) > 1e-5 || filter.starts[i] < 0 || (filter.starts[i] + filter.maxTaps) > filter.inSize) {
+          numWrong += 1;
+        }
+      }
+
+      XCTAssert(numWrong == 0, @"%d wrong outputs for %d -> %d", numWrong, sizes[s][0], sizes[s][1]);
+
+      linear_scale_filter_free(&filter);
+    }
+  }
+}
+
+// Negative lobes at a hard alpha edge never produce color above alpha,
+// and splitting rows into bands gives the same pixels as one band.
+
+- (void)testHardEdgesAndBands {
+  const int width = 300;
+  const int height = 200;
+  const int outWidth = 97;
+  const int outHeight = 61;
+
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *outPixels1 = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+  uint32_t *outPixels7 = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      uint32_t pixel;
+
+      if (((col / 7) + (row / 5)) & 0x1) {
+        pixel = premultiply_pixel(0xFFFF2000);
+      } else if ((col % 13) < 3) {
+        pixel = 0;
+      } else {
+        pixel = premultiply_pixel(0x40FFFFFF);
+      }
+
+      pixels[(row * width) + col] = pixel;
+    }
+  }
+
+  for (int kernel = LinearScaleKernelBilinear; kernel <= LinearScaleKernelLanczos3; kernel++) {
+    LinearScaler scaler1;
+    LinearScaler scaler7;
+
+    int err = linear_scaler_init(&scaler1, (LinearScaleKernel) kernel, 0, width, height, outWidth, outHeight, 1);
+    XCTAssert(err == 0);
+    err = linear_scaler_init(&scaler7, (LinearScaleKernel) kernel, 0, width, height, outWidth, outHeight, 7);
+    XCTAssert(err == 0);
+
+    linear_scaler_scale(&scaler1, pixels, width, outPixels1, outWidth);
+    linear_scaler_scale(&scaler7, pixels, width, outPixels7, outWidth);
+
+    XCTAssert(memcmp(outPixels1, outPixels7, outWidth * outHeight * sizeof(uint32_t)) == 0);
+
+    int numInvalid = 0;
+
+    for (int i = 0; i < (outWidth * outHeight); i++) {
+      const uint32_t pixel = outPixels1[i];
+      const uint32_t A = pixel >> 24;
+
+      for (int shift = 0; shift < 24; shift += 8) {
+        if (((pixel >> shift) & 0xFF) > A) {
+          numInvalid += 1;
+        }
+      }
+    }
+
+    XCTAssert(numInvalid == 0, @"%d invalid components with %s", numInvalid, linear_scale_kernel_name((LinearScaleKernel) kernel));
+
+    linear_scaler_free(&scaler1);
+    linear_scaler_free(&scaler7);
+  }
+
+  free(pixels);
+  free(outPixels1);
+  free(outPixels7);
+}
+
+- (void)testInvalidSizes {
+  LinearScaler scaler;
+
+  int err = linear_scaler_init(&scaler, LinearScaleKernelBilinear, 0, 0, 10, 5, 5, 1);
+  XCTAssert(err == LS_ERR_SIZE);
+
+  err = linear_scaler_init(&scaler, LinearScaleKernelBilinear, 0, 10, 10, 5, 5, LS_MAX_BANDS + 1);
+  XCTAssert(err == LS_ERR_SIZE);
+}
+
+// Benchmarks, semi-transparent noise so that no pixel takes a fast path
+
+- (void) measureScale:(LinearScaleKernel)kernel
+              inWidth:(int)inWidth
+             inHeight:(int)inHeight
+             outWidth:(int)outWidth
+            outHeight:(int)outHeight
+{
+  uint32_t *pixels = (uint32_t *) malloc(inWidth * inHeight * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(outWidth * outHeight * sizeof(uint32_t));
+
+  for (int i = 0; i < (inWidth * inHeight); i++) {
+    pixels[i] = premultiply_pixel(0x80000000 | (i * 2654435761u));
+  }
+
+  int numBands = (int) [[NSProcessInfo processInfo] activeProcessorCount];
+  numBands = (numBands > LS_MAX_BANDS) ? LS_MAX_BANDS : numBands;
+
+  LinearScaler scaler;
+  LinearScaler *scalerPtr = &scaler;
+
+  int err = linear_scaler_init(&scaler, kernel, 0, inWidth, inHeight, outWidth, outHeight, numBands);
+  XCTAssert(err == 0);
+
+  [self measureBlock:^{
+    linear_scaler_scale(scalerPtr, pixels, inWidth, outPixels, outWidth);
+  }];
+
+  linear_scaler_free(&scaler);
+
+  free(pixels);
+  free(outPixels);
+}
+
+- (void)testPerformance2048To1024Bilinear {
+  [self measureScale:LinearScaleKernelBilinear inWidth:2048 inHeight:1536 outWidth:1024 outHeight:768];
+}
+
+- (void)testPerformance2048To1024Bicubic {
+  [self measureScale:LinearScaleKernelBicubic inWidth:2048 inHeight:1536 outWidth:1024 outHeight:768];
+}
+
+- (void)testPerformance2048To1024Lanczos3 {
+  [self measureScale:LinearScaleKernelLanczos3 inWidth:2048 inHeight:1536 outWidth:1024 outHeight:768];
+}
+
+- (void)testPerformance1080pTo720pBilinear {
+  [self measureScale:LinearScaleKernelBilinear inWidth:1920 inHeight:1080 outWidth:1280 outHeight:720];
+}
+
+- (void)testPerformance1080pTo720pBicubic {
+  [self measureScale:LinearScaleKernelBicubic inWidth:1920 inHeight:1080 outWidth:1280 outHeight:720];
+}
+
+- (void)testPerformance1080pTo720pLanczos3 {
+  [self measureScale:LinearScaleKernelLanczos3 inWidth:1920 inHeight:1080 outWidth:1280 outHeight:720];
+}
+
+@end
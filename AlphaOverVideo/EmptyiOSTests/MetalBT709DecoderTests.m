@@ -17,6 +17,12 @@
 
 #import "MetalRenderContext.h"
 
+#import "MetalScaleRenderContext.h"
+
+#import "decode_scaler.h"
+
+#import <MetalKit/MetalKit.h>
+
 @interface MetalBT709DecoderTests : XCTestCase
 
 @end
@@ -2236,4 +2242,130 @@ uint32_t grayToPixel(uint32_t gray)
 }
 
 
+// GPU time in ms of one frame of a 2048 x 1536 video rendered into a
+// view of the given size, with the fused decode and scale or with a
+// full size decode into an intermediate texture followed by a resample.
+
+- (double) gpuTimeDecodeScale:(int)renderWidth
+                 renderHeight:(int)renderHeight
+                      isFused:(BOOL)isFused
+{
+  const int width = 2048;
+  const int height = 1536;
+  const int numFrames = 20;
+  
+  MetalRenderContext *metalRenderContext = [[MetalRenderContext alloc] init];
+  metalRenderContext.device = MTLCreateSystemDefaultDevice();
+  
+  MetalBT709Decoder *metalDecoder = [[MetalBT709Decoder alloc] init];
+  metalDecoder.metalRenderContext = metalRenderContext;
+  metalDecoder.colorPixelFormat = MTLPixelFormatBGRA8Unorm_sRGB;
+  
+  BOOL worked = [metalDecoder setupMetal];
+  XCTAssert(worked, @"setupMetal");
+  
+  MTKView *mtkView = [[MTKView alloc] initWithFrame:CGRectMake(0, 0, renderWidth, renderHeight) device:metalRenderContext.device];
+  mtkView.colorPixelFormat = MTLPixelFormatBGRA8Unorm_sRGB;
+  
+  MetalScaleRenderContext *metalScaleRenderContext = [[MetalScaleRenderContext alloc] init];
+  [metalScaleRenderContext setupRenderPipelines:metalRenderContext mtkView:mtkView];
+  
+  id<MTLTexture> intermediateTexture = [metalRenderContext makeBGRATexture:CGSizeMake(width, height) pixels:NULL usage:MTLTextureUsageRenderTarget|MTLTextureUsageShaderRead|MTLTextureUsageShaderWrite isSRGB:TRUE];
+  id<MTLTexture> viewTexture = [metalRenderContext makeBGRATexture:CGSizeMake(renderWidth, renderHeight) pixels:NULL usage:MTLTextureUsageRenderTarget|MTLTextureUsageShaderRead isSRGB:TRUE];
+  
+  MTLRenderPassDescriptor *renderPassDescriptor = [MTLRenderPassDescriptor renderPassDescriptor];
+  renderPassDescriptor.colorAttachments[0].texture = viewTexture;
+  renderPassDescriptor.colorAttachments[0].loadAction = MTLLoadActionDontCare;
+  renderPassDescriptor.colorAttachments[0].storeAction = MTLStoreActionStore;
+  
+  CVPixelBufferRef yCbCrBuffer = [BGRAToBT709Converter createCoreVideoYCbCrBuffer:CGSizeMake(width, height)];
+  [BGRAToBT709Converter setBT709Attributes:yCbCrBuffer];
+  
+  uint32_t *inBT709 = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  
+  for (int i = 0; i < (width * height); i++) {
+    uint32_t Y = 16 + (((i * 2654435761u) >> 24) % 220);
+    uint32_t Cb = 16 + (((i * 40503u) >> 8) % 225);
+    uint32_t Cr = 16 + (((i * 7919u) >> 4) % 225);
+    inBT709[i] = (Y << 16) | (Cb << 8) | Cr;
+  }
+  
+  [BGRAToBT709Converter copyBT709ToCoreVideo:inBT709 cvPixelBuffer:yCbCrBuffer];
+  
+  free(inBT709);
+  
+  // The first frame sets up filter taps and pipelines and is not timed
+  
+  double totalMs = 0.0;
+  
+  for (int frame = 0; frame <= numFrames; frame++) {
+    id<MTLCommandBuffer> commandBuffer = [metalRenderContext.commandQueue commandBuffer];
+    
+    if (isFused) {
+      worked = [metalDecoder decodeScaleBT709:yCbCrBuffer
+                             alphaPixelBuffer:NULL
+                                commandBuffer:commandBuffer
+                         renderPassDescriptor:renderPassDescriptor
+                                  renderWidth:renderWidth
+                                 renderHeight:renderHeight];
+    } else {
+      worked = [metalDecoder decodeBT709:yCbCrBuffer
+                        alphaPixelBuffer:NULL
+                         bgraSRGBTexture:intermediateTexture
+                           commandBuffer:commandBuffer
+                    renderPassDescriptor:nil
+                             renderWidth:width
+                            renderHeight:height
+                      waitUntilCompleted:FALSE];
+      XCTAssert(worked, @"decodeBT709");
+      
+      worked = [metalScaleRenderContext renderScaled:metalRenderContext
+                                             mtkView:mtkView
+                                         renderWidth:renderWidth
+                                        renderHeight:renderHeight
+                                       commandBuffer:commandBuffer
+                                renderPassDescriptor:renderPassDescriptor
+                                         bgraTexture:intermediateTexture];
+    }
+    
+    XCTAssert(worked, @"render");
+    
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+    
+    if (frame > 0) {
+      totalMs += (commandBuffer.GPUEndTime - commandBuffer.GPUStartTime) * 1000.0;
+    }
+  }
+  
+  CVPixelBufferRelease(yCbCrBuffer);
+  
+  return totalMs / numFrames;
+}
+
+// The view uses the fused decode and scale only at scales where
+// decode_scaler_use_fused() expects it to win, log the GPU time of
+// both paths at each scale to check the model on a device.
+
+- (void)testGPUTimeDecodeScale {
+  const int width = 2048;
+  const int height = 1536;
+  const double scales[] = { 0.9, 0.6, 0.5, 0.25 };
+  
+  for (int i = 0; i < 4; i++) {
+    const int renderWidth = (int) (width * scales[i]);
+    const int renderHeight = (int) (height * scales[i]);
+    
+    double fusedMs = [self gpuTimeDecodeScale:renderWidth renderHeight:renderHeight isFused:TRUE];
+    double twoPassMs = [self gpuTimeDecodeScale:renderWidth renderHeight:renderHeight isFused:FALSE];
+    
+    int useFused = decode_scaler_use_fused(width, height, renderWidth, renderHeight, 4);
+    
+    NSLog(@"%4d x %4d : fused %.3f ms : 2 pass %.3f ms : use fused %d",
+          renderWidth, renderHeight, fusedMs, twoPassMs, useFused);
+    
+    XCTAssert(fusedMs > 0.0 && twoPassMs > 0.0);
+  }
+}
+
 @end
@@ -0,0 +1,409 @@
+//
+//  Mp4IndexTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "mp4_index.h"
+
+@interface Mp4IndexTests : XCTestCase
+
+@end
+
+@implementation Mp4IndexTests
+
+- (NSString*) resourcePath:(NSString*)filename
+{
+  NSString *testsDir = [[NSString stringWithUTF8String:__FILE__] stringByDeletingLastPathComponent];
+  NSString *resDir = [[testsDir stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"Resources"];
+  NSString *path = [resDir stringByAppendingPathComponent:filename];
+
+  if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
+    return path;
+  }
+
+  NSBundle *bundle = [NSBundle bundleForClass:self.class];
+  return [bundle pathForResource:[filename stringByDeletingPathExtension] ofType:[filename pathExtension]];
+}
+
+// CarSpin has B frames, display order differs from decode order
+
+- (void)testIndexCarSpin {
+  NSString *path = [self resourcePath:@"CarSpin.m4v"];
+
+  if (path == nil) {
+    return;
+  }
+
+  Mp4Index index;
+  int err = mp4_index_build_file([path fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+
+  {
+    int v = mp4_index_num_frames(&index);
+    int expectedVal = 155;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = index.header->timescale;
+    int expectedVal = 15360;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // 30 FPS in a 15360 timescale is 512 units per frame
+
+  for (int i = 0; i < mp4_index_num_frames(&index); i++) {
+    const Mp4IndexSample *sample = mp4_index_frame(&index, i);
+
+    {
+      int v = (int) sample->pts;
+      int expectedVal = i * 512;
+      XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+    }
+
+    XCTAssert(sample->frameNum == i);
+    XCTAssert(mp4_index_frame_at_time(&index, sample->pts) == i);
+    XCTAssert(mp4_index_frame_at_time(&index, sample->pts + 511) == i);
+  }
+
+  {
+    // Frame 2 is decoded before frame 1
+    int v = (int) mp4_index_frame(&index, 2)->dts;
+    int expectedVal = 512;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // 1/30 of a second expressed in a 600 timescale
+    int64_t pts = mp4_index_media_time(&index, 20, 600);
+    int v = mp4_index_frame_at_time(&index, pts);
+    int expectedVal = 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // Times past the end hold the final frame
+    int v = mp4_index_frame_at_time(&index, index.header->endPts * 2);
+    int expectedVal = 154;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // Only the first frame is a keyframe
+    int v = mp4_index_keyframe_before(&index, 100);
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  mp4_index_free(&index);
+}
+
+// GlobeLEDAlpha has a second keyframe at frame 250
+
+- (void)testKeyframeBefore {
+  NSString *path = [self resourcePath:@"GlobeLEDAlpha.m4v"];
+
+  if (path == nil) {
+    return;
+  }
+
+  Mp4Index index;
+  int err = mp4_index_build_file([path fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+
+  {
+    int v = index.header->numKeyframes;
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = mp4_index_keyframe_before(&index, 249);
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = mp4_index_keyframe_before(&index, 250);
+    int expectedVal = 250;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = mp4_index_keyframe_before(&index, 358);
+    int expectedVal = 250;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(mp4_index_frame(&index, 250)->flags & MP4_INDEX_FLAG_KEYFRAME);
+
+  mp4_index_free(&index);
+}
+
+// Write the index to a cache file and open it again
+
+- (void)testSerializeRoundTrip {
+  NSString *path = [self resourcePath:@"CarSpin_alpha.m4v"];
+
+  if (path == nil) {
+    return;
+  }
+
+  Mp4Index index;
+  int err = mp4_index_build_file([path fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+
+  NSString *cachePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mp4IndexTests.aovi"];
+
+  err = mp4_index_write_file(&index, [cachePath fileSystemRepresentation]);
+  XCTAssert(err == 0);
+
+  Mp4Index cached;
+  err = mp4_index_read_file([cachePath fileSystemRepresentation], &cached);
+  XCTAssert(err == 0);
+
+  XCTAssert(cached.numBytes == index.numBytes);
+  XCTAssert(memcmp(cached.bytes, index.bytes, (size_t) index.numBytes) == 0);
+
+  {
+    int v = mp4_index_frame_at_time(&cached, mp4_index_frame(&index, 77)->pts);
+    int expectedVal = 77;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // A truncated cache must be rejected
+
+  Mp4Index truncated;
+  err = mp4_index_open_buffer(index.bytes, index.numBytes - 4, &truncated);
+  XCTAssert(err == MP4_PROBE_ERR_MALFORMED);
+
+  mp4_index_free(&cached);
+  mp4_index_free(&index);
+
+  [[NSFileManager defaultManager] removeItemAtPath:cachePath error:nil];
+}
+
+// Serialized index of 3 samples, sample 1 is displayed last and
+// samples 0 and 2 are keyframes.
+
+- (NSMutableData*) syntheticIndexData
+{
+  const uint32_t numSamples = 3;
+  const uint32_t numKeyframes = 2;
+
+  NSMutableData *mData = [NSMutableData dataWithLength:(NSUInteger)mp4_index_num_bytes(numSamples, numKeyframes)];
+
+  Mp4IndexHeader *header = (Mp4IndexHeader *) mData.mutableBytes;
+  header->magic = MP4_INDEX_MAGIC;
+  header->version = MP4_INDEX_VERSION;
+  header->timescale = 30;
+  header->numSamples = numSamples;
+  header->numKeyframes = numKeyframes;
+  header->duration = 3;
+  header->endPts = 3;
+
+  Mp4IndexSample *samples = (Mp4IndexSample *) (header + 1);
+  const int pts[3] = { 0, 2, 1 };
+
+  for (int i = 0; i < numSamples; i++) {
+    samples[i].pts = pts[i];
+    samples[i].dts = i;
+    samples[i].size = 100;
+    samples[i].frameNum = pts[i];
+  }
+
+  uint32_t *displayOrder = (uint32_t *) (samples + numSamples);
+  displayOrder[0] = 0;
+  displayOrder[1] = 2;
+  displayOrder[2] = 1;
+
+  uint32_t *keyframes = displayOrder + numSamples;
+  keyframes[0] = 0;
+  keyframes[1] = 2;
+
+  return mData;
+}
+
+- (Mp4IndexSample*) samplesOf:(NSMutableData*)mData
+{
+  return (Mp4IndexSample *) ((Mp4IndexHeader *) mData.mutableBytes + 1);
+}
+
+- (uint32_t*) displayOrderOf:(NSMutableData*)mData
+{
+  const Mp4IndexHeader *header = (const Mp4IndexHeader *) mData.bytes;
+  return (uint32_t *) ([self samplesOf:mData] + header->numSamples);
+}
+
+- (uint32_t*) keyframesOf:(NSMutableData*)mData
+{
+  const Mp4IndexHeader *header = (const Mp4IndexHeader *) mData.bytes;
+  return [self displayOrderOf:mData] + header->numSamples;
+}
+
+// A corrupt cache with an out of range sample index or frame number
+// is rejected, then loading rebuilds the index from the MP4 file.
+
+- (void)testCorruptCacheRejected {
+  Mp4Index index;
+
+  NSMutableData *mData = [self syntheticIndexData];
+  int err = mp4_index_open_buffer(mData.bytes, mData.length, &index);
+  XCTAssert(err == 0);
+
+  {
+    int v = mp4_index_frame_at_time(&index, 2);
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  mData = [self syntheticIndexData];
+  [self displayOrderOf:mData][1] = 0x7FFFFFFF;
+  XCTAssert(mp4_index_open_buffer(mData.bytes, mData.length, &index) == MP4_PROBE_ERR_MALFORMED);
+
+  mData = [self syntheticIndexData];
+  [self keyframesOf:mData][1] = 3;
+  XCTAssert(mp4_index_open_buffer(mData.bytes, mData.length, &index) == MP4_PROBE_ERR_MALFORMED);
+
+  // Keyframes out of order would break the binary search
+
+  mData = [self syntheticIndexData];
+  [self keyframesOf:mData][0] = 2;
+  [self keyframesOf:mData][1] = 0;
+  XCTAssert(mp4_index_open_buffer(mData.bytes, mData.length, &index) == MP4_PROBE_ERR_MALFORMED);
+
+  mData = [self syntheticIndexData];
+  [self samplesOf:mData][2].frameNum = 3;
+  XCTAssert(mp4_index_open_buffer(mData.bytes, mData.length, &index) == MP4_PROBE_ERR_MALFORMED);
+
+  // A corrupt cache file on disk is a cache miss
+
+  NSString *path = [self resourcePath:@"CarSpin.m4v"];
+
+  if (path == nil) {
+    return;
+  }
+
+  NSString *cachePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mp4IndexTestsCorrupt.aovi"];
+
+  mData = [self syntheticIndexData];
+  [self displayOrderOf:mData][0] = 1000;
+  [mData writeToFile:cachePath atomically:TRUE];
+
+  err = mp4_index_load_cached([path fileSystemRepresentation], [cachePath fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+
+  {
+    int v = mp4_index_num_frames(&index);
+    int expectedVal = 155;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  mp4_index_free(&index);
+
+  // The rebuilt cache was written back and now opens
+
+  err = mp4_index_read_file([cachePath fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+  XCTAssert(mp4_index_num_frames(&index) == 155);
+  mp4_index_free(&index);
+
+  [[NSFileManager defaultManager] removeItemAtPath:cachePath error:nil];
+}
+
+// A cache built from an earlier version of the MP4 file is stale,
+// rewriting the file must rebuild the index.
+
+- (void)testStaleCacheRebuilt {
+  NSString *carSpinPath = [self resourcePath:@"CarSpin.m4v"];
+  NSString *countPath = [self resourcePath:@"CountToTen.m4v"];
+
+  if (carSpinPath == nil || countPath == nil) {
+    return;
+  }
+
+  NSFileManager *fm = [NSFileManager defaultManager];
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mp4IndexTestsSource.m4v"];
+  NSString *cachePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mp4IndexTestsSource.aovi"];
+
+  [fm removeItemAtPath:path error:nil];
+  [fm removeItemAtPath:cachePath error:nil];
+  XCTAssert([fm copyItemAtPath:carSpinPath toPath:path error:nil]);
+
+  Mp4Index index;
+  int err = mp4_index_load_cached([path fileSystemRepresentation], [cachePath fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+  XCTAssert(mp4_index_num_frames(&index) == 155);
+  mp4_index_free(&index);
+
+  // Mark the cache file, an unchanged source reads the marked cache
+
+  NSMutableData *mData = [NSMutableData dataWithContentsOfFile:cachePath];
+  ((Mp4IndexHeader *) mData.mutableBytes)->duration = 12345;
+  [mData writeToFile:cachePath atomically:TRUE];
+
+  err = mp4_index_load_cached([path fileSystemRepresentation], [cachePath fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+
+  {
+    int v = (int) index.header->duration;
+    int expectedVal = 12345;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  mp4_index_free(&index);
+
+  // Rewrite the source with a different clip
+
+  [fm removeItemAtPath:path error:nil];
+  XCTAssert([fm copyItemAtPath:countPath toPath:path error:nil]);
+
+  err = mp4_index_load_cached([path fileSystemRepresentation], [cachePath fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+
+  {
+    int v = mp4_index_num_frames(&index);
+    int expectedVal = 10;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(index.header->duration != 12345);
+  mp4_index_free(&index);
+
+  // The rebuilt cache was written back
+
+  err = mp4_index_read_file([cachePath fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+  XCTAssert(mp4_index_num_frames(&index) == 10);
+  mp4_index_free(&index);
+
+  [fm removeItemAtPath:path error:nil];
+  [fm removeItemAtPath:cachePath error:nil];
+}
+
+- (void)testPerformanceFrameAtTime {
+  NSString *path = [self resourcePath:@"GlobeLEDAlpha.m4v"];
+
+  if (path == nil) {
+    return;
+  }
+
+  Mp4Index index;
+  int err = mp4_index_build_file([path fileSystemRepresentation], &index);
+  XCTAssert(err == 0);
+
+  [self measureBlock:^{
+    int sum = 0;
+    for (int i = 0; i < 100000; i++) {
+      sum += mp4_index_frame_at_time(&index, (i * 7) % index.header->endPts);
+    }
+    XCTAssert(sum > 0);
+  }];
+
+  mp4_index_free(&index);
+}
+
+@end
@@ -0,0 +1,96 @@
+//
+//  Mp4PairCheckTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "mp4_pair_check.h"
+
+@interface Mp4PairCheckTests : XCTestCase
+
+@end
+
+@implementation Mp4PairCheckTests
+
+- (NSString*) resourcePath:(NSString*)filename
+{
+  NSString *testsDir = [[NSString stringWithUTF8String:__FILE__] stringByDeletingLastPathComponent];
+  NSString *resDir = [[testsDir stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"Resources"];
+  NSString *path = [resDir stringByAppendingPathComponent:filename];
+
+  if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
+    return path;
+  }
+
+  return nil;
+}
+
+- (void)testResourcePairsAreLockStep {
+  NSArray *names = @[ @"CarSpin", @"CountToTenA", @"Field", @"GlobeLEDAlpha" ];
+
+  for (NSString *name in names) {
+    NSString *rgbPath = [self resourcePath:[name stringByAppendingString:@".m4v"]];
+    NSString *alphaPath = [self resourcePath:[name stringByAppendingString:@"_alpha.m4v"]];
+
+    if (rgbPath == nil || alphaPath == nil) {
+      continue;
+    }
+
+    Mp4PairReport report;
+    int err = mp4_pair_check_files([rgbPath fileSystemRepresentation], [alphaPath fileSystemRepresentation], &report);
+    XCTAssert(err == 0, @"%@", name);
+    XCTAssert(report.isLockStep, @"%@", name);
+    XCTAssert(report.numMismatches == 0, @"%@", name);
+  }
+}
+
+// CarSpin is 960x720 with 155 frames, Field_alpha is 540x540 with 90 frames
+
+- (void)testMismatchedPair {
+  NSString *rgbPath = [self resourcePath:@"CarSpin.m4v"];
+  NSString *alphaPath = [self resourcePath:@"Field_alpha.m4v"];
+
+  if (rgbPath == nil || alphaPath == nil) {
+    return;
+  }
+
+  Mp4PairReport report;
+  int err = mp4_pair_check_files([rgbPath fileSystemRepresentation], [alphaPath fileSystemRepresentation], &report);
+  XCTAssert(err == 0);
+  XCTAssert(report.isLockStep == 0);
+
+  {
+    int v = report.numMismatches;
+    int expectedVal = 4;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = report.mismatches[0].type;
+    int expectedVal = Mp4PairMismatchDimensions;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // First frame missing from the alpha file
+    int v = report.mismatches[2].type;
+    int expectedVal = Mp4PairMismatchFrameCount;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+
+    v = report.mismatches[2].frameNum;
+    expectedVal = 90;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+- (void)testMissingFile {
+  Mp4PairReport report;
+  int err = mp4_pair_check_files("/does/not/exist.m4v", "/does/not/exist_alpha.m4v", &report);
+  XCTAssert(err == MP4_PROBE_ERR_IO);
+  XCTAssert(report.isLockStep == 0);
+  XCTAssert(report.mismatches[0].type == Mp4PairMismatchParse);
+}
+
+@end
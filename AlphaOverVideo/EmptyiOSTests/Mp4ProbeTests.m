@@ -0,0 +1,198 @@
+//
+//  Mp4ProbeTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "mp4_probe.h"
+
+@interface Mp4ProbeTests : XCTestCase
+
+@end
+
+@implementation Mp4ProbeTests
+
+// Every .m4v in the Resources directory of the source tree, this
+// works in the simulator since it shares the host filesystem. When
+// the source tree is not available the test bundle resources are used.
+
+- (NSArray<NSString*>*) resourceClipPaths
+{
+  NSString *testsDir = [[NSString stringWithUTF8String:__FILE__] stringByDeletingLastPathComponent];
+  NSString *resDir = [[testsDir stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"Resources"];
+
+  NSArray *filenames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:resDir error:nil];
+
+  NSMutableArray *mArr = [NSMutableArray array];
+
+  for (NSString *filename in filenames) {
+    if ([filename hasSuffix:@".m4v"]) {
+      [mArr addObject:[resDir stringByAppendingPathComponent:filename]];
+    }
+  }
+
+  if (mArr.count == 0) {
+    NSBundle *bundle = [NSBundle bundleForClass:self.class];
+    [mArr addObjectsFromArray:[bundle pathsForResourcesOfType:@"m4v" inDirectory:nil]];
+  }
+
+  return [NSArray arrayWithArray:mArr];
+}
+
+- (NSString*) resourceClipPath:(NSString*)filename
+{
+  for (NSString *path in [self resourceClipPaths]) {
+    if ([[path lastPathComponent] isEqualToString:filename]) {
+      return path;
+    }
+  }
+  return nil;
+}
+
+- (void)testProbeAllResourceClips {
+  NSArray *paths = [self resourceClipPaths];
+  XCTAssert(paths.count > 0);
+
+  for (NSString *path in paths) {
+    Mp4ProbeResult result;
+    int err = mp4_probe_file([path fileSystemRepresentation], &result);
+    XCTAssert(err == 0, @"probe failed with %d for %@", err, path);
+    XCTAssert(strcmp(result.codec, "avc1") == 0, @"%@", path);
+    XCTAssert(result.width > 0 && result.height > 0, @"%@", path);
+    XCTAssert(result.numFrames > 0, @"%@", path);
+    XCTAssert(result.FPS > 0.0f, @"%@", path);
+  }
+}
+
+// CarSpin is 30 FPS with sRGB gamma RGB and linear alpha
+
+- (void)testProbeCarSpin {
+  NSString *rgbPath = [self resourceClipPath:@"CarSpin.m4v"];
+  NSString *alphaPath = [self resourceClipPath:@"CarSpin_alpha.m4v"];
+
+  if (rgbPath == nil || alphaPath == nil) {
+    return;
+  }
+
+  Mp4ProbeResult result;
+  int err = mp4_probe_file([rgbPath fileSystemRepresentation], &result);
+  XCTAssert(err == 0);
+
+  {
+    int v = result.width;
+    int expectedVal = 960;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = result.height;
+    int expectedVal = 720;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = result.numFrames;
+    int expectedVal = 155;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) round(result.FPS);
+    int expectedVal = 30;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(result.hasColorTags);
+
+  {
+    // BT.709 primaries
+    int v = result.colorPrimaries;
+    int expectedVal = 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // iec61966_2_1 (sRGB)
+    int v = result.transferCharacteristics;
+    int expectedVal = 13;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  err = mp4_probe_file([alphaPath fileSystemRepresentation], &result);
+  XCTAssert(err == 0);
+
+  {
+    // linear
+    int v = result.transferCharacteristics;
+    int expectedVal = 8;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Truncated and randomly corrupted copies of each clip must fail
+// cleanly or succeed, but never read outside of the input buffer.
+// Mutations are focused on the moov box since mdat is not parsed.
+
+- (void)testFuzzCorruptedHeaders {
+  srandom(1);
+
+  for (NSString *path in [self resourceClipPaths]) {
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    XCTAssert(data);
+
+    if (data.length > (4 * 1024 * 1024)) {
+      continue;
+    }
+
+    const uint8_t *bytes = (const uint8_t *) data.bytes;
+    const int numBytes = (int) data.length;
+
+    int moovOffset = 0;
+    for (int i = 4; i < (numBytes - 4); i++) {
+      if (memcmp(bytes + i, "moov", 4) == 0) {
+        moovOffset = i - 4;
+        break;
+      }
+    }
+
+    for (int iter = 0; iter < 1000; iter++) {
+      int len = numBytes;
+      if ((iter % 3) == 0) {
+        len = (int) (random() % numBytes);
+      }
+
+      NSMutableData *mData = [NSMutableData dataWithBytes:bytes length:len];
+      uint8_t *mBytes = (uint8_t *) mData.mutableBytes;
+
+      const int numMutations = (int) (random() % 8);
+
+      for (int i = 0; i < numMutations && len > moovOffset; i++) {
+        int span = len - moovOffset;
+        span = (span > 4096) ? 4096 : span;
+        int offset = moovOffset + (int) (random() % span);
+        mBytes[offset] = ((random() % 4) == 0) ? 0xFF : (uint8_t) random();
+      }
+
+      Mp4ProbeResult result;
+      int err = mp4_probe_buffer(mBytes, len, &result);
+      XCTAssert(err >= 0 && err <= MP4_PROBE_ERR_TOO_LARGE);
+    }
+  }
+}
+
+- (void)testPerformanceProbeAllResourceClips {
+  NSArray *paths = [self resourceClipPaths];
+
+  [self measureBlock:^{
+    for (int i = 0; i < 10; i++) {
+      for (NSString *path in paths) {
+        Mp4ProbeResult result;
+        mp4_probe_file([path fileSystemRepresentation], &result);
+      }
+    }
+  }];
+}
+
+@end
@@ -0,0 +1,183 @@
+//
+//  Mp4WriterTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "mp4_index.h"
+#import "mp4_writer.h"
+#import "mp4_pair_check.h"
+
+@interface Mp4WriterTests : XCTestCase
+
+@end
+
+@implementation Mp4WriterTests
+
+- (NSString*) resourcePath:(NSString*)filename
+{
+  NSString *testsDir = [[NSString stringWithUTF8String:__FILE__] stringByDeletingLastPathComponent];
+  NSString *resDir = [[testsDir stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"Resources"];
+  NSString *path = [resDir stringByAppendingPathComponent:filename];
+
+  if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
+    return path;
+  }
+
+  NSBundle *bundle = [NSBundle bundleForClass:self.class];
+  return [bundle pathForResource:[filename stringByDeletingPathExtension] ofType:[filename pathExtension]];
+}
+
+// Find the avcC payload in the stsd of the video track
+
+- (NSData*) avcCForPath:(NSString*)path
+{
+  NSData *data = [NSData dataWithContentsOfFile:path];
+
+  Mp4ProbeSpan fileSpan = { data.bytes, data.length };
+  uint8_t *moovBytes = NULL;
+  uint64_t moovLen = 0;
+
+  int err = mp4_probe_read_moov(mp4_probe_read_buffer, &fileSpan, data.length, &moovBytes, &moovLen);
+
+  if (err != 0) {
+    return nil;
+  }
+
+  Mp4ProbeSpan moov = { moovBytes, moovLen };
+  Mp4ProbeSpan trak, mdia, stsd;
+
+  const uint32_t stsdPath[] = {
+    MP4_PROBE_FOURCC('m','i','n','f'),
+    MP4_PROBE_FOURCC('s','t','b','l'),
+    MP4_PROBE_FOURCC('s','t','s','d')
+  };
+
+  NSData *avcC = nil;
+
+  if (mp4_probe_video_trak(&moov, &trak, &mdia) == 0 &&
+      mp4_probe_find_path(&mdia, stsdPath, 3, &stsd) == 0 && stsd.len > 8) {
+    Mp4ProbeSpan entries = { stsd.ptr + 8, stsd.len - 8 };
+    Mp4ProbeSpan entry;
+    Mp4ProbeSpan payload;
+    uint32_t type;
+
+    if (mp4_probe_box(&entries, &type, &entry) != 0 && entry.len > 78) {
+      Mp4ProbeSpan children = { entry.ptr + 78, entry.len - 78 };
+
+      if (mp4_probe_find(&children, MP4_PROBE_FOURCC('a','v','c','C'), &payload) == 0) {
+        avcC = [NSData dataWithBytes:payload.ptr length:(NSUInteger)payload.len];
+      }
+    }
+  }
+
+  free(moovBytes);
+  return avcC;
+}
+
+// Remux the samples of CarSpin into a new file, the B frame
+// reordering, keyframes and sample bytes must be preserved.
+
+- (void)testRemuxCarSpin {
+  NSString *path = [self resourcePath:@"CarSpin.m4v"];
+  NSString *alphaPath = [self resourcePath:@"CarSpin_alpha.m4v"];
+
+  if (path == nil || alphaPath == nil) {
+    return;
+  }
+
+  NSData *data = [NSData dataWithContentsOfFile:path];
+  NSData *avcC = [self avcCForPath:path];
+  XCTAssert(avcC != nil);
+
+  const uint8_t *avcCPtr = (const uint8_t *) avcC.bytes;
+  const int spsLen = (int) mp4_probe_be16(avcCPtr + 6);
+  const uint8_t *spsPtr = avcCPtr + 8;
+  const int ppsLen = (int) mp4_probe_be16(avcCPtr + 8 + spsLen + 1);
+  const uint8_t *ppsPtr = avcCPtr + 8 + spsLen + 3;
+
+  Mp4Index index;
+  int err = mp4_index_build_buffer(data.bytes, data.length, &index);
+  XCTAssert(err == 0);
+
+  NSString *outPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"CarSpin_remux.m4v"];
+
+  Mp4Writer writer;
+  err = mp4_writer_open(&writer, [outPath fileSystemRepresentation], 960, 720, index.header->timescale);
+  XCTAssert(err == 0);
+
+  err = mp4_writer_set_avcc(&writer, spsPtr, spsLen, ppsPtr, ppsLen);
+  XCTAssert(err == 0);
+
+  mp4_writer_set_color(&writer, 1, 13, 1, 0);
+
+  for (int i = 0; i < (int) index.header->numSamples; i++) {
+    const Mp4IndexSample *sample = &index.samples[i];
+    const uint8_t *sampleBytes = ((const uint8_t *) data.bytes) + sample->offset;
+    err = mp4_writer_write_sample(&writer, sampleBytes, sample->size, sample->dts, sample->pts, (sample->flags & MP4_INDEX_FLAG_KEYFRAME));
+    XCTAssert(err == 0);
+  }
+
+  err = mp4_writer_close(&writer, 512);
+  XCTAssert(err == 0);
+
+  NSData *outData = [NSData dataWithContentsOfFile:outPath];
+
+  Mp4ProbeResult probe;
+  err = mp4_probe_buffer(outData.bytes, outData.length, &probe);
+  XCTAssert(err == 0);
+
+  {
+    int v = probe.transferCharacteristics;
+    int expectedVal = 13;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  Mp4Index outIndex;
+  err = mp4_index_build_buffer(outData.bytes, outData.length, &outIndex);
+  XCTAssert(err == 0);
+
+  {
+    int v = mp4_index_num_frames(&outIndex);
+    int expectedVal = 155;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = outIndex.header->numKeyframes;
+    int expectedVal = index.header->numKeyframes;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  for (int i = 0; i < mp4_index_num_frames(&outIndex); i++) {
+    const Mp4IndexSample *inSample = mp4_index_frame(&index, i);
+    const Mp4IndexSample *outSample = mp4_index_frame(&outIndex, i);
+
+    {
+      int v = (int) outSample->pts;
+      int expectedVal = i * 512;
+      XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+    }
+
+    XCTAssert(outSample->size == inSample->size);
+
+    int cmp = memcmp(((const uint8_t *) outData.bytes) + outSample->offset, ((const uint8_t *) data.bytes) + inSample->offset, inSample->size);
+    XCTAssert(cmp == 0);
+  }
+
+  mp4_index_free(&index);
+  mp4_index_free(&outIndex);
+
+  // The remuxed file still plays in lock-step with the original alpha
+
+  Mp4PairReport report;
+  err = mp4_pair_check_files([outPath fileSystemRepresentation], [alphaPath fileSystemRepresentation], &report);
+  XCTAssert(err == 0);
+  XCTAssert(report.isLockStep);
+
+  [[NSFileManager defaultManager] removeItemAtPath:outPath error:nil];
+}
+
+@end
@@ -0,0 +1,339 @@
+//
+//  PngReaderTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+#import <ImageIO/ImageIO.h>
+
+#import "png_reader.h"
+#import "png_writer.h"
+
+@interface PngReaderTests : XCTestCase
+
+@end
+
+@implementation PngReaderTests
+
+- (NSString*) resourcePath:(NSString*)filename
+{
+  NSString *testsDir = [[NSString stringWithUTF8String:__FILE__] stringByDeletingLastPathComponent];
+  NSString *resDir = [[testsDir stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"Resources"];
+  NSString *path = [resDir stringByAppendingPathComponent:filename];
+
+  if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
+    return path;
+  }
+
+  NSBundle *bundle = [NSBundle bundleForClass:self.class];
+  return [bundle pathForResource:[filename stringByDeletingPathExtension] ofType:[filename pathExtension]];
+}
+
+// Pixels written by png_writer.h must read back unchanged
+
+- (void)testRoundTripRGBA {
+  const int width = 6;
+  const int height = 5;
+  uint32_t pixels[width * height];
+
+  for (int i = 0; i < (width * height); i++) {
+    pixels[i] = ((uint32_t) (i * 8) << 24) | ((i * 3) << 16) | ((i * 5) << 8) | (255 - i);
+  }
+
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"png_reader_rgba.png"];
+
+  int err = png_write_file([path fileSystemRepresentation], pixels, width, width, height, 1);
+  XCTAssert(err == 0);
+
+  PngImage image;
+  err = png_read_file([path fileSystemRepresentation], &image);
+  XCTAssert(err == 0);
+
+  {
+    int v = image.width;
+    int expectedVal = width;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = image.height;
+    int expectedVal = height;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(image.hasAlpha);
+
+  // png_writer.h writes an sRGB chunk
+  XCTAssert(image.colorspace == PngColorspaceSRGB);
+
+  int cmp = memcmp(image.pixels, pixels, sizeof(pixels));
+  XCTAssert(cmp == 0);
+
+  png_image_free(&image);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+// AlphaBG.png is an opaque RGB image that uses the Sub, Up and Paeth filters
+
+- (void)testReadAlphaBG {
+  NSString *path = [self resourcePath:@"AlphaBG.png"];
+
+  if (path == nil) {
+    return;
+  }
+
+  PngImage image;
+  int err = png_read_file([path fileSystemRepresentation], &image);
+  XCTAssert(err == 0);
+
+  {
+    int v = image.width;
+    int expectedVal = 32;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(image.hasAlpha == 0);
+
+  {
+    uint32_t v = image.pixels[0];
+    uint32_t expectedVal = 0xFF666666;
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  png_image_free(&image);
+}
+
+// The vector unfilter must match png_unfilter_row() for every filter
+// and pixel size, including the first row where there is no prevRow.
+
+- (void)testUnfilterFastMatchesScalar {
+  const int maxNumBytes = 256;
+  uint8_t row[maxNumBytes + PNG_ROW_PADDING];
+  uint8_t fastRow[maxNumBytes + PNG_ROW_PADDING];
+  uint8_t prevRow[maxNumBytes + PNG_ROW_PADDING];
+  uint8_t zeroRow[maxNumBytes + PNG_ROW_PADDING];
+
+  memset(zeroRow, 0, sizeof(zeroRow));
+
+  uint32_t seed = 1;
+  int numMismatched = 0;
+
+  for (int bpp = 1; bpp <= 4; bpp++) {
+    for (int filterType = 0; filterType <= 4; filterType++) {
+      for (int rowNumBytes = bpp; rowNumBytes <= maxNumBytes; rowNumBytes += bpp) {
+        for (int firstRow = 0; firstRow < 2; firstRow++) {
+          for (int i = 0; i < (int) sizeof(row); i++) {
+            seed = (seed * 1664525) + 1013904223;
+            row[i] = (uint8_t) (seed >> 24);
+            prevRow[i] = (uint8_t) (seed >> 16);
+          }
+
+          memcpy(fastRow, row, sizeof(row));
+
+          png_unfilter_row(filterType, row, firstRow ? NULL : prevRow, rowNumBytes, bpp);
+          png_unfilter_row_fast(filterType, fastRow, firstRow ? zeroRow : prevRow, rowNumBytes, bpp);
+
+          if (memcmp(row, fastRow, rowNumBytes) != 0) {
+            numMismatched += 1;
+          }
+        }
+      }
+    }
+  }
+
+  {
+    int v = numMismatched;
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Append a chunk to a PNG being built in memory, the CRC is not checked on read
+
+static
+void appendChunk(NSMutableData *data, const char *type, const uint8_t *chunk, uint32_t len)
+{
+  uint8_t lenBytes[4] = { (uint8_t) (len >> 24), (uint8_t) (len >> 16), (uint8_t) (len >> 8), (uint8_t) len };
+  uint8_t crc[4] = { 0, 0, 0, 0 };
+  [data appendBytes:lenBytes length:4];
+  [data appendBytes:type length:4];
+  if (len > 0) {
+    [data appendBytes:chunk length:len];
+  }
+  [data appendBytes:crc length:4];
+}
+
+- (PngColorspace) colorspaceWithChunk:(const char*)type chunk:(const uint8_t*)chunk len:(uint32_t)len
+{
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  static const uint8_t ihdr[13] = { 0, 0, 0, 2, 0, 0, 0, 2, 8, 2, 0, 0, 0 };
+
+  NSMutableData *data = [NSMutableData data];
+  [data appendBytes:signature length:8];
+  appendChunk(data, "IHDR", ihdr, 13);
+  if (type != NULL) {
+    appendChunk(data, type, chunk, len);
+  }
+  appendChunk(data, "IEND", NULL, 0);
+
+  PngInfo info;
+  int err = png_read_info((const uint8_t *) data.bytes, data.length, &info);
+  XCTAssert(err == 0);
+
+  return info.colorspace;
+}
+
+// Colorspace is classified from chunks without inflating image data
+
+- (void)testColorspaceChunks {
+  const uint8_t srgb[1] = { 0 };
+  const uint8_t gammaLinear[4] = { 0, 0x01, 0x86, 0xA0 };
+  const uint8_t gamma22[4] = { 0, 0, 0xB1, 0x8F };
+  const uint8_t cicpSRGB[4] = { 1, 13, 0, 1 };
+  const uint8_t cicpLinear[4] = { 1, 8, 0, 1 };
+  const uint8_t cicpBT709[4] = { 1, 1, 0, 1 };
+  const uint8_t cicpP3[4] = { 12, 13, 0, 1 };
+  const uint8_t cicpPQ[4] = { 9, 16, 0, 1 };
+  const uint8_t iccpSRGB[] = "sRGB IEC61966-2.1\0\0";
+  const uint8_t iccpOther[] = "Custom\0\0";
+
+  XCTAssert([self colorspaceWithChunk:NULL chunk:NULL len:0] == PngColorspaceUntagged);
+  XCTAssert([self colorspaceWithChunk:"sRGB" chunk:srgb len:1] == PngColorspaceSRGB);
+  XCTAssert([self colorspaceWithChunk:"gAMA" chunk:gammaLinear len:4] == PngColorspaceLinearSRGB);
+  XCTAssert([self colorspaceWithChunk:"gAMA" chunk:gamma22 len:4] == PngColorspaceOther);
+  XCTAssert([self colorspaceWithChunk:"cICP" chunk:cicpSRGB len:4] == PngColorspaceSRGB);
+  XCTAssert([self colorspaceWithChunk:"cICP" chunk:cicpLinear len:4] == PngColorspaceLinearSRGB);
+  XCTAssert([self colorspaceWithChunk:"cICP" chunk:cicpBT709 len:4] == PngColorspaceBT709);
+  XCTAssert([self colorspaceWithChunk:"cICP" chunk:cicpP3 len:4] == PngColorspaceDisplayP3);
+  XCTAssert([self colorspaceWithChunk:"cICP" chunk:cicpPQ len:4] == PngColorspaceOther);
+  XCTAssert([self colorspaceWithChunk:"iCCP" chunk:iccpSRGB len:sizeof(iccpSRGB)] == PngColorspaceSRGB);
+  XCTAssert([self colorspaceWithChunk:"iCCP" chunk:iccpOther len:sizeof(iccpOther)] == PngColorspaceOther);
+}
+
+// Planar float output holds the same values as BGRA output
+
+- (void)testPlanarFloat {
+  const int width = 8;
+  const int height = 4;
+  uint32_t pixels[width * height];
+
+  for (int i = 0; i < (width * height); i++) {
+    pixels[i] = ((uint32_t) (i * 7) << 24) | ((i * 3) << 16) | ((i * 5) << 8) | (255 - i);
+  }
+
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"png_reader_planar.png"];
+
+  int err = png_write_file([path fileSystemRepresentation], pixels, width, width, height, 1);
+  XCTAssert(err == 0);
+
+  PngMappedFile mapped;
+  err = png_map_file([path fileSystemRepresentation], &mapped);
+  XCTAssert(err == 0);
+
+  PngInfo info;
+  err = png_read_info(mapped.data, mapped.len, &info);
+  XCTAssert(err == 0);
+
+  float planes[4][width * height];
+
+  PngOutput output;
+  memset(&output, 0, sizeof(output));
+  output.format = PngOutputPlanarFloat;
+  for (int i = 0; i < 4; i++) {
+    output.planes[i] = planes[i];
+  }
+  output.floatsPerRow = width;
+
+  err = png_decode_buffer(mapped.data, mapped.len, &info, &output);
+  XCTAssert(err == 0);
+
+  png_unmap_file(&mapped);
+
+  for (int i = 0; i < (width * height); i++) {
+    const uint32_t pixel = pixels[i];
+    XCTAssert(planes[0][i] == ((pixel >> 16) & 0xFF) / 255.0f);
+    XCTAssert(planes[1][i] == ((pixel >> 8) & 0xFF) / 255.0f);
+    XCTAssert(planes[2][i] == (pixel & 0xFF) / 255.0f);
+    XCTAssert(planes[3][i] == (pixel >> 24) / 255.0f);
+  }
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+// Write a smooth RGBA frame like a rendered animation frame
+
+- (NSString*) writeBenchmarkFrame:(int)width height:(int)height
+{
+  NSString *filename = [NSString stringWithFormat:@"png_reader_%dx%d.png", width, height];
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      uint32_t A = (col < (width / 2)) ? 0xFF : 0x80;
+      uint32_t R = (col * 255) / width;
+      uint32_t G = (row * 255) / height;
+      uint32_t B = (col ^ row) & 0xFF;
+      pixels[(row * width) + col] = (A << 24) | (R << 16) | (G << 8) | B;
+    }
+  }
+
+  png_write_file([path fileSystemRepresentation], pixels, width, width, height, 1);
+  free(pixels);
+
+  return path;
+}
+
+- (void) measureDecode:(int)width height:(int)height
+{
+  NSString *path = [self writeBenchmarkFrame:width height:height];
+
+  [self measureBlock:^{
+    PngImage image;
+    int err = png_read_file([path fileSystemRepresentation], &image);
+    XCTAssert(err == 0);
+    png_image_free(&image);
+  }];
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+// Decode and render with ImageIO, as srgb_to_bt709 -ingest imageio does
+
+- (void) measureImageIODecode:(int)width height:(int)height
+{
+  NSString *path = [self writeBenchmarkFrame:width height:height];
+
+  [self measureBlock:^{
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    CGImageSourceRef sourceRef = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    NSDictionary *options = @{ (id)kCGImageSourceShouldCacheImmediately: @(TRUE) };
+    CGImageRef imageRef = CGImageSourceCreateImageAtIndex(sourceRef, 0, (__bridge CFDictionaryRef)options);
+    XCTAssert(imageRef != NULL);
+    CGImageRelease(imageRef);
+    CFRelease(sourceRef);
+  }];
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testPerformanceDecode1080p {
+  [self measureDecode:1920 height:1080];
+}
+
+- (void)testPerformanceDecode4K {
+  [self measureDecode:3840 height:2160];
+}
+
+- (void)testPerformanceImageIODecode1080p {
+  [self measureImageIODecode:1920 height:1080];
+}
+
+- (void)testPerformanceImageIODecode4K {
+  [self measureImageIODecode:3840 height:2160];
+}
+
+@end
@@ -0,0 +1,240 @@
+//
+//  PremultiplyTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "premultiply.h"
+
+#import "BGRAToBT709Converter.h"
+#import "CGFrameBuffer.h"
+
+@interface PremultiplyTests : XCTestCase
+
+@end
+
+@implementation PremultiplyTests
+
+// 32 BPP premultiplied image where every (C, A) pair appears
+
+- (CGImageRef) makePremultipliedImage:(int)width height:(int)height CF_RETURNS_RETAINED
+{
+  CGFrameBuffer *cgFramebuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
+
+  CGColorSpaceRef cs = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+  cgFramebuffer.colorspace = cs;
+  CGColorSpaceRelease(cs);
+
+  uint32_t *pixels = (uint32_t *) cgFramebuffer.pixels;
+
+  for (int i = 0; i < (width * height); i++) {
+    uint32_t A = (i >> 8) & 0xFF;
+    uint32_t R = premultiply_component(i & 0xFF, A);
+    uint32_t G = premultiply_component((i * 7) & 0xFF, A);
+    uint32_t B = premultiply_component((i * 13) & 0xFF, A);
+    pixels[i] = (A << 24) | (R << 16) | (G << 8) | B;
+  }
+
+  return [cgFramebuffer createCGImageRef];
+}
+
+// Both byte kernels must match the rounding contract for every input
+
+- (void)testComponentContract {
+  PremultiplyTables tables;
+  premultiply_tables_init(&tables);
+
+  int numMismatched = 0;
+
+  for (uint32_t A = 0; A < 256; A++) {
+    for (uint32_t C = 0; C < 256; C++) {
+      uint32_t v = premultiply_component(C, A);
+      uint32_t expectedVal = (uint32_t) round(C * A / 255.0);
+      if (v != expectedVal) {
+        numMismatched++;
+      }
+
+      if (A > 0 && C <= A) {
+        v = unpremultiply_component(tables.reciprocal, C, A);
+        expectedVal = ((C * 255) + (A / 2)) / A;
+        expectedVal = (expectedVal > 255) ? 255 : expectedVal;
+        if (v != expectedVal) {
+          numMismatched++;
+        }
+      }
+    }
+  }
+
+  {
+    int v = numMismatched;
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Vector rows must match the scalar pixel functions, including the
+// tail pixels and the opaque and transparent fast paths.
+
+- (void)testRowMatchesPixel {
+  PremultiplyTables tables;
+  premultiply_tables_init(&tables);
+
+  const int numPixels = 256 * 256 + 3;
+  uint32_t *inPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+
+  for (int i = 0; i < numPixels; i++) {
+    uint32_t A = (i < 64) ? 0 : ((i < 128) ? 255 : ((i >> 8) & 0xFF));
+    inPixels[i] = (A << 24) | ((i * 3) & 0xFFFFFF);
+  }
+
+  int numMismatched = 0;
+
+  premultiply_row(inPixels, outPixels, numPixels);
+
+  for (int i = 0; i < numPixels; i++) {
+    if (outPixels[i] != premultiply_pixel(inPixels[i])) {
+      numMismatched++;
+    }
+  }
+
+  // Unpremultiply the premultiplied pixels in place
+
+  unpremultiply_row(&tables, outPixels, outPixels, numPixels);
+  premultiply_row(inPixels, inPixels, numPixels);
+
+  for (int i = 0; i < numPixels; i++) {
+    if (outPixels[i] != unpremultiply_pixel(&tables, inPixels[i])) {
+      numMismatched++;
+    }
+  }
+
+  {
+    int v = numMismatched;
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  free(inPixels);
+  free(outPixels);
+}
+
+// Linear light round trip of opaque pixels returns the same bytes
+
+- (void)testLinearRoundTrip {
+  PremultiplyTables tables;
+  premultiply_tables_init(&tables);
+
+  uint32_t inPixels[256];
+  uint32_t outPixels[256];
+  pm_float4 vecs[256];
+
+  for (int i = 0; i < 256; i++) {
+    inPixels[i] = (0xFFu << 24) | (i << 16) | ((255 - i) << 8) | (i / 2);
+  }
+
+  premultiply_linear_row(&tables, inPixels, vecs, 256);
+  unpremultiply_linear_row(&tables, vecs, outPixels, 256);
+
+  int cmp = memcmp(inPixels, outPixels, sizeof(inPixels));
+  XCTAssert(cmp == 0);
+}
+
+// The table based converter must match the vImage implementation
+
+- (void)testUnpremultiplyMatchesVImage {
+  const int width = 256;
+  const int height = 256;
+
+  CGImageRef inImage = [self makePremultipliedImage:width height:height];
+
+  CGImageRef outImage = [BGRAToBT709Converter unpremultiply:inImage];
+  CGImageRef refImage = [BGRAToBT709Converter unpremultiplyWithVImage:inImage];
+
+  XCTAssert(outImage != NULL);
+  XCTAssert(refImage != NULL);
+
+  CFDataRef outData = CGDataProviderCopyData(CGImageGetDataProvider(outImage));
+  CFDataRef refData = CGDataProviderCopyData(CGImageGetDataProvider(refImage));
+
+  const size_t outBytesPerRow = CGImageGetBytesPerRow(outImage);
+  const size_t refBytesPerRow = CGImageGetBytesPerRow(refImage);
+
+  int numMismatched = 0;
+
+  for (int row = 0; row < height; row++) {
+    const uint32_t *outRow = (const uint32_t *) (CFDataGetBytePtr(outData) + (row * outBytesPerRow));
+    const uint32_t *refRow = (const uint32_t *) (CFDataGetBytePtr(refData) + (row * refBytesPerRow));
+
+    for (int col = 0; col < width; col++) {
+      if ((outRow[col] & 0xFFFFFF) != (refRow[col] & 0xFFFFFF)) {
+        numMismatched++;
+      }
+    }
+  }
+
+  {
+    int v = numMismatched;
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  CFRelease(outData);
+  CFRelease(refData);
+  CGImageRelease(outImage);
+  CGImageRelease(refImage);
+  CGImageRelease(inImage);
+}
+
+- (void)testPerformanceUnpremultiply {
+  CGImageRef inImage = [self makePremultipliedImage:1920 height:1080];
+
+  [self measureBlock:^{
+    for (int i = 0; i < 10; i++) {
+      CGImageRef outImage = [BGRAToBT709Converter unpremultiply:inImage];
+      CGImageRelease(outImage);
+    }
+  }];
+
+  CGImageRelease(inImage);
+}
+
+- (void)testPerformanceUnpremultiplyWithVImage {
+  CGImageRef inImage = [self makePremultipliedImage:1920 height:1080];
+
+  [self measureBlock:^{
+    for (int i = 0; i < 10; i++) {
+      CGImageRef outImage = [BGRAToBT709Converter unpremultiplyWithVImage:inImage];
+      CGImageRelease(outImage);
+    }
+  }];
+
+  CGImageRelease(inImage);
+}
+
+- (void)testPerformanceUnpremultiplyRow {
+  PremultiplyTables tables;
+  premultiply_tables_init(&tables);
+
+  const int numPixels = 1920 * 1080;
+  uint32_t *inPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(numPixels * sizeof(uint32_t));
+
+  for (int i = 0; i < numPixels; i++) {
+    uint32_t A = (i >> 4) & 0xFF;
+    inPixels[i] = premultiply_pixel((A << 24) | (i & 0xFFFFFF));
+  }
+
+  [self measureBlock:^{
+    for (int i = 0; i < 10; i++) {
+      unpremultiply_row(&tables, inPixels, outPixels, numPixels);
+    }
+  }];
+
+  free(inPixels);
+  free(outPixels);
+}
+
+@end
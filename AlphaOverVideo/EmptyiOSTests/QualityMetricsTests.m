@@ -0,0 +1,275 @@
+//
+//  QualityMetricsTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "quality_metrics.h"
+
+@interface QualityMetricsTests : XCTestCase
+
+@end
+
+@implementation QualityMetricsTests
+
+- (void)testIdenticalFrames {
+  const int width = 4;
+  const int height = 2;
+
+  uint8_t yPlane[8] = { 16, 50, 100, 150, 200, 235, 128, 64 };
+  uint8_t cbPlane[2] = { 100, 160 };
+  uint8_t crPlane[2] = { 140, 90 };
+  uint32_t srcRow[4];
+  uint32_t dstRow[4];
+
+  QualityTables tables;
+  quality_tables_init(&tables, BT709GammaSrgb);
+
+  QualityLinearError err;
+  memset(&err, 0, sizeof(err));
+
+  quality_linear_error_frame(&tables,
+                             yPlane, cbPlane, crPlane,
+                             yPlane, cbPlane, crPlane,
+                             width, height, srcRow, dstRow, &err);
+
+  {
+    int v = (int) err.numPixels;
+    int expectedVal = 8;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) round(quality_linear_psnr(&err));
+    int expectedVal = (int) QUALITY_MAX_PSNR;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Gray pixels in linear gamma decode to the same value in R G B,
+// so the error of a single step is known exactly.
+
+- (void)testLinearGrayOffset {
+  const int width = 2;
+  const int height = 2;
+
+  QualityTables tables;
+  quality_tables_init(&tables, BT709GammaLinear);
+
+  uint8_t srcY[4] = { 126, 126, 126, 126 };
+  uint8_t dstY[4] = { 126, 126, 126, 126 };
+  uint8_t cb[1] = { 128 };
+  uint8_t cr[1] = { 128 };
+  uint32_t srcRow[2];
+  uint32_t dstRow[2];
+
+  uint32_t pixel;
+  bt709_decode_frame(srcY, cb, cr, 1, 1, BT709GammaLinear, &pixel, 1);
+  int gray = pixel & 0xFF;
+
+  // Find the Y value that decodes to gray + 16
+
+  for (int Y = 126; Y < 256; Y++) {
+    uint8_t yVal = (uint8_t) Y;
+    bt709_decode_frame(&yVal, cb, cr, 1, 1, BT709GammaLinear, &pixel, 1);
+    if ((int) (pixel & 0xFF) == gray + 16) {
+      memset(dstY, Y, sizeof(dstY));
+      break;
+    }
+  }
+
+  XCTAssert(dstY[0] != 126);
+
+  QualityLinearError err;
+  memset(&err, 0, sizeof(err));
+
+  quality_linear_error_frame(&tables,
+                             srcY, cb, cr,
+                             dstY, cb, cr,
+                             width, height, srcRow, dstRow, &err);
+
+  // 10 * log10(1 / (16/255)^2) = 24.05 dB
+
+  {
+    int v = (int) round(quality_linear_psnr(&err) * 100);
+    int expectedVal = 2405;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  for (int c = 0; c < 3; c++) {
+    int v = (int) round(quality_linear_channel_psnr(&err, c) * 100);
+    int expectedVal = 2405;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Half the alpha pixels off by 255 gives an MSE of 0.5, so 3.01 dB
+
+- (void)testAlphaError {
+  QualityTables tables;
+  quality_tables_init(&tables, BT709GammaLinear);
+
+  uint8_t srcY[4];
+  uint8_t dstY[4];
+
+  // Y values that decode to alpha 0 and 255
+
+  int zeroY = -1;
+  int fullY = -1;
+
+  for (int Y = 0; Y < 256; Y++) {
+    if (zeroY == -1 && tables.alphaTable[Y] == 0) {
+      zeroY = Y;
+    }
+    if (fullY == -1 && tables.alphaTable[Y] == 255) {
+      fullY = Y;
+    }
+  }
+
+  XCTAssert(zeroY != -1 && fullY != -1);
+
+  srcY[0] = srcY[1] = srcY[2] = srcY[3] = (uint8_t) fullY;
+  dstY[0] = dstY[1] = (uint8_t) fullY;
+  dstY[2] = dstY[3] = (uint8_t) zeroY;
+
+  QualityAlphaError err;
+  memset(&err, 0, sizeof(err));
+
+  quality_alpha_error_frame(&tables, srcY, dstY, 2, 2, &err);
+
+  {
+    int v = (int) round(quality_alpha_psnr(&err) * 100);
+    int expectedVal = 301;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// Compare BGRA source pixels to planes encoded from the same pixels,
+// Y must match exactly so Y PSNR is the max and SSIM is 1.0
+
+- (void)testSourceFrameIdentical {
+  const int width = 72;
+  const int height = 40;
+
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint8_t *yPlane = (uint8_t *) malloc(width * height);
+  uint8_t *cbPlane = (uint8_t *) malloc(width * height / 4);
+  uint8_t *crPlane = (uint8_t *) malloc(width * height / 4);
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      uint32_t R = (col * 3) & 0xFF;
+      uint32_t G = (row * 5) & 0xFF;
+      uint32_t B = (col + row) & 0xFF;
+      pixels[(row * width) + col] = (0xFFu << 24) | (R << 16) | (G << 8) | B;
+
+      int Y, Cb, Cr;
+      sRGB_from_sRGB_convertRGBToYCbCr(R, G, B, &Y, &Cb, &Cr);
+      yPlane[(row * width) + col] = Y;
+
+      if ((row % 2) == 0 && (col % 2) == 0) {
+        cbPlane[((row / 2) * (width / 2)) + (col / 2)] = Cb;
+        crPlane[((row / 2) * (width / 2)) + (col / 2)] = Cr;
+      }
+    }
+  }
+
+  QualityTables tables;
+  quality_tables_init(&tables, BT709GammaSrgb);
+
+  QualityFrame frame;
+  frame.tables = &tables;
+  frame.srcPixels = pixels;
+  frame.srcPixelsPerRow = width;
+  frame.dstY = yPlane;
+  frame.dstCb = cbPlane;
+  frame.dstCr = crPlane;
+  frame.dstAlpha = NULL;
+  frame.isPremultiplied = 0;
+  frame.width = width;
+  frame.height = height;
+
+  {
+    int v = quality_frame_num_tiles(&frame);
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  QualityStats stats;
+  memset(&stats, 0, sizeof(stats));
+  quality_measure(&frame, &stats);
+
+  {
+    int v = (int) round(quality_stats_y_psnr(&stats));
+    int expectedVal = (int) QUALITY_MAX_PSNR;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = (int) round(quality_stats_ssim(&stats) * 1000);
+    int expectedVal = 1000;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // One 8x8 window every 4 pixels, windows cross the tile edge
+
+  {
+    int v = (int) stats.ssimNumWindows;
+    int expectedVal = (((width - 8) / 4) + 1) * (((height - 8) / 4) + 1);
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Y is off by 2 in every pixel : 10 * log10(255^2 / 4) = 42.11 dB
+
+  for (int i = 0; i < (width * height); i++) {
+    yPlane[i] = yPlane[i] + 2;
+  }
+
+  memset(&stats, 0, sizeof(stats));
+  quality_measure(&frame, &stats);
+
+  {
+    int v = (int) round(quality_stats_y_psnr(&stats) * 100);
+    int expectedVal = 4211;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(quality_stats_ssim(&stats) < 1.0);
+
+  free(pixels);
+  free(yPlane);
+  free(cbPlane);
+  free(crPlane);
+}
+
+// The table driven decode must match bt709_decode_pixel()
+
+- (void)testDecodePixel {
+  QualityTables tables;
+  quality_tables_init(&tables, BT709GammaSrgb);
+
+  int numMismatched = 0;
+
+  for (int Y = 0; Y < 256; Y += 3) {
+    for (int Cb = 0; Cb < 256; Cb += 5) {
+      for (int Cr = 0; Cr < 256; Cr += 7) {
+        int R1, G1, B1, R2, G2, B2;
+        bt709_decode_pixel(Y, Cb, Cr, BT709GammaSrgb, &R1, &G1, &B1);
+        quality_decode_pixel(&tables, Y, Cb, Cr, &R2, &G2, &B2);
+        if (R1 != R2 || G1 != G2 || B1 != B2) {
+          numMismatched++;
+        }
+      }
+    }
+  }
+
+  {
+    int v = numMismatched;
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+@end
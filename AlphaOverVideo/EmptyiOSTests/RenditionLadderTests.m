@@ -0,0 +1,197 @@
+//
+//  RenditionLadderTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "rendition_ladder.h"
+
+@interface RenditionLadderTests : XCTestCase
+
+@end
+
+@implementation RenditionLadderTests
+
+// Black and white pixels average to 50% linear light, sRGB 188 and not 128
+
+- (void)testCheckerAveragesInLinearLight {
+  uint32_t pixels[4 * 4];
+
+  for (int i = 0; i < (4 * 4); i++) {
+    pixels[i] = (((i / 4) + (i % 4)) & 0x1) ? 0xFFFFFFFF : 0xFF000000;
+  }
+
+  RenditionSize sizes[] = { { 2, 2 } };
+  RenditionLadder ladder;
+
+  int err = rendition_ladder_init(&ladder, 0, 4, 4, sizes, 1);
+  XCTAssert(err == 0);
+
+  rendition_ladder_set_source(&ladder, pixels, 4);
+
+  uint32_t outPixels[2 * 2];
+  rendition_ladder_render(&ladder, 0, outPixels, 2);
+
+  for (int i = 0; i < (2 * 2); i++) {
+    uint32_t v = outPixels[i];
+    uint32_t expectedVal = 0xFFBCBCBC;
+    XCTAssert(v == expectedVal, @"0x%08X != 0x%08X", v, expectedVal);
+  }
+
+  rendition_ladder_free(&ladder);
+}
+
+// Transparent pixels next to opaque white do not darken the color
+
+- (void)testTransparentEdge {
+  uint32_t pixels[4 * 2];
+
+  for (int i = 0; i < (4 * 2); i++) {
+    pixels[i] = ((i % 2) == 0) ? 0xFFFFFFFF : 0x0;
+  }
+
+  RenditionSize sizes[] = { { 2, 2 } };
+  RenditionLadder ladder;
+
+  int err = rendition_ladder_init(&ladder, 0, 4, 2, sizes, 1);
+  XCTAssert(err == 0);
+
+  rendition_ladder_set_source(&ladder, pixels, 4);
+
+  uint32_t outPixels[2 * 2];
+  rendition_ladder_render(&ladder, 0, outPixels, 2);
+
+  for (int i = 0; i < (2 * 2); i++) {
+    uint32_t pixel = outPixels[i];
+    uint32_t A = pixel >> 24;
+
+    XCTAssert(A > 0 && A < 255);
+
+    // Premultiplied white has every component equal to alpha
+
+    XCTAssert((pixel & 0xFF) == A, @"0x%08X", pixel);
+    XCTAssert(((pixel >> 8) & 0xFF) == A, @"0x%08X", pixel);
+    XCTAssert(((pixel >> 16) & 0xFF) == A, @"0x%08X", pixel);
+  }
+
+  rendition_ladder_free(&ladder);
+}
+
+// A solid color stays the same at every size, the source size is an exact copy
+
+- (void)testSolidColorAndLevels {
+  const int width = 256;
+  const int height = 192;
+  const uint32_t solidPixel = premultiply_pixel(0x80336699);
+
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+
+  for (int i = 0; i < (width * height); i++) {
+    pixels[i] = solidPixel;
+  }
+
+  RenditionSize sizes[] = { { 256, 192 }, { 192, 144 }, { 128, 96 }, { 60, 46 } };
+  const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  RenditionLadder ladder;
+
+  int err = rendition_ladder_init(&ladder, 0, width, height, sizes, numSizes);
+  XCTAssert(err == 0);
+
+  // 256x192, 128x96 and 64x48 levels, 60x46 is resampled from 64x48
+
+  {
+    int v = ladder.numLevels;
+    int expectedVal = 3;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = ladder.levelForRendition[1];
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = ladder.levelForRendition[3];
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  rendition_ladder_set_source(&ladder, pixels, width);
+
+  for (int r = 0; r < numSizes; r++) {
+    rendition_ladder_render(&ladder, r, outPixels, sizes[r].width);
+
+    int numWrong = 0;
+
+    for (int i = 0; i < (sizes[r].width * sizes[r].height); i++) {
+      if (outPixels[i] != solidPixel) {
+        numWrong += 1;
+      }
+    }
+
+    XCTAssert(numWrong == 0, @"%d wrong pixels at %d x %d", numWrong, sizes[r].width, sizes[r].height);
+  }
+
+  rendition_ladder_free(&ladder);
+
+  free(pixels);
+  free(outPixels);
+}
+
+// Sizes larger than the source or with odd dimensions are rejected
+
+- (void)testInvalidSizes {
+  RenditionLadder ladder;
+
+  RenditionSize largerSizes[] = { { 128, 128 } };
+  int err = rendition_ladder_init(&ladder, 0, 64, 64, largerSizes, 1);
+  XCTAssert(err == RL_ERR_SIZE);
+
+  RenditionSize oddSizes[] = { { 31, 32 } };
+  err = rendition_ladder_init(&ladder, 0, 64, 64, oddSizes, 1);
+  XCTAssert(err == RL_ERR_SIZE);
+}
+
+// Build the pyramid for a 2048x1536 frame and render a 4 size ladder
+
+- (void)testPerformanceLadder2048 {
+  const int width = 2048;
+  const int height = 1536;
+
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+
+  for (int i = 0; i < (width * height); i++) {
+    pixels[i] = premultiply_pixel(0x80000000 | (i * 2654435761u));
+  }
+
+  RenditionSize sizes[] = { { 2048, 1536 }, { 1536, 1152 }, { 1024, 768 }, { 480, 360 } };
+  const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  RenditionLadder ladder;
+  RenditionLadder *ladderPtr = &ladder;
+  const RenditionSize *sizesPtr = sizes;
+
+  int err = rendition_ladder_init(&ladder, 0, width, height, sizes, numSizes);
+  XCTAssert(err == 0);
+
+  [self measureBlock:^{
+    rendition_ladder_set_source(ladderPtr, pixels, width);
+
+    for (int r = 0; r < numSizes; r++) {
+      rendition_ladder_render(ladderPtr, r, outPixels, sizesPtr[r].width);
+    }
+  }];
+
+  rendition_ladder_free(&ladder);
+
+  free(pixels);
+  free(outPixels);
+}
+
+@end
@@ -0,0 +1,203 @@
+//
+//  RenditionManifestTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "rendition_manifest.h"
+
+static const char *exampleManifest =
+"# Example renditions\n"
+"\n"
+"2048x1536 8000 Example_2048x1536.m4v Example_2048x1536_alpha.m4v\n"
+"1024x768 3000 Example_1024x768.m4v Example_1024x768_alpha.m4v\r\n"
+"  1024x768 2000 Example_1024x768_low.m4v Example_1024x768_low_alpha.m4v\n"
+"512x384 900 Example_512x384.m4v Example_512x384_alpha.m4v";
+
+@interface RenditionManifestTests : XCTestCase
+
+@end
+
+@implementation RenditionManifestTests
+
+- (int) select:(const RenditionManifest*)manifest
+         width:(int)width
+        height:(int)height
+    maxBitrate:(int)maxBitrate
+{
+  return rendition_manifest_select(manifest, width, height, maxBitrate);
+}
+
+- (void)testParse {
+  RenditionManifest manifest;
+  int err = rendition_manifest_parse(exampleManifest, strlen(exampleManifest), &manifest);
+  XCTAssert(err == 0);
+
+  {
+    int v = manifest.numRenditions;
+    int expectedVal = 4;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(manifest.hasAlpha == 1);
+
+  {
+    int v = manifest.renditions[1].bitrateKbps;
+    int expectedVal = 3000;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(strcmp(manifest.renditions[1].alphaPath, "Example_1024x768_alpha.m4v") == 0);
+  XCTAssert(strcmp(manifest.renditions[2].rgbPath, "Example_1024x768_low.m4v") == 0);
+}
+
+// Errors report the line that could not be parsed
+
+- (void)testParseErrors {
+  RenditionManifest manifest;
+
+  const char *extraToken = "100x100 10 a.m4v b.m4v c.m4v";
+  int err = rendition_manifest_parse(extraToken, strlen(extraToken), &manifest);
+  XCTAssert(err == RM_ERR_SYNTAX);
+
+  const char *oddSize = "100x100 10 a.m4v\n101x100 10 b.m4v";
+  err = rendition_manifest_parse(oddSize, strlen(oddSize), &manifest);
+  XCTAssert(err == RM_ERR_SIZE);
+
+  {
+    int v = manifest.errorLine;
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  const char *noBitrate = "100x100 a.m4v b.m4v";
+  err = rendition_manifest_parse(noBitrate, strlen(noBitrate), &manifest);
+  XCTAssert(err == RM_ERR_SYNTAX);
+
+  const char *mixedAlpha = "100x100 10 a.m4v a_alpha.m4v\n50x50 5 b.m4v";
+  err = rendition_manifest_parse(mixedAlpha, strlen(mixedAlpha), &manifest);
+  XCTAssert(err == RM_ERR_MIXED_ALPHA);
+
+  const char *onlyComments = "# nothing\n\n";
+  err = rendition_manifest_parse(onlyComments, strlen(onlyComments), &manifest);
+  XCTAssert(err == RM_ERR_EMPTY);
+}
+
+// The smallest rendition that covers the view is selected
+
+- (void)testSelect {
+  RenditionManifest manifest;
+  int err = rendition_manifest_parse(exampleManifest, strlen(exampleManifest), &manifest);
+  XCTAssert(err == 0);
+
+  // Equal sizes prefer the higher bitrate
+
+  {
+    int v = [self select:&manifest width:1000 height:700 maxBitrate:0];
+    int expectedVal = 1;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Exact size match
+
+  {
+    int v = [self select:&manifest width:512 height:384 maxBitrate:0];
+    int expectedVal = 3;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // One pixel too wide for 1024x768
+
+  {
+    int v = [self select:&manifest width:1025 height:700 maxBitrate:0];
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Larger than every rendition
+
+  {
+    int v = [self select:&manifest width:4096 height:3072 maxBitrate:0];
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Unknown view size
+
+  {
+    int v = [self select:&manifest width:0 height:0 maxBitrate:0];
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+// A bitrate limit skips the renditions above it
+
+- (void)testSelectMaxBitrate {
+  RenditionManifest manifest;
+  int err = rendition_manifest_parse(exampleManifest, strlen(exampleManifest), &manifest);
+  XCTAssert(err == 0);
+
+  {
+    int v = [self select:&manifest width:1000 height:700 maxBitrate:2500];
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Too large for any allowed rendition, the largest allowed is used
+
+  {
+    int v = [self select:&manifest width:2048 height:1536 maxBitrate:1000];
+    int expectedVal = 3;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  // Every rendition is over the limit, the lowest bitrate is used
+
+  {
+    int v = [self select:&manifest width:1000 height:700 maxBitrate:100];
+    int expectedVal = 3;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+
+// Levels step down from the selected rendition to each smaller size,
+// renditions of the same size are not separate levels.
+
+- (void)testLevels {
+  RenditionManifest manifest;
+  int err = rendition_manifest_parse(exampleManifest, strlen(exampleManifest), &manifest);
+  XCTAssert(err == 0);
+
+  int levels[RM_MAX_RENDITIONS];
+
+  {
+    int v = rendition_manifest_levels(&manifest, 0, levels, RM_MAX_RENDITIONS);
+    int expectedVal = 3;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(levels[0] == 0);
+  XCTAssert(levels[1] == 1);
+  XCTAssert(levels[2] == 3);
+
+  {
+    int v = rendition_manifest_levels(&manifest, 2, levels, RM_MAX_RENDITIONS);
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  XCTAssert(levels[0] == 2);
+  XCTAssert(levels[1] == 3);
+
+  {
+    int v = rendition_manifest_levels(&manifest, 0, levels, 2);
+    int expectedVal = 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+@end
@@ -0,0 +1,228 @@
+//
+//  SubsampleMemoTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "BT709.h"
+
+@interface SubsampleMemoTests : XCTestCase
+
+@end
+
+// Frames shaped like the RedCircleOverWhiteA and Fireworks sources,
+// a red circle with an antialiased edge over white and a black frame
+// with a few bright sparks.
+
+static
+uint32_t* makeRedCircleFrame(int width, int height)
+{
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  const int radius = height / 3;
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      int dx = col - (width / 2);
+      int dy = row - (height / 2);
+      int d2 = (dx * dx) + (dy * dy);
+      uint32_t pixel = (d2 < (radius * radius)) ? 0xFFFF0000 : 0xFFFFFFFF;
+      if (abs(d2 - (radius * radius)) < height) {
+        pixel = 0xFFFF0000 | (((col * 3) & 0xFF) << 8) | ((row * 5) & 0xFF);
+      }
+      pixels[(row * width) + col] = pixel;
+    }
+  }
+
+  return pixels;
+}
+
+static
+uint32_t* makeFireworksFrame(int width, int height)
+{
+  uint32_t *pixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      uint32_t pixel = 0xFF000000;
+      if ((((row * 7) + (col * 13)) % 97) == 0) {
+        pixel |= (((row * 3) & 0xFF) << 16) | (((col * 5) & 0xFF) << 8) | ((row + col) & 0xFF);
+      }
+      pixels[(row * width) + col] = pixel;
+    }
+  }
+
+  return pixels;
+}
+
+// Subsample with the memo, or with BT709_average_pixel_values() for
+// every block when memo is NULL. Y Cb Cr for each block is written
+// as 6 ints to outValues.
+
+static
+void subsampleFrame(const uint32_t *pixels, int width, int height,
+                    BT709UniformMemo *memo, BT709SubsampleStats *stats,
+                    int *outValues)
+{
+  for (int row = 0; row < height; row += 2) {
+    for (int col = 0; col < width; col += 2) {
+      uint32_t p1 = pixels[(row * width) + col];
+      uint32_t p2 = pixels[(row * width) + col + 1];
+      uint32_t p3 = pixels[((row + 1) * width) + col];
+      uint32_t p4 = pixels[((row + 1) * width) + col + 1];
+
+      int *v = outValues;
+      outValues += 6;
+
+      if (memo) {
+        BT709_average_block_memo(memo, p1, p2, p3, p4, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], stats);
+      } else {
+        BT709_average_pixel_values((p1 >> 16) & 0xFF, (p1 >> 8) & 0xFF, p1 & 0xFF,
+                                   (p2 >> 16) & 0xFF, (p2 >> 8) & 0xFF, p2 & 0xFF,
+                                   (p3 >> 16) & 0xFF, (p3 >> 8) & 0xFF, p3 & 0xFF,
+                                   (p4 >> 16) & 0xFF, (p4 >> 8) & 0xFF, p4 & 0xFF,
+                                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+                                   BT709GammaSrgb, BT709GammaApple);
+      }
+    }
+  }
+}
+
+@implementation SubsampleMemoTests
+
+// Memo output must be bit exact for every block
+
+- (void)testMemoMatchesFullAverage {
+  const int width = 320;
+  const int height = 180;
+  const int numValues = (width / 2) * (height / 2) * 6;
+
+  uint32_t *frames[2] = { makeRedCircleFrame(width, height), makeFireworksFrame(width, height) };
+
+  int *expectedValues = (int *) malloc(numValues * sizeof(int));
+  int *values = (int *) malloc(numValues * sizeof(int));
+
+  BT709UniformMemo *memo = (BT709UniformMemo *) malloc(sizeof(BT709UniformMemo));
+
+  for (int i = 0; i < 2; i++) {
+    BT709_uniform_memo_init(memo, BT709GammaSrgb, BT709GammaApple);
+
+    BT709SubsampleStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    subsampleFrame(frames[i], width, height, NULL, NULL, expectedValues);
+    subsampleFrame(frames[i], width, height, memo, &stats, values);
+
+    int cmp = memcmp(values, expectedValues, numValues * sizeof(int));
+    XCTAssert(cmp == 0);
+
+    {
+      int v = (int) (stats.numMixedBlocks + stats.numRunBlocks + stats.numMemoHitBlocks + stats.numMemoMissBlocks);
+      int expectedVal = (width / 2) * (height / 2);
+      XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+    }
+
+    // Most blocks are uniform and in a run
+    XCTAssert(stats.numRunBlocks > (stats.numMixedBlocks * 4));
+  }
+
+  // Black frame : one miss then every other block is a run
+
+  {
+    memset(frames[1], 0, width * height * sizeof(uint32_t));
+
+    BT709_uniform_memo_init(memo, BT709GammaSrgb, BT709GammaApple);
+
+    BT709SubsampleStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    subsampleFrame(frames[1], width, height, memo, &stats, values);
+
+    {
+      int v = (int) stats.numMemoMissBlocks;
+      int expectedVal = 1;
+      XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+    }
+
+    {
+      int v = (int) stats.numRunBlocks;
+      int expectedVal = ((width / 2) * (height / 2)) - 1;
+      XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+    }
+  }
+
+  free(memo);
+  free(values);
+  free(expectedValues);
+  free(frames[0]);
+  free(frames[1]);
+}
+
+- (void)testPerformanceRedCircleFull {
+  const int width = 1280;
+  const int height = 720;
+  uint32_t *pixels = makeRedCircleFrame(width, height);
+  int *values = (int *) malloc((width / 2) * (height / 2) * 6 * sizeof(int));
+
+  [self measureBlock:^{
+    subsampleFrame(pixels, width, height, NULL, NULL, values);
+  }];
+
+  free(values);
+  free(pixels);
+}
+
+- (void)testPerformanceRedCircleMemo {
+  const int width = 1280;
+  const int height = 720;
+  uint32_t *pixels = makeRedCircleFrame(width, height);
+  int *values = (int *) malloc((width / 2) * (height / 2) * 6 * sizeof(int));
+  BT709UniformMemo *memo = (BT709UniformMemo *) malloc(sizeof(BT709UniformMemo));
+
+  [self measureBlock:^{
+    BT709SubsampleStats stats;
+    memset(&stats, 0, sizeof(stats));
+    BT709_uniform_memo_init(memo, BT709GammaSrgb, BT709GammaApple);
+    subsampleFrame(pixels, width, height, memo, &stats, values);
+  }];
+
+  free(memo);
+  free(values);
+  free(pixels);
+}
+
+- (void)testPerformanceFireworksFull {
+  const int width = 1280;
+  const int height = 720;
+  uint32_t *pixels = makeFireworksFrame(width, height);
+  int *values = (int *) malloc((width / 2) * (height / 2) * 6 * sizeof(int));
+
+  [self measureBlock:^{
+    subsampleFrame(pixels, width, height, NULL, NULL, values);
+  }];
+
+  free(values);
+  free(pixels);
+}
+
+- (void)testPerformanceFireworksMemo {
+  const int width = 1280;
+  const int height = 720;
+  uint32_t *pixels = makeFireworksFrame(width, height);
+  int *values = (int *) malloc((width / 2) * (height / 2) * 6 * sizeof(int));
+  BT709UniformMemo *memo = (BT709UniformMemo *) malloc(sizeof(BT709UniformMemo));
+
+  [self measureBlock:^{
+    BT709SubsampleStats stats;
+    memset(&stats, 0, sizeof(stats));
+    BT709_uniform_memo_init(memo, BT709GammaSrgb, BT709GammaApple);
+    subsampleFrame(pixels, width, height, memo, &stats, values);
+  }];
+
+  free(memo);
+  free(values);
+  free(pixels);
+}
+
+@end
@@ -0,0 +1,172 @@
+//
+//  Y4MReaderTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "BT709.h"
+#import "bt709_decode.h"
+#import "y4m_writer.h"
+#import "y4m_reader.h"
+
+@interface Y4MReaderTests : XCTestCase
+
+@end
+
+@implementation Y4MReaderTests
+
+- (NSString*) tmpPath:(NSString*)filename {
+  return [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+}
+
+// Write N frames where every Y value is the frame number + 16
+
+- (void) writeFrames:(int)numFrames width:(int)width height:(int)height path:(NSString*)path
+{
+  FILE *outFile = y4m_open_file([path UTF8String]);
+  XCTAssert(outFile != NULL);
+
+  Y4MHeaderStruct header;
+  header.width = width;
+  header.height = height;
+  header.fps = Y4MHeaderFPS_30;
+
+  int result = y4m_write_header(outFile, &header);
+  XCTAssert(result == 0);
+
+  NSMutableData *Y = [NSMutableData dataWithLength:width*height];
+  NSMutableData *U = [NSMutableData dataWithLength:(width/2)*(height/2)];
+  NSMutableData *V = [NSMutableData dataWithLength:(width/2)*(height/2)];
+
+  for (int i = 0; i < numFrames; i++) {
+    memset(Y.mutableBytes, 16 + i, Y.length);
+    memset(U.mutableBytes, 128, U.length);
+    memset(V.mutableBytes, 128, V.length);
+
+    Y4MFrameStruct fs;
+    fs.yPtr = (uint8_t *) Y.mutableBytes;
+    fs.yLen = (int) Y.length;
+    fs.uPtr = (uint8_t *) U.mutableBytes;
+    fs.uLen = (int) U.length;
+    fs.vPtr = (uint8_t *) V.mutableBytes;
+    fs.vLen = (int) V.length;
+
+    result = y4m_write_frame(outFile, &fs);
+    XCTAssert(result == 0);
+  }
+
+  fclose(outFile);
+}
+
+- (void)testReadHeaderAndSeek {
+  NSString *path = [self tmpPath:@"Y4MReaderTests.y4m"];
+  const int width = 32;
+  const int height = 16;
+
+  [self writeFrames:10 width:width height:height path:path];
+
+  Y4MReaderStruct reader;
+  int result = y4m_open_reader([path UTF8String], &reader);
+  XCTAssert(result == 0);
+
+  {
+    int v = reader.width;
+    int expectedVal = width;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = reader.height;
+    int expectedVal = height;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = reader.numFrames;
+    int expectedVal = 10;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // 0.2 seconds at 30 FPS is frame 6, times after the end hold the last frame
+    int v = y4m_frame_for_time(&reader, 0.2);
+    int expectedVal = 6;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+
+    v = y4m_frame_for_time(&reader, 100.0);
+    expectedVal = 9;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  NSMutableData *Y = [NSMutableData dataWithLength:reader.yLen];
+  NSMutableData *U = [NSMutableData dataWithLength:reader.uvLen];
+  NSMutableData *V = [NSMutableData dataWithLength:reader.uvLen];
+
+  Y4MFrameStruct fs;
+  fs.yPtr = (uint8_t *) Y.mutableBytes;
+  fs.yLen = (int) Y.length;
+  fs.uPtr = (uint8_t *) U.mutableBytes;
+  fs.uLen = (int) U.length;
+  fs.vPtr = (uint8_t *) V.mutableBytes;
+  fs.vLen = (int) V.length;
+
+  result = y4m_read_frame(&reader, 7, &fs);
+  XCTAssert(result == 0);
+
+  {
+    int v = ((uint8_t *) Y.bytes)[0];
+    int expectedVal = 16 + 7;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  result = y4m_read_frame(&reader, 10, &fs);
+  XCTAssert(result != 0);
+
+  y4m_close_reader(&reader);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+// Encode sRGB values to YCbCr and decode them back
+
+- (void)testDecodeRoundTrip {
+  const int inputs[] = { 0, 1, 50, 128, 200, 254, 255 };
+
+  for (int i = 0; i < sizeof(inputs)/sizeof(int); i++) {
+    int Y, Cb, Cr;
+    sRGB_from_sRGB_convertRGBToYCbCr(inputs[i], inputs[i], inputs[i], &Y, &Cb, &Cr);
+
+    int R, G, B;
+    bt709_decode_pixel(Y, Cb, Cr, BT709GammaSrgb, &R, &G, &B);
+
+    int v = G;
+    int expectedVal = inputs[i];
+    XCTAssert(abs(v - expectedVal) <= 1, @"%3d != %3d", v, expectedVal);
+  }
+
+  uint8_t table[256];
+  bt709_decode_alpha_table(table);
+
+  {
+    int v = table[16];
+    int expectedVal = 0;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    int v = table[235];
+    int expectedVal = 255;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // Out of range values are clamped
+    int v = table[255];
+    int expectedVal = 255;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+}
+
+@end
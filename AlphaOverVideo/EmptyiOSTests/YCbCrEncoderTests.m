@@ -0,0 +1,118 @@
+//
+//  YCbCrEncoderTests.m
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "ycbcr_encoder.h"
+#import "y4m_reader.h"
+
+@interface YCbCrEncoderTests : XCTestCase
+
+@end
+
+@implementation YCbCrEncoderTests
+
+// Frames with padded rows and interleaved CbCr, as in a biplanar
+// CoreVideo buffer, are written as packed planar Y4M frames.
+
+- (void)testY4MBackendInterleavedChroma {
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"YCbCrEncoderTests.y4m"];
+
+  const int width = 8;
+  const int height = 4;
+  const int bytesPerRow = 16;
+
+  YCbCrEncoderBackend backend;
+  YCbCrY4MBackendContext ctx;
+  ycbcr_y4m_backend_init(&backend, &ctx, [path fileSystemRepresentation]);
+
+  YCbCrEncoderConfig config;
+  config.width = width;
+  config.height = height;
+  config.fps = Y4MHeaderFPS_30;
+  config.gamma = BT709GammaSrgb;
+
+  int result = backend.open(backend.ctx, &config);
+  XCTAssert(result == 0);
+
+  uint8_t yPlane[bytesPerRow * height];
+  uint8_t cbcrPlane[bytesPerRow * (height / 2)];
+
+  for (int frameNum = 0; frameNum < 3; frameNum++) {
+    memset(yPlane, 16 + frameNum, sizeof(yPlane));
+
+    for (int row = 0; row < (height / 2); row++) {
+      for (int col = 0; col < (width / 2); col++) {
+        cbcrPlane[(row * bytesPerRow) + (col * 2)] = 100 + col;
+        cbcrPlane[(row * bytesPerRow) + (col * 2) + 1] = 200 + row;
+      }
+    }
+
+    YCbCrEncoderFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.yPtr = yPlane;
+    frame.yBytesPerRow = bytesPerRow;
+    frame.cbcrPtr = cbcrPlane;
+    frame.cbcrBytesPerRow = bytesPerRow;
+
+    result = backend.write_frame(backend.ctx, &frame);
+    XCTAssert(result == 0);
+  }
+
+  result = backend.close(backend.ctx);
+  XCTAssert(result == 0);
+
+  Y4MReaderStruct reader;
+  result = y4m_open_reader([path fileSystemRepresentation], &reader);
+  XCTAssert(result == 0);
+
+  {
+    int v = reader.numFrames;
+    int expectedVal = 3;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  uint8_t Y[width * height];
+  uint8_t U[(width / 2) * (height / 2)];
+  uint8_t V[(width / 2) * (height / 2)];
+
+  Y4MFrameStruct fs;
+  fs.yPtr = Y;
+  fs.yLen = sizeof(Y);
+  fs.uPtr = U;
+  fs.uLen = sizeof(U);
+  fs.vPtr = V;
+  fs.vLen = sizeof(V);
+
+  result = y4m_read_frame(&reader, 2, &fs);
+  XCTAssert(result == 0);
+
+  {
+    int v = Y[(width * height) - 1];
+    int expectedVal = 16 + 2;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // Second Cb in the first row
+    int v = U[1];
+    int expectedVal = 101;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  {
+    // First Cr in the second row
+    int v = V[width / 2];
+    int expectedVal = 201;
+    XCTAssert(v == expectedVal, @"%3d != %3d", v, expectedVal);
+  }
+
+  y4m_close_reader(&reader);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+@end
@@ -0,0 +1,755 @@
+//
+//  aov_build.c
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Command line utility that builds a pack of clips from a manifest.
+//  Each clip is planned as a small graph of jobs, a srgb_to_bt709
+//  conversion followed by one ffmpeg encode script run for the RGB
+//  video and one for the _alpha video. Jobs run as child processes
+//  on a pool of CPU slots as soon as their inputs are ready. Results
+//  are cached by content hash, so a rebuild after touching the frames
+//  of one clip only redoes the jobs for that clip. Progress and job
+//  timing are written as one JSON object per line.
+//
+//  This tool depends only on libc and pthreads:
+//
+//  cc -O2 -I../AlphaOverVideo -o aov_build aov_build.c -lpthread
+//
+//  Manifest format, one entry per line, # starts a comment and paths
+//  are relative to the manifest file:
+//
+//  defaults -fps 30 -crf 23
+//  clip Fireworks frames/Fireworks/F0001.png -alpha 1
+//  clip Logo frames/Logo/F0001.png -gamma apple -crf 28
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "build_plan.h"
+
+#define CACHE_FILENAME "aov_build.cache"
+
+extern char **environ;
+
+static
+void usage() {
+  printf("aov_build ?OPTIONS? MANIFEST\n");
+  printf("-jobs N (number of CPU slots, default num CPUs)\n");
+  printf("-encode-cost N (slots held by each encode job, default 2)\n");
+  printf("-threads N (number of threads used to hash input frames, default num CPUs)\n");
+  printf("-builddir DIR (intermediate files, logs and cache, default build)\n");
+  printf("-outdir DIR (output .m4v files, default .)\n");
+  printf("-tools DIR (directory containing srgb_to_bt709 and the FFMPEG scripts, default PATH)\n");
+  printf("-progress FILE (JSON progress lines, default stdout)\n");
+  printf("-keep 0|1 (set to 1 to keep intermediate .y4m files)\n");
+  printf("-force 0|1 (set to 1 to ignore the cache)\n");
+  printf("-dryrun 0|1 (set to 1 to print the plan without running jobs)\n");
+}
+
+static
+double elapsed_seconds(const BuildPlan *plan) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) (now.tv_sec - plan->startTime.tv_sec) + (now.tv_nsec - plan->startTime.tv_nsec) / 1.0e9;
+}
+
+static
+int make_dirs(const char *path) {
+  char tmp[BUILD_MAX_PATH_LEN];
+  snprintf(tmp, sizeof(tmp), "%s", path);
+
+  for (char *p = tmp + 1; *p != '\0'; p++) {
+    if (*p == '/') {
+      *p = '\0';
+      if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+        return 1;
+      }
+      *p = '/';
+    }
+  }
+
+  if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+    return 1;
+  }
+
+  return 0;
+}
+
+// JSON output
+
+static
+void json_string(FILE *outFile, const char *str) {
+  fputc('"', outFile);
+  for (const char *p = str; *p != '\0'; p++) {
+    unsigned char c = (unsigned char) *p;
+    if (c == '"' || c == '\\') {
+      fprintf(outFile, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(outFile, "\\u%04x", c);
+    } else {
+      fputc(c, outFile);
+    }
+  }
+  fputc('"', outFile);
+}
+
+static
+void json_job_event(BuildPlan *plan, const char *event, const BuildJob *job) {
+  FILE *outFile = plan->progressFile;
+
+  fprintf(outFile, "{\"event\":\"%s\",\"job\":", event);
+  json_string(outFile, job->name);
+  fprintf(outFile, ",\"clip\":");
+  json_string(outFile, plan->clips[job->clipIndex].name);
+  fprintf(outFile, ",\"t\":%.3f", elapsed_seconds(plan));
+
+  if (job->state == JobStateDone || job->state == JobStateFailed) {
+    fprintf(outFile, ",\"seconds\":%.3f,\"exit\":%d", job->seconds, job->exitStatus);
+  }
+
+  fprintf(outFile, "}\n");
+  fflush(outFile);
+}
+
+// Find input frames the same way srgb_to_bt709 -frames does, frame
+// numbers are incremented from the first frame until a file is missing.
+
+static
+int find_clip_frames(BuildClip *clip) {
+  const char *path = clip->firstFrame;
+  const char *dot = strrchr(path, '.');
+  const char *slash = strrchr(path, '/');
+
+  if (dot == NULL || (slash != NULL && dot < slash)) {
+    fprintf(stderr, "clip %s: first frame \"%s\" has no extension\n", clip->name, path);
+    return 1;
+  }
+
+  const char *numEnd = dot;
+  const char *numStart = numEnd;
+
+  while (numStart > path && numStart[-1] >= '0' && numStart[-1] <= '9') {
+    numStart--;
+  }
+
+  const int numDigits = (int) (numEnd - numStart);
+
+  if (numDigits == 0 || numDigits > 7) {
+    fprintf(stderr, "clip %s: could not find frame number in \"%s\"\n", clip->name, path);
+    return 1;
+  }
+
+  const int prefixLen = (int) (numStart - path);
+  const int firstNum = atoi(numStart);
+
+  int maxFrames = 0;
+
+  for (int frameNum = firstNum; frameNum < BUILD_MAX_FRAMES; frameNum++) {
+    char framePath[BUILD_MAX_PATH_LEN];
+
+    if (!build_path_fits(snprintf(framePath, sizeof(framePath), "%.*s%0*d%s", prefixLen, path, numDigits, frameNum, dot)) ||
+        !build_file_exists(framePath)) {
+      break;
+    }
+
+    if (clip->numFrames == maxFrames) {
+      maxFrames = (maxFrames == 0) ? 64 : (maxFrames * 2);
+      clip->frames = (char **) realloc(clip->frames, maxFrames * sizeof(char *));
+    }
+
+    clip->frames[clip->numFrames++] = strdup(framePath);
+  }
+
+  if (clip->numFrames < 2) {
+    fprintf(stderr, "clip %s: at least 2 input frames are required starting at \"%s\"\n", clip->name, path);
+    return 1;
+  }
+
+  return 0;
+}
+
+// Hash queued input files on a pool of threads
+
+static
+void* hash_worker_main(void *arg) {
+  BuildPlan *plan = (BuildPlan *) arg;
+
+  while (1) {
+    int index = __sync_fetch_and_add(&plan->nextHash, 1);
+
+    if (index >= plan->numHashQueue) {
+      break;
+    }
+
+    CacheInput *input = plan->hashQueue[index];
+
+    if (build_hash_file(input->path, &input->hash) != 0) {
+      fprintf(stderr, "can't read \"%s\"\n", input->path);
+      input->hash = 0;
+    }
+  }
+
+  return NULL;
+}
+
+// Compute the content hash of the input frames of every clip. Files
+// whose size and mtime match the cache are not read again.
+
+static
+int hash_clip_inputs(BuildPlan *plan) {
+  BuildCache *cache = &plan->cache;
+
+  int numFiles = 0;
+  for (int i = 0; i < plan->numClips; i++) {
+    numFiles += plan->clips[i].numFrames;
+  }
+
+  // Add entries first so that pointers remain valid while hashing
+
+  CacheInput **clipInputs = (CacheInput **) malloc(numFiles * sizeof(CacheInput *));
+  int *inputIndexes = (int *) malloc(numFiles * sizeof(int));
+  plan->hashQueue = (CacheInput **) malloc(numFiles * sizeof(CacheInput *));
+  plan->numHashQueue = 0;
+  plan->nextHash = 0;
+
+  int fileIndex = 0;
+
+  for (int i = 0; i < plan->numClips; i++) {
+    BuildClip *clip = &plan->clips[i];
+
+    for (int j = 0; j < clip->numFrames; j++) {
+      struct stat sb;
+
+      if (stat(clip->frames[j], &sb) != 0) {
+        fprintf(stderr, "can't access \"%s\"\n", clip->frames[j]);
+        free(clipInputs);
+        free(inputIndexes);
+        return 1;
+      }
+
+      CacheInput *input = build_cache_find_input(cache, clip->frames[j]);
+      int isStale = (input == NULL) || plan->force ||
+        input->size != (int64_t) sb.st_size || input->mtime != (int64_t) sb.st_mtime;
+
+      if (input == NULL) {
+        input = build_cache_add_input(cache, clip->frames[j]);
+      }
+
+      input->size = (int64_t) sb.st_size;
+      input->mtime = (int64_t) sb.st_mtime;
+      input->isLive = 1;
+
+      inputIndexes[fileIndex++] = (int) (input - cache->inputs);
+
+      if (isStale) {
+        input->hash = 0;
+      }
+    }
+  }
+
+  for (int i = 0; i < numFiles; i++) {
+    clipInputs[i] = &cache->inputs[inputIndexes[i]];
+  }
+
+  for (int i = 0; i < cache->numInputs; i++) {
+    CacheInput *input = &cache->inputs[i];
+    if (input->isLive && input->hash == 0) {
+      plan->hashQueue[plan->numHashQueue++] = input;
+    }
+  }
+
+  int numThreads = plan->numThreads;
+
+  if (numThreads > plan->numHashQueue) {
+    numThreads = plan->numHashQueue;
+  }
+
+  if (numThreads > 0) {
+    pthread_t *threads = (pthread_t *) malloc(numThreads * sizeof(pthread_t));
+
+    for (int i = 0; i < numThreads; i++) {
+      pthread_create(&threads[i], NULL, hash_worker_main, plan);
+    }
+
+    for (int i = 0; i < numThreads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+  }
+
+  fprintf(stderr, "hashed %d of %d input frames\n", plan->numHashQueue, numFiles);
+
+  // Clip hash covers frame names and contents along with the order
+
+  int err = 0;
+  fileIndex = 0;
+
+  for (int i = 0; i < plan->numClips; i++) {
+    BuildClip *clip = &plan->clips[i];
+    uint64_t hash = BUILD_FNV_OFFSET;
+
+    hash = build_fnv_update_u64(hash, (uint64_t) clip->numFrames);
+
+    for (int j = 0; j < clip->numFrames; j++) {
+      const CacheInput *input = clipInputs[fileIndex++];
+
+      if (input->hash == 0) {
+        err = 1;
+      }
+
+      const char *slash = strrchr(input->path, '/');
+      hash = build_fnv_update_str(hash, (slash != NULL) ? (slash + 1) : input->path);
+      hash = build_fnv_update_u64(hash, input->hash);
+    }
+
+    clip->inputHash = hash;
+  }
+
+  free(clipInputs);
+  free(inputIndexes);
+
+  return err;
+}
+
+// Running
+
+static
+int start_job(BuildPlan *plan, BuildJob *job) {
+  for (int i = 0; i < job->numOutputs; i++) {
+    char dir[BUILD_MAX_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s", job->outputs[i]);
+    char *slash = strrchr(dir, '/');
+    if (slash != NULL && slash != dir) {
+      *slash = '\0';
+      make_dirs(dir);
+    }
+  }
+
+  // stdout and stderr of each job go to a log in the build dir
+
+  char logPath[BUILD_MAX_PATH_LEN];
+
+  if (!build_path_fits(snprintf(logPath, sizeof(logPath), "%s/%s.log", plan->buildDir, job->name))) {
+    fprintf(stderr, "log path too long for \"%s\"\n", job->name);
+    return 1;
+  }
+
+  char logDir[BUILD_MAX_PATH_LEN];
+  snprintf(logDir, sizeof(logDir), "%s", logPath);
+  *strrchr(logDir, '/') = '\0';
+  make_dirs(logDir);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+  pid_t pid;
+  int err = posix_spawnp(&pid, job->argv[0], &actions, NULL, job->argv, environ);
+
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (err != 0) {
+    fprintf(stderr, "can't run \"%s\" : %s\n", job->argv[0], strerror(err));
+    return 1;
+  }
+
+  job->pid = pid;
+  job->state = JobStateRunning;
+  job->startTime = elapsed_seconds(plan);
+
+  json_job_event(plan, "start", job);
+
+  return 0;
+}
+
+// Skip every pending job that depends on a failed or skipped job
+
+static
+void skip_dependents(BuildPlan *plan) {
+  for (int i = 0; i < plan->numJobs; i++) {
+    BuildJob *job = &plan->jobs[i];
+
+    if (job->state != JobStatePending) {
+      continue;
+    }
+
+    for (int j = 0; j < job->numDeps; j++) {
+      JobState depState = plan->jobs[job->deps[j]].state;
+      if (depState == JobStateFailed || depState == JobStateSkipped) {
+        job->state = JobStateSkipped;
+        json_job_event(plan, "skipped", job);
+        break;
+      }
+    }
+  }
+}
+
+static
+int deps_are_done(const BuildPlan *plan, const BuildJob *job) {
+  for (int i = 0; i < job->numDeps; i++) {
+    JobState depState = plan->jobs[job->deps[i]].state;
+    if (depState != JobStateDone && depState != JobStateCached) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Delete intermediate outputs once every job that reads them succeeded
+
+static
+void remove_intermediates(BuildPlan *plan, int jobIndex) {
+  BuildJob *job = &plan->jobs[jobIndex];
+
+  if (!job->isIntermediate || (job->state != JobStateDone && job->state != JobStateCached)) {
+    return;
+  }
+
+  for (int j = jobIndex + 1; j < plan->numJobs; j++) {
+    const BuildJob *other = &plan->jobs[j];
+    for (int k = 0; k < other->numDeps; k++) {
+      // Keep the files for a rebuild when a dependent failed
+      if (other->deps[k] == jobIndex && other->state != JobStateDone && other->state != JobStateCached) {
+        return;
+      }
+    }
+  }
+
+  for (int i = 0; i < job->numOutputs; i++) {
+    unlink(job->outputs[i]);
+  }
+}
+
+static
+void finish_job(BuildPlan *plan, BuildJob *job, int status) {
+  job->seconds = elapsed_seconds(plan) - job->startTime;
+  job->exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : (128 + WTERMSIG(status));
+  job->pid = -1;
+
+  int isOk = (job->exitStatus == 0);
+
+  for (int i = 0; isOk && i < job->numOutputs; i++) {
+    if (!build_file_exists(job->outputs[i])) {
+      fprintf(stderr, "%s did not write \"%s\"\n", job->name, job->outputs[i]);
+      isOk = 0;
+    }
+  }
+
+  if (isOk) {
+    job->state = JobStateDone;
+    for (int i = 0; i < job->numOutputs; i++) {
+      build_cache_set_output(&plan->cache, job->outputs[i], job->hash);
+    }
+  } else {
+    job->state = JobStateFailed;
+    fprintf(stderr, "%s failed, see %s/%s.log\n", job->name, plan->buildDir, job->name);
+  }
+
+  json_job_event(plan, "finish", job);
+}
+
+// Start ready jobs while CPU slots are free, a job that costs more
+// than the pool can still run when nothing else is running.
+
+static
+int run_jobs(BuildPlan *plan) {
+  int slotsUsed = 0;
+  int numRunning = 0;
+
+  while (1) {
+    for (int i = 0; i < plan->numJobs; i++) {
+      BuildJob *job = &plan->jobs[i];
+
+      if (job->state != JobStatePending || !deps_are_done(plan, job)) {
+        continue;
+      }
+
+      int cost = (job->cost < plan->numSlots) ? job->cost : plan->numSlots;
+
+      if (numRunning > 0 && (slotsUsed + cost) > plan->numSlots) {
+        continue;
+      }
+
+      if (start_job(plan, job) != 0) {
+        job->state = JobStateFailed;
+        job->exitStatus = 127;
+        json_job_event(plan, "finish", job);
+        skip_dependents(plan);
+        continue;
+      }
+
+      slotsUsed += cost;
+      numRunning++;
+    }
+
+    if (numRunning == 0) {
+      break;
+    }
+
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+
+    if (pid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    for (int i = 0; i < plan->numJobs; i++) {
+      BuildJob *job = &plan->jobs[i];
+
+      if (job->pid != pid) {
+        continue;
+      }
+
+      int cost = (job->cost < plan->numSlots) ? job->cost : plan->numSlots;
+      slotsUsed -= cost;
+      numRunning--;
+
+      finish_job(plan, job, status);
+
+      if (job->state == JobStateFailed) {
+        skip_dependents(plan);
+      }
+
+      for (int j = 0; j < job->numDeps; j++) {
+        remove_intermediates(plan, job->deps[j]);
+      }
+      remove_intermediates(plan, i);
+      break;
+    }
+  }
+
+  int numFailed = 0;
+
+  for (int i = 0; i < plan->numJobs; i++) {
+    if (plan->jobs[i].state == JobStateFailed || plan->jobs[i].state == JobStateSkipped) {
+      numFailed++;
+    }
+  }
+
+  return numFailed;
+}
+
+static
+void print_plan(BuildPlan *plan) {
+  for (int i = 0; i < plan->numJobs; i++) {
+    const BuildJob *job = &plan->jobs[i];
+
+    printf("%s %s (cost %d)", job->needsRun ? "run" : "cached", job->name, job->cost);
+
+    if (job->numDeps > 0) {
+      printf(" after");
+      for (int j = 0; j < job->numDeps; j++) {
+        printf(" %s", plan->jobs[job->deps[j]].name);
+      }
+    }
+
+    printf("\n ");
+    for (int j = 0; j < job->argc; j++) {
+      printf(" %s", job->argv[j]);
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, const char * argv[]) {
+  BuildPlan plan;
+  memset(&plan, 0, sizeof(plan));
+
+  int numCPUs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+  plan.numSlots = numCPUs;
+  plan.numThreads = numCPUs;
+  plan.encodeCost = 2;
+  plan.buildDir = "build";
+  plan.outDir = ".";
+
+  int argi = 1;
+
+  for ( ; argi < argc; argi++) {
+    const char *arg = argv[argi];
+
+    if (arg[0] != '-') {
+      break;
+    }
+
+    if (argi == (argc - 1)) {
+      usage();
+      return 1;
+    }
+
+    const char *value = argv[++argi];
+
+    if (strcmp(arg, "-jobs") == 0) {
+      plan.numSlots = atoi(value);
+    } else if (strcmp(arg, "-encode-cost") == 0) {
+      plan.encodeCost = atoi(value);
+    } else if (strcmp(arg, "-threads") == 0) {
+      plan.numThreads = atoi(value);
+    } else if (strcmp(arg, "-builddir") == 0) {
+      plan.buildDir = value;
+    } else if (strcmp(arg, "-outdir") == 0) {
+      plan.outDir = value;
+    } else if (strcmp(arg, "-tools") == 0) {
+      plan.toolsDir = value;
+    } else if (strcmp(arg, "-progress") == 0) {
+      plan.progressPath = value;
+    } else if (strcmp(arg, "-keep") == 0) {
+      plan.keepIntermediate = atoi(value);
+    } else if (strcmp(arg, "-force") == 0) {
+      plan.force = atoi(value);
+    } else if (strcmp(arg, "-dryrun") == 0) {
+      plan.dryRun = atoi(value);
+    } else {
+      printf("unknown option \"%s\"\n", arg);
+      usage();
+      return 1;
+    }
+  }
+
+  if (argi != (argc - 1)) {
+    usage();
+    return 1;
+  }
+
+  if (plan.numSlots < 1) {
+    plan.numSlots = 1;
+  }
+  if (plan.numThreads < 1) {
+    plan.numThreads = 1;
+  }
+  if (plan.encodeCost < 1) {
+    plan.encodeCost = 1;
+  }
+
+  plan.manifestPath = argv[argi];
+
+  const char *slash = strrchr(plan.manifestPath, '/');
+  if (slash != NULL) {
+    if (!build_path_fits(snprintf(plan.manifestDir, sizeof(plan.manifestDir), "%.*s", (int) (slash - plan.manifestPath), plan.manifestPath))) {
+      fprintf(stderr, "manifest path too long \"%s\"\n", plan.manifestPath);
+      return 1;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &plan.startTime);
+
+  if (build_parse_manifest(&plan) != 0) {
+    return 1;
+  }
+
+  for (int i = 0; i < plan.numClips; i++) {
+    if (find_clip_frames(&plan.clips[i]) != 0) {
+      return 1;
+    }
+  }
+
+  if (make_dirs(plan.buildDir) != 0) {
+    fprintf(stderr, "can't create build dir \"%s\"\n", plan.buildDir);
+    return 1;
+  }
+
+  char cachePath[BUILD_MAX_PATH_LEN];
+
+  if (!build_path_fits(snprintf(cachePath, sizeof(cachePath), "%s/%s", plan.buildDir, CACHE_FILENAME))) {
+    fprintf(stderr, "build dir path too long \"%s\"\n", plan.buildDir);
+    return 1;
+  }
+
+  build_cache_read(&plan.cache, cachePath);
+
+  if (hash_clip_inputs(&plan) != 0) {
+    return 1;
+  }
+
+  for (int i = 0; i < plan.numClips; i++) {
+    if (build_plan_clip_jobs(&plan, i) != 0) {
+      fprintf(stderr, "clip %s: output path too long\n", plan.clips[i].name);
+      return 1;
+    }
+  }
+
+  build_hash_jobs(&plan);
+  build_mark_jobs_to_run(&plan);
+
+  if (plan.dryRun) {
+    print_plan(&plan);
+    build_free_plan(&plan);
+    return 0;
+  }
+
+  if (plan.progressPath != NULL) {
+    plan.progressFile = fopen(plan.progressPath, "w");
+    if (plan.progressFile == NULL) {
+      fprintf(stderr, "can't write progress file \"%s\"\n", plan.progressPath);
+      return 1;
+    }
+  } else {
+    plan.progressFile = stdout;
+  }
+
+  int numToRun = 0;
+
+  for (int i = 0; i < plan.numJobs; i++) {
+    if (plan.jobs[i].needsRun) {
+      numToRun++;
+    }
+  }
+
+  fprintf(plan.progressFile, "{\"event\":\"plan\",\"clips\":%d,\"jobs\":%d,\"run\":%d,\"cached\":%d,\"slots\":%d}\n",
+          plan.numClips, plan.numJobs, numToRun, plan.numJobs - numToRun, plan.numSlots);
+
+  for (int i = 0; i < plan.numJobs; i++) {
+    if (plan.jobs[i].state == JobStateCached) {
+      json_job_event(&plan, "cached", &plan.jobs[i]);
+    }
+  }
+
+  int numFailed = run_jobs(&plan);
+
+  // Successful jobs are recorded even when other jobs failed
+
+  if (build_cache_write(&plan.cache, cachePath) != 0) {
+    fprintf(stderr, "can't write cache \"%s\"\n", cachePath);
+  }
+
+  int numBuilt = 0;
+  double jobSeconds = 0.0;
+
+  for (int i = 0; i < plan.numJobs; i++) {
+    if (plan.jobs[i].state == JobStateDone) {
+      numBuilt++;
+      jobSeconds += plan.jobs[i].seconds;
+    }
+  }
+
+  fprintf(plan.progressFile, "{\"event\":\"summary\",\"built\":%d,\"cached\":%d,\"failed\":%d,\"seconds\":%.3f,\"job_seconds\":%.3f}\n",
+          numBuilt, plan.numJobs - numToRun, numFailed, elapsed_seconds(&plan), jobSeconds);
+
+  if (plan.progressFile != stdout) {
+    fclose(plan.progressFile);
+  }
+
+  build_free_plan(&plan);
+
+  return (numFailed > 0) ? 1 : 0;
+}
@@ -0,0 +1,770 @@
+//
+//  aov_crf_search.c
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Command line utility that finds the largest CRF, and so the smallest
+//  file, that keeps an encoded clip above a quality target. Trial
+//  encodes are made with the FFMPEG/ext_ffmpeg_encode_*_crf.sh scripts
+//  and decoded back to Y4M with ffmpeg. The decoded frames are compared
+//  to the source Y4M written by srgb_to_bt709 in linear light. The RGB
+//  video and the _alpha video are searched separately since alpha
+//  edges tolerate far less loss. Each round runs several trial CRFs in
+//  parallel and narrows the range around the target.
+//
+//  This tool depends on libc, pthreads and ffmpeg at runtime:
+//
+//  cc -O2 -I../AlphaOverVideo -o aov_crf_search aov_crf_search.c -lpthread -lm
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "BT709.h"
+#include "y4m_writer.h"
+#include "y4m_reader.h"
+#include "quality_metrics.h"
+
+#define MAX_PATH_LEN 4096
+#define MIN_CRF 0
+#define MAX_CRF 51
+
+typedef struct {
+  int crf;
+  int err;
+  int64_t numBytes;
+  double psnr;
+  // R G B PSNR, unused for alpha
+  double channelPsnr[3];
+  int numFrames;
+} CrfTrial;
+
+typedef struct {
+  const char *label;
+  char srcPath[MAX_PATH_LEN];
+  const char *script;
+  BT709Gamma gamma;
+  int isAlpha;
+  double target;
+
+  // The answer is in (lo, hi], lo meets the target and hi does not
+  int lo;
+  int hi;
+  int loMeetsTarget;
+  int isDone;
+
+  CrfTrial trials[MAX_CRF + 1];
+  int hasTrial[MAX_CRF + 1];
+} CrfSearch;
+
+typedef struct {
+  CrfSearch *search;
+  int crf;
+} CrfTrialTask;
+
+typedef struct {
+  const char *toolsDir;
+  const char *tmpDir;
+  int sampleStep;
+  int numThreads;
+  int minCrf;
+  int maxCrf;
+  const char *profile;
+  const char *jsonPath;
+
+  CrfSearch searches[2];
+  int numSearches;
+
+  // Trials of the current round, shared by all workers
+  CrfTrialTask tasks[2 * (MAX_CRF + 1)];
+  int numTasks;
+  int nextTask;
+} CrfSearchJob;
+
+static
+void usage() {
+  printf("aov_crf_search ?OPTIONS? CLIP.y4m\n");
+  printf("-gamma apple|srgb|linear (gamma of CLIP.y4m, default srgb)\n");
+  printf("-target DB (linear light RGB PSNR target, default 40)\n");
+  printf("-alpha-target DB (alpha PSNR target, default 45)\n");
+  printf("-min CRF (default 10)\n");
+  printf("-max CRF (default 40)\n");
+  printf("-profile baseline|main|high (default main)\n");
+  printf("-sample N (encode every Nth frame, default 1)\n");
+  printf("-threads N (number of trial encodes at once, default num CPUs)\n");
+  printf("-tools DIR (directory containing the FFMPEG scripts, default PATH)\n");
+  printf("-tmpdir DIR (trial files, default /tmp)\n");
+  printf("-json FILE (write the size and quality curve as JSON)\n");
+  printf("The alpha channel is read from CLIP_alpha.y4m when it exists\n");
+}
+
+static
+const char* encode_script_for_gamma(BT709Gamma gamma) {
+  switch (gamma) {
+    case BT709GammaSrgb:
+      return "ext_ffmpeg_encode_srgb_crf.sh";
+    case BT709GammaLinear:
+      return "ext_ffmpeg_encode_linear_crf.sh";
+    default:
+      return "ext_ffmpeg_encode_bt709_crf.sh";
+  }
+}
+
+// Run a command with output discarded, returns the exit status
+
+static
+int run_command(char *const argv[]) {
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    return 1;
+  }
+
+  if (pid == 0) {
+    int devNull = open("/dev/null", O_RDWR);
+    dup2(devNull, STDIN_FILENO);
+    dup2(devNull, STDOUT_FILENO);
+    dup2(devNull, STDERR_FILENO);
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+
+  int status;
+
+  if (waitpid(pid, &status, 0) != pid) {
+    return 1;
+  }
+
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+// Copy every Nth frame of a Y4M file so that trials encode less data
+
+static
+int write_sampled_y4m(const char *inPath, const char *outPath, int sampleStep) {
+  Y4MReaderStruct reader;
+
+  if (y4m_open_reader(inPath, &reader) != 0) {
+    return 1;
+  }
+
+  FILE *outFile = y4m_open_file(outPath);
+
+  if (outFile == NULL) {
+    y4m_close_reader(&reader);
+    return 1;
+  }
+
+  Y4MHeaderStruct header;
+  header.width = reader.width;
+  header.height = reader.height;
+  header.fps = Y4MHeaderFPS_30;
+
+  if (reader.fpsDen == 1001) {
+    header.fps = Y4MHeaderFPS_29_97;
+  } else if (reader.fpsNum == 1) {
+    header.fps = Y4MHeaderFPS_1;
+  } else if (reader.fpsNum == 2) {
+    header.fps = Y4MHeaderFPS_2;
+  } else if (reader.fpsNum == 15) {
+    header.fps = Y4MHeaderFPS_15;
+  } else if (reader.fpsNum == 24) {
+    header.fps = Y4MHeaderFPS_24;
+  } else if (reader.fpsNum == 25) {
+    header.fps = Y4MHeaderFPS_25;
+  } else if (reader.fpsNum == 60) {
+    header.fps = Y4MHeaderFPS_60;
+  }
+
+  int err = y4m_write_header(outFile, &header);
+
+  Y4MFrameStruct fs;
+  fs.yLen = reader.yLen;
+  fs.uLen = reader.uvLen;
+  fs.vLen = reader.uvLen;
+  fs.yPtr = (uint8_t *) malloc(reader.yLen);
+  fs.uPtr = (uint8_t *) malloc(reader.uvLen);
+  fs.vPtr = (uint8_t *) malloc(reader.uvLen);
+
+  for (int frameNum = 0; err == 0 && frameNum < reader.numFrames; frameNum += sampleStep) {
+    err = y4m_read_frame(&reader, frameNum, &fs);
+    if (err == 0) {
+      err = y4m_write_frame(outFile, &fs);
+    }
+  }
+
+  free(fs.yPtr);
+  free(fs.uPtr);
+  free(fs.vPtr);
+
+  if (fclose(outFile) != 0 && err == 0) {
+    err = 1;
+  }
+
+  y4m_close_reader(&reader);
+
+  return err;
+}
+
+// Compare a decoded Y4M file to the source, frames are paired by number
+
+static
+int measure_trial(const CrfSearch *search, const char *decodedPath, CrfTrial *trial) {
+  Y4MReaderStruct srcReader;
+  Y4MReaderStruct dstReader;
+
+  if (y4m_open_reader(search->srcPath, &srcReader) != 0) {
+    return 1;
+  }
+
+  if (y4m_open_reader(decodedPath, &dstReader) != 0) {
+    y4m_close_reader(&srcReader);
+    return 1;
+  }
+
+  if (srcReader.width != dstReader.width || srcReader.height != dstReader.height) {
+    fprintf(stderr, "decoded size %dx%d does not match source %dx%d\n",
+            dstReader.width, dstReader.height, srcReader.width, srcReader.height);
+    y4m_close_reader(&srcReader);
+    y4m_close_reader(&dstReader);
+    return 1;
+  }
+
+  const int width = srcReader.width;
+  const int height = srcReader.height;
+  const int numFrames = (srcReader.numFrames < dstReader.numFrames) ? srcReader.numFrames : dstReader.numFrames;
+
+  QualityTables tables;
+  quality_tables_init(&tables, search->gamma);
+
+  Y4MFrameStruct src;
+  Y4MFrameStruct dst;
+
+  src.yLen = dst.yLen = srcReader.yLen;
+  src.uLen = dst.uLen = srcReader.uvLen;
+  src.vLen = dst.vLen = srcReader.uvLen;
+  src.yPtr = (uint8_t *) malloc(src.yLen);
+  src.uPtr = (uint8_t *) malloc(src.uLen);
+  src.vPtr = (uint8_t *) malloc(src.vLen);
+  dst.yPtr = (uint8_t *) malloc(dst.yLen);
+  dst.uPtr = (uint8_t *) malloc(dst.uLen);
+  dst.vPtr = (uint8_t *) malloc(dst.vLen);
+
+  uint32_t *srcRow = (uint32_t *) malloc(width * sizeof(uint32_t));
+  uint32_t *dstRow = (uint32_t *) malloc(width * sizeof(uint32_t));
+
+  QualityLinearError linearErr;
+  QualityAlphaError alphaErr;
+  memset(&linearErr, 0, sizeof(linearErr));
+  memset(&alphaErr, 0, sizeof(alphaErr));
+
+  int err = 0;
+
+  for (int frameNum = 0; err == 0 && frameNum < numFrames; frameNum++) {
+    err = y4m_read_frame(&srcReader, frameNum, &src);
+
+    if (err == 0) {
+      err = y4m_read_frame(&dstReader, frameNum, &dst);
+    }
+
+    if (err != 0) {
+      break;
+    }
+
+    if (search->isAlpha) {
+      quality_alpha_error_frame(&tables, src.yPtr, dst.yPtr, width, height, &alphaErr);
+    } else {
+      quality_linear_error_frame(&tables,
+                                 src.yPtr, src.uPtr, src.vPtr,
+                                 dst.yPtr, dst.uPtr, dst.vPtr,
+                                 width, height, srcRow, dstRow, &linearErr);
+    }
+  }
+
+  if (search->isAlpha) {
+    trial->psnr = quality_alpha_psnr(&alphaErr);
+  } else {
+    trial->psnr = quality_linear_psnr(&linearErr);
+    for (int c = 0; c < 3; c++) {
+      trial->channelPsnr[c] = quality_linear_channel_psnr(&linearErr, c);
+    }
+  }
+
+  trial->numFrames = numFrames;
+
+  if (srcReader.numFrames != dstReader.numFrames) {
+    fprintf(stderr, "%s crf %d decoded %d frames, expected %d\n",
+            search->label, trial->crf, dstReader.numFrames, srcReader.numFrames);
+  }
+
+  free(src.yPtr);
+  free(src.uPtr);
+  free(src.vPtr);
+  free(dst.yPtr);
+  free(dst.uPtr);
+  free(dst.vPtr);
+  free(srcRow);
+  free(dstRow);
+
+  y4m_close_reader(&srcReader);
+  y4m_close_reader(&dstReader);
+
+  return err;
+}
+
+// Encode, decode and measure one CRF
+
+static
+void run_trial(CrfSearchJob *job, CrfSearch *search, int crf) {
+  CrfTrial *trial = &search->trials[crf];
+  memset(trial, 0, sizeof(CrfTrial));
+  trial->crf = crf;
+
+  char scriptPath[MAX_PATH_LEN];
+  char encodedPath[MAX_PATH_LEN];
+  char decodedPath[MAX_PATH_LEN];
+  char crfStr[16];
+
+  if (job->toolsDir != NULL) {
+    snprintf(scriptPath, sizeof(scriptPath), "%s/%s", job->toolsDir, search->script);
+  } else {
+    snprintf(scriptPath, sizeof(scriptPath), "%s", search->script);
+  }
+
+  snprintf(encodedPath, sizeof(encodedPath), "%s/aov_crf_%d_%s_%d.m4v", job->tmpDir, (int) getpid(), search->label, crf);
+  snprintf(decodedPath, sizeof(decodedPath), "%s/aov_crf_%d_%s_%d.y4m", job->tmpDir, (int) getpid(), search->label, crf);
+  snprintf(crfStr, sizeof(crfStr), "%d", crf);
+
+  char *encodeArgv[] = { scriptPath, search->srcPath, encodedPath, crfStr, (char *) job->profile, NULL };
+
+  if (run_command(encodeArgv) != 0) {
+    fprintf(stderr, "%s crf %d encode failed\n", search->label, crf);
+    trial->err = 1;
+    return;
+  }
+
+  struct stat sb;
+
+  if (stat(encodedPath, &sb) != 0) {
+    trial->err = 1;
+    return;
+  }
+
+  trial->numBytes = (int64_t) sb.st_size;
+
+  char *decodeArgv[] = {
+    "ffmpeg", "-y", "-loglevel", "error", "-i", encodedPath,
+    "-f", "yuv4mpegpipe", "-pix_fmt", "yuv420p", "-strict", "-1", decodedPath, NULL
+  };
+
+  if (run_command(decodeArgv) != 0) {
+    fprintf(stderr, "%s crf %d decode failed\n", search->label, crf);
+    trial->err = 1;
+  } else {
+    trial->err = measure_trial(search, decodedPath, trial);
+  }
+
+  unlink(encodedPath);
+  unlink(decodedPath);
+}
+
+static
+void* worker_main(void *arg) {
+  CrfSearchJob *job = (CrfSearchJob *) arg;
+
+  while (1) {
+    int taskIndex = __sync_fetch_and_add(&job->nextTask, 1);
+
+    if (taskIndex >= job->numTasks) {
+      break;
+    }
+
+    CrfTrialTask *task = &job->tasks[taskIndex];
+    run_trial(job, task->search, task->crf);
+  }
+
+  return NULL;
+}
+
+static
+void add_task(CrfSearchJob *job, CrfSearch *search, int crf) {
+  if (search->hasTrial[crf]) {
+    return;
+  }
+
+  for (int i = 0; i < job->numTasks; i++) {
+    if (job->tasks[i].search == search && job->tasks[i].crf == crf) {
+      return;
+    }
+  }
+
+  job->tasks[job->numTasks].search = search;
+  job->tasks[job->numTasks].crf = crf;
+  job->numTasks++;
+}
+
+// Pick up to numThreads CRF values spread evenly inside (lo, hi).
+// The first round also measures both ends of the range.
+
+static
+void plan_round(CrfSearchJob *job, CrfSearch *search, int numPoints) {
+  if (search->isDone) {
+    return;
+  }
+
+  if (!search->hasTrial[search->lo]) {
+    add_task(job, search, search->lo);
+  }
+
+  if (!search->hasTrial[search->hi]) {
+    add_task(job, search, search->hi);
+  }
+
+  const int span = search->hi - search->lo;
+
+  for (int i = 1; i <= numPoints; i++) {
+    int crf = search->lo + (span * i) / (numPoints + 1);
+    if (crf > search->lo && crf < search->hi) {
+      add_task(job, search, crf);
+    }
+  }
+}
+
+// Narrow (lo, hi] using the trials measured so far. Quality is close
+// to monotonic in CRF, the largest passing CRF below the smallest
+// failing CRF is kept so that a noisy trial can't skip past a failure.
+
+static
+void update_search(CrfSearch *search, int minCrf, int maxCrf) {
+  int firstFail = -1;
+
+  for (int crf = minCrf; crf <= maxCrf; crf++) {
+    if (search->hasTrial[crf] && (search->trials[crf].err != 0 || search->trials[crf].psnr < search->target)) {
+      firstFail = crf;
+      break;
+    }
+  }
+
+  int lastPass = -1;
+  int limit = (firstFail < 0) ? maxCrf : (firstFail - 1);
+
+  for (int crf = minCrf; crf <= limit; crf++) {
+    if (search->hasTrial[crf] && search->trials[crf].err == 0 && search->trials[crf].psnr >= search->target) {
+      lastPass = crf;
+    }
+  }
+
+  if (firstFail < 0) {
+    // Even the largest CRF meets the target
+    search->lo = maxCrf;
+    search->hi = maxCrf;
+    search->loMeetsTarget = 1;
+    search->isDone = 1;
+    return;
+  }
+
+  if (lastPass < 0) {
+    // Even the smallest CRF misses the target
+    search->lo = minCrf;
+    search->hi = firstFail;
+    search->loMeetsTarget = 0;
+    search->isDone = search->hasTrial[minCrf];
+    return;
+  }
+
+  search->lo = lastPass;
+  search->hi = firstFail;
+  search->loMeetsTarget = 1;
+  search->isDone = (search->hi - search->lo) <= 1;
+}
+
+static
+void print_trial(const CrfSearch *search, const CrfTrial *trial) {
+  if (trial->err != 0) {
+    printf("%s crf %2d : failed\n", search->label, trial->crf);
+  } else if (search->isAlpha) {
+    printf("%s crf %2d : %lld bytes : PSNR %.2f\n",
+           search->label, trial->crf, (long long) trial->numBytes, trial->psnr);
+  } else {
+    printf("%s crf %2d : %lld bytes : linear PSNR %.2f (R %.2f G %.2f B %.2f)\n",
+           search->label, trial->crf, (long long) trial->numBytes, trial->psnr,
+           trial->channelPsnr[0], trial->channelPsnr[1], trial->channelPsnr[2]);
+  }
+}
+
+static
+int write_json(const CrfSearchJob *job, const char *path) {
+  FILE *outFile = fopen(path, "w");
+
+  if (outFile == NULL) {
+    return 1;
+  }
+
+  fprintf(outFile, "{\n");
+
+  for (int i = 0; i < job->numSearches; i++) {
+    const CrfSearch *search = &job->searches[i];
+
+    fprintf(outFile, "  \"%s\": {\n", search->label);
+    fprintf(outFile, "    \"target\": %.2f,\n", search->target);
+    fprintf(outFile, "    \"crf\": %d,\n", search->lo);
+    fprintf(outFile, "    \"meets_target\": %s,\n", search->loMeetsTarget ? "true" : "false");
+    fprintf(outFile, "    \"curve\": [");
+
+    int isFirst = 1;
+
+    for (int crf = 0; crf <= MAX_CRF; crf++) {
+      const CrfTrial *trial = &search->trials[crf];
+
+      if (!search->hasTrial[crf] || trial->err != 0) {
+        continue;
+      }
+
+      fprintf(outFile, "%s\n      { \"crf\": %d, \"bytes\": %lld, \"psnr\": %.3f",
+              isFirst ? "" : ",", crf, (long long) trial->numBytes, trial->psnr);
+
+      if (!search->isAlpha) {
+        fprintf(outFile, ", \"psnr_r\": %.3f, \"psnr_g\": %.3f, \"psnr_b\": %.3f",
+                trial->channelPsnr[0], trial->channelPsnr[1], trial->channelPsnr[2]);
+      }
+
+      fprintf(outFile, " }");
+      isFirst = 0;
+    }
+
+    fprintf(outFile, "\n    ]\n  }%s\n", (i < (job->numSearches - 1)) ? "," : "");
+  }
+
+  fprintf(outFile, "}\n");
+
+  return (fclose(outFile) == 0) ? 0 : 1;
+}
+
+int main(int argc, const char * argv[]) {
+  CrfSearchJob job;
+  memset(&job, 0, sizeof(job));
+
+  job.numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  job.sampleStep = 1;
+  job.minCrf = 10;
+  job.maxCrf = 40;
+  job.profile = "main";
+  job.tmpDir = "/tmp";
+
+  BT709Gamma gamma = BT709GammaSrgb;
+  double target = 40.0;
+  double alphaTarget = 45.0;
+
+  int argi = 1;
+
+  for ( ; argi < argc; argi++) {
+    const char *arg = argv[argi];
+
+    if (arg[0] != '-') {
+      break;
+    }
+
+    if (argi == (argc - 1)) {
+      usage();
+      return 1;
+    }
+
+    const char *value = argv[++argi];
+
+    if (strcmp(arg, "-gamma") == 0) {
+      if (strcmp(value, "apple") == 0) {
+        gamma = BT709GammaApple;
+      } else if (strcmp(value, "srgb") == 0) {
+        gamma = BT709GammaSrgb;
+      } else if (strcmp(value, "linear") == 0) {
+        gamma = BT709GammaLinear;
+      } else {
+        printf("option -gamma unknown value \"%s\"\n", value);
+        return 1;
+      }
+    } else if (strcmp(arg, "-target") == 0) {
+      target = atof(value);
+    } else if (strcmp(arg, "-alpha-target") == 0) {
+      alphaTarget = atof(value);
+    } else if (strcmp(arg, "-min") == 0) {
+      job.minCrf = atoi(value);
+    } else if (strcmp(arg, "-max") == 0) {
+      job.maxCrf = atoi(value);
+    } else if (strcmp(arg, "-profile") == 0) {
+      job.profile = value;
+    } else if (strcmp(arg, "-sample") == 0) {
+      job.sampleStep = atoi(value);
+    } else if (strcmp(arg, "-threads") == 0) {
+      job.numThreads = atoi(value);
+    } else if (strcmp(arg, "-tools") == 0) {
+      job.toolsDir = value;
+    } else if (strcmp(arg, "-tmpdir") == 0) {
+      job.tmpDir = value;
+    } else if (strcmp(arg, "-json") == 0) {
+      job.jsonPath = value;
+    } else {
+      printf("unknown option \"%s\"\n", arg);
+      usage();
+      return 1;
+    }
+  }
+
+  if (argi != (argc - 1)) {
+    usage();
+    return 1;
+  }
+
+  if (job.minCrf < MIN_CRF || job.maxCrf > MAX_CRF || job.minCrf >= job.maxCrf) {
+    printf("CRF range must be within %d to %d\n", MIN_CRF, MAX_CRF);
+    return 1;
+  }
+
+  if (job.numThreads < 1) {
+    job.numThreads = 1;
+  }
+  if (job.sampleStep < 1) {
+    job.sampleStep = 1;
+  }
+
+  const char *rgbPath = argv[argi];
+  size_t len = strlen(rgbPath);
+
+  if (len < 4 || strcmp(rgbPath + len - 4, ".y4m") != 0) {
+    printf("input \"%s\" must be a .y4m file\n", rgbPath);
+    return 1;
+  }
+
+  char alphaPath[MAX_PATH_LEN];
+  snprintf(alphaPath, sizeof(alphaPath), "%.*s_alpha.y4m", (int) (len - 4), rgbPath);
+  int hasAlpha = (access(alphaPath, R_OK) == 0);
+
+  // RGB search
+
+  CrfSearch *search = &job.searches[job.numSearches++];
+  search->label = "rgb";
+  search->script = encode_script_for_gamma(gamma);
+  search->gamma = gamma;
+  search->target = target;
+  snprintf(search->srcPath, sizeof(search->srcPath), "%s", rgbPath);
+
+  // Alpha search, alpha is always encoded as linear
+
+  if (hasAlpha) {
+    search = &job.searches[job.numSearches++];
+    search->label = "alpha";
+    search->script = encode_script_for_gamma(BT709GammaLinear);
+    search->gamma = BT709GammaLinear;
+    search->isAlpha = 1;
+    search->target = alphaTarget;
+    snprintf(search->srcPath, sizeof(search->srcPath), "%s", alphaPath);
+  }
+
+  // Trials use a sampled copy of the source when -sample is passed
+
+  for (int i = 0; i < job.numSearches; i++) {
+    search = &job.searches[i];
+    search->lo = job.minCrf;
+    search->hi = job.maxCrf;
+
+    if (job.sampleStep > 1) {
+      char sampledPath[MAX_PATH_LEN];
+      snprintf(sampledPath, sizeof(sampledPath), "%s/aov_crf_%d_%s_src.y4m", job.tmpDir, (int) getpid(), search->label);
+
+      if (write_sampled_y4m(search->srcPath, sampledPath, job.sampleStep) != 0) {
+        fprintf(stderr, "can't write sampled frames to \"%s\"\n", sampledPath);
+        return 1;
+      }
+
+      snprintf(search->srcPath, sizeof(search->srcPath), "%s", sampledPath);
+    }
+  }
+
+  // Each round runs the trials of all searches on one pool of threads
+
+  pthread_t *threads = (pthread_t *) malloc(job.numThreads * sizeof(pthread_t));
+
+  while (1) {
+    job.numTasks = 0;
+    job.nextTask = 0;
+
+    int numActive = 0;
+    for (int i = 0; i < job.numSearches; i++) {
+      numActive += !job.searches[i].isDone;
+    }
+
+    if (numActive == 0) {
+      break;
+    }
+
+    int numPoints = job.numThreads / numActive;
+    if (numPoints < 1) {
+      numPoints = 1;
+    }
+
+    for (int i = 0; i < job.numSearches; i++) {
+      plan_round(&job, &job.searches[i], numPoints);
+    }
+
+    if (job.numTasks == 0) {
+      break;
+    }
+
+    int numThreads = (job.numThreads < job.numTasks) ? job.numThreads : job.numTasks;
+
+    for (int i = 0; i < numThreads; i++) {
+      pthread_create(&threads[i], NULL, worker_main, &job);
+    }
+
+    for (int i = 0; i < numThreads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < job.numTasks; i++) {
+      CrfTrialTask *task = &job.tasks[i];
+      task->search->hasTrial[task->crf] = 1;
+      print_trial(task->search, &task->search->trials[task->crf]);
+    }
+
+    for (int i = 0; i < job.numSearches; i++) {
+      if (!job.searches[i].isDone) {
+        update_search(&job.searches[i], job.minCrf, job.maxCrf);
+      }
+    }
+  }
+
+  free(threads);
+
+  int exitStatus = 0;
+
+  for (int i = 0; i < job.numSearches; i++) {
+    search = &job.searches[i];
+    const CrfTrial *trial = &search->trials[search->lo];
+
+    if (search->loMeetsTarget) {
+      printf("%s crf %d : %lld bytes : PSNR %.2f >= target %.2f\n",
+             search->label, search->lo, (long long) trial->numBytes, trial->psnr, search->target);
+    } else {
+      printf("%s target %.2f not met, crf %d gives PSNR %.2f\n",
+             search->label, search->target, search->lo, trial->psnr);
+      exitStatus = 1;
+    }
+
+    if (job.sampleStep > 1) {
+      unlink(search->srcPath);
+    }
+  }
+
+  if (job.jsonPath != NULL && write_json(&job, job.jsonPath) != 0) {
+    fprintf(stderr, "can't write \"%s\"\n", job.jsonPath);
+    exitStatus = 1;
+  }
+
+  return exitStatus;
+}
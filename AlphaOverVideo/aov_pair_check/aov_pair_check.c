@@ -0,0 +1,273 @@
+//
+//  aov_pair_check.c
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Command line utility that validates RGB and _alpha video pairs
+//  before they ship. Each argument is either an RGB video file or a
+//  directory that is searched recursively for CLIP_alpha.m4v files
+//  (also .mp4 and .mov) with a matching CLIP.m4v. The sample tables
+//  of each pair are compared on a pool of threads without decoding.
+//
+//  This tool depends only on libc and pthreads:
+//
+//  cc -O2 -I../AlphaOverVideo -o aov_pair_check aov_pair_check.c -lpthread
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ftw.h>
+
+#include "mp4_pair_check.h"
+
+#define MAX_PATH_LEN 4096
+
+typedef struct {
+  char *rgbPath;
+  char *alphaPath;
+  int err;
+  Mp4PairReport report;
+} PairCheck;
+
+typedef struct {
+  PairCheck *pairs;
+  int numPairs;
+  int maxPairs;
+
+  int numThreads;
+
+  // Next pair to process, shared by all workers
+  int nextPair;
+} PairCheckJob;
+
+// nftw() does not pass a user pointer to the callback
+static PairCheckJob *ftwJob = NULL;
+
+static
+void usage() {
+  printf("aov_pair_check ?OPTIONS? CLIP.m4v|DIR ?CLIP.m4v|DIR ...?\n");
+  printf("-threads N (number of pairs checked at once, default num CPUs)\n");
+  printf("The alpha channel is read from CLIP_alpha.m4v, directories are searched recursively\n");
+}
+
+static
+int has_video_suffix(const char *path, const char **suffixPtr) {
+  static const char *suffixes[] = { ".m4v", ".mp4", ".mov" };
+  size_t len = strlen(path);
+
+  for (int i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++) {
+    if (len > 4 && strcmp(path + len - 4, suffixes[i]) == 0) {
+      *suffixPtr = suffixes[i];
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static
+void add_pair(PairCheckJob *job, const char *rgbPath, const char *alphaPath) {
+  if (job->numPairs == job->maxPairs) {
+    job->maxPairs = (job->maxPairs == 0) ? 64 : (job->maxPairs * 2);
+    job->pairs = (PairCheck *) realloc(job->pairs, job->maxPairs * sizeof(PairCheck));
+  }
+
+  PairCheck *pair = &job->pairs[job->numPairs++];
+  memset(pair, 0, sizeof(PairCheck));
+  pair->rgbPath = strdup(rgbPath);
+  pair->alphaPath = strdup(alphaPath);
+}
+
+// Add CLIP.m4v + CLIP_alpha.m4v given the path to CLIP.m4v,
+// returns 0 when the path is not a video or no alpha file exists.
+
+static
+int add_rgb_path(PairCheckJob *job, const char *rgbPath) {
+  const char *suffix;
+
+  if (has_video_suffix(rgbPath, &suffix) == 0) {
+    return 0;
+  }
+
+  char alphaPath[MAX_PATH_LEN];
+  snprintf(alphaPath, sizeof(alphaPath), "%.*s_alpha%s", (int) (strlen(rgbPath) - 4), rgbPath, suffix);
+
+  if (access(alphaPath, R_OK) != 0) {
+    return 0;
+  }
+
+  add_pair(job, rgbPath, alphaPath);
+  return 1;
+}
+
+// Directory walk callback, each CLIP_alpha.m4v found adds the pair
+
+static
+int add_tree_entry(const char *path, const struct stat *sb, int typeflag, struct FTW *ftwbuf) {
+  (void) sb;
+  (void) ftwbuf;
+
+  const char *suffix;
+
+  if (typeflag != FTW_F || has_video_suffix(path, &suffix) == 0) {
+    return 0;
+  }
+
+  const char *alphaSuffix = "_alpha";
+  size_t len = strlen(path) - 4;
+  size_t alphaLen = strlen(alphaSuffix);
+
+  if (len <= alphaLen || strncmp(path + len - alphaLen, alphaSuffix, alphaLen) != 0) {
+    return 0;
+  }
+
+  char rgbPath[MAX_PATH_LEN];
+  snprintf(rgbPath, sizeof(rgbPath), "%.*s%s", (int) (len - alphaLen), path, suffix);
+
+  if (access(rgbPath, R_OK) == 0) {
+    add_pair(ftwJob, rgbPath, path);
+  } else {
+    fprintf(stderr, "no RGB file for \"%s\"\n", path);
+  }
+
+  return 0;
+}
+
+static
+int pair_cmp(const void *a, const void *b) {
+  return strcmp(((const PairCheck *) a)->rgbPath, ((const PairCheck *) b)->rgbPath);
+}
+
+// Each worker pulls the next pair index until all pairs are done
+
+static
+void* worker_main(void *arg) {
+  PairCheckJob *job = (PairCheckJob *) arg;
+
+  while (1) {
+    int pairIndex = __sync_fetch_and_add(&job->nextPair, 1);
+
+    if (pairIndex >= job->numPairs) {
+      break;
+    }
+
+    PairCheck *pair = &job->pairs[pairIndex];
+    pair->err = mp4_pair_check_files(pair->rgbPath, pair->alphaPath, &pair->report);
+  }
+
+  return NULL;
+}
+
+int main(int argc, const char * argv[]) {
+  PairCheckJob job;
+  memset(&job, 0, sizeof(job));
+
+  job.numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+  int argi = 1;
+
+  for ( ; argi < argc; argi++) {
+    const char *arg = argv[argi];
+
+    if (arg[0] != '-') {
+      break;
+    }
+
+    if (argi == (argc - 1)) {
+      usage();
+      return 1;
+    }
+
+    const char *value = argv[++argi];
+
+    if (strcmp(arg, "-threads") == 0) {
+      job.numThreads = atoi(value);
+    } else {
+      printf("unknown option \"%s\"\n", arg);
+      usage();
+      return 1;
+    }
+  }
+
+  if (argi == argc) {
+    usage();
+    return 1;
+  }
+
+  ftwJob = &job;
+
+  for ( ; argi < argc; argi++) {
+    const char *path = argv[argi];
+    struct stat sb;
+
+    if (stat(path, &sb) != 0) {
+      fprintf(stderr, "can't access \"%s\"\n", path);
+      return 1;
+    }
+
+    if (S_ISDIR(sb.st_mode)) {
+      nftw(path, add_tree_entry, 32, FTW_PHYS);
+    } else if (add_rgb_path(&job, path) == 0) {
+      fprintf(stderr, "no alpha file for \"%s\"\n", path);
+      return 1;
+    }
+  }
+
+  if (job.numPairs == 0) {
+    fprintf(stderr, "no RGB and alpha pairs found\n");
+    return 1;
+  }
+
+  qsort(job.pairs, job.numPairs, sizeof(PairCheck), pair_cmp);
+
+  if (job.numThreads < 1) {
+    job.numThreads = 1;
+  }
+  if (job.numThreads > job.numPairs) {
+    job.numThreads = job.numPairs;
+  }
+
+  pthread_t *threads = (pthread_t *) malloc(job.numThreads * sizeof(pthread_t));
+
+  for (int i = 0; i < job.numThreads; i++) {
+    pthread_create(&threads[i], NULL, worker_main, &job);
+  }
+
+  for (int i = 0; i < job.numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+
+  // Report in sorted order once all pairs are checked
+
+  int numFailed = 0;
+
+  for (int i = 0; i < job.numPairs; i++) {
+    PairCheck *pair = &job.pairs[i];
+
+    if (pair->err == 0 && pair->report.isLockStep) {
+      printf("ok \"%s\" : %d frames\n", pair->rgbPath, pair->report.numFrames);
+    } else {
+      numFailed += 1;
+      printf("mismatch \"%s\"\n", pair->rgbPath);
+      mp4_pair_print_report(stdout, "  ", &pair->report);
+    }
+
+    free(pair->rgbPath);
+    free(pair->alphaPath);
+  }
+
+  free(job.pairs);
+
+  if (numFailed > 0) {
+    fprintf(stderr, "%d of %d pairs do not match\n", numFailed, job.numPairs);
+    return 1;
+  }
+
+  return 0;
+}
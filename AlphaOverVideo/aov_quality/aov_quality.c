@@ -0,0 +1,451 @@
+//
+//  aov_quality.c
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Command line utility that compares a source PNG sequence to the
+//  decoded Y4M output of an encode. Y PSNR, SSIM on Y, linear light
+//  RGB PSNR per channel and, for alpha clips, alpha PSNR and an
+//  alpha weighted edge PSNR are reported for each frame and for the
+//  whole clip. Frames are measured in parallel on a pool of threads
+//  and each frame is processed in tiles, see quality_metrics.h.
+//
+//  This tool depends only on libc, pthreads and zlib:
+//
+//  cc -O2 -I../AlphaOverVideo -o aov_quality aov_quality.c -lz -lpthread -lm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "BT709.h"
+#include "y4m_reader.h"
+#include "png_reader.h"
+#include "quality_metrics.h"
+
+#define MAX_PATH_LEN 4096
+#define MAX_FRAMES 1000000
+
+typedef struct {
+  QualityTables *tables;
+  int isAlpha;
+
+  const char *y4mPath;
+  char alphaPath[MAX_PATH_LEN];
+
+  char **frames;
+  int numFrames;
+
+  int width;
+  int height;
+
+  QualityStats *frameStats;
+  int *frameErrors;
+
+  int nextFrame;
+  int numThreads;
+} QualityJob;
+
+static
+void usage() {
+  printf("aov_quality ?OPTIONS? -frames F0001.png DECODED.y4m\n");
+  printf("-gamma apple|srgb|linear (gamma DECODED.y4m was encoded with, default is apple)\n");
+  printf("-alpha 1 (compare premultiplied RGB and DECODED_alpha.y4m to PNG alpha)\n");
+  printf("-threads N (number of frames measured at once, default num CPUs)\n");
+  printf("-json FILE (write per frame and clip metrics as JSON)\n");
+}
+
+static
+double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (ts.tv_nsec / 1.0e9);
+}
+
+// Find input frames the same way srgb_to_bt709 -frames does, frame
+// numbers are incremented from the first frame until a file is missing.
+
+static
+int find_frames(QualityJob *job, const char *path) {
+  const char *dot = strrchr(path, '.');
+  const char *slash = strrchr(path, '/');
+
+  if (dot == NULL || (slash != NULL && dot < slash)) {
+    fprintf(stderr, "first frame \"%s\" has no extension\n", path);
+    return 1;
+  }
+
+  const char *numEnd = dot;
+  const char *numStart = numEnd;
+
+  while (numStart > path && numStart[-1] >= '0' && numStart[-1] <= '9') {
+    numStart--;
+  }
+
+  const int numDigits = (int) (numEnd - numStart);
+
+  if (numDigits == 0 || numDigits > 7) {
+    fprintf(stderr, "could not find frame number in \"%s\"\n", path);
+    return 1;
+  }
+
+  const int prefixLen = (int) (numStart - path);
+  const int firstNum = atoi(numStart);
+
+  int maxFrames = 0;
+
+  for (int frameNum = firstNum; frameNum < MAX_FRAMES; frameNum++) {
+    char framePath[MAX_PATH_LEN];
+    snprintf(framePath, sizeof(framePath), "%.*s%0*d%s", prefixLen, path, numDigits, frameNum, dot);
+
+    if (access(framePath, R_OK) != 0) {
+      break;
+    }
+
+    if (job->numFrames == maxFrames) {
+      maxFrames = (maxFrames == 0) ? 64 : (maxFrames * 2);
+      job->frames = (char **) realloc(job->frames, maxFrames * sizeof(char *));
+    }
+
+    job->frames[job->numFrames++] = strdup(framePath);
+  }
+
+  if (job->numFrames == 0) {
+    fprintf(stderr, "no input frames found starting at \"%s\"\n", path);
+    return 1;
+  }
+
+  return 0;
+}
+
+static
+void* worker_main(void *arg) {
+  QualityJob *job = (QualityJob *) arg;
+
+  Y4MReaderStruct reader;
+  Y4MReaderStruct alphaReader;
+  int hasReader = (y4m_open_reader(job->y4mPath, &reader) == 0);
+  int hasAlphaReader = job->isAlpha && (y4m_open_reader(job->alphaPath, &alphaReader) == 0);
+
+  Y4MFrameStruct fs;
+  Y4MFrameStruct alphaFs;
+  memset(&fs, 0, sizeof(fs));
+  memset(&alphaFs, 0, sizeof(alphaFs));
+
+  if (hasReader) {
+    fs.yLen = reader.yLen;
+    fs.uLen = reader.uvLen;
+    fs.vLen = reader.uvLen;
+    fs.yPtr = (uint8_t *) malloc(fs.yLen);
+    fs.uPtr = (uint8_t *) malloc(fs.uLen);
+    fs.vPtr = (uint8_t *) malloc(fs.vLen);
+  }
+
+  if (hasAlphaReader) {
+    alphaFs.yLen = alphaReader.yLen;
+    alphaFs.uLen = alphaReader.uvLen;
+    alphaFs.vLen = alphaReader.uvLen;
+    alphaFs.yPtr = (uint8_t *) malloc(alphaFs.yLen);
+    alphaFs.uPtr = (uint8_t *) malloc(alphaFs.uLen);
+    alphaFs.vPtr = (uint8_t *) malloc(alphaFs.vLen);
+  }
+
+  while (1) {
+    int frameNum = __sync_fetch_and_add(&job->nextFrame, 1);
+
+    if (frameNum >= job->numFrames) {
+      break;
+    }
+
+    int err = (!hasReader || (job->isAlpha && !hasAlphaReader));
+
+    if (err == 0) {
+      err = y4m_read_frame(&reader, frameNum, &fs);
+    }
+
+    if (err == 0 && job->isAlpha) {
+      err = y4m_read_frame(&alphaReader, frameNum, &alphaFs);
+    }
+
+    PngImage image;
+    memset(&image, 0, sizeof(image));
+
+    if (err == 0) {
+      err = png_read_file(job->frames[frameNum], &image);
+    }
+
+    if (err == 0 && (image.width != job->width || image.height != job->height)) {
+      fprintf(stderr, "\"%s\" is %dx%d, expected %dx%d\n",
+              job->frames[frameNum], image.width, image.height, job->width, job->height);
+      err = 1;
+    }
+
+    if (err == 0) {
+      QualityFrame frame;
+      frame.tables = job->tables;
+      frame.srcPixels = image.pixels;
+      frame.srcPixelsPerRow = image.width;
+      frame.dstY = fs.yPtr;
+      frame.dstCb = fs.uPtr;
+      frame.dstCr = fs.vPtr;
+      frame.dstAlpha = job->isAlpha ? alphaFs.yPtr : NULL;
+      frame.isPremultiplied = job->isAlpha;
+      frame.width = job->width;
+      frame.height = job->height;
+
+      quality_measure(&frame, &job->frameStats[frameNum]);
+    }
+
+    png_image_free(&image);
+    job->frameErrors[frameNum] = err;
+  }
+
+  free(fs.yPtr);
+  free(fs.uPtr);
+  free(fs.vPtr);
+  free(alphaFs.yPtr);
+  free(alphaFs.uPtr);
+  free(alphaFs.vPtr);
+
+  if (hasReader) {
+    y4m_close_reader(&reader);
+  }
+  if (hasAlphaReader) {
+    y4m_close_reader(&alphaReader);
+  }
+
+  return NULL;
+}
+
+static
+void json_stats(FILE *outFile, const QualityStats *stats, int isAlpha) {
+  fprintf(outFile, "\"y_psnr\": %.3f, \"ssim\": %.5f, \"rgb_psnr\": %.3f, \"r_psnr\": %.3f, \"g_psnr\": %.3f, \"b_psnr\": %.3f",
+          quality_stats_y_psnr(stats),
+          quality_stats_ssim(stats),
+          quality_linear_psnr(&stats->linear),
+          quality_linear_channel_psnr(&stats->linear, 0),
+          quality_linear_channel_psnr(&stats->linear, 1),
+          quality_linear_channel_psnr(&stats->linear, 2));
+
+  if (isAlpha) {
+    fprintf(outFile, ", \"alpha_psnr\": %.3f, \"edge_psnr\": %.3f",
+            quality_alpha_psnr(&stats->alpha),
+            quality_stats_edge_psnr(stats));
+  }
+}
+
+static
+int write_json(const QualityJob *job, const QualityStats *clipStats, const char *path) {
+  FILE *outFile = fopen(path, "w");
+
+  if (outFile == NULL) {
+    return 1;
+  }
+
+  fprintf(outFile, "{\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"alpha\": %s,\n  \"clip\": { ",
+          job->width, job->height, job->numFrames, job->isAlpha ? "true" : "false");
+  json_stats(outFile, clipStats, job->isAlpha);
+  fprintf(outFile, " },\n  \"per_frame\": [");
+
+  for (int i = 0; i < job->numFrames; i++) {
+    fprintf(outFile, "%s\n    { \"frame\": %d, ", (i == 0) ? "" : ",", i);
+    json_stats(outFile, &job->frameStats[i], job->isAlpha);
+    fprintf(outFile, " }");
+  }
+
+  fprintf(outFile, "\n  ]\n}\n");
+
+  return (fclose(outFile) == 0) ? 0 : 1;
+}
+
+int main(int argc, const char * argv[]) {
+  QualityJob job;
+  memset(&job, 0, sizeof(job));
+
+  job.numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+  BT709Gamma gamma = BT709GammaApple;
+  const char *firstFrame = NULL;
+  const char *jsonPath = NULL;
+
+  int argi = 1;
+
+  for ( ; argi < argc; argi++) {
+    const char *arg = argv[argi];
+
+    if (arg[0] != '-') {
+      break;
+    }
+
+    if (argi == (argc - 1)) {
+      usage();
+      return 1;
+    }
+
+    const char *value = argv[++argi];
+
+    if (strcmp(arg, "-gamma") == 0) {
+      if (strcmp(value, "apple") == 0) {
+        gamma = BT709GammaApple;
+      } else if (strcmp(value, "srgb") == 0) {
+        gamma = BT709GammaSrgb;
+      } else if (strcmp(value, "linear") == 0) {
+        gamma = BT709GammaLinear;
+      } else {
+        printf("option -gamma unknown value \"%s\"\n", value);
+        return 1;
+      }
+    } else if (strcmp(arg, "-alpha") == 0) {
+      job.isAlpha = atoi(value);
+    } else if (strcmp(arg, "-frames") == 0) {
+      firstFrame = value;
+    } else if (strcmp(arg, "-threads") == 0) {
+      job.numThreads = atoi(value);
+    } else if (strcmp(arg, "-json") == 0) {
+      jsonPath = value;
+    } else {
+      printf("unknown option \"%s\"\n", arg);
+      usage();
+      return 1;
+    }
+  }
+
+  if (argi != (argc - 1) || firstFrame == NULL) {
+    usage();
+    return 1;
+  }
+
+  if (job.isAlpha && gamma != BT709GammaSrgb) {
+    printf("-alpha 1 can only be used with -gamma srgb\n");
+    return 1;
+  }
+
+  if (job.numThreads < 1) {
+    job.numThreads = 1;
+  }
+
+  job.y4mPath = argv[argi];
+
+  size_t len = strlen(job.y4mPath);
+
+  if (len < 4 || strcmp(job.y4mPath + len - 4, ".y4m") != 0) {
+    printf("input \"%s\" must be a .y4m file\n", job.y4mPath);
+    return 1;
+  }
+
+  snprintf(job.alphaPath, sizeof(job.alphaPath), "%.*s_alpha.y4m", (int) (len - 4), job.y4mPath);
+
+  Y4MReaderStruct reader;
+
+  if (y4m_open_reader(job.y4mPath, &reader) != 0) {
+    fprintf(stderr, "can't read \"%s\"\n", job.y4mPath);
+    return 1;
+  }
+
+  job.width = reader.width;
+  job.height = reader.height;
+  int numDecodedFrames = reader.numFrames;
+  y4m_close_reader(&reader);
+
+  if (job.isAlpha) {
+    if (y4m_open_reader(job.alphaPath, &reader) != 0) {
+      fprintf(stderr, "can't read \"%s\"\n", job.alphaPath);
+      return 1;
+    }
+
+    if (reader.width != job.width || reader.height != job.height || reader.numFrames != numDecodedFrames) {
+      fprintf(stderr, "\"%s\" does not match \"%s\"\n", job.alphaPath, job.y4mPath);
+      y4m_close_reader(&reader);
+      return 1;
+    }
+
+    y4m_close_reader(&reader);
+  }
+
+  if (find_frames(&job, firstFrame) != 0) {
+    return 1;
+  }
+
+  const int numFound = job.numFrames;
+
+  if (job.numFrames != numDecodedFrames) {
+    fprintf(stderr, "found %d PNG frames but \"%s\" has %d frames, comparing %d\n",
+            job.numFrames, job.y4mPath, numDecodedFrames,
+            (job.numFrames < numDecodedFrames) ? job.numFrames : numDecodedFrames);
+
+    if (numDecodedFrames < job.numFrames) {
+      job.numFrames = numDecodedFrames;
+    }
+  }
+
+  job.tables = (QualityTables *) malloc(sizeof(QualityTables));
+  quality_tables_init(job.tables, gamma);
+
+  job.frameStats = (QualityStats *) calloc(job.numFrames, sizeof(QualityStats));
+  job.frameErrors = (int *) calloc(job.numFrames, sizeof(int));
+
+  const double startTime = now_seconds();
+
+  int numThreads = (job.numThreads < job.numFrames) ? job.numThreads : job.numFrames;
+  pthread_t *threads = (pthread_t *) malloc(numThreads * sizeof(pthread_t));
+
+  for (int i = 0; i < numThreads; i++) {
+    pthread_create(&threads[i], NULL, worker_main, &job);
+  }
+
+  for (int i = 0; i < numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+
+  const double elapsed = now_seconds() - startTime;
+
+  QualityStats clipStats;
+  memset(&clipStats, 0, sizeof(clipStats));
+
+  int numFailed = 0;
+
+  for (int i = 0; i < job.numFrames; i++) {
+    if (job.frameErrors[i] != 0) {
+      fprintf(stderr, "failed to compare frame %d \"%s\"\n", i, job.frames[i]);
+      numFailed++;
+    } else {
+      quality_stats_merge(&clipStats, &job.frameStats[i]);
+    }
+  }
+
+  printf("%d frames %dx%d in %.2f s (%.1f Mpix/s)\n",
+         job.numFrames, job.width, job.height, elapsed,
+         ((double) job.width * job.height * job.numFrames) / (elapsed * 1.0e6));
+  printf("Y PSNR %.2f SSIM %.5f\n", quality_stats_y_psnr(&clipStats), quality_stats_ssim(&clipStats));
+  printf("linear RGB PSNR %.2f (R %.2f G %.2f B %.2f)\n",
+         quality_linear_psnr(&clipStats.linear),
+         quality_linear_channel_psnr(&clipStats.linear, 0),
+         quality_linear_channel_psnr(&clipStats.linear, 1),
+         quality_linear_channel_psnr(&clipStats.linear, 2));
+
+  if (job.isAlpha) {
+    printf("alpha PSNR %.2f edge PSNR %.2f\n", quality_alpha_psnr(&clipStats.alpha), quality_stats_edge_psnr(&clipStats));
+  }
+
+  int exitStatus = (numFailed > 0) ? 1 : 0;
+
+  if (jsonPath != NULL && write_json(&job, &clipStats, jsonPath) != 0) {
+    fprintf(stderr, "can't write \"%s\"\n", jsonPath);
+    exitStatus = 1;
+  }
+
+  for (int i = 0; i < numFound; i++) {
+    free(job.frames[i]);
+  }
+  free(job.frames);
+  free(job.frameStats);
+  free(job.frameErrors);
+  free(job.tables);
+
+  return exitStatus;
+}
@@ -0,0 +1,608 @@
+//
+//  aov_thumbnail.c
+//
+//  Created by Mo DeJong on 10/19/26.
+//
+//  Command line utility that renders preview stills for
+//  alpha clips without a GPU. The premultiplied RGB and the alpha
+//  Y4M files written by srgb_to_bt709 -alpha 1 are decoded on the CPU,
+//  composited in linear light over a background and then
+//  written as PNG thumbnails or as one contact sheet per clip.
+//  Clips are processed in parallel on a pool of threads.
+//
+//  This tool depends only on libc, pthreads and zlib:
+//
+//  cc -O2 -I../AlphaOverVideo -o aov_thumbnail aov_thumbnail.c -lz -lpthread -lm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "BT709.h"
+#include "bt709_decode.h"
+#include "y4m_reader.h"
+#include "alpha_compositor.h"
+#include "png_writer.h"
+#include "linear_scaler.h"
+
+#define MAX_TIMES 256
+
+typedef enum {
+  BackgroundSolid = 0,
+  BackgroundChecker = 1,
+  BackgroundNone = 2
+} BackgroundType;
+
+typedef struct {
+  BackgroundType bgType;
+  uint32_t bgColor;
+  BT709Gamma gamma;
+
+  // Explicit times in seconds, or when numTimes is zero
+  // count frames evenly spaced over the clip duration.
+  double times[MAX_TIMES];
+  int numTimes;
+  int count;
+
+  // Thumbnail width, zero means full size
+  int thumbWidth;
+
+  // Resample kernel for thumbnails, box when isBoxFilter is set
+  int isBoxFilter;
+  LinearScaleKernel filter;
+
+  // Number of columns in contact sheet, zero means write one PNG per time
+  int sheetCols;
+
+  int numThreads;
+  const char *outDir;
+
+  const char **clips;
+  int numClips;
+
+  AlphaCompositorTables *tables;
+  uint8_t alphaTable[256];
+
+  // Decoded RGB byte -> linear, depends on the gamma
+  float layerToLinear[256];
+
+  // Next clip to process, shared by all workers
+  int nextClip;
+  int numFailed;
+} ThumbnailJob;
+
+static
+void usage() {
+  printf("aov_thumbnail ?OPTIONS? CLIP.y4m ?CLIP.y4m ...?\n");
+  printf("-bg RRGGBB|checker|none (background, default checker)\n");
+  printf("-gamma apple|srgb|linear (RGB gamma curve, default srgb)\n");
+  printf("-times T1,T2,... (timestamps in seconds)\n");
+  printf("-count N (N frames evenly spaced over clip, default 1)\n");
+  printf("-width W (thumbnail width, default full size)\n");
+  printf("-filter box|bilinear|bicubic|lanczos3 (thumbnail resample filter, default box)\n");
+  printf("-sheet COLS (write one contact sheet per clip with COLS columns)\n");
+  printf("-threads N (number of clips processed at once, default num CPUs)\n");
+  printf("-outdir DIR (output directory, default .)\n");
+  printf("The alpha channel is read from CLIP_alpha.y4m when it exists\n");
+}
+
+// Find CLIP_alpha.y4m given CLIP.y4m, returns 0 when no alpha file exists
+
+static
+int alpha_path_for_clip(const char *rgbPath, char *alphaPath, int maxLen) {
+  const char *suffix = ".y4m";
+  size_t len = strlen(rgbPath);
+  size_t suffixLen = strlen(suffix);
+
+  if (len < suffixLen || strcmp(rgbPath + len - suffixLen, suffix) != 0) {
+    return 0;
+  }
+
+  snprintf(alphaPath, maxLen, "%.*s_alpha.y4m", (int) (len - suffixLen), rgbPath);
+
+  return access(alphaPath, R_OK) == 0;
+}
+
+// Clip name without directory and without ".y4m"
+
+static
+void clip_basename(const char *rgbPath, char *name, int maxLen) {
+  const char *slash = strrchr(rgbPath, '/');
+  const char *start = (slash != NULL) ? slash + 1 : rgbPath;
+  snprintf(name, maxLen, "%s", start);
+
+  size_t len = strlen(name);
+
+  if (len > 4 && strcmp(name + len - 4, ".y4m") == 0) {
+    name[len - 4] = '\0';
+  }
+}
+
+static
+void fill_background(ThumbnailJob *job, uint32_t *pixels, int width, int height) {
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      uint32_t pixel = job->bgColor;
+      if (job->bgType == BackgroundChecker) {
+        int isDark = ((row / 16) + (col / 16)) & 0x1;
+        pixel = isDark ? 0xFF999999 : 0xFFCCCCCC;
+      }
+      pixels[(row * width) + col] = pixel;
+    }
+  }
+}
+
+// Box filter downscale done with linear premultiplied values so that
+// edges are averaged the same way the GPU resampler would average them.
+
+static
+void downscale_linear(const AlphaCompositorTables *tables,
+                      const uint32_t *inPixels,
+                      int inWidth,
+                      int inHeight,
+                      uint32_t *outPixels,
+                      int outPixelsPerRow,
+                      int outWidth,
+                      int outHeight)
+{
+  for (int row = 0; row < outHeight; row++) {
+    const int r0 = (row * inHeight) / outHeight;
+    int r1 = ((row + 1) * inHeight) / outHeight;
+    r1 = (r1 > r0) ? r1 : r0 + 1;
+
+    for (int col = 0; col < outWidth; col++) {
+      const int c0 = (col * inWidth) / outWidth;
+      int c1 = ((col + 1) * inWidth) / outWidth;
+      c1 = (c1 > c0) ? c1 : c0 + 1;
+
+      float sumB = 0.0f, sumG = 0.0f, sumR = 0.0f, sumA = 0.0f;
+
+      for (int y = r0; y < r1; y++) {
+        for (int x = c0; x < c1; x++) {
+          uint32_t pixel = inPixels[(y * inWidth) + x];
+          const float An = tables->alphaNorm[(pixel >> 24) & 0xFF];
+          sumB += tables->toLinear[pixel & 0xFF] * An;
+          sumG += tables->toLinear[(pixel >> 8) & 0xFF] * An;
+          sumR += tables->toLinear[(pixel >> 16) & 0xFF] * An;
+          sumA += An;
+        }
+      }
+
+      uint32_t outPixel = 0;
+
+      if (sumA > 0.0f) {
+        const float invA = 1.0f / sumA;
+        const int numPixels = (r1 - r0) * (c1 - c0);
+        const int A = (int) ((sumA / numPixels) * 255.0f + 0.5f);
+        const int B = ac_encode_srgb(tables, sumB * invA);
+        const int G = ac_encode_srgb(tables, sumG * invA);
+        const int R = ac_encode_srgb(tables, sumR * invA);
+        outPixel = ((uint32_t) A << 24) | (R << 16) | (G << 8) | B;
+      }
+
+      outPixels[(row * outPixelsPerRow) + col] = outPixel;
+    }
+  }
+}
+
+// Render all requested frames for one clip, returns 0 on success
+
+static
+int render_clip(ThumbnailJob *job, const char *rgbPath) {
+  Y4MReaderStruct rgbReader;
+  Y4MReaderStruct alphaReader;
+  int hasAlpha = 0;
+  int result = 1;
+
+  if (y4m_open_reader(rgbPath, &rgbReader) != 0) {
+    return 1;
+  }
+
+  if (rgbReader.numFrames == 0) {
+    fprintf(stderr, "no frames in \"%s\"\n", rgbPath);
+    y4m_close_reader(&rgbReader);
+    return 1;
+  }
+
+  char alphaPath[4096];
+
+  if (alpha_path_for_clip(rgbPath, alphaPath, sizeof(alphaPath))) {
+    if (y4m_open_reader(alphaPath, &alphaReader) != 0) {
+      y4m_close_reader(&rgbReader);
+      return 1;
+    }
+
+    if (alphaReader.width != rgbReader.width || alphaReader.height != rgbReader.height) {
+      fprintf(stderr, "alpha dimensions %d x %d do not match RGB %d x %d for \"%s\"\n",
+              alphaReader.width, alphaReader.height, rgbReader.width, rgbReader.height, rgbPath);
+      y4m_close_reader(&rgbReader);
+      y4m_close_reader(&alphaReader);
+      return 1;
+    }
+
+    hasAlpha = 1;
+  }
+
+  const int width = rgbReader.width;
+  const int height = rgbReader.height;
+
+  int thumbWidth = width;
+  int thumbHeight = height;
+
+  if (job->thumbWidth > 0 && job->thumbWidth < width) {
+    thumbWidth = job->thumbWidth;
+    thumbHeight = (int) (((long) height * thumbWidth + (width / 2)) / width);
+    thumbHeight = (thumbHeight > 0) ? thumbHeight : 1;
+  }
+
+  // Frame numbers to render
+
+  int frameNums[MAX_TIMES];
+  int numFrames;
+
+  if (job->numTimes > 0) {
+    numFrames = job->numTimes;
+    for (int i = 0; i < numFrames; i++) {
+      frameNums[i] = y4m_frame_for_time(&rgbReader, job->times[i]);
+    }
+  } else {
+    numFrames = job->count;
+    for (int i = 0; i < numFrames; i++) {
+      frameNums[i] = (int) (((long) i * rgbReader.numFrames) / numFrames);
+    }
+  }
+
+  const int sheetCols = (job->sheetCols > numFrames) ? numFrames : job->sheetCols;
+  const int sheetRows = (sheetCols > 0) ? ((numFrames + sheetCols - 1) / sheetCols) : 0;
+  const int sheetWidth = sheetCols * thumbWidth;
+  const int sheetHeight = sheetRows * thumbHeight;
+
+  uint8_t *yPlane = (uint8_t *) malloc(rgbReader.yLen);
+  uint8_t *uPlane = (uint8_t *) malloc(rgbReader.uvLen);
+  uint8_t *vPlane = (uint8_t *) malloc(rgbReader.uvLen);
+  uint32_t *layerPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint8_t *alphaPlane = (uint8_t *) malloc(width * height);
+  uint32_t *bgPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *outPixels = (uint32_t *) malloc(width * height * sizeof(uint32_t));
+  uint32_t *thumbPixels = (uint32_t *) malloc(thumbWidth * thumbHeight * sizeof(uint32_t));
+  uint32_t *sheetPixels = NULL;
+
+  if (sheetCols > 0) {
+    sheetPixels = (uint32_t *) calloc(sheetWidth * sheetHeight, sizeof(uint32_t));
+  }
+
+  LinearScaler scaler;
+  memset(&scaler, 0, sizeof(scaler));
+
+  if (yPlane == NULL || uPlane == NULL || vPlane == NULL || layerPixels == NULL ||
+      alphaPlane == NULL || bgPixels == NULL || outPixels == NULL || thumbPixels == NULL ||
+      (sheetCols > 0 && sheetPixels == NULL)) {
+    fprintf(stderr, "could not allocate frame buffers for \"%s\"\n", rgbPath);
+    goto done;
+  }
+
+  // Clips already run in parallel, so the scaler uses one band
+
+  if (thumbWidth != width && !job->isBoxFilter &&
+      linear_scaler_init(&scaler, job->filter, 0, width, height, thumbWidth, thumbHeight, 1) != 0) {
+    fprintf(stderr, "could not allocate scaler for \"%s\"\n", rgbPath);
+    goto done;
+  }
+
+  fill_background(job, bgPixels, width, height);
+
+  char name[1024];
+  clip_basename(rgbPath, name, sizeof(name));
+
+  Y4MFrameStruct fs;
+  fs.yPtr = yPlane;
+  fs.yLen = rgbReader.yLen;
+  fs.uPtr = uPlane;
+  fs.uLen = rgbReader.uvLen;
+  fs.vPtr = vPlane;
+  fs.vLen = rgbReader.uvLen;
+
+  for (int i = 0; i < numFrames; i++) {
+    const int frameNum = frameNums[i];
+
+    if (y4m_read_frame(&rgbReader, frameNum, &fs) != 0) {
+      fprintf(stderr, "could not read frame %d from \"%s\"\n", frameNum, rgbPath);
+      goto done;
+    }
+
+    bt709_decode_frame(yPlane, uPlane, vPlane, width, height, job->gamma, layerPixels, width);
+
+    AlphaCompositorLayer layer;
+    memset(&layer, 0, sizeof(layer));
+    layer.pixels = layerPixels;
+    layer.pixelsPerRow = width;
+    layer.toLinear = job->layerToLinear;
+    layer.width = width;
+    layer.height = height;
+
+    if (hasAlpha) {
+      // The alpha frame can be shorter than the RGB clip, hold the last frame
+      const int alphaFrameNum = (frameNum < alphaReader.numFrames) ? frameNum : (alphaReader.numFrames - 1);
+
+      if (y4m_read_frame(&alphaReader, alphaFrameNum, &fs) != 0) {
+        fprintf(stderr, "could not read frame %d from \"%s\"\n", alphaFrameNum, alphaPath);
+        goto done;
+      }
+
+      bt709_decode_alpha(yPlane, width, height, job->alphaTable, alphaPlane, width);
+
+      layer.alpha = alphaPlane;
+      layer.alphaBytesPerRow = width;
+      layer.isPremultiplied = 1;
+
+      if (ac_layer_scan_coverage(&layer) != 0) {
+        goto done;
+      }
+    }
+
+    AlphaCompositorFrame frame;
+    ac_frame_init(&frame, job->tables,
+                  (job->bgType == BackgroundNone) ? NULL : bgPixels, width,
+                  outPixels, width,
+                  width, height,
+                  &layer, 1);
+
+    AlphaCompositorStats stats;
+    memset(&stats, 0, sizeof(stats));
+    ac_composite(&frame, &stats);
+
+    ac_layer_free_coverage(&layer);
+
+    uint32_t *stillPixels = outPixels;
+
+    if (thumbWidth != width && job->isBoxFilter) {
+      downscale_linear(job->tables, outPixels, width, height, thumbPixels, thumbWidth, thumbWidth, thumbHeight);
+      stillPixels = thumbPixels;
+    } else if (thumbWidth != width) {
+      // Composited pixels are not premultiplied, the scaler input and output are
+      premultiply_row(outPixels, outPixels, width * height);
+      linear_scaler_scale(&scaler, outPixels, width, thumbPixels, thumbWidth);
+      unpremultiply_row(&scaler.tables, thumbPixels, thumbPixels, thumbWidth * thumbHeight);
+      stillPixels = thumbPixels;
+    }
+
+    if (sheetPixels != NULL) {
+      const int sheetRow = i / sheetCols;
+      const int sheetCol = i % sheetCols;
+      uint32_t *dstPtr = sheetPixels + (sheetRow * thumbHeight * sheetWidth) + (sheetCol * thumbWidth);
+
+      for (int row = 0; row < thumbHeight; row++) {
+        memcpy(dstPtr + (row * sheetWidth), stillPixels + (row * thumbWidth), thumbWidth * sizeof(uint32_t));
+      }
+    } else {
+      char outPath[4096];
+      snprintf(outPath, sizeof(outPath), "%s/%s_%04d.png", job->outDir, name, frameNum);
+
+      if (png_write_file(outPath, stillPixels, thumbWidth, thumbWidth, thumbHeight, (job->bgType == BackgroundNone)) != 0) {
+        fprintf(stderr, "could not write \"%s\"\n", outPath);
+        goto done;
+      }
+    }
+  }
+
+  if (sheetPixels != NULL) {
+    char outPath[4096];
+    snprintf(outPath, sizeof(outPath), "%s/%s_sheet.png", job->outDir, name);
+
+    if (png_write_file(outPath, sheetPixels, sheetWidth, sheetWidth, sheetHeight, (job->bgType == BackgroundNone)) != 0) {
+      fprintf(stderr, "could not write \"%s\"\n", outPath);
+      goto done;
+    }
+  }
+
+  result = 0;
+
+done:
+  free(yPlane);
+  free(uPlane);
+  free(vPlane);
+  free(layerPixels);
+  free(alphaPlane);
+  free(bgPixels);
+  free(outPixels);
+  free(thumbPixels);
+  free(sheetPixels);
+
+  linear_scaler_free(&scaler);
+
+  y4m_close_reader(&rgbReader);
+
+  if (hasAlpha) {
+    y4m_close_reader(&alphaReader);
+  }
+
+  return result;
+}
+
+// Each worker pulls the next clip index until all clips are done
+
+static
+void* worker_main(void *arg) {
+  ThumbnailJob *job = (ThumbnailJob *) arg;
+
+  while (1) {
+    int clipIndex = __sync_fetch_and_add(&job->nextClip, 1);
+
+    if (clipIndex >= job->numClips) {
+      break;
+    }
+
+    const char *clip = job->clips[clipIndex];
+
+    if (render_clip(job, clip) != 0) {
+      __sync_fetch_and_add(&job->numFailed, 1);
+      fprintf(stderr, "failed \"%s\"\n", clip);
+    } else {
+      printf("rendered \"%s\"\n", clip);
+    }
+  }
+
+  return NULL;
+}
+
+static
+int parse_times(ThumbnailJob *job, const char *str) {
+  job->numTimes = 0;
+
+  const char *ptr = str;
+
+  while (*ptr != '\0') {
+    char *endPtr;
+    double t = strtod(ptr, &endPtr);
+
+    if (endPtr == ptr || t < 0.0 || job->numTimes == MAX_TIMES) {
+      return 1;
+    }
+
+    job->times[job->numTimes++] = t;
+
+    ptr = endPtr;
+    if (*ptr == ',') {
+      ptr++;
+    } else if (*ptr != '\0') {
+      return 1;
+    }
+  }
+
+  return (job->numTimes == 0);
+}
+
+int main(int argc, const char * argv[]) {
+  ThumbnailJob job;
+  memset(&job, 0, sizeof(job));
+
+  job.bgType = BackgroundChecker;
+  job.gamma = BT709GammaSrgb;
+  job.count = 1;
+  job.outDir = ".";
+  job.isBoxFilter = 1;
+  job.numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+  int argi = 1;
+
+  for ( ; argi < argc; argi++) {
+    const char *arg = argv[argi];
+
+    if (arg[0] != '-') {
+      break;
+    }
+
+    if (argi == (argc - 1)) {
+      usage();
+      return 1;
+    }
+
+    const char *value = argv[++argi];
+
+    if (strcmp(arg, "-bg") == 0) {
+      if (strcmp(value, "checker") == 0) {
+        job.bgType = BackgroundChecker;
+      } else if (strcmp(value, "none") == 0) {
+        job.bgType = BackgroundNone;
+      } else {
+        unsigned int rgb;
+        if (strlen(value) != 6 || sscanf(value, "%06x", &rgb) != 1) {
+          printf("unknown option -bg value \"%s\"\n", value);
+          return 1;
+        }
+        job.bgType = BackgroundSolid;
+        job.bgColor = 0xFF000000 | rgb;
+      }
+    } else if (strcmp(arg, "-gamma") == 0) {
+      if (strcmp(value, "apple") == 0) {
+        job.gamma = BT709GammaApple;
+      } else if (strcmp(value, "srgb") == 0) {
+        job.gamma = BT709GammaSrgb;
+      } else if (strcmp(value, "linear") == 0) {
+        job.gamma = BT709GammaLinear;
+      } else {
+        printf("unknown option -gamma value \"%s\"\n", value);
+        return 1;
+      }
+    } else if (strcmp(arg, "-times") == 0) {
+      if (parse_times(&job, value) != 0) {
+        printf("invalid -times value \"%s\"\n", value);
+        return 1;
+      }
+    } else if (strcmp(arg, "-count") == 0) {
+      job.count = atoi(value);
+      if (job.count < 1 || job.count > MAX_TIMES) {
+        printf("-count must be in range [1, %d]\n", MAX_TIMES);
+        return 1;
+      }
+    } else if (strcmp(arg, "-width") == 0) {
+      job.thumbWidth = atoi(value);
+    } else if (strcmp(arg, "-filter") == 0) {
+      job.isBoxFilter = 0;
+      if (strcmp(value, "box") == 0) {
+        job.isBoxFilter = 1;
+      } else if (strcmp(value, "bilinear") == 0) {
+        job.filter = LinearScaleKernelBilinear;
+      } else if (strcmp(value, "bicubic") == 0) {
+        job.filter = LinearScaleKernelBicubic;
+      } else if (strcmp(value, "lanczos3") == 0) {
+        job.filter = LinearScaleKernelLanczos3;
+      } else {
+        printf("unknown option -filter value \"%s\"\n", value);
+        return 1;
+      }
+    } else if (strcmp(arg, "-sheet") == 0) {
+      job.sheetCols = atoi(value);
+    } else if (strcmp(arg, "-threads") == 0) {
+      job.numThreads = atoi(value);
+    } else if (strcmp(arg, "-outdir") == 0) {
+      job.outDir = value;
+    } else {
+      printf("unknown option \"%s\"\n", arg);
+      usage();
+      return 1;
+    }
+  }
+
+  if (argi == argc) {
+    usage();
+    return 1;
+  }
+
+  job.clips = argv + argi;
+  job.numClips = argc - argi;
+
+  if (job.numThreads < 1) {
+    job.numThreads = 1;
+  }
+  if (job.numThreads > job.numClips) {
+    job.numThreads = job.numClips;
+  }
+
+  job.tables = (AlphaCompositorTables *) malloc(sizeof(AlphaCompositorTables));
+  ac_tables_init(job.tables);
+  ac_to_linear_init(job.layerToLinear, (job.gamma == BT709GammaLinear));
+  bt709_decode_alpha_table(job.alphaTable);
+
+  pthread_t *threads = (pthread_t *) malloc(job.numThreads * sizeof(pthread_t));
+
+  for (int i = 0; i < job.numThreads; i++) {
+    pthread_create(&threads[i], NULL, worker_main, &job);
+  }
+
+  for (int i = 0; i < job.numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  free(job.tables);
+
+  if (job.numFailed > 0) {
+    fprintf(stderr, "%d of %d clips failed\n", job.numFailed, job.numClips);
+    return 1;
+  }
+
+  return 0;
+}
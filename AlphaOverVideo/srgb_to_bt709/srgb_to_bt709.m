@@ -7,6 +7,9 @@
 //  or a series of images to a Y4M 4:2:0 video
 //  file encoded as BT.709 colorspace pixels.
 //  A y4m file can contain multiple video frames.
+//  When built with AOV_HAVE_X264 and the output
+//  is a .m4v file, frames are encoded with x264
+//  directly and no Y4M file is written.
 
 #import <Foundation/Foundation.h>
 
@@ -16,6 +19,30 @@
 #import "BT709.h"
 
 #import "y4m_writer.h"
+#import "ycbcr_encoder.h"
+#import "x264_backend.h"
+#import "encode_stats.h"
+#import "png_reader.h"
+#import "premultiply.h"
+#import "frame_cache.h"
+#import "frame_ring.h"
+#import "rendition_ladder.h"
+
+#include <fcntl.h>
+
+// Per stage timing, enabled with -stats 1
+
+static EncodeStats encodeStats;
+
+// Decode PNG files tagged as sRGB or linear sRGB without ImageIO,
+// disabled with -ingest imageio
+
+static BOOL fastPngIngest = TRUE;
+
+// Y4M output named "-" is written to this copy of stdout, stdout
+// itself is pointed at stderr so that messages do not mix with frames.
+
+static FILE *y4mOutStream = NULL;
 
 // Emit an array of float data as a CSV file, the
 // labels should be NSString, these define
@@ -71,16 +98,97 @@ BOOL writeTableToCSV(NSString *filename, NSArray* labelsArr, NSArray* valuesArr)
 }
 
 void usage() {
-  printf("srgb_to_bt709 ?OPTIONS? OUTPUT.y4m\n");
+  printf("srgb_to_bt709 ?OPTIONS? OUTPUT.y4m|OUTPUT.m4v\n");
   printf("OPTIONS:\n");
   printf("-alpha 0|1 (set to 1 to write as srgb alpha channel)\n");
   printf("-frame F.png (input is a single frame)\n");
   printf("-frames F0001.png (first frame of N input frames)\n");
   printf("-gamma apple|srgb|linear (default is apple)\n");
   printf("-fps 1|15|24|25|2997|30|60 (default to 30 with -frames)\n");
+  printf("-stats 0|1 (print per stage timing and memory use at exit)\n");
+  printf("-stats-json FILE (also write stats as JSON, implies -stats 1)\n");
+  printf("-ingest fast|imageio (PNG decoder, default is fast)\n");
+  printf("-cache DIR (reuse frames converted by earlier runs, stored in DIR)\n");
+  printf("-raw-frames PATH|- (read raw frames from a file, named pipe or stdin)\n");
+  printf("-raw-size WxH (dimensions of each raw frame)\n");
+  printf("-raw-format bgra|rgba (raw pixel layout with straight alpha, default is bgra)\n");
+  printf("-raw-colorspace srgb|linear (colorspace of raw frames, default is srgb)\n");
+  printf("-raw-buffers N (raw frames read ahead of conversion, default is 4)\n");
+  printf("-renditions WxH,WxH,... (write OUTPUT_WxH.y4m for each size, scaled in linear light)\n");
+  printf("OUTPUT - writes a .y4m stream to stdout\n");
+#if defined(AOV_HAVE_X264)
+  printf("-crf 0-51 (x264 quality for .m4v output, default is 23)\n");
+  printf("-profile baseline|main|high (default is main)\n");
+  printf("-preset PRESET (x264 preset, default is slow)\n");
+  printf("-tune TUNE (x264 tune, default is animation)\n");
+#endif // AOV_HAVE_X264
   fflush(stdout);
 }
 
+// Decode a PNG tagged as sRGB or linear sRGB directly into the premultiplied
+// BGRA layout of a 32 BPP CGFrameBuffer. The colorspace comes from the
+// PNG chunks, so rendering this image into a buffer with the same
+// colorspace is a copy. Returns NULL when the file should be read
+// with ImageIO, for example untagged, ICC tagged or grayscale images.
+
+static
+CGImageRef makeImageFromPngFile(NSString *filenameStr, size_t *numBytesReadPtr)
+{
+  PngMappedFile mapped;
+  
+  if (png_map_file([filenameStr fileSystemRepresentation], &mapped) != 0) {
+    return NULL;
+  }
+  
+  PngInfo info;
+  CGColorSpaceRef colorspace = NULL;
+  
+  if (png_read_info(mapped.data, mapped.len, &info) == 0 &&
+      png_info_is_supported(&info) &&
+      (info.colorType == 2 || info.colorType == 3 || info.colorType == 6)) {
+    if (info.colorspace == PngColorspaceSRGB) {
+      colorspace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    } else if (info.colorspace == PngColorspaceLinearSRGB) {
+      colorspace = CGColorSpaceCreateWithName(kCGColorSpaceLinearSRGB);
+    }
+  }
+  
+  if (colorspace == NULL) {
+    png_unmap_file(&mapped);
+    return NULL;
+  }
+  
+  CGFrameBuffer *frameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:info.width height:info.height];
+  
+  frameBuffer.colorspace = colorspace;
+  
+  CGColorSpaceRelease(colorspace);
+  
+  uint32_t *pixels = (uint32_t *) frameBuffer.pixels;
+  
+  PngOutput output;
+  memset(&output, 0, sizeof(output));
+  output.format = PngOutputBGRA;
+  output.pixels = pixels;
+  output.pixelsPerRow = info.width;
+  
+  int err = png_decode_buffer(mapped.data, mapped.len, &info, &output);
+  
+  *numBytesReadPtr = mapped.len;
+  png_unmap_file(&mapped);
+  
+  if (err != 0) {
+    // ImageIO reports the error
+    return NULL;
+  }
+  
+  if (info.hasAlpha) {
+    premultiply_row(pixels, pixels, info.width * info.height);
+  }
+  
+  return [frameBuffer createCGImageRef];
+}
+
 // Load PNG from the filesystem
 
 CGImageRef makeImageFromFile(NSString *filenameStr)
@@ -88,6 +196,19 @@ CGImageRef makeImageFromFile(NSString *filenameStr)
   CGImageSourceRef sourceRef;
   CGImageRef imageRef;
   
+  EncodeStatsMark mark;
+  encode_stats_begin(&encodeStats, &mark);
+  
+  if (fastPngIngest && [[[filenameStr pathExtension] lowercaseString] isEqualToString:@"png"]) {
+    size_t numBytesRead = 0;
+    imageRef = makeImageFromPngFile(filenameStr, &numBytesRead);
+    
+    if (imageRef != NULL) {
+      encode_stats_end(&encodeStats, EncodeStageDecode, &mark, numBytesRead, 0);
+      return imageRef;
+    }
+  }
+  
   NSData *image_data = [NSData dataWithContentsOfFile:filenameStr];
   if (image_data == nil) {
     fprintf(stderr, "can't read image data from file \"%s\"\n", [filenameStr UTF8String]);
@@ -107,10 +228,22 @@ CGImageRef makeImageFromFile(NSString *filenameStr)
   
   // Create an image from the first item in the image source.
   
-  imageRef = CGImageSourceCreateImageAtIndex(sourceRef, 0, NULL);
+  // Decoding is deferred until the first render unless the image is
+  // cached immediately, do that when stats are enabled so that decode
+  // time is not counted as render time.
+  
+  NSDictionary *options = nil;
+  
+  if (encodeStats.enabled) {
+    options = @{ (id)kCGImageSourceShouldCacheImmediately: @(TRUE) };
+  }
+  
+  imageRef = CGImageSourceCreateImageAtIndex(sourceRef, 0, (__bridge CFDictionaryRef)options);
   
   CFRelease(sourceRef);
   
+  encode_stats_end(&encodeStats, EncodeStageDecode, &mark, image_data.length, 0);
+  
   return imageRef;
 }
 
@@ -629,29 +762,21 @@ int parse_filenames_from_first_file(NSString *firstFilename,
   return 0;
 }
 
-// Read from source frame, convert to YCbCr and populate CoreVideo buffer
+// Convert a source image to YCbCr and populate CoreVideo buffer,
+// inImage is released before returning.
 
-static inline
-CVPixelBufferRef loadFrameIntoCVPixelBuffer(
-          NSString *inputImageStr,
-                                            int frameNum,
-                                            BOOL isLinearGamma,
-                                            BOOL isSRGBGamma,
-                                            BOOL isAlpha,
-                                            BOOL writeAlpha,
-                                            NSMutableData *Y,
-                                            NSMutableData *Cb,
-                                            NSMutableData *Cr)
+static
+CVPixelBufferRef convertImageIntoCVPixelBuffer(
+                                               CGImageRef inImage,
+                                               int frameNum,
+                                               BOOL isLinearGamma,
+                                               BOOL isSRGBGamma,
+                                               BOOL isAlpha,
+                                               BOOL writeAlpha,
+                                               NSMutableData *Y,
+                                               NSMutableData *Cb,
+                                               NSMutableData *Cr)
 {
-  if (1 || frameNum == 1) {
-    printf("loading %s\n", [inputImageStr UTF8String]);
-  }
-  
-  CGImageRef inImage = makeImageFromFile(inputImageStr);
-  if (inImage == NULL) {
-    return NULL;
-  }
-  
   int width = (int) CGImageGetWidth(inImage);
   int height = (int) CGImageGetHeight(inImage);
   
@@ -664,6 +789,7 @@ CVPixelBufferRef loadFrameIntoCVPixelBuffer(
   if (widthDiv2 && heightDiv2) {
   } else {
     printf("width and height must both be even but got dimensions %d x %d\n", width, height);
+    CGImageRelease(inImage);
     return NULL;
   }
   
@@ -766,6 +892,9 @@ CVPixelBufferRef loadFrameIntoCVPixelBuffer(
     }
   }
   
+  EncodeStatsMark mark;
+  encode_stats_begin(&encodeStats, &mark);
+  
   if (isAlpha && !writeAlpha) {
     // Previously, RGB values were being emitted as unpremultiplied
     // pixels but the compression and color reconstruction results
@@ -916,6 +1045,8 @@ CVPixelBufferRef loadFrameIntoCVPixelBuffer(
     // Treat input as Gamma = 1.0
     isLinearGamma = TRUE;
     isSRGBGamma = FALSE;
+    
+    encode_stats_end(&encodeStats, EncodeStageRender, &mark, 0, 0);
   } else if (isLinearGamma) {
     // Treat input image data as linear, grayscale input image data
     // must be tagged as sRGB with gamma = 1.0
@@ -943,6 +1074,8 @@ CVPixelBufferRef loadFrameIntoCVPixelBuffer(
     CGImageRelease(inImage);
     
     inImage = [linearFB createCGImageRef];
+    
+    encode_stats_end(&encodeStats, EncodeStageRender, &mark, 0, 0);
   } else if (isSRGBGamma) {
     // ffmpeg -i in.y4m -c:v libx264 -color_primaries bt709 -colorspace bt709 -color_trc iec61966_2_1 out.m4v
   }
@@ -953,10 +1086,15 @@ CVPixelBufferRef loadFrameIntoCVPixelBuffer(
   
   CVPixelBufferRef cvPixelBuffer = [BGRAToBT709Converter createYCbCrFromCGImage:inImage
                                                                        isLinear:isLinearGamma
-                                                                    asSRGBGamma:isSRGBGamma];
+                                                                    asSRGBGamma:isSRGBGamma
+                                                                          stats:&encodeStats];
+  
+  encode_stats_begin(&encodeStats, &mark);
   
   int dumpResult = dump_image_meta(inImage, cvPixelBuffer, Y, Cb, Cr);
   
+  encode_stats_end(&encodeStats, EncodeStageCopy, &mark, 0, 0);
+  
   CGImageRelease(inImage);
   
   if (dumpResult != 0) {
@@ -966,219 +1104,903 @@ CVPixelBufferRef loadFrameIntoCVPixelBuffer(
   return cvPixelBuffer;
 }
 
-int process(NSDictionary *inDict) {
-  // Read PNG
-  
-  NSString *inputImageStr = inDict[@"input"];
-  NSString *outY4mStr = inDict[@"output"];
-  NSString *gamma = inDict[@"-gamma"];
-  
-  BOOL isAlpha = [inDict[@"-alpha"] boolValue];
+// Read from source frame, convert to YCbCr and populate CoreVideo buffer
 
-  NSNumber *inputIsFramesPatternNum = inDict[@"inputIsFramesPattern"];
-  BOOL inputIsFramesPattern = [inputIsFramesPatternNum boolValue];
-  NSMutableArray *inputFramesFilenames = [NSMutableArray array];
+static inline
+CVPixelBufferRef loadFrameIntoCVPixelBuffer(
+          NSString *inputImageStr,
+                                            int frameNum,
+                                            BOOL isLinearGamma,
+                                            BOOL isSRGBGamma,
+                                            BOOL isAlpha,
+                                            BOOL writeAlpha,
+                                            NSMutableData *Y,
+                                            NSMutableData *Cb,
+                                            NSMutableData *Cr)
+{
+  if (1 || frameNum == 1) {
+    printf("loading %s\n", [inputImageStr UTF8String]);
+  }
   
-  if (inputIsFramesPattern) {
-    int result = parse_filenames_from_first_file(inputImageStr, inputFramesFilenames);
-    if (result != 0) {
-      return result;
-    }
-  } else {
-    [inputFramesFilenames addObject:inputImageStr];
+  CGImageRef inImage = makeImageFromFile(inputImageStr);
+  if (inImage == NULL) {
+    return NULL;
   }
   
-  NSNumber *fpsNum = inDict[@"-fps"];
-  Y4MHeaderFPS fps = [fpsNum intValue];
-  int frameNum = 1;
+  return convertImageIntoCVPixelBuffer(inImage, frameNum, isLinearGamma, isSRGBGamma, isAlpha, writeAlpha, Y, Cb, Cr);
+}
 
-  BOOL isLinearGamma = FALSE;
-  BOOL isSRGBGamma = FALSE;
-  BOOL hasWrittenHeader = FALSE;
-  
-  if ([gamma isEqualToString:@"linear"]) {
-    isLinearGamma = TRUE;
-  } else if ([gamma isEqualToString:@"srgb"]) {
-    isSRGBGamma = TRUE;
+// Create the encoder backend for the output path, .y4m files are written
+// directly and .m4v files are encoded with x264 when it is linked.
+
+static
+BOOL makeBackend(NSDictionary *inDict,
+                 const char *outFilename,
+                 YCbCrEncoderBackend *backend,
+                 YCbCrY4MBackendContext *y4mCtx
+#if defined(AOV_HAVE_X264)
+                 , YCbCrX264BackendContext *x264Ctx
+#endif // AOV_HAVE_X264
+                 )
+{
+  NSString *outStr = [NSString stringWithUTF8String:outFilename];
+
+  if ([outStr isEqualToString:@"-"]) {
+    ycbcr_y4m_backend_init_stream(backend, y4mCtx, y4mOutStream);
+    return TRUE;
+  }
+
+  if ([outStr hasSuffix:@".y4m"]) {
+    ycbcr_y4m_backend_init(backend, y4mCtx, outFilename);
+    return TRUE;
   }
+
+#if defined(AOV_HAVE_X264)
+  x264_backend_init(backend, x264Ctx, outFilename);
+  x264Ctx->crf = [inDict[@"-crf"] intValue];
+  x264Ctx->profile = [inDict[@"-profile"] UTF8String];
+  x264Ctx->preset = [inDict[@"-preset"] UTF8String];
+  x264Ctx->tune = [inDict[@"-tune"] UTF8String];
+  return TRUE;
+#else
+  fprintf(stderr, "srgb_to_bt709 was built without x264, can't write \"%s\"\n", outFilename);
+  return FALSE;
+#endif // AOV_HAVE_X264
+}
+
+// Load each input frame and pass the YCbCr planes to the encoder backend.
+// When asAlpha is TRUE the alpha channel values are encoded.
+
+static
+int encodeFrames(NSDictionary *inDict,
+                 NSArray *inputFramesFilenames,
+                 const char *outFilename,
+                 BT709Gamma outGamma,
+                 BOOL isLinearGamma,
+                 BOOL isSRGBGamma,
+                 BOOL isAlpha,
+                 BOOL asAlpha,
+                 int *frameNumPtr)
+{
+  NSNumber *fpsNum = inDict[@"-fps"];
+  Y4MHeaderFPS fps = [fpsNum intValue];
   
   NSMutableData *Y = [NSMutableData data];
   NSMutableData *Cb = [NSMutableData data];
   NSMutableData *Cr = [NSMutableData data];
   
-  // Process YCbCr by writing to output YUV frame(s) to y4m file
+  YCbCrEncoderBackend backend;
+  YCbCrY4MBackendContext y4mCtx;
+#if defined(AOV_HAVE_X264)
+  YCbCrX264BackendContext x264Ctx;
+#endif // AOV_HAVE_X264
   
-  const char *outFilename = NULL;
+  BOOL worked = makeBackend(inDict, outFilename, &backend, &y4mCtx
+#if defined(AOV_HAVE_X264)
+                            , &x264Ctx
+#endif // AOV_HAVE_X264
+                            );
   
-  if (FALSE && isAlpha) {
-    // When emitting Unpremultiplied RGB data, emit as "_rgb.y4m"
-    NSString *pathBeforeExt = [outY4mStr stringByDeletingPathExtension];
-    NSString *pathWithExt = [NSString stringWithFormat:@"%@_rgb.y4m", pathBeforeExt];
-    outFilename = [pathWithExt UTF8String];
-  } else {
-    outFilename = [outY4mStr UTF8String];
+  if (!worked) {
+    return 1;
   }
   
-  FILE *outFile = y4m_open_file(outFilename);
+  BOOL hasOpenedBackend = FALSE;
+  int result = 0;
   
-  if (outFile == NULL) {
-    return 1;
-  }
+  // Frames are keyed by input contents and every option that changes
+  // the output. A frame with the same key as the previous frame reuses
+  // the planes already in Y, Cb and Cr. With -cache DIR other frames
+  // are read from or written to the cache directory.
   
-  for (int i = 0; i < (int)[inputFramesFilenames count]; i++) @autoreleasepool {
-    inputImageStr = inputFramesFilenames[i];
-
-    CVPixelBufferRef cvPixelBuffer = loadFrameIntoCVPixelBuffer(inputImageStr, frameNum++, isLinearGamma, isSRGBGamma, isAlpha, FALSE, Y, Cb, Cr);
-    
-    if (cvPixelBuffer == NULL) {
-      return 1;
-    }
+  NSString *cacheDir = inDict[@"-cache"];
   
-    if (hasWrittenHeader == FALSE) {
-      Y4MHeaderStruct header;
-      
-      int width = (int) CVPixelBufferGetWidth(cvPixelBuffer);
-      int height = (int) CVPixelBufferGetHeight(cvPixelBuffer);
-      
-      header.width = width;
-      header.height = height;
-      
-      header.fps = fps;
-      
-      int header_result = y4m_write_header(outFile, &header);
-      if (header_result != 0) {
-        return header_result;
-      }
-      
-      hasWrittenHeader = TRUE;
-    }
-    
-    // Write frame data
+  NSString *settings = [NSString stringWithFormat:@"linear=%d srgb=%d alpha=%d asAlpha=%d ingest=%d",
+                        isLinearGamma, isSRGBGamma, isAlpha, asAlpha, fastPngIngest];
+  
+  FrameCacheStats cacheStats;
+  memset(&cacheStats, 0, sizeof(cacheStats));
+  
+  FrameCacheKey prevKey;
+  BOOL hasPrevKey = FALSE;
+  
+  int width = 0;
+  int height = 0;
+  
+  for (int i = 0; i < (int)[inputFramesFilenames count] && result == 0; i++) @autoreleasepool {
+    NSString *inputImageStr = inputFramesFilenames[i];
     
-    Y4MFrameStruct fs;
+    EncodeStatsMark mark;
+    encode_stats_begin(&encodeStats, &mark);
     
-    fs.yPtr = (uint8_t*) Y.bytes;
-    fs.yLen = (int) Y.length;
+    FrameCacheKey key;
+    BOOL hasKey = (frame_cache_key_for_file([inputImageStr fileSystemRepresentation], [settings UTF8String], &key) == 0);
     
-    fs.uPtr = (uint8_t*) Cb.bytes;
-    fs.uLen = (int) Cb.length;
+    BOOL isRepeat = (hasKey && hasPrevKey && frame_cache_key_equal(&key, &prevKey));
     
-    fs.vPtr = (uint8_t*) Cr.bytes;
-    fs.vLen = (int) Cr.length;
+    FrameCacheEntry entry;
+    BOOL isCached = (!isRepeat && hasKey && cacheDir != nil &&
+                     frame_cache_read_entry([cacheDir fileSystemRepresentation], &key, &entry) == 0);
     
-    int write_frame_result = y4m_write_frame(outFile, &fs);
-    if (write_frame_result != 0) {
-      return write_frame_result;
+    if (isCached) {
+      width = entry.width;
+      height = entry.height;
+      
+      [Y setLength:width * height];
+      [Cb setLength:(width / 2) * (height / 2)];
+      [Cr setLength:(width / 2) * (height / 2)];
+      
+      memcpy(Y.mutableBytes, entry.planes[0], Y.length);
+      memcpy(Cb.mutableBytes, entry.planes[1], Cb.length);
+      memcpy(Cr.mutableBytes, entry.planes[2], Cr.length);
+      
+      frame_cache_entry_free(&entry);
     }
     
-    CVPixelBufferRelease(cvPixelBuffer);
-  }
-  
-  fclose(outFile);
-  
-  fprintf(stdout, "wrote %s\n", outFilename);
-  
-  // When emitting alpha, iterate over the input again but emit the alpha
-  // channel values. The alpha channel values are always treated as linear.
-  
-  if (isAlpha) {
-    hasWrittenHeader = FALSE;
-    NSString *pathBeforeExt = [outY4mStr stringByDeletingPathExtension];
-    NSString *pathWithExt = [NSString stringWithFormat:@"%@_alpha.y4m", pathBeforeExt];
-    const char *outFilename = [pathWithExt UTF8String];
-    FILE *outFile = y4m_open_file(outFilename);
-    
-    if (outFile == NULL) {
-      return 1;
-    }
+    encode_stats_end(&encodeStats, EncodeStageCache, &mark, 0, 0);
     
-    for (int i = 0; i < (int)[inputFramesFilenames count]; i++) @autoreleasepool {
-      inputImageStr = inputFramesFilenames[i];
-      
-      CVPixelBufferRef cvPixelBuffer = loadFrameIntoCVPixelBuffer(inputImageStr, frameNum++, isLinearGamma, isSRGBGamma, isAlpha, TRUE, Y, Cb, Cr);
+    if (isRepeat) {
+      printf("repeat %s\n", [inputImageStr UTF8String]);
+      (*frameNumPtr)++;
+      cacheStats.numRepeatHits += 1;
+    } else if (isCached) {
+      printf("cached %s\n", [inputImageStr UTF8String]);
+      (*frameNumPtr)++;
+      cacheStats.numStoreHits += 1;
+    } else {
+      CVPixelBufferRef cvPixelBuffer = loadFrameIntoCVPixelBuffer(inputImageStr, (*frameNumPtr)++, isLinearGamma, isSRGBGamma, isAlpha, asAlpha, Y, Cb, Cr);
       
       if (cvPixelBuffer == NULL) {
-        return 1;
+        result = 1;
+        break;
       }
       
-      if (hasWrittenHeader == FALSE) {
-        Y4MHeaderStruct header;
-        
-        int width = (int) CVPixelBufferGetWidth(cvPixelBuffer);
-        int height = (int) CVPixelBufferGetHeight(cvPixelBuffer);
+      width = (int) CVPixelBufferGetWidth(cvPixelBuffer);
+      height = (int) CVPixelBufferGetHeight(cvPixelBuffer);
+      
+      CVPixelBufferRelease(cvPixelBuffer);
+      
+      cacheStats.numMisses += 1;
+      
+      if (hasKey && cacheDir != nil) {
+        // A failed write only means the frame is converted again next time
         
-        header.width = width;
-        header.height = height;
+        encode_stats_begin(&encodeStats, &mark);
         
-        header.fps = fps;
+        uint64_t numBytesStored = cacheStats.numBytesStored;
         
-        int header_result = y4m_write_header(outFile, &header);
-        if (header_result != 0) {
-          return header_result;
-        }
+        frame_cache_write_entry([cacheDir fileSystemRepresentation], &key, width, height,
+                                (const uint8_t *) Y.bytes, (const uint8_t *) Cb.bytes, (const uint8_t *) Cr.bytes,
+                                &cacheStats);
         
-        hasWrittenHeader = TRUE;
+        encode_stats_end(&encodeStats, EncodeStageCache, &mark, 0, cacheStats.numBytesStored - numBytesStored);
       }
+    }
+    
+    if (hasKey) {
+      prevKey = key;
+    }
+    hasPrevKey = hasKey;
+    
+    if (hasOpenedBackend == FALSE) {
+      YCbCrEncoderConfig config;
       
-      // Write frame data
-      
-      Y4MFrameStruct fs;
-      
-      fs.yPtr = (uint8_t*) Y.bytes;
-      fs.yLen = (int) Y.length;
-      
-      fs.uPtr = (uint8_t*) Cb.bytes;
-      fs.uLen = (int) Cb.length;
+      config.width = width;
+      config.height = height;
+      config.fps = fps;
+      config.gamma = outGamma;
       
-      fs.vPtr = (uint8_t*) Cr.bytes;
-      fs.vLen = (int) Cr.length;
+      hasOpenedBackend = TRUE;
       
-      int write_frame_result = y4m_write_frame(outFile, &fs);
-      if (write_frame_result != 0) {
-        return write_frame_result;
+      result = backend.open(backend.ctx, &config);
+      if (result != 0) {
+        break;
       }
-      
-      CVPixelBufferRelease(cvPixelBuffer);
     }
-
-    fclose(outFile);
     
+    // Write frame data, planes are packed
+    
+    YCbCrEncoderFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    
+    frame.yPtr = (const uint8_t *) Y.bytes;
+    frame.yBytesPerRow = width;
+    
+    frame.cbPtr = (const uint8_t *) Cb.bytes;
+    frame.crPtr = (const uint8_t *) Cr.bytes;
+    frame.chromaBytesPerRow = width / 2;
+    
+    encode_stats_begin(&encodeStats, &mark);
+    
+    result = backend.write_frame(backend.ctx, &frame);
+    
+    encode_stats_end(&encodeStats, EncodeStageWrite, &mark, 0, 0);
+  }
+  
+  if (hasOpenedBackend) {
+    int closeResult = backend.close(backend.ctx);
+    if (result == 0) {
+      result = closeResult;
+    }
+  }
+  
+  // Count the size of the output file once it has been closed,
+  // for .m4v output this is the compressed size.
+  
+  if (result == 0 && encodeStats.enabled && strcmp(outFilename, "-") != 0) {
+    NSDictionary *attrs = [[NSFileManager defaultManager] attributesOfItemAtPath:[NSString stringWithUTF8String:outFilename] error:nil];
+    encode_stats_add_bytes_written(&encodeStats, EncodeStageWrite, [attrs fileSize]);
+  }
+  
+  if (result == 0) {
     fprintf(stdout, "wrote %s\n", outFilename);
   }
   
-  return 0;
+  if (cacheDir != nil || cacheStats.numRepeatHits > 0) {
+    frame_cache_print_stats(&cacheStats, stdout);
+  }
+  
+  return result;
 }
 
-int main(int argc, const char * argv[]) {
-  int retcode = 0;
+// Raw frames are read on their own thread into a bounded ring of frame
+// buffers. Once every buffer is full the reader stops reading, so the
+// process writing into the pipe blocks until a frame has been converted.
+
+typedef struct {
+  FrameRing ring;
+  int fd;
+  size_t frameNumBytes;
+  int result;
+} RawFrameReader;
+
+static
+void* rawFrameReaderMain(void *arg)
+{
+  RawFrameReader *reader = (RawFrameReader *) arg;
+  reader->result = frame_ring_fill_from_fd(&reader->ring, reader->fd, reader->frameNumBytes);
+  return NULL;
+}
+
+// Copy a raw BGRA or RGBA frame with straight alpha into the premultiplied
+// BGRA layout of a 32 BPP CGFrameBuffer in the declared colorspace.
+
+static
+CGImageRef makeImageFromRawFrame(const uint8_t *rawPixels, int width, int height, BOOL isRGBA, CGColorSpaceRef colorspace)
+{
+  CGFrameBuffer *frameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
   
-  @autoreleasepool {
-    char *inPNG = NULL;
-    BOOL inPNGIsFramesPattern = FALSE;
-    char *outY4m = NULL;
+  frameBuffer.colorspace = colorspace;
+  
+  const int numPixels = width * height;
+  const uint32_t *inPixels = (const uint32_t *) rawPixels;
+  uint32_t *outPixels = (uint32_t *) frameBuffer.pixels;
+  
+  if (isRGBA) {
+    // Swap R and B in place of a copy
     
-    if (argc < 3) {
-      usage();
-      exit(1);
+    for (int i = 0; i < numPixels; i++) {
+      uint32_t pixel = inPixels[i];
+      outPixels[i] = (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16);
     }
     
-    // Process command line argument(s)
-    //
-    // -option ARG
-    //
-    // Followed by OUTPUT.y4m
-    
-    NSMutableDictionary *args = [NSMutableDictionary dictionary];
-    
-    // Defaults
-    
-    args[@"-gamma"] = @"apple";
-    
-    args[@"-alpha"] = @FALSE;
+    premultiply_row(outPixels, outPixels, numPixels);
+  } else {
+    premultiply_row(inPixels, outPixels, numPixels);
+  }
+  
+  return [frameBuffer createCGImageRef];
+}
+
+// Read raw frames from a file, named pipe or stdin and pass the YCbCr
+// planes to the encoder backend. A pipe can't be read twice, so with
+// -alpha 1 each frame is converted twice and written to both the RGB
+// and the _alpha backends.
+
+static
+int encodeRawFrames(NSDictionary *inDict,
+                    const char *outFilename,
+                    const char *outAlphaFilename,
+                    BT709Gamma outGamma,
+                    BOOL isLinearGamma,
+                    BOOL isSRGBGamma,
+                    BOOL isAlpha)
+{
+  NSString *rawPath = inDict[@"-raw-frames"];
+  const int width = [inDict[@"-raw-width"] intValue];
+  const int height = [inDict[@"-raw-height"] intValue];
+  const int numBuffers = [inDict[@"-raw-buffers"] intValue];
+  BOOL isRGBA = [inDict[@"-raw-format"] isEqualToString:@"rgba"];
+  BOOL isLinearInput = [inDict[@"-raw-colorspace"] isEqualToString:@"linear"];
+  
+  NSNumber *fpsNum = inDict[@"-fps"];
+  Y4MHeaderFPS fps = [fpsNum intValue];
+  
+  const size_t frameNumBytes = (size_t) width * height * sizeof(uint32_t);
+  
+  const int numOutputs = isAlpha ? 2 : 1;
+  const char *outFilenames[2] = { outFilename, outAlphaFilename };
+  
+  YCbCrEncoderBackend backends[2];
+  YCbCrY4MBackendContext y4mCtxs[2];
+#if defined(AOV_HAVE_X264)
+  YCbCrX264BackendContext x264Ctxs[2];
+#endif // AOV_HAVE_X264
+  
+  for (int i = 0; i < numOutputs; i++) {
+    BOOL worked = makeBackend(inDict, outFilenames[i], &backends[i], &y4mCtxs[i]
+#if defined(AOV_HAVE_X264)
+                              , &x264Ctxs[i]
+#endif // AOV_HAVE_X264
+                              );
     
-    args[@"-fps"] = @(Y4MHeaderFPS_30);
+    if (!worked) {
+      return 1;
+    }
+  }
+  
+  int fd = STDIN_FILENO;
+  
+  if (![rawPath isEqualToString:@"-"]) {
+    fd = open([rawPath fileSystemRepresentation], O_RDONLY);
     
-    for (int i = 1; i < argc; ) {
+    if (fd < 0) {
+      fprintf(stderr, "can't open raw frames \"%s\"\n", [rawPath UTF8String]);
+      return 1;
+    }
+  }
+  
+  // The reader is heap allocated since it is left running after an error
+  
+  RawFrameReader *reader = (RawFrameReader *) malloc(sizeof(RawFrameReader));
+  
+  if (reader == NULL || frame_ring_init(&reader->ring, numBuffers, frameNumBytes) != 0) {
+    fprintf(stderr, "can't allocate %d raw frame buffers of %d x %d\n", numBuffers, width, height);
+    free(reader);
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    return 1;
+  }
+  
+  reader->fd = fd;
+  reader->frameNumBytes = frameNumBytes;
+  reader->result = 0;
+  
+  int result = 0;
+  int numOpened = 0;
+  
+  // Dimensions are known up front, so the outputs are opened before any
+  // input is read and a downstream encoder gets the stream header at once.
+  
+  for (int i = 0; i < numOutputs && result == 0; i++) {
+    YCbCrEncoderConfig config;
+    
+    config.width = width;
+    config.height = height;
+    config.fps = fps;
+    config.gamma = (i == 0) ? outGamma : BT709GammaLinear;
+    
+    result = backends[i].open(backends[i].ctx, &config);
+    numOpened += 1;
+  }
+  
+  CGColorSpaceRef colorspace = CGColorSpaceCreateWithName(isLinearInput ? kCGColorSpaceLinearSRGB : kCGColorSpaceSRGB);
+  
+  NSMutableData *Y = [NSMutableData data];
+  NSMutableData *Cb = [NSMutableData data];
+  NSMutableData *Cr = [NSMutableData data];
+  
+  const uint64_t startNanos = frame_ring_now_nanos();
+  
+  pthread_t readerThread;
+  BOOL hasReaderThread = FALSE;
+  
+  if (result == 0) {
+    if (pthread_create(&readerThread, NULL, rawFrameReaderMain, reader) != 0) {
+      fprintf(stderr, "can't start raw frame reader thread\n");
+      result = 1;
+    } else {
+      hasReaderThread = TRUE;
+    }
+  }
+  
+  int frameNum = 1;
+  int numFrames = 0;
+  
+  while (result == 0) @autoreleasepool {
+    const uint8_t *rawPixels = frame_ring_acquire_read(&reader->ring);
+    
+    if (rawPixels == NULL) {
+      break;
+    }
+    
+    EncodeStatsMark mark;
+    encode_stats_begin(&encodeStats, &mark);
+    
+    CGImageRef inImage = makeImageFromRawFrame(rawPixels, width, height, isRGBA, colorspace);
+    
+    encode_stats_end(&encodeStats, EncodeStageDecode, &mark, frameNumBytes, 0);
+    
+    frame_ring_release_read(&reader->ring);
+    
+    for (int i = 0; i < numOutputs && result == 0; i++) {
+      // Conversion releases the image, hold a reference for each output
+      
+      CGImageRetain(inImage);
+      
+      CVPixelBufferRef cvPixelBuffer = convertImageIntoCVPixelBuffer(inImage, frameNum++, isLinearGamma, isSRGBGamma, isAlpha, (i == 1), Y, Cb, Cr);
+      
+      if (cvPixelBuffer == NULL) {
+        result = 1;
+        break;
+      }
+      
+      CVPixelBufferRelease(cvPixelBuffer);
+      
+      YCbCrEncoderFrame frame;
+      memset(&frame, 0, sizeof(frame));
+      
+      frame.yPtr = (const uint8_t *) Y.bytes;
+      frame.yBytesPerRow = width;
+      
+      frame.cbPtr = (const uint8_t *) Cb.bytes;
+      frame.crPtr = (const uint8_t *) Cr.bytes;
+      frame.chromaBytesPerRow = width / 2;
+      
+      encode_stats_begin(&encodeStats, &mark);
+      
+      result = backends[i].write_frame(backends[i].ctx, &frame);
+      
+      encode_stats_end(&encodeStats, EncodeStageWrite, &mark, 0, 0);
+    }
+    
+    CGImageRelease(inImage);
+    
+    numFrames += 1;
+  }
+  
+  BOOL hasJoinedReader = FALSE;
+  
+  if (hasReaderThread && result != 0) {
+    // The reader may be blocked in read() until more input arrives,
+    // stop it at the next frame but do not wait for it.
+    
+    frame_ring_abort(&reader->ring);
+    pthread_detach(readerThread);
+  } else if (hasReaderThread) {
+    pthread_join(readerThread, NULL);
+    hasJoinedReader = TRUE;
+    
+    if (reader->result != 0) {
+      fprintf(stderr, "raw frames input ended with a partial frame or a read error\n");
+      result = 1;
+    } else if (numFrames == 0) {
+      fprintf(stderr, "no raw frames were read\n");
+      result = 1;
+    }
+  }
+  
+  for (int i = 0; i < numOpened; i++) {
+    int closeResult = backends[i].close(backends[i].ctx);
+    if (result == 0) {
+      result = closeResult;
+    }
+  }
+  
+  // Throughput covers reading, conversion and writing of every frame
+  
+  const uint64_t wallNanos = frame_ring_now_nanos() - startNanos;
+  
+  CGColorSpaceRelease(colorspace);
+  
+  for (int i = 0; i < numOutputs && result == 0; i++) {
+    if (strcmp(outFilenames[i], "-") == 0) {
+      continue;
+    }
+    
+    if (encodeStats.enabled) {
+      NSDictionary *attrs = [[NSFileManager defaultManager] attributesOfItemAtPath:[NSString stringWithUTF8String:outFilenames[i]] error:nil];
+      encode_stats_add_bytes_written(&encodeStats, EncodeStageWrite, [attrs fileSize]);
+    }
+    
+    fprintf(stdout, "wrote %s\n", outFilenames[i]);
+  }
+  
+  if (hasJoinedReader || !hasReaderThread) {
+    if (hasJoinedReader) {
+      frame_ring_print_stats(&reader->ring, frameNumBytes, wallNanos, stdout);
+    }
+    
+    frame_ring_free(&reader->ring);
+    free(reader);
+    
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+  }
+  
+  return result;
+}
+
+// Output path for one rendition, OUT.y4m -> OUT_WxH.y4m or OUT_WxH_alpha.y4m
+
+static
+NSString* renditionOutputPath(NSString *outPath, RenditionSize size, BOOL isAlphaOutput)
+{
+  NSString *pathBeforeExt = [outPath stringByDeletingPathExtension];
+  return [NSString stringWithFormat:@"%@_%dx%d%@.%@", pathBeforeExt, size.width, size.height, isAlphaOutput ? @"_alpha" : @"", [outPath pathExtension]];
+}
+
+// Decode each input frame once and write every size in the rendition
+// ladder. With -alpha 1 each rendition has an RGB and an _alpha output,
+// all outputs are written in a single pass over the input frames.
+
+static
+int encodeRenditionFrames(NSDictionary *inDict,
+                          NSArray *inputFramesFilenames,
+                          NSString *outPath,
+                          const RenditionSize *sizes,
+                          int numSizes,
+                          BT709Gamma outGamma,
+                          BOOL isLinearGamma,
+                          BOOL isSRGBGamma,
+                          BOOL isAlpha)
+{
+  NSNumber *fpsNum = inDict[@"-fps"];
+  Y4MHeaderFPS fps = [fpsNum intValue];
+  
+  const int numPerRendition = isAlpha ? 2 : 1;
+  const int numOutputs = numSizes * numPerRendition;
+  
+  const char *outFilenames[RL_MAX_RENDITIONS * 2];
+  YCbCrEncoderBackend backends[RL_MAX_RENDITIONS * 2];
+  YCbCrY4MBackendContext y4mCtxs[RL_MAX_RENDITIONS * 2];
+#if defined(AOV_HAVE_X264)
+  YCbCrX264BackendContext x264Ctxs[RL_MAX_RENDITIONS * 2];
+#endif // AOV_HAVE_X264
+  
+  for (int i = 0; i < numOutputs; i++) {
+    NSString *path = renditionOutputPath(outPath, sizes[i / numPerRendition], (i % numPerRendition) == 1);
+    outFilenames[i] = [path UTF8String];
+    
+    BOOL worked = makeBackend(inDict, outFilenames[i], &backends[i], &y4mCtxs[i]
+#if defined(AOV_HAVE_X264)
+                              , &x264Ctxs[i]
+#endif // AOV_HAVE_X264
+                              );
+    
+    if (!worked) {
+      return 1;
+    }
+  }
+  
+  NSMutableData *Y = [NSMutableData data];
+  NSMutableData *Cb = [NSMutableData data];
+  NSMutableData *Cr = [NSMutableData data];
+  
+  RenditionLadder ladder;
+  RenditionLadder *ladderPtr = &ladder;
+  BOOL hasLadder = FALSE;
+  int numOpened = 0;
+  
+  int srcWidth = 0;
+  int srcHeight = 0;
+  
+  int result = 0;
+  int frameNum = 1;
+  
+  for (int i = 0; i < (int)[inputFramesFilenames count] && result == 0; i++) @autoreleasepool {
+    NSString *inputImageStr = inputFramesFilenames[i];
+    
+    printf("loading %s\n", [inputImageStr UTF8String]);
+    
+    CGImageRef inImage = makeImageFromFile(inputImageStr);
+    if (inImage == NULL) {
+      result = 1;
+      break;
+    }
+    
+    const int width = (int) CGImageGetWidth(inImage);
+    const int height = (int) CGImageGetHeight(inImage);
+    
+    // Frames in sRGB or linear sRGB are scaled as is, frames in
+    // any other colorspace are rendered into sRGB first.
+    
+    CGColorSpaceRef inputColorspace = CGImageGetColorSpace(inImage);
+    NSString *inputColorspaceName = (__bridge_transfer NSString*) CGColorSpaceCopyName(inputColorspace);
+    
+    BOOL isLinearSource = isLinearGamma || [inputColorspaceName isEqualToString:(__bridge NSString*)kCGColorSpaceLinearSRGB];
+    BOOL isSRGBSource = [inputColorspaceName isEqualToString:(__bridge NSString*)kCGColorSpaceSRGB];
+    
+    EncodeStatsMark mark;
+    encode_stats_begin(&encodeStats, &mark);
+    
+    CGFrameBuffer *srcFB = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
+    
+    if (isLinearSource || isSRGBSource) {
+      srcFB.colorspace = inputColorspace;
+    } else {
+      CGColorSpaceRef colorspace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+      srcFB.colorspace = colorspace;
+      CGColorSpaceRelease(colorspace);
+    }
+    
+    BOOL worked = [srcFB renderCGImage:inImage];
+    assert(worked);
+    
+    CGImageRelease(inImage);
+    
+    encode_stats_end(&encodeStats, EncodeStageRender, &mark, 0, 0);
+    
+    if (hasLadder == FALSE) {
+      int err = rendition_ladder_init(&ladder, isLinearSource, width, height, sizes, numSizes);
+      
+      if (err == RL_ERR_SIZE) {
+        fprintf(stderr, "each rendition must have an even width and height no larger than the %d x %d input\n", width, height);
+        result = 1;
+        break;
+      } else if (err != 0) {
+        fprintf(stderr, "can't allocate rendition ladder for %d x %d input\n", width, height);
+        result = 1;
+        break;
+      }
+      
+      hasLadder = TRUE;
+      srcWidth = width;
+      srcHeight = height;
+      
+      for (int j = 0; j < numOutputs && result == 0; j++) {
+        YCbCrEncoderConfig config;
+        
+        config.width = sizes[j / numPerRendition].width;
+        config.height = sizes[j / numPerRendition].height;
+        config.fps = fps;
+        config.gamma = ((j % numPerRendition) == 1) ? BT709GammaLinear : outGamma;
+        
+        result = backends[j].open(backends[j].ctx, &config);
+        numOpened += 1;
+      }
+      
+      if (result != 0) {
+        break;
+      }
+    } else if (width != srcWidth || height != srcHeight) {
+      fprintf(stderr, "input frame %s is %d x %d but the first frame is %d x %d\n", [inputImageStr UTF8String], width, height, srcWidth, srcHeight);
+      result = 1;
+      break;
+    }
+    
+    // Renditions are independent once the pyramid is built
+    
+    encode_stats_begin(&encodeStats, &mark);
+    
+    rendition_ladder_set_source(&ladder, (const uint32_t *) srcFB.pixels, width);
+    
+    NSMutableArray *renditionFBs = [NSMutableArray array];
+    uint32_t *renditionPixels[RL_MAX_RENDITIONS];
+    uint32_t **renditionPixelsPtr = renditionPixels;
+    
+    for (int r = 0; r < numSizes; r++) {
+      CGFrameBuffer *fb = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:sizes[r].width height:sizes[r].height];
+      fb.colorspace = srcFB.colorspace;
+      [renditionFBs addObject:fb];
+      renditionPixels[r] = (uint32_t *) fb.pixels;
+    }
+    
+    dispatch_apply(numSizes, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t r) {
+      rendition_ladder_render(ladderPtr, (int) r, renditionPixelsPtr[r], sizes[r].width);
+    });
+    
+    encode_stats_end(&encodeStats, EncodeStageScale, &mark, 0, 0);
+    
+    for (int j = 0; j < numOutputs && result == 0; j++) {
+      const int r = j / numPerRendition;
+      
+      CGFrameBuffer *fb = renditionFBs[r];
+      CGImageRef renditionImage = [fb createCGImageRef];
+      
+      CVPixelBufferRef cvPixelBuffer = convertImageIntoCVPixelBuffer(renditionImage, frameNum++, isLinearGamma, isSRGBGamma, isAlpha, ((j % numPerRendition) == 1), Y, Cb, Cr);
+      
+      if (cvPixelBuffer == NULL) {
+        result = 1;
+        break;
+      }
+      
+      CVPixelBufferRelease(cvPixelBuffer);
+      
+      YCbCrEncoderFrame frame;
+      memset(&frame, 0, sizeof(frame));
+      
+      frame.yPtr = (const uint8_t *) Y.bytes;
+      frame.yBytesPerRow = sizes[r].width;
+      
+      frame.cbPtr = (const uint8_t *) Cb.bytes;
+      frame.crPtr = (const uint8_t *) Cr.bytes;
+      frame.chromaBytesPerRow = sizes[r].width / 2;
+      
+      encode_stats_begin(&encodeStats, &mark);
+      
+      result = backends[j].write_frame(backends[j].ctx, &frame);
+      
+      encode_stats_end(&encodeStats, EncodeStageWrite, &mark, 0, 0);
+    }
+  }
+  
+  for (int j = 0; j < numOpened; j++) {
+    int closeResult = backends[j].close(backends[j].ctx);
+    if (result == 0) {
+      result = closeResult;
+    }
+  }
+  
+  if (hasLadder) {
+    rendition_ladder_free(&ladder);
+  }
+  
+  for (int j = 0; j < numOutputs && result == 0; j++) {
+    if (encodeStats.enabled) {
+      NSDictionary *attrs = [[NSFileManager defaultManager] attributesOfItemAtPath:[NSString stringWithUTF8String:outFilenames[j]] error:nil];
+      encode_stats_add_bytes_written(&encodeStats, EncodeStageWrite, [attrs fileSize]);
+    }
+    
+    fprintf(stdout, "wrote %s\n", outFilenames[j]);
+  }
+  
+  return result;
+}
+
+int process(NSDictionary *inDict) {
+  // Read PNG
+  
+  NSString *inputImageStr = inDict[@"input"];
+  NSString *outY4mStr = inDict[@"output"];
+  NSString *gamma = inDict[@"-gamma"];
+  
+  BOOL isAlpha = [inDict[@"-alpha"] boolValue];
+  BOOL isRawFrames = (inDict[@"-raw-frames"] != nil);
+
+  NSNumber *inputIsFramesPatternNum = inDict[@"inputIsFramesPattern"];
+  BOOL inputIsFramesPattern = [inputIsFramesPatternNum boolValue];
+  NSMutableArray *inputFramesFilenames = [NSMutableArray array];
+  
+  if (isRawFrames) {
+    // Frames are read from the raw input as they are converted
+  } else if (inputIsFramesPattern) {
+    int result = parse_filenames_from_first_file(inputImageStr, inputFramesFilenames);
+    if (result != 0) {
+      return result;
+    }
+  } else {
+    [inputFramesFilenames addObject:inputImageStr];
+  }
+  
+  int frameNum = 1;
+
+  BOOL isLinearGamma = FALSE;
+  BOOL isSRGBGamma = FALSE;
+  BT709Gamma outGamma = BT709GammaApple;
+  
+  if ([gamma isEqualToString:@"linear"]) {
+    isLinearGamma = TRUE;
+    outGamma = BT709GammaLinear;
+  } else if ([gamma isEqualToString:@"srgb"]) {
+    isSRGBGamma = TRUE;
+    outGamma = BT709GammaSrgb;
+  }
+  
+  // Process YCbCr by writing output YUV frame(s) to the y4m or m4v file
+  
+  const char *outFilename = [outY4mStr UTF8String];
+  
+  NSArray *renditions = inDict[@"-renditions"];
+  
+  if (renditions != nil) {
+    RenditionSize sizes[RL_MAX_RENDITIONS];
+    
+    for (int i = 0; i < (int) renditions.count; i++) {
+      sizes[i].width = [renditions[i][0] intValue];
+      sizes[i].height = [renditions[i][1] intValue];
+    }
+    
+    return encodeRenditionFrames(inDict, inputFramesFilenames, outY4mStr, sizes, (int) renditions.count, outGamma, isLinearGamma, isSRGBGamma, isAlpha);
+  }
+  
+  if (isRawFrames) {
+    NSString *pathBeforeExt = [outY4mStr stringByDeletingPathExtension];
+    NSString *pathWithExt = [NSString stringWithFormat:@"%@_alpha.%@", pathBeforeExt, [outY4mStr pathExtension]];
+    
+    return encodeRawFrames(inDict, outFilename, [pathWithExt UTF8String], outGamma, isLinearGamma, isSRGBGamma, isAlpha);
+  }
+  
+  int result = encodeFrames(inDict, inputFramesFilenames, outFilename, outGamma, isLinearGamma, isSRGBGamma, isAlpha, FALSE, &frameNum);
+  
+  if (result != 0) {
+    return result;
+  }
+  
+  // When emitting alpha, iterate over the input again but emit the alpha
+  // channel values. The alpha channel values are always treated as linear.
+  
+  if (isAlpha) {
+    NSString *pathBeforeExt = [outY4mStr stringByDeletingPathExtension];
+    NSString *pathWithExt = [NSString stringWithFormat:@"%@_alpha.%@", pathBeforeExt, [outY4mStr pathExtension]];
+    const char *outAlphaFilename = [pathWithExt UTF8String];
+    
+    result = encodeFrames(inDict, inputFramesFilenames, outAlphaFilename, BT709GammaLinear, isLinearGamma, isSRGBGamma, isAlpha, TRUE, &frameNum);
+  }
+  
+  return result;
+}
+
+int main(int argc, const char * argv[]) {
+  int retcode = 0;
+  
+  @autoreleasepool {
+    char *inPNG = NULL;
+    BOOL inPNGIsFramesPattern = FALSE;
+    char *outY4m = NULL;
+    
+    if (argc < 3) {
+      usage();
+      exit(1);
+    }
+    
+    // Process command line argument(s)
+    //
+    // -option ARG
+    //
+    // Followed by OUTPUT.y4m
+    
+    NSMutableDictionary *args = [NSMutableDictionary dictionary];
+    
+    // Defaults
+    
+    args[@"-gamma"] = @"apple";
+    
+    args[@"-alpha"] = @FALSE;
+    
+    args[@"-fps"] = @(Y4MHeaderFPS_30);
+    
+    // Same defaults as FFMPEG/ext_ffmpeg_encode_*_crf.sh
+    
+    args[@"-crf"] = @(23);
+    
+    args[@"-profile"] = @"main";
+    
+    args[@"-preset"] = @"slow";
+    
+    args[@"-tune"] = @"animation";
+    
+    args[@"-stats"] = @FALSE;
+    
+    args[@"-raw-format"] = @"bgra";
+    
+    args[@"-raw-colorspace"] = @"srgb";
+    
+    args[@"-raw-buffers"] = @(4);
+    
+    for (int i = 1; i < argc; ) {
       char *arg = (char *) argv[i];
       
       //printf("process option \"%s\"\n", arg);
@@ -1241,6 +2063,174 @@ int main(int argc, const char * argv[]) {
             printf("option -fps unknown value \"%s\"\n", arg);
             exit(3);
           }
+        } else if (strcmp(arg, "-crf") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          int crf = atoi(arg);
+          
+          if (crf < 0 || crf > 51 || (crf == 0 && strcmp(arg, "0") != 0)) {
+            printf("option -crf value \"%s\" must be in range 0 to 51\n", arg);
+            exit(3);
+          }
+          
+          args[@"-crf"] = @(crf);
+        } else if (strcmp(arg, "-profile") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          if (strcmp(arg, "baseline") == 0 || strcmp(arg, "main") == 0 || strcmp(arg, "high") == 0) {
+            args[@"-profile"] = [NSString stringWithUTF8String:arg];
+          } else {
+            printf("option -profile unknown value \"%s\"\n", arg);
+            exit(3);
+          }
+        } else if (strcmp(arg, "-preset") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          args[@"-preset"] = [NSString stringWithUTF8String:arg];
+        } else if (strcmp(arg, "-tune") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          args[@"-tune"] = [NSString stringWithUTF8String:arg];
+        } else if (strcmp(arg, "-stats") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          if (strcmp(arg, "1") == 0) {
+            args[@"-stats"] = @TRUE;
+          } else if (strcmp(arg, "0") == 0) {
+            args[@"-stats"] = @FALSE;
+          } else {
+            printf("unknown option -stats value \"%s\", must be 0 or 1\n", arg);
+            exit(3);
+          }
+        } else if (strcmp(arg, "-stats-json") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          args[@"-stats-json"] = [NSString stringWithUTF8String:arg];
+          args[@"-stats"] = @TRUE;
+        } else if (strcmp(arg, "-cache") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          NSString *cacheDir = [NSString stringWithUTF8String:arg];
+          
+          if ([[NSFileManager defaultManager] createDirectoryAtPath:cacheDir withIntermediateDirectories:TRUE attributes:nil error:nil] == FALSE) {
+            printf("can't create cache directory \"%s\"\n", arg);
+            exit(3);
+          }
+          
+          args[@"-cache"] = cacheDir;
+        } else if (strcmp(arg, "-ingest") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          if (strcmp(arg, "fast") == 0) {
+            fastPngIngest = TRUE;
+          } else if (strcmp(arg, "imageio") == 0) {
+            fastPngIngest = FALSE;
+          } else {
+            printf("unknown option -ingest value \"%s\", must be fast or imageio\n", arg);
+            exit(3);
+          }
+        } else if (strcmp(arg, "-raw-frames") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          if (args[@"-raw-frames"] != nil) {
+            printf("-raw-frames path \"%s\" must appear just once\n", arg);
+            exit(3);
+          }
+          
+          args[@"-raw-frames"] = [NSString stringWithUTF8String:arg];
+        } else if (strcmp(arg, "-raw-size") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          int width = 0;
+          int height = 0;
+          
+          if (sscanf(arg, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0 || (width % 2) != 0 || (height % 2) != 0) {
+            printf("option -raw-size value \"%s\" must be WxH with even width and height\n", arg);
+            exit(3);
+          }
+          
+          args[@"-raw-width"] = @(width);
+          args[@"-raw-height"] = @(height);
+        } else if (strcmp(arg, "-raw-format") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          if (strcmp(arg, "bgra") == 0 || strcmp(arg, "rgba") == 0) {
+            args[@"-raw-format"] = [NSString stringWithUTF8String:arg];
+          } else {
+            printf("unknown option -raw-format value \"%s\", must be bgra or rgba\n", arg);
+            exit(3);
+          }
+        } else if (strcmp(arg, "-raw-colorspace") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          if (strcmp(arg, "srgb") == 0 || strcmp(arg, "linear") == 0) {
+            args[@"-raw-colorspace"] = [NSString stringWithUTF8String:arg];
+          } else {
+            printf("unknown option -raw-colorspace value \"%s\", must be srgb or linear\n", arg);
+            exit(3);
+          }
+        } else if (strcmp(arg, "-raw-buffers") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          int numBuffers = atoi(arg);
+          
+          if (numBuffers < 1 || numBuffers > 64) {
+            printf("option -raw-buffers value \"%s\" must be in range 1 to 64\n", arg);
+            exit(3);
+          }
+          
+          args[@"-raw-buffers"] = @(numBuffers);
+        } else if (strcmp(arg, "-renditions") == 0) {
+          i++;
+          arg = (char *) argv[i];
+          i++;
+          
+          NSMutableArray *renditions = [NSMutableArray array];
+          
+          for (NSString *sizeStr in [[NSString stringWithUTF8String:arg] componentsSeparatedByString:@","]) {
+            int width = 0;
+            int height = 0;
+            
+            if (sscanf([sizeStr UTF8String], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0 || (width % 2) != 0 || (height % 2) != 0) {
+              printf("option -renditions size \"%s\" must be WxH with even width and height\n", [sizeStr UTF8String]);
+              exit(3);
+            }
+            
+            [renditions addObject:@[@(width), @(height)]];
+          }
+          
+          if (renditions.count > RL_MAX_RENDITIONS) {
+            printf("option -renditions accepts at most %d sizes\n", RL_MAX_RENDITIONS);
+            exit(3);
+          }
+          
+          args[@"-renditions"] = renditions;
         } else if (strcmp(arg, "-frame") == 0) {
           // Indicates a single frame of image data
           i++;
@@ -1288,8 +2278,30 @@ int main(int argc, const char * argv[]) {
       }
     }
 
-    if (inPNG == NULL) {
-      printf("int filename not found, either -frame or -frames must be used to indicate input image(s)\n");
+    BOOL isRawFrames = (args[@"-raw-frames"] != nil);
+    
+    if (isRawFrames && inPNG != NULL) {
+      printf("-raw-frames can't be used with -frame or -frames\n");
+      exit(3);
+    }
+    
+    if (isRawFrames && args[@"-raw-width"] == nil) {
+      printf("-raw-frames needs -raw-size WxH\n");
+      exit(3);
+    }
+    
+    if (isRawFrames && args[@"-cache"] != nil) {
+      printf("-cache can't be used with -raw-frames\n");
+      exit(3);
+    }
+    
+    if (args[@"-renditions"] != nil && (isRawFrames || args[@"-cache"] != nil)) {
+      printf("-renditions can't be used with -raw-frames or -cache\n");
+      exit(3);
+    }
+    
+    if (inPNG == NULL && !isRawFrames) {
+      printf("int filename not found, either -frame or -frames or -raw-frames must be used to indicate input image(s)\n");
       exit(3);
     }
     
@@ -1298,7 +2310,7 @@ int main(int argc, const char * argv[]) {
       exit(3);
     }
     
-    args[@"input"] = [NSString stringWithFormat:@"%s", inPNG];
+    args[@"input"] = isRawFrames ? args[@"-raw-frames"] : [NSString stringWithFormat:@"%s", inPNG];
     args[@"output"] = [NSString stringWithFormat:@"%s", outY4m];
     
     // Input must be .png or .jpg
@@ -1306,7 +2318,7 @@ int main(int argc, const char * argv[]) {
     BOOL isPNG = [args[@"input"] hasSuffix:@".png"];
     BOOL isJPG = [args[@"input"] hasSuffix:@".jpg"] || [args[@"input"] hasSuffix:@".jpeg"];
     
-    if (isPNG || isJPG) {
+    if (isPNG || isJPG || isRawFrames) {
       // input is good
     } else {
       printf("input filename \"%s\" must be .png or .jpg or .jpeg\n", inPNG);
@@ -1315,12 +2327,25 @@ int main(int argc, const char * argv[]) {
     
     args[@"inputIsFramesPattern"] = @(inPNGIsFramesPattern);
     
-    BOOL isY4m = [args[@"output"] hasSuffix:@".y4m"];
+    // Output "-" is a .y4m stream on stdout
+    
+    BOOL isStdout = [args[@"output"] isEqualToString:@"-"];
     
-    if (isY4m) {
+    BOOL isY4m = [args[@"output"] hasSuffix:@".y4m"] || isStdout;
+#if defined(AOV_HAVE_X264)
+    BOOL isM4v = [args[@"output"] hasSuffix:@".m4v"];
+#else
+    BOOL isM4v = FALSE;
+#endif // AOV_HAVE_X264
+    
+    if (isY4m || isM4v) {
       // output is good
     } else {
+#if defined(AOV_HAVE_X264)
+      printf("output filename \"%s\" must have extension .y4m or .m4v\n", outY4m);
+#else
       printf("output filename \"%s\" must have extension .y4m\n", outY4m);
+#endif // AOV_HAVE_X264
       exit(3);
     }
     
@@ -1333,9 +2358,47 @@ int main(int argc, const char * argv[]) {
         printf("-alpha 1 can only be used with -gamma srgb\n : got \"%s\"", [args[@"-gamma"] UTF8String]);
         exit(3);
       }
+      
+      if (isStdout) {
+        printf("-alpha 1 writes two outputs and can't be used with output -\n");
+        exit(3);
+      }
+    }
+    
+    if (isStdout && args[@"-renditions"] != nil) {
+      printf("-renditions writes one output per size and can't be used with output -\n");
+      exit(3);
     }
     
+    if (isStdout) {
+      // Frames go to a copy of stdout, everything printed goes to stderr
+      
+      fflush(stdout);
+      
+      int outFd = dup(STDOUT_FILENO);
+      
+      if (outFd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 || (y4mOutStream = fdopen(outFd, "wb")) == NULL) {
+        fprintf(stderr, "can't write .y4m stream to stdout\n");
+        exit(3);
+      }
+    }
+    
+    encode_stats_init(&encodeStats, [args[@"-stats"] boolValue]);
+    
     retcode = process(args);
+    
+    if (encodeStats.enabled) {
+      encode_stats_print(&encodeStats, stdout);
+      
+      NSString *jsonPath = args[@"-stats-json"];
+      
+      if (jsonPath != nil && encode_stats_write_json(&encodeStats, [jsonPath fileSystemRepresentation]) != 0) {
+        fprintf(stderr, "can't write stats to \"%s\"\n", [jsonPath UTF8String]);
+        if (retcode == 0) {
+          retcode = 1;
+        }
+      }
+    }
   }
   
   exit(retcode);